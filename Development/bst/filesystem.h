@@ -67,6 +67,7 @@ namespace bst
         using bst_filesystem::exists;
         using bst_filesystem::is_directory;
         using bst_filesystem::file_size;
+        using bst_filesystem::last_write_time;
         using bst_filesystem::create_directory;
         using bst_filesystem::remove_all;
     }
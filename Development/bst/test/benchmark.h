@@ -0,0 +1,67 @@
+#ifndef BST_TEST_BENCHMARK_H
+#define BST_TEST_BENCHMARK_H
+
+#include <chrono>
+#include <iomanip>
+#include <iostream>
+#include <string>
+
+////////////////////////////////////////////////////////////////////////////////////////////
+// This file introduces a simple timing loop for micro-benchmarks, which are written as test cases
+// using the shim in bst/test/test.h, so they are independent of the underlying testing framework.
+
+// bst::test::benchmark(name, function) - call function repeatedly, doubling the number of iterations until the batch takes
+// at least the minimum time, and report the mean time per iteration
+// bst::test::do_not_optimize(value) - prevent the compiler from discarding the computation of value
+
+namespace bst
+{
+    namespace test
+    {
+        template <typename T>
+        inline void do_not_optimize(const T& value)
+        {
+#if defined(__GNUC__) || defined(__clang__)
+            asm volatile("" : : "r,m"(value) : "memory");
+#else
+            static const volatile void* sink;
+            sink = &value;
+#endif
+        }
+
+        struct benchmark_result
+        {
+            std::size_t iterations;
+            std::chrono::nanoseconds elapsed;
+
+            double nanoseconds_per_iteration() const { return 0 != iterations ? double(elapsed.count()) / iterations : 0.0; }
+        };
+
+        template <typename Function>
+        inline benchmark_result benchmark(const std::string& name, Function function, std::chrono::nanoseconds min_time = std::chrono::milliseconds(200), std::ostream& os = std::cout)
+        {
+            typedef std::chrono::steady_clock clock;
+
+            benchmark_result result{ 0, {} };
+            for (std::size_t iterations = 1;; iterations *= 2)
+            {
+                const auto start = clock::now();
+                for (std::size_t iteration = 0; iteration < iterations; ++iteration)
+                {
+                    function();
+                }
+                result = { iterations, std::chrono::duration_cast<std::chrono::nanoseconds>(clock::now() - start) };
+                if (result.elapsed >= min_time) break;
+            }
+
+            os << std::left << std::setw(64) << name << std::right
+                << std::setw(12) << result.iterations << " iterations"
+                << std::setw(16) << std::fixed << std::setprecision(1) << result.nanoseconds_per_iteration() << " ns/iteration"
+                << std::endl;
+
+            return result;
+        }
+    }
+}
+
+#endif
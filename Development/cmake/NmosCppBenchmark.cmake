@@ -0,0 +1,89 @@
+# CMake instructions for making the nmos-cpp benchmark program
+
+# caller can set NMOS_CPP_DIR if the project is different
+if (NOT DEFINED NMOS_CPP_DIR)
+    set (NMOS_CPP_DIR ${PROJECT_SOURCE_DIR})
+endif()
+
+# nmos-cpp-benchmark
+# the micro-benchmarks are test cases using the same shim as nmos-cpp-test, but take much longer to run,
+# so they are not registered with CTest; run e.g. "nmos-cpp-benchmark" or "nmos-cpp-benchmark benchmarkRql"
+
+set(NMOS_CPP_BENCHMARK_SOURCES
+    ${NMOS_CPP_DIR}/nmos-cpp-benchmark/main.cpp
+    )
+set(NMOS_CPP_BENCHMARK_HEADERS
+    )
+
+set(NMOS_CPP_BENCHMARK_BST_TEST_SOURCES
+    )
+set(NMOS_CPP_BENCHMARK_BST_TEST_HEADERS
+    ${NMOS_CPP_DIR}/bst/test/benchmark.h
+    ${NMOS_CPP_DIR}/bst/test/test.h
+    )
+
+set(NMOS_CPP_BENCHMARK_CPPREST_TEST_SOURCES
+    ${NMOS_CPP_DIR}/cpprest/test/json_utils_benchmark.cpp
+    )
+set(NMOS_CPP_BENCHMARK_CPPREST_TEST_HEADERS
+    )
+
+set(NMOS_CPP_BENCHMARK_NMOS_TEST_SOURCES
+    ${NMOS_CPP_DIR}/nmos/test/connection_activation_benchmark.cpp
+    ${NMOS_CPP_DIR}/nmos/test/resources_benchmark.cpp
+    ${NMOS_CPP_DIR}/nmos/test/websocket_fanout_benchmark.cpp
+    )
+set(NMOS_CPP_BENCHMARK_NMOS_TEST_HEADERS
+    )
+
+set(NMOS_CPP_BENCHMARK_RQL_TEST_SOURCES
+    ${NMOS_CPP_DIR}/rql/test/rql_benchmark.cpp
+    )
+set(NMOS_CPP_BENCHMARK_RQL_TEST_HEADERS
+    )
+
+set(NMOS_CPP_BENCHMARK_SDP_TEST_SOURCES
+    ${NMOS_CPP_DIR}/sdp/test/sdp_benchmark.cpp
+    )
+set(NMOS_CPP_BENCHMARK_SDP_TEST_HEADERS
+    )
+
+add_executable(
+    nmos-cpp-benchmark
+    ${NMOS_CPP_BENCHMARK_SOURCES}
+    ${NMOS_CPP_BENCHMARK_HEADERS}
+    ${NMOS_CPP_BENCHMARK_BST_TEST_SOURCES}
+    ${NMOS_CPP_BENCHMARK_BST_TEST_HEADERS}
+    ${NMOS_CPP_BENCHMARK_CPPREST_TEST_SOURCES}
+    ${NMOS_CPP_BENCHMARK_CPPREST_TEST_HEADERS}
+    ${NMOS_CPP_BENCHMARK_NMOS_TEST_SOURCES}
+    ${NMOS_CPP_BENCHMARK_NMOS_TEST_HEADERS}
+    ${NMOS_CPP_BENCHMARK_RQL_TEST_SOURCES}
+    ${NMOS_CPP_BENCHMARK_RQL_TEST_HEADERS}
+    ${NMOS_CPP_BENCHMARK_SDP_TEST_SOURCES}
+    ${NMOS_CPP_BENCHMARK_SDP_TEST_HEADERS}
+    )
+
+source_group("Source Files" FILES ${NMOS_CPP_BENCHMARK_SOURCES})
+source_group("bst\\test\\Source Files" FILES ${NMOS_CPP_BENCHMARK_BST_TEST_SOURCES})
+source_group("cpprest\\test\\Source Files" FILES ${NMOS_CPP_BENCHMARK_CPPREST_TEST_SOURCES})
+source_group("nmos\\test\\Source Files" FILES ${NMOS_CPP_BENCHMARK_NMOS_TEST_SOURCES})
+source_group("rql\\test\\Source Files" FILES ${NMOS_CPP_BENCHMARK_RQL_TEST_SOURCES})
+source_group("sdp\\test\\Source Files" FILES ${NMOS_CPP_BENCHMARK_SDP_TEST_SOURCES})
+
+source_group("Header Files" FILES ${NMOS_CPP_BENCHMARK_HEADERS})
+source_group("bst\\test\\Header Files" FILES ${NMOS_CPP_BENCHMARK_BST_TEST_HEADERS})
+source_group("cpprest\\test\\Header Files" FILES ${NMOS_CPP_BENCHMARK_CPPREST_TEST_HEADERS})
+source_group("nmos\\test\\Header Files" FILES ${NMOS_CPP_BENCHMARK_NMOS_TEST_HEADERS})
+source_group("rql\\test\\Header Files" FILES ${NMOS_CPP_BENCHMARK_RQL_TEST_HEADERS})
+source_group("sdp\\test\\Header Files" FILES ${NMOS_CPP_BENCHMARK_SDP_TEST_HEADERS})
+
+target_link_libraries(
+    nmos-cpp-benchmark
+    nmos-cpp_static
+    mdns_static
+    cpprestsdk::cpprest
+    ${BONJOUR_LIB}
+    ${PLATFORM_LIBS}
+    ${Boost_LIBRARIES}
+    )
@@ -76,6 +76,9 @@ if(${CMAKE_SYSTEM_NAME} STREQUAL "Linux")
     else()
         list(APPEND FIND_BOOST_COMPONENTS filesystem)
     endif()
+
+    # add dependency required by nmos/resources_shared_memory.cpp (shm_open is in librt before glibc 2.34)
+    list(APPEND PLATFORM_LIBS -lrt)
 endif()
 
 if(${CMAKE_SYSTEM_NAME} MATCHES "Windows")
@@ -118,6 +121,94 @@ if(${CMAKE_SYSTEM_NAME} MATCHES "Windows")
     set (CMAKE_EXE_LINKER_FLAGS "${CMAKE_EXE_LINKER_FLAGS} /NODEFAULTLIB:libcmt")
 endif()
 
+# optional support for the WebSocket permessage-deflate extension (RFC 7692) in websocket_listener, which depends on zlib
+set (NMOS_CPP_WEBSOCKETS_PERMESSAGE_DEFLATE OFF CACHE BOOL "Enable negotiation of WebSocket permessage-deflate compression (requires zlib)")
+if (NMOS_CPP_WEBSOCKETS_PERMESSAGE_DEFLATE)
+    find_package(ZLIB REQUIRED)
+    include_directories(${ZLIB_INCLUDE_DIRS})
+    list(APPEND PLATFORM_LIBS ${ZLIB_LIBRARIES})
+    add_definitions(/DCPPREST_WEBSOCKETS_PERMESSAGE_DEFLATE)
+endif()
+
+# optional support for gzip and deflate content-coding of HTTP API response bodies, which depends on zlib
+set (NMOS_CPP_HTTP_COMPRESSION OFF CACHE BOOL "Enable compression of HTTP API response bodies according to Accept-Encoding (requires zlib)")
+if (NMOS_CPP_HTTP_COMPRESSION)
+    find_package(ZLIB REQUIRED)
+    include_directories(${ZLIB_INCLUDE_DIRS})
+    list(APPEND PLATFORM_LIBS ${ZLIB_LIBRARIES})
+    add_definitions(/DNMOS_CPP_HTTP_COMPRESSION)
+endif()
+
+# optional use of an alternative memory allocator, e.g. to reduce fragmentation, or to investigate memory growth
+# (see nmos/allocator.h for the statistics reported by the Metrics API, and releasing free memory)
+set (NMOS_CPP_MALLOC "" CACHE STRING "Memory allocator to link, \"jemalloc\" or \"tcmalloc\", or empty for the system allocator")
+if (NMOS_CPP_MALLOC STREQUAL "jemalloc")
+    find_path(JEMALLOC_INCLUDE_DIR jemalloc/jemalloc.h)
+    find_library(JEMALLOC_LIBRARY jemalloc)
+    if (NOT JEMALLOC_INCLUDE_DIR OR NOT JEMALLOC_LIBRARY)
+        message(FATAL_ERROR "NMOS_CPP_MALLOC is jemalloc, but jemalloc was not found")
+    endif()
+    include_directories(${JEMALLOC_INCLUDE_DIR})
+    list(APPEND PLATFORM_LIBS ${JEMALLOC_LIBRARY})
+    add_definitions(/DNMOS_CPP_MALLOC_JEMALLOC)
+elseif (NMOS_CPP_MALLOC STREQUAL "tcmalloc")
+    find_path(TCMALLOC_INCLUDE_DIR gperftools/malloc_extension_c.h)
+    find_library(TCMALLOC_LIBRARY tcmalloc)
+    if (NOT TCMALLOC_INCLUDE_DIR OR NOT TCMALLOC_LIBRARY)
+        message(FATAL_ERROR "NMOS_CPP_MALLOC is tcmalloc, but tcmalloc was not found")
+    endif()
+    include_directories(${TCMALLOC_INCLUDE_DIR})
+    list(APPEND PLATFORM_LIBS ${TCMALLOC_LIBRARY})
+    add_definitions(/DNMOS_CPP_MALLOC_TCMALLOC)
+elseif (NMOS_CPP_MALLOC)
+    message(FATAL_ERROR "NMOS_CPP_MALLOC must be jemalloc, tcmalloc or empty")
+endif()
+
+# optional instrumentation of nmos::mutex, which records the time spent waiting for and holding each lock by call site, e.g. for the Metrics API
+set (NMOS_CPP_INSTRUMENT_MUTEX OFF CACHE BOOL "Enable instrumentation of nmos::mutex to measure lock contention")
+if (NMOS_CPP_INSTRUMENT_MUTEX)
+    add_definitions(/DNMOS_CPP_INSTRUMENT_MUTEX)
+endif()
+
+# optional USDT tracepoints (see nmos/tracepoints.h), which cost a nop each until a tracer such as bpftrace or perf attaches to them
+# this requires sys/sdt.h, e.g. from the systemtap-sdt-dev or systemtap-sdt-devel package
+set (NMOS_CPP_USDT OFF CACHE BOOL "Enable USDT tracepoints for profiling with bpftrace or perf")
+if (NMOS_CPP_USDT)
+    include(CheckIncludeFileCXX)
+    check_include_file_cxx(sys/sdt.h NMOS_CPP_HAVE_SYS_SDT_H)
+    if (NOT NMOS_CPP_HAVE_SYS_SDT_H)
+        message(FATAL_ERROR "NMOS_CPP_USDT requires sys/sdt.h")
+    endif()
+    add_definitions(/DNMOS_CPP_USDT)
+endif()
+
+# the JSON Schema validator walks web::json::value instances directly by default
+# the previous implementation using nlohmann/json and pboettch/json-schema-validator, which converts each instance, can be selected instead
+set (NMOS_CPP_NLOHMANN_JSON_VALIDATOR OFF CACHE BOOL "Use the JSON Schema validator implementation based on nlohmann/json")
+if (NMOS_CPP_NLOHMANN_JSON_VALIDATOR)
+    add_definitions(/DCPPREST_JSON_VALIDATOR_NLOHMANN)
+endif()
+
+# the IS-04, IS-05 and IS-09 API versions to build in, e.g. "v1.2;v1.3", so that the schemas of other versions are omitted from the libraries
+# the corresponding settings, e.g. "is04_versions", can only select from these versions
+set (NMOS_CPP_IS04_VERSIONS "v1.0;v1.1;v1.2;v1.3" CACHE STRING "IS-04 API versions to build in")
+set (NMOS_CPP_IS05_VERSIONS "v1.0;v1.1" CACHE STRING "IS-05 API versions to build in")
+set (NMOS_CPP_IS09_VERSIONS "v1.0" CACHE STRING "IS-09 API versions to build in")
+foreach (SPEC IS04 IS05 IS09)
+    if (NOT NMOS_CPP_${SPEC}_VERSIONS)
+        message(FATAL_ERROR "NMOS_CPP_${SPEC}_VERSIONS must include at least one API version")
+    endif()
+endforeach()
+foreach (SPEC_VERSION IS04_V1_0 IS04_V1_1 IS04_V1_2 IS04_V1_3 IS05_V1_0 IS05_V1_1 IS09_V1_0)
+    string(REGEX REPLACE "^(IS[0-9]+)_V([0-9]+)_([0-9]+)$" "\\1" SPEC "${SPEC_VERSION}")
+    string(REGEX REPLACE "^(IS[0-9]+)_V([0-9]+)_([0-9]+)$" "v\\2.\\3" VERSION "${SPEC_VERSION}")
+    list(FIND NMOS_CPP_${SPEC}_VERSIONS "${VERSION}" FOUND)
+    if (FOUND EQUAL -1)
+        set (NMOS_CPP_EXCLUDE_${SPEC_VERSION} ON)
+        add_definitions(/DNMOS_CPP_EXCLUDE_${SPEC_VERSION})
+    endif()
+endforeach()
+
 # since std::shared_mutex is not available until C++17
 list(APPEND FIND_BOOST_COMPONENTS thread)
 add_definitions(/DBST_SHARED_MUTEX_BOOST)
@@ -9,12 +9,14 @@ endif()
 
 set(MDNS_SOURCES
     ${NMOS_CPP_DIR}/mdns/core.cpp
+    ${NMOS_CPP_DIR}/mdns/discovery_cache.cpp
     ${NMOS_CPP_DIR}/mdns/dns_sd_impl.cpp
     ${NMOS_CPP_DIR}/mdns/service_advertiser_impl.cpp
     ${NMOS_CPP_DIR}/mdns/service_discovery_impl.cpp
     )
 set(MDNS_HEADERS
     ${NMOS_CPP_DIR}/mdns/core.h
+    ${NMOS_CPP_DIR}/mdns/discovery_cache.h
     ${NMOS_CPP_DIR}/mdns/dns_sd_impl.h
     ${NMOS_CPP_DIR}/mdns/service_advertiser.h
     ${NMOS_CPP_DIR}/mdns/service_discovery.h
@@ -220,6 +222,13 @@ set(NMOS_IS04_V1_0_SCHEMAS_JSON
     ${NMOS_CPP_DIR}/third_party/nmos-discovery-registration/${NMOS_IS04_V1_0_TAG}/APIs/schemas/sources.json
     )
 
+# omit the schemas of the API versions which are not built in (see NMOS_CPP_IS04_VERSIONS)
+foreach(VERSION V1_0 V1_1 V1_2 V1_3)
+    if (NMOS_CPP_EXCLUDE_IS04_${VERSION})
+        set(NMOS_IS04_${VERSION}_SCHEMAS_JSON)
+    endif()
+endforeach()
+
 set(NMOS_IS04_SCHEMAS_JSON_MATCH "${NMOS_CPP_DIR}/third_party/nmos-discovery-registration/([^/]+)/APIs/schemas/([^;]+)\\.json")
 set(NMOS_IS04_SCHEMAS_SOURCE_REPLACE "${CMAKE_BINARY_DIR}/nmos/is04_schemas/\\1/\\2.cpp")
 string(REGEX REPLACE "${NMOS_IS04_SCHEMAS_JSON_MATCH}(;|$)" "${NMOS_IS04_SCHEMAS_SOURCE_REPLACE}\\3" NMOS_IS04_V1_3_SCHEMAS_SOURCES "${NMOS_IS04_V1_3_SCHEMAS_JSON}")
@@ -336,6 +345,13 @@ set(NMOS_IS05_V1_0_SCHEMAS_JSON
     ${NMOS_CPP_DIR}/third_party/nmos-device-connection-management/${NMOS_IS05_V1_0_TAG}/APIs/schemas/v1.0-sender-stage-schema.json
     )
 
+# omit the schemas of the API versions which are not built in (see NMOS_CPP_IS05_VERSIONS)
+foreach(VERSION V1_0 V1_1)
+    if (NMOS_CPP_EXCLUDE_IS05_${VERSION})
+        set(NMOS_IS05_${VERSION}_SCHEMAS_JSON)
+    endif()
+endforeach()
+
 set(NMOS_IS05_SCHEMAS_JSON_MATCH "${NMOS_CPP_DIR}/third_party/nmos-device-connection-management/([^/]+)/APIs/schemas/([^;]+)\\.json")
 set(NMOS_IS05_SCHEMAS_SOURCE_REPLACE "${CMAKE_BINARY_DIR}/nmos/is05_schemas/\\1/\\2.cpp")
 string(REGEX REPLACE "${NMOS_IS05_SCHEMAS_JSON_MATCH}(;|$)" "${NMOS_IS05_SCHEMAS_SOURCE_REPLACE}\\3" NMOS_IS05_V1_1_SCHEMAS_SOURCES "${NMOS_IS05_V1_1_SCHEMAS_JSON}")
@@ -400,6 +416,13 @@ set(NMOS_IS09_V1_0_SCHEMAS_JSON
     ${NMOS_CPP_DIR}/third_party/nmos-system/${NMOS_IS09_V1_0_TAG}/APIs/schemas/resource_core.json
     )
 
+# omit the schemas of the API versions which are not built in (see NMOS_CPP_IS09_VERSIONS)
+foreach(VERSION V1_0)
+    if (NMOS_CPP_EXCLUDE_IS09_${VERSION})
+        set(NMOS_IS09_${VERSION}_SCHEMAS_JSON)
+    endif()
+endforeach()
+
 set(NMOS_IS09_SCHEMAS_JSON_MATCH "${NMOS_CPP_DIR}/third_party/nmos-system/([^/]+)/APIs/schemas/([^;]+)\\.json")
 set(NMOS_IS09_SCHEMAS_SOURCE_REPLACE "${CMAKE_BINARY_DIR}/nmos/is09_schemas/\\1/\\2.cpp")
 string(REGEX REPLACE "${NMOS_IS09_SCHEMAS_JSON_MATCH}(;|$)" "${NMOS_IS09_SCHEMAS_SOURCE_REPLACE}\\3" NMOS_IS09_V1_0_SCHEMAS_SOURCES "${NMOS_IS09_V1_0_SCHEMAS_JSON}")
@@ -512,23 +535,33 @@ set(NMOS_CPP_CPPREST_HEADERS
 
 set(NMOS_CPP_NMOS_SOURCES
     ${NMOS_CPP_DIR}/nmos/admin_ui.cpp
+    ${NMOS_CPP_DIR}/nmos/allocator.cpp
     ${NMOS_CPP_DIR}/nmos/api_downgrade.cpp
     ${NMOS_CPP_DIR}/nmos/api_utils.cpp
+    ${NMOS_CPP_DIR}/nmos/binary_log.cpp
     ${NMOS_CPP_DIR}/nmos/client_utils.cpp
     ${NMOS_CPP_DIR}/nmos/components.cpp
+    ${NMOS_CPP_DIR}/nmos/connection_activation.cpp
     ${NMOS_CPP_DIR}/nmos/connection_api.cpp
     ${NMOS_CPP_DIR}/nmos/connection_resources.cpp
     ${NMOS_CPP_DIR}/nmos/events_api.cpp
+    ${NMOS_CPP_DIR}/nmos/events_mqtt.cpp
     ${NMOS_CPP_DIR}/nmos/events_resources.cpp
     ${NMOS_CPP_DIR}/nmos/events_ws_api.cpp
+    ${NMOS_CPP_DIR}/nmos/expiry_utils.cpp
     ${NMOS_CPP_DIR}/nmos/filesystem_route.cpp
     ${NMOS_CPP_DIR}/nmos/group_hint.cpp
+    ${NMOS_CPP_DIR}/nmos/heartbeat_scheduler.cpp
     ${NMOS_CPP_DIR}/nmos/id.cpp
     ${NMOS_CPP_DIR}/nmos/json_schema.cpp
+    ${NMOS_CPP_DIR}/nmos/log_filebuf.cpp
     ${NMOS_CPP_DIR}/nmos/log_model.cpp
     ${NMOS_CPP_DIR}/nmos/logging_api.cpp
     ${NMOS_CPP_DIR}/nmos/mdns.cpp
     ${NMOS_CPP_DIR}/nmos/mdns_api.cpp
+    ${NMOS_CPP_DIR}/nmos/metrics.cpp
+    ${NMOS_CPP_DIR}/nmos/metrics_api.cpp
+    ${NMOS_CPP_DIR}/nmos/mutex.cpp
     ${NMOS_CPP_DIR}/nmos/node_api.cpp
     ${NMOS_CPP_DIR}/nmos/node_api_target_handler.cpp
     ${NMOS_CPP_DIR}/nmos/node_behaviour.cpp
@@ -538,39 +571,58 @@ set(NMOS_CPP_NMOS_SOURCES
     ${NMOS_CPP_DIR}/nmos/query_api.cpp
     ${NMOS_CPP_DIR}/nmos/query_utils.cpp
     ${NMOS_CPP_DIR}/nmos/query_ws_api.cpp
+    ${NMOS_CPP_DIR}/nmos/rate_limiter.cpp
     ${NMOS_CPP_DIR}/nmos/registration_api.cpp
+    ${NMOS_CPP_DIR}/nmos/registration_validation.cpp
+    ${NMOS_CPP_DIR}/nmos/registry_federation.cpp
+    ${NMOS_CPP_DIR}/nmos/registry_replication.cpp
     ${NMOS_CPP_DIR}/nmos/registry_resources.cpp
+    ${NMOS_CPP_DIR}/nmos/registry_snapshot.cpp
+    ${NMOS_CPP_DIR}/nmos/request_accounting.cpp
     ${NMOS_CPP_DIR}/nmos/resource.cpp
+    ${NMOS_CPP_DIR}/nmos/resource_journal.cpp
     ${NMOS_CPP_DIR}/nmos/resources.cpp
+    ${NMOS_CPP_DIR}/nmos/resources_batch.cpp
+    ${NMOS_CPP_DIR}/nmos/resources_shared_memory.cpp
     ${NMOS_CPP_DIR}/nmos/sdp_utils.cpp
     ${NMOS_CPP_DIR}/nmos/server_utils.cpp
     ${NMOS_CPP_DIR}/nmos/settings.cpp
     ${NMOS_CPP_DIR}/nmos/settings_api.cpp
     ${NMOS_CPP_DIR}/nmos/system_api.cpp
     ${NMOS_CPP_DIR}/nmos/system_resources.cpp
+    ${NMOS_CPP_DIR}/nmos/thread_scheduling.cpp
+    ${NMOS_CPP_DIR}/nmos/traffic_trace.cpp
+    ${NMOS_CPP_DIR}/nmos/websockets.cpp
     )
 set(NMOS_CPP_NMOS_HEADERS
     ${NMOS_CPP_DIR}/nmos/activation_mode.h
     ${NMOS_CPP_DIR}/nmos/admin_ui.h
+    ${NMOS_CPP_DIR}/nmos/allocator.h
     ${NMOS_CPP_DIR}/nmos/api_downgrade.h
     ${NMOS_CPP_DIR}/nmos/api_utils.h
     ${NMOS_CPP_DIR}/nmos/api_version.h
+    ${NMOS_CPP_DIR}/nmos/binary_log.h
     ${NMOS_CPP_DIR}/nmos/channels.h
     ${NMOS_CPP_DIR}/nmos/client_utils.h
     ${NMOS_CPP_DIR}/nmos/colorspace.h
     ${NMOS_CPP_DIR}/nmos/components.h
+    ${NMOS_CPP_DIR}/nmos/connection_activation.h
     ${NMOS_CPP_DIR}/nmos/copyable_atomic.h
     ${NMOS_CPP_DIR}/nmos/connection_api.h
     ${NMOS_CPP_DIR}/nmos/connection_resources.h
     ${NMOS_CPP_DIR}/nmos/device_type.h
+    ${NMOS_CPP_DIR}/nmos/event_queues.h
     ${NMOS_CPP_DIR}/nmos/event_type.h
     ${NMOS_CPP_DIR}/nmos/events_api.h
+    ${NMOS_CPP_DIR}/nmos/events_mqtt.h
     ${NMOS_CPP_DIR}/nmos/events_resources.h
     ${NMOS_CPP_DIR}/nmos/events_ws_api.h
+    ${NMOS_CPP_DIR}/nmos/expiry_utils.h
     ${NMOS_CPP_DIR}/nmos/filesystem_route.h
     ${NMOS_CPP_DIR}/nmos/format.h
     ${NMOS_CPP_DIR}/nmos/group_hint.h
     ${NMOS_CPP_DIR}/nmos/health.h
+    ${NMOS_CPP_DIR}/nmos/heartbeat_scheduler.h
     ${NMOS_CPP_DIR}/nmos/id.h
     ${NMOS_CPP_DIR}/nmos/interlace_mode.h
     ${NMOS_CPP_DIR}/nmos/is04_versions.h
@@ -579,6 +631,7 @@ set(NMOS_CPP_NMOS_HEADERS
     ${NMOS_CPP_DIR}/nmos/is09_versions.h
     ${NMOS_CPP_DIR}/nmos/json_fields.h
     ${NMOS_CPP_DIR}/nmos/json_schema.h
+    ${NMOS_CPP_DIR}/nmos/log_filebuf.h
     ${NMOS_CPP_DIR}/nmos/log_gate.h
     ${NMOS_CPP_DIR}/nmos/log_manip.h
     ${NMOS_CPP_DIR}/nmos/log_model.h
@@ -586,6 +639,8 @@ set(NMOS_CPP_NMOS_HEADERS
     ${NMOS_CPP_DIR}/nmos/mdns.h
     ${NMOS_CPP_DIR}/nmos/mdns_api.h
     ${NMOS_CPP_DIR}/nmos/media_type.h
+    ${NMOS_CPP_DIR}/nmos/metrics.h
+    ${NMOS_CPP_DIR}/nmos/metrics_api.h
     ${NMOS_CPP_DIR}/nmos/model.h
     ${NMOS_CPP_DIR}/nmos/mutex.h
     ${NMOS_CPP_DIR}/nmos/node_api.h
@@ -600,10 +655,19 @@ set(NMOS_CPP_NMOS_HEADERS
     ${NMOS_CPP_DIR}/nmos/query_ws_api.h
     ${NMOS_CPP_DIR}/nmos/random.h
     ${NMOS_CPP_DIR}/nmos/rational.h
+    ${NMOS_CPP_DIR}/nmos/rate_limiter.h
     ${NMOS_CPP_DIR}/nmos/registration_api.h
+    ${NMOS_CPP_DIR}/nmos/registration_validation.h
+    ${NMOS_CPP_DIR}/nmos/registry_federation.h
+    ${NMOS_CPP_DIR}/nmos/registry_replication.h
     ${NMOS_CPP_DIR}/nmos/registry_resources.h
+    ${NMOS_CPP_DIR}/nmos/registry_snapshot.h
+    ${NMOS_CPP_DIR}/nmos/request_accounting.h
     ${NMOS_CPP_DIR}/nmos/resource.h
+    ${NMOS_CPP_DIR}/nmos/resource_journal.h
     ${NMOS_CPP_DIR}/nmos/resources.h
+    ${NMOS_CPP_DIR}/nmos/resources_batch.h
+    ${NMOS_CPP_DIR}/nmos/resources_shared_memory.h
     ${NMOS_CPP_DIR}/nmos/sdp_utils.h
     ${NMOS_CPP_DIR}/nmos/server_utils.h
     ${NMOS_CPP_DIR}/nmos/settings.h
@@ -614,7 +678,10 @@ set(NMOS_CPP_NMOS_HEADERS
     ${NMOS_CPP_DIR}/nmos/system_api.h
     ${NMOS_CPP_DIR}/nmos/system_resources.h
     ${NMOS_CPP_DIR}/nmos/tai.h
+    ${NMOS_CPP_DIR}/nmos/thread_scheduling.h
     ${NMOS_CPP_DIR}/nmos/thread_utils.h
+    ${NMOS_CPP_DIR}/nmos/tracepoints.h
+    ${NMOS_CPP_DIR}/nmos/traffic_trace.h
     ${NMOS_CPP_DIR}/nmos/transfer_characteristic.h
     ${NMOS_CPP_DIR}/nmos/transport.h
     ${NMOS_CPP_DIR}/nmos/type.h
@@ -626,6 +693,7 @@ set(NMOS_CPP_PPLX_SOURCES
     ${NMOS_CPP_DIR}/pplx/pplx_utils.cpp
     )
 set(NMOS_CPP_PPLX_HEADERS
+    ${NMOS_CPP_DIR}/pplx/pplx_coroutine.h
     ${NMOS_CPP_DIR}/pplx/pplx_utils.h
     )
 
@@ -23,6 +23,7 @@ set(NMOS_CPP_TEST_CPPREST_TEST_SOURCES
     ${NMOS_CPP_DIR}/cpprest/test/api_router_test.cpp
     ${NMOS_CPP_DIR}/cpprest/test/http_utils_test.cpp
     ${NMOS_CPP_DIR}/cpprest/test/json_utils_test.cpp
+    ${NMOS_CPP_DIR}/cpprest/test/json_validator_test.cpp
     ${NMOS_CPP_DIR}/cpprest/test/regex_utils_test.cpp
     )
 set(NMOS_CPP_TEST_CPPREST_TEST_HEADERS
@@ -36,12 +37,36 @@ set(NMOS_CPP_TEST_MDNS_TEST_HEADERS
     )
 
 set(NMOS_CPP_TEST_NMOS_TEST_SOURCES
+    ${NMOS_CPP_DIR}/nmos/test/allocator_test.cpp
+    ${NMOS_CPP_DIR}/nmos/test/api_downgrade_test.cpp
     ${NMOS_CPP_DIR}/nmos/test/api_utils_test.cpp
+    ${NMOS_CPP_DIR}/nmos/test/binary_log_test.cpp
+    ${NMOS_CPP_DIR}/nmos/test/events_mqtt_test.cpp
+    ${NMOS_CPP_DIR}/nmos/test/id_test.cpp
+    ${NMOS_CPP_DIR}/nmos/test/log_model_test.cpp
     ${NMOS_CPP_DIR}/nmos/test/paging_utils_test.cpp
+    ${NMOS_CPP_DIR}/nmos/test/rate_limiter_test.cpp
+    ${NMOS_CPP_DIR}/nmos/test/registration_validation_test.cpp
+    ${NMOS_CPP_DIR}/nmos/test/registry_federation_test.cpp
+    ${NMOS_CPP_DIR}/nmos/test/registry_snapshot_test.cpp
+    ${NMOS_CPP_DIR}/nmos/test/resources_shared_memory_test.cpp
+    ${NMOS_CPP_DIR}/nmos/test/resources_test.cpp
+    ${NMOS_CPP_DIR}/nmos/test/sdp_utils_test.cpp
+    ${NMOS_CPP_DIR}/nmos/test/server_utils_test.cpp
+    ${NMOS_CPP_DIR}/nmos/test/slog_test.cpp
+    ${NMOS_CPP_DIR}/nmos/test/thread_scheduling_test.cpp
+    ${NMOS_CPP_DIR}/nmos/test/traffic_trace_test.cpp
+    ${NMOS_CPP_DIR}/nmos/test/version_test.cpp
     )
 set(NMOS_CPP_TEST_NMOS_TEST_HEADERS
     )
 
+set(NMOS_CPP_TEST_RQL_TEST_SOURCES
+    ${NMOS_CPP_DIR}/rql/test/rql_test.cpp
+    )
+set(NMOS_CPP_TEST_RQL_TEST_HEADERS
+    )
+
 set(NMOS_CPP_TEST_SDP_TEST_SOURCES
     ${NMOS_CPP_DIR}/sdp/test/sdp_test.cpp
     )
@@ -60,6 +85,8 @@ add_executable(
     ${NMOS_CPP_TEST_MDNS_TEST_HEADERS}
     ${NMOS_CPP_TEST_NMOS_TEST_SOURCES}
     ${NMOS_CPP_TEST_NMOS_TEST_HEADERS}
+    ${NMOS_CPP_TEST_RQL_TEST_SOURCES}
+    ${NMOS_CPP_TEST_RQL_TEST_HEADERS}
     ${NMOS_CPP_TEST_SDP_TEST_SOURCES}
     ${NMOS_CPP_TEST_SDP_TEST_HEADERS}
     )
@@ -69,6 +96,7 @@ source_group("bst\\test\\Source Files" FILES ${NMOS_CPP_TEST_BST_TEST_SOURCES})
 source_group("cpprest\\test\\Source Files" FILES ${NMOS_CPP_TEST_CPPREST_TEST_SOURCES})
 source_group("mdns\\test\\Source Files" FILES ${NMOS_CPP_TEST_MDNS_TEST_SOURCES})
 source_group("nmos\\test\\Source Files" FILES ${NMOS_CPP_TEST_NMOS_TEST_SOURCES})
+source_group("rql\\test\\Source Files" FILES ${NMOS_CPP_TEST_RQL_TEST_SOURCES})
 source_group("sdp\\test\\Source Files" FILES ${NMOS_CPP_TEST_SDP_TEST_SOURCES})
 
 source_group("Header Files" FILES ${NMOS_CPP_TEST_HEADERS})
@@ -76,6 +104,7 @@ source_group("bst\\test\\Header Files" FILES ${NMOS_CPP_TEST_BST_TEST_HEADERS})
 source_group("cpprest\\test\\Header Files" FILES ${NMOS_CPP_TEST_CPPREST_TEST_HEADERS})
 source_group("mdns\\test\\Header Files" FILES ${NMOS_CPP_TEST_MDNS_TEST_HEADERS})
 source_group("nmos\\test\\Header Files" FILES ${NMOS_CPP_TEST_NMOS_TEST_HEADERS})
+source_group("rql\\test\\Header Files" FILES ${NMOS_CPP_TEST_RQL_TEST_HEADERS})
 source_group("sdp\\test\\Header Files" FILES ${NMOS_CPP_TEST_SDP_TEST_HEADERS})
 
 target_link_libraries(
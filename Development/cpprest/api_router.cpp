@@ -9,6 +9,28 @@ namespace web
         {
             namespace listener
             {
+                namespace details
+                {
+                    static route_call_hook& global_route_call_hook()
+                    {
+                        static route_call_hook hook;
+                        return hook;
+                    }
+
+                    // call the hook, if any, on construction and destruction, even if the route handler throws
+                    struct route_call_scope
+                    {
+                        explicit route_call_scope(web::http::http_request& req) : req(req) { const auto& hook = global_route_call_hook(); if (hook) hook(req, true); }
+                        ~route_call_scope() { const auto& hook = global_route_call_hook(); if (hook) hook(req, false); }
+                        web::http::http_request& req;
+                    };
+                }
+
+                void set_route_call_hook(route_call_hook hook)
+                {
+                    details::global_route_call_hook() = std::move(hook);
+                }
+
                 utility::string_t api_router::get_route_relative_path(const web::http::http_request& req, const utility::string_t& route_path)
                 {
                     // If the route path is empty, then just return the listener-relative URI.
@@ -68,13 +90,14 @@ namespace web
                     const utility::string_t path = get_route_relative_path(req, route_path); // required, as must live longer than the match results
                     for (; routes.end() != route; ++route)
                     {
-                        utility::smatch_t route_match;
-                        if (route_regex_match(path, route_match, route->route_pattern.first, route->flags))
+                        utility::string_t matched_path;
+                        route_parameters matched_parameters;
+                        if (match_route(*route, path, matched_path, matched_parameters))
                         {
                             // route_path for this route handler is constructed by appending the entire matching expression
-                            const auto merged_path = route_path + route_match.str();
+                            const auto merged_path = route_path + matched_path;
                             // existing parameters are inserted into the new parameters rather than vice-versa so that new parameters replace existing ones with the same name
-                            const auto merged_parameters = insert(get_parameters(route->route_pattern.second, route_match), parameters);
+                            const auto merged_parameters = insert(std::move(matched_parameters), parameters);
 
                             if (route->method == req.method() || any_method == route->method)
                             {
@@ -101,6 +124,8 @@ namespace web
 
                 pplx::task<bool> api_router::call(const route_handler& handler, const route_handler& exception_handler, web::http::http_request req, web::http::http_response res, const utility::string_t& route_path, const route_parameters& parameters)
                 {
+                    const details::route_call_scope scope(req);
+
                     if (!exception_handler)
                     {
                         return handler(req, res, route_path, parameters);
@@ -174,7 +199,10 @@ namespace web
                 api_router::iterator api_router::insert(iterator where, match_flag_type flags, const utility::string_t& route_pattern, const web::http::method& method, route_handler handler)
                 {
                     auto parsed = utility::parse_regex_named_sub_matches(route_pattern);
-                    return routes.insert(where, { flags, { utility::regex_t(parsed.first), parsed.second }, method, handler });
+                    // the regex is constructed even when the simple_regex will be used, so that an invalid route pattern is still reported
+                    utility::simple_regex_t simple_pattern;
+                    simple_pattern.assign(parsed.first);
+                    return routes.insert(where, { flags, { utility::regex_t(parsed.first), parsed.second }, std::move(simple_pattern), method, handler });
                 }
 
                 route_parameters api_router::get_parameters(const utility::named_sub_matches_t& parameter_sub_matches, const utility::smatch_t& route_match)
@@ -191,6 +219,20 @@ namespace web
                     return parameters;
                 }
 
+                route_parameters api_router::get_parameters(const utility::named_sub_matches_t& parameter_sub_matches, const utility::string_t& path, const utility::simple_sub_matches_t& route_match)
+                {
+                    route_parameters parameters;
+                    for (auto& named_sub_match : parameter_sub_matches)
+                    {
+                        auto& sub_match = route_match[named_sub_match.second];
+                        if (utility::simple_regex_t::npos != sub_match.first)
+                        {
+                            parameters[named_sub_match.first] = path.substr(sub_match.first, sub_match.second - sub_match.first);
+                        }
+                    }
+                    return parameters;
+                }
+
                 route_parameters api_router::insert(route_parameters&& into, const route_parameters& range)
                 {
                     // unorderd_map::insert only inserts elements if the container doesn't already contain an element with an equivalent key
@@ -204,6 +246,28 @@ namespace web
                         ? bst::regex_search(path, route_match, route_regex, bst::regex_constants::match_continuous)
                         : bst::regex_match(path, route_match, route_regex);
                 }
+
+                bool api_router::match_route(const route& route, const utility::string_t& path, utility::string_t& matched_path, route_parameters& parameters)
+                {
+                    if (!route.simple_pattern.empty())
+                    {
+                        utility::simple_sub_matches_t route_match;
+                        if (!route.simple_pattern.match(path, route_match, match_prefix == route.flags)) return false;
+
+                        matched_path = path.substr(route_match[0].first, route_match[0].second - route_match[0].first);
+                        parameters = get_parameters(route.route_pattern.second, path, route_match);
+                        return true;
+                    }
+                    else
+                    {
+                        utility::smatch_t route_match;
+                        if (!route_regex_match(path, route_match, route.route_pattern.first, route.flags)) return false;
+
+                        matched_path = route_match.str();
+                        parameters = get_parameters(route.route_pattern.second, route_match);
+                        return true;
+                    }
+                }
             }
         }
     }
@@ -1,9 +1,11 @@
 #ifndef CPPREST_API_ROUTER_H
 #define CPPREST_API_ROUTER_H
 
+#include <array>
 #include <functional>
 #include <list>
-#include <unordered_map>
+#include <stdexcept>
+#include <vector>
 #include "cpprest/http_utils.h"
 #include "cpprest/json_utils.h" // hmm, only for names used in using declarations
 #include "cpprest/regex_utils.h" // hmm, only for types used in private static functions
@@ -22,12 +24,111 @@ namespace web
                 // using namespace api_router_using_declarations;
                 namespace api_router_using_declarations {}
 
-                typedef std::unordered_map<utility::string_t, utility::string_t> route_parameters;
+                // route parameters are held in a flat container with the interface of an associative container, since there are usually only a few
+                // and a small number of them are stored without any allocation other than for the strings themselves
+                class route_parameters
+                {
+                public:
+                    typedef utility::string_t key_type;
+                    typedef utility::string_t mapped_type;
+                    typedef std::pair<key_type, mapped_type> value_type;
+                    typedef std::size_t size_type;
+                    typedef value_type* iterator;
+                    typedef const value_type* const_iterator;
+
+                    route_parameters() : used(0) {}
+
+                    iterator begin() { return data(); }
+                    iterator end() { return data() + used; }
+                    const_iterator begin() const { return data(); }
+                    const_iterator end() const { return data() + used; }
+
+                    bool empty() const { return 0 == used; }
+                    size_type size() const { return used; }
+
+                    iterator find(const key_type& key) { return const_cast<iterator>(const_cast<const route_parameters*>(this)->find(key)); }
+                    const_iterator find(const key_type& key) const
+                    {
+                        auto it = begin();
+                        while (end() != it && it->first != key) ++it;
+                        return it;
+                    }
+                    size_type count(const key_type& key) const { return end() != find(key) ? 1 : 0; }
+
+                    mapped_type& at(const key_type& key) { return const_cast<mapped_type&>(const_cast<const route_parameters*>(this)->at(key)); }
+                    const mapped_type& at(const key_type& key) const
+                    {
+                        auto it = find(key);
+                        if (end() == it) throw std::out_of_range("route parameter not found");
+                        return it->second;
+                    }
+
+                    mapped_type& operator[](const key_type& key)
+                    {
+                        return insert(value_type{ key, mapped_type{} }).first->second;
+                    }
+
+                    // like unordered_map::insert, only inserts elements if the container doesn't already contain an element with an equivalent key
+                    std::pair<iterator, bool> insert(value_type value)
+                    {
+                        auto it = find(value.first);
+                        if (end() != it) return{ it, false };
+
+                        if (overflow.empty() && used < fixed.size())
+                        {
+                            fixed[used] = std::move(value);
+                        }
+                        else
+                        {
+                            if (overflow.empty())
+                            {
+                                overflow.reserve(2 * fixed.size());
+                                overflow.insert(overflow.end(), std::make_move_iterator(fixed.begin()), std::make_move_iterator(fixed.end()));
+                            }
+                            overflow.push_back(std::move(value));
+                        }
+                        ++used;
+                        return{ end() - 1, true };
+                    }
+                    template <typename InputIterator>
+                    void insert(InputIterator first, InputIterator last)
+                    {
+                        for (; last != first; ++first) insert(*first);
+                    }
+
+                    friend bool operator==(const route_parameters& lhs, const route_parameters& rhs)
+                    {
+                        if (lhs.size() != rhs.size()) return false;
+                        for (const auto& parameter : lhs)
+                        {
+                            auto found = rhs.find(parameter.first);
+                            if (rhs.end() == found || found->second != parameter.second) return false;
+                        }
+                        return true;
+                    }
+                    friend bool operator!=(const route_parameters& lhs, const route_parameters& rhs) { return !(lhs == rhs); }
+
+                private:
+                    value_type* data() { return overflow.empty() ? fixed.data() : overflow.data(); }
+                    const value_type* data() const { return overflow.empty() ? fixed.data() : overflow.data(); }
+
+                    // the first few parameters are held in the fixed array, until there are too many and they are all moved to the overflow vector
+                    std::array<value_type, 4> fixed;
+                    std::vector<value_type> overflow;
+                    size_type used;
+                };
 
                 // route handlers have access to the request, and a mutable response object, the route path and parameters extracted from it by the matched route pattern;
                 // a handler may e.g. reply to the request or initiate asynchronous processing, and returns a flag indicating whether to continue matching routes or not
                 typedef std::function<pplx::task<bool>(web::http::http_request, web::http::http_response, const utility::string_t&, const route_parameters&)> route_handler;
 
+                // experimental extension, a hook called on the calling thread immediately before (entering) and after (!entering) any api_router calls a route handler,
+                // e.g. to account for the work done for each request; since handlers may be called on different threads, and a handler that initiates asynchronous
+                // processing returns before that is complete, only the synchronous part of each handler is covered; calls are nested when one api_router is mounted
+                // in another; the hook isn't synchronized, so it must be set before any requests are handled
+                typedef std::function<void(web::http::http_request& req, bool entering)> route_call_hook;
+                void set_route_call_hook(route_call_hook hook);
+
                 class api_router
                 {
                     DETAIL_PRIVATE_ACCESS_DECLARATION
@@ -55,7 +156,8 @@ namespace web
                 private:
                     enum match_flag_type { match_entire = 0, match_prefix = 1 };
                     typedef std::pair<utility::regex_t, utility::named_sub_matches_t> regex_named_sub_matches_type;
-                    struct route { match_flag_type flags; regex_named_sub_matches_type route_pattern; web::http::method method; route_handler handler; };
+                    // route patterns within the subset supported by utility::simple_regex_t are also compiled into a simple_regex, which is used instead of the general regex engine
+                    struct route { match_flag_type flags; regex_named_sub_matches_type route_pattern; utility::simple_regex_t simple_pattern; web::http::method method; route_handler handler; };
                     typedef std::list<route> route_handlers;
                     typedef route_handlers::iterator iterator;
 
@@ -63,8 +165,10 @@ namespace web
                     static pplx::task<bool> call(const route_handler& handler, const route_handler& exception_handler, web::http::http_request req, web::http::http_response res, const utility::string_t& route_path, const route_parameters& parameters);
                     static void handle_method_not_allowed(const route& route, web::http::http_response& res, const utility::string_t& route_path, const route_parameters& parameters);
                     static route_parameters get_parameters(const utility::named_sub_matches_t& parameter_sub_matches, const utility::smatch_t& route_match);
+                    static route_parameters get_parameters(const utility::named_sub_matches_t& parameter_sub_matches, const utility::string_t& path, const utility::simple_sub_matches_t& route_match);
                     static route_parameters insert(route_parameters&& into, const route_parameters& range);
                     static bool route_regex_match(const utility::string_t& path, utility::smatch_t& route_match, const utility::regex_t& route_regex, match_flag_type flags);
+                    static bool match_route(const route& route, const utility::string_t& path, utility::string_t& matched_path, route_parameters& parameters);
 
                     pplx::task<bool> operator()(web::http::http_request req, web::http::http_response res, const utility::string_t& route_path, const route_parameters& parameters, iterator route);
 
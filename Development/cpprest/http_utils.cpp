@@ -64,6 +64,44 @@ namespace web
             }
         }
 
+        namespace details
+        {
+            // strip the weakness indicator, "W/", from an entity-tag, leaving the opaque-tag, including the double quotes
+            inline utility::string_t opaque_tag(const utility::string_t& entity_tag)
+            {
+                return 0 == entity_tag.compare(0, 2, _XPLATSTR("W/")) ? entity_tag.substr(2) : entity_tag;
+            }
+        }
+
+        bool has_matching_entity_tag(const http_headers& headers, const utility::string_t& name, const utility::string_t& entity_tag)
+        {
+            const auto header = headers.find(name);
+            if (headers.end() == header) return false;
+
+            // If-None-Match = "*" / 1#entity-tag
+            // entity-tag = [ weak ] opaque-tag
+            // weak = %x57.2F ; "W/", case-sensitive
+            // opaque-tag = DQUOTE *etagc DQUOTE
+            // etagc = %x21 / %x23-7E / obs-text ; VCHAR except double quotes, plus obs-text
+            // note that etagc includes the comma, so the list cannot simply be split on commas
+            const auto& value = header->second;
+            const auto opaque = details::opaque_tag(entity_tag);
+            utility::string_t::size_type pos = 0;
+            while (utility::string_t::npos != (pos = value.find_first_not_of(_XPLATSTR(", \t"), pos)))
+            {
+                if (_XPLATSTR('*') == value[pos]) return true;
+
+                if (0 == value.compare(pos, 2, _XPLATSTR("W/"))) pos += 2;
+                if (value.size() <= pos || _XPLATSTR('"') != value[pos]) return false; // invalid
+                const auto last = value.find(_XPLATSTR('"'), pos + 1);
+                if (utility::string_t::npos == last) return false; // invalid
+
+                if (0 == value.compare(pos, last + 1 - pos, opaque)) return true;
+                pos = last + 1;
+            }
+            return false;
+        }
+
         void set_reply(web::http::http_response& res, web::http::status_code code)
         {
             res.set_status_code(code);
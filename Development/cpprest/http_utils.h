@@ -28,6 +28,11 @@ namespace web
             return add_header_value(headers, name, utility::conversions::details::print_string(value));
         }
 
+        // Determine if an entity-tag is found in a header that represents a set of entity-tags, like "If-None-Match", using the weak comparison function,
+        // or the header value is "*"
+        // See https://tools.ietf.org/html/rfc7232#section-2.3
+        bool has_matching_entity_tag(const http_headers& headers, const utility::string_t& name, const utility::string_t& entity_tag);
+
         // Set response fields like the equivalent http_request::reply() functions
         void set_reply(web::http::http_response& res, web::http::status_code code);
         void set_reply(web::http::http_response& res, web::http::status_code code, const concurrency::streams::istream& body, const utility::string_t& content_type = _XPLATSTR("application/octet-stream"));
@@ -116,6 +121,9 @@ namespace web
                 // RAII helper for http_listener sessions
                 typedef pplx::open_close_guard<http_listener> http_listener_guard;
 
+                // RAII helper for http_listener sessions, which are opened (and closed) concurrently
+                typedef pplx::open_close_guards<http_listener> http_listeners_guard;
+
                 // platform-specific wildcard address to accept connections for any address
 #if defined(_WIN32) && !defined(CPPREST_FORCE_HTTP_LISTENER_ASIO)
                 const utility::string_t host_wildcard{ _XPLATSTR("*") }; // "weak wildcard"
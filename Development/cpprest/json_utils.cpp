@@ -1,8 +1,19 @@
 #include "cpprest/json_utils.h"
 
+#include <algorithm>
+#include <array>
+#include <cstdint>
+#include <cstdio>
+#include <cstring>
+#include <iterator>
+#include <limits>
 #include <list>
+#include <locale>
+#include <sstream>
+#include <type_traits>
 #include <boost/algorithm/string/find.hpp>
 #include <boost/algorithm/string/predicate.hpp>
+#include <boost/algorithm/string/split.hpp>
 #include "cpprest/base_uri.h" // for web::uri::decode
 #include "cpprest/regex_utils.h"
 #include "detail/private_access.h"
@@ -24,6 +35,676 @@ namespace web
                 // having inserted a single space to ensure tokens are not coalesced
                 return bst::regex_replace(value, string_or_comment, U(" $1"));
             }
+
+            namespace details
+            {
+                // scanning UTF-8 json text a word (8 bytes) at a time, rather than a character at a time, for the long runs of unescaped characters
+                // in strings and of indentation whitespace which make up most of a large request body, cf. "Bit Twiddling Hacks", "Determine if a word has a byte less than n"
+                // see https://graphics.stanford.edu/~seander/bithacks.html#HasLessInWord
+                const uint64_t word_ones = 0x0101010101010101ULL;
+                const uint64_t word_highs = 0x8080808080808080ULL;
+
+                inline uint64_t load_word(const char* it)
+                {
+                    uint64_t word;
+                    std::memcpy(&word, it, sizeof(word));
+                    return word;
+                }
+
+                // whether any byte of the word is zero; this is exact, not just a probable match
+                inline bool has_zero_byte(uint64_t word)
+                {
+                    return 0 != ((word - word_ones) & ~word & word_highs);
+                }
+
+                // whether any byte of the word is a quotation mark, a reverse solidus or a control character, i.e. the end of a run of unescaped characters in a string
+                inline bool has_string_special_byte(uint64_t word)
+                {
+                    return has_zero_byte(word ^ (word_ones * '"'))
+                        || has_zero_byte(word ^ (word_ones * '\\'))
+                        || 0 != ((word - word_ones * 0x20) & ~word & word_highs);
+                }
+
+                // skip past the unescaped characters of a string
+                inline const char* skip_string_run(const char* it, const char* last)
+                {
+                    while (last - it >= 8 && !has_string_special_byte(load_word(it))) it += 8;
+                    while (last != it && '"' != *it && '\\' != *it && 0x20 <= (unsigned char)*it) ++it;
+                    return it;
+                }
+
+                // recursive descent parser for UTF-8 json text
+                // see https://tools.ietf.org/html/rfc8259
+                class utf8_parser
+                {
+                public:
+                    utf8_parser(const char* first, const char* last) : it(first), last(last), depth(0) {}
+
+                    web::json::value parse_text()
+                    {
+                        skip_whitespace();
+                        auto result = parse_value();
+                        skip_whitespace();
+                        if (last != it) fail("unexpected trailing characters");
+                        return result;
+                    }
+
+                private:
+                    // the same nesting limit as web::json::value::parse, to bound the recursion
+                    static const int max_depth = 128;
+
+                    void fail(const char* message) const
+                    {
+                        throw web::json::json_exception(message);
+                    }
+
+                    void skip_whitespace()
+                    {
+                        while (last != it && (' ' == *it || '\t' == *it || '\n' == *it || '\r' == *it))
+                        {
+                            ++it;
+                            // indentation comes in long runs of spaces
+                            while (last - it >= 8 && word_ones * ' ' == load_word(it)) it += 8;
+                        }
+                    }
+
+                    void expect(const char* literal)
+                    {
+                        for (; *literal; ++literal, ++it)
+                        {
+                            if (last == it || *literal != *it) fail("unexpected token");
+                        }
+                    }
+
+                    web::json::value parse_value()
+                    {
+                        if (last == it) fail("unexpected end of json text");
+                        switch (*it)
+                        {
+                        case '{': return parse_object();
+                        case '[': return parse_array();
+                        case '"': return web::json::value::string(parse_string());
+                        case 't': expect("true"); return web::json::value::boolean(true);
+                        case 'f': expect("false"); return web::json::value::boolean(false);
+                        case 'n': expect("null"); return web::json::value::null();
+                        default: return parse_number();
+                        }
+                    }
+
+                    web::json::value parse_object()
+                    {
+                        if (max_depth < ++depth) fail("json text is nested too deeply");
+                        ++it;
+                        std::vector<std::pair<utility::string_t, web::json::value>> fields;
+                        skip_whitespace();
+                        if (last != it && '}' == *it)
+                        {
+                            ++it;
+                        }
+                        else for (;;)
+                        {
+                            if (last == it || '"' != *it) fail("expected a string key");
+                            auto key = parse_string();
+                            skip_whitespace();
+                            if (last == it || ':' != *it) fail("expected ':'");
+                            ++it;
+                            skip_whitespace();
+                            fields.push_back({ std::move(key), parse_value() });
+                            skip_whitespace();
+                            if (last == it) fail("unexpected end of json text");
+                            if ('}' == *it) { ++it; break; }
+                            if (',' != *it) fail("expected ',' or '}'");
+                            ++it;
+                            skip_whitespace();
+                        }
+                        --depth;
+                        // sorted once, rather than on each insertion
+                        return web::json::value::object(std::move(fields));
+                    }
+
+                    web::json::value parse_array()
+                    {
+                        if (max_depth < ++depth) fail("json text is nested too deeply");
+                        ++it;
+                        std::vector<web::json::value> elements;
+                        skip_whitespace();
+                        if (last != it && ']' == *it)
+                        {
+                            ++it;
+                        }
+                        else for (;;)
+                        {
+                            elements.push_back(parse_value());
+                            skip_whitespace();
+                            if (last == it) fail("unexpected end of json text");
+                            if (']' == *it) { ++it; break; }
+                            if (',' != *it) fail("expected ',' or ']'");
+                            ++it;
+                            skip_whitespace();
+                        }
+                        --depth;
+                        return web::json::value::array(std::move(elements));
+                    }
+
+                    unsigned int parse_hex4()
+                    {
+                        unsigned int code = 0;
+                        for (int i = 0; i < 4; ++i, ++it)
+                        {
+                            if (last == it) fail("unexpected end of json text");
+                            const char c = *it;
+                            code <<= 4;
+                            if ('0' <= c && c <= '9') code |= c - '0';
+                            else if ('a' <= c && c <= 'f') code |= c - 'a' + 10;
+                            else if ('A' <= c && c <= 'F') code |= c - 'A' + 10;
+                            else fail("invalid \\u escape");
+                        }
+                        return code;
+                    }
+
+                    static void append_utf8(std::string& utf8, unsigned int code)
+                    {
+                        if (code < 0x80)
+                        {
+                            utf8.push_back((char)code);
+                        }
+                        else if (code < 0x800)
+                        {
+                            utf8.push_back((char)(0xC0 | (code >> 6)));
+                            utf8.push_back((char)(0x80 | (code & 0x3F)));
+                        }
+                        else if (code < 0x10000)
+                        {
+                            utf8.push_back((char)(0xE0 | (code >> 12)));
+                            utf8.push_back((char)(0x80 | ((code >> 6) & 0x3F)));
+                            utf8.push_back((char)(0x80 | (code & 0x3F)));
+                        }
+                        else
+                        {
+                            utf8.push_back((char)(0xF0 | (code >> 18)));
+                            utf8.push_back((char)(0x80 | ((code >> 12) & 0x3F)));
+                            utf8.push_back((char)(0x80 | ((code >> 6) & 0x3F)));
+                            utf8.push_back((char)(0x80 | (code & 0x3F)));
+                        }
+                    }
+
+                    utility::string_t parse_string()
+                    {
+                        ++it;
+                        std::string utf8;
+                        for (;;)
+                        {
+                            // copy runs of unescaped characters all at once
+                            const auto run = it;
+                            it = skip_string_run(it, last);
+                            utf8.append(run, it);
+
+                            if (last == it) fail("unexpected end of json text");
+                            if ('"' == *it) { ++it; break; }
+                            if ('\\' != *it) fail("unescaped control character in string");
+
+                            if (last == ++it) fail("unexpected end of json text");
+                            switch (*it++)
+                            {
+                            case '"': utf8.push_back('"'); break;
+                            case '\\': utf8.push_back('\\'); break;
+                            case '/': utf8.push_back('/'); break;
+                            case 'b': utf8.push_back('\b'); break;
+                            case 'f': utf8.push_back('\f'); break;
+                            case 'n': utf8.push_back('\n'); break;
+                            case 'r': utf8.push_back('\r'); break;
+                            case 't': utf8.push_back('\t'); break;
+                            case 'u':
+                            {
+                                auto code = parse_hex4();
+                                if (0xD800 <= code && code < 0xDC00)
+                                {
+                                    // a high surrogate must be followed by a low surrogate
+                                    if (last - it < 2 || '\\' != it[0] || 'u' != it[1]) fail("invalid surrogate pair");
+                                    it += 2;
+                                    const auto low = parse_hex4();
+                                    if (low < 0xDC00 || 0xE000 <= low) fail("invalid surrogate pair");
+                                    code = 0x10000 + ((code - 0xD800) << 10) + (low - 0xDC00);
+                                }
+                                else if (0xDC00 <= code && code < 0xE000)
+                                {
+                                    fail("invalid surrogate pair");
+                                }
+                                append_utf8(utf8, code);
+                                break;
+                            }
+                            default:
+                                fail("invalid escape in string");
+                            }
+                        }
+#ifdef _UTF16_STRINGS
+                        return utility::conversions::utf8_to_utf16(utf8);
+#else
+                        return utf8;
+#endif
+                    }
+
+                    web::json::value parse_number()
+                    {
+                        const auto first = it;
+                        const bool negative = last != it && '-' == *it;
+                        if (negative) ++it;
+
+                        // integral part, without leading zeros
+                        if (last == it || *it < '0' || '9' < *it) fail("unexpected token");
+                        uint64_t integer = 0;
+                        bool overflow = false;
+                        if ('0' == *it)
+                        {
+                            ++it;
+                        }
+                        else for (; last != it && '0' <= *it && *it <= '9'; ++it)
+                        {
+                            const uint64_t digit = *it - '0';
+                            if (integer > ((std::numeric_limits<uint64_t>::max)() - digit) / 10) overflow = true;
+                            integer = integer * 10 + digit;
+                        }
+
+                        bool is_integer = true;
+                        if (last != it && '.' == *it)
+                        {
+                            is_integer = false;
+                            ++it;
+                            if (last == it || *it < '0' || '9' < *it) fail("expected a digit");
+                            while (last != it && '0' <= *it && *it <= '9') ++it;
+                        }
+                        if (last != it && ('e' == *it || 'E' == *it))
+                        {
+                            is_integer = false;
+                            ++it;
+                            if (last != it && ('+' == *it || '-' == *it)) ++it;
+                            if (last == it || *it < '0' || '9' < *it) fail("expected a digit");
+                            while (last != it && '0' <= *it && *it <= '9') ++it;
+                        }
+
+                        // integers are represented exactly when possible, like web::json::value::parse
+                        if (is_integer && !overflow)
+                        {
+                            if (!negative) return web::json::value::number(integer);
+                            if (integer <= (uint64_t)(std::numeric_limits<int64_t>::max)() + 1) return web::json::value::number((int64_t)(0 - integer));
+                        }
+
+                        // strtod depends on the C locale for the decimal point, so use a classic stream instead
+                        std::istringstream is(std::string(first, it));
+                        is.imbue(std::locale::classic());
+                        double d;
+                        is >> d;
+                        if (is.fail()) fail("invalid number");
+                        return web::json::value::number(d);
+                    }
+
+                    const char* it;
+                    const char* last;
+                    int depth;
+                };
+            }
+
+            web::json::value parse_utf8(const char* first, const char* last)
+            {
+                return details::utf8_parser(first, last).parse_text();
+            }
+        }
+    }
+}
+
+// json serialization helpers
+namespace web
+{
+    namespace json
+    {
+        namespace experimental
+        {
+            namespace details
+            {
+                // CBOR major types
+                // see https://tools.ietf.org/html/rfc7049#section-2.1
+                enum cbor_major_type
+                {
+                    cbor_unsigned_integer = 0,
+                    cbor_negative_integer = 1,
+                    cbor_text_string = 3,
+                    cbor_array = 4,
+                    cbor_map = 5,
+                    cbor_simple_or_float = 7
+                };
+
+                inline void serialize_cbor_big_endian(std::string& cbor, uint64_t value, int bytes)
+                {
+                    for (int shift = 8 * (bytes - 1); 0 <= shift; shift -= 8)
+                    {
+                        cbor.push_back((char)(uint8_t)(value >> shift));
+                    }
+                }
+
+                // the initial byte and the shortest encoding of the argument
+                // see https://tools.ietf.org/html/rfc7049#section-2
+                inline void serialize_cbor_head(std::string& cbor, cbor_major_type major_type, uint64_t argument)
+                {
+                    const auto initial = (uint8_t)(major_type << 5);
+                    if (argument < 24)
+                    {
+                        cbor.push_back((char)(initial | argument));
+                    }
+                    else if (argument <= UINT8_MAX)
+                    {
+                        cbor.push_back((char)(initial | 24));
+                        serialize_cbor_big_endian(cbor, argument, 1);
+                    }
+                    else if (argument <= UINT16_MAX)
+                    {
+                        cbor.push_back((char)(initial | 25));
+                        serialize_cbor_big_endian(cbor, argument, 2);
+                    }
+                    else if (argument <= UINT32_MAX)
+                    {
+                        cbor.push_back((char)(initial | 26));
+                        serialize_cbor_big_endian(cbor, argument, 4);
+                    }
+                    else
+                    {
+                        cbor.push_back((char)(initial | 27));
+                        serialize_cbor_big_endian(cbor, argument, 8);
+                    }
+                }
+
+                inline void serialize_cbor_string(std::string& cbor, const utility::string_t& value)
+                {
+                    const auto utf8 = utility::conversions::to_utf8string(value);
+                    serialize_cbor_head(cbor, cbor_text_string, utf8.size());
+                    cbor.append(utf8);
+                }
+
+                inline void serialize_cbor_number(std::string& cbor, const web::json::number& value)
+                {
+                    if (value.is_int64())
+                    {
+                        const auto i = value.to_int64();
+                        if (0 <= i) serialize_cbor_head(cbor, cbor_unsigned_integer, (uint64_t)i);
+                        else serialize_cbor_head(cbor, cbor_negative_integer, (uint64_t)(-1 - i));
+                    }
+                    else if (value.is_uint64())
+                    {
+                        serialize_cbor_head(cbor, cbor_unsigned_integer, value.to_uint64());
+                    }
+                    else
+                    {
+                        const auto d = value.to_double();
+                        const auto f = (float)d;
+                        if ((double)f == d)
+                        {
+                            uint32_t bits;
+                            std::memcpy(&bits, &f, sizeof(bits));
+                            cbor.push_back((char)((cbor_simple_or_float << 5) | 26));
+                            serialize_cbor_big_endian(cbor, bits, 4);
+                        }
+                        else
+                        {
+                            uint64_t bits;
+                            std::memcpy(&bits, &d, sizeof(bits));
+                            cbor.push_back((char)((cbor_simple_or_float << 5) | 27));
+                            serialize_cbor_big_endian(cbor, bits, 8);
+                        }
+                    }
+                }
+            }
+
+            namespace details
+            {
+                // escape characters in the same way as web::json::value::serialize
+                inline void serialize_utf8_escaped(std::string& utf8, const std::string& value)
+                {
+                    static const char hex_digits[] = "0123456789abcdef";
+
+                    utf8.push_back('"');
+                    auto unescaped = value.data();
+                    const auto end = value.data() + value.size();
+                    for (auto ch = unescaped; end != ch; ++ch)
+                    {
+                        const auto uch = (unsigned char)*ch;
+                        if (uch >= 0x20 && '"' != uch && '\\' != uch) continue;
+
+                        // append the run of characters that don't need escaping in one go
+                        utf8.append(unescaped, ch);
+                        unescaped = ch + 1;
+
+                        utf8.push_back('\\');
+                        switch (uch)
+                        {
+                        case '"': utf8.push_back('"'); break;
+                        case '\\': utf8.push_back('\\'); break;
+                        case '\b': utf8.push_back('b'); break;
+                        case '\f': utf8.push_back('f'); break;
+                        case '\r': utf8.push_back('r'); break;
+                        case '\n': utf8.push_back('n'); break;
+                        case '\t': utf8.push_back('t'); break;
+                        default:
+                            // other control characters must be unicode escaped
+                            utf8.append("u00");
+                            utf8.push_back(hex_digits[(uch & 0xF0) >> 4]);
+                            utf8.push_back(hex_digits[uch & 0x0F]);
+                            break;
+                        }
+                    }
+                    utf8.append(unescaped, end);
+                    utf8.push_back('"');
+                }
+
+                inline void serialize_utf8_string(std::string& utf8, const utility::string_t& value)
+                {
+#ifdef _UTF16_STRINGS
+                    serialize_utf8_escaped(utf8, utility::conversions::to_utf8string(value));
+#else
+                    serialize_utf8_escaped(utf8, value);
+#endif
+                }
+
+                inline void serialize_utf8_integer(std::string& utf8, uint64_t value, bool negative)
+                {
+                    char digits[24];
+                    auto first = std::end(digits);
+                    do
+                    {
+                        *--first = (char)('0' + value % 10);
+                        value /= 10;
+                    } while (0 != value);
+                    if (negative) *--first = '-';
+                    utf8.append(first, std::end(digits));
+                }
+
+                inline void serialize_utf8_number(std::string& utf8, const web::json::number& value)
+                {
+                    if (value.is_int64())
+                    {
+                        const auto i = value.to_int64();
+                        // avoid overflow negating the minimum value
+                        serialize_utf8_integer(utf8, 0 <= i ? (uint64_t)i : (uint64_t)0 - (uint64_t)i, 0 > i);
+                    }
+                    else if (value.is_uint64())
+                    {
+                        serialize_utf8_integer(utf8, value.to_uint64(), false);
+                    }
+                    else
+                    {
+                        // the same format as web::json::value::serialize, in order to produce identical output
+                        char digits[std::numeric_limits<double>::digits10 + 10];
+                        const auto count = std::snprintf(digits, sizeof(digits), "%.*g", std::numeric_limits<double>::digits10 + 2, value.to_double());
+                        if (0 < count) utf8.append(digits, (std::min)((size_t)count, sizeof(digits) - 1));
+                    }
+                }
+            }
+
+            std::string serialize_utf8(const web::json::value& value)
+            {
+                std::string utf8;
+                serialize_utf8(utf8, value);
+                return utf8;
+            }
+
+            void serialize_utf8(std::string& utf8, const web::json::value& value)
+            {
+                using namespace details;
+
+                switch (value.type())
+                {
+                case web::json::value::Null:
+                    utf8.append("null");
+                    break;
+                case web::json::value::Boolean:
+                    utf8.append(value.as_bool() ? "true" : "false");
+                    break;
+                case web::json::value::Number:
+                    serialize_utf8_number(utf8, value.as_number());
+                    break;
+                case web::json::value::String:
+                    serialize_utf8_string(utf8, value.as_string());
+                    break;
+                case web::json::value::Array:
+                {
+                    utf8.push_back('[');
+                    bool empty = true;
+                    for (const auto& element : value.as_array())
+                    {
+                        if (!empty) utf8.push_back(',');
+                        empty = false;
+                        serialize_utf8(utf8, element);
+                    }
+                    utf8.push_back(']');
+                    break;
+                }
+                case web::json::value::Object:
+                {
+                    utf8.push_back('{');
+                    bool empty = true;
+                    for (const auto& field : value.as_object())
+                    {
+                        if (!empty) utf8.push_back(',');
+                        empty = false;
+                        serialize_utf8_string(utf8, field.first);
+                        utf8.push_back(':');
+                        serialize_utf8(utf8, field.second);
+                    }
+                    utf8.push_back('}');
+                    break;
+                }
+                }
+            }
+
+            namespace details
+            {
+                inline size_t serialized_utf8_string_size(const utility::string_t& value)
+                {
+                    size_t size = value.size() + 2;
+                    for (const auto ch : value)
+                    {
+                        const auto uch = (std::make_unsigned<utility::char_t>::type)ch;
+                        if (uch >= 0x20 && '"' != uch && '\\' != uch) continue;
+
+                        switch (uch)
+                        {
+                        case '"': case '\\': case '\b': case '\f': case '\r': case '\n': case '\t': size += 1; break;
+                        // other control characters are unicode escaped
+                        default: size += 5; break;
+                        }
+                    }
+                    return size;
+                }
+            }
+
+            size_t serialized_utf8_size(const web::json::value& value)
+            {
+                using namespace details;
+
+                switch (value.type())
+                {
+                case web::json::value::Null:
+                    return 4;
+                case web::json::value::Boolean:
+                    return value.as_bool() ? 4 : 5;
+                case web::json::value::Number:
+                {
+                    // numbers are short, so simply serialize them
+                    std::string utf8;
+                    serialize_utf8_number(utf8, value.as_number());
+                    return utf8.size();
+                }
+                case web::json::value::String:
+                    return serialized_utf8_string_size(value.as_string());
+                case web::json::value::Array:
+                {
+                    const auto& elements = value.as_array();
+                    size_t size = 2 + (0 != elements.size() ? elements.size() - 1 : 0);
+                    for (const auto& element : elements)
+                    {
+                        size += serialized_utf8_size(element);
+                    }
+                    return size;
+                }
+                case web::json::value::Object:
+                {
+                    const auto& fields = value.as_object();
+                    size_t size = 2 + (0 != fields.size() ? fields.size() - 1 : 0);
+                    for (const auto& field : fields)
+                    {
+                        size += serialized_utf8_string_size(field.first) + 1 + serialized_utf8_size(field.second);
+                    }
+                    return size;
+                }
+                }
+                return 0;
+            }
+
+            std::string serialize_cbor(const web::json::value& value)
+            {
+                std::string cbor;
+                serialize_cbor(cbor, value);
+                return cbor;
+            }
+
+            void serialize_cbor(std::string& cbor, const web::json::value& value)
+            {
+                using namespace details;
+
+                switch (value.type())
+                {
+                case web::json::value::Null:
+                    cbor.push_back((char)0xf6);
+                    break;
+                case web::json::value::Boolean:
+                    cbor.push_back(value.as_bool() ? (char)0xf5 : (char)0xf4);
+                    break;
+                case web::json::value::Number:
+                    serialize_cbor_number(cbor, value.as_number());
+                    break;
+                case web::json::value::String:
+                    serialize_cbor_string(cbor, value.as_string());
+                    break;
+                case web::json::value::Array:
+                    serialize_cbor_head(cbor, cbor_array, value.size());
+                    for (const auto& element : value.as_array())
+                    {
+                        serialize_cbor(cbor, element);
+                    }
+                    break;
+                case web::json::value::Object:
+                    serialize_cbor_head(cbor, cbor_map, value.size());
+                    for (const auto& field : value.as_object())
+                    {
+                        serialize_cbor_string(cbor, field.first);
+                        serialize_cbor(cbor, field.second);
+                    }
+                    break;
+                }
+            }
+
+            void serialize_cbor_array_header(std::string& cbor, size_t size)
+            {
+                details::serialize_cbor_head(cbor, details::cbor_array, size);
+            }
         }
     }
 }
@@ -75,17 +756,23 @@ namespace web
         // returns true if the value has at least one field matching the key path
         // if any arrays are encountered on the key path, results is an array, otherwise it's a non-array value
         bool extract(const web::json::object& object, web::json::value& results, const utility::string_t& key_path)
+        {
+            std::vector<utility::string_t> keys;
+            boost::algorithm::split(keys, key_path, [](utility::char_t c) { return _XPLATSTR('.') == c; });
+            return extract(object, results, keys);
+        }
+
+        // find the value of a field or fields from the specified object, as above, when the key path has already been split into its keys
+        bool extract(const web::json::object& object, web::json::value& results, const std::vector<utility::string_t>& key_path)
         {
             bool match = false;
             results = web::json::value::null();
 
             std::list<const web::json::object*> pobjects(1, &object);
-            utility::string_t::size_type key_first = 0;
-            do
+            for (auto key_it = key_path.begin(); key_path.end() != key_it; ++key_it)
             {
-                const utility::string_t::size_type key_last = key_path.find_first_of(_XPLATSTR("."), key_first);
-                const utility::string_t key = key_path.substr(key_first, details::count(key_first, key_last));
-                if (utility::string_t::npos != key_last)
+                const utility::string_t& key = *key_it;
+                if (key_path.end() != std::next(key_it))
                 {
                     // not the leaf key, so map each object to the specified field, searching arrays and filtering out other types
                     for (auto it = pobjects.begin(); pobjects.end() != it; it = pobjects.erase(it))
@@ -154,8 +841,7 @@ namespace web
                         }
                     }
                 }
-                key_first = utility::string_t::npos != key_last ? key_last + 1 : key_last;
-            } while (utility::string_t::npos != key_first);
+            }
 
             return match;
         }
@@ -277,6 +963,183 @@ namespace web
             }
         }
 
+        namespace details
+        {
+            // the query/exemplar is flattened into a vector of terms, with the fields of each object term held contiguously
+            // in a vector of (key, term index) pairs
+            struct compiled_match_query_impl
+            {
+                struct term
+                {
+                    web::json::value::value_type type;
+                    // for an object, the range of its fields
+                    size_t first_field;
+                    size_t last_field;
+                    // for a string, the pattern, already case-folded for a case-insensitive match
+                    utility::string_t pattern;
+                    // for a string that is also serialized json, the parsed query, used when the value is of another type
+                    size_t parsed;
+                    // for any other type, the value itself
+                    web::json::value constant;
+                };
+
+                static const size_t npos = size_t(-1);
+
+                compiled_match_query_impl(const web::json::value& query, match_flag_type match_flags)
+                    : substr(0 != (match_substr & match_flags))
+                    , icase(0 != (match_icase & match_flags))
+                    , ctype(std::use_facet<std::ctype<utility::char_t>>(locale))
+                {
+                    if (icase)
+                    {
+                        for (size_t ch = 0; ch < folded.size(); ++ch) folded[ch] = ctype.toupper((utility::char_t)ch);
+                    }
+                    compile(query);
+                }
+
+                // compile the specified query, returning the index of its term
+                size_t compile(const web::json::value& query)
+                {
+                    const size_t index = terms.size();
+                    terms.push_back({ query.type(), 0, 0, {}, npos, {} });
+
+                    if (query.is_object())
+                    {
+                        // compile the sub-queries first so that this object's fields are contiguous
+                        std::vector<std::pair<utility::string_t, size_t>> object_fields;
+                        for (auto& query_field : query.as_object())
+                        {
+                            object_fields.push_back({ query_field.first, compile(query_field.second) });
+                        }
+                        terms[index].first_field = fields.size();
+                        fields.insert(fields.end(), object_fields.begin(), object_fields.end());
+                        terms[index].last_field = fields.size();
+                    }
+                    else if (query.is_string())
+                    {
+                        auto pattern = query.as_string();
+                        if (icase) std::transform(pattern.begin(), pattern.end(), pattern.begin(), [this](utility::char_t ch) { return fold(ch); });
+                        terms[index].pattern = std::move(pattern);
+
+                        // see match_query, this is the last resort when the value is of another type
+                        std::error_code ec;
+                        const auto parsed_query = web::json::value::parse(query.as_string(), ec);
+                        if (!ec)
+                        {
+                            const auto parsed = compile(parsed_query);
+                            terms[index].parsed = parsed;
+                        }
+                    }
+                    else
+                    {
+                        terms[index].constant = query;
+                    }
+
+                    return index;
+                }
+
+                bool match(const web::json::value& value, size_t index) const
+                {
+                    if (value.is_array())
+                    {
+                        // one of the value's elements must match the query
+                        for (auto& element : value.as_array())
+                        {
+                            if (match(element, index))
+                            {
+                                return true;
+                            }
+                        }
+                        return false;
+                    }
+
+                    const auto& query = terms[index];
+                    if (value.is_object() && web::json::value::Object == query.type)
+                    {
+                        // value must have fields matching all of the query fields, but other value fields are ignored
+                        const auto& object = value.as_object();
+                        for (auto field = fields.begin() + query.first_field, last = fields.begin() + query.last_field; last != field; ++field)
+                        {
+                            const auto found = object.find(field->first);
+                            if (object.end() == found || !match(found->second, field->second))
+                            {
+                                return false;
+                            }
+                        }
+                        return true;
+                    }
+                    else if (value.type() == query.type)
+                    {
+                        return web::json::value::String == query.type
+                            ? match_string(value.as_string(), query.pattern)
+                            // value must be an exact match
+                            : value == query.constant;
+                    }
+                    else if (web::json::value::String == query.type)
+                    {
+                        return npos != query.parsed && match(value, query.parsed);
+                    }
+                    else
+                    {
+                        return false;
+                    }
+                }
+
+                // equivalent to the boost::algorithm functions used by match_query, including that an empty pattern is never found as a substring
+                bool match_string(const utility::string_t& value, const utility::string_t& pattern) const
+                {
+                    if (substr)
+                    {
+                        // value must contain the query as a substring (optionally case-insensitive)
+                        if (pattern.empty()) return false;
+                        return icase
+                            ? value.end() != std::search(value.begin(), value.end(), pattern.begin(), pattern.end(), [this](utility::char_t v, utility::char_t p) { return fold(v) == p; })
+                            : utility::string_t::npos != value.find(pattern);
+                    }
+                    else
+                    {
+                        // value must be an exact match (optionally case-insensitive)
+                        return icase
+                            ? value.size() == pattern.size() && std::equal(value.begin(), value.end(), pattern.begin(), [this](utility::char_t v, utility::char_t p) { return fold(v) == p; })
+                            : value == pattern;
+                    }
+                }
+
+                const bool substr;
+                const bool icase;
+                // the same case-folding as boost::algorithm::is_iequal with the default global locale
+                const std::locale locale;
+                const std::ctype<utility::char_t>& ctype;
+                // the case-folding of the first 256 characters, looked up rather than making a virtual call to the facet for every character
+                // compared, since e.g. searching the labels of all the resources for a short pattern compares many characters
+                std::array<utility::char_t, 256> folded;
+
+                utility::char_t fold(utility::char_t ch) const
+                {
+                    typedef std::make_unsigned<utility::char_t>::type unsigned_char_t;
+                    const auto uch = (unsigned_char_t)ch;
+                    return uch < folded.size() ? folded[uch] : ctype.toupper(ch);
+                }
+
+                std::vector<term> terms;
+                std::vector<std::pair<utility::string_t, size_t>> fields;
+            };
+        }
+
+        compiled_match_query::compiled_match_query()
+        {
+        }
+
+        compiled_match_query::compiled_match_query(const web::json::value& query, match_flag_type match_flags)
+            : impl(std::make_shared<details::compiled_match_query_impl>(query, match_flags))
+        {
+        }
+
+        compiled_match_query::result_type compiled_match_query::operator()(argument_type value) const
+        {
+            return !impl || impl->match(value, 0);
+        }
+
         // merge source into target value
         void merge_patch(web::json::value& value, const web::json::value& patch, bool permissive)
         {
@@ -360,6 +1223,91 @@ namespace web
             }
         }
 
+        namespace experimental
+        {
+            namespace details
+            {
+                // escape a reference token of a JSON Pointer
+                // see https://tools.ietf.org/html/rfc6901#section-3
+                static utility::string_t escape_pointer_token(const utility::string_t& token)
+                {
+                    utility::string_t result;
+                    result.reserve(token.size());
+                    for (auto c : token)
+                    {
+                        if (_XPLATSTR('~') == c) result.append(_XPLATSTR("~0"));
+                        else if (_XPLATSTR('/') == c) result.append(_XPLATSTR("~1"));
+                        else result.push_back(c);
+                    }
+                    return result;
+                }
+
+                static value make_patch_operation(const utility::string_t& op, const utility::string_t& path)
+                {
+                    // seems worthwhile to keep_order for simple visualisation
+                    value operation = value::object(true);
+                    operation[_XPLATSTR("op")] = value::string(op);
+                    operation[_XPLATSTR("path")] = value::string(path);
+                    return operation;
+                }
+
+                static void make_patch(web::json::details::array_storage_t& patch, const utility::string_t& path, const value& source, const value& target)
+                {
+                    if (source.is_object() && target.is_object())
+                    {
+                        const auto& so = source.as_object();
+                        const auto& to = target.as_object();
+                        for (const auto& field : so)
+                        {
+                            if (to.end() == to.find(field.first))
+                            {
+                                patch.push_back(make_patch_operation(_XPLATSTR("remove"), path + _XPLATSTR('/') + escape_pointer_token(field.first)));
+                            }
+                        }
+                        for (const auto& field : to)
+                        {
+                            const auto found = so.find(field.first);
+                            if (so.end() == found)
+                            {
+                                auto operation = make_patch_operation(_XPLATSTR("add"), path + _XPLATSTR('/') + escape_pointer_token(field.first));
+                                operation[_XPLATSTR("value")] = field.second;
+                                patch.push_back(std::move(operation));
+                            }
+                            else if (found->second != field.second)
+                            {
+                                make_patch(patch, path + _XPLATSTR('/') + escape_pointer_token(field.first), found->second, field.second);
+                            }
+                        }
+                    }
+                    else if (source.is_array() && target.is_array() && source.size() == target.size())
+                    {
+                        // arrays of different sizes are simply replaced, rather than finding the minimal sequence of insertions and removals
+                        for (size_t index = 0; index < source.size(); ++index)
+                        {
+                            if (source.at(index) != target.at(index))
+                            {
+                                make_patch(patch, path + _XPLATSTR('/') + utility::conversions::details::print_string(index), source.at(index), target.at(index));
+                            }
+                        }
+                    }
+                    else
+                    {
+                        auto operation = make_patch_operation(_XPLATSTR("replace"), path);
+                        operation[_XPLATSTR("value")] = target;
+                        patch.push_back(std::move(operation));
+                    }
+                }
+            }
+
+            // construct an RFC 6902 JSON Patch, i.e. an array of "add", "remove" and "replace" operations, which transforms the source value into the target value
+            web::json::value make_patch(const web::json::value& source, const web::json::value& target)
+            {
+                value patch = value::array();
+                if (source != target) details::make_patch(storage_of(patch.as_array()), {}, source, target);
+                return patch;
+            }
+        }
+
         namespace details
         {
             struct array_elements { typedef details::array_storage_t(array::*type); };
@@ -377,6 +1325,39 @@ namespace web
         {
             return object.*detail::stowed<details::object_elements>::value;
         }
+
+        // release the unused capacity of the storage of the specified value and any nested objects and arrays, and of their keys and strings
+        void shrink_to_fit(web::json::value& value)
+        {
+            if (value.is_object())
+            {
+                auto& storage = storage_of(value.as_object());
+                storage.shrink_to_fit();
+                for (auto& field : storage)
+                {
+                    field.first.shrink_to_fit();
+                    shrink_to_fit(field.second);
+                }
+            }
+            else if (value.is_array())
+            {
+                auto& storage = storage_of(value.as_array());
+                storage.shrink_to_fit();
+                for (auto& element : storage)
+                {
+                    shrink_to_fit(element);
+                }
+            }
+            else if (value.is_string())
+            {
+                // string values are immutable, so only replace those that have excess capacity
+                const auto& string = value.as_string();
+                if (string.capacity() > string.size() && string.capacity() > utility::string_t().capacity())
+                {
+                    value = web::json::value::string(utility::string_t(string.begin(), string.end()));
+                }
+            }
+        }
     }
 }
 
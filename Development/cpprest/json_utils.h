@@ -1,6 +1,10 @@
 #ifndef CPPREST_JSON_UTILS_H
 #define CPPREST_JSON_UTILS_H
 
+#include <atomic>
+#include <cstddef>
+#include <memory>
+#include <vector>
 #include "cpprest/json.h"
 
 // since some of the constructors are explicit, provide helpers
@@ -107,13 +111,49 @@ namespace web
             return details::value_as<T>{}(value);
         }
 
+        namespace details
+        {
+            // the position at which a field accessor last found its key; since the objects accessed by each accessor usually have
+            // the same shape (e.g. resources of one type), the key is very often at the same position of the next object too,
+            // which saves the search of the object (binary, or linear if keep_order was specified)
+            // note, the hint is shared between threads, but is only ever a hint, so relaxed loads and stores are sufficient
+            struct field_position
+            {
+                field_position() : index(0) {}
+                field_position(const field_position& other) : index(other.index.load(std::memory_order_relaxed)) {}
+                field_position& operator=(const field_position& other) { index.store(other.index.load(std::memory_order_relaxed), std::memory_order_relaxed); return *this; }
+
+                mutable std::atomic<std::size_t> index;
+            };
+
+            // find the field with the specified key in the object (const or non-const), trying the hinted position first
+            template <typename Object>
+            inline auto find_field(Object& object, const utility::string_t& key, const field_position& hint) -> decltype(object.find(key))
+            {
+                const auto index = hint.index.load(std::memory_order_relaxed);
+                if (index < object.size())
+                {
+                    const auto it = object.begin() + index;
+                    if (it->first == key) return it;
+                }
+                const auto it = object.find(key);
+                if (object.end() != it) hint.index.store(std::size_t(it - object.begin()), std::memory_order_relaxed);
+                return it;
+            }
+        }
+
         template <typename T> struct field
         {
             utility::string_t key;
+            details::field_position position;
             operator const utility::string_t&() const { return key; }
             template <typename V> auto operator()(V& value) const -> decltype(as<T>(value))
             {
-                return as<T>(value.at(key));
+                // equivalent to value.at(key), including the exceptions
+                auto& object = value.as_object();
+                const auto it = details::find_field(object, key, position);
+                if (object.end() == it) throw web::json::json_exception("Key not found");
+                return as<T>(it->second);
             }
         };
 
@@ -142,11 +182,12 @@ namespace web
         {
             utility::string_t key;
             T default_value;
+            details::field_position position;
             operator const utility::string_t&() const { return key; }
             auto operator()(const web::json::value& value) const -> decltype(as<T>(value))
             {
                 web::json::object::const_iterator it;
-                return value.is_object() && value.as_object().end() != (it = value.as_object().find(key)) ? as<T>(it->second) : default_value;
+                return value.is_object() && value.as_object().end() != (it = details::find_field(value.as_object(), key, position)) ? as<T>(it->second) : default_value;
             }
         };
 
@@ -312,6 +353,10 @@ namespace web
 
         // take care, but sometimes the limited interface just isn't enough
         details::object_storage_t& storage_of(web::json::object& object);
+
+        // release the unused capacity of the storage of the specified value and any nested objects and arrays, and of their keys and strings
+        // e.g. to reduce the memory used by values that are held for a long time, since parsing and insertion both grow by doubling
+        void shrink_to_fit(web::json::value& value);
     }
 }
 
@@ -387,6 +432,70 @@ namespace web
         {
             // preprocess a json-like string to remove C++/JavaScript-style comments
             utility::string_t preprocess(const utility::string_t& value);
+
+            // parse UTF-8 json text, equivalent to web::json::value::parse(utility::conversions::to_string_t(utf8)), but in a single pass without the intermediate strings
+            // throws web::json::json_exception if the text is not valid json
+            web::json::value parse_utf8(const char* first, const char* last);
+
+            inline web::json::value parse_utf8(const std::string& utf8)
+            {
+                return parse_utf8(utf8.data(), utf8.data() + utf8.size());
+            }
+        }
+    }
+}
+
+// json serialization helpers
+namespace web
+{
+    namespace json
+    {
+        namespace experimental
+        {
+            // serialize a json value in the Concise Binary Object Representation, as a more compact and cheaper alternative to json text
+            // integers are encoded as CBOR integers, and other numbers as single-precision floats if that is exact, or double-precision otherwise
+            // see https://tools.ietf.org/html/rfc7049
+            std::string serialize_cbor(const web::json::value& value);
+
+            // append the CBOR serialization of a json value
+            void serialize_cbor(std::string& cbor, const web::json::value& value);
+
+            // append the CBOR header of an array with the specified number of elements, e.g. to concatenate elements serialized separately
+            void serialize_cbor_array_header(std::string& cbor, size_t size);
+
+            // serialize a json value as UTF-8 json text, identical to utility::conversions::to_utf8string(value.serialize()), but without the intermediate strings
+            std::string serialize_utf8(const web::json::value& value);
+
+            // append the UTF-8 json text serialization of a json value, e.g. to a buffer which is cleared and reused for each message
+            void serialize_utf8(std::string& utf8, const web::json::value& value);
+
+            // calculate the size in bytes of the UTF-8 json text serialization of a json value, without serializing it, e.g. to limit the size of a message
+            // (exact except with UTF-16 strings, when non-ASCII characters are counted as a single byte)
+            size_t serialized_utf8_size(const web::json::value& value);
+
+            // filter, transform and append the UTF-8 json text serialization of a forward range of json values as an array, cf. web::json::serialize_if
+            template <typename ForwardRange, typename Pred, typename Transform>
+            inline void serialize_utf8_if(std::string& utf8, const ForwardRange& range, Pred pred, Transform transform)
+            {
+                utf8.push_back('[');
+                bool empty = true;
+                for (auto& element : range)
+                {
+                    if (pred(element))
+                    {
+                        if (!empty)
+                        {
+                            utf8.push_back(',');
+                        }
+                        else
+                        {
+                            empty = false;
+                        }
+                        serialize_utf8(utf8, transform(element));
+                    }
+                }
+                utf8.push_back(']');
+            }
         }
     }
 }
@@ -405,6 +514,9 @@ namespace web
         // if any arrays are encountered on the key path, results is an array, otherwise it's a non-array value
         bool extract(const web::json::object& object, web::json::value& results, const utility::string_t& key_path);
 
+        // find the value of a field or fields from the specified object, as above, when the key path has already been split into its keys
+        bool extract(const web::json::object& object, web::json::value& results, const std::vector<utility::string_t>& key_path);
+
         // match_flag_type is a bitmask
         enum match_flag_type
         {
@@ -431,8 +543,40 @@ namespace web
         // compare a value against a query/exemplar
         bool match_query(const web::json::value& value, const web::json::value& query, match_flag_type match_flags = match_default);
 
+        namespace details
+        {
+            struct compiled_match_query_impl;
+        }
+
+        // a query/exemplar compiled once, to be compared against many values, with the same result as match_query,
+        // but with the sub-objects already walked, string patterns already case-folded where necessary, and any query strings
+        // that are serialized json already parsed, rather than repeating all that for every value
+        // a default-constructed compiled_match_query matches every value
+        class compiled_match_query
+        {
+        public:
+            typedef const web::json::value& argument_type;
+            typedef bool result_type;
+
+            compiled_match_query();
+            explicit compiled_match_query(const web::json::value& query, match_flag_type match_flags = match_default);
+
+            result_type operator()(argument_type value) const;
+
+        private:
+            std::shared_ptr<const details::compiled_match_query_impl> impl;
+        };
+
         // merge source into target value
         void merge_patch(web::json::value& value, const web::json::value& patch, bool permissive = false);
+
+        namespace experimental
+        {
+            // construct an RFC 6902 JSON Patch, i.e. an array of "add", "remove" and "replace" operations, which transforms the source value into the target value
+            // object fields are compared recursively, as are the elements of arrays of the same size, but an array whose size has changed is replaced entirely
+            // see https://tools.ietf.org/html/rfc6902
+            web::json::value make_patch(const web::json::value& source, const web::json::value& target);
+        }
     }
 }
 
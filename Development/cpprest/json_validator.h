@@ -21,6 +21,7 @@ namespace web
             {
             public:
                 // initialize for the specified base URIs using the specified loader
+                // the schema for each base URI is loaded and compiled when it is first used to validate an instance
                 explicit json_validator(std::function<web::json::value(const web::uri&)> load_schema, const std::vector<web::uri>& ids = {});
 
                 // validate the specified instance with the schema identified by the specified base URI
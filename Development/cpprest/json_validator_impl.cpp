@@ -3,12 +3,24 @@
 #include "bst/regex.h"
 #include "cpprest/basic_utils.h"
 #include "cpprest/json.h"
+#include <mutex>
+#include <set>
+#ifdef CPPREST_JSON_VALIDATOR_NLOHMANN
 // use of nlohmann/json and pboettch/json-schema-validator should be an implementation detail, i.e. not in a public header file
 #include "detail/pragma_warnings.h"
 PRAGMA_WARNING_PUSH
 PRAGMA_WARNING_DISABLE_CONDITIONAL_EXPRESSION_IS_CONSTANT
 #include "nlohmann/json-schema.hpp"
 PRAGMA_WARNING_POP
+#else
+#include <algorithm>
+#include <cmath>
+#include <iterator>
+#include <limits>
+#include <list>
+#include <map>
+#include <string>
+#endif
 
 namespace web
 {
@@ -18,111 +30,563 @@ namespace web
         {
             namespace details
             {
+                typedef bst::basic_regex<utility::char_t> regex_t;
+
                 // see https://stackoverflow.com/a/3824105
-                static const bst::regex ipv4_regex(R"((([0-9]|[1-9][0-9]|1[0-9]{2}|2[0-4][0-9]|25[0-5])\.){3}([0-9]|[1-9][0-9]|1[0-9]{2}|2[0-4][0-9]|25[0-5]))");
+                static const regex_t ipv4_regex(_XPLATSTR(R"((([0-9]|[1-9][0-9]|1[0-9]{2}|2[0-4][0-9]|25[0-5])\.){3}([0-9]|[1-9][0-9]|1[0-9]{2}|2[0-4][0-9]|25[0-5]))"));
                 // see https://stackoverflow.com/a/17871737
-                static const bst::regex ipv6_regex(R"((([0-9a-fA-F]{1,4}:){7,7}[0-9a-fA-F]{1,4}|([0-9a-fA-F]{1,4}:){1,7}:|([0-9a-fA-F]{1,4}:){1,6}:[0-9a-fA-F]{1,4}|([0-9a-fA-F]{1,4}:){1,5}(:[0-9a-fA-F]{1,4}){1,2}|([0-9a-fA-F]{1,4}:){1,4}(:[0-9a-fA-F]{1,4}){1,3}|([0-9a-fA-F]{1,4}:){1,3}(:[0-9a-fA-F]{1,4}){1,4}|([0-9a-fA-F]{1,4}:){1,2}(:[0-9a-fA-F]{1,4}){1,5}|[0-9a-fA-F]{1,4}:((:[0-9a-fA-F]{1,4}){1,6})|:((:[0-9a-fA-F]{1,4}){1,7}|:)|fe80:(:[0-9a-fA-F]{0,4}){0,4}%[0-9a-zA-Z]{1,}|::(ffff(:0{1,4}){0,1}:){0,1}((25[0-5]|(2[0-4]|1{0,1}[0-9]){0,1}[0-9])\.){3,3}(25[0-5]|(2[0-4]|1{0,1}[0-9]){0,1}[0-9])|([0-9a-fA-F]{1,4}:){1,4}:((25[0-5]|(2[0-4]|1{0,1}[0-9]){0,1}[0-9])\.){3,3}(25[0-5]|(2[0-4]|1{0,1}[0-9]){0,1}[0-9])))");
+                static const regex_t ipv6_regex(_XPLATSTR(R"((([0-9a-fA-F]{1,4}:){7,7}[0-9a-fA-F]{1,4}|([0-9a-fA-F]{1,4}:){1,7}:|([0-9a-fA-F]{1,4}:){1,6}:[0-9a-fA-F]{1,4}|([0-9a-fA-F]{1,4}:){1,5}(:[0-9a-fA-F]{1,4}){1,2}|([0-9a-fA-F]{1,4}:){1,4}(:[0-9a-fA-F]{1,4}){1,3}|([0-9a-fA-F]{1,4}:){1,3}(:[0-9a-fA-F]{1,4}){1,4}|([0-9a-fA-F]{1,4}:){1,2}(:[0-9a-fA-F]{1,4}){1,5}|[0-9a-fA-F]{1,4}:((:[0-9a-fA-F]{1,4}){1,6})|:((:[0-9a-fA-F]{1,4}){1,7}|:)|fe80:(:[0-9a-fA-F]{0,4}){0,4}%[0-9a-zA-Z]{1,}|::(ffff(:0{1,4}){0,1}:){0,1}((25[0-5]|(2[0-4]|1{0,1}[0-9]){0,1}[0-9])\.){3,3}(25[0-5]|(2[0-4]|1{0,1}[0-9]){0,1}[0-9])|([0-9a-fA-F]{1,4}:){1,4}:((25[0-5]|(2[0-4]|1{0,1}[0-9]){0,1}[0-9])\.){3,3}(25[0-5]|(2[0-4]|1{0,1}[0-9]){0,1}[0-9])))"));
 #ifdef JSON_VALIDATOR_CHECK_HOSTNAME
                 // see https://stackoverflow.com/a/106223
-                static const bst::regex hostname_regex(R"(([a-zA-Z0-9]|[a-zA-Z0-9][a-zA-Z0-9\-]{0,61}[a-zA-Z0-9])(\.([a-zA-Z0-9]|[a-zA-Z0-9][a-zA-Z0-9\-]{0,61}[a-zA-Z0-9]))*)");
+                static const regex_t hostname_regex(_XPLATSTR(R"(([a-zA-Z0-9]|[a-zA-Z0-9][a-zA-Z0-9\-]{0,61}[a-zA-Z0-9])(\.([a-zA-Z0-9]|[a-zA-Z0-9][a-zA-Z0-9\-]{0,61}[a-zA-Z0-9]))*)"));
 #endif
 
-                // string format checking function for use with pboettch/json_schema_validator
-                // with some of the defined formats in the JSON Schema specification (draft 4)
+                // string format checking function for some of the defined formats in the JSON Schema specification (draft 4)
+                // returning an empty string if the value is valid, or a description of the problem otherwise
                 // see https://tools.ietf.org/html/draft-fge-json-schema-validation-00#section-7
-                void check_format(const std::string& format, const std::string& value)
+                static utility::string_t check_format(const utility::string_t& format, const utility::string_t& value)
                 {
-                    if (format == "uri")
+                    if (format == _XPLATSTR("uri"))
                     {
-                        if (!web::uri::validate(utility::s2us(value)))
-                            throw std::invalid_argument(value + " is not a valid uri");
+                        if (!web::uri::validate(value))
+                            return value + _XPLATSTR(" is not a valid uri");
                     }
-                    else if (format == "ipv4")
+                    else if (format == _XPLATSTR("ipv4"))
                     {
                         if (!bst::regex_match(value, ipv4_regex))
-                            throw std::invalid_argument(value + " is not a valid ipv4");
+                            return value + _XPLATSTR(" is not a valid ipv4");
                     }
-                    else if (format == "ipv6")
+                    else if (format == _XPLATSTR("ipv6"))
                     {
                         if (!bst::regex_match(value, ipv6_regex))
-                            throw std::invalid_argument(value + " is not a valid ipv6");
+                            return value + _XPLATSTR(" is not a valid ipv6");
                     }
 #ifdef JSON_VALIDATOR_CHECK_HOSTNAME
                     // validation of hostnames is disabled due to the unfortunate lack of consistency
                     // between implementations and the bewildering number of possibly relevant RFCs
                     // see https://github.com/sony/nmos-cpp/issues/11
-                    else if (format == "hostname")
+                    else if (format == _XPLATSTR("hostname"))
                     {
                         if (!bst::regex_match(value, hostname_regex))
-                            throw std::invalid_argument(value + " is not a valid hostname");
+                            return value + _XPLATSTR(" is not a valid hostname");
                     }
 #endif
-                    else if (format == "date-time")
+                    else if (format == _XPLATSTR("date-time"))
                     {
-                        if (utility::datetime() == utility::datetime::from_string(utility::s2us(value), utility::datetime::ISO_8601))
-                            throw std::invalid_argument(value + " is not a valid date-time");
+                        if (utility::datetime() == utility::datetime::from_string(value, utility::datetime::ISO_8601))
+                            return value + _XPLATSTR(" is not a valid date-time");
                     }
-                    else if (format == "regex")
+                    else if (format == _XPLATSTR("regex"))
                     {
                         try
                         {
-                            bst::regex re(value, bst::regex::ECMAScript);
+                            regex_t re(value, bst::regex_constants::ECMAScript);
                         }
                         catch (const bst::regex_error& e)
                         {
-                            throw std::invalid_argument(value + " is not a valid regex: " + e.what());
+                            return value + _XPLATSTR(" is not a valid regex: ") + utility::s2us(e.what());
+                        }
+                    }
+                    return{};
+                }
+
+#ifdef CPPREST_JSON_VALIDATOR_NLOHMANN
+                // string format checking function for use with pboettch/json_schema_validator
+                static void nlohmann_check_format(const std::string& format, const std::string& value)
+                {
+                    const auto problem = check_format(utility::s2us(format), utility::s2us(value));
+                    if (!problem.empty()) throw std::invalid_argument(utility::us2s(problem));
+                }
+
+                // convert the specified instance directly, rather than by serializing and parsing it
+                static nlohmann::json to_nlohmann_json(const web::json::value& value)
+                {
+                    switch (value.type())
+                    {
+                    case web::json::value::Boolean:
+                        return value.as_bool();
+                    case web::json::value::Number:
+                    {
+                        const auto& number = value.as_number();
+                        if (number.is_int64()) return number.to_int64();
+                        if (number.is_uint64()) return number.to_uint64();
+                        return number.to_double();
+                    }
+                    case web::json::value::String:
+                        return utility::us2s(value.as_string());
+                    case web::json::value::Array:
+                    {
+                        auto result = nlohmann::json::array();
+                        for (const auto& element : value.as_array())
+                        {
+                            result.push_back(to_nlohmann_json(element));
+                        }
+                        return result;
+                    }
+                    case web::json::value::Object:
+                    {
+                        auto result = nlohmann::json::object();
+                        for (const auto& field : value.as_object())
+                        {
+                            result[utility::us2s(field.first)] = to_nlohmann_json(field.second);
                         }
+                        return result;
+                    }
+                    default:
+                        return nullptr;
                     }
                 }
 
                 // json validator implementation that uses pboettch/json_schema_validator
+                // the schemas are compiled once, on first use, and validation does not modify the validators,
+                // so validate may be called concurrently
                 class json_validator_impl
                 {
                 public:
                     json_validator_impl(std::function<web::json::value(const web::uri&)> load_schema, const std::vector<web::uri>& ids)
+                        : load_schema(load_schema)
+                        , ids(ids.begin(), ids.end())
                     {
-                        for (const auto& id : ids)
+                    }
+
+                    void validate(const web::json::value& value, const web::uri& id)
+                    {
+                        auto validator = find_validator(id);
+
+                        struct error_handler : nlohmann::json_schema::error_handler
                         {
-                            nlohmann::json_schema::json_validator validator
+                            virtual void error(const nlohmann::json::json_pointer& ptr, const nlohmann::json& instance, const std::string& message)
                             {
-                                [load_schema](const nlohmann::json_uri& id_impl, nlohmann::json& value_impl)
-                                {
-                                    const auto id = web::uri(utility::s2us(id_impl.url()));
-                                    const auto value = load_schema(id);
-                                    value_impl = nlohmann::json::parse(utility::us2s(value.serialize()));
-                                },
-                                check_format
-                            };
+                                throw web::json::json_exception("schema validation failed at " + (nlohmann::json::json_pointer() == ptr ? "root" : ptr.to_string()) + " - " + message);
+                            }
+                        } error_handler;
+
+                        try
+                        {
+                            const auto instance = to_nlohmann_json(value);
+                            validator->second.validate(instance, error_handler);
+                        }
+                        catch (const web::json::json_exception&)
+                        {
+                            throw;
+                        }
+                        catch (const std::exception& e)
+                        {
+                            throw web::json::json_exception(e.what());
+                        }
+                    }
+
+                private:
+                    // find the validator for the specified base URI, which is only constructed on first use, since each loads and compiles the schemas
+                    std::map<web::uri, nlohmann::json_schema::json_validator>::const_iterator find_validator(const web::uri& id)
+                    {
+                        std::lock_guard<std::mutex> lock(mutex);
+
+                        auto validator = validators.find(id);
+                        if (validators.end() != validator) return validator;
+
+                        if (ids.end() == ids.find(id))
+                        {
+                            throw web::json::json_exception("schema not found for " + utility::us2s(id.to_string()));
+                        }
 
-                            validator.set_root_schema(
+                        const auto load_schema = this->load_schema;
+                        nlohmann::json_schema::json_validator created
+                        {
+                            [load_schema](const nlohmann::json_uri& id_impl, nlohmann::json& value_impl)
                             {
-                                { "$ref", utility::us2s(id.to_string()) }
-                            });
+                                const auto id = web::uri(utility::s2us(id_impl.url()));
+                                const auto value = load_schema(id);
+                                value_impl = nlohmann::json::parse(utility::us2s(value.serialize()));
+                            },
+                            nlohmann_check_format
+                        };
+
+                        created.set_root_schema(
+                        {
+                            { "$ref", utility::us2s(id.to_string()) }
+                        });
+
+                        return validators.insert(std::make_pair(id, std::move(created))).first;
+                    }
+
+                    std::function<web::json::value(const web::uri&)> load_schema;
+                    const std::set<web::uri> ids;
+
+                    // the mutex protects the validators, but not validation, since std::map iterators are stable
+                    std::mutex mutex;
+                    std::map<web::uri, nlohmann::json_schema::json_validator> validators;
+                };
+#else
+                // a compiled JSON Schema (draft 4), which is applied directly to web::json::value instances
+                // see https://tools.ietf.org/html/draft-fge-json-schema-validation-00
+                struct schema_node
+                {
+                    enum type_flags
+                    {
+                        null_type = 1 << 0,
+                        boolean_type = 1 << 1,
+                        integer_type = 1 << 2,
+                        number_type = 1 << 3,
+                        string_type = 1 << 4,
+                        array_type = 1 << 5,
+                        object_type = 1 << 6,
+                        any_type = (1 << 7) - 1
+                    };
+
+                    schema_node()
+                        : ref(nullptr)
+                        , types(any_type)
+                        , has_enum(false)
+                        , not_(nullptr)
+                        , additional_properties_allowed(true)
+                        , additional_properties(nullptr)
+                        , min_properties(0)
+                        , max_properties((std::numeric_limits<std::size_t>::max)())
+                        , items(nullptr)
+                        , additional_items_allowed(true)
+                        , additional_items(nullptr)
+                        , min_items(0)
+                        , max_items((std::numeric_limits<std::size_t>::max)())
+                        , unique_items(false)
+                        , min_length(0)
+                        , max_length((std::numeric_limits<std::size_t>::max)())
+                        , has_pattern(false)
+                        , has_minimum(false)
+                        , minimum(0)
+                        , exclusive_minimum(false)
+                        , has_maximum(false)
+                        , maximum(0)
+                        , exclusive_maximum(false)
+                        , multiple_of(0)
+                    {}
+
+                    // "$ref", which in draft 4 means any other keywords are ignored
+                    const schema_node* ref;
+
+                    // any instance type
+                    unsigned int types;
+                    bool has_enum;
+                    web::json::value enum_values;
+                    std::vector<const schema_node*> all_of;
+                    std::vector<const schema_node*> any_of;
+                    std::vector<const schema_node*> one_of;
+                    const schema_node* not_;
+
+                    // objects
+                    std::map<utility::string_t, const schema_node*> properties;
+                    std::vector<std::pair<regex_t, const schema_node*>> pattern_properties;
+                    bool additional_properties_allowed;
+                    const schema_node* additional_properties;
+                    std::vector<utility::string_t> required;
+                    std::map<utility::string_t, std::vector<utility::string_t>> property_dependencies;
+                    std::map<utility::string_t, const schema_node*> schema_dependencies;
+                    std::size_t min_properties;
+                    std::size_t max_properties;
+
+                    // arrays
+                    const schema_node* items;
+                    std::vector<const schema_node*> tuple_items;
+                    bool additional_items_allowed;
+                    const schema_node* additional_items;
+                    std::size_t min_items;
+                    std::size_t max_items;
+                    bool unique_items;
 
-                            validators.insert(std::make_pair(id, std::move(validator)));
+                    // strings
+                    std::size_t min_length;
+                    std::size_t max_length;
+                    bool has_pattern;
+                    utility::string_t pattern_source;
+                    regex_t pattern;
+                    utility::string_t format;
+
+                    // numbers
+                    bool has_minimum;
+                    double minimum;
+                    bool exclusive_minimum;
+                    bool has_maximum;
+                    double maximum;
+                    bool exclusive_maximum;
+                    double multiple_of;
+                };
+
+                // the location and description of the first problem found by validation
+                struct validation_error
+                {
+                    validation_error() : enum_mismatch(false) {}
+
+                    utility::string_t pointer;
+                    utility::string_t message;
+                    // an enum mismatch is less interesting than other problems at the same depth, since it usually indicates the wrong alternative
+                    bool enum_mismatch;
+                };
+
+                // describe a problem, only if a description has been requested, since unsuccessful alternatives
+                // in "anyOf" and "oneOf", etc. are routine and shouldn't have to pay for the string handling
+                template <typename Message>
+                static bool fail(validation_error* error, Message message)
+                {
+                    if (error) error->message = message();
+                    return false;
+                }
+
+                // extend the location of a problem discovered in a child instance
+                static bool fail_at(validation_error* error, const utility::string_t& token)
+                {
+                    if (error)
+                    {
+                        utility::string_t escaped;
+                        escaped.reserve(token.size() + 1);
+                        escaped.push_back(_XPLATSTR('/'));
+                        for (const auto c : token)
+                        {
+                            if (_XPLATSTR('~') == c) escaped.append(_XPLATSTR("~0"));
+                            else if (_XPLATSTR('/') == c) escaped.append(_XPLATSTR("~1"));
+                            else escaped.push_back(c);
                         }
+                        error->pointer.insert(0, escaped);
                     }
+                    return false;
+                }
+
+                static bool fail_at(validation_error* error, std::size_t index)
+                {
+                    return fail_at(error, utility::conversions::details::print_string(index));
+                }
 
-                    void validate(const web::json::value& value, const web::uri& id) const
+                // string length is measured in characters (code points) rather than code units
+                static std::size_t code_point_count(const utility::string_t& value)
+                {
+#ifdef _UTF16_STRINGS
+                    return (std::size_t)std::count_if(value.begin(), value.end(), [](utility::char_t c) { return 0xDC00 != (c & 0xFC00); });
+#else
+                    return (std::size_t)std::count_if(value.begin(), value.end(), [](utility::char_t c) { return 0x80 != (static_cast<unsigned char>(c) & 0xC0); });
+#endif
+                }
+
+                static unsigned int instance_type(const web::json::value& instance)
+                {
+                    switch (instance.type())
                     {
-                        auto validator = validators.find(id);
-                        if (validators.end() == validator)
+                    case web::json::value::Null: return schema_node::null_type;
+                    case web::json::value::Boolean: return schema_node::boolean_type;
+                    case web::json::value::Number: return instance.is_integer() ? schema_node::integer_type | schema_node::number_type : schema_node::number_type;
+                    case web::json::value::String: return schema_node::string_type;
+                    case web::json::value::Array: return schema_node::array_type;
+                    case web::json::value::Object: return schema_node::object_type;
+                    default: return 0;
+                    }
+                }
+
+                static unsigned int type_flag(const utility::string_t& type)
+                {
+                    if (type == _XPLATSTR("null")) return schema_node::null_type;
+                    if (type == _XPLATSTR("boolean")) return schema_node::boolean_type;
+                    if (type == _XPLATSTR("integer")) return schema_node::integer_type;
+                    // "number" includes integers
+                    if (type == _XPLATSTR("number")) return schema_node::integer_type | schema_node::number_type;
+                    if (type == _XPLATSTR("string")) return schema_node::string_type;
+                    if (type == _XPLATSTR("array")) return schema_node::array_type;
+                    if (type == _XPLATSTR("object")) return schema_node::object_type;
+                    throw web::json::json_exception("schema has unknown type " + utility::us2s(type));
+                }
+
+                // json validator implementation that compiles each schema once, on first use, following every "$ref" in advance,
+                // so that validation walks the web::json::value instance in place, without converting it to any other representation
+                // validation does not modify the compiled schemas, so validate may be called concurrently
+                // note: "id" keywords which change the resolution scope are not supported
+                class json_validator_impl
+                {
+                public:
+                    json_validator_impl(std::function<web::json::value(const web::uri&)> load_schema, const std::vector<web::uri>& ids)
+                        : load_schema(load_schema)
+                        , ids(ids.begin(), ids.end())
+                    {
+                    }
+
+                    void validate(const web::json::value& value, const web::uri& id)
+                    {
+                        const auto root = find_root(id);
+
+                        validation_error error;
+                        if (!validate(*root, value, &error))
+                        {
+                            throw web::json::json_exception("schema validation failed at " + (error.pointer.empty() ? std::string("root") : utility::us2s(error.pointer)) + " - " + utility::us2s(error.message));
+                        }
+                    }
+
+                private:
+                    // find the compiled schema for the specified base URI, which is only compiled on first use, so that the cost of loading
+                    // and compiling the schemas isn't paid at startup for versions that are never used
+                    const schema_node* find_root(const web::uri& id)
+                    {
+                        std::lock_guard<std::mutex> lock(mutex);
+
+                        auto root = roots.find(id);
+                        if (roots.end() != root) return root->second;
+
+                        auto failure = failures.find(id);
+                        if (failures.end() != failure) throw web::json::json_exception(failure->second.c_str());
+
+                        if (ids.end() == ids.find(id))
                         {
                             throw web::json::json_exception("schema not found for " + utility::us2s(id.to_string()));
                         }
 
-                        struct error_handler : nlohmann::json_schema::error_handler
+                        const auto& uri = id.to_string();
+                        const auto hash = uri.find(_XPLATSTR('#'));
+                        const auto document = uri.substr(0, hash);
+                        const auto pointer = utility::string_t::npos != hash ? web::uri::decode(uri.substr(hash + 1)) : utility::string_t{};
+                        try
                         {
-                            virtual void error(const nlohmann::json::json_pointer& ptr, const nlohmann::json& instance, const std::string& message)
+                            return roots.insert(std::make_pair(id, compile(document, pointer))).first->second;
+                        }
+                        catch (const web::json::json_exception& e)
+                        {
+                            // a partially compiled schema mustn't be used, so the failure is remembered
+                            failures.insert(std::make_pair(id, std::string(e.what())));
+                            throw;
+                        }
+                    }
+
+                    // schema compilation
+
+                    const web::json::value& load_document(const utility::string_t& document)
+                    {
+                        auto found = documents.find(document);
+                        if (documents.end() == found)
+                        {
+                            found = documents.insert(std::make_pair(document, load_schema(web::uri(document)))).first;
+                        }
+                        return found->second;
+                    }
+
+                    // resolve the specified JSON Pointer (assumed already percent-decoded) within the specified document
+                    // see https://tools.ietf.org/html/rfc6901
+                    const web::json::value& resolve(const utility::string_t& document, const utility::string_t& pointer)
+                    {
+                        const web::json::value* schema = &load_document(document);
+
+                        utility::string_t::size_type pos = 0;
+                        while (pos < pointer.size())
+                        {
+                            if (_XPLATSTR('/') != pointer[pos])
                             {
-                                throw web::json::json_exception("schema validation failed at " + (nlohmann::json::json_pointer() == ptr ? "root" : ptr.to_string()) + " - " + message);
+                                throw web::json::json_exception("schema has invalid reference " + utility::us2s(document + _XPLATSTR('#') + pointer));
                             }
-                        } error_handler;
+                            const auto next = (std::min)(pointer.find(_XPLATSTR('/'), pos + 1), pointer.size());
+                            utility::string_t token;
+                            for (auto i = pos + 1; i < next; ++i)
+                            {
+                                if (_XPLATSTR('~') == pointer[i] && i + 1 < next && _XPLATSTR('1') == pointer[i + 1]) { token.push_back(_XPLATSTR('/')); ++i; }
+                                else if (_XPLATSTR('~') == pointer[i] && i + 1 < next && _XPLATSTR('0') == pointer[i + 1]) { token.push_back(_XPLATSTR('~')); ++i; }
+                                else token.push_back(pointer[i]);
+                            }
+                            pos = next;
+
+                            const web::json::value* child = nullptr;
+                            if (schema->is_object())
+                            {
+                                const auto& object = schema->as_object();
+                                auto found = object.find(token);
+                                if (object.end() != found) child = &found->second;
+                            }
+                            else if (schema->is_array() && !token.empty() && std::all_of(token.begin(), token.end(), [](utility::char_t c) { return _XPLATSTR('0') <= c && c <= _XPLATSTR('9'); }))
+                            {
+                                const auto index = (std::size_t)std::stoul(token);
+                                if (index < schema->size()) child = &schema->at(index);
+                            }
+                            if (!child)
+                            {
+                                throw web::json::json_exception("schema not found for " + utility::us2s(document + _XPLATSTR('#') + pointer));
+                            }
+                            schema = child;
+                        }
+
+                        return *schema;
+                    }
+
+                    // resolve a "$ref" relative to the specified document, and compile the referenced schema
+                    const schema_node* compile_ref(const utility::string_t& document, const utility::string_t& ref)
+                    {
+                        const auto hash = ref.find(_XPLATSTR('#'));
+                        const auto ref_document = ref.substr(0, hash);
+                        const auto pointer = utility::string_t::npos != hash ? web::uri::decode(ref.substr(hash + 1)) : utility::string_t{};
+
+                        if (ref_document.empty())
+                        {
+                            return compile(document, pointer);
+                        }
+
+                        // absolute reference, or relative to the last path segment of the document
+                        // note: dot-segments are not removed, since the NMOS schemas do not use them
+                        const auto colon = ref_document.find(_XPLATSTR(':'));
+                        if (utility::string_t::npos != colon && ref_document.find(_XPLATSTR('/')) > colon)
+                        {
+                            return compile(ref_document, pointer);
+                        }
+                        else if (_XPLATSTR('/') == ref_document.front())
+                        {
+                            const auto authority = document.find(_XPLATSTR("://"));
+                            const auto path = utility::string_t::npos != authority ? document.find(_XPLATSTR('/'), authority + 3) : utility::string_t::npos;
+                            return compile(document.substr(0, path) + ref_document, pointer);
+                        }
+                        else
+                        {
+                            const auto slash = document.rfind(_XPLATSTR('/'));
+                            return compile(document.substr(0, utility::string_t::npos != slash ? slash + 1 : 0) + ref_document, pointer);
+                        }
+                    }
+
+                    const schema_node* compile_child(const utility::string_t& document, const utility::string_t& pointer, const utility::string_t& keyword)
+                    {
+                        return compile(document, pointer + _XPLATSTR('/') + keyword);
+                    }
+
+                    const schema_node* compile_child(const utility::string_t& document, const utility::string_t& pointer, const utility::string_t& keyword, const utility::string_t& token)
+                    {
+                        auto child = pointer + _XPLATSTR('/') + keyword + _XPLATSTR('/');
+                        for (const auto c : token)
+                        {
+                            if (_XPLATSTR('~') == c) child.append(_XPLATSTR("~0"));
+                            else if (_XPLATSTR('/') == c) child.append(_XPLATSTR("~1"));
+                            else child.push_back(c);
+                        }
+                        return compile(document, child);
+                    }
+
+                    const schema_node* compile_child(const utility::string_t& document, const utility::string_t& pointer, const utility::string_t& keyword, std::size_t index)
+                    {
+                        return compile(document, pointer + _XPLATSTR('/') + keyword + _XPLATSTR('/') + utility::conversions::details::print_string(index));
+                    }
+
+                    static std::size_t size_keyword(const web::json::value& value)
+                    {
+                        return (std::size_t)value.as_number().to_uint64();
+                    }
+
+                    // compile the schema at the specified location, unless it has already been compiled
+                    // the node is registered before its subschemas are compiled, so that recursive references are handled
+                    const schema_node* compile(const utility::string_t& document, const utility::string_t& pointer)
+                    {
+                        const auto key = document + _XPLATSTR('#') + pointer;
+                        auto found = compiled.find(key);
+                        if (compiled.end() != found) return found->second;
+
+                        const auto& schema = resolve(document, pointer);
+                        if (!schema.is_object())
+                        {
+                            throw web::json::json_exception("schema is not an object at " + utility::us2s(key));
+                        }
+
+                        nodes.emplace_back();
+                        schema_node& node = nodes.back();
+                        compiled.insert(std::make_pair(key, &node));
 
                         try
                         {
-                            auto instance = nlohmann::json::parse(utility::us2s(value.serialize()));
-                            validator->second.validate(instance, error_handler);
+                            compile(node, schema.as_object(), document, pointer);
                         }
                         catch (const web::json::json_exception&)
                         {
@@ -130,13 +594,437 @@ namespace web
                         }
                         catch (const std::exception& e)
                         {
-                            throw web::json::json_exception(e.what());
+                            throw web::json::json_exception("schema could not be compiled at " + utility::us2s(key) + " - " + e.what());
                         }
+
+                        return &node;
                     }
 
-                private:
-                    std::map<web::uri, nlohmann::json_schema::json_validator> validators;
+                    void compile(schema_node& node, const web::json::object& schema, const utility::string_t& document, const utility::string_t& pointer)
+                    {
+                        auto ref = schema.find(_XPLATSTR("$ref"));
+                        if (schema.end() != ref)
+                        {
+                            node.ref = compile_ref(document, ref->second.as_string());
+                            return;
+                        }
+
+                        for (const auto& keyword : schema)
+                        {
+                            const auto& name = keyword.first;
+                            const auto& value = keyword.second;
+
+                            if (name == _XPLATSTR("type"))
+                            {
+                                if (value.is_array())
+                                {
+                                    node.types = 0;
+                                    for (const auto& type : value.as_array()) node.types |= type_flag(type.as_string());
+                                }
+                                else
+                                {
+                                    node.types = type_flag(value.as_string());
+                                }
+                            }
+                            else if (name == _XPLATSTR("enum"))
+                            {
+                                node.has_enum = true;
+                                node.enum_values = value;
+                            }
+                            else if (name == _XPLATSTR("allOf"))
+                            {
+                                for (std::size_t i = 0; i < value.size(); ++i) node.all_of.push_back(compile_child(document, pointer, name, i));
+                            }
+                            else if (name == _XPLATSTR("anyOf"))
+                            {
+                                for (std::size_t i = 0; i < value.size(); ++i) node.any_of.push_back(compile_child(document, pointer, name, i));
+                            }
+                            else if (name == _XPLATSTR("oneOf"))
+                            {
+                                for (std::size_t i = 0; i < value.size(); ++i) node.one_of.push_back(compile_child(document, pointer, name, i));
+                            }
+                            else if (name == _XPLATSTR("not"))
+                            {
+                                node.not_ = compile_child(document, pointer, name);
+                            }
+                            else if (name == _XPLATSTR("properties"))
+                            {
+                                for (const auto& property : value.as_object()) node.properties[property.first] = compile_child(document, pointer, name, property.first);
+                            }
+                            else if (name == _XPLATSTR("patternProperties"))
+                            {
+                                for (const auto& property : value.as_object()) node.pattern_properties.push_back({ regex_t(property.first, bst::regex_constants::ECMAScript), compile_child(document, pointer, name, property.first) });
+                            }
+                            else if (name == _XPLATSTR("additionalProperties"))
+                            {
+                                if (value.is_boolean()) node.additional_properties_allowed = value.as_bool();
+                                else node.additional_properties = compile_child(document, pointer, name);
+                            }
+                            else if (name == _XPLATSTR("required"))
+                            {
+                                for (const auto& property : value.as_array()) node.required.push_back(property.as_string());
+                            }
+                            else if (name == _XPLATSTR("dependencies"))
+                            {
+                                for (const auto& dependency : value.as_object())
+                                {
+                                    if (dependency.second.is_array())
+                                    {
+                                        auto& properties = node.property_dependencies[dependency.first];
+                                        for (const auto& property : dependency.second.as_array()) properties.push_back(property.as_string());
+                                    }
+                                    else
+                                    {
+                                        node.schema_dependencies[dependency.first] = compile_child(document, pointer, name, dependency.first);
+                                    }
+                                }
+                            }
+                            else if (name == _XPLATSTR("minProperties")) node.min_properties = size_keyword(value);
+                            else if (name == _XPLATSTR("maxProperties")) node.max_properties = size_keyword(value);
+                            else if (name == _XPLATSTR("items"))
+                            {
+                                if (value.is_array())
+                                {
+                                    for (std::size_t i = 0; i < value.size(); ++i) node.tuple_items.push_back(compile_child(document, pointer, name, i));
+                                }
+                                else
+                                {
+                                    node.items = compile_child(document, pointer, name);
+                                }
+                            }
+                            else if (name == _XPLATSTR("additionalItems"))
+                            {
+                                if (value.is_boolean()) node.additional_items_allowed = value.as_bool();
+                                else node.additional_items = compile_child(document, pointer, name);
+                            }
+                            else if (name == _XPLATSTR("minItems")) node.min_items = size_keyword(value);
+                            else if (name == _XPLATSTR("maxItems")) node.max_items = size_keyword(value);
+                            else if (name == _XPLATSTR("uniqueItems")) node.unique_items = value.as_bool();
+                            else if (name == _XPLATSTR("minLength")) node.min_length = size_keyword(value);
+                            else if (name == _XPLATSTR("maxLength")) node.max_length = size_keyword(value);
+                            else if (name == _XPLATSTR("pattern"))
+                            {
+                                node.has_pattern = true;
+                                node.pattern_source = value.as_string();
+                                node.pattern = regex_t(node.pattern_source, bst::regex_constants::ECMAScript);
+                            }
+                            else if (name == _XPLATSTR("format")) node.format = value.as_string();
+                            else if (name == _XPLATSTR("minimum")) { node.has_minimum = true; node.minimum = value.as_double(); }
+                            else if (name == _XPLATSTR("exclusiveMinimum")) node.exclusive_minimum = value.as_bool();
+                            else if (name == _XPLATSTR("maximum")) { node.has_maximum = true; node.maximum = value.as_double(); }
+                            else if (name == _XPLATSTR("exclusiveMaximum")) node.exclusive_maximum = value.as_bool();
+                            else if (name == _XPLATSTR("multipleOf")) node.multiple_of = value.as_double();
+                            // other keywords, e.g. "definitions", "title", "description", "default", are only relevant when referenced
+                        }
+
+                        // "additionalItems" only applies when "items" is an array
+                        if (node.tuple_items.empty())
+                        {
+                            node.additional_items_allowed = true;
+                            node.additional_items = nullptr;
+                        }
+                    }
+
+                    // validation
+
+                    bool validate(const schema_node& node, const web::json::value& instance, validation_error* error) const
+                    {
+                        if (node.ref) return validate(*node.ref, instance, error);
+
+                        const auto type = instance_type(instance);
+                        if (0 == (node.types & type))
+                        {
+                            return fail(error, [&] { return _XPLATSTR("instance type ") + type_name(instance) + _XPLATSTR(" is not allowed by the schema"); });
+                        }
+
+                        if (node.has_enum)
+                        {
+                            const auto& values = node.enum_values.as_array();
+                            if (values.end() == std::find(values.begin(), values.end(), instance))
+                            {
+                                if (error) error->enum_mismatch = true;
+                                return fail(error, [&] { return _XPLATSTR("instance ") + instance.serialize() + _XPLATSTR(" not found in enum"); });
+                            }
+                        }
+
+                        switch (instance.type())
+                        {
+                        case web::json::value::Number:
+                            if (!validate_number(node, instance.as_double(), error)) return false;
+                            break;
+                        case web::json::value::String:
+                            if (!validate_string(node, instance.as_string(), error)) return false;
+                            break;
+                        case web::json::value::Array:
+                            if (!validate_array(node, instance.as_array(), error)) return false;
+                            break;
+                        case web::json::value::Object:
+                            if (!validate_object(node, instance, error)) return false;
+                            break;
+                        default:
+                            break;
+                        }
+
+                        for (const auto& all_of : node.all_of)
+                        {
+                            if (!validate(*all_of, instance, error)) return false;
+                        }
+
+                        if (!node.any_of.empty())
+                        {
+                            if (node.any_of.end() == std::find_if(node.any_of.begin(), node.any_of.end(), [&](const schema_node* any_of) { return validate(*any_of, instance, nullptr); }))
+                            {
+                                return fail_alternatives(node.any_of, instance, _XPLATSTR("anyOf"), error);
+                            }
+                        }
+
+                        if (!node.one_of.empty())
+                        {
+                            const auto count = std::count_if(node.one_of.begin(), node.one_of.end(), [&](const schema_node* one_of) { return validate(*one_of, instance, nullptr); });
+                            if (0 == count)
+                            {
+                                return fail_alternatives(node.one_of, instance, _XPLATSTR("oneOf"), error);
+                            }
+                            if (1 != count)
+                            {
+                                return fail(error, [] { return utility::string_t(_XPLATSTR("instance is valid against more than one of the schemas in oneOf")); });
+                            }
+                        }
+
+                        if (node.not_ && validate(*node.not_, instance, nullptr))
+                        {
+                            return fail(error, [] { return utility::string_t(_XPLATSTR("instance is valid against the schema in not")); });
+                        }
+
+                        return true;
+                    }
+
+                    // when none of the alternatives is successful, describe the problem found by the one that got furthest
+                    // since e.g. in the NMOS schemas, the alternatives are typically distinguished by an enum or pattern near the root
+                    bool fail_alternatives(const std::vector<const schema_node*>& alternatives, const web::json::value& instance, const utility::string_t& keyword, validation_error* error) const
+                    {
+                        if (!error) return false;
+
+                        validation_error furthest;
+                        bool first = true;
+                        for (const auto& alternative : alternatives)
+                        {
+                            validation_error candidate;
+                            validate(*alternative, instance, &candidate);
+                            if (first || candidate.pointer.size() > furthest.pointer.size() || (candidate.pointer.size() == furthest.pointer.size() && furthest.enum_mismatch && !candidate.enum_mismatch))
+                            {
+                                furthest = std::move(candidate);
+                                first = false;
+                            }
+                        }
+
+                        error->pointer = furthest.pointer;
+                        error->enum_mismatch = furthest.enum_mismatch;
+                        error->message = _XPLATSTR("instance is not valid against any of the schemas in ") + keyword + _XPLATSTR(", e.g. ") + furthest.message;
+                        return false;
+                    }
+
+                    static utility::string_t type_name(const web::json::value& instance)
+                    {
+                        switch (instance.type())
+                        {
+                        case web::json::value::Null: return _XPLATSTR("null");
+                        case web::json::value::Boolean: return _XPLATSTR("boolean");
+                        case web::json::value::Number: return instance.is_integer() ? _XPLATSTR("integer") : _XPLATSTR("number");
+                        case web::json::value::String: return _XPLATSTR("string");
+                        case web::json::value::Array: return _XPLATSTR("array");
+                        case web::json::value::Object: return _XPLATSTR("object");
+                        default: return _XPLATSTR("undefined");
+                        }
+                    }
+
+                    static bool validate_number(const schema_node& node, double number, validation_error* error)
+                    {
+                        if (node.has_minimum && (node.exclusive_minimum ? number <= node.minimum : number < node.minimum))
+                        {
+                            return fail(error, [&] { return _XPLATSTR("value ") + utility::conversions::details::print_string(number) + _XPLATSTR(" is less than minimum ") + utility::conversions::details::print_string(node.minimum); });
+                        }
+                        if (node.has_maximum && (node.exclusive_maximum ? number >= node.maximum : number > node.maximum))
+                        {
+                            return fail(error, [&] { return _XPLATSTR("value ") + utility::conversions::details::print_string(number) + _XPLATSTR(" exceeds maximum ") + utility::conversions::details::print_string(node.maximum); });
+                        }
+                        if (0 != node.multiple_of)
+                        {
+                            const auto quotient = number / node.multiple_of;
+                            if (std::abs(quotient - std::round(quotient)) > 1e-9 * (std::max)(1.0, std::abs(quotient)))
+                            {
+                                return fail(error, [&] { return _XPLATSTR("value ") + utility::conversions::details::print_string(number) + _XPLATSTR(" is not a multiple of ") + utility::conversions::details::print_string(node.multiple_of); });
+                            }
+                        }
+                        return true;
+                    }
+
+                    static bool validate_string(const schema_node& node, const utility::string_t& string, validation_error* error)
+                    {
+                        if (0 != node.min_length || (std::numeric_limits<std::size_t>::max)() != node.max_length)
+                        {
+                            const auto length = code_point_count(string);
+                            if (length < node.min_length)
+                            {
+                                return fail(error, [&] { return _XPLATSTR("instance is too short as per minLength:") + utility::conversions::details::print_string(node.min_length); });
+                            }
+                            if (length > node.max_length)
+                            {
+                                return fail(error, [&] { return _XPLATSTR("instance is too long as per maxLength: ") + utility::conversions::details::print_string(node.max_length); });
+                            }
+                        }
+                        if (node.has_pattern && !bst::regex_search(string, node.pattern))
+                        {
+                            return fail(error, [&] { return string + _XPLATSTR(" does not match regex pattern: ") + node.pattern_source; });
+                        }
+                        if (!node.format.empty())
+                        {
+                            auto problem = check_format(node.format, string);
+                            if (!problem.empty())
+                            {
+                                return fail(error, [&] { return _XPLATSTR("format-checking failed: ") + problem; });
+                            }
+                        }
+                        return true;
+                    }
+
+                    bool validate_array(const schema_node& node, const web::json::array& array, validation_error* error) const
+                    {
+                        if (array.size() < node.min_items)
+                        {
+                            return fail(error, [&] { return _XPLATSTR("array has too few items as per minItems: ") + utility::conversions::details::print_string(node.min_items); });
+                        }
+                        if (array.size() > node.max_items)
+                        {
+                            return fail(error, [&] { return _XPLATSTR("array has too many items as per maxItems: ") + utility::conversions::details::print_string(node.max_items); });
+                        }
+
+                        std::size_t index = 0;
+                        for (auto item = array.begin(); array.end() != item; ++item, ++index)
+                        {
+                            const schema_node* item_schema = nullptr;
+                            if (node.items)
+                            {
+                                item_schema = node.items;
+                            }
+                            else if (index < node.tuple_items.size())
+                            {
+                                item_schema = node.tuple_items[index];
+                            }
+                            else if (!node.additional_items_allowed)
+                            {
+                                return fail(error, [&] { return utility::string_t(_XPLATSTR("array has too many items and schema does not allow additional items")); });
+                            }
+                            else
+                            {
+                                item_schema = node.additional_items;
+                            }
+
+                            if (item_schema && !validate(*item_schema, *item, error)) return fail_at(error, index);
+                        }
+
+                        if (node.unique_items)
+                        {
+                            for (auto item = array.begin(); array.end() != item; ++item)
+                            {
+                                if (array.end() != std::find(std::next(item), array.end(), *item))
+                                {
+                                    return fail(error, [] { return utility::string_t(_XPLATSTR("items have to be unique for this array")); });
+                                }
+                            }
+                        }
+
+                        return true;
+                    }
+
+                    bool validate_object(const schema_node& node, const web::json::value& instance, validation_error* error) const
+                    {
+                        const auto& object = instance.as_object();
+
+                        if (object.size() < node.min_properties)
+                        {
+                            return fail(error, [&] { return _XPLATSTR("object has too few properties as per minProperties: ") + utility::conversions::details::print_string(node.min_properties); });
+                        }
+                        if (object.size() > node.max_properties)
+                        {
+                            return fail(error, [&] { return _XPLATSTR("object has too many properties as per maxProperties: ") + utility::conversions::details::print_string(node.max_properties); });
+                        }
+
+                        for (const auto& required : node.required)
+                        {
+                            if (object.end() == object.find(required))
+                            {
+                                return fail(error, [&] { return _XPLATSTR("required property '") + required + _XPLATSTR("' not found in object"); });
+                            }
+                        }
+
+                        for (const auto& field : object)
+                        {
+                            bool matched = false;
+
+                            auto property = node.properties.find(field.first);
+                            if (node.properties.end() != property)
+                            {
+                                matched = true;
+                                if (!validate(*property->second, field.second, error)) return fail_at(error, field.first);
+                            }
+
+                            for (const auto& pattern_property : node.pattern_properties)
+                            {
+                                if (bst::regex_search(field.first, pattern_property.first))
+                                {
+                                    matched = true;
+                                    if (!validate(*pattern_property.second, field.second, error)) return fail_at(error, field.first);
+                                }
+                            }
+
+                            if (!matched)
+                            {
+                                if (!node.additional_properties_allowed)
+                                {
+                                    return fail(error, [&] { return _XPLATSTR("validation failed for additional property '") + field.first + _XPLATSTR("': instance invalid as per false-schema"); });
+                                }
+                                if (node.additional_properties && !validate(*node.additional_properties, field.second, error)) return fail_at(error, field.first);
+                            }
+                        }
+
+                        for (const auto& dependency : node.property_dependencies)
+                        {
+                            if (object.end() == object.find(dependency.first)) continue;
+                            for (const auto& required : dependency.second)
+                            {
+                                if (object.end() == object.find(required))
+                                {
+                                    return fail(error, [&] { return _XPLATSTR("property '") + required + _XPLATSTR("' is required by dependency on '") + dependency.first + _XPLATSTR("'"); });
+                                }
+                            }
+                        }
+
+                        for (const auto& dependency : node.schema_dependencies)
+                        {
+                            if (object.end() == object.find(dependency.first)) continue;
+                            if (!validate(*dependency.second, instance, error)) return false;
+                        }
+
+                        return true;
+                    }
+
+                    std::function<web::json::value(const web::uri&)> load_schema;
+                    const std::set<web::uri> ids;
+
+                    // the mutex protects the schema compilation, but not validation, since compiled nodes don't move or change
+                    std::mutex mutex;
+
+                    // loaded schema documents, by URI without fragment
+                    std::map<utility::string_t, web::json::value> documents;
+                    // compiled schemas, by URI with JSON Pointer fragment; std::list ensures the nodes don't move
+                    std::list<schema_node> nodes;
+                    std::map<utility::string_t, const schema_node*> compiled;
+                    // the compiled schema for each of the base URIs specified on construction that has been used
+                    std::map<web::uri, const schema_node*> roots;
+                    std::map<web::uri, std::string> failures;
                 };
+#endif
             }
 
             // initialize for the specified base URIs using the specified loader
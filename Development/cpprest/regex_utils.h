@@ -1,7 +1,11 @@
 #ifndef CPPREST_REGEX_UTILS_H
 #define CPPREST_REGEX_UTILS_H
 
+#include <cstddef>
+#include <cstdint>
 #include <map>
+#include <type_traits>
+#include <vector>
 #include "bst/regex.h"
 
 // An implementation of named capture on top of bst::basic_regex (could be extracted from the cpprest module)
@@ -167,6 +171,398 @@ namespace xregex
         }
         return result;
     }
+
+    // simple_regex is a matcher for a subset of the ECMAScript regular expression grammar that suffices for typical route patterns, i.e.
+    // literals, '.', character classes, the greedy quantifiers '?', '*', '+' and '{n,m}' applied to those, alternation, and (non-marking) sub_matches
+    // it is compiled into a small program for a backtracking matcher, which gives the same results as bst::regex_match (or bst::regex_search
+    // with match_continuous) but avoids the overhead of the general regex engine; assign returns false for any other regular expression
+    // (the regular expression should have any named sub_matches removed first, see parse_regex_named_sub_matches)
+
+    // the positions of each sub_match (the first being the entire match), with npos for sub_matches which did not participate in the match
+    typedef std::vector<std::pair<std::size_t, std::size_t>> simple_sub_matches_t;
+
+    template <typename Char>
+    class simple_regex
+    {
+    public:
+        static const std::size_t npos = std::size_t(-1);
+
+        simple_regex() : marks(0) {}
+
+        // compile the specified regular expression, returning false if it uses anything outside the supported subset
+        bool assign(const string_t<Char>& regex)
+        {
+            program.clear();
+            prefix.clear();
+            marks = 0;
+
+            auto first = regex.begin();
+            program_t alternation;
+            if (!parse_alternation(first, regex.end(), alternation) || regex.end() != first)
+            {
+                program.clear();
+                return false;
+            }
+
+            program.push_back(make_save(0));
+            append(program, alternation);
+            program.push_back(make_save(1));
+            program.push_back(instruction{ accept, 0, 0, {}, false });
+
+            for (auto& in : program)
+            {
+                if (char_set == in.op) in.index_ascii();
+            }
+
+            // a literal prefix allows most non-matching strings to be rejected immediately
+            for (auto in = program.begin() + 1; program.end() != in && char_set == in->op && !in->negated && 1 == in->ranges.size() && in->ranges[0].first == in->ranges[0].second; ++in)
+            {
+                prefix.push_back(in->ranges[0].first);
+            }
+
+            return true;
+        }
+
+        bool empty() const { return program.empty(); }
+
+        // the number of marked sub_matches
+        std::size_t mark_count() const { return marks; }
+
+        // the literal characters with which every match begins
+        const string_t<Char>& literal_prefix() const { return prefix; }
+
+        // match the entire string, or if prefix is specified, an initial substring, like bst::regex_match (or bst::regex_search with match_continuous)
+        bool match(const string_t<Char>& s, simple_sub_matches_t& sub_matches, bool match_prefix = false) const
+        {
+            if (program.empty()) return false;
+            if (0 != s.compare(0, prefix.size(), prefix)) return false;
+
+            std::vector<std::size_t> saved(2 * (marks + 1), npos);
+            if (!run(0, 0, s, match_prefix, saved)) return false;
+
+            sub_matches.clear();
+            for (std::size_t i = 0; i < saved.size(); i += 2)
+            {
+                if (npos != saved[i] && npos != saved[i + 1])
+                {
+                    sub_matches.push_back({ saved[i], saved[i + 1] });
+                }
+                else
+                {
+                    sub_matches.push_back({ npos, npos });
+                }
+            }
+            return true;
+        }
+
+    private:
+        enum opcode { char_set, split, jump, save, accept };
+        typedef typename std::make_unsigned<Char>::type unsigned_char;
+
+        struct instruction
+        {
+            opcode op;
+            // relative targets for split (x is preferred) and jump, or the slot for save
+            std::ptrdiff_t x;
+            std::ptrdiff_t y;
+            std::vector<std::pair<Char, Char>> ranges;
+            bool negated;
+            // the ranges, as a bitmap of the ASCII characters, since route patterns and request paths are almost always ASCII
+            std::uint64_t ascii[2];
+
+            void index_ascii()
+            {
+                ascii[0] = ascii[1] = 0;
+                for (const auto& range : ranges)
+                {
+                    for (auto ch = (unsigned_char)range.first; ch <= (unsigned_char)range.second && ch < 128; ++ch)
+                    {
+                        ascii[ch >> 6] |= std::uint64_t(1) << (ch & 63);
+                    }
+                }
+            }
+
+            bool matches(Char ch) const
+            {
+                const auto uch = (unsigned_char)ch;
+                if (uch < 128) return (0 != ((ascii[uch >> 6] >> (uch & 63)) & 1)) != negated;
+
+                bool found = false;
+                for (const auto& range : ranges)
+                {
+                    if (range.first <= ch && ch <= range.second) { found = true; break; }
+                }
+                return found != negated;
+            }
+        };
+
+        typedef std::vector<instruction> program_t;
+        typedef typename string_t<Char>::const_iterator const_iterator;
+
+        static instruction make_save(std::size_t slot) { return{ save, (std::ptrdiff_t)slot, 0, {}, false }; }
+        static instruction make_split(std::ptrdiff_t x, std::ptrdiff_t y) { return{ split, x, y, {}, false }; }
+        static instruction make_jump(std::ptrdiff_t x) { return{ jump, x, 0, {}, false }; }
+
+        static void append(program_t& to, const program_t& from) { to.insert(to.end(), from.begin(), from.end()); }
+
+        static bool is_word(Char ch)
+        {
+            return (Char('0') <= ch && ch <= Char('9')) || (Char('A') <= ch && ch <= Char('Z')) || (Char('a') <= ch && ch <= Char('z')) || Char('_') == ch;
+        }
+
+        // parse an escape sequence (after the backslash) into a character set
+        static bool parse_escape(const_iterator& first, const_iterator last, instruction& set)
+        {
+            if (last == first) return false;
+            const Char ch = *first++;
+            if (Char('d') == ch)
+            {
+                set.ranges.push_back({ Char('0'), Char('9') });
+                return true;
+            }
+            // identity escapes of non-word characters, e.g. "\\.", are literals; anything else is not supported
+            if (is_word(ch)) return false;
+            set.ranges.push_back({ ch, ch });
+            return true;
+        }
+
+        static bool parse_class(const_iterator& first, const_iterator last, instruction& set)
+        {
+            if (last != first && Char('^') == *first) { set.negated = true; ++first; }
+            // an empty class, or a leading ']', is not supported
+            if (last == first || Char(']') == *first) return false;
+
+            while (last != first && Char(']') != *first)
+            {
+                instruction item{ char_set, 0, 0, {}, false };
+                const Char ch = *first++;
+                if (Char('\\') == ch)
+                {
+                    if (!parse_escape(first, last, item)) return false;
+                }
+                else
+                {
+                    item.ranges.push_back({ ch, ch });
+                }
+
+                if (last != first && Char('-') == *first && last != first + 1 && Char(']') != *(first + 1))
+                {
+                    // a range must be between two single characters
+                    if (1 != item.ranges.size() || item.ranges[0].first != item.ranges[0].second) return false;
+                    ++first;
+                    Char upper = *first++;
+                    if (Char('\\') == upper)
+                    {
+                        if (last == first || is_word(*first)) return false;
+                        upper = *first++;
+                    }
+                    if (upper < item.ranges[0].first) return false;
+                    item.ranges[0].second = upper;
+                }
+
+                append_ranges(set, item);
+            }
+            if (last == first) return false;
+            ++first; // ']'
+            return true;
+        }
+
+        static void append_ranges(instruction& to, const instruction& from)
+        {
+            to.ranges.insert(to.ranges.end(), from.ranges.begin(), from.ranges.end());
+        }
+
+        static bool parse_number(const_iterator& first, const_iterator last, std::size_t& number)
+        {
+            if (last == first || *first < Char('0') || Char('9') < *first) return false;
+            number = 0;
+            while (last != first && Char('0') <= *first && *first <= Char('9'))
+            {
+                number = 10 * number + std::size_t(*first++ - Char('0'));
+                if (number > 1000) return false;
+            }
+            return true;
+        }
+
+        // parse a (greedy) quantifier, if any
+        static bool parse_quantifier(const_iterator& first, const_iterator last, std::size_t& min, std::size_t& max)
+        {
+            min = max = 1;
+            if (last == first) return true;
+            switch (*first)
+            {
+            case Char('?'): min = 0; max = 1; ++first; break;
+            case Char('*'): min = 0; max = npos; ++first; break;
+            case Char('+'): min = 1; max = npos; ++first; break;
+            case Char('{'):
+                ++first;
+                if (!parse_number(first, last, min)) return false;
+                max = min;
+                if (last != first && Char(',') == *first)
+                {
+                    ++first;
+                    max = npos;
+                    if (last != first && Char('}') != *first && (!parse_number(first, last, max) || max < min)) return false;
+                }
+                if (last == first || Char('}') != *first) return false;
+                ++first;
+                break;
+            default:
+                return true;
+            }
+            // lazy quantifiers are not supported
+            return last == first || Char('?') != *first;
+        }
+
+        // make the program for the quantified character set
+        static program_t quantify(const instruction& set, std::size_t min, std::size_t max)
+        {
+            program_t result(min, set);
+            if (npos == max)
+            {
+                result.push_back(make_split(1, 3));
+                result.push_back(set);
+                result.push_back(make_jump(-2));
+            }
+            else
+            {
+                // each optional repetition is nested within the previous one, i.e. x{0,2} is like (?:x(?:x)?)?
+                program_t optional;
+                for (std::size_t n = min; n < max; ++n)
+                {
+                    program_t nested{ make_split(1, (std::ptrdiff_t)optional.size() + 2), set };
+                    append(nested, optional);
+                    optional.swap(nested);
+                }
+                append(result, optional);
+            }
+            return result;
+        }
+
+        bool parse_sequence(const_iterator& first, const_iterator last, program_t& sequence)
+        {
+            while (last != first && Char('|') != *first && Char(')') != *first)
+            {
+                const Char ch = *first++;
+                instruction set{ char_set, 0, 0, {}, false };
+                switch (ch)
+                {
+                case Char('('):
+                {
+                    std::size_t mark = 0;
+                    if (last != first && Char('?') == *first)
+                    {
+                        // only non-marking sub_matches are supported, not e.g. lookahead assertions
+                        if (last == first + 1 || Char(':') != *(first + 1)) return false;
+                        first += 2;
+                    }
+                    else
+                    {
+                        mark = ++marks;
+                    }
+                    program_t alternation;
+                    if (!parse_alternation(first, last, alternation)) return false;
+                    if (last == first || Char(')') != *first) return false;
+                    ++first;
+                    // quantified sub_matches are not supported
+                    if (last != first && (Char('?') == *first || Char('*') == *first || Char('+') == *first || Char('{') == *first)) return false;
+                    if (0 != mark) sequence.push_back(make_save(2 * mark));
+                    append(sequence, alternation);
+                    if (0 != mark) sequence.push_back(make_save(2 * mark + 1));
+                    continue;
+                }
+                case Char('['):
+                    if (!parse_class(first, last, set)) return false;
+                    break;
+                case Char('\\'):
+                    if (!parse_escape(first, last, set)) return false;
+                    break;
+                case Char('.'):
+                    // any character except line terminators
+                    set.ranges = { { Char('\n'), Char('\n') }, { Char('\r'), Char('\r') } };
+                    set.negated = true;
+                    break;
+                case Char('^'): case Char('$'): case Char('*'): case Char('+'): case Char('?'):
+                case Char(']'): case Char('{'): case Char('}'):
+                    // assertions are not supported, and the others are misplaced
+                    return false;
+                default:
+                    set.ranges.push_back({ ch, ch });
+                    break;
+                }
+
+                std::size_t min, max;
+                if (!parse_quantifier(first, last, min, max)) return false;
+                append(sequence, quantify(set, min, max));
+            }
+            return true;
+        }
+
+        bool parse_alternation(const_iterator& first, const_iterator last, program_t& alternation)
+        {
+            std::vector<program_t> alternatives(1);
+            if (!parse_sequence(first, last, alternatives.back())) return false;
+            while (last != first && Char('|') == *first)
+            {
+                ++first;
+                alternatives.push_back({});
+                if (!parse_sequence(first, last, alternatives.back())) return false;
+            }
+
+            // each alternative but the last is preceded by a split to the next alternative, and followed by a jump to the end
+            alternation = alternatives.back();
+            for (auto alternative = alternatives.rbegin() + 1; alternatives.rend() != alternative; ++alternative)
+            {
+                program_t preceding{ make_split(1, (std::ptrdiff_t)alternative->size() + 2) };
+                append(preceding, *alternative);
+                preceding.push_back(make_jump((std::ptrdiff_t)alternation.size() + 1));
+                append(preceding, alternation);
+                alternation.swap(preceding);
+            }
+            return true;
+        }
+
+        bool run(std::size_t pc, std::size_t pos, const string_t<Char>& s, bool match_prefix, std::vector<std::size_t>& saved) const
+        {
+            for (;;)
+            {
+                const auto& in = program[pc];
+                switch (in.op)
+                {
+                case char_set:
+                    if (s.size() == pos || !in.matches(s[pos])) return false;
+                    ++pos;
+                    ++pc;
+                    break;
+                case split:
+                    if (run(pc + in.x, pos, s, match_prefix, saved)) return true;
+                    pc += in.y;
+                    break;
+                case jump:
+                    pc += in.x;
+                    break;
+                case save:
+                {
+                    const auto previous = saved[in.x];
+                    saved[in.x] = pos;
+                    if (run(pc + 1, pos, s, match_prefix, saved)) return true;
+                    saved[in.x] = previous;
+                    return false;
+                }
+                case accept:
+                default:
+                    return match_prefix || s.size() == pos;
+                }
+            }
+        }
+
+        program_t program;
+        string_t<Char> prefix;
+        std::size_t marks;
+    };
+
+    template <typename Char>
+    const std::size_t simple_regex<Char>::npos;
 }
 
 #include "cpprest/details/basic_types.h"
@@ -181,6 +577,9 @@ namespace utility
     typedef ::xregex::named_sub_matches_t<char_t> named_sub_matches_t;
     typedef ::xregex::regex_named_sub_matches_t<char_t> regex_named_sub_matches_t;
 
+    typedef ::xregex::simple_regex<char_t> simple_regex_t;
+    typedef ::xregex::simple_sub_matches_t simple_sub_matches_t;
+
     inline string_t make_named_sub_match(const string_t& name, const string_t& sub_match)
     {
         return ::xregex::make_named_sub_match(name, sub_match);
@@ -1,6 +1,7 @@
 // The first "test" is of course whether the header compiles standalone
 #include "cpprest/api_router.h"
 
+#include <chrono>
 #include "bst/test/test.h"
 #include "cpprest/basic_utils.h" // for utility::us2s, utility::s2us
 
@@ -88,3 +89,110 @@ BST_TEST_CASE_PRIVATE(testGetParameters)
     BST_REQUIRE(bst::regex_match(path, route_match, route_regex));
     BST_REQUIRE(expected == api_router::get_parameters(parameter_sub_matches, route_match));
 }
+
+////////////////////////////////////////////////////////////////////////////////////////////
+BST_TEST_CASE(testRouteParameters)
+{
+    using web::http::experimental::listener::route_parameters;
+
+    route_parameters parameters;
+    BST_REQUIRE(parameters.empty());
+
+    // enough parameters to exceed the fixed storage
+    for (int i = 0; i < 10; ++i)
+    {
+        parameters[utility::string_t(1, U('0') + i)] = utility::string_t(40, U('a') + i);
+    }
+    BST_REQUIRE_EQUAL(10, parameters.size());
+    for (int i = 0; i < 10; ++i)
+    {
+        BST_REQUIRE(utility::string_t(40, U('a') + i) == parameters.at(utility::string_t(1, U('0') + i)));
+    }
+    BST_REQUIRE_THROW(parameters.at(U("foo")), std::out_of_range);
+    BST_REQUIRE(parameters.end() == parameters.find(U("foo")));
+
+    // insert doesn't replace existing parameters
+    route_parameters merged;
+    merged[U("0")] = U("bar");
+    merged.insert(parameters.begin(), parameters.end());
+    BST_REQUIRE_EQUAL(10, merged.size());
+    BST_REQUIRE(U("bar") == merged.at(U("0")));
+
+    // equality doesn't depend on order
+    route_parameters lhs, rhs;
+    lhs[U("foo")] = U("1");
+    lhs[U("bar")] = U("2");
+    rhs[U("bar")] = U("2");
+    BST_REQUIRE(lhs != rhs);
+    rhs[U("foo")] = U("1");
+    BST_REQUIRE(lhs == rhs);
+}
+
+////////////////////////////////////////////////////////////////////////////////////////////
+BST_TEST_CASE_PRIVATE(testMatchRouteBenchmark)
+{
+    using web::http::experimental::listener::api_router;
+    using web::http::experimental::listener::route_handler;
+    using web::http::experimental::listener::route_parameters;
+
+    const auto type = utility::make_named_sub_match(U("resourceType"), U("nodes|devices|sources|flows|senders|receivers"));
+    const auto id = utility::make_named_sub_match(U("resourceId"), U("[0-9a-f]{8}-[0-9a-f]{4}-[1-5][0-9a-f]{3}-[89ab][0-9a-f]{3}-[0-9a-f]{12}"));
+    const route_handler handler = [](web::http::http_request, web::http::http_response, const utility::string_t&, const route_parameters&) { return pplx::task_from_result(true); };
+
+    // routes similar to those of a typical API
+    api_router router;
+    router.support(U("/?"), handler);
+    router.support(U("/self/?"), handler);
+    router.support(U("/") + type + U("/?"), handler);
+    router.support(U("/") + type + U("/") + id + U("/?"), handler);
+    router.support(U("/receivers/") + id + U("/target"), handler);
+    router.support(U(".*"), handler);
+
+    // the same routes, but forced to use the general regex engine
+    auto regex_routes = router.routes;
+    for (auto& route : regex_routes) route.simple_pattern = {};
+
+    const std::vector<utility::string_t> paths{ U("/"), U("/self"), U("/senders/"), U("/receivers/3b8be755-08ff-452b-b217-c9151eb21193"), U("/receivers/3b8be755-08ff-452b-b217-c9151eb21193/target"), U("/foo") };
+
+    // both should find the same matches
+    for (const auto& path : paths)
+    {
+        auto regex_route = regex_routes.begin();
+        for (const auto& route : router.routes)
+        {
+            utility::string_t simple_path, regex_path;
+            route_parameters simple_parameters, regex_parameters;
+            BST_REQUIRE(!route.simple_pattern.empty());
+            BST_REQUIRE_EQUAL(api_router::match_route(*regex_route, path, regex_path, regex_parameters), api_router::match_route(route, path, simple_path, simple_parameters));
+            BST_REQUIRE(regex_path == simple_path);
+            BST_REQUIRE(regex_parameters == simple_parameters);
+            ++regex_route;
+        }
+    }
+
+    const int iterations = 1000;
+
+    const auto dispatch = [&](const std::list<api_router::route>& routes)
+    {
+        const auto start = std::chrono::steady_clock::now();
+        for (int i = 0; i < iterations; ++i)
+        {
+            for (const auto& path : paths)
+            {
+                for (const auto& route : routes)
+                {
+                    utility::string_t matched_path;
+                    route_parameters parameters;
+                    api_router::match_route(route, path, matched_path, parameters);
+                }
+            }
+        }
+        return std::chrono::steady_clock::now() - start;
+    };
+
+    const auto regex = dispatch(regex_routes);
+    const auto simple = dispatch(router.routes);
+
+    // only a warning, since timing is at the mercy of the test machine
+    BST_WARN_LT(simple.count(), regex.count());
+}
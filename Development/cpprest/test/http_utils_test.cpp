@@ -69,3 +69,30 @@ BST_TEST_CASE(testGetHostPort)
         BST_REQUIRE_EQUAL(std::make_pair(utility::string_t{ U("foobar") }, 0), web::http::get_host_port(req));
     }
 }
+
+////////////////////////////////////////////////////////////////////////////////////////////
+BST_TEST_CASE(testHasMatchingEntityTag)
+{
+    const auto has_match = [](const utility::string_t& header, const utility::string_t& entity_tag)
+    {
+        web::http::http_headers headers;
+        headers.add(U("If-None-Match"), header);
+        return web::http::has_matching_entity_tag(headers, U("If-None-Match"), entity_tag);
+    };
+
+    // no header
+    BST_REQUIRE(!web::http::has_matching_entity_tag(web::http::http_headers{}, U("If-None-Match"), U("\"foo\"")));
+    // any entity-tag
+    BST_REQUIRE(has_match(U("*"), U("\"foo\"")));
+    // exact match
+    BST_REQUIRE(has_match(U("\"foo\""), U("\"foo\"")));
+    BST_REQUIRE(!has_match(U("\"foo\""), U("\"bar\"")));
+    // weak comparison
+    BST_REQUIRE(has_match(U("W/\"foo\""), U("\"foo\"")));
+    BST_REQUIRE(has_match(U("\"foo\""), U("W/\"foo\"")));
+    // list of entity-tags, including one that contains a comma
+    BST_REQUIRE(has_match(U("\"bar\", \"baz,foo\",\"foo\""), U("\"foo\"")));
+    BST_REQUIRE(!has_match(U("\"bar\", \"baz,foo\""), U("\"foo\"")));
+    // not a substring match
+    BST_REQUIRE(!has_match(U("\"foobar\""), U("\"foo\"")));
+}
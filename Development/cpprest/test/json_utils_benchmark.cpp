@@ -0,0 +1,97 @@
+// The first "test" is of course whether the header compiles standalone
+#include "cpprest/json_utils.h"
+
+#include "bst/test/benchmark.h"
+#include "bst/test/test.h"
+
+namespace
+{
+    const auto value = web::json::value::parse(U(R"-({
+        "id": "3b8be755-08ff-452b-b217-c9151eb21193",
+        "version": "1441973902:879053935",
+        "label": "Example Sender",
+        "description": "Example Sender",
+        "tags": { "location": ["Salford", "London"] },
+        "flow_id": "5fbec3b1-1b0f-417d-9059-8b94a47197ed",
+        "transport": "urn:x-nmos:transport:rtp.mcast",
+        "device_id": "c501ae2a-2a0e-4a6f-b8a6-3e4ff4b0eae9",
+        "manifest_href": "http://192.168.0.10/x-nmos/connection/v1.1/single/senders/3b8be755-08ff-452b-b217-c9151eb21193/transportfile",
+        "interface_bindings": ["eth0", "eth1"],
+        "subscription": { "receiver_id": null, "active": false },
+        "caps": {}
+    })-"));
+
+    const auto query = web::json::unflatten(web::json::value_of({
+        { U("transport"), U("urn:x-nmos:transport:rtp.mcast") },
+        { U("tags.location"), U("london") },
+        { U("subscription.active"), U("false") }
+    }));
+}
+
+////////////////////////////////////////////////////////////////////////////////////////////
+BST_TEST_CASE(benchmarkMatchQuery)
+{
+    const auto match_flags = web::json::match_substr | web::json::match_icase;
+    BST_REQUIRE(web::json::match_query(value, query, match_flags));
+
+    bst::test::benchmark("web::json::match_query", [&]
+    {
+        bst::test::do_not_optimize(web::json::match_query(value, query, match_flags));
+    });
+
+    const web::json::compiled_match_query compiled(query, match_flags);
+    BST_REQUIRE(compiled(value));
+
+    bst::test::benchmark("web::json::compiled_match_query", [&]
+    {
+        bst::test::do_not_optimize(compiled(value));
+    });
+}
+
+////////////////////////////////////////////////////////////////////////////////////////////
+BST_TEST_CASE(benchmarkSerialize)
+{
+    bst::test::benchmark("web::json::value::serialize", []
+    {
+        bst::test::do_not_optimize(utility::conversions::to_utf8string(value.serialize()));
+    });
+
+    std::string utf8;
+    bst::test::benchmark("web::json::experimental::serialize_utf8", [&]
+    {
+        utf8.clear();
+        web::json::experimental::serialize_utf8(utf8, value);
+        bst::test::do_not_optimize(utf8);
+    });
+
+    const auto serialized = value.serialize();
+    bst::test::benchmark("web::json::value::parse", [&]
+    {
+        bst::test::do_not_optimize(web::json::value::parse(serialized));
+    });
+
+    bst::test::benchmark("web::json::experimental::parse_utf8", [&]
+    {
+        bst::test::do_not_optimize(web::json::experimental::parse_utf8(utf8));
+    });
+}
+
+////////////////////////////////////////////////////////////////////////////////////////////
+BST_TEST_CASE(benchmarkParseLarge)
+{
+    // e.g. a bulk registration or a registry snapshot
+    auto large = web::json::value::array();
+    for (int i = 0; i < 1000; ++i) web::json::push_back(large, value);
+    const auto serialized = large.serialize();
+    const auto utf8 = utility::conversions::to_utf8string(serialized);
+
+    bst::test::benchmark("web::json::value::parse (1000 senders)", [&]
+    {
+        bst::test::do_not_optimize(web::json::value::parse(serialized));
+    });
+
+    bst::test::benchmark("web::json::experimental::parse_utf8 (1000 senders)", [&]
+    {
+        bst::test::do_not_optimize(web::json::experimental::parse_utf8(utf8));
+    });
+}
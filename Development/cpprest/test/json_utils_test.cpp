@@ -208,3 +208,229 @@ qux */ 42,
     // ho hum, turns out web::json::value::parse doesn't advertise the fact, but it actually handles single- and multi-line comments already...
     BST_REQUIRE_EQUAL(parsed, web::json::value::parse(example));
 }
+
+////////////////////////////////////////////////////////////////////////////////////////////
+BST_TEST_CASE(testSerializeCbor)
+{
+    using web::json::experimental::serialize_cbor;
+
+    // examples from https://tools.ietf.org/html/rfc7049#appendix-A
+    // except that numbers which are not integers are never encoded as half-precision floats
+    BST_REQUIRE_EQUAL(std::string("\x00", 1), serialize_cbor(J(0)));
+    BST_REQUIRE_EQUAL("\x17", serialize_cbor(J(23)));
+    BST_REQUIRE_EQUAL("\x18\x18", serialize_cbor(J(24)));
+    BST_REQUIRE_EQUAL("\x19\x03\xe8", serialize_cbor(J(1000)));
+    BST_REQUIRE_EQUAL(std::string("\x1a\x00\x0f\x42\x40", 5), serialize_cbor(J(1000000)));
+    BST_REQUIRE_EQUAL(std::string("\x1b\x00\x00\x00\xe8\xd4\xa5\x10\x00", 9), serialize_cbor(J(int64_t(1000000000000))));
+    BST_REQUIRE_EQUAL("\x20", serialize_cbor(J(-1)));
+    BST_REQUIRE_EQUAL("\x39\x03\xe7", serialize_cbor(J(-1000)));
+    BST_REQUIRE_EQUAL(std::string("\xfa\x3f\xc0\x00\x00", 5), serialize_cbor(J(1.5)));
+    BST_REQUIRE_EQUAL("\xfb\x3f\xf1\x99\x99\x99\x99\x99\x9a", serialize_cbor(J(1.1)));
+    BST_REQUIRE_EQUAL("\xf4", serialize_cbor(J(false)));
+    BST_REQUIRE_EQUAL("\xf5", serialize_cbor(J(true)));
+    BST_REQUIRE_EQUAL("\xf6", serialize_cbor(web::json::value::null()));
+    BST_REQUIRE_EQUAL("\x60", serialize_cbor(JU("")));
+    BST_REQUIRE_EQUAL("\x64\x49\x45\x54\x46", serialize_cbor(JU("IETF")));
+    BST_REQUIRE_EQUAL("\x83\x01\x02\x03", serialize_cbor(web::json::value_of({ 1, 2, 3 })));
+    BST_REQUIRE_EQUAL("\xa2\x61\x61\x01\x61\x62\x82\x02\x03", serialize_cbor(web::json::value_of({ { U("a"), 1 }, { U("b"), web::json::value_of({ 2, 3 }) } }, true)));
+
+    // concatenation of separately serialized elements
+    std::string cbor;
+    web::json::experimental::serialize_cbor_array_header(cbor, 2);
+    serialize_cbor(cbor, J(1));
+    serialize_cbor(cbor, JU("a"));
+    BST_REQUIRE_EQUAL("\x82\x01\x61\x61", cbor);
+}
+
+////////////////////////////////////////////////////////////////////////////////////////////
+BST_TEST_CASE(testSerializeUtf8)
+{
+    using web::json::experimental::serialize_utf8;
+
+    const auto value = web::json::value_of({
+        { U("non_composites"), non_composites },
+        { U("empty_composites"), empty_composites },
+        { U("integers"), web::json::value_of({ 0, -1, int64_t(-9223372036854775807 - 1), uint64_t(18446744073709551615ull) }) },
+        { U("numbers"), web::json::value_of({ 0.1, -1.5e-300, 1e300, 2.0 }) },
+        { U("escapes"), JU("\"quoted\" \\ \b\f\n\r\t \x01\x1f \x7f") },
+        { U("unicode"), web::json::value::string(utility::conversions::to_string_t("caf\xc3\xa9 \xe2\x82\xac")) },
+        { U("\"key\""), J(true) }
+    }, true);
+
+    // identical to the cpprestsdk serialization
+    BST_REQUIRE_EQUAL(utility::conversions::to_utf8string(value.serialize()), serialize_utf8(value));
+
+    // and the size can be calculated without serializing
+    BST_REQUIRE_EQUAL(serialize_utf8(value).size(), web::json::experimental::serialized_utf8_size(value));
+
+    // appending to a reused buffer, and filtering an array
+    std::string utf8("previous");
+    utf8.clear();
+    web::json::experimental::serialize_utf8_if(utf8, non_composites.as_array(), [](const web::json::value& element) { return !element.is_null(); }, [](const web::json::value& element) { return element; });
+    BST_REQUIRE_EQUAL(utility::conversions::to_utf8string(web::json::serialize_if(non_composites.as_array(), [](const web::json::value& element) { return !element.is_null(); })), utf8);
+}
+
+////////////////////////////////////////////////////////////////////////////////////////////
+BST_TEST_CASE(testCompiledMatchQuery)
+{
+    const auto value = web::json::value_of({
+        { U("id"), JU("3b8be755-08ff-452b-b217-c9151eb21193") },
+        { U("label"), JU("Example Node") },
+        { U("version"), JU("1441973902:879053935") },
+        { U("count"), 42 },
+        { U("services"), web::json::value_of({
+            web::json::value_of({ { U("type"), JU("urn:x-manufacturer:service:Alpha") }, { U("port"), 8080 } }),
+            web::json::value_of({ { U("type"), JU("urn:x-manufacturer:service:Beta") }, { U("port"), 8081 } })
+        }) },
+        { U("tags"), web::json::value::object() }
+    });
+
+    const std::vector<web::json::value> flat_queries{
+        web::json::value::object(),
+        web::json::value_of({ { U("label"), JU("Example Node") } }),
+        web::json::value_of({ { U("label"), JU("example node") } }),
+        web::json::value_of({ { U("label"), JU("Node") } }),
+        web::json::value_of({ { U("label"), JU("NODE") } }),
+        web::json::value_of({ { U("label"), JU("") } }),
+        web::json::value_of({ { U("count"), JU("42") } }),
+        web::json::value_of({ { U("count"), 42 } }),
+        web::json::value_of({ { U("count"), JU("\"42\"") } }),
+        web::json::value_of({ { U("services.port"), JU("8081") } }),
+        web::json::value_of({ { U("services.type"), JU("beta") } }),
+        web::json::value_of({ { U("services.type"), JU("beta") }, { U("services.port"), JU("8080") } }),
+        web::json::value_of({ { U("services.type"), JU("urn:x-manufacturer:service:Beta") }, { U("services.port"), JU("8081") } }),
+        web::json::value_of({ { U("tags"), JU("{}") } }),
+        web::json::value_of({ { U("missing"), JU("foo") } }),
+        web::json::value_of({ { U("label.missing"), JU("foo") } })
+    };
+
+    for (const auto& flat_query : flat_queries)
+    {
+        const auto query = web::json::unflatten(flat_query);
+        for (auto match_flags : { web::json::match_default, web::json::match_substr, web::json::match_icase, web::json::match_substr | web::json::match_icase })
+        {
+            BST_REQUIRE_EQUAL(web::json::match_query(value, query, match_flags), web::json::compiled_match_query(query, match_flags)(value));
+        }
+    }
+
+    BST_REQUIRE(web::json::compiled_match_query()(value));
+}
+
+////////////////////////////////////////////////////////////////////////////////////////////
+BST_TEST_CASE(testShrinkToFit)
+{
+    auto value = web::json::value::parse(U(R"-({"id": "3b8be755-08ff-452b-b217-c9151eb21193", "tags": {"location": ["Salford", "London"]}, "count": 42})-"));
+    const auto expected = value;
+    for (int i = 0; i < 3; ++i) web::json::push_back(value[U("tags")][U("location")], JU("Manchester"));
+    for (int i = 0; i < 3; ++i) web::json::pop_back(value[U("tags")][U("location")]);
+
+    web::json::shrink_to_fit(value);
+    BST_REQUIRE_EQUAL(expected, value);
+
+    auto& storage = web::json::storage_of(value.at(U("tags")).at(U("location")).as_array());
+    BST_REQUIRE_EQUAL(storage.size(), storage.capacity());
+}
+
+////////////////////////////////////////////////////////////////////////////////////////////
+BST_TEST_CASE(testFieldAccessorPosition)
+{
+    const web::json::field_as_string label{ U("label") };
+    const web::json::field_as_integer_or count{ U("count"), 0 };
+
+    const auto value1 = web::json::value_of({ { U("id"), U("1") }, { U("label"), U("one") }, { U("count"), 1 } });
+    const auto value2 = web::json::value_of({ { U("label"), U("two") } });
+    const auto value3 = web::json::value_of({ { U("count"), 3 }, { U("id"), U("3") }, { U("label"), U("three") } }, true);
+
+    // the hinted position is just an optimisation, so the results must be the same whether or not the key is found there
+    for (int i = 0; i < 2; ++i)
+    {
+        BST_REQUIRE_EQUAL(U("one"), label(value1));
+        BST_REQUIRE_EQUAL(U("two"), label(value2));
+        BST_REQUIRE_EQUAL(U("three"), label(value3));
+        BST_REQUIRE_EQUAL(1, count(value1));
+        BST_REQUIRE_EQUAL(0, count(value2));
+        BST_REQUIRE_EQUAL(3, count(value3));
+    }
+
+    BST_REQUIRE_THROW(web::json::field_as_string{ U("missing") }(value1), web::json::json_exception);
+    BST_REQUIRE_THROW(label(web::json::value::null()), web::json::json_exception);
+
+    // accessors are still copyable
+    auto copy = label;
+    BST_REQUIRE_EQUAL(U("one"), copy(value1));
+}
+
+////////////////////////////////////////////////////////////////////////////////////////////
+BST_TEST_CASE(testParseUtf8)
+{
+    const std::string texts[] = {
+        R"-({"id": "3b8be755-08ff-452b-b217-c9151eb21193", "tags": {"location": ["Salford", "London"]}, "count": 42})-",
+        R"-( [null, true, false, -42, 1.5e3, 18446744073709551615, 0.1] )-",
+        R"-({"escaped": "\"\\\/\b\f\n\r\t\u00e9\u20ac\ud83d\ude00", "unescaped": "caf)-" "\xC3\xA9" R"-("})-",
+        R"-({})-",
+        R"-("")-"
+    };
+    for (const auto& text : texts)
+    {
+        BST_REQUIRE_EQUAL(web::json::value::parse(utility::conversions::to_string_t(text)), web::json::experimental::parse_utf8(text));
+    }
+
+    const std::string invalid[] = { "", "{", "[1,]", "{\"a\" 1}", "01", "1.", "tru", "\"\\x\"", "\"\\ud83d\"", "\"\x01\"", "[] []" };
+    for (const auto& text : invalid)
+    {
+        BST_REQUIRE_THROW(web::json::experimental::parse_utf8(text), web::json::json_exception);
+    }
+
+    // the nesting is limited, rather than overflowing the stack
+    BST_REQUIRE_THROW(web::json::experimental::parse_utf8(std::string(100000, '[')), web::json::json_exception);
+
+    // long strings and runs of whitespace are scanned a word at a time, so check the end of each run at every offset within a word
+    for (size_t n = 0; n < 24; ++n)
+    {
+        const std::string run(n, 'x');
+        const std::string indent(n, ' ');
+        const std::string text = "{" + indent + "\"" + run + "\"" + indent + ":" + indent + "[\"" + run + "\\n" + run + "\", \"" + run + "\xC3\xA9" + run + "\"]" + indent + "}";
+        BST_REQUIRE_EQUAL(web::json::value::parse(utility::conversions::to_string_t(text)), web::json::experimental::parse_utf8(text));
+
+        BST_REQUIRE_THROW(web::json::experimental::parse_utf8("\"" + run + "\x01" + run + "\""), web::json::json_exception);
+        BST_REQUIRE_THROW(web::json::experimental::parse_utf8("\"" + run), web::json::json_exception);
+    }
+}
+
+////////////////////////////////////////////////////////////////////////////////////////////
+BST_TEST_CASE(testMakePatch)
+{
+    using web::json::value;
+    using web::json::value_of;
+
+    const auto pre = value_of({
+        { U("id"), U("a") },
+        { U("subscription"), value_of({ { U("active"), false }, { U("sender_id"), value::null() } }) },
+        { U("tags"), value_of({ { U("a/b~c"), value_of({ U("1"), U("2") }) } }) },
+        { U("version"), U("1:0") }
+    });
+    const auto post = value_of({
+        { U("id"), U("a") },
+        { U("label"), U("x") },
+        { U("subscription"), value_of({ { U("active"), true }, { U("sender_id"), U("s") } }) },
+        { U("tags"), value_of({ { U("a/b~c"), value_of({ U("1"), U("3") }) } }) }
+    });
+
+    // only the differences, with the reference tokens of the paths escaped
+    const auto expected = value_of({
+        value_of({ { U("op"), U("remove") }, { U("path"), U("/version") } }),
+        value_of({ { U("op"), U("add") }, { U("path"), U("/label") }, { U("value"), U("x") } }),
+        value_of({ { U("op"), U("replace") }, { U("path"), U("/subscription/active") }, { U("value"), true } }),
+        value_of({ { U("op"), U("replace") }, { U("path"), U("/subscription/sender_id") }, { U("value"), U("s") } }),
+        value_of({ { U("op"), U("replace") }, { U("path"), U("/tags/a~1b~0c/1") }, { U("value"), U("3") } })
+    });
+    BST_REQUIRE_EQUAL(expected, web::json::experimental::make_patch(pre, post));
+
+    // no differences
+    BST_REQUIRE_EQUAL(value::array(), web::json::experimental::make_patch(pre, pre));
+
+    // arrays whose size has changed, and values of different types, are replaced entirely
+    const auto longer = value_of({ U("1"), U("2"), U("3") });
+    BST_REQUIRE_EQUAL(value_of({ value_of({ { U("op"), U("replace") }, { U("path"), U("") }, { U("value"), longer } }) }), web::json::experimental::make_patch(pre.at(U("tags")).at(U("a/b~c")), longer));
+    BST_REQUIRE_EQUAL(value_of({ value_of({ { U("op"), U("replace") }, { U("path"), U("") }, { U("value"), 42 } }) }), web::json::experimental::make_patch(pre, value::number(42)));
+}
@@ -0,0 +1,166 @@
+// The first "test" is of course whether the header compiles standalone
+#include "cpprest/json_validator.h"
+
+#include "bst/test/test.h"
+#include "cpprest/json.h"
+
+namespace
+{
+    const web::uri node_schema_uri(U("https://example.com/schemas/node.json"));
+    const web::uri definitions_schema_uri(U("https://example.com/schemas/definitions.json"));
+
+    const auto node_schema = web::json::value::parse(U(R"-({
+        "$schema": "http://json-schema.org/draft-04/schema#",
+        "type": "object",
+        "required": ["id", "label", "services"],
+        "additionalProperties": false,
+        "properties": {
+            "id": { "$ref": "definitions.json#/definitions/uuid" },
+            "label": { "type": "string", "maxLength": 8 },
+            "href": { "type": "string", "format": "uri" },
+            "services": {
+                "type": "array",
+                "uniqueItems": true,
+                "items": {
+                    "oneOf": [
+                        { "type": "object", "required": ["type"], "properties": { "type": { "enum": ["urn:x-nmos:service:alpha"] } } },
+                        { "type": "object", "required": ["type", "port"], "properties": { "type": { "enum": ["urn:x-nmos:service:beta"] }, "port": { "type": "integer", "minimum": 1, "maximum": 65535 } } }
+                    ]
+                }
+            }
+        }
+    })-"));
+
+    const auto definitions_schema = web::json::value::parse(U(R"-({
+        "$schema": "http://json-schema.org/draft-04/schema#",
+        "definitions": {
+            "uuid": { "type": "string", "pattern": "^[0-9a-f]{8}-[0-9a-f]{4}-[1-5][0-9a-f]{3}-[89ab][0-9a-f]{3}-[0-9a-f]{12}$" }
+        }
+    })-"));
+
+    web::json::value load_schema(const web::uri& id)
+    {
+        if (node_schema_uri == id) return node_schema;
+        if (definitions_schema_uri == id) return definitions_schema;
+        throw web::json::json_exception(U("schema not found"));
+    }
+
+    const auto valid_node = web::json::value::parse(U(R"-({
+        "id": "3b8be755-08ff-452b-b217-c9151eb21193",
+        "label": "node",
+        "href": "http://example.com/",
+        "services": [
+            { "type": "urn:x-nmos:service:alpha" },
+            { "type": "urn:x-nmos:service:beta", "port": 8080 }
+        ]
+    })-"));
+}
+
+////////////////////////////////////////////////////////////////////////////////////////////
+BST_TEST_CASE(testValidateValid)
+{
+    const web::json::experimental::json_validator validator(load_schema, { node_schema_uri });
+
+    validator.validate(valid_node, node_schema_uri);
+}
+
+////////////////////////////////////////////////////////////////////////////////////////////
+BST_TEST_CASE(testValidateInvalid)
+{
+    const web::json::experimental::json_validator validator(load_schema, { node_schema_uri });
+
+    using web::json::json_exception;
+
+    // missing required property
+    {
+        auto node = valid_node;
+        node.erase(U("label"));
+        BST_REQUIRE_THROW(validator.validate(node, node_schema_uri), json_exception);
+    }
+
+    // unexpected additional property
+    {
+        auto node = valid_node;
+        node[U("foo")] = web::json::value::string(U("bar"));
+        BST_REQUIRE_THROW(validator.validate(node, node_schema_uri), json_exception);
+    }
+
+    // pattern, via a reference to a definition in another document
+    {
+        auto node = valid_node;
+        node[U("id")] = web::json::value::string(U("not-a-uuid"));
+        BST_REQUIRE_THROW(validator.validate(node, node_schema_uri), json_exception);
+    }
+
+    // maxLength
+    {
+        auto node = valid_node;
+        node[U("label")] = web::json::value::string(U("too long a label"));
+        BST_REQUIRE_THROW(validator.validate(node, node_schema_uri), json_exception);
+    }
+
+    // format
+    {
+        auto node = valid_node;
+        node[U("href")] = web::json::value::string(U("not a uri"));
+        BST_REQUIRE_THROW(validator.validate(node, node_schema_uri), json_exception);
+    }
+
+    // oneOf, type and maximum
+    {
+        auto node = valid_node;
+        node[U("services")][1][U("port")] = 65536;
+        BST_REQUIRE_THROW(validator.validate(node, node_schema_uri), json_exception);
+        node[U("services")][1][U("port")] = 80.5;
+        BST_REQUIRE_THROW(validator.validate(node, node_schema_uri), json_exception);
+        node[U("services")][1][U("type")] = web::json::value::string(U("urn:x-nmos:service:gamma"));
+        node[U("services")][1][U("port")] = 80;
+        BST_REQUIRE_THROW(validator.validate(node, node_schema_uri), json_exception);
+    }
+
+    // uniqueItems
+    {
+        auto node = valid_node;
+        node[U("services")][1] = node[U("services")][0];
+        BST_REQUIRE_THROW(validator.validate(node, node_schema_uri), json_exception);
+    }
+
+    // unknown schema
+    BST_REQUIRE_THROW(validator.validate(valid_node, definitions_schema_uri), json_exception);
+}
+
+////////////////////////////////////////////////////////////////////////////////////////////
+BST_TEST_CASE(testValidateErrorLocation)
+{
+    const web::json::experimental::json_validator validator(load_schema, { node_schema_uri });
+
+    auto node = valid_node;
+    node[U("services")][1][U("port")] = 0;
+
+    try
+    {
+        validator.validate(node, node_schema_uri);
+        BST_REQUIRE(false);
+    }
+    catch (const web::json::json_exception& e)
+    {
+        const std::string what(e.what());
+        BST_REQUIRE_EQUAL(0, what.find("schema validation failed at /services/1/port - "));
+    }
+}
+
+////////////////////////////////////////////////////////////////////////////////////////////
+BST_TEST_CASE(testValidateLoadsSchemasOnFirstUse)
+{
+    int loads = 0;
+    const web::json::experimental::json_validator validator([&loads](const web::uri& id) { ++loads; return load_schema(id); }, { node_schema_uri });
+    BST_REQUIRE_EQUAL(0, loads);
+
+    validator.validate(valid_node, node_schema_uri);
+    const auto first_loads = loads;
+    BST_REQUIRE(0 < first_loads);
+
+    // the compiled schema is reused
+    validator.validate(valid_node, node_schema_uri);
+    BST_REQUIRE_EQUAL(first_loads, loads);
+}
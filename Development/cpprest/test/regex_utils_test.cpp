@@ -50,3 +50,72 @@ BST_TEST_CASE(testParseRegexNamedSubMatchesWithTrickiness)
     BST_REQUIRE_EQUAL(2, actual.second.at(U("foo")));
     BST_REQUIRE_EQUAL(3, actual.second.at(U("baz")));
 }
+
+////////////////////////////////////////////////////////////////////////////////////////////
+BST_TEST_CASE(testSimpleRegex)
+{
+    const auto uuid = utility::make_named_sub_match(U("uuid"), U("[0-9a-f]{8}-[0-9a-f]{4}-[1-5][0-9a-f]{3}-[89ab][0-9a-f]{3}-[0-9a-f]{12}"));
+    const auto version = utility::make_named_sub_match(U("version"), U("v[0-9]+\\.[0-9]+"));
+    const auto type = utility::make_named_sub_match(U("type"), U("nodes|devices|senders"));
+
+    const std::vector<utility::string_t> patterns{
+        U("/?"), U(".*"), U("/x-nmos/") + version, U("/") + type + U("/") + uuid + U("/?"), U("/") + type + U("/?") + uuid,
+        U("(/.+)"), U("a(b|bc)c"), U("(a|ab)(c|bcd)(d*)"), U("x{2,3}y"), U("x{2,}"), U("[^/]+/[a-c\\-]*"), U("(?:ab|a)b?"), U("\\d+\\.\\d*"), U("a?a?aa")
+    };
+    const std::vector<utility::string_t> paths{
+        U(""), U("/"), U("/x-nmos/"), U("/x-nmos/v1.3"), U("/x-nmos/v1.3/self"), U("/nodes/3b8be755-08ff-452b-b217-c9151eb21193"), U("/senders/3b8be755-08ff-452b-b217-c9151eb21193/"),
+        U("/nodes3b8be755-08ff-452b-b217-c9151eb21193"), U("/flows/3b8be755-08ff-452b-b217-c9151eb21193"), U("abcc"), U("abc"), U("abcd"), U("abcdd"),
+        U("xx"), U("xxxy"), U("xxxxy"), U("foo/a-b"), U("foo/"), U("ab"), U("abb"), U("12."), U("1.5"), U("aa"), U("aaa"), U("aaaaa"),
+        // non-ASCII characters aren't in the bitmap of each character set
+        U("/caf\xC3\xA9"), U("\xC3\xA9/b-")
+    };
+
+    // the results should be identical to those of the general regex engine
+    for (const auto& pattern : patterns)
+    {
+        const auto parsed = utility::parse_regex_named_sub_matches(pattern);
+        const utility::regex_t regex(parsed.first);
+        utility::simple_regex_t simple;
+        BST_REQUIRE(simple.assign(parsed.first));
+        BST_REQUIRE_EQUAL(regex.mark_count(), simple.mark_count());
+
+        for (const auto& path : paths)
+        {
+            for (bool prefix : { false, true })
+            {
+                utility::smatch_t expected;
+                const bool expected_match = prefix
+                    ? bst::regex_search(path, expected, regex, bst::regex_constants::match_continuous)
+                    : bst::regex_match(path, expected, regex);
+
+                utility::simple_sub_matches_t actual;
+                BST_REQUIRE_EQUAL(expected_match, simple.match(path, actual, prefix));
+                if (!expected_match) continue;
+
+                BST_REQUIRE_EQUAL(expected.size(), actual.size());
+                for (size_t i = 0; i < expected.size(); ++i)
+                {
+                    BST_REQUIRE_EQUAL(expected[i].matched, utility::simple_regex_t::npos != actual[i].first);
+                    if (!expected[i].matched) continue;
+                    BST_REQUIRE_EQUAL(size_t(expected[i].first - path.begin()), actual[i].first);
+                    BST_REQUIRE_EQUAL(size_t(expected[i].second - path.begin()), actual[i].second);
+                }
+            }
+        }
+    }
+
+    // other regular expressions are not supported
+    for (const auto& unsupported : { U("^a"), U("a$"), U("(a)?"), U("a*?"), U("(?=a)"), U("\\w"), U("[]"), U("a{"), U("(a") })
+    {
+        utility::simple_regex_t simple;
+        BST_REQUIRE(!simple.assign(unsupported));
+        BST_REQUIRE(simple.empty());
+    }
+
+    // literal prefix
+    {
+        utility::simple_regex_t simple;
+        BST_REQUIRE(simple.assign(U("/x-nmos/(node|query)/?")));
+        BST_REQUIRE_STRING_EQUAL("/x-nmos/", utility::us2s(simple.literal_prefix()));
+    }
+}
@@ -5,6 +5,8 @@
 
 #include <functional>
 #include <memory>
+#include <string>
+#include <vector>
 
 #if !defined(_WIN32) || !defined(__cplusplus_winrt)
 #if defined(__clang__)
@@ -41,6 +43,7 @@ namespace web
                 namespace details
                 {
                     class websocket_listener_impl;
+                    struct websocket_shared_message_impl;
                 }
 
                 // opaque websocket connection id
@@ -62,6 +65,24 @@ namespace web
                 inline bool operator> (const connection_id& lhs, const connection_id& rhs) { return  (rhs < lhs); }
                 inline bool operator<=(const connection_id& lhs, const connection_id& rhs) { return !(rhs < lhs); }
 
+                // experimental extension, an immutable message which can be sent on many connections, e.g. the same grain to all the websocket
+                // connections to a subscription, without the payload being copied into a websocketpp message for each one
+                // the message is only framed once, uncompressed, so on a connection which negotiated the permessage-deflate extension, a message
+                // at or above the compression threshold is still copied and compressed for that connection, unless compression is disabled
+                class websocket_shared_message
+                {
+                public:
+                    websocket_shared_message() {} // = default
+                    explicit websocket_shared_message(std::string payload, websocket_message_type type = websocket_message_type::text_message);
+
+                    // the size of the payload in bytes
+                    size_t size() const;
+
+                private:
+                    std::shared_ptr<details::websocket_shared_message_impl> impl;
+                    friend class details::websocket_listener_impl;
+                };
+
                 // a validate handler gets the resource path and returns a flag indicating whether to accept the connection or not
                 // the default validate handler accepts all connections
                 typedef std::function<bool(const utility::string_t&)> validate_handler;
@@ -80,7 +101,14 @@ namespace web
                 class websocket_listener_config
                 {
                 public:
-                    websocket_listener_config() : m_backlog(0) {}
+                    websocket_listener_config()
+                        : m_backlog(0)
+                        , m_thread_pool_size(1)
+                        , m_compression_threshold(0)
+#if !defined(_WIN32) || !defined(__cplusplus_winrt)
+                        , m_io_service(nullptr)
+#endif
+                    {}
 
                     const web::logging::experimental::log_handler& get_log_callback() const
                     {
@@ -102,6 +130,53 @@ namespace web
                         m_backlog = backlog;
                     }
 
+                    // number of threads used to run the listener's io service, e.g. to perform TLS handshakes and frame writes for many connections concurrently
+                    // note, handlers may therefore be called concurrently for different connections
+                    int thread_pool_size() const
+                    {
+                        return m_thread_pool_size;
+                    }
+
+                    void set_thread_pool_size(int thread_pool_size)
+                    {
+                        m_thread_pool_size = thread_pool_size;
+                    }
+
+                    // function called on each of the listener's own threads (see thread_pool_size) before it runs the io service, e.g. to set the CPU affinity or priority of the thread, or an empty function
+                    const std::function<void()>& get_thread_init_callback() const
+                    {
+                        return m_thread_init_callback;
+                    }
+
+                    void set_thread_init_callback(const std::function<void()>& thread_init_callback)
+                    {
+                        m_thread_init_callback = thread_init_callback;
+                    }
+
+                    // minimum size in bytes of messages to be compressed, when the permessage-deflate extension has been negotiated with the client
+                    // note, the extension is only available when built with CPPREST_WEBSOCKETS_PERMESSAGE_DEFLATE
+                    size_t compression_threshold() const
+                    {
+                        return m_compression_threshold;
+                    }
+
+                    void set_compression_threshold(size_t compression_threshold)
+                    {
+                        m_compression_threshold = compression_threshold;
+                    }
+
+                    // subprotocols supported by the server, in order of preference; during the opening handshake, the most preferred of those
+                    // requested by the client is selected, or none if the client requested none of these
+                    const std::vector<utility::string_t>& subprotocols() const
+                    {
+                        return m_subprotocols;
+                    }
+
+                    void set_subprotocols(std::vector<utility::string_t> subprotocols)
+                    {
+                        m_subprotocols = std::move(subprotocols);
+                    }
+
 #if !defined(_WIN32) || !defined(__cplusplus_winrt)
                     const ssl_context_callback& get_ssl_context_callback() const
                     {
@@ -112,13 +187,30 @@ namespace web
                     {
                         m_ssl_context_callback = ssl_context_callback;
                     }
+
+                    // io service on which to run the listener, e.g. one shared with other listeners, instead of its own threads (see thread_pool_size), or nullptr
+                    // note, the io service must be run by its owner until the listener has been closed
+                    boost::asio::io_service* io_service() const
+                    {
+                        return m_io_service;
+                    }
+
+                    void set_io_service(boost::asio::io_service* io_service)
+                    {
+                        m_io_service = io_service;
+                    }
 #endif
 
                 private:
                     web::logging::experimental::log_handler m_log_callback;
                     int m_backlog;
+                    int m_thread_pool_size;
+                    std::function<void()> m_thread_init_callback;
+                    size_t m_compression_threshold;
+                    std::vector<utility::string_t> m_subprotocols;
 #if !defined(_WIN32) || !defined(__cplusplus_winrt)
                     ssl_context_callback m_ssl_context_callback;
+                    boost::asio::io_service* m_io_service;
 #endif
                 };
 
@@ -144,6 +236,19 @@ namespace web
                     pplx::task<void> close(websocket_close_status close_status, const utility::string_t& close_reason = _XPLATSTR(""));
 
                     pplx::task<void> send(const connection_id& connection, websocket_outgoing_message message);
+                    // send a message, optionally disabling compression, e.g. for small messages which would not benefit
+                    pplx::task<void> send(const connection_id& connection, websocket_outgoing_message message, bool compress);
+                    // send a shared message, see websocket_shared_message
+                    pplx::task<void> send(const connection_id& connection, const websocket_shared_message& message);
+                    pplx::task<void> send(const connection_id& connection, const websocket_shared_message& message, bool compress);
+
+                    // get the number of bytes of messages that have been sent on an individual connection, but not yet written to the network,
+                    // e.g. in order to detect a slow consumer; returns zero if the connection is no longer open
+                    size_t buffered_amount(const connection_id& connection);
+
+                    // get the subprotocol selected for an individual connection, or an empty string if none was selected
+                    // or the connection is no longer open
+                    utility::string_t subprotocol(const connection_id& connection);
 
                     websocket_listener(websocket_listener&& other);
                     websocket_listener& operator=(websocket_listener&& other);
@@ -1,7 +1,12 @@
 #include "cpprest/ws_listener.h"
 
+#include <algorithm>
+#include <condition_variable>
+#include <future>
 #include <mutex>
 #include <set>
+#include <typeinfo>
+#include <vector>
 #include "detail/pragma_warnings.h"
 #include "detail/private_access.h"
 
@@ -18,6 +23,9 @@ __pragma(warning(disable:4701)) // e.g. potentially uninitialized local variable
 #include "websocketpp/config/asio.hpp"
 #include "websocketpp/logger/levels.hpp"
 #include "websocketpp/server.hpp"
+#if defined(CPPREST_WEBSOCKETS_PERMESSAGE_DEFLATE)
+#include "websocketpp/extensions/permessage_deflate/enabled.hpp"
+#endif
 PRAGMA_WARNING_POP
 
 #include "cpprest/asyncrt_utils.h" // for utility::conversions
@@ -145,6 +153,13 @@ namespace web
                         // reminder: these compile-time filters can be adjusted
                         static const websocketpp::log::level elog_level = base::elog_level;
                         static const websocketpp::log::level alog_level = base::alog_level;
+
+#if defined(CPPREST_WEBSOCKETS_PERMESSAGE_DEFLATE)
+                        // enable negotiation of the permessage-deflate extension
+                        // see https://tools.ietf.org/html/rfc7692
+                        struct permessage_deflate_config {};
+                        typedef websocketpp::extensions::permessage_deflate::enabled<permessage_deflate_config> permessage_deflate_type;
+#endif
                     };
 
                     typedef websocketpp_config<websocketpp::config::asio> ws_config;
@@ -154,6 +169,7 @@ namespace web
                     void set_tls_init_handler(websocketpp::server<wss_config>& server, websocketpp::transport::asio::tls_socket::tls_init_handler handler) { server.set_tls_init_handler(handler); }
 
                     struct websocket_outgoing_message_body { typedef concurrency::streams::streambuf<uint8_t>(websocket_outgoing_message::*type); };
+                    struct websocket_outgoing_message_msg_type { typedef websocket_message_type(websocket_outgoing_message::*type); };
                     struct websocket_incoming_message_body { typedef concurrency::streams::container_buffer<std::string>(websocket_incoming_message::*type); };
                     struct websocket_incoming_message_msg_type { typedef websocket_message_type(websocket_incoming_message::*type); };
 
@@ -162,6 +178,25 @@ namespace web
                         return message.*detail::stowed<websocket_outgoing_message_body>::value;
                     }
 
+                    websocket_message_type get_message_type(websocket_outgoing_message& message)
+                    {
+                        return message.*detail::stowed<websocket_outgoing_message_msg_type>::value;
+                    }
+
+                    // the payload of a shared message, and the websocketpp message framed from it, once it has been sent uncompressed
+                    struct websocket_shared_message_impl
+                    {
+                        websocket_shared_message_impl(std::string payload, websocket_message_type type) : payload(std::move(payload)), type(type) {}
+
+                        const std::string payload;
+                        const websocket_message_type type;
+
+                        // type-erased, since the websocketpp message pointer type depends on the config, so only the first type to be prepared is kept
+                        std::mutex mutex;
+                        std::shared_ptr<void> prepared;
+                        const std::type_info* prepared_type = nullptr;
+                    };
+
                     static std::string build_error_msg(const std::error_code& ec, const std::string& location)
                     {
                         std::stringstream ss;
@@ -218,7 +253,10 @@ namespace web
                         virtual pplx::task<void> open() = 0;
                         virtual pplx::task<void> close(const connection_id& connection, websocket_close_status close_status, const utility::string_t& close_reason) = 0;
                         virtual pplx::task<void> close(websocket_close_status close_status, const utility::string_t& close_reason) = 0;
-                        virtual pplx::task<void> send(const connection_id& connection, websocket_outgoing_message message) = 0;
+                        virtual pplx::task<void> send(const connection_id& connection, websocket_outgoing_message message, bool compress) = 0;
+                        virtual pplx::task<void> send(const connection_id& connection, const websocket_shared_message& message, bool compress) = 0;
+                        virtual size_t buffered_amount(const connection_id& connection) = 0;
+                        virtual utility::string_t subprotocol(const connection_id& connection) = 0;
 
                     protected:
                         // extend friendship with connection_id to derived classes
@@ -230,6 +268,11 @@ namespace web
                         {
                             return connection.hdl;
                         }
+                        // extend friendship with websocket_shared_message to derived classes
+                        static std::shared_ptr<websocket_shared_message_impl> impl_from_message(const websocket_shared_message& message)
+                        {
+                            return message.impl;
+                        }
 
                         static void check_uri(const web::uri& address)
                         {
@@ -299,10 +342,27 @@ namespace web
 
                             try
                             {
-                                server.init_asio();
-                                server.start_perpetual();
-                                // hmm, is one thread enough?
-                                thread = std::thread(&server_t::run, &server);
+                                if (nullptr != configuration().io_service())
+                                {
+                                    // the io service is run by its owner, e.g. on the threads shared by all the listeners
+                                    server.init_asio(configuration().io_service());
+                                }
+                                else
+                                {
+                                    server.init_asio();
+                                    server.start_perpetual();
+                                    // websocketpp uses a strand per connection, so the io service may be run on multiple threads
+                                    const auto thread_pool_size = (std::max)(configuration().thread_pool_size(), 1);
+                                    const auto thread_init = configuration().get_thread_init_callback();
+                                    for (int i = 0; i < thread_pool_size; ++i)
+                                    {
+                                        threads.push_back(std::thread([this, thread_init]
+                                        {
+                                            if (thread_init) thread_init();
+                                            server.run();
+                                        }));
+                                    }
+                                }
 
                                 using websocketpp::lib::bind;
                                 using websocketpp::lib::placeholders::_1;
@@ -394,11 +454,11 @@ namespace web
                                     server.stop_listening();
                                 }
 
+                                // the connections are removed by handle_close, so that stop_threads can wait for them to finish closing
                                 connections_t cons;
                                 {
                                     std::lock_guard<std::mutex> lock(mutex);
-                                    using std::swap;
-                                    swap(cons, connections);
+                                    cons = connections;
                                 }
 
                                 const auto reason = utility::conversions::to_utf8string(close_reason);
@@ -414,26 +474,20 @@ namespace web
                             }
                             catch (const websocketpp::exception& e)
                             {
-                                server.stop_perpetual();
-                                if (thread.joinable())
-                                {
-                                    thread.join();
-                                }
+                                stop_threads();
                                 return pplx::task_from_exception<void>(websocket_exception(e.code(), build_error_msg(e.code(), "close")));
                             }
 
-                            server.stop_perpetual();
-                            if (thread.joinable())
-                            {
-                                thread.join();
-                            }
+                            stop_threads();
                             return pplx::task_from_result();
                         }
 
-                        pplx::task<void> send(const connection_id& connection, websocket_outgoing_message message)
+                        pplx::task<void> send(const connection_id& connection, websocket_outgoing_message message, bool compress)
                         {
                             // right now, this implementation is only tested to work with simple UTF-8 text messages
                             // message.set_utf8_message("body");
+                            // and binary messages from a container buffer
+                            // message.set_binary_message(concurrency::streams::container_buffer<std::string>("body").create_istream());
 
                             auto body = get_message_body(message);
                             uint8_t* ptr = nullptr;
@@ -446,8 +500,15 @@ namespace web
 
                             try
                             {
-                                // send will throw if the connection_hdl isn't valid
-                                server.send(hdl_from_id(connection), ptr, count, websocketpp::frame::opcode::text);
+                                // get_con_from_hdl will throw if the connection_hdl isn't valid
+                                const auto con = server.get_con_from_hdl(hdl_from_id(connection));
+                                const auto opcode = websocket_message_type::binary_message == get_message_type(message) ? websocketpp::frame::opcode::binary : websocketpp::frame::opcode::text;
+                                auto msg = con->get_message(opcode, count);
+                                msg->append_payload(ptr, count);
+                                // compression only actually happens if the permessage-deflate extension has been negotiated
+                                msg->set_compressed(compress && configuration().compression_threshold() <= count);
+                                const auto ec = con->send(msg);
+                                if (ec) throw websocketpp::exception(ec);
                             }
                             catch (const websocketpp::exception& e)
                             {
@@ -459,8 +520,119 @@ namespace web
                             return pplx::task_from_result();
                         }
 
+                        pplx::task<void> send(const connection_id& connection, const websocket_shared_message& message, bool compress)
+                        {
+                            const auto shared = impl_from_message(message);
+                            if (!shared || shared->payload.empty())
+                            {
+                                return pplx::task_from_exception<void>(websocket_exception("Invalid message body"));
+                            }
+
+                            try
+                            {
+                                // get_con_from_hdl will throw if the connection_hdl isn't valid
+                                const auto con = server.get_con_from_hdl(hdl_from_id(connection));
+                                const auto opcode = websocket_message_type::binary_message == shared->type ? websocketpp::frame::opcode::binary : websocketpp::frame::opcode::text;
+                                const auto count = shared->payload.size();
+
+                                // compression only actually happens if the permessage-deflate extension has been negotiated, and then needs a message for this connection
+                                // likewise for the obsolete hixie-76 (hybi-00) protocol version, which has no Sec-WebSocket-Version header, and a different framing
+                                const bool compressed = compress && configuration().compression_threshold() <= count
+                                    && std::string::npos != con->get_response_header("Sec-WebSocket-Extensions").find("permessage-deflate");
+                                const bool framed = !compressed && !con->get_request_header("Sec-WebSocket-Version").empty();
+
+                                message_ptr msg;
+                                if (framed)
+                                {
+                                    msg = get_prepared_message(*shared, *con, opcode);
+                                }
+                                else
+                                {
+                                    msg = con->get_message(opcode, count);
+                                    msg->append_payload(shared->payload);
+                                    msg->set_compressed(compressed);
+                                }
+                                const auto ec = con->send(msg);
+                                if (ec) throw websocketpp::exception(ec);
+                            }
+                            catch (const websocketpp::exception& e)
+                            {
+                                return pplx::task_from_exception<void>(websocket_exception(e.code(), build_error_msg(e.code(), "send")));
+                            }
+
+                            return pplx::task_from_result();
+                        }
+
+                        size_t buffered_amount(const connection_id& connection)
+                        {
+                            websocketpp::lib::error_code ec;
+                            const auto con = server.get_con_from_hdl(hdl_from_id(connection), ec);
+                            return !ec && con ? con->get_buffered_amount() : 0;
+                        }
+
+                        utility::string_t subprotocol(const connection_id& connection)
+                        {
+                            websocketpp::lib::error_code ec;
+                            const auto con = server.get_con_from_hdl(hdl_from_id(connection), ec);
+                            return !ec && con ? utility::conversions::to_string_t(con->get_subprotocol()) : utility::string_t{};
+                        }
+
                     private:
                         typedef websocketpp::server<WsppConfig> server_t;
+                        typedef typename server_t::message_ptr message_ptr;
+
+                        // get the message framed from the shared payload, which is the same for every connection since a server never masks its frames,
+                        // so websocketpp queues the same message for each connection, rather than copying the payload into a new frame
+                        static message_ptr get_prepared_message(websocket_shared_message_impl& shared, typename server_t::connection_type& con, websocketpp::frame::opcode::value opcode)
+                        {
+                            std::lock_guard<std::mutex> lock(shared.mutex);
+                            if (shared.prepared && typeid(message_ptr) == *shared.prepared_type)
+                            {
+                                return *std::static_pointer_cast<message_ptr>(shared.prepared);
+                            }
+
+                            const auto count = shared.payload.size();
+                            auto msg = con.get_message(opcode, count);
+                            msg->set_header(websocketpp::frame::prepare_header(websocketpp::frame::basic_header(opcode, count, true, false), websocketpp::frame::extended_header(count)));
+                            msg->append_payload(shared.payload);
+                            msg->set_prepared(true);
+
+                            if (!shared.prepared)
+                            {
+                                shared.prepared = std::make_shared<message_ptr>(msg);
+                                shared.prepared_type = &typeid(message_ptr);
+                            }
+                            return msg;
+                        }
+
+                        void stop_threads()
+                        {
+                            if (nullptr != configuration().io_service())
+                            {
+                                // the handlers of this listener may still be pending on an io service that outlives it, so wait (for a little while)
+                                // for the connections to finish closing, and then for the handlers that were queued when it stopped listening
+                                std::unique_lock<std::mutex> lock(mutex);
+                                connections_closed.wait_for(lock, std::chrono::milliseconds(WsppConfig::timeout_close_handshake), [&] { return connections.empty(); });
+
+                                lock.unlock();
+
+                                // the promise is shared with the handler, in case that runs after this times out
+                                auto drained = std::make_shared<std::promise<void>>();
+                                configuration().io_service()->post([drained] { drained->set_value(); });
+                                drained->get_future().wait_for(std::chrono::milliseconds(WsppConfig::timeout_close_handshake));
+                                return;
+                            }
+
+                            server.stop_perpetual();
+                            for (auto& thread : threads)
+                            {
+                                if (thread.joinable())
+                                {
+                                    thread.join();
+                                }
+                            }
+                            threads.clear();
+                        }
                         typedef std::set<websocketpp::connection_hdl, std::owner_less<websocketpp::connection_hdl>> connections_t;
 
                         utility::string_t resource_from_hdl(websocketpp::connection_hdl hdl)
@@ -476,6 +648,11 @@ namespace web
 
                         websocketpp::lib::shared_ptr<websocketpp::lib::asio::ssl::context> handle_tls_init(websocketpp::connection_hdl hdl)
                         {
+                            // the context is shared by all the connections, so that the key and certificates are only loaded once,
+                            // and so that the sessions it caches and the keys for its session tickets allow clients to resume them
+                            std::lock_guard<std::mutex> lock(ssl_context_mutex);
+                            if (ssl_context) return ssl_context;
+
                             auto ctx = websocketpp::lib::make_shared<websocketpp::lib::asio::ssl::context>(websocketpp::lib::asio::ssl::context::sslv23);
 
                             ctx->set_options(websocketpp::lib::asio::ssl::context::default_workarounds);
@@ -485,14 +662,37 @@ namespace web
                                 config.get_ssl_context_callback()(*ctx);
                             }
 
+                            // if the callback throws, the context is not cached, so the next connection tries again
+                            ssl_context = ctx;
                             return ctx;
                         }
 
                         bool handle_validate(websocketpp::connection_hdl hdl)
                         {
+                            select_subprotocol(hdl);
                             return user_validate ? user_validate(resource_from_hdl(hdl)) : true;
                         }
 
+                        // select the subprotocol most preferred by the server, of those requested by the client
+                        void select_subprotocol(websocketpp::connection_hdl hdl)
+                        {
+                            const auto& subprotocols = configuration().subprotocols();
+                            if (subprotocols.empty()) return;
+
+                            const auto con = server.get_con_from_hdl(hdl);
+                            const auto& requested = con->get_requested_subprotocols();
+                            for (const auto& subprotocol : subprotocols)
+                            {
+                                const auto utf8 = utility::conversions::to_utf8string(subprotocol);
+                                if (requested.end() != std::find(requested.begin(), requested.end(), utf8))
+                                {
+                                    websocketpp::lib::error_code ec;
+                                    con->select_subprotocol(utf8, ec);
+                                    return;
+                                }
+                            }
+                        }
+
                         void handle_open(websocketpp::connection_hdl hdl)
                         {
                             {
@@ -511,6 +711,7 @@ namespace web
                             {
                                 std::lock_guard<std::mutex> lock(mutex);
                                 connections.erase(hdl);
+                                if (connections.empty()) connections_closed.notify_all();
                             }
 
                             if (user_close)
@@ -550,10 +751,13 @@ namespace web
                             }
                         }
 
-                        std::thread thread;
+                        std::vector<std::thread> threads;
                         server_t server;
                         connections_t connections;
                         std::mutex mutex;
+                        std::condition_variable connections_closed;
+                        websocketpp::lib::shared_ptr<websocketpp::lib::asio::ssl::context> ssl_context;
+                        std::mutex ssl_context_mutex;
                     };
 
                     std::unique_ptr<websocket_listener_impl> make_websocket_listener_impl(web::uri&& address, websocket_listener_config&& config)
@@ -564,6 +768,16 @@ namespace web
                     }
                 }
 
+                websocket_shared_message::websocket_shared_message(std::string payload, websocket_message_type type)
+                    : impl(std::make_shared<details::websocket_shared_message_impl>(std::move(payload), type))
+                {
+                }
+
+                size_t websocket_shared_message::size() const
+                {
+                    return impl ? impl->payload.size() : 0;
+                }
+
                 websocket_listener::websocket_listener()
                 {
                 }
@@ -648,7 +862,27 @@ namespace web
 
                 pplx::task<void> websocket_listener::send(const connection_id& connection, websocket_outgoing_message message)
                 {
-                    return impl->send(connection, message);
+                    return impl->send(connection, message, true);
+                }
+
+                pplx::task<void> websocket_listener::send(const connection_id& connection, websocket_outgoing_message message, bool compress)
+                {
+                    return impl->send(connection, message, compress);
+                }
+
+                pplx::task<void> websocket_listener::send(const connection_id& connection, const websocket_shared_message& message)
+                {
+                    return impl->send(connection, message, true);
+                }
+
+                pplx::task<void> websocket_listener::send(const connection_id& connection, const websocket_shared_message& message, bool compress)
+                {
+                    return impl->send(connection, message, compress);
+                }
+
+                size_t websocket_listener::buffered_amount(const connection_id& connection)
+                {
+                    return impl->buffered_amount(connection);
                 }
 
                 const web::uri& websocket_listener::uri() const
@@ -656,6 +890,11 @@ namespace web
                     return impl->uri();
                 }
 
+                utility::string_t websocket_listener::subprotocol(const connection_id& connection)
+                {
+                    return impl->subprotocol(connection);
+                }
+
                 const websocket_listener_config& websocket_listener::configuration() const
                 {
                     return impl->configuration();
@@ -667,5 +906,6 @@ namespace web
 
 // Sigh. "An explicit instantiation shall appear in an enclosing namespace of its template."
 template struct detail::stow_private<web::websockets::experimental::listener::details::websocket_outgoing_message_body, &web::websockets::websocket_outgoing_message::m_body>;
+template struct detail::stow_private<web::websockets::experimental::listener::details::websocket_outgoing_message_msg_type, &web::websockets::websocket_outgoing_message::m_msg_type>;
 template struct detail::stow_private<web::websockets::experimental::listener::details::websocket_incoming_message_body, &web::websockets::websocket_incoming_message::m_body>;
 template struct detail::stow_private<web::websockets::experimental::listener::details::websocket_incoming_message_msg_type, &web::websockets::websocket_incoming_message::m_msg_type>;
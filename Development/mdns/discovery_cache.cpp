@@ -0,0 +1,260 @@
+#include "mdns/discovery_cache.h"
+
+#include <algorithm>
+#include <condition_variable>
+#include <map>
+#include <mutex>
+#include <tuple>
+#include "slog/all_in_one.h"
+
+namespace mdns
+{
+    namespace details
+    {
+        // like the minimum timeout of a browse operation, to give the daemon time to perform a query rather than just returning results from its cache
+        const std::chrono::seconds settle_interval(1);
+
+        typedef std::tuple<std::string, std::string, std::string, std::uint32_t> instance_key;
+
+        static instance_key make_instance_key(const browse_result& instance)
+        {
+            return instance_key{ instance.name, instance.type, instance.domain, instance.interface_id };
+        }
+
+        struct cached_instance
+        {
+            explicit cached_instance(const browse_result& instance) : instance(instance), resolving(false) {}
+
+            browse_result instance;
+            std::vector<resolve_result> resolved;
+            // the default value means the instance has not been resolved yet
+            std::chrono::steady_clock::time_point resolved_at;
+            bool resolving;
+        };
+
+        struct cached_type
+        {
+            cached_type(bool resolve, const std::chrono::steady_clock::time_point& now) : resolve(resolve), started(now), accessed(now) {}
+
+            const bool resolve;
+            const std::chrono::steady_clock::time_point started;
+            std::chrono::steady_clock::time_point accessed;
+            pplx::cancellation_token_source cancellation_source;
+            std::map<instance_key, cached_instance> instances;
+        };
+
+        class discovery_cache_impl
+        {
+        public:
+            discovery_cache_impl(service_discovery& discovery, slog::base_gate& gate, const std::chrono::steady_clock::duration& refresh_interval, const std::chrono::steady_clock::duration& idle_interval)
+                : discovery(discovery)
+                , gate(gate)
+                , refresh_interval(refresh_interval)
+                , idle_interval(idle_interval)
+                , shutdown(false)
+            {
+            }
+
+            ~discovery_cache_impl()
+            {
+                {
+                    std::lock_guard<std::mutex> lock(mutex);
+                    shutdown = true;
+                    for (auto& type : types)
+                    {
+                        type.second->cancellation_source.cancel();
+                    }
+                    types.clear();
+                }
+                condition.notify_all();
+
+                // wait for the browse and resolve tasks, and any requests waiting for initial results
+                for (;;)
+                {
+                    std::vector<pplx::task<void>> pending;
+                    {
+                        std::lock_guard<std::mutex> lock(mutex);
+                        pending.swap(tasks);
+                    }
+                    if (pending.empty()) break;
+
+                    for (auto& task : pending)
+                    {
+                        try
+                        {
+                            task.wait();
+                        }
+                        catch (...) {}
+                    }
+                }
+            }
+
+            pplx::task<std::vector<cached_service>> services(const std::string& type, const std::string& domain, bool resolve, const std::chrono::steady_clock::duration& timeout)
+            {
+                const auto now = std::chrono::steady_clock::now();
+
+                std::unique_lock<std::mutex> lock(mutex);
+
+                expire(now);
+
+                auto& found = types[type_key{ type, domain, resolve }];
+                if (!found)
+                {
+                    found.reset(new cached_type(resolve, now));
+                    start_browse(found, type, domain);
+                }
+                const auto cached = found;
+                cached->accessed = now;
+
+                if (is_settled(*cached, now)) return pplx::task_from_result(get_services(cached, now));
+
+                // wait for the initial results, without blocking the caller
+                const auto latest = now + timeout;
+                auto result = pplx::create_task([this, cached, latest]
+                {
+                    std::unique_lock<std::mutex> lock(mutex);
+                    condition.wait_until(lock, (std::min)(cached->started + settle_interval, latest), [&] { return shutdown; });
+                    condition.wait_until(lock, latest, [&] { return shutdown || is_settled(*cached, std::chrono::steady_clock::now()); });
+                    return get_services(cached, std::chrono::steady_clock::now());
+                });
+                discard_completed_tasks();
+                tasks.push_back(result.then([](pplx::task<std::vector<cached_service>>) {}));
+                return result;
+            }
+
+        private:
+            typedef std::tuple<std::string, std::string, bool> type_key;
+
+            // the initial results are available once the browse has had time to settle and the instances discovered so far have been resolved once
+            static bool is_settled(const cached_type& cached, const std::chrono::steady_clock::time_point& now)
+            {
+                return cached.started + settle_interval <= now && cached.instances.end() == std::find_if(cached.instances.begin(), cached.instances.end(), [](const std::map<instance_key, cached_instance>::value_type& instance)
+                {
+                    return instance.second.resolving && std::chrono::steady_clock::time_point{} == instance.second.resolved_at;
+                });
+            }
+
+            // stop browsing for service types that are no longer being requested
+            void expire(const std::chrono::steady_clock::time_point& now)
+            {
+                for (auto it = types.begin(); types.end() != it;)
+                {
+                    if (it->second->accessed + idle_interval < now)
+                    {
+                        slog::log<slog::severities::more_info>(gate, SLOG_FLF) << "Discovery cache no longer browsing for regtype: " << std::get<0>(it->first) << " domain: " << std::get<1>(it->first);
+                        it->second->cancellation_source.cancel();
+                        it = types.erase(it);
+                    }
+                    else
+                    {
+                        ++it;
+                    }
+                }
+            }
+
+            std::vector<cached_service> get_services(const std::shared_ptr<cached_type>& cached, const std::chrono::steady_clock::time_point& now)
+            {
+                std::vector<cached_service> results;
+                results.reserve(cached->instances.size());
+                for (auto& instance : cached->instances)
+                {
+                    auto& entry = instance.second;
+                    if (cached->resolve && !entry.resolving && entry.resolved_at + refresh_interval <= now)
+                    {
+                        start_resolve(cached, entry);
+                    }
+                    results.push_back({ entry.instance, entry.resolved });
+                }
+                return results;
+            }
+
+            void start_browse(const std::shared_ptr<cached_type>& cached, const std::string& type, const std::string& domain)
+            {
+                slog::log<slog::severities::more_info>(gate, SLOG_FLF) << "Discovery cache browsing for regtype: " << type << " domain: " << domain;
+
+                // the cached type is shared with the browse and resolve operations, so that it outlives them even once it has expired
+                discard_completed_tasks();
+                tasks.push_back(discovery.browse_changes([this, cached](const browse_result& instance, bool added)
+                {
+                    std::lock_guard<std::mutex> lock(mutex);
+                    if (added)
+                    {
+                        auto inserted = cached->instances.insert({ make_instance_key(instance), cached_instance(instance) });
+                        if (inserted.second && cached->resolve) start_resolve(cached, inserted.first->second);
+                    }
+                    else
+                    {
+                        cached->instances.erase(make_instance_key(instance));
+                    }
+                }, type, domain, 0, cached->cancellation_source.get_token()));
+            }
+
+            void start_resolve(const std::shared_ptr<cached_type>& cached, cached_instance& instance)
+            {
+                instance.resolving = true;
+
+                const auto key = make_instance_key(instance.instance);
+                std::shared_ptr<std::vector<resolve_result>> results(new std::vector<resolve_result>());
+
+                discard_completed_tasks();
+                tasks.push_back(discovery.resolve([results](const resolve_result& resolved)
+                {
+                    results->push_back(resolved);
+                    return true;
+                }, instance.instance.name, instance.instance.type, instance.instance.domain, instance.instance.interface_id, std::chrono::seconds(default_timeout_seconds), cached->cancellation_source.get_token()).then([this, cached, key, results](pplx::task<bool> finally)
+                {
+                    try
+                    {
+                        finally.wait();
+                    }
+                    catch (...) {}
+
+                    {
+                        std::lock_guard<std::mutex> lock(mutex);
+
+                        // the instance may have been removed while it was being resolved
+                        auto found = cached->instances.find(key);
+                        if (cached->instances.end() != found)
+                        {
+                            found->second.resolving = false;
+                            found->second.resolved_at = std::chrono::steady_clock::now();
+                            // keep returning the previous results if the instance could not be resolved again this time
+                            if (!results->empty()) found->second.resolved = std::move(*results);
+                        }
+                    }
+                    condition.notify_all();
+                }));
+            }
+
+            void discard_completed_tasks()
+            {
+                tasks.erase(std::remove_if(tasks.begin(), tasks.end(), [](const pplx::task<void>& task) { return task.is_done(); }), tasks.end());
+            }
+
+            service_discovery& discovery;
+            slog::base_gate& gate;
+            const std::chrono::steady_clock::duration refresh_interval;
+            const std::chrono::steady_clock::duration idle_interval;
+
+            std::mutex mutex;
+            std::condition_variable condition;
+            bool shutdown;
+            std::map<type_key, std::shared_ptr<cached_type>> types;
+            std::vector<pplx::task<void>> tasks;
+        };
+    }
+
+    discovery_cache::discovery_cache(service_discovery& discovery, slog::base_gate& gate, const std::chrono::steady_clock::duration& refresh_interval, const std::chrono::steady_clock::duration& idle_interval)
+        : impl(new details::discovery_cache_impl(discovery, gate, refresh_interval, idle_interval))
+    {
+    }
+
+    discovery_cache::~discovery_cache()
+    {
+    }
+
+    pplx::task<std::vector<cached_service>> discovery_cache::services(const std::string& type, const std::string& domain, bool resolve, const std::chrono::steady_clock::duration& timeout)
+    {
+        return impl->services(type, domain, resolve, timeout);
+    }
+}
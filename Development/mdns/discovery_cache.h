@@ -0,0 +1,56 @@
+#ifndef MDNS_DISCOVERY_CACHE_H
+#define MDNS_DISCOVERY_CACHE_H
+
+#include <chrono>
+#include <memory>
+#include <vector>
+#include "mdns/service_discovery.h"
+
+// A cache of mDNS Service Discovery results, maintained by continuous browsing
+namespace mdns
+{
+    // resolved results are refreshed in the background once they are older than this
+    // which is the TTL recommended for records such as SRV records that include a host name
+    // see https://tools.ietf.org/html/rfc6762#section-10
+    const unsigned int default_refresh_seconds = 120;
+
+    // service types which have not been requested for this long are no longer browsed
+    const unsigned int default_idle_seconds = 600;
+
+    // discovery cache implementation
+    namespace details
+    {
+        class discovery_cache_impl;
+    }
+
+    struct cached_service
+    {
+        browse_result instance;
+        // empty if the instance has not (yet) been resolved
+        std::vector<resolve_result> resolved;
+    };
+
+    // a discovery cache continuously browses for instances of each service type that has been requested, resolving each one as it is added,
+    // so that requests can be answered from memory without waiting for a fresh browse and resolve
+    // instances are removed as soon as the browse reports them removed, e.g. because a goodbye was received or their records' TTL expired,
+    // and resolved results that are older than the refresh interval are refreshed in the background, while the previous results are still returned
+    // note, the service discovery must outlive the discovery cache
+    class discovery_cache
+    {
+    public:
+        discovery_cache(service_discovery& discovery, slog::base_gate& gate, const std::chrono::steady_clock::duration& refresh_interval = std::chrono::seconds(default_refresh_seconds), const std::chrono::steady_clock::duration& idle_interval = std::chrono::seconds(default_idle_seconds));
+        ~discovery_cache(); // waits for the background browse and resolve operations to be cancelled
+
+        // the currently discovered instances of the specified service type, and if resolve is true, their resolved results
+        // the first time a service type is requested, the results are returned once the initial browse and resolve operations have settled, or the timeout has expired
+        pplx::task<std::vector<cached_service>> services(const std::string& type, const std::string& domain = {}, bool resolve = true, const std::chrono::steady_clock::duration& timeout = std::chrono::seconds(default_timeout_seconds));
+
+        discovery_cache(const discovery_cache&) = delete;
+        discovery_cache& operator=(const discovery_cache&) = delete;
+
+    private:
+        std::unique_ptr<details::discovery_cache_impl> impl;
+    };
+}
+
+#endif
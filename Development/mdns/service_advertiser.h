@@ -1,6 +1,7 @@
 #ifndef MDNS_SERVICE_ADVERTISER_H
 #define MDNS_SERVICE_ADVERTISER_H
 
+#include <chrono>
 #include <cstdint>
 #include <memory>
 #include "pplx/pplx_utils.h"
@@ -24,6 +25,9 @@ namespace mdns
     {
     public:
         explicit service_advertiser(slog::base_gate& gate); // or web::logging::experimental::log_handler to avoid the dependency on slog?
+        // when a minimum update interval is specified, updates of a record which are made within that interval of the previous one
+        // are held back and coalesced, so that a burst of updates results in only one update per interval (with the most recent TXT records)
+        service_advertiser(slog::base_gate& gate, const std::chrono::steady_clock::duration& min_update_interval);
         ~service_advertiser(); // do not destroy this object with outstanding tasks!
 
         pplx::task<void> open();
@@ -1,5 +1,7 @@
 #include "mdns/service_advertiser.h"
 
+#include <map>
+#include <tuple>
 #include <boost/asio/ip/address.hpp>
 #include "mdns/dns_sd_impl.h"
 #include "slog/all_in_one.h"
@@ -250,8 +252,9 @@ namespace mdns
         class service_advertiser_impl
         {
         public:
-            explicit service_advertiser_impl(slog::base_gate& gate)
+            service_advertiser_impl(slog::base_gate& gate, const std::chrono::steady_clock::duration& min_update_interval)
                 : client(nullptr)
+                , min_update_interval(min_update_interval)
                 , gate(gate)
             {
             }
@@ -267,12 +270,32 @@ namespace mdns
 
             pplx::task<void> open()
             {
+                std::lock_guard<std::mutex> lock(mutex);
+
+                // in case the advertiser has previously been closed
+                if (cancellation_source.get_token().is_canceled()) cancellation_source = pplx::cancellation_token_source();
+
                 // this might be the right place to create the client connection, rather than doing it lazily in register_address?
                 return pplx::task_from_result();
             }
 
             pplx::task<void> close()
             {
+                // abandon any held back updates, and wait for them to give up
+                std::vector<pplx::task<void>> flushes;
+                {
+                    std::lock_guard<std::mutex> lock(mutex);
+                    cancellation_source.cancel();
+                    for (const auto& update : updates)
+                    {
+                        if (update.second.scheduled) flushes.push_back(update.second.flush);
+                    }
+                }
+                for (auto& flush : flushes)
+                {
+                    flush.wait();
+                }
+
                 std::lock_guard<std::mutex> lock(mutex);
 
                 // De-register anything that is registered
@@ -283,6 +306,7 @@ namespace mdns
                 }
 
                 services.clear();
+                updates.clear();
 
                 if (nullptr != client)
                 {
@@ -318,24 +342,89 @@ namespace mdns
 
             pplx::task<bool> update_record(const std::string& name, const std::string& type, const std::string& domain = {}, const txt_records& txt_records = {})
             {
-                return pplx::create_task([=]
+                if (std::chrono::steady_clock::duration::zero() == min_update_interval)
                 {
-                    // Lock also required here, for services
-                    std::lock_guard<std::mutex> lock(mutex);
-                    return mdns_details::update_record(services, name, type, domain, txt_records, gate);
-                });
+                    return pplx::create_task([=]
+                    {
+                        // Lock also required here, for services
+                        std::lock_guard<std::mutex> lock(mutex);
+                        return mdns_details::update_record(services, name, type, domain, txt_records, gate);
+                    });
+                }
+
+                std::lock_guard<std::mutex> lock(mutex);
+
+                const update_key key{ name, type, domain };
+                auto& update = updates[key];
+
+                // the most recent TXT records are used when the update is made
+                update.records = txt_records;
+
+                if (!update.scheduled)
+                {
+                    update.scheduled = true;
+                    update.updated = pplx::task_completion_event<bool>();
+
+                    // make the update immediately if the previous one was long enough ago, otherwise as soon as allowed
+                    update.flush = pplx::complete_at(update.earliest_update, cancellation_source.get_token()).then([this, key](pplx::task<void> finally)
+                    {
+                        flush_update(key);
+                    });
+                }
+
+                return pplx::create_task(update.updated);
             }
 
         private:
+            typedef std::tuple<std::string, std::string, std::string> update_key;
+
+            struct held_update
+            {
+                held_update() : earliest_update(), scheduled(false) {}
+
+                std::chrono::steady_clock::time_point earliest_update;
+                bool scheduled;
+                txt_records records;
+                pplx::task_completion_event<bool> updated;
+                pplx::task<void> flush;
+            };
+
+            void flush_update(const update_key& key)
+            {
+                pplx::task_completion_event<bool> updated;
+                bool result = false;
+                {
+                    std::lock_guard<std::mutex> lock(mutex);
+
+                    auto& update = updates[key];
+                    if (!cancellation_source.get_token().is_canceled())
+                    {
+                        result = mdns_details::update_record(services, std::get<0>(key), std::get<1>(key), std::get<2>(key), update.records, gate);
+                        update.earliest_update = std::chrono::steady_clock::now() + min_update_interval;
+                    }
+                    update.scheduled = false;
+                    updated = update.updated;
+                }
+                updated.set(result);
+            }
+
             DNSServiceRef client;
             std::vector<mdns_details::service> services;
+            const std::chrono::steady_clock::duration min_update_interval;
+            std::map<update_key, held_update> updates;
+            pplx::cancellation_token_source cancellation_source;
             std::mutex mutex;
             slog::base_gate& gate;
         };
     }
 
     service_advertiser::service_advertiser(slog::base_gate& gate)
-        : impl(new details::service_advertiser_impl(gate))
+        : impl(new details::service_advertiser_impl(gate, std::chrono::steady_clock::duration::zero()))
+    {
+    }
+
+    service_advertiser::service_advertiser(slog::base_gate& gate, const std::chrono::steady_clock::duration& min_update_interval)
+        : impl(new details::service_advertiser_impl(gate, min_update_interval))
     {
     }
 
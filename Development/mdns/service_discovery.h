@@ -37,6 +37,10 @@ namespace mdns
     // the callback must not throw
     typedef std::function<bool(const browse_result&)> browse_handler;
 
+    // the browse change callback is called when a service instance is added, or removed (in which case added is false)
+    // the callback must not throw
+    typedef std::function<void(const browse_result&, bool added)> browse_changes_handler;
+
     struct resolve_result
     {
         resolve_result() {}
@@ -53,6 +57,10 @@ namespace mdns
     // the callback must not throw
     typedef std::function<bool(const resolve_result&)> resolve_handler;
 
+    // return true from the browse and resolve result callback if the operation should be ended before its specified timeout once no more results are "imminent"
+    // the callback must not throw
+    typedef std::function<bool(const browse_result&, const resolve_result&)> browse_resolve_handler;
+
     class service_discovery
     {
     public:
@@ -62,6 +70,14 @@ namespace mdns
         pplx::task<bool> browse(const browse_handler& handler, const std::string& type, const std::string& domain, std::uint32_t interface_id, const std::chrono::steady_clock::duration& timeout, const pplx::cancellation_token& token = pplx::cancellation_token::none());
         pplx::task<bool> resolve(const resolve_handler& handler, const std::string& name, const std::string& type, const std::string& domain, std::uint32_t interface_id, const std::chrono::steady_clock::duration& timeout, const pplx::cancellation_token& token = pplx::cancellation_token::none());
 
+        // browse, resolving each service instance and looking up its addresses as soon as it is discovered, rather than one after another
+        // (when supported, all the operations share one connection to the daemon)
+        // in unicast DNS-SD domains, i.e. other than "local.", the results are cached process-wide for the TTL of the records
+        pplx::task<bool> browse_resolve(const browse_resolve_handler& handler, const std::string& type, const std::string& domain, std::uint32_t interface_id, const std::chrono::steady_clock::duration& timeout, const pplx::cancellation_token& token = pplx::cancellation_token::none());
+
+        // browse continuously, reporting service instances as they are added or removed, until the operation is cancelled
+        pplx::task<void> browse_changes(const browse_changes_handler& handler, const std::string& type, const std::string& domain, std::uint32_t interface_id, const pplx::cancellation_token& token);
+
         template <typename Rep = std::chrono::seconds::rep, typename Period = std::chrono::seconds::period>
         pplx::task<bool> browse(const browse_handler& handler, const std::string& type, const std::string& domain = {}, std::uint32_t interface_id = 0, const std::chrono::duration<Rep, Period>& timeout = std::chrono::seconds(default_timeout_seconds), const pplx::cancellation_token& token = pplx::cancellation_token::none())
         {
@@ -73,6 +89,12 @@ namespace mdns
             return resolve(handler, name, type, domain, interface_id, std::chrono::duration_cast<std::chrono::steady_clock::duration>(timeout), token);
         }
 
+        template <typename Rep = std::chrono::seconds::rep, typename Period = std::chrono::seconds::period>
+        pplx::task<bool> browse_resolve(const browse_resolve_handler& handler, const std::string& type, const std::string& domain = {}, std::uint32_t interface_id = 0, const std::chrono::duration<Rep, Period>& timeout = std::chrono::seconds(default_timeout_seconds), const pplx::cancellation_token& token = pplx::cancellation_token::none())
+        {
+            return browse_resolve(handler, type, domain, interface_id, std::chrono::duration_cast<std::chrono::steady_clock::duration>(timeout), token);
+        }
+
         template <typename Rep = std::chrono::seconds::rep, typename Period = std::chrono::seconds::period>
         pplx::task<std::vector<browse_result>> browse(const std::string& type, const std::string& domain = {}, std::uint32_t interface_id = 0, const std::chrono::duration<Rep, Period>& timeout = std::chrono::seconds(default_timeout_seconds), const pplx::cancellation_token& token = pplx::cancellation_token::none())
         {
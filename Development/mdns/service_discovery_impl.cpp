@@ -1,5 +1,11 @@
 #include "mdns/service_discovery.h"
 
+#include <algorithm>
+#include <limits>
+#include <list>
+#include <map>
+#include <mutex>
+#include <tuple>
 #include <boost/asio/ip/address.hpp>
 #include <boost/algorithm/string/predicate.hpp>
 #include <boost/algorithm/string/erase.hpp>
@@ -121,6 +127,80 @@ namespace mdns_details
         return had_enough;
     }
 
+    struct browse_changes_context
+    {
+        // browse in-flight state
+        const browse_changes_handler& handler;
+        slog::base_gate& gate;
+    };
+
+    static void DNSSD_API browse_changes_reply(
+        DNSServiceRef         sdRef,
+        const DNSServiceFlags flags,
+        uint32_t              interfaceIndex,
+        DNSServiceErrorType   errorCode,
+        const char*           serviceName,
+        const char*           regtype,
+        const char*           replyDomain,
+        void*                 context)
+    {
+        browse_changes_context* impl = (browse_changes_context*)context;
+
+        if (errorCode == kDNSServiceErr_NoError)
+        {
+            const bool added = 0 != (flags & kDNSServiceFlagsAdd);
+
+            // map kDNSServiceInterfaceIndexLocalOnly to kDNSServiceInterfaceIndexAny, to handle AVAHI_IF_UNSPEC escaping from the Avahi compatibility layer
+            const browse_result result{ serviceName, regtype, replyDomain, kDNSServiceInterfaceIndexLocalOnly == interfaceIndex ? kDNSServiceInterfaceIndexAny : interfaceIndex };
+
+            slog::log<slog::severities::more_info>(impl->gate, SLOG_FLF) << "After DNSServiceBrowse, DNSServiceBrowseReply " << (added ? "got" : "lost") << " service: " << result.name << " for regtype: " << result.type << " domain: " << result.domain << " on interface: " << result.interface_id;
+
+            impl->handler(result, added);
+        }
+        else
+        {
+            slog::log<slog::severities::error>(impl->gate, SLOG_FLF) << "After DNSServiceBrowse, DNSServiceBrowseReply received error: " << errorCode;
+        }
+    }
+
+    static void browse_changes(const browse_changes_handler& handler, const std::string& type, const std::string& domain, std::uint32_t interface_id, DNSServiceCancellationToken cancel, const pplx::cancellation_token& token, slog::base_gate& gate)
+    {
+        // the wait is interrupted by cancellation in any case, so this just limits how long each wait may be
+        const int wait_millis = 1000;
+
+        DNSServiceRef client = nullptr;
+
+        slog::log<slog::severities::more_info>(gate, SLOG_FLF) << "DNSServiceBrowse continuously for regtype: " << type << " domain: " << domain << " on interface: " << interface_id;
+
+        browse_changes_context context{ handler, gate };
+        DNSServiceErrorType errorCode = DNSServiceBrowse(&client, 0, interface_id, type.c_str(), !domain.empty() ? domain.c_str() : NULL, browse_changes_reply, &context);
+
+        if (errorCode == kDNSServiceErr_NoError)
+        {
+            while (!token.is_canceled())
+            {
+                // process the next browse responses, if any
+                errorCode = DNSServiceProcessResult(client, wait_millis, cancel);
+
+                if (errorCode == kDNSServiceErr_NoError)
+                {
+                    slog::log<slog::severities::too_much_info>(gate, SLOG_FLF) << "After DNSServiceBrowse, DNSServiceProcessResult succeeded";
+                }
+                else if (errorCode != kDNSServiceErr_Timeout_)
+                {
+                    slog::log<slog::severities::error>(gate, SLOG_FLF) << "After DNSServiceBrowse, DNSServiceProcessResult reported error: " << errorCode;
+                    break;
+                }
+            }
+
+            DNSServiceRefDeallocate(client);
+        }
+        else
+        {
+            slog::log<slog::severities::error>(gate, SLOG_FLF) << "DNSServiceBrowse reported error: " << errorCode;
+        }
+    }
+
     static txt_records parse_txt_records(const unsigned char* txtRecord, size_t txtLen)
     {
         txt_records records;
@@ -337,6 +417,34 @@ namespace mdns_details
         return had_enough;
     }
 
+    static bool host_addresses(const address_handler& handler, const std::string& host_name, slog::base_gate& gate)
+    {
+        bool had_enough = false;
+
+        // hmmm, plain old getaddrinfo uses all name resolution mechanisms so isn't specific to a particular interface
+        slog::log<slog::severities::more_info>(gate, SLOG_FLF) << "getaddrinfo for hostname: " << host_name;
+
+#ifdef _WIN32
+        // on Windows, resolution of multicast .local domain names doesn't seem to work even with the Bonjour service running?
+        const auto ip_addresses = web::http::experimental::host_addresses(utility::s2us(without_suffix(host_name)));
+#else
+        // on Linux, the name-service switch should be configured to use Avahi to resolve multicast .local domain names
+        // by including 'mdns4' or 'mdns4_minimal' in the hosts stanza of /etc/nsswitch.conf
+        const auto ip_addresses = web::http::experimental::host_addresses(utility::s2us(host_name));
+#endif
+        for (auto& ip_address : ip_addresses)
+        {
+            const address_result result{ host_name, utility::us2s(ip_address) };
+            slog::log<slog::severities::more_info>(gate, SLOG_FLF) << "Using getaddrinfo, got address: " << result.ip_address << " for host: " << result.host_name;
+
+            had_enough = handler(result);
+        }
+
+        if (ip_addresses.empty()) slog::log<slog::severities::more_info>(gate, SLOG_FLF) << "Using getaddrinfo, got no addresses for host: " << host_name;
+
+        return had_enough;
+    }
+
     static bool getaddrinfo(const address_handler& handler, const std::string& host_name, std::uint32_t interface_id, const std::chrono::steady_clock::duration& latest_timeout_, DNSServiceCancellationToken cancel, slog::base_gate& gate)
     {
         const auto earliest_timeout_ = std::chrono::seconds(0);
@@ -408,27 +516,510 @@ namespace mdns_details
 
         if (!had_enough)
         {
-            // hmmm, plain old getaddrinfo uses all name resolution mechanisms so isn't specific to a particular interface
-            slog::log<slog::severities::more_info>(gate, SLOG_FLF) << "getaddrinfo for hostname: " << host_name;
+            had_enough = host_addresses(handler, host_name, gate);
+        }
+
+        return had_enough;
+    }
+    // a special TTL value, meaning that no TTL has been observed
+    const std::uint32_t no_ttl = (std::numeric_limits<std::uint32_t>::max)();
+
+#ifdef HAVE_DNSSERVICEGETADDRINFO
+    // DNSServiceCreateConnection and kDNSServiceFlagsShareConnection were added at the same time as DNSServiceGetAddrInfo
+    // so when that is available, the browse, resolve and address lookup operations can all be in flight at once on one connection
+
+    struct browse_resolve_context;
+
+    struct browse_resolve_operation
+    {
+        // resolve or address lookup in-flight state, for one browse result
+        browse_resolve_context& context;
+        DNSServiceRef client;
+        browse_result instance;
+        resolve_result resolved;
+        bool done;
+    };
+
+    struct browse_resolve_context
+    {
+        // browse in-flight state
+        const browse_resolve_handler& handler;
+        DNSServiceRef connection;
+        bool had_enough;
+        bool more_coming;
+        // a list, so that each operation stays in the same place while it is in flight
+        std::list<browse_resolve_operation> operations;
+        slog::base_gate& gate;
+        // the lowest TTL of the address records
+        std::uint32_t ttl;
+    };
+
+    static void complete_browse_resolve_operation(browse_resolve_operation& operation)
+    {
+        auto& impl = operation.context;
+
+        if (operation.resolved.ip_addresses.empty())
+        {
+            host_addresses([&](const address_result& address)
+            {
+                operation.resolved.ip_addresses.push_back(address.ip_address);
+                return true;
+            }, operation.resolved.host_name, impl.gate);
+        }
+
+        operation.done = true;
+
+        if (impl.handler(operation.instance, operation.resolved)) impl.had_enough = true;
+    }
+
+    static void DNSSD_API browse_resolve_getaddrinfo_reply(
+        DNSServiceRef          sdRef,
+        const DNSServiceFlags  flags,
+        uint32_t               interfaceIndex,
+        DNSServiceErrorType    errorCode,
+        const char*            hostname,
+        const struct sockaddr* address,
+        uint32_t               ttl,
+        void*                  context)
+    {
+        browse_resolve_operation& operation = *(browse_resolve_operation*)context;
+        auto& impl = operation.context;
+
+        if (errorCode == kDNSServiceErr_NoError)
+        {
+            if (0 != (flags & kDNSServiceFlagsAdd) && 0 != address)
+            {
+                const auto ip_address = from_sockaddr(*address);
+                if (!ip_address.is_unspecified())
+                {
+                    slog::log<slog::severities::more_info>(impl.gate, SLOG_FLF) << "After DNSServiceGetAddrInfo, DNSServiceGetAddrInfoReply got address: " << ip_address.to_string() << " for host: " << hostname;
+
+                    operation.resolved.ip_addresses.push_back(ip_address.to_string());
+                    impl.ttl = (std::min)(impl.ttl, ttl);
+                }
+            }
+
+            if (0 != (flags & kDNSServiceFlagsMoreComing)) return;
+        }
+        else
+        {
+            slog::log<slog::severities::error>(impl.gate, SLOG_FLF) << "After DNSServiceGetAddrInfo, DNSServiceGetAddrInfoReply received error: " << errorCode;
+        }
+
+        // no more addresses are imminent, so the lookup can be stopped
+        DNSServiceRefDeallocate(operation.client);
+        operation.client = nullptr;
+
+        complete_browse_resolve_operation(operation);
+    }
+
+    static void start_browse_resolve_getaddrinfo(browse_resolve_operation& operation)
+    {
+        auto& impl = operation.context;
+
+        // for now, limited to IPv4
+        const DNSServiceProtocol protocol = kDNSServiceProtocol_IPv4;
 
 #ifdef _WIN32
-            // on Windows, resolution of multicast .local domain names doesn't seem to work even with the Bonjour service running?
-            const auto ip_addresses = web::http::experimental::host_addresses(utility::s2us(without_suffix(host_name)));
-#else
-            // on Linux, the name-service switch should be configured to use Avahi to resolve multicast .local domain names
-            // by including 'mdns4' or 'mdns4_minimal' in the hosts stanza of /etc/nsswitch.conf
-            const auto ip_addresses = web::http::experimental::host_addresses(utility::s2us(host_name));
+        if (protocol == kDNSServiceProtocol_IPv4 && operation.instance.interface_id >= kIPv6IfIndexBase)
+        {
+            // no point trying in this case!
+            slog::log<slog::severities::too_much_info>(impl.gate, SLOG_FLF) << "DNSServiceGetAddrInfo not tried for hostname: " << operation.resolved.host_name << " on interface: " << operation.instance.interface_id;
+
+            complete_browse_resolve_operation(operation);
+            return;
+        }
 #endif
-            for (auto& ip_address : ip_addresses)
+
+        slog::log<slog::severities::more_info>(impl.gate, SLOG_FLF) << "DNSServiceGetAddrInfo for hostname: " << operation.resolved.host_name << " on interface: " << operation.instance.interface_id;
+
+        operation.client = impl.connection;
+        DNSServiceErrorType errorCode = DNSServiceGetAddrInfo(&operation.client, kDNSServiceFlagsShareConnection, operation.instance.interface_id, protocol, operation.resolved.host_name.c_str(), browse_resolve_getaddrinfo_reply, &operation);
+
+        if (errorCode != kDNSServiceErr_NoError)
+        {
+            slog::log<slog::severities::error>(impl.gate, SLOG_FLF) << "DNSServiceGetAddrInfo reported error: " << errorCode;
+
+            operation.client = nullptr;
+            complete_browse_resolve_operation(operation);
+        }
+    }
+
+    static void DNSSD_API browse_resolve_resolve_reply(
+        DNSServiceRef         sdRef,
+        const DNSServiceFlags flags,
+        uint32_t              interfaceIndex,
+        DNSServiceErrorType   errorCode,
+        const char*           fullname,
+        const char*           hosttarget,
+        uint16_t              port,
+        uint16_t              txtLen,
+        const unsigned char*  txtRecord,
+        void*                 context)
+    {
+        browse_resolve_operation& operation = *(browse_resolve_operation*)context;
+        auto& impl = operation.context;
+
+        // since the interface was specified, only one result is expected, so the resolve can be stopped now
+        DNSServiceRefDeallocate(operation.client);
+        operation.client = nullptr;
+
+        if (errorCode == kDNSServiceErr_NoError)
+        {
+            operation.resolved = resolve_result{ hosttarget, ntohs(port), parse_txt_records(txtRecord, txtLen) };
+
+            slog::log<slog::severities::more_info>(impl.gate, SLOG_FLF) << "After DNSServiceResolve, DNSServiceResolveReply got host: " << operation.resolved.host_name << " port: " << (int)operation.resolved.port;
+
+            start_browse_resolve_getaddrinfo(operation);
+        }
+        else
+        {
+            slog::log<slog::severities::error>(impl.gate, SLOG_FLF) << "After DNSServiceResolve, DNSServiceResolveReply received error: " << errorCode;
+
+            operation.done = true;
+        }
+    }
+
+    static void DNSSD_API browse_resolve_browse_reply(
+        DNSServiceRef         sdRef,
+        const DNSServiceFlags flags,
+        uint32_t              interfaceIndex,
+        DNSServiceErrorType   errorCode,
+        const char*           serviceName,
+        const char*           regtype,
+        const char*           replyDomain,
+        void*                 context)
+    {
+        browse_resolve_context& impl = *(browse_resolve_context*)context;
+
+        if (errorCode == kDNSServiceErr_NoError)
+        {
+            if (0 != (flags & kDNSServiceFlagsAdd))
             {
-                const address_result result{ host_name, utility::us2s(ip_address) };
-                slog::log<slog::severities::more_info>(gate, SLOG_FLF) << "Using getaddrinfo, got address: " << result.ip_address << " for host: " << result.host_name;
+                // map kDNSServiceInterfaceIndexLocalOnly to kDNSServiceInterfaceIndexAny, to handle AVAHI_IF_UNSPEC escaping from the Avahi compatibility layer
+                const browse_result result{ serviceName, regtype, replyDomain, kDNSServiceInterfaceIndexLocalOnly == interfaceIndex ? kDNSServiceInterfaceIndexAny : interfaceIndex };
 
-                had_enough = handler(result);
+                slog::log<slog::severities::more_info>(impl.gate, SLOG_FLF) << "After DNSServiceBrowse, DNSServiceBrowseReply got service: " << result.name << " for regtype: " << result.type << " domain: " << result.domain << " on interface: " << result.interface_id;
+
+                // start resolving this instance straightaway, without waiting for any other instance to be resolved
+                impl.operations.push_back({ impl, impl.connection, result, {}, false });
+                auto& operation = impl.operations.back();
+
+                slog::log<slog::severities::more_info>(impl.gate, SLOG_FLF) << "DNSServiceResolve for name: " << result.name << " regtype: " << result.type << " domain: " << result.domain << " on interface: " << result.interface_id;
+
+                DNSServiceErrorType resolveErrorCode = DNSServiceResolve(&operation.client, kDNSServiceFlagsShareConnection, result.interface_id, result.name.c_str(), result.type.c_str(), result.domain.c_str(), (DNSServiceResolveReply)browse_resolve_resolve_reply, &operation);
+
+                if (resolveErrorCode != kDNSServiceErr_NoError)
+                {
+                    slog::log<slog::severities::error>(impl.gate, SLOG_FLF) << "DNSServiceResolve reported error: " << resolveErrorCode;
+
+                    operation.client = nullptr;
+                    operation.done = true;
+                }
+            }
+
+            impl.more_coming = 0 != (flags & kDNSServiceFlagsMoreComing);
+        }
+        else
+        {
+            slog::log<slog::severities::error>(impl.gate, SLOG_FLF) << "After DNSServiceBrowse, DNSServiceBrowseReply received error: " << errorCode;
+        }
+    }
+#endif
+
+    // the lowest TTL of the address records that were looked up is also reported, if requested and if any were observed
+    static bool browse_resolve(const browse_resolve_handler& handler, const std::string& type, const std::string& domain, std::uint32_t interface_id, const std::chrono::steady_clock::duration& latest_timeout_, DNSServiceCancellationToken cancel, const pplx::cancellation_token& token, slog::base_gate& gate, std::uint32_t* ttl = nullptr)
+    {
+        const auto latest_timeout = std::chrono::steady_clock::now() + latest_timeout_;
+
+#ifdef HAVE_DNSSERVICEGETADDRINFO
+        {
+            // as for browse, apply a minimum timeout to ensure the daemon actually performs a query
+            const auto earliest_timeout = std::chrono::steady_clock::now() + std::chrono::seconds(1);
+
+            DNSServiceRef connection = nullptr;
+            DNSServiceErrorType errorCode = DNSServiceCreateConnection(&connection);
+
+            if (errorCode == kDNSServiceErr_NoError)
+            {
+                browse_resolve_context context{ handler, connection, false, true, {}, gate, no_ttl };
+
+                slog::log<slog::severities::more_info>(gate, SLOG_FLF) << "DNSServiceBrowse for regtype: " << type << " domain: " << domain << " on interface: " << interface_id << " with shared connection";
+
+                DNSServiceRef client = connection;
+                errorCode = DNSServiceBrowse(&client, kDNSServiceFlagsShareConnection, interface_id, type.c_str(), !domain.empty() ? domain.c_str() : NULL, browse_resolve_browse_reply, &context);
+
+                if (errorCode == kDNSServiceErr_NoError)
+                {
+                    // once the handler has had enough, only wait for the earliest timeout and any operations that are still in flight
+                    const auto absolute_timeout = [&]
+                    {
+                        const bool in_flight = context.more_coming || context.operations.end() != std::find_if(context.operations.begin(), context.operations.end(), [](const browse_resolve_operation& operation)
+                        {
+                            return !operation.done;
+                        });
+                        return context.had_enough && !in_flight ? earliest_timeout : latest_timeout;
+                    };
+
+                    do
+                    {
+                        // wait for up to timeout for a response
+                        int wait_millis = (std::max)(0, (int)std::chrono::duration_cast<std::chrono::milliseconds>(absolute_timeout() - std::chrono::steady_clock::now()).count());
+
+                        // process the next responses for any of the operations sharing the connection
+                        errorCode = DNSServiceProcessResult(connection, wait_millis, cancel);
+
+                        if (errorCode == kDNSServiceErr_NoError)
+                        {
+                            slog::log<slog::severities::too_much_info>(gate, SLOG_FLF) << "After DNSServiceBrowse, DNSServiceProcessResult succeeded";
+                        }
+                        else if (errorCode == kDNSServiceErr_Timeout_)
+                        {
+                            slog::log<slog::severities::more_info>(gate, SLOG_FLF) << "After DNSServiceBrowse, DNSServiceProcessResult timed out or was cancelled";
+                            break;
+                        }
+                        else
+                        {
+                            slog::log<slog::severities::error>(gate, SLOG_FLF) << "After DNSServiceBrowse, DNSServiceProcessResult reported error: " << errorCode;
+                            break;
+                        }
+
+                    } while (!token.is_canceled() && absolute_timeout() > std::chrono::steady_clock::now());
+                }
+                else
+                {
+                    slog::log<slog::severities::error>(gate, SLOG_FLF) << "DNSServiceBrowse reported error: " << errorCode;
+                }
+
+                // deallocating the shared connection also deallocates any operations still in flight
+                DNSServiceRefDeallocate(connection);
+
+                if (nullptr != ttl) *ttl = context.ttl;
+                return context.had_enough;
             }
 
-            if (ip_addresses.empty()) slog::log<slog::severities::more_info>(gate, SLOG_FLF) << "Using getaddrinfo, got no addresses for host: " << host_name;
+            slog::log<slog::severities::more_info>(gate, SLOG_FLF) << "DNSServiceCreateConnection reported error: " << errorCode << ", so resolving each service in turn";
         }
+#endif
+
+        // without a shared connection, resolve and look up the addresses of each service during the browse
+        // (address record TTLs aren't observed in this case, since the fallback to getaddrinfo doesn't provide them)
+        return browse([&](const browse_result& instance)
+        {
+            bool had_enough = false;
+            resolve([&](const resolve_result& resolved_)
+            {
+                auto resolved = resolved_;
+                getaddrinfo([&](const address_result& address)
+                {
+                    resolved.ip_addresses.push_back(address.ip_address);
+                    return true;
+                }, resolved.host_name, instance.interface_id, latest_timeout - std::chrono::steady_clock::now(), cancel, gate);
+                if (handler(instance, resolved)) had_enough = true;
+                return true;
+            }, instance.name, instance.type, instance.domain, instance.interface_id, latest_timeout - std::chrono::steady_clock::now(), cancel, gate);
+            return had_enough || token.is_canceled();
+        }, type, domain, interface_id, latest_timeout - std::chrono::steady_clock::now(), cancel, gate);
+    }
+
+    struct query_record_context
+    {
+        // query in-flight state
+        std::uint32_t& ttl;
+        bool& done;
+        slog::base_gate& gate;
+    };
+
+    static void DNSSD_API query_record_reply(
+        DNSServiceRef         sdRef,
+        const DNSServiceFlags flags,
+        uint32_t              interfaceIndex,
+        DNSServiceErrorType   errorCode,
+        const char*           fullname,
+        uint16_t              rrtype,
+        uint16_t              rrclass,
+        uint16_t              rdlen,
+        const void*           rdata,
+        uint32_t              ttl,
+        void*                 context)
+    {
+        query_record_context* impl = (query_record_context*)context;
+
+        if (errorCode == kDNSServiceErr_NoError)
+        {
+            if (0 != (flags & kDNSServiceFlagsAdd))
+            {
+                slog::log<slog::severities::more_info>(impl->gate, SLOG_FLF) << "After DNSServiceQueryRecord, DNSServiceQueryRecordReply got record for fullname: " << fullname << " with ttl: " << ttl;
+
+                impl->ttl = (std::min)(impl->ttl, (std::uint32_t)ttl);
+            }
+
+            impl->done = 0 == (flags & kDNSServiceFlagsMoreComing);
+        }
+        else
+        {
+            slog::log<slog::severities::error>(impl->gate, SLOG_FLF) << "After DNSServiceQueryRecord, DNSServiceQueryRecordReply received error: " << errorCode;
+
+            impl->done = true;
+        }
+    }
+
+    // return the lowest TTL of the records of the specified type for the specified name, or no_ttl if none were found
+    static std::uint32_t query_record_ttl(const std::string& fullname, std::uint16_t rrtype, std::uint32_t interface_id, const std::chrono::steady_clock::duration& latest_timeout_, DNSServiceCancellationToken cancel, slog::base_gate& gate)
+    {
+        std::uint32_t ttl = no_ttl;
+        bool done = false;
+
+        DNSServiceRef client = nullptr;
+
+        const auto latest_timeout = std::chrono::steady_clock::now() + latest_timeout_;
+
+        slog::log<slog::severities::more_info>(gate, SLOG_FLF) << "DNSServiceQueryRecord for fullname: " << fullname << " rrtype: " << rrtype << " on interface: " << interface_id;
+
+        query_record_context context{ ttl, done, gate };
+        DNSServiceErrorType errorCode = DNSServiceQueryRecord(&client, 0, interface_id, fullname.c_str(), rrtype, kDNSServiceClass_IN, (DNSServiceQueryRecordReply)query_record_reply, &context);
+
+        if (errorCode == kDNSServiceErr_NoError)
+        {
+            do
+            {
+                // wait for up to timeout for a response
+                int wait_millis = (std::max)(0, (int)std::chrono::duration_cast<std::chrono::milliseconds>(latest_timeout - std::chrono::steady_clock::now()).count());
+
+                errorCode = DNSServiceProcessResult(client, wait_millis, cancel);
+
+                if (errorCode == kDNSServiceErr_NoError)
+                {
+                    slog::log<slog::severities::too_much_info>(gate, SLOG_FLF) << "After DNSServiceQueryRecord, DNSServiceProcessResult succeeded";
+                }
+                else if (errorCode == kDNSServiceErr_Timeout_)
+                {
+                    slog::log<slog::severities::more_info>(gate, SLOG_FLF) << "After DNSServiceQueryRecord, DNSServiceProcessResult timed out or was cancelled";
+                    break;
+                }
+                else
+                {
+                    slog::log<slog::severities::error>(gate, SLOG_FLF) << "After DNSServiceQueryRecord, DNSServiceProcessResult reported error: " << errorCode;
+                    break;
+                }
+
+            } while (!done && latest_timeout > std::chrono::steady_clock::now());
+
+            DNSServiceRefDeallocate(client);
+        }
+        else
+        {
+            // e.g. the Avahi compatibility layer doesn't support DNSServiceQueryRecord
+            slog::log<slog::severities::more_info>(gate, SLOG_FLF) << "DNSServiceQueryRecord reported error: " << errorCode;
+        }
+
+        return ttl;
+    }
+
+    // results in multicast DNS domains aren't cached, since the daemon maintains its own cache which is kept up to date by the multicast traffic
+    static bool is_unicast_domain(const std::string& domain)
+    {
+        return !domain.empty() && !boost::algorithm::iequals(domain, "local.") && !boost::algorithm::iequals(domain, "local");
+    }
+
+    // a process-wide cache of the results of browsing and resolving in unicast DNS-SD domains, according to the records' TTLs,
+    // so that e.g. many nodes in one process retrying discovery at the same time don't each repeat the same queries of the DNS server
+    class unicast_cache
+    {
+    public:
+        typedef std::tuple<std::string, std::string, std::uint32_t> key_type;
+        typedef std::vector<std::pair<browse_result, resolve_result>> results_type;
+
+        bool find(const key_type& key, results_type& results) const
+        {
+            std::lock_guard<std::mutex> lock(mutex);
+            auto found = entries.find(key);
+            if (entries.end() == found || found->second.expiry <= std::chrono::steady_clock::now()) return false;
+            results = found->second.results;
+            return true;
+        }
+
+        void insert(const key_type& key, results_type results, std::uint32_t ttl)
+        {
+            const auto now = std::chrono::steady_clock::now();
+
+            std::lock_guard<std::mutex> lock(mutex);
+
+            for (auto it = entries.begin(); entries.end() != it;)
+            {
+                if (it->second.expiry <= now) it = entries.erase(it); else ++it;
+            }
+
+            if (0 == ttl) return;
+            entries[key] = { std::move(results), now + std::chrono::seconds(ttl) };
+        }
+
+    private:
+        struct entry
+        {
+            results_type results;
+            std::chrono::steady_clock::time_point expiry;
+        };
+
+        mutable std::mutex mutex;
+        std::map<key_type, entry> entries;
+    };
+
+    static unicast_cache& get_unicast_cache()
+    {
+        static unicast_cache cache;
+        return cache;
+    }
+
+    // when the TTL of the records can't be determined, or no services were found, results are cached only briefly
+    // which still prevents a burst of identical queries
+    const std::uint32_t default_unicast_ttl = 10;
+
+    static bool cached_browse_resolve(const browse_resolve_handler& handler, const std::string& type, const std::string& domain, std::uint32_t interface_id, const std::chrono::steady_clock::duration& latest_timeout_, DNSServiceCancellationToken cancel, const pplx::cancellation_token& token, slog::base_gate& gate)
+    {
+        if (!is_unicast_domain(domain)) return browse_resolve(handler, type, domain, interface_id, latest_timeout_, cancel, token, gate);
+
+        auto& cache = get_unicast_cache();
+        const unicast_cache::key_type key{ type, domain, interface_id };
+
+        unicast_cache::results_type results;
+        if (cache.find(key, results))
+        {
+            slog::log<slog::severities::more_info>(gate, SLOG_FLF) << "Using cached results for regtype: " << type << " domain: " << domain << " on interface: " << interface_id;
+
+            bool had_enough = false;
+            for (const auto& result : results)
+            {
+                if (handler(result.first, result.second)) had_enough = true;
+            }
+            return had_enough;
+        }
+
+        const auto latest_timeout = std::chrono::steady_clock::now() + latest_timeout_;
+
+        std::uint32_t ttl = no_ttl;
+        const bool had_enough = browse_resolve([&](const browse_result& instance, const resolve_result& resolved)
+        {
+            results.push_back({ instance, resolved });
+            return handler(instance, resolved);
+        }, type, domain, interface_id, latest_timeout_, cancel, token, gate, &ttl);
+
+        // partial results from a cancelled operation aren't cached
+        if (token.is_canceled()) return had_enough;
+
+        if (!results.empty())
+        {
+            // the set of instances is valid for as long as the PTR records, which should have been cached by the daemon during the browse
+            // (RFC 6763 recommends that the SRV and TXT records have the same TTL as the PTR records)
+            // see https://tools.ietf.org/html/rfc6763#section-6
+            const auto query_timeout = (std::min)(std::chrono::steady_clock::duration(std::chrono::seconds(1)), latest_timeout - std::chrono::steady_clock::now());
+            ttl = (std::min)(ttl, query_record_ttl(type + "." + domain, kDNSServiceType_PTR, interface_id, query_timeout, cancel, gate));
+        }
+        if (no_ttl == ttl) ttl = default_unicast_ttl;
+
+        slog::log<slog::severities::more_info>(gate, SLOG_FLF) << "Caching " << results.size() << " results for regtype: " << type << " domain: " << domain << " on interface: " << interface_id << " with ttl: " << ttl;
+
+        cache.insert(key, std::move(results), ttl);
 
         return had_enough;
     }
@@ -488,6 +1079,29 @@ namespace mdns
                 }, token);
             }
 
+            pplx::task<bool> browse_resolve(const browse_resolve_handler& handler, const std::string& type, const std::string& domain, std::uint32_t interface_id, const std::chrono::steady_clock::duration& timeout, const pplx::cancellation_token& token)
+            {
+                auto gate_ = &this->gate;
+                return pplx::create_task([=]
+                {
+                    cancellation_guard guard(token);
+                    auto result = mdns_details::cached_browse_resolve(handler, type, domain, interface_id, timeout, guard.target, token, *gate_);
+                    // when this task is cancelled, make sure it doesn't just return an empty/partial result
+                    if (token.is_canceled()) pplx::cancel_current_task();
+                    return result;
+                }, token);
+            }
+
+            pplx::task<void> browse_changes(const browse_changes_handler& handler, const std::string& type, const std::string& domain, std::uint32_t interface_id, const pplx::cancellation_token& token)
+            {
+                auto gate_ = &this->gate;
+                return pplx::create_task([=]
+                {
+                    cancellation_guard guard(token);
+                    mdns_details::browse_changes(handler, type, domain, interface_id, guard.target, token, *gate_);
+                }, token);
+            }
+
             pplx::task<bool> resolve(const resolve_handler& handler, const std::string& name, const std::string& type, const std::string& domain, std::uint32_t interface_id, const std::chrono::steady_clock::duration& timeout, const pplx::cancellation_token& token)
             {
                 auto gate_ = &this->gate;
@@ -544,6 +1158,16 @@ namespace mdns
         return impl->browse(handler, type, domain, interface_id, timeout, token);
     }
 
+    pplx::task<bool> service_discovery::browse_resolve(const browse_resolve_handler& handler, const std::string& type, const std::string& domain, std::uint32_t interface_id, const std::chrono::steady_clock::duration& timeout, const pplx::cancellation_token& token)
+    {
+        return impl->browse_resolve(handler, type, domain, interface_id, timeout, token);
+    }
+
+    pplx::task<void> service_discovery::browse_changes(const browse_changes_handler& handler, const std::string& type, const std::string& domain, std::uint32_t interface_id, const pplx::cancellation_token& token)
+    {
+        return impl->browse_changes(handler, type, domain, interface_id, token);
+    }
+
     pplx::task<bool> service_discovery::resolve(const resolve_handler& handler, const std::string& name, const std::string& type, const std::string& domain, std::uint32_t interface_id, const std::chrono::steady_clock::duration& timeout, const pplx::cancellation_token& token)
     {
         return impl->resolve(handler, name, type, domain, interface_id, timeout, token);
@@ -0,0 +1,2 @@
+#define BST_TEST_MAIN
+#include "bst/test/test.h"
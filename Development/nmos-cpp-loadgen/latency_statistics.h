@@ -0,0 +1,96 @@
+#ifndef NMOS_CPP_LOADGEN_LATENCY_STATISTICS_H
+#define NMOS_CPP_LOADGEN_LATENCY_STATISTICS_H
+
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <iomanip>
+#include <mutex>
+#include <ostream>
+#include <string>
+#include <vector>
+
+namespace loadgen
+{
+    namespace details
+    {
+        typedef std::chrono::steady_clock clock;
+
+        // the latencies of the successful requests (or messages) of one kind, and the number of failures
+        class latency_statistics
+        {
+        public:
+            latency_statistics() : failures(0) {}
+
+            void success(clock::duration latency)
+            {
+                std::lock_guard<std::mutex> lock(mutex);
+                latencies.push_back(latency);
+            }
+
+            void failure(size_t count = 1)
+            {
+                std::lock_guard<std::mutex> lock(mutex);
+                failures += count;
+            }
+
+            static void write_heading(std::ostream& os)
+            {
+                os << std::left << std::setw(24) << "" << std::right
+                    << std::setw(10) << "count"
+                    << std::setw(10) << "errors"
+                    << std::setw(12) << "per second"
+                    << std::setw(10) << "p50 ms"
+                    << std::setw(10) << "p99 ms"
+                    << std::setw(10) << "p999 ms"
+                    << std::setw(10) << "max ms"
+                    << '\n';
+            }
+
+            // write one line of the report, with the throughput over the specified elapsed time
+            void write(std::ostream& os, const std::string& name, clock::duration elapsed) const
+            {
+                std::vector<clock::duration> sorted;
+                size_t failed;
+                {
+                    std::lock_guard<std::mutex> lock(mutex);
+                    sorted = latencies;
+                    failed = failures;
+                }
+                std::sort(sorted.begin(), sorted.end());
+
+                const auto seconds = std::chrono::duration<double>(elapsed).count();
+                os << std::left << std::setw(24) << name << std::right << std::fixed
+                    << std::setw(10) << sorted.size()
+                    << std::setw(10) << failed
+                    << std::setw(12) << std::setprecision(1) << (0 < seconds ? sorted.size() / seconds : 0.0)
+                    << std::setprecision(2)
+                    << std::setw(10) << milliseconds(percentile(sorted, 0.5))
+                    << std::setw(10) << milliseconds(percentile(sorted, 0.99))
+                    << std::setw(10) << milliseconds(percentile(sorted, 0.999))
+                    << std::setw(10) << milliseconds(sorted.empty() ? clock::duration::zero() : sorted.back())
+                    << '\n';
+            }
+
+        private:
+            // nearest-rank percentile
+            static clock::duration percentile(const std::vector<clock::duration>& sorted, double p)
+            {
+                if (sorted.empty()) return clock::duration::zero();
+                const auto rank = (size_t)std::ceil(p * sorted.size());
+                return sorted[(std::max)(rank, size_t(1)) - 1];
+            }
+
+            static double milliseconds(clock::duration duration)
+            {
+                return std::chrono::duration<double, std::milli>(duration).count();
+            }
+
+            mutable std::mutex mutex;
+            std::vector<clock::duration> latencies;
+            size_t failures;
+        };
+    }
+}
+
+#endif
@@ -0,0 +1,447 @@
+#include "load_generator.h"
+
+#include <algorithm>
+#include <atomic>
+#include <cmath>
+#include <condition_variable>
+#include <iomanip>
+#include <map>
+#include <mutex>
+#include <ostream>
+#include <thread>
+#include "cpprest/http_client.h"
+#include "cpprest/ws_client.h"
+#include "nmos/api_downgrade.h"
+#include "nmos/client_utils.h"
+#include "nmos/json_fields.h"
+#include "nmos/node_resource.h"
+#include "nmos/node_resources.h"
+#include "nmos/query_utils.h" // for nmos::fields::grain_data
+#include "nmos/resource.h"
+#include "nmos/slog.h"
+#include "nmos/transport.h"
+#include "nmos/version.h"
+#include "latency_statistics.h"
+
+namespace loadgen
+{
+    namespace details
+    {
+        // a simulated node and its sub-resources, in an order that respects referential integrity
+        struct simulated_node
+        {
+            simulated_node() : registered(false) {}
+
+            std::vector<nmos::resource> resources;
+
+            // protects the resources and registered flag while the node is being registered, or one of its senders updated
+            std::mutex mutex;
+            bool registered;
+        };
+
+        inline web::json::value make_registration_request_body(const nmos::resource& resource, const nmos::api_version& registry_version)
+        {
+            return web::json::value_of(
+            {
+                { U("type"), web::json::value::string(resource.type.name) },
+                { U("data"), nmos::downgrade(resource.version, resource.type, resource.data, registry_version, registry_version) }
+            });
+        }
+
+        class load_generator
+        {
+        public:
+            load_generator(const nmos::settings& settings, slog::base_gate& gate)
+                : settings(settings)
+                , gate(gate)
+                , registration_client(fields::registration_uri(settings), nmos::make_http_client_config(settings))
+                , query_client(fields::query_uri(settings), nmos::make_http_client_config(settings))
+                , registry_version(nmos::parse_api_version(web::uri::split_path(registration_client.base_uri().path()).back()))
+                , nodes((size_t)(std::max)(1, fields::nodes(settings)))
+                , in_flight(0)
+            {
+                const auto devices_per_node = fields::devices_per_node(settings);
+                const auto senders_per_device = fields::senders_per_device(settings);
+                const auto receivers_per_device = fields::receivers_per_device(settings);
+
+                for (auto& node : nodes)
+                {
+                    const auto node_id = nmos::make_id();
+                    node.resources.push_back(nmos::make_node(node_id, settings));
+
+                    for (int device = 0; device < devices_per_node; ++device)
+                    {
+                        const auto device_id = nmos::make_id();
+                        std::vector<nmos::id> sender_ids;
+                        std::vector<nmos::id> receiver_ids;
+                        std::vector<nmos::resource> sub_resources;
+
+                        for (int sender = 0; sender < senders_per_device; ++sender)
+                        {
+                            const auto source_id = nmos::make_id();
+                            const auto flow_id = nmos::make_id();
+                            const auto sender_id = nmos::make_id();
+                            sub_resources.push_back(nmos::make_video_source(source_id, device_id, nmos::rational(25, 1), settings));
+                            sub_resources.push_back(nmos::make_raw_video_flow(flow_id, source_id, device_id, settings));
+                            sub_resources.push_back(nmos::make_sender(sender_id, flow_id, device_id, {}, settings));
+                            sender_ids.push_back(sender_id);
+                        }
+
+                        for (int receiver = 0; receiver < receivers_per_device; ++receiver)
+                        {
+                            const auto receiver_id = nmos::make_id();
+                            sub_resources.push_back(nmos::make_video_receiver(receiver_id, device_id, nmos::transports::rtp_mcast, {}, settings));
+                            receiver_ids.push_back(receiver_id);
+                        }
+
+                        node.resources.push_back(nmos::make_device(device_id, node_id, sender_ids, receiver_ids, settings));
+                        for (auto& sub_resource : sub_resources)
+                        {
+                            if (nmos::types::sender == sub_resource.type) senders.push_back({ &node, node.resources.size() });
+                            node.resources.push_back(std::move(sub_resource));
+                        }
+                    }
+                }
+            }
+
+            void run(std::ostream& report)
+            {
+                const auto resource_count = nodes.size() * nodes.front().resources.size();
+
+                // initial registration, by several workers each registering one node at a time
+
+                slog::log<slog::severities::info>(gate, SLOG_FLF) << "Registering " << nodes.size() << " nodes (" << resource_count << " resources) on " << registration_client.base_uri().to_string();
+
+                const auto registration_start = clock::now();
+                {
+                    std::atomic<size_t> next(0);
+                    std::vector<std::thread> workers;
+                    const auto concurrency = (std::min)((size_t)(std::max)(1, fields::registration_concurrency(settings)), nodes.size());
+                    for (size_t worker = 0; worker < concurrency; ++worker)
+                    {
+                        workers.push_back(std::thread([&]
+                        {
+                            for (size_t index; nodes.size() > (index = next++);)
+                            {
+                                auto& node = nodes[index];
+                                std::lock_guard<std::mutex> lock(node.mutex);
+                                node.registered = register_node(node, initial_registration);
+                            }
+                        }));
+                    }
+                    for (auto& worker : workers) worker.join();
+                }
+                const auto registration_elapsed = clock::now() - registration_start;
+
+                const auto registered = std::count_if(nodes.begin(), nodes.end(), [](const simulated_node& node) { return node.registered; });
+                slog::log<slog::severities::info>(gate, SLOG_FLF) << "Registered " << registered << " of " << nodes.size() << " nodes in " << std::chrono::duration<double>(registration_elapsed).count() << " s";
+
+                // Query API websocket subscriptions, which receive the sender updates
+
+                for (int subscription = 0; subscription < fields::subscriptions(settings); ++subscription)
+                {
+                    subscribe();
+                }
+
+                // steady-state load, until the configured duration has elapsed
+
+                slog::log<slog::severities::info>(gate, SLOG_FLF) << "Generating load for " << fields::duration(settings) << " s";
+
+                const auto start = clock::now();
+                const auto until = start + std::chrono::seconds(fields::duration(settings));
+
+                std::vector<std::thread> threads;
+
+                // heartbeats are spread evenly over the heartbeat interval
+                const auto heartbeat_rate = nodes.size() / (double)(std::max)(1, fields::heartbeat_interval(settings));
+                threads.push_back(std::thread([&] { paced(heartbeat_rate, start, until, [&](size_t count) { heartbeat(nodes[count % nodes.size()]); }); }));
+
+                threads.push_back(std::thread([&] { paced(fields::churn_rate(settings), start, until, [&](size_t count) { churn(nodes[count % nodes.size()]); }); }));
+
+                if (!senders.empty())
+                {
+                    threads.push_back(std::thread([&] { paced(fields::update_rate(settings), start, until, [&](size_t count) { update(senders[count % senders.size()]); }); }));
+                }
+
+                const auto& query_paths = fields::query_paths(settings).as_array();
+                if (0 != query_paths.size())
+                {
+                    threads.push_back(std::thread([&] { paced(fields::query_rate(settings), start, until, [&](size_t count) { query(query_paths.at(count % query_paths.size()).as_string()); }); }));
+                }
+
+                for (auto& thread : threads) thread.join();
+
+                // allow the outstanding requests and websocket messages to complete
+                wait_in_flight(std::chrono::seconds(10));
+                if (!websockets.empty()) std::this_thread::sleep_for(std::chrono::seconds(1));
+
+                const auto elapsed = clock::now() - start;
+
+                for (auto& websocket : websockets)
+                {
+                    websocket.close().wait();
+                }
+                wait_in_flight(std::chrono::seconds(1));
+
+                // any sender updates that were not received by all the subscriptions
+                {
+                    std::lock_guard<std::mutex> lock(updates_mutex);
+                    for (const auto& update : updates) websocket_events.failure(update.second.second);
+                    updates.clear();
+                }
+
+                slog::log<slog::severities::info>(gate, SLOG_FLF) << "Load generation complete";
+
+                report << "Initial registration of " << registered << " of " << nodes.size() << " nodes (" << resource_count << " resources) took "
+                    << std::fixed << std::setprecision(1) << std::chrono::duration<double>(registration_elapsed).count() << " s\n";
+                report << "Steady-state load for " << std::chrono::duration<double>(elapsed).count() << " s with " << websockets.size() << " websocket subscriptions\n";
+                report << '\n';
+                latency_statistics::write_heading(report);
+                initial_registration.write(report, "initial registration", registration_elapsed);
+                registration.write(report, "registration", elapsed);
+                deletion.write(report, "deletion", elapsed);
+                updates_statistics.write(report, "update", elapsed);
+                heartbeats.write(report, "heartbeat", elapsed);
+                queries.write(report, "query", elapsed);
+                subscriptions.write(report, "subscription", elapsed);
+                websocket_events.write(report, "websocket event", elapsed);
+                report.flush();
+            }
+
+        private:
+            // call the function at the specified rate, from start until the specified time
+            template <typename Function>
+            static void paced(double rate, clock::time_point start, clock::time_point until, Function function)
+            {
+                if (0 >= rate) return;
+                for (size_t count = 0;; ++count)
+                {
+                    const auto due = start + std::chrono::duration_cast<clock::duration>(std::chrono::duration<double>(count / rate));
+                    if (due >= until) break;
+                    std::this_thread::sleep_until(due);
+                    function(count);
+                }
+            }
+
+            // make an asynchronous request, recording its latency up to the end of the response body if it is successful
+            pplx::task<bool> request(web::http::client::http_client& client, const web::http::method& method, const utility::string_t& path, const web::json::value& body, latency_statistics& statistics)
+            {
+                begin_in_flight();
+                const auto start = clock::now();
+                auto response_task = body.is_null() ? client.request(method, path) : client.request(method, path, body);
+                return response_task.then([](web::http::http_response response)
+                {
+                    return response.content_ready();
+                }).then([this, start, method, path, &statistics](pplx::task<web::http::http_response> finally)
+                {
+                    bool success = false;
+                    try
+                    {
+                        const auto response = finally.get();
+                        success = web::http::status_codes::OK <= response.status_code() && 300 > response.status_code();
+                        if (success)
+                            statistics.success(clock::now() - start);
+                        else
+                            slog::log<slog::severities::more_info>(gate, SLOG_FLF) << "Unexpected response for " << method << " " << path << " [" << response.status_code() << "]";
+                    }
+                    catch (const web::http::http_exception& e)
+                    {
+                        slog::log<slog::severities::more_info>(gate, SLOG_FLF) << "HTTP error for " << method << " " << path << ": " << e.what() << " [" << e.error_code() << "]";
+                    }
+                    if (!success) statistics.failure();
+                    end_in_flight();
+                    return success;
+                });
+            }
+
+            // register the node and all its sub-resources in turn (with the node mutex locked)
+            bool register_node(simulated_node& node, latency_statistics& statistics)
+            {
+                for (const auto& resource : node.resources)
+                {
+                    if (!request(registration_client, web::http::methods::POST, U("/resource"), make_registration_request_body(resource, registry_version), statistics).get()) return false;
+                }
+                return true;
+            }
+
+            void heartbeat(simulated_node& node)
+            {
+                std::unique_lock<std::mutex> lock(node.mutex, std::try_to_lock);
+                if (!lock.owns_lock() || !node.registered) return;
+                const auto path = U("/health/nodes/") + node.resources.front().id;
+                lock.unlock();
+
+                request(registration_client, web::http::methods::POST, path, web::json::value::null(), heartbeats);
+            }
+
+            // delete the node, which also deletes its sub-resources, and register them all again
+            void churn(simulated_node& node)
+            {
+                std::lock_guard<std::mutex> lock(node.mutex);
+                if (!node.registered) return;
+                node.registered = false;
+
+                if (!request(registration_client, web::http::methods::DEL, U("/resource/nodes/") + node.resources.front().id, web::json::value::null(), deletion).get()) return;
+
+                node.registered = register_node(node, registration);
+            }
+
+            // update the version of one sender, noting when, in order to measure when the websocket subscriptions receive the event
+            void update(const std::pair<simulated_node*, size_t>& sender)
+            {
+                auto& node = *sender.first;
+                std::unique_lock<std::mutex> lock(node.mutex, std::try_to_lock);
+                if (!lock.owns_lock() || !node.registered) return;
+                auto& resource = node.resources[sender.second];
+                const auto version = nmos::make_version();
+                resource.data[nmos::fields::version] = web::json::value::string(version);
+                const auto body = make_registration_request_body(resource, registry_version);
+                lock.unlock();
+
+                if (!websockets.empty())
+                {
+                    std::lock_guard<std::mutex> lock(updates_mutex);
+                    updates[version] = { clock::now(), websockets.size() };
+                }
+
+                request(registration_client, web::http::methods::POST, U("/resource"), body, updates_statistics);
+            }
+
+            void query(const utility::string_t& path)
+            {
+                request(query_client, web::http::methods::GET, path, web::json::value::null(), queries);
+            }
+
+            // create a non-persistent subscription on /senders and connect to it, recording the time taken for both
+            void subscribe()
+            {
+                using web::json::value;
+
+                const auto body = web::json::value_of(
+                {
+                    { nmos::fields::max_update_rate_ms, 0 },
+                    { nmos::fields::resource_path, JU("/senders") },
+                    { nmos::fields::params, value::object() },
+                    { nmos::fields::persist, false },
+                    { nmos::fields::secure, U("https") == query_client.base_uri().scheme() }
+                });
+
+                const auto start = clock::now();
+                try
+                {
+                    auto response = query_client.request(web::http::methods::POST, U("/subscriptions"), body).get();
+                    if (web::http::status_codes::Created != response.status_code() && web::http::status_codes::OK != response.status_code())
+                    {
+                        slog::log<slog::severities::error>(gate, SLOG_FLF) << "Unexpected response for subscription [" << response.status_code() << "]";
+                        subscriptions.failure();
+                        return;
+                    }
+                    const auto subscription = response.extract_json().get();
+
+                    web::websockets::client::websocket_callback_client websocket(nmos::make_websocket_client_config(settings));
+                    websocket.set_message_handler([this](const web::websockets::client::websocket_incoming_message& message)
+                    {
+                        const auto received = clock::now();
+                        begin_in_flight();
+                        message.extract_string().then([this, received](pplx::task<std::string> message_task)
+                        {
+                            try
+                            {
+                                receive(web::json::value::parse(utility::s2us(message_task.get())), received);
+                            }
+                            catch (const std::exception& e)
+                            {
+                                slog::log<slog::severities::more_info>(gate, SLOG_FLF) << "Unexpected websocket message: " << e.what();
+                            }
+                            end_in_flight();
+                        });
+                    });
+                    websocket.connect(nmos::fields::ws_href(subscription)).wait();
+
+                    subscriptions.success(clock::now() - start);
+                    websockets.push_back(websocket);
+                }
+                catch (const web::http::http_exception& e)
+                {
+                    slog::log<slog::severities::error>(gate, SLOG_FLF) << "HTTP error for subscription: " << e.what() << " [" << e.error_code() << "]";
+                    subscriptions.failure();
+                }
+                catch (const web::websockets::websocket_exception& e)
+                {
+                    slog::log<slog::severities::error>(gate, SLOG_FLF) << "WebSocket error for subscription: " << e.what() << " [" << e.error_code() << "]";
+                    subscriptions.failure();
+                }
+            }
+
+            // record the latency of each sender update in the grain
+            void receive(const web::json::value& message, clock::time_point received)
+            {
+                for (const auto& event : nmos::fields::grain_data(message).as_array())
+                {
+                    if (!event.has_field(U("post"))) continue;
+                    const auto& post = event.at(U("post"));
+                    if (!post.has_field(nmos::fields::version)) continue;
+
+                    std::lock_guard<std::mutex> lock(updates_mutex);
+                    auto found = updates.find(post.at(nmos::fields::version).as_string());
+                    if (updates.end() == found) continue;
+                    websocket_events.success(received - found->second.first);
+                    if (0 == --found->second.second) updates.erase(found);
+                }
+            }
+
+            void begin_in_flight()
+            {
+                std::lock_guard<std::mutex> lock(in_flight_mutex);
+                ++in_flight;
+            }
+
+            void end_in_flight()
+            {
+                std::lock_guard<std::mutex> lock(in_flight_mutex);
+                if (0 == --in_flight) in_flight_condition.notify_all();
+            }
+
+            void wait_in_flight(clock::duration timeout)
+            {
+                std::unique_lock<std::mutex> lock(in_flight_mutex);
+                in_flight_condition.wait_for(lock, timeout, [&] { return 0 == in_flight; });
+            }
+
+            const nmos::settings& settings;
+            slog::base_gate& gate;
+
+            web::http::client::http_client registration_client;
+            web::http::client::http_client query_client;
+            const nmos::api_version registry_version;
+
+            std::vector<simulated_node> nodes;
+            std::vector<std::pair<simulated_node*, size_t>> senders;
+            std::vector<web::websockets::client::websocket_callback_client> websockets;
+
+            // the sender updates not yet received by all the subscriptions, with the time each was made
+            std::mutex updates_mutex;
+            std::map<utility::string_t, std::pair<clock::time_point, size_t>> updates;
+
+            std::mutex in_flight_mutex;
+            std::condition_variable in_flight_condition;
+            size_t in_flight;
+
+            latency_statistics initial_registration;
+            latency_statistics registration;
+            latency_statistics deletion;
+            latency_statistics updates_statistics;
+            latency_statistics heartbeats;
+            latency_statistics queries;
+            latency_statistics subscriptions;
+            latency_statistics websocket_events;
+        };
+    }
+
+    // register the simulated nodes, then generate heartbeats, registration churn, sender updates and queries, and receive
+    // websocket messages for the configured duration, and finally write the throughput and latencies for each API to the report
+    void run_load_generator(const nmos::settings& settings, std::ostream& report, slog::base_gate& gate)
+    {
+        details::load_generator(settings, gate).run(report);
+    }
+}
@@ -0,0 +1,72 @@
+#ifndef NMOS_CPP_LOADGEN_LOAD_GENERATOR_H
+#define NMOS_CPP_LOADGEN_LOAD_GENERATOR_H
+
+#include <iosfwd>
+#include "cpprest/json_utils.h"
+#include "nmos/settings.h"
+
+namespace slog
+{
+    class base_gate;
+}
+
+// Settings for the load generator, in addition to the client settings such as proxy_address and ca_certificate_file
+// see nmos-cpp-loadgen/config.json
+namespace loadgen
+{
+    namespace fields
+    {
+        // registration_uri: the base URI of the Registration API under test
+        const web::json::field_as_string_or registration_uri{ U("registration_uri"), U("http://127.0.0.1:3210/x-nmos/registration/v1.3") };
+
+        // query_uri: the base URI of the Query API under test
+        const web::json::field_as_string_or query_uri{ U("query_uri"), U("http://127.0.0.1:3211/x-nmos/query/v1.3") };
+
+        // nodes: the number of simulated nodes
+        const web::json::field_as_integer_or nodes{ U("nodes"), 100 };
+
+        // devices_per_node, senders_per_device, receivers_per_device: the resources of each simulated node
+        // note, each sender has its own source and flow
+        const web::json::field_as_integer_or devices_per_node{ U("devices_per_node"), 1 };
+        const web::json::field_as_integer_or senders_per_device{ U("senders_per_device"), 2 };
+        const web::json::field_as_integer_or receivers_per_device{ U("receivers_per_device"), 2 };
+
+        // registration_concurrency: the number of nodes registered concurrently during the initial registration
+        const web::json::field_as_integer_or registration_concurrency{ U("registration_concurrency"), 16 };
+
+        // heartbeat_interval: the interval between heartbeats of each simulated node, in seconds, spread evenly across the nodes
+        const web::json::field_as_integer_or heartbeat_interval{ U("heartbeat_interval"), 5 };
+
+        // duration: how long to generate the steady-state load after the initial registration, in seconds
+        const web::json::field_as_integer_or duration{ U("duration"), 60 };
+
+        // churn_rate: the number of nodes per second that are deleted and registered again, with all their sub-resources
+        const web::json::field_with_default<double> churn_rate{ U("churn_rate"), 0.0 };
+
+        // update_rate: the number of sender updates per second, from which the Query API websocket latency is also measured
+        const web::json::field_with_default<double> update_rate{ U("update_rate"), 1.0 };
+
+        // query_rate: the number of Query API requests per second
+        const web::json::field_with_default<double> query_rate{ U("query_rate"), 10.0 };
+
+        // query_paths: the resource paths, each optionally with a query string, that are requested in turn from the Query API
+        const web::json::field_as_value_or query_paths{ U("query_paths"), web::json::value_of({ JU("/nodes"), JU("/devices"), JU("/sources"), JU("/flows"), JU("/senders"), JU("/receivers") }) };
+
+        // subscriptions: the number of Query API websocket subscriptions on /senders
+        const web::json::field_as_integer_or subscriptions{ U("subscriptions"), 1 };
+
+        // replay_trace: filename of a traffic trace recorded by a registry (see nmos::experimental::fields::traffic_trace_file) to replay against the registry under test,
+        // instead of generating load from simulated nodes, or an empty string
+        const web::json::field_as_string_or replay_trace{ U("replay_trace"), U("") };
+
+        // replay_speed: how much faster than recorded to replay the traffic trace, e.g. 1.0 for the recorded times, or 0.0 to replay the requests as fast as possible
+        // the requests from each client are sent in the recorded order whatever the speed, each one after the response to the previous one
+        const web::json::field_with_default<double> replay_speed{ U("replay_speed"), 1.0 };
+    }
+
+    // register the simulated nodes, then generate heartbeats, registration churn, sender updates and queries, and receive
+    // websocket messages for the configured duration, and finally write the throughput and latencies for each API to the report
+    void run_load_generator(const nmos::settings& settings, std::ostream& report, slog::base_gate& gate);
+}
+
+#endif
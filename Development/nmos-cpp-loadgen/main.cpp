@@ -0,0 +1,110 @@
+#include <fstream>
+#include <iostream>
+#include "cpprest/http_client.h"
+#include "cpprest/ws_client.h"
+#include "nmos/log_filebuf.h"
+#include "nmos/log_gate.h"
+#include "nmos/process_utils.h"
+#include "nmos/settings.h"
+#include "load_generator.h"
+#include "trace_replay.h"
+
+int main(int argc, char* argv[])
+{
+    nmos::settings settings;
+
+    nmos::experimental::log_model log_model;
+
+    // Streams for logging, configured to write errors to stderr and to discard the access log, since the report is written to stdout
+    std::ostream error_log(std::cerr.rdbuf());
+    nmos::experimental::log_filebuf access_log_buf;
+    std::ostream access_log(&access_log_buf);
+
+    // Logging should all go through this logging gateway
+    nmos::experimental::log_gate gate(error_log, access_log, log_model);
+
+    try
+    {
+        slog::log<slog::severities::info>(gate, SLOG_FLF) << "Starting nmos-cpp load generator";
+
+        // Settings can be passed on the command-line, directly or in a configuration file
+        //
+        // E.g.
+        //
+        // # ./nmos-cpp-loadgen "{\"nodes\":1000,\"registration_uri\":\"http://192.168.0.10:3210/x-nmos/registration/v1.3\",\"query_uri\":\"http://192.168.0.10:3211/x-nmos/query/v1.3\"}"
+        // # ./nmos-cpp-loadgen config.json
+        // # ./nmos-cpp-loadgen "{\"replay_trace\":\"registry.trace\",\"replay_speed\":2.0,\"registration_uri\":\"http://192.168.0.10:3210/x-nmos/registration/v1.3\",\"query_uri\":\"http://192.168.0.10:3211/x-nmos/query/v1.3\"}"
+
+        if (argc > 1)
+        {
+            std::error_code error;
+            settings = web::json::value::parse(utility::s2us(argv[1]), error);
+            if (error)
+            {
+                std::ifstream file(argv[1]);
+                settings = web::json::value::parse(file, error);
+            }
+            if (error || !settings.is_object())
+            {
+                slog::log<slog::severities::severe>(gate, SLOG_FLF) << "Bad command-line settings [" << error << "]";
+                return -1;
+            }
+        }
+        else
+        {
+            settings = web::json::value::object();
+        }
+
+        // Prepare run-time default settings, which are used to construct the simulated resources
+
+        nmos::insert_node_default_settings(settings);
+
+        log_model.settings = settings;
+        nmos::experimental::update_category_levels(log_model);
+
+        slog::log<slog::severities::info>(gate, SLOG_FLF) << "Process ID: " << nmos::details::get_process_id();
+        slog::log<slog::severities::info>(gate, SLOG_FLF) << "Initial settings: " << settings.serialize();
+
+        if (!loadgen::fields::replay_trace(settings).empty())
+        {
+            loadgen::run_trace_replay(settings, std::cout, gate);
+        }
+        else
+        {
+            loadgen::run_load_generator(settings, std::cout, gate);
+        }
+    }
+    catch (const web::json::json_exception& e)
+    {
+        // most likely from incorrect types in the command line settings
+        slog::log<slog::severities::error>(gate, SLOG_FLF) << "JSON error: " << e.what();
+    }
+    catch (const web::http::http_exception& e)
+    {
+        slog::log<slog::severities::error>(gate, SLOG_FLF) << "HTTP error: " << e.what() << " [" << e.error_code() << "]";
+    }
+    catch (const web::websockets::websocket_exception& e)
+    {
+        slog::log<slog::severities::error>(gate, SLOG_FLF) << "WebSocket error: " << e.what() << " [" << e.error_code() << "]";
+    }
+    catch (const std::system_error& e)
+    {
+        slog::log<slog::severities::error>(gate, SLOG_FLF) << "System error: " << e.what() << " [" << e.code() << "]";
+    }
+    catch (const std::runtime_error& e)
+    {
+        slog::log<slog::severities::error>(gate, SLOG_FLF) << "Implementation error: " << e.what();
+    }
+    catch (const std::exception& e)
+    {
+        slog::log<slog::severities::error>(gate, SLOG_FLF) << "Unexpected exception: " << e.what();
+    }
+    catch (...)
+    {
+        slog::log<slog::severities::severe>(gate, SLOG_FLF) << "Unexpected unknown exception";
+    }
+
+    slog::log<slog::severities::info>(gate, SLOG_FLF) << "Stopping nmos-cpp load generator";
+
+    return 0;
+}
@@ -0,0 +1,244 @@
+#include "trace_replay.h"
+
+#include <atomic>
+#include <fstream>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <ostream>
+#include <thread>
+#include <boost/algorithm/string/predicate.hpp>
+#include "cpprest/http_client.h"
+#include "cpprest/ws_client.h"
+#include "nmos/client_utils.h"
+#include "nmos/json_fields.h"
+#include "nmos/slog.h"
+#include "nmos/traffic_trace.h"
+#include "latency_statistics.h"
+#include "load_generator.h"
+
+namespace loadgen
+{
+    namespace details
+    {
+        // the requests are sent to the scheme and authority of the API under test, so the recorded paths can be used unchanged
+        inline web::uri make_authority_uri(const utility::string_t& api_uri)
+        {
+            const web::uri uri(api_uri);
+            return web::uri_builder().set_scheme(uri.scheme()).set_host(uri.host()).set_port(uri.port()).to_uri();
+        }
+
+        // these headers describe the recorded connection or message, rather than the request itself, so they are not replayed
+        inline bool is_replayed_header(const utility::string_t& name)
+        {
+            return !boost::algorithm::iequals(name, web::http::header_names::host)
+                && !boost::algorithm::iequals(name, web::http::header_names::content_length)
+                && !boost::algorithm::iequals(name, web::http::header_names::connection)
+                && !boost::algorithm::iequals(name, U("Transfer-Encoding"));
+        }
+
+        class trace_replay
+        {
+        public:
+            trace_replay(const nmos::settings& settings, slog::base_gate& gate)
+                : settings(settings)
+                , gate(gate)
+                , registration_client(make_authority_uri(fields::registration_uri(settings)), nmos::make_http_client_config(settings))
+                , query_client(make_authority_uri(fields::query_uri(settings)), nmos::make_http_client_config(settings))
+                , websocket_messages(0)
+            {}
+
+            void run(std::ostream& report)
+            {
+                const auto file = utility::us2s(fields::replay_trace(settings));
+                std::ifstream is(file, std::ios::binary);
+                if (!is) throw std::runtime_error("could not open traffic trace file: " + file);
+                nmos::experimental::read_traffic_trace_header(is);
+
+                // 1.0 replays the requests at the recorded times, 2.0 twice as fast, and so on, while 0.0 replays them as fast as possible
+                const auto speed = fields::replay_speed(settings);
+
+                slog::log<slog::severities::info>(gate, SLOG_FLF) << "Replaying traffic trace: " << file;
+
+                // the requests from each client are chained, so that each one is sent after the response to the previous one,
+                // which preserves the order in which each client made them, while the clients are replayed concurrently
+                std::map<utility::string_t, pplx::task<void>> clients;
+
+                size_t replayed = 0;
+                size_t skipped = 0;
+                std::int64_t first_received = 0;
+                const auto start = clock::now();
+
+                nmos::experimental::traffic_record record;
+                while (nmos::experimental::read_traffic_record(is, record))
+                {
+                    // requests to other APIs, e.g. the Settings API or Metrics API, are not replayed
+                    const bool query = boost::algorithm::starts_with(record.path, U("/x-nmos/query/"));
+                    if (!query && !boost::algorithm::starts_with(record.path, U("/x-nmos/registration/")))
+                    {
+                        ++skipped;
+                        continue;
+                    }
+
+                    if (0 == replayed) first_received = record.received;
+                    if (0 < speed)
+                    {
+                        const std::chrono::duration<double, std::micro> offset((record.received - first_received) / speed);
+                        std::this_thread::sleep_until(start + std::chrono::duration_cast<clock::duration>(offset));
+                    }
+
+                    auto request = std::make_shared<nmos::experimental::traffic_record>(std::move(record));
+                    record = {};
+
+                    auto& client = query ? query_client : registration_client;
+                    auto& statistics = query ? queries : registrations;
+
+                    auto tail = clients.find(request->client);
+                    if (clients.end() == tail) tail = clients.insert({ request->client, pplx::task_from_result() }).first;
+                    tail->second = tail->second.then([this, &client, &statistics, request]
+                    {
+                        return send(client, request, statistics);
+                    });
+
+                    ++replayed;
+                }
+
+                for (auto& client : clients)
+                {
+                    client.second.wait();
+                }
+
+                const auto elapsed = clock::now() - start;
+
+                // allow the last websocket connections to complete, and messages to arrive
+                if (0 != replayed) std::this_thread::sleep_for(std::chrono::seconds(1));
+                size_t websocket_count = 0;
+                {
+                    std::lock_guard<std::mutex> lock(websockets_mutex);
+                    for (auto& websocket : websockets)
+                    {
+                        websocket.close().wait();
+                    }
+                    websocket_count = websockets.size();
+                }
+
+                slog::log<slog::severities::info>(gate, SLOG_FLF) << "Replay complete";
+
+                report << "Replayed " << replayed << " requests (skipped " << skipped << ") from " << clients.size() << " clients in "
+                    << std::fixed << std::setprecision(1) << std::chrono::duration<double>(elapsed).count() << " s";
+                if (0 < speed) report << " at " << speed << "x speed\n"; else report << " at maximum speed\n";
+                report << "Received " << websocket_messages.load() << " messages on " << websocket_count << " websocket subscriptions\n";
+                report << "Note, errors may include requests that were also unsuccessful when recorded, e.g. heartbeats for expired nodes\n";
+                report << '\n';
+                latency_statistics::write_heading(report);
+                registrations.write(report, "registration", elapsed);
+                queries.write(report, "query", elapsed);
+                subscriptions.write(report, "websocket connection", elapsed);
+                report.flush();
+            }
+
+        private:
+            // send the recorded request, recording its latency up to the end of the response body if it is successful,
+            // and connect to the websocket of each subscription that is created
+            pplx::task<void> send(web::http::client::http_client& client, std::shared_ptr<const nmos::experimental::traffic_record> record, latency_statistics& statistics)
+            {
+                web::http::http_request request(record->method);
+                request.set_request_uri(web::uri(record->path));
+                for (const auto& header : record->headers)
+                {
+                    if (is_replayed_header(header.first)) request.headers().add(header.first, header.second);
+                }
+                if (!record->body.empty())
+                {
+                    const auto content_type = request.headers().content_type();
+                    request.set_body(record->body);
+                    if (!content_type.empty()) request.headers().set_content_type(content_type);
+                }
+
+                // any subscriptions in the trace were created on the recording registry, so only those created during the replay can be connected
+                const bool subscription = web::http::methods::POST == record->method && boost::algorithm::ends_with(record->path, U("/subscriptions"));
+
+                const auto start = clock::now();
+                return client.request(request).then([](web::http::http_response response)
+                {
+                    return response.content_ready();
+                }).then([this, start, record, subscription, &statistics](pplx::task<web::http::http_response> finally)
+                {
+                    try
+                    {
+                        auto response = finally.get();
+                        const bool success = web::http::status_codes::OK <= response.status_code() && 300 > response.status_code();
+                        if (success)
+                        {
+                            statistics.success(clock::now() - start);
+                            if (subscription) connect(response.extract_json().get());
+                        }
+                        else
+                        {
+                            slog::log<slog::severities::more_info>(gate, SLOG_FLF) << "Unsuccessful response for " << record->method << " " << record->path << " [" << response.status_code() << "]";
+                            statistics.failure();
+                        }
+                    }
+                    catch (const web::http::http_exception& e)
+                    {
+                        slog::log<slog::severities::more_info>(gate, SLOG_FLF) << "HTTP error for " << record->method << " " << record->path << ": " << e.what() << " [" << e.error_code() << "]";
+                        statistics.failure();
+                    }
+                    catch (const web::json::json_exception& e)
+                    {
+                        slog::log<slog::severities::more_info>(gate, SLOG_FLF) << "JSON error for " << record->method << " " << record->path << ": " << e.what();
+                        statistics.failure();
+                    }
+                });
+            }
+
+            void connect(const web::json::value& subscription)
+            {
+                web::websockets::client::websocket_callback_client websocket(nmos::make_websocket_client_config(settings));
+                websocket.set_message_handler([this](const web::websockets::client::websocket_incoming_message&)
+                {
+                    ++websocket_messages;
+                });
+
+                const auto start = clock::now();
+                websocket.connect(nmos::fields::ws_href(subscription)).then([this, start, websocket](pplx::task<void> finally)
+                {
+                    try
+                    {
+                        finally.get();
+                        subscriptions.success(clock::now() - start);
+                        std::lock_guard<std::mutex> lock(websockets_mutex);
+                        websockets.push_back(websocket);
+                    }
+                    catch (const web::websockets::websocket_exception& e)
+                    {
+                        slog::log<slog::severities::more_info>(gate, SLOG_FLF) << "WebSocket error for subscription: " << e.what() << " [" << e.error_code() << "]";
+                        subscriptions.failure();
+                    }
+                });
+            }
+
+            const nmos::settings& settings;
+            slog::base_gate& gate;
+
+            web::http::client::http_client registration_client;
+            web::http::client::http_client query_client;
+
+            std::mutex websockets_mutex;
+            std::vector<web::websockets::client::websocket_callback_client> websockets;
+            std::atomic<size_t> websocket_messages;
+
+            latency_statistics registrations;
+            latency_statistics queries;
+            latency_statistics subscriptions;
+        };
+    }
+
+    // replay the Registration API and Query API requests in the traffic trace against the registry under test,
+    // at the configured speed, preserving the order of the requests from each client, and connect to each subscription that is created,
+    // and finally write the throughput and latencies for each API to the report
+    void run_trace_replay(const nmos::settings& settings, std::ostream& report, slog::base_gate& gate)
+    {
+        details::trace_replay(settings, gate).run(report);
+    }
+}
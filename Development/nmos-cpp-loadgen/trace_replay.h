@@ -0,0 +1,20 @@
+#ifndef NMOS_CPP_LOADGEN_TRACE_REPLAY_H
+#define NMOS_CPP_LOADGEN_TRACE_REPLAY_H
+
+#include <iosfwd>
+#include "nmos/settings.h"
+
+namespace slog
+{
+    class base_gate;
+}
+
+namespace loadgen
+{
+    // replay the Registration API and Query API requests in the traffic trace (see nmos::experimental::fields::traffic_trace_file) against the registry under test,
+    // at the configured speed, preserving the order of the requests from each client, and connect to each subscription that is created,
+    // and finally write the throughput and latencies for each API to the report
+    void run_trace_replay(const nmos::settings& settings, std::ostream& report, slog::base_gate& gate);
+}
+
+#endif
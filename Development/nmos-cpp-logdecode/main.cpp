@@ -0,0 +1,88 @@
+#include <fstream>
+#include <iostream>
+#include <iterator>
+#include <sstream>
+#include <boost/range/adaptor/transformed.hpp>
+#include "cpprest/json_utils.h"
+#include "nmos/binary_log.h"
+#include "nmos/log_gate.h"
+
+namespace
+{
+    slog::async_log_message::time_point make_time_point(std::int64_t timestamp)
+    {
+        return slog::async_log_message::time_point(bst::chrono::duration_cast<slog::async_log_message::time_point::duration>(bst::chrono::nanoseconds(timestamp)));
+    }
+
+    // the same format as the error log, except for the thread id, which is only a hash
+    void write_text(std::ostream& os, const nmos::experimental::binary_log_record& record)
+    {
+        os
+            << slog::put_timestamp(make_time_point(record.timestamp)) << ": "
+            << slog::put_severity_name(record.level) << ": "
+            << std::hex << record.thread_id << std::dec << ": "
+            << nmos::experimental::details::indent_new_lines(record.message)
+            << std::endl;
+    }
+
+    // the same format as the log events of the Logging API, except for the thread id and the unique id
+    void write_json(std::ostream& os, const nmos::experimental::binary_log_record& record)
+    {
+        std::ostringstream timestamp; timestamp << slog::put_timestamp(make_time_point(record.timestamp), "%Y-%m-%dT%H:%M:%06.3SZ");
+        std::ostringstream level_name; level_name << slog::put_severity_name(record.level);
+        std::ostringstream thread_id; thread_id << std::hex << record.thread_id;
+
+        auto json_message = web::json::value_of({
+            { U("timestamp"), utility::s2us(timestamp.str()) },
+            { U("level"), record.level },
+            { U("level_name"), utility::s2us(level_name.str()) },
+            { U("thread_id"), utility::s2us(thread_id.str()) },
+            { U("source_location"), web::json::value_of({
+                { U("file"), utility::s2us(record.file) },
+                { U("line"), record.line },
+                { U("function"), utility::s2us(record.function) }
+            }, true) },
+            { U("message"), utility::s2us(record.message) }
+        }, true);
+        if (!record.categories.empty()) json_message[U("tags")][U("category")] = web::json::value_from_elements(record.categories | boost::adaptors::transformed(utility::s2us));
+
+        os << utility::us2s(json_message.serialize()) << std::endl;
+    }
+}
+
+int main(int argc, char* argv[])
+{
+    // The binary log file is specified on the command-line, optionally preceded by --json to write one JSON object per line rather than text
+    //
+    // E.g.
+    //
+    // # ./nmos-cpp-logdecode registry.binlog
+    // # ./nmos-cpp-logdecode --json registry.binlog
+
+    const bool json = argc > 2 && std::string("--json") == argv[1];
+    if (argc != (json ? 3 : 2))
+    {
+        std::cerr << "Usage: nmos-cpp-logdecode [--json] <binary log file>" << std::endl;
+        return -1;
+    }
+
+    std::ifstream file(argv[json ? 2 : 1], std::ios::binary);
+    if (!file)
+    {
+        std::cerr << "Could not open the binary log file" << std::endl;
+        return -1;
+    }
+    const std::string contents{ std::istreambuf_iterator<char>(file), std::istreambuf_iterator<char>() };
+
+    const bool recognised = nmos::experimental::read_binary_log(contents, [&](const nmos::experimental::binary_log_record& record)
+    {
+        if (json) write_json(std::cout, record); else write_text(std::cout, record);
+    });
+    if (!recognised)
+    {
+        std::cerr << "Not a binary log file, or an unsupported format" << std::endl;
+        return -1;
+    }
+
+    return 0;
+}
@@ -6,17 +6,22 @@
 #include "nmos/api_utils.h"
 #include "nmos/connection_api.h"
 #include "nmos/events_api.h"
+#include "nmos/events_mqtt.h"
 #include "nmos/events_ws_api.h"
+#include "nmos/log_filebuf.h"
 #include "nmos/log_gate.h"
 #include "nmos/logging_api.h"
+#include "nmos/metrics_api.h"
 #include "nmos/model.h"
 #include "nmos/node_api.h"
 #include "nmos/node_behaviour.h"
 #include "nmos/node_resources.h"
 #include "nmos/process_utils.h"
+#include "nmos/resources_shared_memory.h"
 #include "nmos/server_utils.h"
 #include "nmos/settings_api.h"
 #include "nmos/slog.h"
+#include "nmos/thread_scheduling.h"
 #include "nmos/thread_utils.h"
 #include "node_implementation.h"
 
@@ -29,13 +34,16 @@ int main(int argc, char* argv[])
     nmos::experimental::log_model log_model;
 
     // Streams for logging, initially configured to write errors to stderr and to discard the access log
-    std::filebuf error_log_buf;
+    nmos::experimental::log_filebuf error_log_buf;
     std::ostream error_log(std::cerr.rdbuf());
-    std::filebuf access_log_buf;
+    nmos::experimental::log_filebuf access_log_buf;
     std::ostream access_log(&access_log_buf);
 
+    // A compact binary log of the most recent messages, initially closed
+    nmos::experimental::binary_log binary_log;
+
     // Logging should all go through this logging gateway
-    nmos::experimental::log_gate gate(error_log, access_log, log_model);
+    nmos::experimental::log_gate gate(error_log, access_log, log_model, binary_log);
 
     try
     {
@@ -73,31 +81,62 @@ int main(int argc, char* argv[])
 
         nmos::insert_node_default_settings(node_model.settings);
 
+        // and the typed snapshot of the settings read on hot paths
+        node_model.update_settings_snapshot();
+
         // copy to the logging settings
         // hmm, this is a bit icky, but simplest for now
         log_model.settings = node_model.settings;
 
         // the logging level is a special case because we want to turn it into an atomic value
-        // that can be read by logging statements without locking the mutex protecting the settings
-        log_model.level = nmos::fields::logging_level(log_model.settings);
+        // that can be read by logging statements without locking the mutex protecting the settings, and likewise the per-category logging levels
+        nmos::experimental::update_category_levels(log_model);
 
         // Reconfigure the logging streams according to settings
         // (obviously, until this point, the logging gateway has its default behaviour...)
 
+        const std::chrono::milliseconds log_flush_interval(nmos::experimental::fields::log_flush_interval(node_model.settings));
+        const auto log_rotation_size = (std::size_t)nmos::experimental::fields::log_rotation_size(node_model.settings);
+        const auto log_rotation_count = (std::size_t)nmos::experimental::fields::log_rotation_count(node_model.settings);
+
         if (!nmos::fields::error_log(node_model.settings).empty())
         {
-            error_log_buf.open(nmos::fields::error_log(node_model.settings), std::ios_base::out | std::ios_base::app);
+            error_log_buf.open(utility::us2s(nmos::fields::error_log(node_model.settings)), log_flush_interval, log_rotation_size, log_rotation_count);
             auto lock = log_model.write_lock();
             error_log.rdbuf(&error_log_buf);
         }
 
         if (!nmos::fields::access_log(node_model.settings).empty())
         {
-            access_log_buf.open(nmos::fields::access_log(node_model.settings), std::ios_base::out | std::ios_base::app);
+            access_log_buf.open(utility::us2s(nmos::fields::access_log(node_model.settings)), log_flush_interval, log_rotation_size, log_rotation_count);
             auto lock = log_model.write_lock();
             access_log.rdbuf(&access_log_buf);
         }
 
+        if (!nmos::experimental::fields::binary_log(node_model.settings).empty())
+        {
+            auto lock = log_model.write_lock();
+            if (!binary_log.open(utility::us2s(nmos::experimental::fields::binary_log(node_model.settings)), (std::size_t)nmos::experimental::fields::binary_log_size(node_model.settings), nmos::experimental::fields::binary_log_level(node_model.settings)))
+            {
+                slog::log<slog::severities::error>(gate, SLOG_FLF) << "Could not open the binary log";
+            }
+        }
+
+        // Initialize the thread pool shared by all the listeners and task continuations, if configured, before any tasks are created
+
+        nmos::experimental::initialize_io_thread_pool(node_model.settings);
+
+        // Enable accounting for the work done for each request in the access log, if configured, before any requests are handled
+
+        nmos::experimental::initialize_request_accounting(node_model.settings);
+
+        // Install the work-stealing scheduler for task continuations, if configured, before any tasks are created
+
+#if !defined(_WIN32) || defined(CPPREST_FORCE_PPLX)
+        const auto task_scheduler = nmos::experimental::make_task_scheduler(node_model.settings);
+        if (task_scheduler) pplx::set_ambient_scheduler(task_scheduler);
+#endif
+
         // Log the process ID and the API addresses we'll be using
 
         slog::log<slog::severities::info>(gate, SLOG_FLF) << "Process ID: " << nmos::details::get_process_id();
@@ -121,13 +160,21 @@ int main(int argc, char* argv[])
         const address_port logging_address(nmos::experimental::fields::logging_address(node_model.settings), nmos::experimental::fields::logging_port(node_model.settings));
         port_routers[logging_address].mount({}, nmos::experimental::make_logging_api(log_model, gate));
 
+        // Configure the Metrics API
+
+        const address_port metrics_address(nmos::experimental::fields::metrics_address(node_model.settings), nmos::experimental::fields::metrics_port(node_model.settings));
+        port_routers[metrics_address].mount({}, nmos::experimental::make_metrics_api(node_model, log_model, gate));
+
         // Configure the Node API
 
         nmos::node_api_target_handler target_handler = nmos::make_node_api_target_handler(node_model);
         port_routers[{ {}, nmos::fields::node_port(node_model.settings) }].mount({}, nmos::make_node_api(node_model, target_handler, gate));
 
+        nmos::websockets node_websockets;
+        nmos::experimental::events_ws_publisher events_ws_publisher;
+
         // start the underlying implementation and set up the node resources
-        auto node_resources = nmos::details::make_thread_guard([&] { node_implementation_thread(node_model, gate); }, [&] { node_model.controlled_shutdown(); });
+        auto node_resources = nmos::details::make_thread_guard([&] { nmos::experimental::set_thread_scheduling(node_model, U("node_implementation"), gate); node_implementation_thread(node_model, node_websockets, events_ws_publisher, gate); }, [&] { node_model.controlled_shutdown(); });
 
         // Configure the Connection API
 
@@ -136,14 +183,16 @@ int main(int argc, char* argv[])
         // Configure the Events API
         port_routers[{ {}, nmos::fields::events_port(node_model.settings) }].mount({}, nmos::make_events_api(node_model, gate));
 
-        nmos::websockets node_websockets;
-
         auto websocket_config = nmos::make_websocket_listener_config(node_model.settings);
         websocket_config.set_log_callback(nmos::make_slog_logging_callback(gate));
+        // experimental extension, to set the CPU affinity and priority of the listener's own threads
+        websocket_config.set_thread_init_callback(nmos::experimental::make_thread_scheduling_callback(node_model.settings, U("websocket_listener"), gate));
+        // experimental extension, for clients which prefer CBOR-encoded event messages
+        websocket_config.set_subprotocols({ nmos::experimental::events_ws_cbor_subprotocol });
         web::websockets::experimental::listener::validate_handler events_ws_validate_handler = nmos::make_events_ws_validate_handler(node_model, gate);
         web::websockets::experimental::listener::open_handler events_ws_open_handler = nmos::make_events_ws_open_handler(node_model, node_websockets, gate);
-        web::websockets::experimental::listener::close_handler events_ws_close_handler = nmos::make_events_ws_close_handler(node_model, node_websockets, gate);
-        web::websockets::experimental::listener::message_handler events_ws_message_handler = nmos::make_events_ws_message_handler(node_model, node_websockets, gate);
+        web::websockets::experimental::listener::close_handler events_ws_close_handler = nmos::make_events_ws_close_handler(node_model, node_websockets, events_ws_publisher, gate);
+        web::websockets::experimental::listener::message_handler events_ws_message_handler = nmos::make_events_ws_message_handler(node_model, node_websockets, events_ws_publisher, gate);
         auto events_ws_uri = web::websockets::experimental::listener::make_listener_uri(server_secure, web::websockets::experimental::listener::host_wildcard, nmos::experimental::server_port(nmos::fields::events_ws_port(node_model.settings), node_model.settings));
         web::websockets::experimental::listener::websocket_listener events_ws_listener(events_ws_uri, websocket_config);
         events_ws_listener.set_validate_handler(std::ref(events_ws_validate_handler));
@@ -151,9 +200,23 @@ int main(int argc, char* argv[])
         events_ws_listener.set_close_handler(std::ref(events_ws_close_handler));
         events_ws_listener.set_message_handler(std::ref(events_ws_message_handler));
 
+        // Configure the Logging WebSocket API, to stream log events rather than polling the Logging API
+
+        nmos::experimental::logging_websockets logging_websockets;
+
+        web::websockets::experimental::listener::validate_handler logging_ws_validate_handler = nmos::experimental::make_logging_ws_validate_handler(log_model, gate);
+        web::websockets::experimental::listener::open_handler logging_ws_open_handler = nmos::experimental::make_logging_ws_open_handler(log_model, logging_websockets, gate);
+        web::websockets::experimental::listener::close_handler logging_ws_close_handler = nmos::experimental::make_logging_ws_close_handler(log_model, logging_websockets, gate);
+        auto logging_ws_uri = web::websockets::experimental::listener::make_listener_uri(server_secure, web::websockets::experimental::listener::host_wildcard, nmos::experimental::server_port(nmos::experimental::fields::logging_ws_port(node_model.settings), node_model.settings));
+        web::websockets::experimental::listener::websocket_listener logging_ws_listener(logging_ws_uri, websocket_config);
+        logging_ws_listener.set_validate_handler(std::ref(logging_ws_validate_handler));
+        logging_ws_listener.set_open_handler(std::ref(logging_ws_open_handler));
+        logging_ws_listener.set_close_handler(std::ref(logging_ws_close_handler));
+
         // Set up the listeners for each API port
 
        auto http_config = nmos::make_http_listener_config(node_model.settings);
+       const auto http_compression = nmos::experimental::make_response_compression(node_model.settings);
 
         std::vector<web::http::experimental::listener::http_listener> port_listeners;
         for (auto& port_router : port_routers)
@@ -162,26 +225,33 @@ int main(int argc, char* argv[])
             const auto& router_address = !port_router.first.first.empty() ? port_router.first.first : web::http::experimental::listener::host_wildcard;
             // map the configured client port to the server port on which to listen
             // hmm, this should probably also take account of the address
-            port_listeners.push_back(nmos::make_api_listener(server_secure, router_address, nmos::experimental::server_port(port_router.first.second, node_model.settings), port_router.second, http_config, gate));
+            port_listeners.push_back(nmos::make_api_listener(server_secure, router_address, nmos::experimental::server_port(port_router.first.second, node_model.settings), port_router.second, http_config, gate, http_compression, nmos::experimental::make_listener_scheduler(port_router.first.second, node_model.settings, gate), &node_model.metrics));
         }
 
         // Open the API ports
 
         slog::log<slog::severities::info>(gate, SLOG_FLF) << "Preparing for connections";
 
-        std::vector<web::http::experimental::listener::http_listener_guard> port_guards;
+        // the listeners are opened concurrently, since each may take some time, e.g. to bind and set up TLS
+        std::vector<web::http::experimental::listener::http_listener*> open_listeners;
         for (auto& port_listener : port_listeners)
         {
-            if (0 <= port_listener.uri().port()) port_guards.push_back({ port_listener });
+            if (0 <= port_listener.uri().port()) open_listeners.push_back(&port_listener);
         }
+        web::http::experimental::listener::http_listeners_guard port_guards(open_listeners);
         web::websockets::experimental::listener::websocket_listener_guard events_ws_guard;
         if (0 <= events_ws_listener.uri().port()) events_ws_guard = { events_ws_listener };
+        web::websockets::experimental::listener::websocket_listener_guard logging_ws_guard;
+        if (0 <= logging_ws_listener.uri().port()) logging_ws_guard = { logging_ws_listener };
 
         // Start up node operation (including the mDNS advertisements) once all NMOS APIs are open
 
-        auto node_behaviour = nmos::details::make_thread_guard([&] { nmos::node_behaviour_thread(node_model, gate); }, [&] { node_model.controlled_shutdown(); });
-        auto send_events_ws_messages = nmos::details::make_thread_guard([&] { nmos::send_events_ws_messages_thread(events_ws_listener, node_model, node_websockets, gate); }, [&] { node_model.controlled_shutdown(); });
-        auto erase_expired_resources = nmos::details::make_thread_guard([&] { nmos::erase_expired_events_resources_thread(node_model, gate); }, [&] { node_model.controlled_shutdown(); });
+        auto node_behaviour = nmos::details::make_thread_guard([&] { nmos::experimental::set_thread_scheduling(node_model, U("node_behaviour"), gate); nmos::node_behaviour_thread(node_model, gate); }, [&] { node_model.controlled_shutdown(); });
+        auto send_events_ws_messages = nmos::details::make_thread_guard([&] { nmos::experimental::set_thread_scheduling(node_model, U("send_events_ws_messages"), gate); nmos::send_events_ws_messages_thread(events_ws_listener, node_model, node_websockets, events_ws_publisher, gate); }, [&] { node_model.controlled_shutdown(); });
+        auto send_events_mqtt_messages = nmos::details::make_thread_guard([&] { nmos::experimental::set_thread_scheduling(node_model, U("send_events_mqtt_messages"), gate); nmos::send_events_mqtt_messages_thread(node_model, gate); }, [&] { node_model.controlled_shutdown(); });
+        auto erase_expired_resources = nmos::details::make_thread_guard([&] { nmos::experimental::set_thread_scheduling(node_model, U("erase_expired_resources"), gate); nmos::erase_expired_events_resources_thread(node_model, gate); }, [&] { node_model.controlled_shutdown(); });
+        auto publish_resources_shared_memory = nmos::details::make_thread_guard([&] { nmos::experimental::set_thread_scheduling(node_model, U("publish_resources_shared_memory"), gate); nmos::experimental::publish_resources_shared_memory_thread(node_model, node_model.node_resources, gate); }, [&] { node_model.controlled_shutdown(); });
+        auto send_logging_ws_events = nmos::details::make_thread_guard([&] { nmos::experimental::set_thread_scheduling(node_model, U("send_logging_ws_events"), gate); nmos::experimental::send_logging_ws_events_thread(logging_ws_listener, log_model, logging_websockets, gate); }, [&] { log_model.controlled_shutdown(); });
 
         slog::log<slog::severities::info>(gate, SLOG_FLF) << "Ready for connections";
 
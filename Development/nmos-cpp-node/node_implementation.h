@@ -1,6 +1,8 @@
 #ifndef NMOS_CPP_NODE_NODE_IMPLEMENTATION_H
 #define NMOS_CPP_NODE_NODE_IMPLEMENTATION_H
 
+#include "nmos/websockets.h"
+
 namespace slog
 {
     class base_gate;
@@ -9,11 +11,17 @@ namespace slog
 namespace nmos
 {
     struct node_model;
+
+    namespace experimental
+    {
+        class events_ws_publisher;
+    }
 }
 
 // This is an example of how to integrate the nmos-cpp library with a device-specific underlying implementation.
 // It constructs and inserts a node resource and some sub-resources into the model, based on the model settings,
 // and then waits for sender/receiver activations or shutdown.
-void node_implementation_thread(nmos::node_model& model, slog::base_gate& gate);
+// IS-07 state changes are published directly to the subscribed Events API websocket connections.
+void node_implementation_thread(nmos::node_model& model, const nmos::websockets& websockets, nmos::experimental::events_ws_publisher& events_ws_publisher, slog::base_gate& gate);
 
 #endif
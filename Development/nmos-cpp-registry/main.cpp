@@ -5,22 +5,31 @@
 #include "mdns/service_advertiser.h"
 #include "nmos/admin_ui.h"
 #include "nmos/api_utils.h"
+#include "nmos/log_filebuf.h"
 #include "nmos/log_gate.h"
 #include "nmos/logging_api.h"
 #include "nmos/model.h"
 #include "nmos/mdns.h"
 #include "nmos/mdns_api.h"
+#include "nmos/metrics_api.h"
 #include "nmos/node_api.h"
 #include "nmos/process_utils.h"
 #include "nmos/query_api.h"
 #include "nmos/query_ws_api.h"
 #include "nmos/registration_api.h"
+#include "nmos/registry_federation.h"
+#include "nmos/registry_replication.h"
 #include "nmos/registry_resources.h"
+#include "nmos/registry_snapshot.h"
+#include "nmos/resource_journal.h"
+#include "nmos/resources_shared_memory.h"
 #include "nmos/server_utils.h"
 #include "nmos/settings_api.h"
 #include "nmos/system_api.h"
 #include "nmos/system_resources.h"
+#include "nmos/thread_scheduling.h"
 #include "nmos/thread_utils.h"
+#include "nmos/traffic_trace.h"
 
 int main(int argc, char* argv[])
 {
@@ -31,13 +40,16 @@ int main(int argc, char* argv[])
     nmos::experimental::log_model log_model;
 
     // Streams for logging, initially configured to write errors to stderr and to discard the access log
-    std::filebuf error_log_buf;
+    nmos::experimental::log_filebuf error_log_buf;
     std::ostream error_log(std::cerr.rdbuf());
-    std::filebuf access_log_buf;
+    nmos::experimental::log_filebuf access_log_buf;
     std::ostream access_log(&access_log_buf);
 
+    // A compact binary log of the most recent messages, initially closed
+    nmos::experimental::binary_log binary_log;
+
     // Logging should all go through this logging gateway
-    nmos::experimental::log_gate gate(error_log, access_log, log_model);
+    nmos::experimental::log_gate gate(error_log, access_log, log_model, binary_log);
 
     try
     {
@@ -74,37 +86,85 @@ int main(int argc, char* argv[])
 
         nmos::insert_registry_default_settings(registry_model.settings);
 
+        // and the typed snapshot of the settings read on hot paths
+        registry_model.update_settings_snapshot();
+
         // copy to the logging settings
         // hmm, this is a bit icky, but simplest for now
         log_model.settings = registry_model.settings;
 
         // the logging level is a special case because we want to turn it into an atomic value
-        // that can be read by logging statements without locking the mutex protecting the settings
-        log_model.level = nmos::fields::logging_level(log_model.settings);
+        // that can be read by logging statements without locking the mutex protecting the settings, and likewise the per-category logging levels
+        nmos::experimental::update_category_levels(log_model);
 
         // Reconfigure the logging streams according to settings
         // (obviously, until this point, the logging gateway has its default behaviour...)
 
+        const std::chrono::milliseconds log_flush_interval(nmos::experimental::fields::log_flush_interval(registry_model.settings));
+        const auto log_rotation_size = (std::size_t)nmos::experimental::fields::log_rotation_size(registry_model.settings);
+        const auto log_rotation_count = (std::size_t)nmos::experimental::fields::log_rotation_count(registry_model.settings);
+
         if (!nmos::fields::error_log(registry_model.settings).empty())
         {
-            error_log_buf.open(nmos::fields::error_log(registry_model.settings), std::ios_base::out | std::ios_base::app);
+            error_log_buf.open(utility::us2s(nmos::fields::error_log(registry_model.settings)), log_flush_interval, log_rotation_size, log_rotation_count);
             auto lock = log_model.write_lock();
             error_log.rdbuf(&error_log_buf);
         }
 
         if (!nmos::fields::access_log(registry_model.settings).empty())
         {
-            access_log_buf.open(nmos::fields::access_log(registry_model.settings), std::ios_base::out | std::ios_base::app);
+            access_log_buf.open(utility::us2s(nmos::fields::access_log(registry_model.settings)), log_flush_interval, log_rotation_size, log_rotation_count);
             auto lock = log_model.write_lock();
             access_log.rdbuf(&access_log_buf);
         }
 
+        if (!nmos::experimental::fields::binary_log(registry_model.settings).empty())
+        {
+            auto lock = log_model.write_lock();
+            if (!binary_log.open(utility::us2s(nmos::experimental::fields::binary_log(registry_model.settings)), (std::size_t)nmos::experimental::fields::binary_log_size(registry_model.settings), nmos::experimental::fields::binary_log_level(registry_model.settings)))
+            {
+                slog::log<slog::severities::error>(gate, SLOG_FLF) << "Could not open the binary log";
+            }
+        }
+
+        // Initialize the thread pool shared by all the listeners and task continuations, if configured, before any tasks are created
+
+        nmos::experimental::initialize_io_thread_pool(registry_model.settings);
+
+        // Enable accounting for the work done for each request in the access log, if configured, before any requests are handled
+
+        nmos::experimental::initialize_request_accounting(registry_model.settings);
+
+        // Install the work-stealing scheduler for task continuations, if configured, before any tasks are created
+
+#if !defined(_WIN32) || defined(CPPREST_FORCE_PPLX)
+        const auto task_scheduler = nmos::experimental::make_task_scheduler(registry_model.settings);
+        if (task_scheduler) pplx::set_ambient_scheduler(task_scheduler);
+#endif
+
         // Log the process ID and the API addresses we'll be using
 
         slog::log<slog::severities::info>(gate, SLOG_FLF) << "Process ID: " << nmos::details::get_process_id();
         slog::log<slog::severities::info>(gate, SLOG_FLF) << "Initial settings: " << registry_model.settings.serialize();
         slog::log<slog::severities::info>(gate, SLOG_FLF) << "Configuring nmos-cpp registry with its primary Node API at: " << nmos::get_host(registry_model.settings) << ":" << nmos::fields::node_port(registry_model.settings);
-        slog::log<slog::severities::info>(gate, SLOG_FLF) << "Configuring nmos-cpp registry with its primary Registration API at: " << nmos::get_host(registry_model.settings) << ":" << nmos::fields::registration_port(registry_model.settings);
+        // a query replica serves the resources of its primary registry, so doesn't have a Registration API of its own
+        const auto primary = nmos::experimental::fields::registry_primary(registry_model.settings);
+        // the front end of a federated registry is a query replica of every shard, with a Registration API which forwards each request to the shard that owns the node
+        const auto shards = nmos::experimental::fields::registry_shards(registry_model.settings);
+        const bool federation_front_end = 0 != shards.size();
+        const bool query_replica = !primary.empty() || federation_front_end;
+        if (federation_front_end)
+        {
+            slog::log<slog::severities::info>(gate, SLOG_FLF) << "Configuring nmos-cpp registry as the front end of a federated registry of " << shards.size() << " shards, with its Registration API at: " << nmos::get_host(registry_model.settings) << ":" << nmos::fields::registration_port(registry_model.settings);
+        }
+        else if (query_replica)
+        {
+            slog::log<slog::severities::info>(gate, SLOG_FLF) << "Configuring nmos-cpp registry as a query replica of: " << utility::us2s(primary);
+        }
+        else
+        {
+            slog::log<slog::severities::info>(gate, SLOG_FLF) << "Configuring nmos-cpp registry with its primary Registration API at: " << nmos::get_host(registry_model.settings) << ":" << nmos::fields::registration_port(registry_model.settings);
+        }
         slog::log<slog::severities::info>(gate, SLOG_FLF) << "Configuring nmos-cpp registry with its primary Query API at: " << nmos::get_host(registry_model.settings) << ":" << nmos::fields::query_port(registry_model.settings);
 
         // Set up the APIs, assigning them to the configured ports
@@ -129,6 +189,11 @@ int main(int argc, char* argv[])
         const address_port logging_address(nmos::experimental::fields::logging_address(registry_model.settings), nmos::experimental::fields::logging_port(registry_model.settings));
         port_routers[logging_address].mount({}, nmos::experimental::make_logging_api(log_model, gate));
 
+        // Configure the Metrics API
+
+        const address_port metrics_address(nmos::experimental::fields::metrics_address(registry_model.settings), nmos::experimental::fields::metrics_port(registry_model.settings));
+        port_routers[metrics_address].mount({}, nmos::experimental::make_metrics_api(registry_model, log_model, gate));
+
         // Configure the Query API
 
         port_routers[{ {}, nmos::fields::query_port(registry_model.settings) }].mount({}, nmos::make_query_api(registry_model, gate));
@@ -141,6 +206,8 @@ int main(int argc, char* argv[])
 
         auto websocket_config = nmos::make_websocket_listener_config(registry_model.settings);
         websocket_config.set_log_callback(nmos::make_slog_logging_callback(gate));
+        // experimental extension, to set the CPU affinity and priority of the listener's own threads
+        websocket_config.set_thread_init_callback(nmos::experimental::make_thread_scheduling_callback(registry_model.settings, U("websocket_listener"), gate));
         web::websockets::experimental::listener::validate_handler query_ws_validate_handler = nmos::make_query_ws_validate_handler(registry_model, gate);
         web::websockets::experimental::listener::open_handler query_ws_open_handler = nmos::make_query_ws_open_handler(query_id, registry_model, registry_websockets, gate);
         web::websockets::experimental::listener::close_handler query_ws_close_handler = nmos::make_query_ws_close_handler(registry_model, registry_websockets, gate);
@@ -150,9 +217,29 @@ int main(int argc, char* argv[])
         query_ws_listener.set_open_handler(std::ref(query_ws_open_handler));
         query_ws_listener.set_close_handler(std::ref(query_ws_close_handler));
 
+        // Configure the Logging WebSocket API, to stream log events rather than polling the Logging API
+
+        nmos::experimental::logging_websockets logging_websockets;
+
+        web::websockets::experimental::listener::validate_handler logging_ws_validate_handler = nmos::experimental::make_logging_ws_validate_handler(log_model, gate);
+        web::websockets::experimental::listener::open_handler logging_ws_open_handler = nmos::experimental::make_logging_ws_open_handler(log_model, logging_websockets, gate);
+        web::websockets::experimental::listener::close_handler logging_ws_close_handler = nmos::experimental::make_logging_ws_close_handler(log_model, logging_websockets, gate);
+        auto logging_ws_uri = web::websockets::experimental::listener::make_listener_uri(server_secure, web::websockets::experimental::listener::host_wildcard, nmos::experimental::server_port(nmos::experimental::fields::logging_ws_port(registry_model.settings), registry_model.settings));
+        web::websockets::experimental::listener::websocket_listener logging_ws_listener(logging_ws_uri, websocket_config);
+        logging_ws_listener.set_validate_handler(std::ref(logging_ws_validate_handler));
+        logging_ws_listener.set_open_handler(std::ref(logging_ws_open_handler));
+        logging_ws_listener.set_close_handler(std::ref(logging_ws_close_handler));
+
         // Configure the Registration API
 
-        port_routers[{ {}, nmos::fields::registration_port(registry_model.settings) }].mount({}, nmos::make_registration_api(registry_model, gate));
+        if (federation_front_end)
+        {
+            port_routers[{ {}, nmos::fields::registration_port(registry_model.settings) }].mount({}, nmos::experimental::make_registration_federation_api(registry_model, gate));
+        }
+        else if (!query_replica)
+        {
+            port_routers[{ {}, nmos::fields::registration_port(registry_model.settings) }].mount({}, nmos::make_registration_api(registry_model, gate));
+        }
 
         // Configure the Node API
 
@@ -163,8 +250,27 @@ int main(int argc, char* argv[])
         nmos::experimental::insert_registry_resources(self_resources, registry_model.settings);
 
         // add the self resources to the Registration API resources
-        // (for now just copy them directly, since these resources currently do not change and are configured to never expire)
-        registry_model.registry_resources.insert(self_resources.begin(), self_resources.end());
+        // (for now just copy them, since these resources currently do not change and are configured to never expire)
+        // inserting them one by one keeps the resource counts and memory usage accounting of the registry resources up to date
+        for (const auto& self_resource : self_resources)
+        {
+            nmos::insert_resource(registry_model.registry_resources, nmos::resource{ self_resource });
+        }
+
+        // restore the registry resources from the most recent snapshot, if configured, for a warm restart
+        // (a query replica is synced from its primary instead)
+        if (!query_replica)
+        {
+            nmos::experimental::restore_registry_snapshot(registry_model, gate);
+        }
+
+        // set up the journal of the most recent resource changes, if it is needed and hasn't already been set up when restoring the snapshot
+        // (see nmos::experimental::fields::resource_journal_limit)
+        {
+            auto lock = registry_model.write_lock();
+            auto& resources = registry_model.registry_resources;
+            if (!resources.journal) resources.journal = nmos::experimental::make_resource_journal(registry_model.settings, 0, nmos::most_recent_update(resources));
+        }
 
         // Configure the System API
 
@@ -182,7 +288,14 @@ int main(int argc, char* argv[])
         // Set up the listeners for each API port
 
         auto http_config = nmos::make_http_listener_config(registry_model.settings);
-
+        const auto http_compression = nmos::experimental::make_response_compression(registry_model.settings);
+        // experimental extension, to record the requests to every API, e.g. to reproduce production load offline
+        const auto traffic_recorder = nmos::experimental::make_traffic_recorder(registry_model.settings, gate);
+
+        // hmm, one listener per port means connections on each port are accepted by a single acceptor; several acceptors per port,
+        // bound with SO_REUSEPORT, would spread them across cores, but the C++ REST SDK registers at most one acceptor for each
+        // host and port in the process, and doesn't expose its socket options, so for now, the listener threads that run the
+        // API handlers are scaled instead (see nmos::experimental::fields::http_thread_pool_size and io_thread_pool_size)
         std::vector<web::http::experimental::listener::http_listener> port_listeners;
         for (auto& port_router : port_routers)
         {
@@ -190,25 +303,33 @@ int main(int argc, char* argv[])
             const auto& router_address = !port_router.first.first.empty() ? port_router.first.first : web::http::experimental::listener::host_wildcard;
             // map the configured client port to the server port on which to listen
             // hmm, this should probably also take account of the address
-            port_listeners.push_back(nmos::make_api_listener(server_secure, router_address, nmos::experimental::server_port(port_router.first.second, registry_model.settings), port_router.second, http_config, gate));
+            port_listeners.push_back(nmos::make_api_listener(server_secure, router_address, nmos::experimental::server_port(port_router.first.second, registry_model.settings), port_router.second, http_config, gate, http_compression, nmos::experimental::make_listener_scheduler(port_router.first.second, registry_model.settings, gate), &registry_model.metrics, traffic_recorder));
         }
 
         // Start up registry management before any NMOS APIs are open
 
-        auto send_query_ws_events = nmos::details::make_thread_guard([&] { nmos::send_query_ws_events_thread(query_ws_listener, registry_model, registry_websockets, gate); }, [&] { registry_model.controlled_shutdown(); });
-        auto erase_expired_resources = nmos::details::make_thread_guard([&] { nmos::erase_expired_resources_thread(registry_model, gate); }, [&] { registry_model.controlled_shutdown(); });
+        auto send_query_ws_events = nmos::details::make_thread_guard([&] { nmos::experimental::set_thread_scheduling(registry_model, U("send_query_ws_events"), gate); nmos::send_query_ws_events_thread(query_ws_listener, registry_model, registry_websockets, gate); }, [&] { registry_model.controlled_shutdown(); });
+        auto erase_expired_resources = nmos::details::make_thread_guard([&] { nmos::experimental::set_thread_scheduling(registry_model, U("erase_expired_resources"), gate); nmos::erase_expired_resources_thread(registry_model, gate); }, [&] { registry_model.controlled_shutdown(); });
+        auto registry_snapshot = nmos::details::make_thread_guard([&] { nmos::experimental::set_thread_scheduling(registry_model, U("registry_snapshot"), gate); nmos::experimental::registry_snapshot_thread(registry_model, gate); }, [&] { registry_model.controlled_shutdown(); });
+        auto registry_replication = nmos::details::make_thread_guard([&] { nmos::experimental::set_thread_scheduling(registry_model, U("registry_replication"), gate); nmos::experimental::registry_replication_thread(registry_model, gate); }, [&] { registry_model.controlled_shutdown(); });
+        auto publish_resources_shared_memory = nmos::details::make_thread_guard([&] { nmos::experimental::set_thread_scheduling(registry_model, U("publish_resources_shared_memory"), gate); nmos::experimental::publish_resources_shared_memory_thread(registry_model, registry_model.registry_resources, gate); }, [&] { registry_model.controlled_shutdown(); });
+        auto send_logging_ws_events = nmos::details::make_thread_guard([&] { nmos::experimental::set_thread_scheduling(registry_model, U("send_logging_ws_events"), gate); nmos::experimental::send_logging_ws_events_thread(logging_ws_listener, log_model, logging_websockets, gate); }, [&] { log_model.controlled_shutdown(); });
 
         // Open the API ports
 
         slog::log<slog::severities::info>(gate, SLOG_FLF) << "Preparing for connections";
 
-        std::vector<web::http::experimental::listener::http_listener_guard> port_guards;
+        // the listeners are opened concurrently, since each may take some time, e.g. to bind and set up TLS
+        std::vector<web::http::experimental::listener::http_listener*> open_listeners;
         for (auto& port_listener : port_listeners)
         {
-            if (0 <= port_listener.uri().port()) port_guards.push_back({ port_listener });
+            if (0 <= port_listener.uri().port()) open_listeners.push_back(&port_listener);
         }
+        web::http::experimental::listener::http_listeners_guard port_guards(open_listeners);
         web::websockets::experimental::listener::websocket_listener_guard query_ws_guard;
         if (0 <= query_ws_listener.uri().port()) query_ws_guard = { query_ws_listener };
+        web::websockets::experimental::listener::websocket_listener_guard logging_ws_guard;
+        if (0 <= logging_ws_listener.uri().port()) logging_ws_guard = { logging_ws_listener };
 
         // Configure the mDNS advertisements for our APIs
 
@@ -218,7 +339,7 @@ int main(int argc, char* argv[])
         if (nmos::service_priorities::no_priority != pri) // no_priority allows the registry to run unadvertised
         {
             nmos::experimental::register_service(advertiser, nmos::service_types::query, registry_model.settings);
-            nmos::experimental::register_service(advertiser, nmos::service_types::registration, registry_model.settings);
+            if (!query_replica || federation_front_end) nmos::experimental::register_service(advertiser, nmos::service_types::registration, registry_model.settings);
             nmos::experimental::register_service(advertiser, nmos::service_types::node, registry_model.settings);
             nmos::experimental::register_service(advertiser, nmos::service_types::system, registry_model.settings);
         }
@@ -0,0 +1,110 @@
+#include "nmos/allocator.h"
+
+#include <cstdint>
+#include <string>
+#if defined(NMOS_CPP_MALLOC_JEMALLOC)
+#include <jemalloc/jemalloc.h>
+#elif defined(NMOS_CPP_MALLOC_TCMALLOC)
+#include <gperftools/malloc_extension_c.h>
+#elif defined(__GLIBC__)
+#include <malloc.h>
+#endif
+
+namespace nmos
+{
+    namespace experimental
+    {
+#if defined(NMOS_CPP_MALLOC_JEMALLOC)
+
+        const char* allocator_name()
+        {
+            return "jemalloc";
+        }
+
+        bool get_allocator_statistics(allocator_statistics& statistics)
+        {
+            // the statistics are cached, and only refreshed by advancing the epoch
+            std::uint64_t epoch = 1;
+            std::size_t size = sizeof(epoch);
+            if (0 != mallctl("epoch", &epoch, &size, &epoch, size)) return false;
+
+            size = sizeof(std::size_t);
+            return 0 == mallctl("stats.allocated", &statistics.allocated, &size, nullptr, 0)
+                && 0 == mallctl("stats.resident", &statistics.resident, &size, nullptr, 0);
+        }
+
+        bool release_free_memory()
+        {
+            static const std::string purge = "arena." + std::to_string(MALLCTL_ARENAS_ALL) + ".purge";
+            return 0 == mallctl(purge.c_str(), nullptr, nullptr, nullptr, 0);
+        }
+
+#elif defined(NMOS_CPP_MALLOC_TCMALLOC)
+
+        const char* allocator_name()
+        {
+            return "tcmalloc";
+        }
+
+        bool get_allocator_statistics(allocator_statistics& statistics)
+        {
+            std::size_t heap_size = 0, unmapped = 0;
+            if (!MallocExtension_GetNumericProperty("generic.current_allocated_bytes", &statistics.allocated)) return false;
+            if (!MallocExtension_GetNumericProperty("generic.heap_size", &heap_size)) return false;
+            MallocExtension_GetNumericProperty("tcmalloc.pageheap_unmapped_bytes", &unmapped);
+            statistics.resident = heap_size - unmapped;
+            return true;
+        }
+
+        bool release_free_memory()
+        {
+            MallocExtension_ReleaseFreeMemory();
+            return true;
+        }
+
+#elif defined(__GLIBC__)
+
+        const char* allocator_name()
+        {
+            return "glibc";
+        }
+
+        bool get_allocator_statistics(allocator_statistics& statistics)
+        {
+            // mallinfo2 was added in glibc 2.33, since the fields of mallinfo overflow above 2 GiB
+#if __GLIBC_PREREQ(2, 33)
+            const auto info = mallinfo2();
+#else
+            const auto info = mallinfo();
+#endif
+            statistics.allocated = std::size_t(info.uordblks) + std::size_t(info.hblkhd);
+            statistics.resident = std::size_t(info.arena) + std::size_t(info.hblkhd);
+            return true;
+        }
+
+        bool release_free_memory()
+        {
+            malloc_trim(0);
+            return true;
+        }
+
+#else
+
+        const char* allocator_name()
+        {
+            return "system";
+        }
+
+        bool get_allocator_statistics(allocator_statistics&)
+        {
+            return false;
+        }
+
+        bool release_free_memory()
+        {
+            return false;
+        }
+
+#endif
+    }
+}
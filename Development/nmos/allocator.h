@@ -0,0 +1,32 @@
+#ifndef NMOS_ALLOCATOR_H
+#define NMOS_ALLOCATOR_H
+
+#include <cstddef>
+
+// This is an experimental extension to report on, and manage, the memory allocator linked into the process
+// which may be the system allocator, or jemalloc or tcmalloc (see NMOS_CPP_MALLOC in NmosCppCommon.cmake)
+namespace nmos
+{
+    namespace experimental
+    {
+        // the name of the memory allocator, i.e. "jemalloc", "tcmalloc", "glibc" or "system"
+        const char* allocator_name();
+
+        struct allocator_statistics
+        {
+            // bytes allocated by the application
+            std::size_t allocated;
+            // bytes held by the allocator, including free memory that hasn't been returned to the operating system
+            std::size_t resident;
+        };
+
+        // get the statistics of the memory allocator, and return false if they aren't available
+        bool get_allocator_statistics(allocator_statistics& statistics);
+
+        // return free memory held by the memory allocator to the operating system, e.g. after a burst of activity
+        // and return false if that isn't supported
+        bool release_free_memory();
+    }
+}
+
+#endif
@@ -1,6 +1,8 @@
 #include "nmos/api_downgrade.h"
 
+#include <algorithm>
 #include <map>
+#include "cpprest/json_utils.h" // for web::json::experimental::serialize_utf8
 #include "nmos/is04_versions.h"
 #include "nmos/resource.h"
 
@@ -122,6 +124,46 @@ namespace nmos
         return resources_versions;
     }
 
+    // the sorted top-level properties of each resource type in each API version, i.e. the cumulative properties of all the versions up to it,
+    // which are calculated just once, so that downgrading a resource is a single filtered pass over its properties
+    static const std::map<nmos::type, std::map<nmos::api_version, std::vector<utility::string_t>>>& resources_versions_properties()
+    {
+        static const std::map<nmos::type, std::map<nmos::api_version, std::vector<utility::string_t>>> resources_versions_properties = []
+        {
+            std::map<nmos::type, std::map<nmos::api_version, std::vector<utility::string_t>>> result;
+            for (const auto& resource_versions : resources_versions())
+            {
+                auto& versions_properties = result[resource_versions.first];
+                std::vector<utility::string_t> properties;
+                for (const auto& version_properties : resource_versions.second)
+                {
+                    properties.insert(properties.end(), version_properties.second.begin(), version_properties.second.end());
+                    std::sort(properties.begin(), properties.end());
+                    versions_properties[version_properties.first] = properties;
+                }
+            }
+            return result;
+        }();
+        return resources_versions_properties;
+    }
+
+    namespace details
+    {
+        // the sorted top-level properties of the resource type in the specified API version
+        static const std::vector<utility::string_t>& downgrade_properties(const nmos::type& resource_type, const nmos::api_version& version)
+        {
+            static const std::vector<utility::string_t> no_properties;
+            auto& versions_properties = resources_versions_properties().at(resource_type);
+            auto found = versions_properties.upper_bound(version);
+            return versions_properties.begin() != found ? (--found)->second : no_properties;
+        }
+
+        static bool is_downgrade_property(const std::vector<utility::string_t>& properties, const utility::string_t& property)
+        {
+            return std::binary_search(properties.begin(), properties.end(), property);
+        }
+    }
+
     web::json::value downgrade(const nmos::api_version& resource_version, const nmos::type& resource_type, const web::json::value& resource_data, const nmos::api_version& version, const nmos::api_version& downgrade_version)
     {
         if (!is_permitted_downgrade(resource_version, resource_type, version, downgrade_version)) return web::json::value::null();
@@ -132,7 +174,7 @@ namespace nmos
         // optimisation for the common case (old-versioned resources, if being permitted, do not get upgraded)
         if (resource_version <= version) return resource_data;
 
-        web::json::value result;
+        if (!resource_data.is_object()) return web::json::value::null();
 
         // This is a simple representation of the backwards-compatible changes that have been made between minor versions
         // of the specification. It just describes in which version each top-level property of each resource type was added.
@@ -143,20 +185,51 @@ namespace nmos
         // could be an oversight...
         // See nmos-discovery-registration/APIs/schemas/receiver_core.json
 
-        auto& resource_versions = resources_versions().at(resource_type);
-        auto version_first = resource_versions.cbegin();
-        auto version_last = resource_versions.upper_bound(version);
-        for (auto version_properties = version_first; version_last != version_properties; ++version_properties)
+        const auto& properties = details::downgrade_properties(resource_type, version);
+
+        std::vector<std::pair<utility::string_t, web::json::value>> result;
+        result.reserve(properties.size());
+        for (const auto& field : resource_data.as_object())
         {
-            for (auto& property : version_properties->second)
+            if (details::is_downgrade_property(properties, field.first))
             {
-                if (resource_data.has_field(property))
-                {
-                    result[property] = resource_data.at(property);
-                }
+                result.push_back(field);
             }
         }
 
-        return result;
+        return web::json::value::object(std::move(result));
+    }
+
+    void serialize_downgrade_utf8(std::string& utf8, const nmos::api_version& resource_version, const nmos::type& resource_type, const web::json::value& resource_data, const nmos::api_version& version, const nmos::api_version& downgrade_version)
+    {
+        if (!is_permitted_downgrade(resource_version, resource_type, version, downgrade_version) || (version < resource_version && !resource_data.is_null() && !resource_data.is_object()))
+        {
+            web::json::experimental::serialize_utf8(utf8, web::json::value::null());
+            return;
+        }
+
+        if (resource_data.is_null() || resource_version <= version)
+        {
+            web::json::experimental::serialize_utf8(utf8, resource_data);
+            return;
+        }
+
+        // the projection is applied while serializing, so the retained properties are never copied
+        const auto& properties = details::downgrade_properties(resource_type, version);
+
+        utf8.push_back('{');
+        bool empty = true;
+        for (const auto& field : resource_data.as_object())
+        {
+            if (details::is_downgrade_property(properties, field.first))
+            {
+                if (!empty) utf8.push_back(',');
+                empty = false;
+                web::json::experimental::serialize_utf8(utf8, web::json::value::string(field.first));
+                utf8.push_back(':');
+                web::json::experimental::serialize_utf8(utf8, field.second);
+            }
+        }
+        utf8.push_back('}');
     }
 }
@@ -1,6 +1,7 @@
 #ifndef NMOS_API_DOWNGRADE_H
 #define NMOS_API_DOWNGRADE_H
 
+#include <string>
 #include "cpprest/json.h"
 
 // "Downgrade queries permit old-versioned responses to be provided to clients which are confident
@@ -27,6 +28,10 @@ namespace nmos
     web::json::value downgrade(const nmos::resource& resource, const nmos::api_version& version);
     web::json::value downgrade(const nmos::resource& resource, const nmos::api_version& version, const nmos::api_version& downgrade_version);
     web::json::value downgrade(const nmos::api_version& resource_version, const nmos::type& resource_type, const web::json::value& resource_data, const nmos::api_version& version, const nmos::api_version& downgrade_version);
+
+    // append the UTF-8 json text serialization of the downgraded resource data, equivalent to serializing the result of nmos::downgrade,
+    // but without first making a copy of the properties to be retained
+    void serialize_downgrade_utf8(std::string& utf8, const nmos::api_version& resource_version, const nmos::type& resource_type, const web::json::value& resource_data, const nmos::api_version& version, const nmos::api_version& downgrade_version);
 }
 
 #endif
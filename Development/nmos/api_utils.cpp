@@ -1,11 +1,31 @@
 #include "nmos/api_utils.h"
 
+#include <algorithm>
+#include <chrono>
+#include <boost/algorithm/string/case_conv.hpp>
+#include <boost/algorithm/string/split.hpp>
 #include <boost/algorithm/string/trim.hpp>
 #include <boost/range/adaptor/transformed.hpp>
+#include "cpprest/basic_utils.h" // for utility::istringstreamed
+#include "cpprest/containerstream.h"
+#include "cpprest/http_utils.h" // for web::http::has_matching_entity_tag
+#include "cpprest/json_utils.h" // for web::json::experimental::parse_utf8
+#include "cpprest/producerconsumerstream.h"
 #include "cpprest/uri_schemes.h"
 #include "nmos/api_version.h"
+#include "nmos/metrics.h"
+#include "nmos/request_accounting.h"
+#include "nmos/resources.h"
 #include "nmos/slog.h"
+#include "nmos/traffic_trace.h"
 #include "nmos/type.h"
+#include "nmos/version.h"
+#include "pplx/pplx_utils.h"
+
+#ifdef NMOS_CPP_HTTP_COMPRESSION
+#include <cstring>
+#include <zlib.h>
+#endif
 
 namespace web
 {
@@ -43,9 +63,37 @@ namespace nmos
             }
         }
 
+        // parse the message body as UTF-8 json text in a single pass, rather than first converting the whole body to a string
+        // cf. web::http::http_request::extract_json
+        template <typename HttpMessage>
+        inline pplx::task<web::json::value> extract_utf8_json(const HttpMessage& msg, std::size_t max_size)
+        {
+            // reject an oversized body before reading it, if it says how large it is
+            if (0 != max_size && msg.headers().has(web::http::header_names::content_length) && max_size < msg.headers().content_length())
+            {
+                return pplx::task_from_exception<web::json::value>(web::http::http_exception(U("Request body too large")));
+            }
+
+            return msg.extract_vector().then([max_size](std::vector<unsigned char> body)
+            {
+                if (0 != max_size && max_size < body.size()) throw web::http::http_exception(U("Request body too large"));
+
+                // like extract_json, an empty body is null
+                if (body.empty()) return web::json::value{};
+
+                auto first = (const char*)body.data();
+                const auto last = first + body.size();
+                // "Implementations MUST NOT add a byte order mark (U+FEFF) to the beginning of a networked-transmitted JSON text.
+                // In the interests of interoperability, implementations that parse JSON texts MAY ignore the presence of a byte order mark"
+                // See https://tools.ietf.org/html/rfc8259#section-8.1
+                if (3 <= last - first && '\xEF' == first[0] && '\xBB' == first[1] && '\xBF' == first[2]) first += 3;
+                return web::json::experimental::parse_utf8(first, last);
+            });
+        }
+
         // extract JSON after checking the Content-Type header
         template <typename HttpMessage>
-        inline pplx::task<web::json::value> extract_json(const HttpMessage& msg, slog::base_gate& gate)
+        inline pplx::task<web::json::value> extract_json(const HttpMessage& msg, slog::base_gate& gate, std::size_t max_size)
         {
             auto content_type = msg.headers().content_type();
             auto semicolon = content_type.find(U(';'));
@@ -58,7 +106,7 @@ namespace nmos
                 // but it's quite common so don't even bother to log a warning...
                 // See https://www.iana.org/assignments/media-types/application/json
 
-                return msg.extract_json(false);
+                return extract_utf8_json(msg, max_size);
             }
             else if (content_type.empty())
             {
@@ -68,7 +116,7 @@ namespace nmos
 
                 slog::log<slog::severities::warning>(gate, SLOG_FLF) << "Missing Content-Type: should be application/json";
 
-                return msg.extract_json(true);
+                return extract_utf8_json(msg, max_size);
             }
             else
             {
@@ -77,14 +125,14 @@ namespace nmos
             }
         }
 
-        pplx::task<web::json::value> extract_json(const web::http::http_request& req, slog::base_gate& gate)
+        pplx::task<web::json::value> extract_json(const web::http::http_request& req, slog::base_gate& gate, std::size_t max_size)
         {
-            return extract_json<>(req, gate);
+            return extract_json<>(req, gate, max_size);
         }
 
-        pplx::task<web::json::value> extract_json(const web::http::http_response& res, slog::base_gate& gate)
+        pplx::task<web::json::value> extract_json(const web::http::http_response& res, slog::base_gate& gate, std::size_t max_size)
         {
-            return extract_json<>(res, gate);
+            return extract_json<>(res, gate, max_size);
         }
 
         // add the NMOS-specified CORS response headers
@@ -216,6 +264,35 @@ namespace nmos
             return U("resource has recently expired or been deleted");
         }
 
+        // set the response to a conditional GET to 304 (Not Modified) if the request's If-None-Match header matches the entity-tag of the current representation
+        // See https://tools.ietf.org/html/rfc7232#section-3.2
+        bool set_not_modified_reply(const web::http::http_request& req, web::http::http_response& res, const utility::string_t& entity_tag)
+        {
+            if (!web::http::has_matching_entity_tag(req.headers(), web::http::header_names::if_none_match, entity_tag)) return false;
+            set_reply(res, web::http::status_codes::NotModified);
+            res.headers().add(web::http::header_names::etag, entity_tag);
+            return true;
+        }
+
+        // make a strong entity-tag for the current state of all the resources, which changes whenever any resource is inserted, modified or erased
+        // the number of resources is included because the most recent update may go backwards when erased resources are forgotten
+        utility::string_t make_resources_entity_tag(const nmos::resources& resources)
+        {
+            return U("\"") + make_version(most_recent_update(resources)) + U("/") + utility::ostringstreamed(resources.size()) + U("\"");
+        }
+
+        // make a strong entity-tag for the current state of the specified resource
+        utility::string_t make_resource_entity_tag(const nmos::resource& resource)
+        {
+            return U("\"") + make_version(resource.updated) + U("\"");
+        }
+
+        // set the response body to the specified UTF-8 json text, e.g. a pre-serialized representation, without converting it to a json value or utility::string_t
+        void set_utf8_json_reply(web::http::http_response& res, web::http::status_code code, const std::string& utf8)
+        {
+            set_reply(res, code, concurrency::streams::container_buffer<std::string>(utf8).create_istream(), utf8.size(), web::http::details::mime_types::application_json);
+        }
+
         // make handler to check supported API version, and set error response otherwise
         web::http::experimental::listener::route_handler make_api_version_handler(const std::set<api_version>& versions, slog::base_gate& gate_)
         {
@@ -235,17 +312,307 @@ namespace nmos
             };
         }
 
+#ifdef NMOS_CPP_HTTP_COMPRESSION
+        // select the preferred supported content-coding, "gzip" or "deflate", that is acceptable according to the specified Accept-Encoding header,
+        // or return the empty string if neither is acceptable
+        // See https://tools.ietf.org/html/rfc7231#section-5.3.4
+        static utility::string_t select_content_coding(const utility::string_t& accept_encoding)
+        {
+            // qvalue of each coding, or -1 if not listed
+            double gzip = -1, deflate = -1, any = -1;
+
+            std::vector<utility::string_t> elements;
+            boost::algorithm::split(elements, accept_encoding, [](utility::char_t c) { return U(',') == c; });
+            for (const auto& element : elements)
+            {
+                std::vector<utility::string_t> params;
+                boost::algorithm::split(params, element, [](utility::char_t c) { return U(';') == c; });
+                const auto coding = boost::algorithm::to_lower_copy(boost::algorithm::trim_copy(params.front()));
+                if (coding.empty()) continue;
+
+                double qvalue = 1;
+                for (auto param = std::next(params.begin()); params.end() != param; ++param)
+                {
+                    const auto trimmed = boost::algorithm::trim_copy(*param);
+                    if (0 == trimmed.compare(0, 2, U("q=")) || 0 == trimmed.compare(0, 2, U("Q=")))
+                    {
+                        qvalue = utility::istringstreamed<double>(trimmed.substr(2), 0);
+                    }
+                }
+
+                if (U("gzip") == coding || U("x-gzip") == coding) gzip = qvalue;
+                else if (U("deflate") == coding) deflate = qvalue;
+                else if (U("*") == coding) any = qvalue;
+            }
+
+            // "*" matches any available content-coding not explicitly listed
+            if (0 > gzip) gzip = 0 > any ? 0 : any;
+            if (0 > deflate) deflate = 0 > any ? 0 : any;
+
+            if (0 >= gzip && 0 >= deflate) return{};
+            return gzip >= deflate ? U("gzip") : U("deflate");
+        }
+
+        // zlib deflate stream, with either the zlib (RFC 1950) or gzip (RFC 1952) wrapper
+        struct deflater
+        {
+            deflater(int level, bool gzip)
+            {
+                std::memset(&stream, 0, sizeof(stream));
+                // windowBits of 15 is the default, plus 16 to write the gzip wrapper
+                if (Z_OK != deflateInit2(&stream, level, Z_DEFLATED, gzip ? 15 + 16 : 15, 8, Z_DEFAULT_STRATEGY))
+                {
+                    throw std::runtime_error("deflate initialization failed");
+                }
+            }
+
+            ~deflater()
+            {
+                deflateEnd(&stream);
+            }
+
+            deflater(const deflater&) = delete;
+            deflater& operator=(const deflater&) = delete;
+
+            // compress the input, replacing the output; each input is flushed so it can be decompressed without waiting for the next
+            void operator()(const uint8_t* input, size_t input_size, bool finish, std::vector<uint8_t>& output)
+            {
+                const size_t output_chunk = 16 * 1024;
+
+                output.clear();
+                stream.next_in = const_cast<Bytef*>(input);
+                stream.avail_in = (uInt)input_size;
+                do
+                {
+                    const auto offset = output.size();
+                    output.resize(offset + output_chunk);
+                    stream.next_out = output.data() + offset;
+                    stream.avail_out = (uInt)output_chunk;
+                    if (Z_STREAM_ERROR == deflate(&stream, finish ? Z_FINISH : Z_SYNC_FLUSH))
+                    {
+                        throw std::runtime_error("deflate failed");
+                    }
+                    output.resize(offset + output_chunk - stream.avail_out);
+                } while (0 == stream.avail_out);
+            }
+
+            z_stream stream;
+        };
+
+        // read the source stream to the end, writing the compressed data to the sink, and then close it,
+        // pausing while more than the specified amount of compressed data is waiting to be read
+        static pplx::task<void> compress_stream(concurrency::streams::streambuf<uint8_t> source, concurrency::streams::producer_consumer_buffer<uint8_t> sink, int level, bool gzip, size_t buffered_limit)
+        {
+            struct compressor_state
+            {
+                compressor_state(int level, bool gzip) : deflate(level, gzip), input(64 * 1024) {}
+
+                deflater deflate;
+                std::vector<uint8_t> input;
+                std::vector<uint8_t> output;
+            };
+            auto state = std::make_shared<compressor_state>(level, gzip);
+
+            return pplx::do_while([source, sink, state, buffered_limit]() mutable -> pplx::task<bool>
+            {
+                if (sink.in_avail() > buffered_limit)
+                {
+                    return pplx::complete_after(std::chrono::milliseconds(10)).then([] { return true; });
+                }
+
+                return source.getn(state->input.data(), state->input.size()).then([sink, state](size_t count) mutable -> pplx::task<bool>
+                {
+                    // zero indicates the end of the source stream
+                    state->deflate(state->input.data(), count, 0 == count, state->output);
+                    if (state->output.empty()) return pplx::task_from_result(0 != count);
+                    // the output must remain valid until the write has completed
+                    return sink.putn_nocopy(state->output.data(), state->output.size()).then([state, count](size_t) { return 0 != count; });
+                });
+            }).then([sink](pplx::task<void> finally) mutable -> pplx::task<void>
+            {
+                try
+                {
+                    finally.get();
+                    return sink.close(std::ios_base::out);
+                }
+                catch (...)
+                {
+                    return sink.close(std::ios_base::out, std::current_exception());
+                }
+            });
+        }
+#endif
+
+        // compress the response body, if enabled, and the request's Accept-Encoding header indicates a supported content-coding is acceptable
+        void compress_response_body(const web::http::http_request& req, web::http::http_response& res, const experimental::response_compression& compression)
+        {
+#ifdef NMOS_CPP_HTTP_COMPRESSION
+            using web::http::header_names;
+
+            if (0 >= compression.level) return;
+            if (!res.body() || web::http::methods::HEAD == req.method()) return;
+            if (web::http::status_codes::NoContent == res.status_code() || web::http::status_codes::NotModified == res.status_code()) return;
+            if (res.headers().has(header_names::content_encoding)) return;
+
+            // when the size of the response body is known in advance, small bodies aren't worth compressing
+            utility::size64_t content_length = 0;
+            if (res.headers().match(header_names::content_length, content_length) && compression.threshold > content_length) return;
+
+            // the response may vary according to the request's Accept-Encoding header
+            web::http::add_header_value(res.headers(), header_names::vary, header_names::accept_encoding);
+
+            const auto accept_encoding = req.headers().find(header_names::accept_encoding);
+            if (req.headers().end() == accept_encoding) return;
+            const auto content_coding = select_content_coding(accept_encoding->second);
+            if (content_coding.empty()) return;
+
+            // compress the existing body, which may still be being written, as it's read
+            // the compressed body length isn't known in advance, so the response will use chunked transfer encoding
+            const auto content_type = res.headers().content_type();
+            auto source = res.body().streambuf();
+            concurrency::streams::producer_consumer_buffer<uint8_t> sink;
+            res.set_body(sink.create_istream(), content_type);
+            res.headers().remove(header_names::content_length);
+            res.headers().add(header_names::content_encoding, content_coding);
+
+            compress_stream(source, sink, (std::min)(compression.level, 9), U("gzip") == content_coding, 1024 * 1024).then([](pplx::task<void> finally)
+            {
+                // the compressor has already closed the sink, with any exception, so there's nothing else to do
+                try { finally.get(); } catch (...) {}
+            });
+#endif
+        }
+
         static const utility::string_t actual_method{ U("X-Actual-Method") };
 
+        // the time at which the request was received by the listener, recorded only when metrics are being collected
+        static const utility::string_t received_time{ U("X-Received-Time") };
+
+        typedef std::chrono::steady_clock metrics_clock;
+
+        // get the latency of the request so far, if the time it was received by the listener was recorded
+        static bool get_request_latency(const web::http::http_request& req, std::chrono::microseconds& latency)
+        {
+            const auto received = req.headers().find(received_time);
+            if (req.headers().end() == received) return false;
+            const auto now = std::chrono::duration_cast<std::chrono::microseconds>(metrics_clock::now().time_since_epoch());
+            latency = std::chrono::microseconds(now.count() - utility::istringstreamed<long long>(received->second, now.count()));
+            return true;
+        }
+
+        // the work done by the route handlers for the request so far, i.e. "<cpu time> <lock wait> <lock hold>" in microseconds,
+        // recorded only when request accounting is enabled (see nmos::experimental::initialize_request_accounting)
+        static const utility::string_t accounted_work{ U("X-Accounted-Work") };
+
+        // route call hook to accumulate the work done on each thread by the route handlers for each request
+        static void account_route_call(web::http::http_request& req, bool entering)
+        {
+            auto& accounting = experimental::details::this_thread_request_accounting();
+            if (entering)
+            {
+                if (0 == accounting.depth++)
+                {
+                    accounting.lock_wait = accounting.lock_hold = std::chrono::microseconds::zero();
+                    accounting.cpu_time = experimental::this_thread_cpu_time();
+                }
+                return;
+            }
+            if (0 != --accounting.depth) return;
+
+            long long cpu_time = 0, lock_wait = 0, lock_hold = 0;
+            auto& headers = req.headers();
+            const auto found = headers.find(accounted_work);
+            if (headers.end() != found)
+            {
+                utility::istringstream_t is(found->second);
+                is >> cpu_time >> lock_wait >> lock_hold;
+            }
+            cpu_time += (experimental::this_thread_cpu_time() - accounting.cpu_time).count();
+            lock_wait += accounting.lock_wait.count();
+            lock_hold += accounting.lock_hold.count();
+
+            utility::ostringstream_t os;
+            os << cpu_time << U(' ') << lock_wait << U(' ') << lock_hold;
+            headers[accounted_work] = os.str();
+        }
+
+        // make the extra access log fields for the request, i.e. "<latency> <lock wait> <lock hold> <cpu time>" in microseconds, or an empty string if request accounting isn't enabled
+        // note, the work done by the 'finally' handler itself hasn't been accounted for yet
+        static std::string make_request_accounting_fields(const web::http::http_request& req)
+        {
+            const auto found = req.headers().find(accounted_work);
+            if (req.headers().end() == found) return{};
+
+            long long cpu_time = 0, lock_wait = 0, lock_hold = 0;
+            utility::istringstream_t is(found->second);
+            is >> cpu_time >> lock_wait >> lock_hold;
+
+            std::ostringstream os;
+            std::chrono::microseconds latency;
+            if (get_request_latency(req, latency)) os << latency.count(); else os << "-";
+            os << " " << lock_wait;
+#ifdef NMOS_CPP_INSTRUMENT_MUTEX
+            os << " " << lock_hold;
+#else
+            os << " -";
+#endif
+            os << " " << cpu_time;
+            return os.str();
+        }
+
+        // check whether the specified characters match nmos::patterns::resourceId, without the cost of a regex
+        static bool is_resource_id(utility::string_t::const_iterator first, utility::string_t::const_iterator last)
+        {
+            if (36 != last - first) return false;
+            for (int i = 0; first != last; ++first, ++i)
+            {
+                if (8 == i || 13 == i || 18 == i || 23 == i)
+                {
+                    if (U('-') != *first) return false;
+                }
+                else if (!((U('0') <= *first && *first <= U('9')) || (U('a') <= *first && *first <= U('f'))))
+                {
+                    return false;
+                }
+            }
+            return true;
+        }
+
+        // make a low-cardinality label for the route of a request, by replacing resource ids in the request path, e.g. "/x-nmos/query/v1.3/nodes/{resourceId}"
+        // note, the 'finally' handler doesn't have the route parameters matched by other route handlers, so the label is based on the path alone
+        utility::string_t make_route_label(const utility::string_t& path)
+        {
+            utility::string_t label;
+            label.reserve(path.size());
+            auto segment = path.begin();
+            while (path.end() != segment)
+            {
+                const auto next = std::find(segment + 1, path.end(), U('/'));
+                if (U('/') == *segment && is_resource_id(segment + 1, next))
+                {
+                    label.append(U("/{resourceId}"));
+                }
+                else
+                {
+                    label.append(segment, next);
+                }
+                segment = next;
+            }
+            return label;
+        }
+
         // make handler to set appropriate response headers, and error response body if indicated
-        web::http::experimental::listener::route_handler make_api_finally_handler(slog::base_gate& gate_)
+        web::http::experimental::listener::route_handler make_api_finally_handler(slog::base_gate& gate_, const experimental::response_compression& compression, experimental::metrics* metrics)
         {
             using namespace web::http::experimental::listener::api_router_using_declarations;
 
-            return [&gate_](http_request req, http_response res, const string_t&, const route_parameters& parameters)
+            return [&gate_, compression, metrics](http_request req, http_response res, const string_t& route_path, const route_parameters& parameters)
             {
                 nmos::api_gate gate(gate_, req, parameters);
 
+                // an empty status code means that no other route handler matched the request, so the request path isn't a useful label
+                const bool unmatched = web::http::empty_status_code == res.status_code();
+
                 // if it was a HEAD request, restore that and discard any response body
                 // since RFC 7231 says "the server MUST NOT send a message body in the response"
                 // see https://tools.ietf.org/html/rfc7231#section-4.3.2
@@ -308,7 +675,15 @@ namespace nmos
 
                 nmos::details::add_cors_headers(res);
 
-                slog::detail::logw<slog::log_statement, slog::base_gate>(gate, slog::severities::more_info, SLOG_FLF) << nmos::stash_categories({ nmos::categories::access }) << nmos::common_log_stash(req, res) << "Sending response";
+                nmos::details::compress_response_body(req, res, compression);
+
+                slog::detail::logw<slog::log_statement, slog::base_gate>(gate, slog::severities::more_info, SLOG_FLF) << nmos::stash_categories({ nmos::categories::access }) << nmos::common_log_stash(req, res) << nmos::stash_request_accounting(make_request_accounting_fields(req)) << "Sending response";
+
+                std::chrono::microseconds latency;
+                if (nullptr != metrics && get_request_latency(req, latency))
+                {
+                    metrics->record(unmatched ? U("{unmatched}") : make_route_label(route_path), req.method(), res.status_code(), latency);
+                }
 
                 req.reply(res);
                 return pplx::task_from_result(false); // don't continue matching routes
@@ -331,11 +706,11 @@ namespace nmos
     }
 
     // add handler to set appropriate response headers, and error response body if indicated - call this only after adding all others!
-    void add_api_finally_handler(web::http::experimental::listener::api_router& api, slog::base_gate& gate_)
+    void add_api_finally_handler(web::http::experimental::listener::api_router& api, slog::base_gate& gate_, const experimental::response_compression& compression, experimental::metrics* metrics)
     {
         using namespace web::http::experimental::listener::api_router_using_declarations;
 
-        api.support(U(".*"), details::make_api_finally_handler(gate_));
+        api.support(U(".*"), details::make_api_finally_handler(gate_, compression, metrics));
 
         api.set_exception_handler([&gate_](http_request req, http_response res, const string_t&, const route_parameters& parameters)
         {
@@ -392,29 +767,85 @@ namespace nmos
         });
     }
 
+    namespace details
+    {
+        // make a listener handler which calls the specified API on the specified scheduler, if any - captures api by reference!
+        std::function<void(web::http::http_request)> make_api_listener_handler(web::http::experimental::listener::api_router& api, std::shared_ptr<pplx::scheduler_interface> scheduler)
+        {
+            if (!scheduler) return std::ref(api);
+
+            return [&api, scheduler](web::http::http_request req)
+            {
+                pplx::create_task([&api, req]
+                {
+                    api(req);
+                }, pplx::task_options(scheduler));
+            };
+        }
+
+        // make a listener handler which records the time each request is received, for the 'finally' handler to calculate the latency (see make_api_finally_handler)
+        std::function<void(web::http::http_request)> make_received_time_handler(std::function<void(web::http::http_request)> handler)
+        {
+            return [handler](web::http::http_request req)
+            {
+                const auto now = std::chrono::duration_cast<std::chrono::microseconds>(metrics_clock::now().time_since_epoch());
+                req.headers().add(received_time, utility::ostringstreamed(now.count()));
+                handler(req);
+            };
+        }
+    }
+
     // modify the specified API to handle all requests (including CORS preflight requests via "OPTIONS") and attach it to the specified listener - captures api by reference!
-    void support_api(web::http::experimental::listener::http_listener& listener, web::http::experimental::listener::api_router& api, slog::base_gate& gate)
+    void support_api(web::http::experimental::listener::http_listener& listener, web::http::experimental::listener::api_router& api, slog::base_gate& gate, const experimental::response_compression& compression, std::shared_ptr<pplx::scheduler_interface> scheduler, experimental::metrics* metrics, std::shared_ptr<experimental::traffic_recorder> recorder)
     {
-        add_api_finally_handler(api, gate);
-        listener.support(std::ref(api));
-        listener.support(web::http::methods::OPTIONS, std::ref(api)); // to handle CORS preflight requests
-        listener.support(web::http::methods::HEAD, [&api](web::http::http_request req) // to handle HEAD requests
+        add_api_finally_handler(api, gate, compression, metrics);
+        auto handler = details::make_api_listener_handler(api, scheduler);
+        if (nullptr != metrics) handler = details::make_received_time_handler(handler);
+        std::function<void(web::http::http_request)> head_handler = [handler](web::http::http_request req) // to handle HEAD requests
         {
             // this naive approach means that the API may well generate a response body
             req.headers().add(details::actual_method, web::http::methods::HEAD);
             req.set_method(web::http::methods::GET);
-            api(req);
-        });
+            handler(req);
+        };
+        // requests are recorded as received, before any of the headers used internally are added
+        // note, this means the latency in the metrics excludes the time to receive the request body
+        if (recorder)
+        {
+            handler = experimental::details::make_traffic_capture_handler(handler, recorder);
+            head_handler = experimental::details::make_traffic_capture_handler(head_handler, recorder);
+        }
+        listener.support(handler);
+        listener.support(web::http::methods::OPTIONS, handler); // to handle CORS preflight requests
+        listener.support(web::http::methods::HEAD, head_handler);
     }
 
     // construct an http_listener on the specified port, using the specified API to handle all requests
-    web::http::experimental::listener::http_listener make_api_listener(bool secure, const utility::string_t& host_address, int port, web::http::experimental::listener::api_router& api, web::http::experimental::listener::http_listener_config config, slog::base_gate& gate)
+    web::http::experimental::listener::http_listener make_api_listener(bool secure, const utility::string_t& host_address, int port, web::http::experimental::listener::api_router& api, web::http::experimental::listener::http_listener_config config, slog::base_gate& gate, const experimental::response_compression& compression, std::shared_ptr<pplx::scheduler_interface> scheduler, experimental::metrics* metrics, std::shared_ptr<experimental::traffic_recorder> recorder)
     {
         web::http::experimental::listener::http_listener api_listener(web::http::experimental::listener::make_listener_uri(secure, host_address, port), std::move(config));
-        nmos::support_api(api_listener, api, gate);
+        nmos::support_api(api_listener, api, gate, compression, std::move(scheduler), metrics, std::move(recorder));
         return api_listener;
     }
 
+    namespace experimental
+    {
+        // construct response compression options based on settings
+        response_compression make_response_compression(const nmos::settings& settings)
+        {
+            return{ nmos::experimental::fields::http_compression_level(settings), (size_t)nmos::experimental::fields::http_compression_threshold(settings) };
+        }
+
+        // enable accounting for the work done by the route handlers for each request, if configured, before any requests are handled
+        void initialize_request_accounting(const nmos::settings& settings)
+        {
+            if (nmos::experimental::fields::access_log_accounting(settings))
+            {
+                web::http::experimental::listener::set_route_call_hook(&nmos::details::account_route_call);
+            }
+        }
+    }
+
     // returns "http" or "https" depending on settings
     utility::string_t http_scheme(const nmos::settings& settings)
     {
@@ -6,6 +6,7 @@
 #include "cpprest/api_router.h"
 #include "cpprest/http_listener.h" // for web::http::experimental::listener::http_listener_config
 #include "cpprest/regex_utils.h"
+#include "pplx/pplxinterface.h" // for pplx::scheduler_interface
 #include "nmos/settings.h" // just a forward declaration of nmos::settings
 
 namespace slog
@@ -17,6 +18,8 @@ namespace slog
 namespace nmos
 {
     struct api_version;
+    struct resource;
+    struct resources;
     struct type;
 
     // Patterns are used to form parameterised route paths
@@ -99,15 +102,47 @@ namespace nmos
     // set up a standard NMOS error response, using the default reason phrase and the specified debug information
     void set_error_reply(web::http::http_response& res, web::http::status_code code, const std::exception& debug);
 
+    namespace experimental
+    {
+        struct metrics;
+        class traffic_recorder;
+
+        // options for compressing response bodies according to the request's Accept-Encoding header, using the "gzip" or "deflate" content-coding
+        // note, response bodies are only ever compressed if nmos-cpp is built with NMOS_CPP_HTTP_COMPRESSION
+        struct response_compression
+        {
+            response_compression(int level = 0, size_t threshold = 0) : level(level), threshold(threshold) {}
+
+            // compression level, from 1 (best speed) to 9 (best compression), or 0 to disable compression
+            int level;
+
+            // minimum size in bytes of response bodies to be compressed, when the size is known in advance
+            size_t threshold;
+        };
+
+        // construct response compression options based on settings
+        response_compression make_response_compression(const nmos::settings& settings);
+
+        // enable accounting for the work done by the route handlers for each request, if configured, before any requests are handled
+        // so that the latency, the time spent waiting for and holding the model lock, and the thread CPU time are appended to the access log
+        // (see nmos::experimental::fields::access_log_accounting)
+        void initialize_request_accounting(const nmos::settings& settings);
+    }
+
     // add handler to set appropriate response headers, and error response body if indicated - call this only after adding all others!
-    void add_api_finally_handler(web::http::experimental::listener::api_router& api, slog::base_gate& gate);
+    // if metrics are specified, e.g. see nmos::base_model::metrics, the response status code and latency of each request are recorded - captures metrics by reference!
+    void add_api_finally_handler(web::http::experimental::listener::api_router& api, slog::base_gate& gate, const experimental::response_compression& compression = {}, experimental::metrics* metrics = nullptr);
 
     // modify the specified API to handle all requests (including CORS preflight requests via "OPTIONS") and attach it to the specified listener - captures api by reference!
-    void support_api(web::http::experimental::listener::http_listener& listener, web::http::experimental::listener::api_router& api, slog::base_gate& gate);
+    // if a scheduler is specified, e.g. see nmos::experimental::make_listener_scheduler, the API handles the requests on it rather than on the thread pool shared by all the listeners
+    // (continuations of tasks which are created by the route handlers without a scheduler still run on the shared thread pool)
+    // if metrics are specified, the response status code and latency of each request are recorded - captures metrics by reference!
+    // if a traffic recorder is specified, e.g. see nmos::experimental::make_traffic_recorder, each request is recorded before it is handled
+    void support_api(web::http::experimental::listener::http_listener& listener, web::http::experimental::listener::api_router& api, slog::base_gate& gate, const experimental::response_compression& compression = {}, std::shared_ptr<pplx::scheduler_interface> scheduler = {}, experimental::metrics* metrics = nullptr, std::shared_ptr<experimental::traffic_recorder> recorder = {});
 
     // construct an http_listener on the specified address and port, modifying the specified API to handle all requests
-    // (including CORS preflight requests via "OPTIONS") - captures api by reference!
-    web::http::experimental::listener::http_listener make_api_listener(bool secure, const utility::string_t& host_address, int port, web::http::experimental::listener::api_router& api, web::http::experimental::listener::http_listener_config config, slog::base_gate& gate);
+    // (including CORS preflight requests via "OPTIONS") on the specified scheduler, if any - captures api by reference!
+    web::http::experimental::listener::http_listener make_api_listener(bool secure, const utility::string_t& host_address, int port, web::http::experimental::listener::api_router& api, web::http::experimental::listener::http_listener_config config, slog::base_gate& gate, const experimental::response_compression& compression = {}, std::shared_ptr<pplx::scheduler_interface> scheduler = {}, experimental::metrics* metrics = nullptr, std::shared_ptr<experimental::traffic_recorder> recorder = {});
 
     // construct an http_listener on the specified port, modifying the specified API to handle all requests
     // (including CORS preflight requests via "OPTIONS") - captures api by reference!
@@ -134,10 +169,11 @@ namespace nmos
         void encode_elements(web::json::value& value);
 
         // extract JSON after checking the Content-Type header
-        pplx::task<web::json::value> extract_json(const web::http::http_request& req, slog::base_gate& gate);
+        // the body is parsed directly from its UTF-8 bytes, and is rejected if it is larger than the specified size, unless that is 0
+        pplx::task<web::json::value> extract_json(const web::http::http_request& req, slog::base_gate& gate, std::size_t max_size = 0);
 
         // extract JSON after checking the Content-Type header
-        pplx::task<web::json::value> extract_json(const web::http::http_response& res, slog::base_gate& gate);
+        pplx::task<web::json::value> extract_json(const web::http::http_response& res, slog::base_gate& gate, std::size_t max_size = 0);
 
         // add the NMOS-specified CORS response headers
         web::http::http_response& add_cors_preflight_headers(const web::http::http_request& req, web::http::http_response& res);
@@ -146,11 +182,30 @@ namespace nmos
         // make user error information (to be used with status_codes::NotFound)
         utility::string_t make_erased_resource_error();
 
+        // set the response to a conditional GET to 304 (Not Modified) if the request's If-None-Match header matches the entity-tag of the current representation
+        // See https://tools.ietf.org/html/rfc7232#section-3.2
+        bool set_not_modified_reply(const web::http::http_request& req, web::http::http_response& res, const utility::string_t& entity_tag);
+
+        // make a strong entity-tag for the current state of all the resources, which changes whenever any resource is inserted, modified or erased
+        utility::string_t make_resources_entity_tag(const nmos::resources& resources);
+
+        // make a strong entity-tag for the current state of the specified resource
+        utility::string_t make_resource_entity_tag(const nmos::resource& resource);
+
+        // set the response body to the specified UTF-8 json text, e.g. a pre-serialized representation, without converting it to a json value or utility::string_t
+        void set_utf8_json_reply(web::http::http_response& res, web::http::status_code code, const std::string& utf8);
+
         // make handler to check supported API version, and set error response otherwise
         web::http::experimental::listener::route_handler make_api_version_handler(const std::set<api_version>& versions, slog::base_gate& gate);
 
+        // compress the response body, if enabled, and the request's Accept-Encoding header indicates a supported content-coding is acceptable
+        void compress_response_body(const web::http::http_request& req, web::http::http_response& res, const experimental::response_compression& compression);
+
+        // make a low-cardinality label for the route of a request, by replacing resource ids in the request path, e.g. "/x-nmos/query/v1.3/nodes/{resourceId}"
+        utility::string_t make_route_label(const utility::string_t& path);
+
         // make handler to set appropriate response headers, and error response body if indicated
-        web::http::experimental::listener::route_handler make_api_finally_handler(slog::base_gate& gate);
+        web::http::experimental::listener::route_handler make_api_finally_handler(slog::base_gate& gate, const experimental::response_compression& compression = {}, experimental::metrics* metrics = nullptr);
     }
 }
 
@@ -0,0 +1,284 @@
+#include "nmos/binary_log.h"
+
+#include <algorithm>
+#include <cstring>
+#include <fstream>
+#include <new>
+#include <unordered_map>
+#include <boost/interprocess/file_mapping.hpp>
+#include <boost/interprocess/mapped_region.hpp>
+#include "slog/all_in_one.h"
+
+namespace nmos
+{
+    namespace experimental
+    {
+        namespace details
+        {
+            // the source locations are never overwritten, so a fixed size is enough for all the logging statements of the application
+            const std::size_t binary_log_sites_capacity = 256 * 1024;
+
+            // a record is limited to a quarter of the ring, so the messages around a huge one aren't all overwritten at once
+            const std::size_t binary_log_min_capacity = 64 * 1024;
+
+            inline std::uint64_t binary_log_align(std::uint64_t size)
+            {
+                return (size + 7) & ~std::uint64_t(7);
+            }
+        }
+
+        struct binary_log::impl_t
+        {
+            boost::interprocess::file_mapping mapping;
+            boost::interprocess::mapped_region region;
+            details::binary_log_header* header;
+            char* sites;
+            char* ring;
+
+            // the offset of each source location, by file and line
+            std::unordered_map<std::string, std::uint32_t> site_offsets;
+
+            std::uint32_t site(const char* file, int line, const char* function)
+            {
+                std::string key(file);
+                key.push_back(':');
+                key.append(std::to_string(line));
+
+                auto found = site_offsets.find(key);
+                if (site_offsets.end() != found) return found->second;
+
+                const auto file_size = (std::min)(std::strlen(file), (std::size_t)UINT16_MAX);
+                const auto function_size = (std::min)(std::strlen(function), (std::size_t)UINT16_MAX);
+                const auto offset = header->sites_size.load(std::memory_order_relaxed);
+                const auto size = details::binary_log_align(sizeof(details::binary_log_site) + file_size + function_size);
+                if (header->sites_capacity < offset + size)
+                {
+                    // once the source locations are full, further ones are recorded as unknown
+                    site_offsets.insert({ std::move(key), details::binary_log_unknown_site });
+                    return details::binary_log_unknown_site;
+                }
+
+                const details::binary_log_site entry{ (std::uint32_t)line, (std::uint16_t)file_size, (std::uint16_t)function_size };
+                std::memcpy(sites + offset, &entry, sizeof(entry));
+                std::memcpy(sites + offset + sizeof(entry), file, file_size);
+                std::memcpy(sites + offset + sizeof(entry) + file_size, function, function_size);
+                header->sites_size.store(offset + size, std::memory_order_release);
+
+                site_offsets.insert({ std::move(key), (std::uint32_t)offset });
+                return (std::uint32_t)offset;
+            }
+
+            // discard the least recent records until there is room for the specified number of bytes at the head
+            void make_room(std::uint64_t head, std::uint64_t size)
+            {
+                auto tail = header->tail.load(std::memory_order_relaxed);
+                while (header->capacity < head + size - tail)
+                {
+                    details::binary_log_record_header record;
+                    std::memcpy(&record, ring + tail % header->capacity, sizeof(record.size));
+                    tail += record.size;
+                }
+                header->tail.store(tail, std::memory_order_release);
+            }
+
+            void write(const details::binary_log_record_header& record, const std::string& categories, const char* message)
+            {
+                auto head = header->head.load(std::memory_order_relaxed);
+
+                // a record is never split across the end of the ring
+                const auto remaining = header->capacity - head % header->capacity;
+                if (remaining < record.size)
+                {
+                    make_room(head, remaining);
+                    details::binary_log_record_header padding{};
+                    padding.size = (std::uint32_t)remaining;
+                    padding.level = details::binary_log_padding_level;
+                    std::memcpy(ring + head % header->capacity, &padding, (std::min)(remaining, (std::uint64_t)sizeof(padding)));
+                    head += remaining;
+                    header->head.store(head, std::memory_order_release);
+                }
+
+                make_room(head, record.size);
+                char* first = ring + head % header->capacity;
+                std::memcpy(first, &record, sizeof(record));
+                std::memcpy(first + sizeof(record), categories.data(), record.categories_size);
+                std::memcpy(first + sizeof(record) + record.categories_size, message, record.message_size);
+                header->head.store(head + record.size, std::memory_order_release);
+            }
+        };
+
+        binary_log::binary_log()
+            : open_(false)
+            , level_(0)
+        {
+        }
+
+        binary_log::~binary_log()
+        {
+            close();
+        }
+
+        bool binary_log::open(const std::string& filename, std::size_t size, int level)
+        {
+            close();
+
+            const auto capacity = details::binary_log_align((std::max)(size, details::binary_log_min_capacity) - 7);
+            const auto file_size = sizeof(details::binary_log_header) + details::binary_log_sites_capacity + capacity;
+
+            try
+            {
+                {
+                    // a file left behind by a previous run is replaced
+                    std::ofstream file(filename, std::ios::binary | std::ios::trunc);
+                    file.seekp(file_size - 1);
+                    file.put('\0');
+                    if (!file) return false;
+                }
+
+                std::unique_ptr<impl_t> opened(new impl_t);
+                opened->mapping = boost::interprocess::file_mapping(filename.c_str(), boost::interprocess::read_write);
+                opened->region = boost::interprocess::mapped_region(opened->mapping, boost::interprocess::read_write);
+                if (opened->region.get_size() < file_size) return false;
+
+                auto header = new (opened->region.get_address()) details::binary_log_header;
+                header->format = details::binary_log_format;
+                header->reserved = 0;
+                header->sites_capacity = details::binary_log_sites_capacity;
+                header->capacity = capacity;
+                header->sites_size.store(0, std::memory_order_relaxed);
+                header->tail.store(0, std::memory_order_relaxed);
+                header->head.store(0, std::memory_order_relaxed);
+
+                // the magic is written last, so a file that hasn't been initialized isn't recognised
+                std::atomic_thread_fence(std::memory_order_release);
+                std::memcpy(header->magic, details::binary_log_magic, sizeof(header->magic));
+
+                opened->header = header;
+                opened->sites = (char*)(header + 1);
+                opened->ring = opened->sites + details::binary_log_sites_capacity;
+
+                impl = std::move(opened);
+            }
+            catch (const boost::interprocess::interprocess_exception&)
+            {
+                return false;
+            }
+
+            level_.store(level, std::memory_order_relaxed);
+            open_.store(true, std::memory_order_relaxed);
+            return true;
+        }
+
+        bool binary_log::is_open() const
+        {
+            return (bool)impl;
+        }
+
+        void binary_log::close()
+        {
+            open_.store(false, std::memory_order_relaxed);
+            if (!impl) return;
+            impl->region.flush();
+            impl.reset();
+        }
+
+        void binary_log::write(const slog::async_log_message& message, const std::list<std::string>& categories)
+        {
+            if (!impl) return;
+
+            std::string joined;
+            for (const auto& category : categories)
+            {
+                if (!joined.empty()) joined.push_back(',');
+                joined.append(category);
+            }
+            if (UINT16_MAX < joined.size()) joined.resize(UINT16_MAX);
+
+            const auto str = message.str();
+
+            details::binary_log_record_header record{};
+            record.level = message.level();
+            record.timestamp = (std::int64_t)bst::chrono::duration_cast<bst::chrono::nanoseconds>(message.timestamp().time_since_epoch()).count();
+            record.thread_id = (std::uint64_t)std::hash<bst::thread::id>()(message.thread_id());
+            record.site = impl->site(message.file(), message.line(), message.function());
+            record.categories_size = (std::uint16_t)joined.size();
+
+            // a huge message is truncated, rather than overwriting most of the ring
+            const std::uint64_t max_size = impl->header->capacity / 4;
+            const std::uint64_t fixed_size = sizeof(record) + record.categories_size;
+            record.message_size = (std::uint32_t)(std::min)((std::uint64_t)str.size(), max_size - fixed_size);
+            record.size = (std::uint32_t)details::binary_log_align(fixed_size + record.message_size);
+
+            impl->write(record, joined, str.data());
+        }
+
+        bool read_binary_log(const std::string& contents, const std::function<void(const binary_log_record&)>& record)
+        {
+            if (contents.size() < sizeof(details::binary_log_header)) return false;
+            const auto& header = *(const details::binary_log_header*)contents.data();
+            if (0 != std::memcmp(header.magic, details::binary_log_magic, sizeof(header.magic))
+                || details::binary_log_format != header.format
+                || contents.size() < sizeof(details::binary_log_header) + header.sites_capacity + header.capacity
+                || 0 == header.capacity)
+            {
+                return false;
+            }
+
+            const char* sites = (const char*)(&header + 1);
+            const char* ring = sites + header.sites_capacity;
+            const auto sites_size = (std::min)(header.sites_size.load(std::memory_order_acquire), header.sites_capacity);
+            const auto head = header.head.load(std::memory_order_acquire);
+            auto tail = header.tail.load(std::memory_order_acquire);
+            // a writer may have advanced the tail since the header was read, in which case the records may no longer be aligned
+            if (head - tail > header.capacity) return true;
+
+            while (tail < head)
+            {
+                const auto offset = tail % header.capacity;
+                const auto remaining = header.capacity - offset;
+
+                details::binary_log_record_header fixed{};
+                std::memcpy(&fixed, ring + offset, (std::min)(remaining, (std::uint64_t)sizeof(fixed)));
+                if (0 == fixed.size || 0 != fixed.size % 8 || remaining < fixed.size) return true;
+                tail += fixed.size;
+                if (details::binary_log_padding_level == fixed.level) continue;
+                if (fixed.size < sizeof(fixed) + fixed.categories_size + fixed.message_size) return true;
+
+                binary_log_record decoded;
+                decoded.level = fixed.level;
+                decoded.timestamp = fixed.timestamp;
+                decoded.thread_id = fixed.thread_id;
+                decoded.line = 0;
+                if (details::binary_log_unknown_site != fixed.site && fixed.site + sizeof(details::binary_log_site) <= sites_size)
+                {
+                    details::binary_log_site site;
+                    std::memcpy(&site, sites + fixed.site, sizeof(site));
+                    if (fixed.site + sizeof(site) + site.file_size + site.function_size <= sites_size)
+                    {
+                        decoded.line = (int)site.line;
+                        decoded.file.assign(sites + fixed.site + sizeof(site), site.file_size);
+                        decoded.function.assign(sites + fixed.site + sizeof(site) + site.file_size, site.function_size);
+                    }
+                }
+                const char* categories = ring + offset + sizeof(fixed);
+                if (0 != fixed.categories_size)
+                {
+                    const std::string joined(categories, fixed.categories_size);
+                    std::string::size_type first = 0;
+                    for (;;)
+                    {
+                        const auto last = joined.find(',', first);
+                        decoded.categories.push_back(joined.substr(first, last - first));
+                        if (std::string::npos == last) break;
+                        first = last + 1;
+                    }
+                }
+                decoded.message.assign(categories + fixed.categories_size, fixed.message_size);
+
+                record(decoded);
+            }
+
+            return true;
+        }
+    }
+}
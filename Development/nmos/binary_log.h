@@ -0,0 +1,127 @@
+#ifndef NMOS_BINARY_LOG_H
+#define NMOS_BINARY_LOG_H
+
+#include <atomic>
+#include <cstdint>
+#include <functional>
+#include <list>
+#include <memory>
+#include <string>
+#include <vector>
+
+namespace slog
+{
+    class async_log_message;
+}
+
+// This is an experimental extension to record log messages in a compact binary form in a memory-mapped ring file, so that at verbose
+// logging levels the cost of formatting each message as text, or as JSON for the Logging API, is deferred until the file is decoded,
+// e.g. by nmos-cpp-logdecode, and the most recent messages survive the process crashing
+// See nmos::experimental::fields::binary_log
+namespace nmos
+{
+    namespace experimental
+    {
+        namespace details
+        {
+            // the layout of the file, this header, followed by sites_capacity bytes for the source locations, and capacity bytes for the ring of records
+            struct binary_log_header
+            {
+                // identifies the format, in case it ever needs to change
+                char magic[16];
+                std::uint32_t format;
+                std::uint32_t reserved;
+
+                std::uint64_t sites_capacity;
+                std::uint64_t capacity;
+
+                // the size of the source locations written so far
+                std::atomic<std::uint64_t> sites_size;
+
+                // the logical offsets of the least recent record, and of the end of the most recent record, which only ever increase
+                // the physical offset in the ring is the logical offset modulo the capacity
+                std::atomic<std::uint64_t> tail;
+                std::atomic<std::uint64_t> head;
+            };
+
+            const char binary_log_magic[16] = "nmos_binary_log";
+            const std::uint32_t binary_log_format = 1;
+
+            // each source location is written once, and identified by its offset; the file and function names follow this header
+            struct binary_log_site
+            {
+                std::uint32_t line;
+                std::uint16_t file_size;
+                std::uint16_t function_size;
+            };
+
+            // each record is this header, followed by the categories, separated by commas, and the message, padded to a multiple of 8 bytes
+            // a record at the padding level fills the space at the end of the ring which is too small for the next record
+            struct binary_log_record_header
+            {
+                std::uint32_t size;
+                std::int32_t level;
+                std::int64_t timestamp; // nanoseconds since the system clock epoch
+                std::uint64_t thread_id; // a hash of the thread id
+                std::uint32_t site; // the offset of the source location, or binary_log_unknown_site
+                std::uint32_t message_size;
+                std::uint16_t categories_size;
+                std::uint16_t reserved[3];
+            };
+
+            const std::int32_t binary_log_padding_level = INT32_MIN;
+            const std::uint32_t binary_log_unknown_site = UINT32_MAX;
+        }
+
+        // a decoded log message
+        struct binary_log_record
+        {
+            int level;
+            std::int64_t timestamp; // nanoseconds since the system clock epoch
+            std::uint64_t thread_id;
+            std::string file;
+            int line;
+            std::string function;
+            std::vector<std::string> categories;
+            std::string message;
+        };
+
+        // a memory-mapped ring file of log messages, in which the least recent messages are overwritten when it is full
+        // messages must only be written by one thread at a time, e.g. the log service thread of nmos::experimental::log_gate
+        class binary_log
+        {
+        public:
+            binary_log();
+            ~binary_log();
+
+            // create (or replace) the specified file, of about the specified size in bytes, to record the messages at or above the specified level,
+            // returning false on failure
+            bool open(const std::string& filename, std::size_t size, int level);
+            bool is_open() const;
+
+            // flush the file and close it
+            void close();
+
+            // determine whether a message at the specified level would be recorded, without any locking
+            bool pertinent(int level) const { return open_.load(std::memory_order_relaxed) && level_.load(std::memory_order_relaxed) <= level; }
+
+            // record a message, with the specified categories
+            void write(const slog::async_log_message& message, const std::list<std::string>& categories);
+
+            binary_log(const binary_log&) = delete;
+            binary_log& operator=(const binary_log&) = delete;
+
+        private:
+            struct impl_t;
+            std::unique_ptr<impl_t> impl;
+            std::atomic<bool> open_;
+            std::atomic<int> level_;
+        };
+
+        // decode the records in the contents of a binary log file, least recent first, returning false if the contents aren't recognised
+        // if the file was being written while it was read, the least recent records may have been overwritten, and are then skipped
+        bool read_binary_log(const std::string& contents, const std::function<void(const binary_log_record&)>& record);
+    }
+}
+
+#endif
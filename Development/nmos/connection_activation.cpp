@@ -0,0 +1,205 @@
+#include "nmos/connection_activation.h"
+
+#include <iomanip>
+#include <set>
+#include "nmos/activation_mode.h"
+#include "nmos/connection_api.h"
+#include "nmos/model.h"
+#include "nmos/resources_batch.h"
+#include "nmos/slog.h"
+#include "nmos/tracepoints.h"
+
+namespace nmos
+{
+    namespace details
+    {
+        // get the scheduled activation time of the specified connection resource, if it has a pending scheduled activation
+        static bool get_scheduled_activation(const nmos::resource& resource, nmos::tai_clock::time_point& scheduled_activation)
+        {
+            auto& staged_activation = nmos::fields::activation(nmos::fields::endpoint_staged(resource.data));
+            auto& staged_mode_or_null = nmos::fields::mode(staged_activation);
+            if (staged_mode_or_null.is_null()) return false;
+
+            const nmos::activation_mode staged_mode{ staged_mode_or_null.as_string() };
+            if (nmos::activation_modes::activate_scheduled_absolute != staged_mode &&
+                nmos::activation_modes::activate_scheduled_relative != staged_mode) return false;
+
+            scheduled_activation = nmos::time_point_from_tai(nmos::parse_version(nmos::fields::activation_time(staged_activation).as_string()));
+            return true;
+        }
+    }
+
+    // wait for immediate activations, and the activation time of scheduled activations, and process each one as it becomes due,
+    // updating both the IS-05 connection resource and the IS-04 resource, until the server is shut down
+    void connection_activation_thread(nmos::node_model& model, connection_resource_auto_resolver resolve_auto, connection_activation_handler activated, slog::base_gate& gate)
+    {
+        if (!resolve_auto)
+        {
+            resolve_auto = [](const std::pair<nmos::id, nmos::type>& id_type, web::json::value& endpoint_active)
+            {
+                nmos::resolve_auto(id_type.second, endpoint_active[nmos::fields::transport_params]);
+            };
+        }
+
+        // process an immediate activation or scheduled activation, by staging the updates to the IS-05 connection resource and the IS-04 resource
+        // so that both (and those for any other activations processed at the same time) are committed together
+        const auto process_activation = [&](const std::pair<nmos::id, nmos::type>& id_type, nmos::experimental::resources_transaction& transaction)
+        {
+            const auto activation_time = nmos::tai_now();
+
+            // the update to the IS-05 connection resource determines the update to the IS-04 resource
+            struct activation_state
+            {
+                bool active = false;
+                nmos::id connected_id;
+            };
+            auto state = std::make_shared<activation_state>();
+
+            // Update the IS-05 connection resource, and call the underlying implementation
+
+            transaction.modify(model.connection_resources, id_type.first, [&resolve_auto, &activated, activation_time, state](nmos::resource& connection_resource)
+            {
+                const std::pair<nmos::id, nmos::type> id_type{ connection_resource.id, connection_resource.type };
+                nmos::set_connection_resource_active(connection_resource, [&](web::json::value& endpoint_active)
+                {
+                    resolve_auto(id_type, endpoint_active);
+                    state->active = nmos::fields::master_enable(endpoint_active);
+                    // Senders indicate the connected receiver_id, receivers indicate the connected sender_id
+                    auto& connected_id_or_null = nmos::types::sender == id_type.second ? nmos::fields::receiver_id(endpoint_active) : nmos::fields::sender_id(endpoint_active);
+                    if (!connected_id_or_null.is_null()) state->connected_id = connected_id_or_null.as_string();
+                }, activation_time);
+
+                if (activated) activated(connection_resource);
+            });
+
+            // Update the IS-04 resource
+
+            transaction.modify(model.node_resources, id_type.first, [activation_time, state](nmos::resource& resource)
+            {
+                nmos::set_resource_subscription(resource, state->active, state->connected_id, activation_time);
+            });
+        };
+
+        auto lock = model.write_lock();
+
+        // pending scheduled activations, in order of activation time, so that there's no need to go through all the connection resources to find those that are due
+        // entries are not removed when a scheduled activation is cancelled or rescheduled, but are just checked against the staged activation when they are due
+        std::set<std::pair<nmos::tai_clock::time_point, std::pair<nmos::id, nmos::type>>> scheduled_activations;
+
+        // scheduled activations are processed as soon as possible after the activation time, but by how much later is an indication of how precisely they are processed
+        std::chrono::microseconds scheduled_activation_latency_max{};
+        std::chrono::microseconds scheduled_activation_latency_total{};
+        size_t scheduled_activation_count = 0;
+
+        auto most_recent_update = nmos::tai_min();
+        auto earliest_scheduled_activation = (nmos::tai_clock::time_point::max)();
+
+        for (;;)
+        {
+            // wait for the thread to be interrupted because there may be new scheduled activations, or immediate activations to process
+            // or because the server is being shut down
+            // or because it's time for the next scheduled activation
+            model.wait_until(lock, earliest_scheduled_activation, [&] { return model.shutdown || most_recent_update < nmos::most_recent_update(model.connection_resources); });
+            if (model.shutdown) break;
+
+            auto& by_updated = model.connection_resources.get<nmos::tags::updated>();
+
+            // go through the connection resources that have been updated since last time
+            // process any immediate activations
+            // identify any new scheduled activations
+            // and then process any scheduled activations whose requested_time has passed
+
+            nmos::experimental::resources_transaction transaction;
+
+            // since modify reorders the resource in this index, first identify the updated resources
+            std::vector<std::pair<nmos::id, nmos::type>> immediate_activations;
+            for (auto& resource : by_updated)
+            {
+                if (resource.updated <= most_recent_update) break;
+                if (!resource.has_data()) continue;
+
+                const std::pair<nmos::id, nmos::type> id_type{ resource.id, resource.type };
+
+                auto& staged = nmos::fields::endpoint_staged(resource.data);
+                auto& staged_activation = nmos::fields::activation(staged);
+                auto& staged_mode_or_null = nmos::fields::mode(staged_activation);
+
+                if (staged_mode_or_null.is_null()) continue;
+
+                const nmos::activation_mode staged_mode{ staged_mode_or_null.as_string() };
+
+                nmos::tai_clock::time_point scheduled_activation;
+                if (details::get_scheduled_activation(resource, scheduled_activation))
+                {
+                    scheduled_activations.insert({ scheduled_activation, id_type });
+                }
+                else if (nmos::activation_modes::activate_immediate == staged_mode)
+                {
+                    // check for cancelled in-flight immediate activation
+                    if (nmos::fields::requested_time(staged_activation).is_null()) continue;
+                    // check for processed in-flight immediate activation
+                    if (!nmos::fields::activation_time(staged_activation).is_null()) continue;
+
+                    immediate_activations.push_back(id_type);
+                }
+                else
+                {
+                    slog::log<slog::severities::severe>(gate, SLOG_FLF) << "Unexpected activation mode for " << id_type;
+                }
+            }
+
+            for (const auto& id_type : immediate_activations)
+            {
+                slog::log<slog::severities::info>(gate, SLOG_FLF) << "Processing immediate activation for " << id_type;
+                NMOS_CPP_TRACE(activation_process, id_type.first.c_str(), 0, 0LL);
+
+                process_activation(id_type, transaction);
+            }
+
+            const auto now = nmos::tai_clock::now();
+
+            while (!scheduled_activations.empty() && scheduled_activations.begin()->first <= now)
+            {
+                const auto due = *scheduled_activations.begin();
+                scheduled_activations.erase(scheduled_activations.begin());
+
+                // check the scheduled activation is still pending, and hasn't been cancelled or rescheduled
+                const auto resource = nmos::find_resource(model.connection_resources, due.second);
+                if (model.connection_resources.end() == resource) continue;
+                nmos::tai_clock::time_point scheduled_activation;
+                if (!details::get_scheduled_activation(*resource, scheduled_activation) || due.first != scheduled_activation) continue;
+
+                const auto latency = std::chrono::duration_cast<std::chrono::microseconds>(now - due.first);
+                scheduled_activation_latency_max = (std::max)(scheduled_activation_latency_max, latency);
+                scheduled_activation_latency_total += latency;
+                ++scheduled_activation_count;
+
+                slog::log<slog::severities::info>(gate, SLOG_FLF) << "Processing scheduled activation for " << due.second;
+                slog::log<slog::severities::more_info>(gate, SLOG_FLF) << "Scheduled activation latency: " << latency.count() << " us"
+                    << " (mean: " << scheduled_activation_latency_total.count() / scheduled_activation_count << " us, max: " << scheduled_activation_latency_max.count() << " us, over " << scheduled_activation_count << " scheduled activations)";
+                NMOS_CPP_TRACE(activation_process, due.second.first.c_str(), 1, (long long)latency.count());
+
+                process_activation(due.second, transaction);
+            }
+
+            earliest_scheduled_activation = !scheduled_activations.empty() ? scheduled_activations.begin()->first : (nmos::tai_clock::time_point::max)();
+
+            if ((nmos::tai_clock::time_point::max)() != earliest_scheduled_activation)
+            {
+                slog::log<slog::severities::more_info>(gate, SLOG_FLF) << "Next scheduled activation is at " << nmos::make_version(nmos::tai_from_time_point(earliest_scheduled_activation))
+                    << " in about " << std::fixed << std::setprecision(3) << std::chrono::duration_cast<std::chrono::duration<double>>(earliest_scheduled_activation - now).count() << " seconds time";
+            }
+
+            if (!transaction.empty())
+            {
+                slog::log<slog::severities::too_much_info>(gate, SLOG_FLF) << "Notifying node behaviour thread"; // and anyone else who cares...
+                NMOS_CPP_TRACE(activation_commit, transaction.size());
+                const auto failures = transaction.commit(model);
+                NMOS_CPP_TRACE(activation_committed, failures);
+                if (0 != failures) slog::log<slog::severities::severe>(gate, SLOG_FLF) << "Model update error for " << failures << " resources";
+            }
+
+            most_recent_update = nmos::most_recent_update(model.connection_resources);
+        }
+    }
+}
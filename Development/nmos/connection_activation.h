@@ -0,0 +1,39 @@
+#ifndef NMOS_CONNECTION_ACTIVATION_H
+#define NMOS_CONNECTION_ACTIVATION_H
+
+#include <functional>
+#include "cpprest/json.h"
+#include "nmos/id.h"
+
+namespace slog
+{
+    class base_gate;
+}
+
+// Processing of the immediate and scheduled activations of the IS-05 senders and receivers of a node,
+// so that the underlying implementation is called directly when each activation is due, rather than having to watch the model
+// See https://github.com/AMWA-TV/nmos-device-connection-management/blob/v1.0/docs/2.2.%20APIs%20-%20Server%20Side%20Implementation.md
+namespace nmos
+{
+    struct node_model;
+    struct resource;
+    struct type;
+
+    // a connection_resource_auto_resolver resolves all instances of "auto" in the transport parameters of the specified endpoint of an IS-05 sender or receiver,
+    // e.g. by calling nmos::details::resolve_auto for any vendor-specific values and then nmos::resolve_auto for the rest
+    typedef std::function<void(const std::pair<nmos::id, nmos::type>& id_type, web::json::value& endpoint_active)> connection_resource_auto_resolver;
+
+    // a connection_activation_handler is called as soon as an immediate or scheduled activation of the specified IS-05 sender or receiver is due,
+    // after the staged parameters have been made active and "auto" values resolved, so that the underlying implementation can be reconfigured
+    // using the resolved transport parameters, i.e. nmos::fields::transport_params(nmos::fields::endpoint_active(connection_resource.data));
+    // it may also update the connection resource, e.g. to set the sender /transportfile
+    // it is called on the activation thread with the model write lock held, and the Connection API response isn't sent until it returns, so it should be quick
+    typedef std::function<void(nmos::resource& connection_resource)> connection_activation_handler;
+
+    // wait for immediate activations, and the activation time of scheduled activations, and process each one as it becomes due,
+    // updating both the IS-05 connection resource and the IS-04 resource, until the server is shut down
+    // if no auto resolver is specified, only nmos::resolve_auto is used
+    void connection_activation_thread(nmos::node_model& model, connection_resource_auto_resolver resolve_auto, connection_activation_handler activated, slog::base_gate& gate);
+}
+
+#endif
@@ -1,7 +1,11 @@
 #include "nmos/connection_api.h"
 
+#include <mutex>
+#include <thread>
+#include <boost/algorithm/string/split.hpp>
 #include <boost/range/join.hpp>
 #include "cpprest/http_utils.h"
+#include "cpprest/json_utils.h" // for web::json::experimental::serialize_utf8
 #include "cpprest/json_validator.h"
 #include "nmos/activation_mode.h"
 #include "nmos/api_downgrade.h"
@@ -180,21 +184,55 @@ namespace nmos
             }, keep_order);
         }
 
+        // Validators for the constraints of senders or receivers, keyed by the constraints themselves, since constraints rarely change
+        // and many senders or receivers typically have the same constraints, whereas compiling the schema is much more expensive than validation
+        // the cache is shared by all node models in the process, and is simply cleared when it reaches its capacity
+        class staged_constraints_validators
+        {
+        public:
+            explicit staged_constraints_validators(size_t capacity = 1024) : capacity(capacity) {}
+
+            web::json::experimental::json_validator get(const nmos::type& type, const web::json::value& constraints, const web::uri& uri)
+            {
+                std::lock_guard<std::mutex> lock(mutex);
+
+                const auto key = std::make_pair(type, constraints.serialize());
+                auto found = validators.find(key);
+                if (validators.end() == found)
+                {
+                    if (capacity <= validators.size()) validators.clear();
+
+                    const auto schema = make_constraints_schema(type, constraints);
+
+                    found = validators.insert({ key, web::json::experimental::json_validator
+                    {
+                        [&](const web::uri& ) { return schema; },
+                        { uri }
+                    } }).first;
+                }
+                return found->second;
+            }
+
+        private:
+            std::mutex mutex;
+            const size_t capacity;
+            std::map<std::pair<nmos::type, utility::string_t>, web::json::experimental::json_validator> validators;
+        };
+
+        static staged_constraints_validators& staged_constraints_validator_cache()
+        {
+            static staged_constraints_validators validators;
+            return validators;
+        }
+
         // Validate staged endpoint against constraints
         void validate_staged_constraints(const nmos::type& type, const web::json::value& constraints, const web::json::value& staged)
         {
-            const auto schema = make_constraints_schema(type, constraints);
             const auto uri = web::uri{U("/constraints")};
 
-            // Validate staged JSON syntax according to the schema
-
-            const web::json::experimental::json_validator validator
-            {
-                [&](const web::uri& ) { return schema; },
-                { uri }
-            };
+            const auto validator = staged_constraints_validator_cache().get(type, constraints, uri);
 
-            // Validate JSON syntax according to the schema
+            // Validate staged JSON syntax according to the schema
 
             validator.validate(staged, uri);
         }
@@ -385,7 +423,10 @@ namespace nmos
             using web::json::value;
 
             // lock.owns_lock() must be true initially; waiting releases and reacquires the lock
-            if (!wait_activation_modified(model, lock, id_type, response_activation) || model.shutdown)
+            const auto waiting = std::chrono::steady_clock::now();
+            const bool modified = wait_activation_modified(model, lock, id_type, response_activation);
+            model.metrics.connection_patch.activation.record(nmos::experimental::elapsed_since(waiting));
+            if (!modified || model.shutdown)
             {
                 throw std::logic_error("timed out waiting for in-flight immediate activation to complete");
             }
@@ -449,6 +490,126 @@ namespace nmos
             return make_connection_resource_patch_error_response(code,{}, utility::s2us(debug.what()));
         }
 
+        // make the response for an element of a bulk request for which an exception has been thrown
+        // try-catch based on the exception handler in nmos::add_api_finally_handler
+        connection_resource_patch_response handle_connection_resource_patch_exception(const nmos::id& id, slog::base_gate& gate)
+        {
+            using namespace web::http::experimental::listener::api_router_using_declarations;
+
+            try
+            {
+                throw;
+            }
+            catch (const web::json::json_exception& e)
+            {
+                slog::log<slog::severities::warning>(gate, SLOG_FLF) << "JSON error for " << id << " in bulk request: " << e.what();
+                return make_connection_resource_patch_error_response(status_codes::BadRequest, e);
+            }
+            catch (const web::http::http_exception& e)
+            {
+                slog::log<slog::severities::warning>(gate, SLOG_FLF) << "HTTP error for " << id << " in bulk request: " << e.what() << " [" << e.error_code() << "]";
+                return make_connection_resource_patch_error_response(status_codes::BadRequest, e);
+            }
+            catch (const std::runtime_error& e)
+            {
+                slog::log<slog::severities::error>(gate, SLOG_FLF) << "Implementation error for " << id << " in bulk request: " << e.what();
+                return make_connection_resource_patch_error_response(status_codes::NotImplemented, e);
+            }
+            catch (const std::logic_error& e)
+            {
+                slog::log<slog::severities::error>(gate, SLOG_FLF) << "Implementation error for " << id << " in bulk request: " << e.what();
+                return make_connection_resource_patch_error_response(status_codes::InternalError, e);
+            }
+            catch (const std::exception& e)
+            {
+                slog::log<slog::severities::error>(gate, SLOG_FLF) << "Unexpected exception for " << id << " in bulk request: " << e.what();
+                return make_connection_resource_patch_error_response(status_codes::InternalError, e);
+            }
+            catch (...)
+            {
+                slog::log<slog::severities::severe>(gate, SLOG_FLF) << "Unexpected unknown exception for " << id << " in bulk request";
+                return make_connection_resource_patch_error_response(status_codes::InternalError);
+            }
+        }
+
+        // the transport file in a patch, parsed, and validated against the IS-04 receiver, before acquiring the model write lock
+        struct connection_resource_patch_transport_file
+        {
+            connection_resource_patch_transport_file() : parsed(false) {}
+
+            // whether the patch has a transport file from which transport parameters were parsed
+            bool parsed;
+            nmos::sdp_parameters sdp_params;
+            web::json::value transport_params;
+
+            // the version of the receiver against which the transport file was validated, so that it need only be validated again
+            // with the model lock if the receiver has since been modified
+            utility::string_t receiver_version;
+
+            // any error processing the transport file, which is only thrown once the resource has been found and the patch is known to be acceptable,
+            // i.e. at the same point as if the transport file had been processed with the model lock
+            std::exception_ptr error;
+        };
+
+        // parsing the SDP file and validating it against the receiver don't require the model write lock, and may take long enough to block other requests
+        // so they are done beforehand, taking just a read lock to copy the receiver
+        connection_resource_patch_transport_file prepare_connection_resource_patch_transport_file(nmos::node_model& model, const std::pair<nmos::id, nmos::type>& id_type, const web::json::value& patch, slog::base_gate& gate)
+        {
+            connection_resource_patch_transport_file prepared;
+
+            try
+            {
+                auto& transport_file = nmos::fields::transport_file(patch);
+                if (transport_file.is_null() || transport_file.as_object().empty()) return prepared;
+
+                const auto transport_type_data = details::get_transport_type_data(transport_file);
+                if (transport_type_data.first.empty()) return prepared;
+
+                slog::log<slog::severities::more_info>(gate, SLOG_FLF) << "Processing transport file";
+
+                if (transport_type_data.first != U("application/sdp"))
+                {
+                    throw transport_file_error("unexpected type: " + utility::us2s(transport_type_data.first));
+                }
+
+                try
+                {
+                    auto sdp_transport_params = nmos::parse_session_description(utility::us2s(transport_type_data.second));
+
+                    // Validate transport file according to the IS-04 receiver
+
+                    const auto receiver = with_read_lock(model.mutex, [&]
+                    {
+                        auto receiver = find_resource(model.node_resources, id_type);
+                        return model.node_resources.end() != receiver ? receiver->data : web::json::value::null();
+                    });
+                    if (!receiver.is_null())
+                    {
+                        validate_sdp_parameters(receiver, sdp_transport_params.first);
+                        prepared.receiver_version = nmos::fields::version(receiver);
+                    }
+
+                    prepared.parsed = true;
+                    prepared.sdp_params = std::move(sdp_transport_params.first);
+                    prepared.transport_params = std::move(sdp_transport_params.second);
+                }
+                catch (const web::json::json_exception& e)
+                {
+                    throw transport_file_error(e.what());
+                }
+                catch (const std::runtime_error& e)
+                {
+                    throw transport_file_error(e.what());
+                }
+            }
+            catch (...)
+            {
+                prepared.error = std::current_exception();
+            }
+
+            return prepared;
+        }
+
         // Basic theory of implementation of PATCH /staged
         //
         // 1. Reject any patch, other than cancellation, when a scheduled activation is outstanding.
@@ -489,21 +650,22 @@ namespace nmos
         // also be set back to null to unblock concurrent patch operations (nmos::set_connection_resource_not_pending does both).
         //
         // This obviously requires co-operation from other threads that are manipulating these connection resources.
-        // nmos-cpp-node/node_implementation.cpp currently serves as an example of how to handle sender/receiver activations.
+        // nmos::connection_activation_thread handles sender/receiver activations in this way, calling the underlying implementation
+        // as each one is due; nmos-cpp-node/node_implementation.cpp serves as an example of how to use it.
         //
         // By the time we reacquire the model lock anything may have happened, but we can identify with the above whether to send
         // a success response or an error, and in the success case, release the 'per-resource lock' by updating the staged
         // activation mode, requested_time and activation_time.
-        connection_resource_patch_response handle_connection_resource_patch(nmos::node_model& model, nmos::write_lock& lock, const nmos::api_version& version, const std::pair<nmos::id, nmos::type>& id_type, const web::json::value& patch, const nmos::tai& request_time, slog::base_gate& gate)
+        //
+        // The patch must already have been validated against the schema by details::validate_staged_core, and its transport file prepared
+        // by details::prepare_connection_resource_patch_transport_file, neither of which require the model lock.
+        connection_resource_patch_response handle_connection_resource_patch(nmos::node_model& model, nmos::write_lock& lock, const nmos::api_version& version, const std::pair<nmos::id, nmos::type>& id_type, const web::json::value& patch, const connection_resource_patch_transport_file& transport_file, const nmos::tai& request_time, slog::base_gate& gate)
         {
             using namespace web::http::experimental::listener::api_router_using_declarations;
 
             // lock.owns_lock() must be true initially
             auto& resources = model.connection_resources;
 
-            // Validate JSON syntax according to the schema
-            details::validate_staged_core(version, id_type.second, patch);
-
             const auto patch_state = details::get_activation_state(nmos::fields::activation(patch));
 
             auto resource = find_resource(resources, id_type);
@@ -547,6 +709,9 @@ namespace nmos
 
             if (resources.end() != resource)
             {
+                // the time spent waiting for a pending immediate activation, above, isn't included
+                const auto staging = std::chrono::steady_clock::now();
+
                 // Merge this patch request into a *copy* of the current staged endpoint
                 // so that the merged parameters can be validated against the constraints
                 // before the current values are overwritten.
@@ -563,61 +728,48 @@ namespace nmos
                 // First, validate and merge the transport file (this resource must be a receiver)
                 // See https://github.com/AMWA-TV/nmos-device-connection-management/blob/v1.0/APIs/ConnectionAPI.raml#L344-L363
 
-                auto& transport_file = nmos::fields::transport_file(patch);
-                if (!transport_file.is_null() && !transport_file.as_object().empty())
-                {
-                    const auto transport_type_data = details::get_transport_type_data(transport_file);
+                if (transport_file.error) std::rethrow_exception(transport_file.error);
 
-                    if (!transport_type_data.first.empty())
+                if (transport_file.parsed)
+                {
+                    try
                     {
-                        slog::log<slog::severities::more_info>(gate, SLOG_FLF) << "Processing transport file";
+                        // Validate transport file according to the IS-04 receiver, again, only if it has been modified since it was prepared
 
-                        if (transport_type_data.first != U("application/sdp"))
+                        auto receiver = find_resource(model.node_resources, id_type);
+                        if (model.node_resources.end() != receiver && nmos::fields::version(receiver->data) != transport_file.receiver_version)
                         {
-                            throw transport_file_error("unexpected type: " + utility::us2s(transport_type_data.first));
+                            validate_sdp_parameters(receiver->data, transport_file.sdp_params);
                         }
 
-                        try
-                        {
-                            const auto session_description = sdp::parse_session_description(utility::us2s(transport_type_data.second));
-                            auto sdp_transport_params = nmos::parse_session_description(session_description);
-
-                            // Validate transport file according to the IS-04 receiver
-
-                            auto receiver = find_resource(model.node_resources, id_type);
-                            if (model.node_resources.end() != receiver)
-                            {
-                                validate_sdp_parameters(receiver->data, sdp_transport_params.first);
-                            }
-
-                            // Merge the transport file into the transport parameters
-
-                            auto& transport_params = nmos::fields::transport_params(merged);
+                        // Merge the transport file into the transport parameters
 
-                            if (1 == transport_params.size() && 2 == sdp_transport_params.second.size())
-                            {
-                                web::json::pop_back(sdp_transport_params.second);
-                            }
-
-                            // "Where a Receiver supports SMPTE 2022-7 but is required to Receive a non-SMPTE 2022-7 stream,
-                            // only the first set of transport parameters should be used. rtp_enabled in the second set of parameters
-                            // must be set to false"
-                            // See https://github.com/AMWA-TV/nmos-device-connection-management/blob/v1.0/docs/4.1.%20Behaviour%20-%20RTP%20Transport%20Type.md#operation-with-smpte-2022-7
-                            if (2 == transport_params.size() && 1 == sdp_transport_params.second.size())
-                            {
-                                web::json::push_back(sdp_transport_params.second, web::json::value_of({ { U("rtp_enabled"), false } }));
-                            }
+                        auto& transport_params = nmos::fields::transport_params(merged);
+                        auto sdp_transport_params = transport_file.transport_params;
 
-                            web::json::merge_patch(transport_params, sdp_transport_params.second);
-                        }
-                        catch (const web::json::json_exception& e)
+                        if (1 == transport_params.size() && 2 == sdp_transport_params.size())
                         {
-                            throw transport_file_error(e.what());
+                            web::json::pop_back(sdp_transport_params);
                         }
-                        catch (const std::runtime_error& e)
+
+                        // "Where a Receiver supports SMPTE 2022-7 but is required to Receive a non-SMPTE 2022-7 stream,
+                        // only the first set of transport parameters should be used. rtp_enabled in the second set of parameters
+                        // must be set to false"
+                        // See https://github.com/AMWA-TV/nmos-device-connection-management/blob/v1.0/docs/4.1.%20Behaviour%20-%20RTP%20Transport%20Type.md#operation-with-smpte-2022-7
+                        if (2 == transport_params.size() && 1 == sdp_transport_params.size())
                         {
-                            throw transport_file_error(e.what());
+                            web::json::push_back(sdp_transport_params, web::json::value_of({ { U("rtp_enabled"), false } }));
                         }
+
+                        web::json::merge_patch(transport_params, sdp_transport_params);
+                    }
+                    catch (const web::json::json_exception& e)
+                    {
+                        throw transport_file_error(e.what());
+                    }
+                    catch (const std::runtime_error& e)
+                    {
+                        throw transport_file_error(e.what());
                     }
                 }
 
@@ -656,6 +808,8 @@ namespace nmos
                 else if (details::immediate_activation_pending == patch_state)
                     slog::log<slog::severities::too_much_info>(gate, SLOG_FLF) << "Immediate activation requested for " << id_type;
 
+                model.metrics.connection_patch.staging.record(nmos::experimental::elapsed_since(staging));
+
                 // details::notify_connection_resource_patch also needs to be called!
 
                 return{ details::scheduled_activation_pending == patch_state ? status_codes::Accepted : status_codes::OK, merged };
@@ -675,10 +829,16 @@ namespace nmos
 
         void handle_connection_resource_patch(web::http::http_response res, nmos::node_model& model, const nmos::api_version& version, const std::pair<nmos::id, nmos::type>& id_type, const web::json::value& patch, slog::base_gate& gate)
         {
+            // Validate JSON syntax according to the schema, before acquiring the model lock
+            const auto validation = std::chrono::steady_clock::now();
+            details::validate_staged_core(version, id_type.second, patch);
+            const auto transport_file = details::prepare_connection_resource_patch_transport_file(model, id_type, patch, gate);
+            model.metrics.connection_patch.validation.record(nmos::experimental::elapsed_since(validation));
+
             auto lock = model.write_lock();
             const auto request_time = tai_now(); // during write lock to ensure uniqueness
 
-            auto result = handle_connection_resource_patch(model, lock, version, id_type, patch, request_time, gate);
+            auto result = handle_connection_resource_patch(model, lock, version, id_type, patch, transport_file, request_time, gate);
 
             if (web::http::is_success_status_code(result.first))
             {
@@ -690,7 +850,9 @@ namespace nmos
                     details::handle_immediate_activation_pending(model, lock, id_type, result.second[nmos::fields::activation], gate);
                 }
 
+                const auto responding = std::chrono::steady_clock::now();
                 set_reply(res, result.first, result.second);
+                model.metrics.connection_patch.response.record(nmos::experimental::elapsed_since(responding));
             }
             else
             {
@@ -850,12 +1012,94 @@ namespace nmos
         }
     }
 
+    namespace details
+    {
+        // make a strong entity-tag for the current transport file of the specified sender, which changes whenever the connection resource is modified
+        // the representation is included, since the experimental extension means the same resource may also be returned as JSON
+        utility::string_t make_transportfile_entity_tag(const nmos::resource& resource, bool json)
+        {
+            return U("\"") + make_version(resource.updated) + (json ? U("/json") : U("")) + U("\"");
+        }
+
+        // the transport files of senders parsed into the experimental JSON representation and serialized, keyed by sender id and the entity-tag
+        // so that when many clients request the same transport file, it is only parsed once after each change
+        // the cache is simply cleared when it reaches its capacity
+        class transportfile_json_cache
+        {
+        public:
+            explicit transportfile_json_cache(size_t capacity = 1024) : capacity(capacity) {}
+
+            utility::string_t get(const nmos::id& id, const utility::string_t& entity_tag, const utility::string_t& session_description)
+            {
+                std::lock_guard<std::mutex> lock(mutex);
+
+                auto found = entries.find(id);
+                if (entries.end() != found && found->second.first == entity_tag) return found->second.second;
+
+                if (entries.end() == found && capacity <= entries.size()) entries.clear();
+
+                auto body = sdp::parse_session_description(utility::us2s(session_description)).serialize();
+                entries[id] = { entity_tag, body };
+                return body;
+            }
+
+        private:
+            std::mutex mutex;
+            const size_t capacity;
+            std::map<nmos::id, std::pair<utility::string_t, utility::string_t>> entries;
+        };
+
+        // the serialized (UTF-8) /constraints, /staged and /active endpoint data of senders and receivers, keyed by resource id and endpoint, with the entity-tag
+        // of the resource from which each was made, so that when many clients poll e.g. the /active endpoints after a salvo, each is only serialized once after each change
+        // the cache is simply cleared when it reaches its capacity
+        class connection_endpoint_cache
+        {
+        public:
+            explicit connection_endpoint_cache(size_t capacity = 4096) : capacity(capacity) {}
+
+            std::shared_ptr<const std::string> get(const nmos::resource& resource, const utility::string_t& endpoint, const utility::string_t& entity_tag)
+            {
+                const auto key = std::make_pair(resource.id, endpoint);
+
+                std::lock_guard<std::mutex> lock(mutex);
+
+                auto found = entries.find(key);
+                if (entries.end() != found && found->second.first == entity_tag) return found->second.second;
+
+                if (entries.end() == found && capacity <= entries.size()) entries.clear();
+
+                const web::json::field_as_value endpoint_data{ endpoint };
+                std::shared_ptr<const std::string> body(new std::string(web::json::experimental::serialize_utf8(endpoint_data(resource.data))));
+                entries[key] = { entity_tag, body };
+                return body;
+            }
+
+        private:
+            std::mutex mutex;
+            const size_t capacity;
+            std::map<std::pair<nmos::id, utility::string_t>, std::pair<utility::string_t, std::shared_ptr<const std::string>>> entries;
+        };
+
+        // set the response to the cached endpoint data, with its entity-tag, or to 304 (Not Modified) if the request's If-None-Match header matches
+        static void set_connection_endpoint_reply(const web::http::http_request& req, web::http::http_response& res, connection_endpoint_cache& cache, const nmos::resource& resource, const utility::string_t& endpoint)
+        {
+            const auto entity_tag = make_resource_entity_tag(resource);
+            if (set_not_modified_reply(req, res, entity_tag)) return;
+
+            set_utf8_json_reply(res, web::http::status_codes::OK, *cache.get(resource, endpoint, entity_tag));
+            res.headers().add(web::http::header_names::etag, entity_tag);
+        }
+    }
+
     web::http::experimental::listener::api_router make_unmounted_connection_api(nmos::node_model& model, slog::base_gate& gate_)
     {
         using namespace web::http::experimental::listener::api_router_using_declarations;
 
         api_router connection_api;
 
+        auto transportfile_json_cache = std::make_shared<details::transportfile_json_cache>();
+        auto endpoint_cache = std::make_shared<details::connection_endpoint_cache>();
+
         // check for supported API version
         const auto versions = with_read_lock(model.mutex, [&model] { return nmos::is05_versions::from_settings(model.settings); });
         connection_api.support(U(".*"), details::make_api_version_handler(versions, gate_));
@@ -880,20 +1124,26 @@ namespace nmos
         connection_api.support(U("/bulk/") + nmos::patterns::connectorType.pattern + U("/?"), methods::POST, [&model, &gate_](http_request req, http_response res, const string_t&, const route_parameters& parameters)
         {
             nmos::api_gate gate(gate_, req, parameters);
-            return details::extract_json(req, gate).then([&model, req, res, parameters, gate](value body) mutable
+            return details::extract_json(req, gate, model.get_settings_snapshot()->max_request_body_size).then([&model, req, res, parameters, gate](value body) mutable
             {
-                auto lock = model.write_lock();
-                const auto request_time = tai_now(); // during write lock to ensure uniqueness
-
                 const nmos::api_version version = nmos::parse_api_version(parameters.at(nmos::patterns::version.name));
                 const string_t resourceType = parameters.at(nmos::patterns::connectorType.name);
 
-                auto& patches = body.as_array();
+                auto patches = std::make_shared<value>(std::move(body));
+                const auto& elements = patches->as_array();
+
+                slog::log<slog::severities::info>(gate, SLOG_FLF) << "Bulk operation requested for " << elements.size() << " " << resourceType;
 
-                slog::log<slog::severities::info>(gate, SLOG_FLF) << "Bulk operation requested for " << patches.size() << " " << resourceType;
+                std::vector<nmos::id> ids;
+                ids.reserve(elements.size());
+                for (const auto& patch : elements)
+                {
+                    ids.push_back(nmos::fields::id(patch));
+                }
 
-                std::vector<details::connection_resource_patch_response> results;
-                results.reserve(patches.size());
+                // results which are already unsuccessful after validation have a non-zero status code
+                auto results = std::make_shared<std::vector<details::connection_resource_patch_response>>(elements.size());
+                auto transport_files = std::make_shared<std::vector<details::connection_resource_patch_transport_file>>(elements.size());
 
                 // "Where a server implementation supports concurrent application of settings changes to
                 // underlying Senders and Receivers, it may choose to perform 'bulk' resource operations
@@ -903,121 +1153,184 @@ namespace nmos
 
                 const auto type = nmos::type_from_resourceType(resourceType);
 
-                const auto handle_connection_resource_exception = [&](const nmos::id& id)
+                // Validate JSON syntax of each element according to the schema, and prepare any transport file, in parallel, and before acquiring the model lock
+
+                const size_t concurrency = (std::max)(1u, std::thread::hardware_concurrency());
+                const size_t chunk = (std::max)(size_t(1), (elements.size() + concurrency - 1) / concurrency);
+
+                std::vector<pplx::task<void>> validations{ pplx::task_from_result() };
+                for (size_t first = 0; first < elements.size(); first += chunk)
                 {
-                    // try-catch based on the exception handler in nmos::add_api_finally_handler
-                    try
-                    {
-                        throw;
-                    }
-                    catch (const web::json::json_exception& e)
-                    {
-                        slog::log<slog::severities::warning>(gate, SLOG_FLF) << "JSON error for " << id << " in bulk request: " << e.what();
-                        return details::make_connection_resource_patch_error_response(status_codes::BadRequest, e);
-                    }
-                    catch (const web::http::http_exception& e)
-                    {
-                        slog::log<slog::severities::warning>(gate, SLOG_FLF) << "HTTP error for " << id << " in bulk request: " << e.what() << " [" << e.error_code() << "]";
-                        return details::make_connection_resource_patch_error_response(status_codes::BadRequest, e);
-                    }
-                    catch (const std::runtime_error& e)
-                    {
-                        slog::log<slog::severities::error>(gate, SLOG_FLF) << "Implementation error for " << id << " in bulk request: " << e.what();
-                        return details::make_connection_resource_patch_error_response(status_codes::NotImplemented, e);
-                    }
-                    catch (const std::logic_error& e)
-                    {
-                        slog::log<slog::severities::error>(gate, SLOG_FLF) << "Implementation error for " << id << " in bulk request: " << e.what();
-                        return details::make_connection_resource_patch_error_response(status_codes::InternalError, e);
-                    }
-                    catch (const std::exception& e)
-                    {
-                        slog::log<slog::severities::error>(gate, SLOG_FLF) << "Unexpected exception for " << id << " in bulk request: " << e.what();
-                        return details::make_connection_resource_patch_error_response(status_codes::InternalError, e);
-                    }
-                    catch (...)
+                    const auto last = (std::min)(first + chunk, elements.size());
+                    validations.push_back(pplx::create_task([&model, patches, results, transport_files, ids, version, type, first, last, gate]() mutable
                     {
-                        slog::log<slog::severities::severe>(gate, SLOG_FLF) << "Unexpected unknown exception for " << id << " in bulk request";
-                        return details::make_connection_resource_patch_error_response(status_codes::InternalError);
-                    }
-                };
+                        const auto& elements = patches->as_array();
+                        for (auto index = first; index < last; ++index)
+                        {
+                            try
+                            {
+                                const auto validation = std::chrono::steady_clock::now();
+                                details::validate_staged_core(version, type, nmos::fields::params(elements.at(index)));
+                                (*transport_files)[index] = details::prepare_connection_resource_patch_transport_file(model, { ids[index], type }, nmos::fields::params(elements.at(index)), gate);
+                                model.metrics.connection_patch.validation.record(nmos::experimental::elapsed_since(validation));
+                            }
+                            catch (...)
+                            {
+                                (*results)[index] = details::handle_connection_resource_patch_exception(ids[index], gate);
+                            }
+                        }
+                    }));
+                }
 
-                for (auto& patch : patches)
+                return pplx::when_all(validations.begin(), validations.end()).then([&model, res, patches, results, transport_files, ids, version, type, gate]() mutable
                 {
-                    const auto id = nmos::fields::id(patch);
+                    auto lock = model.write_lock();
+                    const auto request_time = tai_now(); // during write lock to ensure uniqueness
 
-                    details::connection_resource_patch_response result;
+                    auto& elements = patches->as_array();
 
-                    try
+                    for (size_t index = 0; index < elements.size(); ++index)
                     {
-                        result = details::handle_connection_resource_patch(model, lock, version, { id, type }, patch[nmos::fields::params], request_time, gate);
-                    }
-                    catch (...)
-                    {
-                        result = handle_connection_resource_exception(id);
-                    }
+                        auto& result = (*results)[index];
+                        if (0 != result.first) continue;
 
-                    results.push_back(result);
-                }
-
-                if (0 != patches.size()) details::notify_connection_resource_patch(model, gate);
-
-                auto rit = results.begin();
-                for (auto pit = patches.begin(); patches.end() != pit; ++pit, ++rit)
-                {
-                    auto& patch = *pit;
-                    auto& result = *rit;
+                        try
+                        {
+                            result = details::handle_connection_resource_patch(model, lock, version, { ids[index], type }, nmos::fields::params(elements.at(index)), (*transport_files)[index], request_time, gate);
+                        }
+                        catch (...)
+                        {
+                            result = details::handle_connection_resource_patch_exception(ids[index], gate);
+                        }
+                    }
 
-                    const auto id = nmos::fields::id(patch);
+                    // all the elements are staged before notifying the node implementation, so that their immediate activations are processed together
+                    if (0 != elements.size()) details::notify_connection_resource_patch(model, gate);
 
-                    if (web::http::is_success_status_code(result.first))
+                    for (size_t index = 0; index < elements.size(); ++index)
                     {
-                        auto& response_activation = result.second[nmos::fields::activation];
+                        auto& result = (*results)[index];
+                        const auto& id = ids[index];
 
-                        // only pending immediate activations need to be processed before sending the response
-                        if (details::immediate_activation_pending == details::get_activation_state(response_activation))
+                        if (web::http::is_success_status_code(result.first))
                         {
-                            try
-                            {
-                                details::handle_immediate_activation_pending(model, lock, { id, type }, response_activation, gate);
-                            }
-                            catch (...)
+                            auto& response_activation = result.second[nmos::fields::activation];
+
+                            // only pending immediate activations need to be processed before sending the response
+                            if (details::immediate_activation_pending == details::get_activation_state(response_activation))
                             {
-                                result = handle_connection_resource_exception(id);
+                                try
+                                {
+                                    details::handle_immediate_activation_pending(model, lock, { id, type }, response_activation, gate);
+                                }
+                                catch (...)
+                                {
+                                    result = details::handle_connection_resource_patch_exception(id, gate);
+                                }
                             }
                         }
-                    }
 
-                    if (web::http::is_success_status_code(result.first))
-                    {
-                        // make a bulk response success item
-                        // see https://github.com/AMWA-TV/nmos-device-connection-management/blob/v1.0/APIs/schemas/v1.0-bulk-response-schema.json
-                        result.second = value_of({
-                            { nmos::fields::id, id },
-                            { U("code"), result.first }
-                        });
-                    }
-                    else
-                    {
-                        // don't replace an existing response body which might contain richer error information
-                        if (result.second.is_null())
+                        if (web::http::is_success_status_code(result.first))
                         {
-                            result.second = nmos::make_error_response_body(result.first);
+                            // make a bulk response success item
+                            // see https://github.com/AMWA-TV/nmos-device-connection-management/blob/v1.0/APIs/schemas/v1.0-bulk-response-schema.json
+                            result.second = value_of({
+                                { nmos::fields::id, id },
+                                { U("code"), result.first }
+                            });
                         }
+                        else
+                        {
+                            // don't replace an existing response body which might contain richer error information
+                            if (result.second.is_null())
+                            {
+                                result.second = nmos::make_error_response_body(result.first);
+                            }
 
-                        // make a bulk response error item from the standard NMOS error response
-                        result.second[nmos::fields::id] = value::string(id);
+                            // make a bulk response error item from the standard NMOS error response
+                            result.second[nmos::fields::id] = value::string(id);
+                        }
                     }
-                }
 
-                set_reply(res, status_codes::OK,
-                    web::json::serialize(results,
-                        [](const details::connection_resource_patch_response& result) { return result.second; }),
-                    web::http::details::mime_types::application_json);
-                return true;
+                    const auto responding = std::chrono::steady_clock::now();
+                    set_reply(res, status_codes::OK,
+                        web::json::serialize(*results,
+                            [](const details::connection_resource_patch_response& result) { return result.second; }),
+                        web::http::details::mime_types::application_json);
+                    model.metrics.connection_patch.response.record(nmos::experimental::elapsed_since(responding));
+                    return true;
+                });
             });
         });
 
+        // Experimental extension - the active endpoint data of many senders or receivers in one response, e.g. to confirm a salvo has been activated
+        // the optional "id" query parameter is a comma-separated list of the senders or receivers to include, by default all are included
+        // each element of the response is like those of the bulk POST response, but with the active endpoint data rather than the error information
+        connection_api.support(U("/bulk/") + nmos::patterns::connectorType.pattern + U("/active/?"), methods::GET, [&model, endpoint_cache, &gate_](http_request req, http_response res, const string_t&, const route_parameters& parameters)
+        {
+            nmos::api_gate gate(gate_, req, parameters);
+
+            const string_t resourceType = parameters.at(nmos::patterns::connectorType.name);
+            const auto type = nmos::type_from_resourceType(resourceType);
+
+            auto flat_query_params = web::json::value_from_query(req.request_uri().query());
+            nmos::details::decode_elements(flat_query_params);
+            const auto ids_param = web::json::field_as_string_or{ { U("id") }, {} }(flat_query_params);
+
+            std::vector<nmos::id> ids;
+            if (!ids_param.empty()) boost::algorithm::split(ids, ids_param, [](utility::char_t c) { return U(',') == c; });
+
+            auto lock = model.read_lock();
+            auto& resources = model.connection_resources;
+
+            // the response is assembled from the cached serialized endpoint data of each resource
+            std::string body;
+            body.push_back('[');
+            size_t count = 0;
+            const auto append = [&](const nmos::id& id, const std::shared_ptr<const std::string>& active)
+            {
+                if (0 != count++) body.push_back(',');
+                body.append("{\"id\":");
+                web::json::experimental::serialize_utf8(body, value::string(id));
+                if (active)
+                {
+                    body.append(",\"code\":200,\"active\":");
+                    body.append(*active);
+                }
+                else
+                {
+                    body.append(",\"code\":404,\"error\":\"Not Found\"");
+                }
+                body.push_back('}');
+            };
+
+            if (ids.empty())
+            {
+                for (const auto& resource : resources)
+                {
+                    if (type != resource.type || !resource.has_data()) continue;
+                    append(resource.id, endpoint_cache->get(resource, nmos::fields::endpoint_active.key, details::make_resource_entity_tag(resource)));
+                }
+            }
+            else
+            {
+                for (const auto& id : ids)
+                {
+                    auto resource = find_resource(resources, { id, type });
+                    append(id, resources.end() != resource ? endpoint_cache->get(*resource, nmos::fields::endpoint_active.key, details::make_resource_entity_tag(*resource)) : std::shared_ptr<const std::string>());
+                }
+            }
+            body.push_back(']');
+
+            lock.unlock();
+
+            slog::log<slog::severities::info>(gate, SLOG_FLF) << "Returning active data for " << count << " " << resourceType;
+
+            details::set_utf8_json_reply(res, status_codes::OK, body);
+
+            return pplx::task_from_result(true);
+        });
+
         connection_api.support(U("/single/?"), methods::GET, [](http_request, http_response res, const string_t&, const route_parameters&)
         {
             set_reply(res, status_codes::OK, nmos::make_sub_routes_body({ U("senders/"), U("receivers/") }, res));
@@ -1076,7 +1389,7 @@ namespace nmos
             return pplx::task_from_result(true);
         });
 
-        connection_api.support(U("/single/") + nmos::patterns::connectorType.pattern + U("/") + nmos::patterns::resourceId.pattern + U("/constraints/?"), methods::GET, [&model, &gate_](http_request req, http_response res, const string_t&, const route_parameters& parameters)
+        connection_api.support(U("/single/") + nmos::patterns::connectorType.pattern + U("/") + nmos::patterns::resourceId.pattern + U("/constraints/?"), methods::GET, [&model, endpoint_cache, &gate_](http_request req, http_response res, const string_t&, const route_parameters& parameters)
         {
             nmos::api_gate gate(gate_, req, parameters);
             auto lock = model.read_lock();
@@ -1099,7 +1412,7 @@ namespace nmos
                 }
                 else
                 {
-                    set_reply(res, status_codes::OK, nmos::fields::endpoint_constraints(resource->data));
+                    details::set_connection_endpoint_reply(req, res, *endpoint_cache, *resource, nmos::fields::endpoint_constraints.key);
                 }
             }
             else
@@ -1113,7 +1426,7 @@ namespace nmos
         connection_api.support(U("/single/") + nmos::patterns::connectorType.pattern + U("/") + nmos::patterns::resourceId.pattern + U("/staged/?"), methods::PATCH, [&model, &gate_](http_request req, http_response res, const string_t&, const route_parameters& parameters)
         {
             nmos::api_gate gate(gate_, req, parameters);
-            return details::extract_json(req, gate).then([&model, req, res, parameters, gate](value body) mutable
+            return details::extract_json(req, gate, model.get_settings_snapshot()->max_request_body_size).then([&model, req, res, parameters, gate](value body) mutable
             {
                 const nmos::api_version version = nmos::parse_api_version(parameters.at(nmos::patterns::version.name));
                 const string_t resourceType = parameters.at(nmos::patterns::connectorType.name);
@@ -1129,7 +1442,7 @@ namespace nmos
             });
         });
 
-        connection_api.support(U("/single/") + nmos::patterns::connectorType.pattern + U("/") + nmos::patterns::resourceId.pattern + U("/") + nmos::patterns::stagingType.pattern + U("/?"), methods::GET, [&model, &gate_](http_request req, http_response res, const string_t&, const route_parameters& parameters)
+        connection_api.support(U("/single/") + nmos::patterns::connectorType.pattern + U("/") + nmos::patterns::resourceId.pattern + U("/") + nmos::patterns::stagingType.pattern + U("/?"), methods::GET, [&model, endpoint_cache, &gate_](http_request req, http_response res, const string_t&, const route_parameters& parameters)
         {
             nmos::api_gate gate(gate_, req, parameters);
             auto lock = model.read_lock();
@@ -1167,8 +1480,7 @@ namespace nmos
             {
                 slog::log<slog::severities::info>(gate, SLOG_FLF) << "Returning " << stagingType << " data for " << id_type;
 
-                const web::json::field_as_value endpoint_staging{ stagingType };
-                set_reply(res, status_codes::OK, endpoint_staging(resource->data));
+                details::set_connection_endpoint_reply(req, res, *endpoint_cache, *resource, stagingType);
             }
             else
             {
@@ -1178,7 +1490,7 @@ namespace nmos
             return pplx::task_from_result(true);
         });
 
-        connection_api.support(U("/single/") + nmos::patterns::senderType.pattern + U("/") + nmos::patterns::resourceId.pattern + U("/transportfile/?"), methods::GET, [&model, &gate_](http_request req, http_response res, const string_t&, const route_parameters& parameters)
+        connection_api.support(U("/single/") + nmos::patterns::senderType.pattern + U("/") + nmos::patterns::resourceId.pattern + U("/transportfile/?"), methods::GET, [&model, transportfile_json_cache, &gate_](http_request req, http_response res, const string_t&, const route_parameters& parameters)
         {
             nmos::api_gate gate(gate_, req, parameters);
             auto lock = model.read_lock();
@@ -1202,16 +1514,27 @@ namespace nmos
                         slog::log<slog::severities::info>(gate, SLOG_FLF) << "Returning transport file for " << id_type;
 
                         const auto accept = req.headers().find(web::http::header_names::accept);
-                        if (req.headers().end() != accept && web::http::details::mime_types::application_json == accept->second && U("application/sdp") == nmos::fields::transportfile_type(transportfile))
+                        const bool json = req.headers().end() != accept && web::http::details::mime_types::application_json == accept->second && U("application/sdp") == nmos::fields::transportfile_type(transportfile);
+
+                        // the transport file is only regenerated when the sender is activated, so clients can cheaply check whether it has changed
+                        const auto entity_tag = details::make_transportfile_entity_tag(*resource, json);
+                        if (details::set_not_modified_reply(req, res, entity_tag))
+                        {
+                            res.headers().set_cache_control(U("no-cache"));
+                            return pplx::task_from_result(true);
+                        }
+
+                        if (json)
                         {
                             // Experimental extension - SDP as JSON
-                            set_reply(res, status_codes::OK, sdp::parse_session_description(utility::us2s(data.as_string())));
+                            set_reply(res, status_codes::OK, transportfile_json_cache->get(resource->id, entity_tag, data.as_string()), web::http::details::mime_types::application_json);
                         }
                         else
                         {
                             // This automatically performs conversion to UTF-8 if required (i.e. on Windows)
                             set_reply(res, status_codes::OK, data.as_string(), nmos::fields::transportfile_type(transportfile));
                         }
+                        res.headers().add(web::http::header_names::etag, entity_tag);
 
                         // "It is strongly recommended that the following caching headers are included via the /transportfile endpoint (or whatever this endpoint redirects to).
                         // This is important to ensure that connection management clients do not cache the contents of transport files which are liable to change."
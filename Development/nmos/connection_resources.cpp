@@ -308,6 +308,66 @@ namespace nmos
         return{ is05_versions::v1_1, types::sender, data, false };
     }
 
+    namespace details
+    {
+        // See https://github.com/AMWA-TV/nmos-device-connection-management/blob/v1.1-dev/APIs/schemas/constraints-schema-mqtt.json
+        web::json::value make_connection_mqtt_sender_core_constraints()
+        {
+            using web::json::value;
+            using web::json::value_of;
+
+            const auto unconstrained = value::object();
+            return value_of({
+                { nmos::fields::destination_host, unconstrained },
+                { nmos::fields::destination_port, unconstrained },
+                { nmos::fields::broker_topic, unconstrained }
+            });
+        }
+
+        // See https://github.com/AMWA-TV/nmos-device-connection-management/blob/v1.1-dev/APIs/schemas/sender_transport_params_mqtt.json
+        // "A null value indicates that the sender has not yet been configured."
+        web::json::value make_connection_mqtt_sender_staged_core_parameter_set(const utility::string_t& destination_host, int destination_port, const utility::string_t& broker_topic)
+        {
+            using web::json::value;
+            using web::json::value_of;
+
+            return value_of({
+                { nmos::fields::destination_host, !destination_host.empty() ? value::string(destination_host) : value::null() },
+                { nmos::fields::destination_port, destination_port },
+                { nmos::fields::broker_topic, broker_topic }
+            });
+        }
+    }
+
+    // Although this function makes a "connection" (IS-05) resource, its details are defined by IS-07 Event & Tally
+    // See https://github.com/AMWA-TV/nmos-event-tally/blob/v1.0/docs/5.1.%20Transport%20-%20MQTT.md
+    nmos::resource make_connection_events_mqtt_sender(const nmos::id& id, const nmos::id& source_id, const nmos::settings& settings)
+    {
+        using web::json::value;
+
+        auto data = details::make_connection_resource_core(id, false);
+
+        auto constraints = details::make_connection_mqtt_sender_core_constraints();
+        auto ext_constraints = details::make_connection_events_websocket_sender_ext_constraints();
+        web::json::insert(constraints, ext_constraints.as_object().begin(), ext_constraints.as_object().end());
+
+        data[nmos::fields::endpoint_constraints] = details::legs_of(constraints, false);
+        data[nmos::fields::endpoint_staged][nmos::fields::receiver_id] = value::null();
+        data[nmos::fields::endpoint_staged][nmos::fields::master_enable] = value::boolean(false);
+
+        const auto rest_api_url = make_events_api_ext_is_07_rest_api_url(source_id, settings);
+
+        // the broker is configured, rather than resolved from "auto", e.g. by DNS-SD discovery
+        auto transport_params = details::make_connection_mqtt_sender_staged_core_parameter_set(nmos::experimental::fields::events_mqtt_broker_host(settings), nmos::experimental::fields::events_mqtt_broker_port(settings), make_events_mqtt_broker_topic(source_id, settings));
+        auto ext_transport_params = details::make_connection_events_websocket_sender_staged_ext_parameter_set(source_id, rest_api_url);
+        web::json::insert(transport_params, ext_transport_params.as_object().begin(), ext_transport_params.as_object().end());
+
+        data[nmos::fields::endpoint_staged][nmos::fields::transport_params] = details::legs_of(transport_params, false);
+        data[nmos::fields::endpoint_active] = data[nmos::fields::endpoint_staged];
+
+        return{ is05_versions::v1_1, types::sender, data, false };
+    }
+
     web::uri make_events_ws_api_connection_uri(const nmos::id& device_id, const nmos::settings& settings)
     {
         const auto version = *nmos::is07_versions::from_settings(settings).rbegin();
@@ -337,4 +397,12 @@ namespace nmos
             .set_path(U("/x-nmos/events/") + make_api_version(version) + U("/sources/") + source_id)
             .to_uri();
     }
+
+    utility::string_t make_events_mqtt_broker_topic(const nmos::id& source_id, const nmos::settings& settings)
+    {
+        const auto version = *nmos::is07_versions::from_settings(settings).rbegin();
+
+        // the topic mirrors the path of the source in the Events API
+        return U("x-nmos/events/") + make_api_version(version) + U("/sources/") + source_id;
+    }
 }
@@ -46,8 +46,15 @@ namespace nmos
     // See https://github.com/AMWA-TV/nmos-event-tally/blob/v1.0/docs/5.2.%20Transport%20-%20Websocket.md#3-connection-management
     nmos::resource make_connection_events_websocket_sender(const nmos::id& id, const nmos::id& device_id, const nmos::id& source_id, const nmos::settings& settings);
 
+    // An IS-07 MQTT sender publishes the state of its source to the broker configured by nmos::experimental::fields::events_mqtt_broker_host and events_mqtt_broker_port,
+    // once each time it changes, so that the fan-out to the subscribers is left to the broker
+    // see nmos::send_events_mqtt_messages_thread
+    // See https://github.com/AMWA-TV/nmos-event-tally/blob/v1.0/docs/5.1.%20Transport%20-%20MQTT.md
+    nmos::resource make_connection_events_mqtt_sender(const nmos::id& id, const nmos::id& source_id, const nmos::settings& settings);
+
     web::uri make_events_ws_api_connection_uri(const nmos::id& device_id, const nmos::settings& settings);
     web::uri make_events_api_ext_is_07_rest_api_url(const nmos::id& source_id, const nmos::settings& settings);
+    utility::string_t make_events_mqtt_broker_topic(const nmos::id& source_id, const nmos::settings& settings);
 }
 
 #endif
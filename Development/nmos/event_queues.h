@@ -0,0 +1,229 @@
+#ifndef NMOS_EVENT_QUEUES_H
+#define NMOS_EVENT_QUEUES_H
+
+#include <chrono>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <queue>
+#include <set>
+#include <unordered_map>
+#include <unordered_set>
+#include <vector>
+#include "cpprest/json.h"
+#include "nmos/api_version.h"
+#include "nmos/id.h"
+#include "nmos/metrics.h"
+#include "nmos/tai.h"
+#include "nmos/type.h"
+
+namespace nmos
+{
+    // the next message to be sent on a Query API websocket connection, and the resource events that are waiting to be sent
+    struct event_queue
+    {
+        // the id of the websocket connection and of the subscription to which it is connected
+        nmos::id id;
+        nmos::id subscription_id;
+
+        // experimental extension, the id of the websocket connection on which the messages are sent, which is the queue's own id
+        // unless the queue is for one of several subscriptions multiplexed over a single websocket connection
+        nmos::id websocket_id;
+
+        // the next message, see nmos::details::make_grain
+        // its grain data is only populated with the events when the message is being prepared to be sent
+        web::json::value message;
+
+        // the resource events waiting to be sent, which are immutable, so that each event can be shared by all the websocket connections
+        // whose subscriptions have the same variant of it, rather than copied into each queue when inserted with the exclusive/write lock held
+        typedef std::shared_ptr<const web::json::value> shared_event;
+        std::vector<shared_event> events;
+
+        // for streaming the initial 'sync' resource events over multiple messages, rather than including them all when the websocket connection is opened
+        // resources created after the sync_cursor, and at or before the sync_until snapshot point, have yet to be included
+        nmos::tai sync_cursor;
+        nmos::tai sync_until;
+
+        // for coalescing the pending resource events, so that there is at most one event for each resource
+        bool coalesce;
+
+        // experimental extension, the origin_timestamp of the most recent message after which all the resource events up to that point had been sent
+        // which a client can use to resume on a new websocket connection, or zero if the initial 'sync' resource events haven't yet been completely sent
+        nmos::tai resume_cursor;
+
+        // when the queue is scheduled to be considered again, e.g. because sending was throttled, or max if it isn't scheduled
+        tai_clock::time_point scheduled = (tai_clock::time_point::max)();
+
+        // experimental extension, for change-propagation latency metrics, the ingress time of the least recent change whose events are waiting to be sent,
+        // or max if there are none; when the events are split over several messages, it is only reset once they have all been sent, so overestimates the later ones
+        std::chrono::steady_clock::time_point ingress = (std::chrono::steady_clock::time_point::max)();
+    };
+
+    // a change to a resource, so that the resource events for a batch of changes, e.g. a cascaded deletion, can be inserted together
+    // see nmos::insert_resource_events
+    struct resource_change
+    {
+        nmos::tai updated;
+        nmos::api_version version;
+        nmos::type type;
+        web::json::value pre;
+        web::json::value post;
+    };
+
+    // the event queues for all the websocket connections to the subscriptions in some resources, kept outside the resources themselves,
+    // so that queuing an event doesn't re-index a resource or update the most recent update timestamp of the resources
+    // events are pushed with the exclusive/write lock on the resources held, but since the queues are drained with just a shared/read lock,
+    // and may be read concurrently, e.g. for metrics, they are also protected by their own mutex
+    // see nmos::insert_resource_events and nmos::send_query_ws_events_thread
+    struct event_queues
+    {
+        mutable std::mutex mutex;
+
+        // queues by websocket connection id
+        std::unordered_map<nmos::id, event_queue> queues;
+
+        // websocket connection ids by subscription id
+        typedef std::set<nmos::id> connection_ids;
+        std::unordered_map<nmos::id, connection_ids> subscriptions;
+
+        // experimental extension, the ids of the additional queues multiplexed over each websocket connection, by websocket connection id
+        std::unordered_map<nmos::id, connection_ids> multiplexed;
+
+        // the websocket connections which may have something to send now, or which may need to be closed
+        // so that the send thread only considers these, rather than every websocket connection, each time it is woken
+        std::unordered_set<nmos::id> ready;
+
+        // the websocket connections which are scheduled to be considered again, earliest first
+        // entries for which the queue has since been erased or rescheduled are stale, and are discarded when they reach the top
+        typedef std::pair<tai_clock::time_point, nmos::id> schedule_entry;
+        std::priority_queue<schedule_entry, std::vector<schedule_entry>, std::greater<schedule_entry>> schedule;
+
+        // experimental extension, for change-propagation latency metrics, the time at which the change now being made entered the registry,
+        // e.g. when the Registration API request was received, or the epoch if unknown, in which case the change is stamped when its events are inserted
+        // since it is only used when resource events are being inserted, it is protected by the exclusive/write lock on the resources
+        // see nmos::event_ingress_guard
+        std::chrono::steady_clock::time_point ingress;
+
+        // the histograms of the time from the ingress of each change to the websocket message including its events having been sent, by subscription id
+        // the histogram of a subscription is discarded when its last websocket connection is closed
+        std::unordered_map<nmos::id, nmos::experimental::latency_histogram> latencies;
+
+        // insert a new queue, which is ready to start streaming the initial 'sync' resource events (with the mutex locked)
+        void insert(event_queue queue)
+        {
+            subscriptions[queue.subscription_id].insert(queue.id);
+            if (queue.websocket_id != queue.id) multiplexed[queue.websocket_id].insert(queue.id);
+            ready.insert(queue.id);
+            const auto id = queue.id;
+            queues.insert({ id, std::move(queue) });
+        }
+
+        // erase the queue with the specified id, and return the number of remaining connections to the same subscription (with the mutex locked)
+        std::size_t erase(const nmos::id& id)
+        {
+            auto found = queues.find(id);
+            if (queues.end() == found) return 0;
+
+            std::size_t remaining = 0;
+            auto subscription = subscriptions.find(found->second.subscription_id);
+            if (subscriptions.end() != subscription)
+            {
+                subscription->second.erase(id);
+                remaining = subscription->second.size();
+                if (0 == remaining)
+                {
+                    latencies.erase(subscription->first);
+                    subscriptions.erase(subscription);
+                }
+            }
+            if (found->second.websocket_id != id)
+            {
+                auto websocket = multiplexed.find(found->second.websocket_id);
+                if (multiplexed.end() != websocket)
+                {
+                    websocket->second.erase(id);
+                    if (websocket->second.empty()) multiplexed.erase(websocket);
+                }
+            }
+            ready.erase(id);
+            queues.erase(found);
+            return remaining;
+        }
+
+        // the ids of the additional queues multiplexed over the specified websocket connection (with the mutex locked)
+        connection_ids multiplexed_queues(const nmos::id& websocket_id) const
+        {
+            auto found = multiplexed.find(websocket_id);
+            return multiplexed.end() != found ? found->second : connection_ids{};
+        }
+
+        // the number of websocket connections to the specified subscription (with the mutex locked)
+        std::size_t connections(const nmos::id& subscription_id) const
+        {
+            auto found = subscriptions.find(subscription_id);
+            return subscriptions.end() != found ? found->second.size() : 0;
+        }
+
+        // mark the queue as ready, unless it is already scheduled to be considered, e.g. after an event has been pushed (with the mutex locked)
+        void notify(event_queue& queue)
+        {
+            if ((tai_clock::time_point::max)() == queue.scheduled) ready.insert(queue.id);
+        }
+
+        // schedule the queue to be considered again no later than the specified time (with the mutex locked)
+        void reschedule(event_queue& queue, const tai_clock::time_point& when)
+        {
+            if (when < queue.scheduled)
+            {
+                queue.scheduled = when;
+                schedule.push({ when, queue.id });
+            }
+        }
+
+        // move the queues which are scheduled to be considered at or before the specified time to the ready set,
+        // and return when the next one is scheduled, or max if none are (with the mutex locked)
+        tai_clock::time_point wake(const tai_clock::time_point& now)
+        {
+            while (!schedule.empty())
+            {
+                const auto top = schedule.top();
+                auto found = queues.find(top.second);
+                if (queues.end() == found || found->second.scheduled != top.first)
+                {
+                    schedule.pop();
+                    continue;
+                }
+                if (now < top.first) return top.first;
+                schedule.pop();
+                found->second.scheduled = (tai_clock::time_point::max)();
+                ready.insert(top.second);
+            }
+            return (tai_clock::time_point::max)();
+        }
+    };
+
+    // stamp the resource changes made while the guard is in scope with the specified ingress time, e.g. when the Registration API request was received
+    // (with the exclusive/write lock on the resources held)
+    class event_ingress_guard
+    {
+    public:
+        event_ingress_guard(std::shared_ptr<event_queues> queues, std::chrono::steady_clock::time_point ingress)
+            : queues(std::move(queues))
+        {
+            if (this->queues) this->queues->ingress = ingress;
+        }
+
+        ~event_ingress_guard()
+        {
+            if (queues) queues->ingress = {};
+        }
+
+        event_ingress_guard(const event_ingress_guard&) = delete;
+        event_ingress_guard& operator=(const event_ingress_guard&) = delete;
+
+    private:
+        std::shared_ptr<event_queues> queues;
+    };
+}
+
+#endif
@@ -1,5 +1,6 @@
 #include "nmos/events_api.h"
 
+#include "cpprest/json_utils.h" // for web::json::experimental::serialize_utf8
 #include "nmos/api_utils.h"
 #include "nmos/is07_versions.h"
 #include "nmos/model.h"
@@ -39,6 +40,44 @@ namespace nmos
         return events_api;
     }
 
+    namespace details
+    {
+        // make the Events API /state or /type response for the specified source
+        static web::json::value make_events_endpoint_response(const nmos::resource& resource, const web::json::field_as_value& endpoint)
+        {
+            if (nmos::fields::endpoint_state.key == endpoint.key)
+            {
+                // "The flow_id will NOT be included in the response to a [REST API query for the] state because the state is held by
+                // the source which has no dependency on a flow. It will, however, appear when being sent through one of the two
+                // specified transports because it will pass from the source through a flow and out on the network through the sender."
+                // Therefore, since the stored data in the event resources is also used to generate the messages on the transport, it
+                // *should* include the flow id. It will be removed to generate the Events API /state response.
+                // See https://github.com/AMWA-TV/nmos-event-tally/blob/v1.0/docs/2.0.%20Message%20types.md#11-the-state-message-type
+                // and https://github.com/AMWA-TV/nmos-event-tally/blob/v1.0/docs/4.0.%20Core%20models.md#1-introduction
+                auto state = endpoint(resource.data);
+                auto& identity = nmos::fields::identity(state);
+                if (identity.has_field(nmos::fields::flow_id))
+                {
+                    identity.erase(nmos::fields::flow_id);
+                }
+                return state;
+            }
+            else // if (nmos::fields::endpoint_type.key == endpoint.key)
+            {
+                return endpoint(resource.data);
+            }
+        }
+
+        // set the response from a pre-serialized view, or a not modified response if the client already has that representation
+        static void set_events_endpoint_reply(const web::http::http_request& req, web::http::http_response& res, const nmos::details::query_page& view)
+        {
+            if (nmos::details::set_not_modified_reply(req, res, view.entity_tag)) return;
+
+            nmos::details::set_utf8_json_reply(res, web::http::status_codes::OK, view.body);
+            res.headers().add(web::http::header_names::etag, view.entity_tag);
+        }
+    }
+
     web::http::experimental::listener::api_router make_unmounted_events_api(const nmos::node_model& model, slog::base_gate& gate_)
     {
         using namespace web::http::experimental::listener::api_router_using_declarations;
@@ -98,7 +137,6 @@ namespace nmos
         events_api.support(U("/") + nmos::patterns::sourceType.pattern + U("/?") + nmos::patterns::resourceId.pattern + U("/") + nmos::patterns::eventTypeState.pattern + U("/?"), methods::GET, [&model, &gate_](http_request req, http_response res, const string_t&, const route_parameters& parameters)
         {
             nmos::api_gate gate(gate_, req, parameters);
-            auto lock = model.read_lock();
             auto& resources = model.events_resources;
 
             const string_t resourceType = parameters.at(nmos::patterns::sourceType.name);
@@ -107,34 +145,40 @@ namespace nmos
             const std::pair<nmos::id, nmos::type> id_type{ resourceId, nmos::type_from_resourceType(resourceType) };
 
             const string_t eventTypeState = parameters.at(nmos::patterns::eventTypeState.name);
+
+            // experimental extension, the pre-serialized response is served without the lock, so that high-rate polling doesn't contend
+            // with changing the state; the view is discarded whenever the source is modified, and rebuilt by the next request
+            // (only sources have views, so the resource type doesn't need to be part of the key)
+            if (nmos::types::source == id_type.second)
+            {
+                const auto view = nmos::details::find_resource_view(resources, resourceId, eventTypeState);
+                if (view)
+                {
+                    slog::log<slog::severities::more_info>(gate, SLOG_FLF) << "Returning cached " << eventTypeState << " for " << id_type;
+                    details::set_events_endpoint_reply(req, res, *view);
+                    return pplx::task_from_result(true);
+                }
+            }
+
+            auto lock = model.read_lock();
+
             auto resource = find_resource(resources, id_type);
             if (resources.end() != resource)
             {
                 slog::log<slog::severities::more_info>(gate, SLOG_FLF) << "Returning " << eventTypeState << " for " << id_type;
                 const web::json::field_as_value endpoint{ eventTypeState };
 
-                if (nmos::fields::endpoint_state.key == endpoint.key)
-                {
-                    // "The flow_id will NOT be included in the response to a [REST API query for the] state because the state is held by
-                    // the source which has no dependency on a flow. It will, however, appear when being sent through one of the two
-                    // specified transports because it will pass from the source through a flow and out on the network through the sender."
-                    // Therefore, since the stored data in the event resources is also used to generate the messages on the transport, it
-                    // *should* include the flow id. It will be removed to generate the Events API /state response.
-                    // See https://github.com/AMWA-TV/nmos-event-tally/blob/v1.0/docs/2.0.%20Message%20types.md#11-the-state-message-type
-                    // and https://github.com/AMWA-TV/nmos-event-tally/blob/v1.0/docs/4.0.%20Core%20models.md#1-introduction
-                    auto state = endpoint(resource->data);
-                    auto& identity = nmos::fields::identity(state);
-                    if (identity.has_field(nmos::fields::flow_id))
-                    {
-                        identity.erase(nmos::fields::flow_id);
-                    }
-
-                    set_reply(res, status_codes::OK, state);
-                }
-                else // if (nmos::fields::endpoint_type.key == endpoint.key)
+                auto view = std::make_shared<nmos::details::query_page>();
+                view->body = web::json::experimental::serialize_utf8(details::make_events_endpoint_response(*resource, endpoint));
+                view->entity_tag = nmos::details::make_resource_entity_tag(*resource);
+
+                // the lock is still held, so the view is consistent with the resource
+                if (nmos::types::source == id_type.second)
                 {
-                    set_reply(res, status_codes::OK, endpoint(resource->data));
+                    nmos::details::insert_resource_view(resources, resourceId, eventTypeState, view);
                 }
+
+                details::set_events_endpoint_reply(req, res, *view);
             }
             else
             {
@@ -0,0 +1,302 @@
+#include "nmos/events_mqtt.h"
+
+#include <map>
+#include <memory>
+#include <set>
+#include <stdexcept>
+#include <boost/asio/connect.hpp>
+#include <boost/asio/io_service.hpp>
+#include <boost/asio/ip/tcp.hpp>
+#include <boost/asio/read.hpp>
+#include <boost/asio/write.hpp>
+#include "cpprest/json_utils.h" // for web::json::experimental::serialize_utf8
+#include "nmos/json_fields.h"
+#include "nmos/model.h"
+#include "nmos/slog.h"
+
+namespace nmos
+{
+    namespace details
+    {
+        // "The Remaining Length is encoded using a variable length encoding scheme which uses a single byte for values up to 127."
+        // with up to four bytes in total
+        static void append_mqtt_remaining_length(std::string& packet, size_t length)
+        {
+            if (268435455 < length) throw std::length_error("MQTT packet is too large");
+            do
+            {
+                char byte = char(length % 128);
+                length /= 128;
+                if (0 < length) byte |= char(0x80);
+                packet.push_back(byte);
+            } while (0 < length);
+        }
+
+        // "Each of these strings is prefixed with a two byte length field that gives the number of bytes in a UTF-8 encoded string itself"
+        static void append_mqtt_string(std::string& packet, const std::string& value)
+        {
+            if (0xFFFF < value.size()) throw std::length_error("MQTT string is too long");
+            packet.push_back(char(value.size() >> 8));
+            packet.push_back(char(value.size() & 0xFF));
+            packet.append(value);
+        }
+
+        static std::string make_mqtt_packet(unsigned char type_and_flags, const std::string& body)
+        {
+            std::string packet;
+            packet.reserve(5 + body.size());
+            packet.push_back(char(type_and_flags));
+            append_mqtt_remaining_length(packet, body.size());
+            packet.append(body);
+            return packet;
+        }
+
+        std::string make_mqtt_connect_packet(const std::string& client_id, std::uint16_t keep_alive_seconds)
+        {
+            std::string body;
+            append_mqtt_string(body, "MQTT");
+            body.push_back(4); // protocol level, i.e. 3.1.1
+            body.push_back(0x02); // connect flags, i.e. just clean session
+            body.push_back(char(keep_alive_seconds >> 8));
+            body.push_back(char(keep_alive_seconds & 0xFF));
+            append_mqtt_string(body, client_id);
+            return make_mqtt_packet(0x10, body);
+        }
+
+        std::string make_mqtt_publish_packet(const std::string& topic, const std::string& payload, bool retain)
+        {
+            // at QoS 0, there's no packet identifier
+            std::string body;
+            body.reserve(2 + topic.size() + payload.size());
+            append_mqtt_string(body, topic);
+            body.append(payload);
+            return make_mqtt_packet(0x30 | (retain ? 0x01 : 0x00), body);
+        }
+
+        std::string make_mqtt_disconnect_packet()
+        {
+            return make_mqtt_packet(0xE0, {});
+        }
+
+        // a blocking connection to an MQTT broker, which only publishes messages, so never expects to receive anything after the CONNACK
+        // and doesn't set a keep alive, since any broken connection is detected and replaced when a message fails to be sent
+        class mqtt_connection
+        {
+        public:
+            mqtt_connection(boost::asio::io_service& service, const std::string& host, const std::string& port)
+                : socket(service)
+            {
+                boost::asio::ip::tcp::resolver resolver(service);
+                boost::asio::connect(socket, resolver.resolve(boost::asio::ip::tcp::resolver::query(host, port)));
+                socket.set_option(boost::asio::ip::tcp::no_delay(true));
+                boost::asio::write(socket, boost::asio::buffer(make_mqtt_connect_packet()));
+
+                // "The first packet sent from the Server to the Client MUST be a CONNACK Packet"
+                unsigned char connack[4];
+                boost::asio::read(socket, boost::asio::buffer(connack));
+                if (0x20 != connack[0] || 0x02 != connack[1]) throw std::runtime_error("unexpected MQTT packet");
+                if (0x00 != connack[3]) throw std::runtime_error("MQTT connection refused, return code " + std::to_string(connack[3]));
+            }
+
+            ~mqtt_connection()
+            {
+                boost::system::error_code ec;
+                boost::asio::write(socket, boost::asio::buffer(make_mqtt_disconnect_packet()), ec);
+                socket.close(ec);
+            }
+
+            void publish(const std::string& packet)
+            {
+                boost::asio::write(socket, boost::asio::buffer(packet));
+            }
+
+        private:
+            boost::asio::ip::tcp::socket socket;
+        };
+
+        typedef std::pair<std::string, std::string> mqtt_broker;
+
+        // the broker and topic of an active MQTT sender, and the source whose state it publishes
+        struct events_mqtt_destination
+        {
+            mqtt_broker broker;
+            std::string topic;
+            nmos::id source_id;
+
+            // whether the current state of the source has yet to be published, e.g. because the sender has just been activated or the connection to the broker failed
+            bool pending;
+        };
+
+        typedef std::map<nmos::id, events_mqtt_destination> events_mqtt_destinations;
+
+        // find the enabled MQTT senders, i.e. those whose active transport parameters have a broker and topic
+        static events_mqtt_destinations find_events_mqtt_destinations(const nmos::resources& connection_resources)
+        {
+            events_mqtt_destinations destinations;
+            for (const auto& resource : connection_resources)
+            {
+                if (nmos::types::sender != resource.type || !resource.has_data()) continue;
+
+                const auto& active = nmos::fields::endpoint_active(resource.data);
+                if (!nmos::fields::master_enable(active)) continue;
+                const auto& transport_params = nmos::fields::transport_params(active);
+                if (!transport_params.is_array() || 0 == transport_params.size()) continue;
+                const auto& params = transport_params.at(0);
+
+                const auto host = nmos::fields::destination_host(params);
+                const auto port = nmos::fields::destination_port(params);
+                const auto topic = nmos::fields::broker_topic(params);
+                const auto source_id = nmos::fields::ext_is_07_source_id(params);
+                if (!host.is_string() || !port.is_integer() || !topic.is_string() || !source_id.is_string()) continue;
+
+                destinations[resource.id] = { { utility::us2s(host.as_string()), std::to_string(port.as_integer()) }, utility::us2s(topic.as_string()), source_id.as_string(), true };
+            }
+            return destinations;
+        }
+    }
+
+    // publish the state of each IS-07 source to the broker and topic of each of its active MQTT senders (see nmos::make_connection_events_mqtt_sender),
+    // once each time it changes, and when each sender is activated, as a retained message, so that new subscribers immediately receive the current state,
+    // until the server is shut down; the messages are published without the model lock held, and failed connections to a broker are retried
+    void send_events_mqtt_messages_thread(nmos::node_model& model, slog::base_gate& gate_)
+    {
+        nmos::details::omanip_gate gate(gate_, nmos::categories::send_events_mqtt_messages);
+
+        // connecting to a broker, and sending to it, block this thread, but neither the model nor the WebSocket senders
+        boost::asio::io_service service;
+
+        // one connection to each broker, shared by all the MQTT senders to that broker
+        std::map<details::mqtt_broker, std::unique_ptr<details::mqtt_connection>> connections;
+
+        // the interval after which to retry publishing to a broker after an error
+        const auto retry_interval = std::chrono::seconds(5);
+
+        auto lock = model.read_lock();
+
+        details::events_mqtt_destinations destinations;
+        tai most_recent_connection_update{};
+        tai most_recent_events_update{};
+        auto earliest_retry = (tai_clock::time_point::max)();
+
+        for (;;)
+        {
+            // wait for the thread to be interrupted because senders have been activated or deactivated (or any other change to the connection resources),
+            // or the state of sources may have changed, or because the server is being shut down, or because it's time to retry
+            model.wait_until(lock, earliest_retry, [&] { return model.shutdown || most_recent_connection_update < most_recent_update(model.connection_resources) || most_recent_events_update < most_recent_update(model.events_resources); });
+            if (model.shutdown) break;
+
+            earliest_retry = (tai_clock::time_point::max)();
+
+            if (most_recent_connection_update < most_recent_update(model.connection_resources))
+            {
+                most_recent_connection_update = most_recent_update(model.connection_resources);
+
+                // a newly enabled sender, or one whose broker, topic or source has changed, has to publish the current state
+                auto found = details::find_events_mqtt_destinations(model.connection_resources);
+                for (auto& destination : found)
+                {
+                    const auto previous = destinations.find(destination.first);
+                    if (destinations.end() == previous) continue;
+                    const auto& prev = previous->second;
+                    destination.second.pending = prev.pending || prev.broker != destination.second.broker || prev.topic != destination.second.topic || prev.source_id != destination.second.source_id;
+                }
+                destinations.swap(found);
+            }
+
+            // the sources whose state has changed since last time
+            const auto since = most_recent_events_update;
+            most_recent_events_update = most_recent_update(model.events_resources);
+            std::set<nmos::id> updated;
+            for (const auto& resource : model.events_resources.get<tags::updated>())
+            {
+                if (resource.updated <= since) break;
+                if (nmos::types::source == resource.type && resource.has_data()) updated.insert(resource.id);
+            }
+
+            // prepare the messages for each broker, serializing the state of each source just once
+            std::map<details::mqtt_broker, std::vector<std::pair<nmos::id, std::string>>> messages;
+            std::map<nmos::id, std::string> payloads;
+            std::set<details::mqtt_broker> brokers;
+            for (auto& destination : destinations)
+            {
+                auto& mqtt = destination.second;
+                brokers.insert(mqtt.broker);
+                if (!mqtt.pending && updated.end() == updated.find(mqtt.source_id)) continue;
+
+                const auto source = find_resource(model.events_resources, { mqtt.source_id, nmos::types::source });
+                if (model.events_resources.end() == source || !source->has_data()) continue;
+
+                auto payload = payloads.find(mqtt.source_id);
+                if (payloads.end() == payload)
+                {
+                    payload = payloads.insert({ mqtt.source_id, web::json::experimental::serialize_utf8(nmos::fields::endpoint_state(source->data)) }).first;
+                }
+
+                messages[mqtt.broker].push_back({ destination.first, details::make_mqtt_publish_packet(mqtt.topic, payload->second, true) });
+                mqtt.pending = false;
+            }
+
+            lock.unlock();
+
+            // publish the messages, connecting to each broker if necessary
+            std::vector<nmos::id> failed;
+            for (const auto& broker : messages)
+            {
+                try
+                {
+                    auto& connection = connections[broker.first];
+                    if (!connection)
+                    {
+                        slog::log<slog::severities::info>(gate, SLOG_FLF) << "Connecting to MQTT broker: " << broker.first.first << ":" << broker.first.second;
+                        connection.reset(new details::mqtt_connection(service, broker.first.first, broker.first.second));
+                    }
+
+                    for (const auto& message : broker.second)
+                    {
+                        connection->publish(message.second);
+                    }
+
+                    slog::log<slog::severities::too_much_info>(gate, SLOG_FLF) << "Published " << broker.second.size() << " state messages to MQTT broker: " << broker.first.first << ":" << broker.first.second;
+                }
+                catch (const std::exception& e)
+                {
+                    slog::log<slog::severities::warning>(gate, SLOG_FLF) << "MQTT error for broker: " << broker.first.first << ":" << broker.first.second << ": " << e.what();
+
+                    // the whole batch is published again; each message is the current state of the source, so that's harmless
+                    connections.erase(broker.first);
+                    for (const auto& message : broker.second)
+                    {
+                        failed.push_back(message.first);
+                    }
+                }
+            }
+
+            // disconnect from any brokers no longer used by any of the active senders
+            for (auto connection = connections.begin(); connections.end() != connection;)
+            {
+                if (brokers.end() == brokers.find(connection->first))
+                {
+                    slog::log<slog::severities::info>(gate, SLOG_FLF) << "Disconnecting from MQTT broker: " << connection->first.first << ":" << connection->first.second;
+                    connection = connections.erase(connection);
+                }
+                else ++connection;
+            }
+
+            lock.lock();
+
+            if (!failed.empty())
+            {
+                for (const auto& id : failed)
+                {
+                    auto destination = destinations.find(id);
+                    if (destinations.end() != destination) destination->second.pending = true;
+                }
+                earliest_retry = tai_clock::now() + retry_interval;
+            }
+        }
+
+        // disconnect from the brokers without the model lock held
+        lock.unlock();
+        connections.clear();
+    }
+}
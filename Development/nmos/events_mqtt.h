@@ -0,0 +1,35 @@
+#ifndef NMOS_EVENTS_MQTT_H
+#define NMOS_EVENTS_MQTT_H
+
+#include <cstdint>
+#include <string>
+
+namespace slog
+{
+    class base_gate;
+}
+
+// Events MQTT transport implementation, for the IS-07 MQTT senders of a node
+// See https://github.com/AMWA-TV/nmos-event-tally/blob/v1.0/docs/5.1.%20Transport%20-%20MQTT.md
+namespace nmos
+{
+    struct node_model;
+
+    namespace details
+    {
+        // MQTT 3.1.1 control packets, just those required to publish messages at QoS 0 (at most once)
+        // see http://docs.oasis-open.org/mqtt/mqtt/v3.1.1/os/mqtt-v3.1.1-os.html
+
+        // an empty client identifier means the broker assigns one, which requires a clean session
+        std::string make_mqtt_connect_packet(const std::string& client_id = {}, std::uint16_t keep_alive_seconds = 0);
+        std::string make_mqtt_publish_packet(const std::string& topic, const std::string& payload, bool retain);
+        std::string make_mqtt_disconnect_packet();
+    }
+
+    // publish the state of each IS-07 source to the broker and topic of each of its active MQTT senders (see nmos::make_connection_events_mqtt_sender),
+    // once each time it changes, and when each sender is activated, as a retained message, so that new subscribers immediately receive the current state,
+    // until the server is shut down; the messages are published without the model lock held, and failed connections to a broker are retried
+    void send_events_mqtt_messages_thread(nmos::node_model& model, slog::base_gate& gate);
+}
+
+#endif
@@ -1,7 +1,12 @@
 #include "nmos/events_ws_api.h"
 
+#include <map>
+#include <set>
 #include <boost/algorithm/string/join.hpp>
+#include "cpprest/containerstream.h"
+#include "cpprest/json_utils.h"
 #include "nmos/api_utils.h"
+#include "nmos/expiry_utils.h"
 #include "nmos/is07_versions.h"
 #include "nmos/log_manip.h"
 #include "nmos/model.h"
@@ -120,6 +125,7 @@ namespace nmos
                 insert_resource(resources, std::move(grain));
 
                 websockets.insert({ id, connection_id });
+                model.metrics.websockets.insert(id);
 
                 slog::log<slog::severities::info>(gate, SLOG_FLF) << "Creating websocket connection: " << id << " to subscription: " << subscription->id;
 
@@ -129,9 +135,20 @@ namespace nmos
         };
     }
 
-    web::websockets::experimental::listener::close_handler make_events_ws_close_handler(nmos::node_model& model, nmos::websockets& websockets, slog::base_gate& gate_)
+    web::websockets::experimental::listener::close_handler make_events_ws_close_handler(nmos::node_model& model, nmos::websockets& websockets, slog::base_gate& gate)
     {
-        return [&model, &websockets, &gate_](const utility::string_t& ws_resource_path, const web::websockets::experimental::listener::connection_id& connection_id, web::websockets::websocket_close_status close_status, const utility::string_t& close_reason)
+        // the index of subscribed websocket connections is not used without a publisher shared with send_events_ws_messages_thread
+        auto publisher = std::make_shared<nmos::experimental::events_ws_publisher>();
+        auto handler = make_events_ws_close_handler(model, websockets, *publisher, gate);
+        return [publisher, handler](const utility::string_t& ws_resource_path, const web::websockets::experimental::listener::connection_id& connection_id, web::websockets::websocket_close_status close_status, const utility::string_t& close_reason)
+        {
+            handler(ws_resource_path, connection_id, close_status, close_reason);
+        };
+    }
+
+    web::websockets::experimental::listener::close_handler make_events_ws_close_handler(nmos::node_model& model, nmos::websockets& websockets, nmos::experimental::events_ws_publisher& publisher, slog::base_gate& gate_)
+    {
+        return [&model, &websockets, &publisher, &gate_](const utility::string_t& ws_resource_path, const web::websockets::experimental::listener::connection_id& connection_id, web::websockets::websocket_close_status close_status, const utility::string_t& close_reason)
         {
             nmos::ws_api_gate gate(gate_, ws_resource_path);
             auto lock = model.write_lock();
@@ -163,19 +180,32 @@ namespace nmos
                     }
                 }
 
+                model.metrics.websockets.erase(websocket->second);
                 websockets.right.erase(websocket);
+                publisher.unsubscribe(connection_id);
 
                 model.notify();
             }
         };
     }
 
-    web::websockets::experimental::listener::message_handler make_events_ws_message_handler(nmos::node_model& model, nmos::websockets& websockets, slog::base_gate& gate_)
+    web::websockets::experimental::listener::message_handler make_events_ws_message_handler(nmos::node_model& model, nmos::websockets& websockets, slog::base_gate& gate)
+    {
+        // the index of subscribed websocket connections is not used without a publisher shared with send_events_ws_messages_thread
+        auto publisher = std::make_shared<nmos::experimental::events_ws_publisher>();
+        auto handler = make_events_ws_message_handler(model, websockets, *publisher, gate);
+        return [publisher, handler](const utility::string_t& ws_resource_path, const web::websockets::experimental::listener::connection_id& connection_id, const web::websockets::websocket_incoming_message& msg)
+        {
+            handler(ws_resource_path, connection_id, msg);
+        };
+    }
+
+    web::websockets::experimental::listener::message_handler make_events_ws_message_handler(nmos::node_model& model, nmos::websockets& websockets, nmos::experimental::events_ws_publisher& publisher, slog::base_gate& gate_)
     {
         using web::json::value;
         using web::json::value_of;
 
-        return [&model, &websockets, &gate_](const utility::string_t& ws_resource_path, const web::websockets::experimental::listener::connection_id& connection_id, const web::websockets::websocket_incoming_message& msg_)
+        return [&model, &websockets, &publisher, &gate_](const utility::string_t& ws_resource_path, const web::websockets::experimental::listener::connection_id& connection_id, const web::websockets::websocket_incoming_message& msg_)
         {
             nmos::ws_api_gate gate(gate_, ws_resource_path);
             auto lock = model.write_lock();
@@ -211,6 +241,13 @@ namespace nmos
                                     auto rql_query = U("in(id,(") + boost::algorithm::join(nmos::fields::sources(message) | boost::adaptors::transformed([](const value& v) { return v.as_string(); }), U(",")) + U("))");
 
                                     resource.data[nmos::fields::params] = value_of({ { U("query.rql"), rql_query } });
+
+                                    // experimental extension, to allow a client to receive several state messages in one frame
+                                    resource.data[nmos::experimental::fields::batch] = value::boolean(nmos::experimental::fields::batch(message));
+
+                                    // experimental extension, to allow a client to limit the rate of state messages for each source
+                                    // see nmos::send_events_ws_messages_thread
+                                    resource.data[nmos::fields::max_update_rate_ms] = (std::max)(0, nmos::experimental::fields::max_update_rate_ms(message));
                                 });
 
                                 // update the grain with the current (sync) data for state messages
@@ -237,6 +274,15 @@ namespace nmos
                                     grain.updated = strictly_increasing_update(resources);
                                 });
 
+                                // update the index of the websocket connections subscribed to each source
+
+                                std::set<nmos::id> source_ids;
+                                for (const auto& source_id : nmos::fields::sources(message))
+                                {
+                                    source_ids.insert(source_id.as_string());
+                                }
+                                publisher.subscribe(connection_id, source_ids);
+
                                 slog::log<slog::severities::info>(gate, SLOG_FLF) << "Received subscription command for " << nmos::fields::sources(message).size() << " sources";
                                 model.notify();
                             }
@@ -310,15 +356,396 @@ namespace nmos
         });
     }
 
-    void send_events_ws_messages_thread(web::websockets::experimental::listener::websocket_listener& listener, nmos::node_model& model, nmos::websockets& websockets, slog::base_gate& gate_)
+    namespace details
+    {
+        // determine whether the grain of any websocket connection has been erased, e.g. because its subscription expired, so that the connection needs to be closed
+        // using the maintained resource counts, rather than checking the grain of every websocket connection
+        static bool has_erased_events_ws_grains(const nmos::resources& resources, const nmos::websockets& websockets)
+        {
+            return websockets.size() != nmos::count_resources(resources, nmos::types::grain);
+        }
+
+        // find the websocket connections whose grain has expired, e.g. because a health command was not received soon enough
+        // expired grains aren't forgotten until the next expiry interval (see nmos::erase_expired_events_resources_thread), so they can be found
+        // using the type index of the non-extant resources, and the cost depends on the number of expired grains rather than the number of websocket connections
+        // (each health command only updates the health index, which the expiry thread uses to find just the resources which have actually expired)
+        static std::vector<std::pair<nmos::id, web::websockets::experimental::listener::connection_id>> find_expired_events_ws_grains(const nmos::resources& resources, const nmos::websockets& websockets)
+        {
+            std::vector<std::pair<nmos::id, web::websockets::experimental::listener::connection_id>> expired;
+            const auto& by_type = resources.get<tags::type>();
+            const auto grains = by_type.equal_range(nmos::details::type_extractor_tuple{ false, nmos::types::grain });
+            for (auto grain = grains.first; grains.second != grain; ++grain)
+            {
+                const auto websocket = websockets.left.find(grain->id);
+                if (websockets.left.end() != websocket) expired.push_back({ websocket->first, websocket->second });
+            }
+            return expired;
+        }
+
+        // find the grains which have been updated since the specified timestamp, e.g. because events have been inserted, most recently updated first
+        // using the typed updated index, so that the cost depends on the number of changes rather than the number of websocket connections
+        static std::vector<nmos::id> find_updated_events_ws_grains(const nmos::resources& resources, const nmos::tai& since)
+        {
+            std::vector<nmos::id> updated;
+            const typed_resources<tags::type_updated> grains(resources.get<tags::type_updated>(), nmos::types::grain);
+            const auto end = lower_bound(grains, since);
+            for (auto grain = grains.begin(); end != grain; ++grain)
+            {
+                updated.push_back(grain->id);
+            }
+            return updated;
+        }
+
+        // determine whether there are any websocket connections that need to be closed, or that have events to send
+        // note, this only requires a shared/read lock on the resources
+        static bool has_events_ws_messages_to_send(const nmos::resources& resources, const nmos::websockets& websockets, const nmos::tai& since)
+        {
+            if (has_erased_events_ws_grains(resources, websockets)) return true;
+
+            for (const auto& id : find_updated_events_ws_grains(resources, since))
+            {
+                if (websockets.left.end() == websockets.left.find(id)) continue;
+                const auto grain = find_resource(resources, { id, nmos::types::grain });
+                if (resources.end() == grain) continue;
+                const auto subscription = find_resource(resources, { nmos::fields::subscription_id(grain->data), nmos::types::subscription });
+                if (resources.end() == subscription) return true;
+
+                if (0 != nmos::fields::message_grain_data(grain->data).size()) return true;
+            }
+            return false;
+        }
+
+        struct events_ws_outgoing_message
+        {
+            web::websockets::experimental::listener::connection_id connection;
+            web::websockets::websocket_outgoing_message message;
+            // the serialized size, for the websocket connection metrics
+            size_t bytes;
+        };
+
+        typedef std::vector<events_ws_outgoing_message> events_ws_outgoing_messages;
+
+        // serialized state messages held back for a websocket connection which requested batching in the subscription command
+        struct events_ws_batch
+        {
+            events_ws_batch() : binary(false) {}
+
+            tai_clock::time_point due;
+            bool binary;
+            std::vector<std::string> messages;
+        };
+
+        typedef std::map<web::websockets::experimental::listener::connection_id, events_ws_batch> events_ws_batches;
+
+        // determine whether the websocket connection selected the experimental subprotocol for CBOR-encoded messages
+        static bool is_events_ws_binary(web::websockets::experimental::listener::websocket_listener& listener, const web::websockets::experimental::listener::connection_id& connection_id)
+        {
+            return nmos::experimental::events_ws_cbor_subprotocol == listener.subprotocol(connection_id);
+        }
+
+        static std::string serialize_events_ws_message(const web::json::value& message, bool binary)
+        {
+            return binary ? web::json::experimental::serialize_cbor(message) : utility::us2s(message.serialize());
+        }
+
+        // the health message replies to every connection's health commands differ only in their timestamps, so the JSON text around them
+        // is serialized once and shared, rather than each reply being built up as a JSON value and serialized separately
+        struct events_ws_health_message_template
+        {
+            std::string prefix;
+            std::string infix;
+            std::string suffix;
+
+            events_ws_health_message_template()
+            {
+                // derived from an example message, so that the result is exactly what serialize_events_ws_message would produce
+                const auto creation = utility::us2s(nmos::make_version(nmos::tai{ 1, 0 }));
+                const auto origin = utility::us2s(nmos::make_version(nmos::tai{ 2, 0 }));
+                const auto example = utility::us2s(make_events_health_message({ nmos::tai{ 1, 0 }, nmos::tai{ 2, 0 } }).serialize());
+                const auto c = example.find(creation);
+                const auto o = example.find(origin, c + creation.size());
+                prefix = example.substr(0, c);
+                infix = example.substr(c + creation.size(), o - c - creation.size());
+                suffix = example.substr(o + origin.size());
+            }
+        };
+
+        static std::string serialize_events_ws_health_message(const web::json::value& message)
+        {
+            const auto& timing = nmos::fields::timing(message);
+            const auto& creation = timing.at(U("creation_timestamp")).as_string();
+            const auto& origin = timing.at(U("origin_timestamp")).as_string();
+
+            static const events_ws_health_message_template health;
+
+            std::string serialized;
+            serialized.reserve(health.prefix.size() + creation.size() + health.infix.size() + origin.size() + health.suffix.size());
+            serialized.append(health.prefix);
+            serialized.append(utility::us2s(creation));
+            serialized.append(health.infix);
+            serialized.append(utility::us2s(origin));
+            serialized.append(health.suffix);
+            return serialized;
+        }
+
+        // determine whether the message is a health message which can be serialized by serialize_events_ws_health_message
+        static bool is_events_ws_health_message(const web::json::value& message, bool binary)
+        {
+            // the CBOR encoding of the timestamps isn't fixed-length, so isn't worth the special case
+            if (binary) return false;
+            if (!message.has_field(U("message_type")) || U("health") != message.at(U("message_type")).as_string()) return false;
+            if (!message.has_field(U("timing"))) return false;
+            const auto& timing = nmos::fields::timing(message);
+            return 2 == timing.size()
+                && timing.has_field(U("creation_timestamp")) && timing.at(U("creation_timestamp")).is_string()
+                && timing.has_field(U("origin_timestamp")) && timing.at(U("origin_timestamp")).is_string();
+        }
+
+        static void push_back(events_ws_outgoing_messages& outgoing_messages, const web::websockets::experimental::listener::connection_id& connection_id, std::string message, bool binary)
+        {
+            const auto bytes = message.size();
+            web::websockets::websocket_outgoing_message outgoing_message;
+            if (binary)
+            {
+                outgoing_message.set_binary_message(concurrency::streams::container_buffer<std::string>(std::move(message)).create_istream());
+            }
+            else
+            {
+                outgoing_message.set_utf8_message(std::move(message));
+            }
+            outgoing_messages.push_back({ connection_id, outgoing_message, bytes });
+        }
+
+        static void push_back(events_ws_batches& batches, const web::websockets::experimental::listener::connection_id& connection_id, std::string message, bool binary, const tai_clock::time_point& due)
+        {
+            auto& batch = batches[connection_id];
+            if (batch.messages.empty()) batch.due = due;
+            batch.binary = binary;
+            batch.messages.push_back(std::move(message));
+        }
+
+        // prepare the batched state messages as frames each containing a JSON (or CBOR) array of up to batch_limit state messages
+        static void flush_events_ws_batch(events_ws_batch& batch, const web::websockets::experimental::listener::connection_id& connection_id, size_t batch_limit, events_ws_outgoing_messages& outgoing_messages)
+        {
+            for (size_t first = 0; first < batch.messages.size(); first += batch_limit)
+            {
+                const auto last = (std::min)(first + batch_limit, batch.messages.size());
+
+                // the messages are already serialized, so can simply be concatenated
+                std::string frame;
+                if (batch.binary)
+                {
+                    web::json::experimental::serialize_cbor_array_header(frame, last - first);
+                    for (auto message = first; last != message; ++message)
+                    {
+                        frame.append(batch.messages[message]);
+                    }
+                }
+                else
+                {
+                    frame.push_back('[');
+                    for (auto message = first; last != message; ++message)
+                    {
+                        if (first != message) frame.push_back(',');
+                        frame.append(batch.messages[message]);
+                    }
+                    frame.push_back(']');
+                }
+
+                push_back(outgoing_messages, connection_id, std::move(frame), batch.binary);
+            }
+            batch.messages.clear();
+        }
+
+        // prepare a state message for a websocket connection, to be sent now, or batched if the subscription command requested batching
+        static void prepare_events_ws_state_message(events_ws_batches& batches, events_ws_outgoing_messages& outgoing_messages, const web::websockets::experimental::listener::connection_id& connection_id, std::string message, bool batching, bool binary, const tai_clock::time_point& due)
+        {
+            if (batching)
+            {
+                push_back(batches, connection_id, std::move(message), binary, due);
+            }
+            else
+            {
+                push_back(outgoing_messages, connection_id, std::move(message), binary);
+            }
+        }
+
+        // find the subscription of a websocket connection which is still open
+        static nmos::resources::const_iterator find_events_ws_subscription(const nmos::resources& resources, const nmos::websockets& websockets, const web::websockets::experimental::listener::connection_id& connection_id)
+        {
+            const auto websocket = websockets.right.find(connection_id);
+            if (websockets.right.end() == websocket) return resources.end();
+            const auto grain = find_resource(resources, { websocket->second, nmos::types::grain });
+            if (resources.end() == grain) return resources.end();
+            return find_resource(resources, { nmos::fields::subscription_id(grain->data), nmos::types::subscription });
+        }
+
+        // the latest state of a source held back for a websocket connection whose subscription command requested a maximum update rate
+        struct events_ws_throttle
+        {
+            // the end of the current window, before which state messages are coalesced
+            tai_clock::time_point next;
+            std::chrono::milliseconds max_update_rate;
+            // the latest state in the current window, or null
+            web::json::value latest;
+        };
+
+        typedef std::map<web::websockets::experimental::listener::connection_id, std::map<nmos::id, events_ws_throttle>> events_ws_throttles;
+
+        // determine whether a state message for a websocket connection must be held back, i.e. coalesced with any later state of the same source
+        // until the end of the current window, because the subscription command requested a maximum update rate
+        static bool throttle_events_ws_state(events_ws_throttles& throttles, const web::websockets::experimental::listener::connection_id& connection_id, const web::json::value& state, const web::json::value& subscription_data, const tai_clock::time_point& now)
+        {
+            const auto max_update_rate = std::chrono::milliseconds(nmos::fields::max_update_rate_ms(subscription_data));
+            if (std::chrono::milliseconds::zero() >= max_update_rate) return false;
+
+            auto& throttle = throttles[connection_id][nmos::fields::source_id(nmos::fields::identity(state))];
+            throttle.max_update_rate = max_update_rate;
+            if (throttle.next <= now)
+            {
+                throttle.next = now + max_update_rate;
+                throttle.latest = web::json::value::null();
+                return false;
+            }
+            throttle.latest = state;
+            return true;
+        }
+
+        // take the held back state messages at the end of their window, for websocket connections which are still open, and determine when the others are due
+        static void take_events_ws_throttled_states(events_ws_throttles& throttles, const nmos::websockets& websockets, const tai_clock::time_point& now, tai_clock::time_point& earliest_necessary_update, std::vector<std::pair<web::websockets::experimental::listener::connection_id, web::json::value>>& states)
+        {
+            for (auto connection = throttles.begin(); throttles.end() != connection;)
+            {
+                auto& sources = connection->second;
+                if (websockets.right.end() == websockets.right.find(connection->first)) sources.clear();
+
+                for (auto source = sources.begin(); sources.end() != source;)
+                {
+                    auto& throttle = source->second;
+                    if (throttle.next <= now)
+                    {
+                        // nothing was held back in the last window, so the next state message can be sent immediately
+                        if (throttle.latest.is_null())
+                        {
+                            source = sources.erase(source);
+                            continue;
+                        }
+                        throttle.next = now + throttle.max_update_rate;
+                        states.push_back({ connection->first, throttle.latest });
+                        throttle.latest = web::json::value::null();
+                    }
+                    else if (!throttle.latest.is_null())
+                    {
+                        if (throttle.next < earliest_necessary_update) earliest_necessary_update = throttle.next;
+                    }
+                    ++source;
+                }
+
+                if (sources.empty())
+                {
+                    connection = throttles.erase(connection);
+                }
+                else
+                {
+                    ++connection;
+                }
+            }
+        }
+
+        // take the published state messages for websocket connections which are still open
+        // each state message is serialized at most once for each encoding, however many connections it is sent to
+        static void take_events_ws_published_messages(nmos::experimental::events_ws_publisher& publisher, web::websockets::experimental::listener::websocket_listener& listener, const nmos::resources& resources, const nmos::websockets& websockets, const tai_clock::time_point& now, const tai_clock::time_point& due, events_ws_throttles& throttles, events_ws_batches& batches, events_ws_outgoing_messages& outgoing_messages)
+        {
+            std::map<const web::json::value*, std::string> serialized[2];
+
+            for (auto& published : publisher.take())
+            {
+                const auto subscription = find_events_ws_subscription(resources, websockets, published.first);
+                if (resources.end() == subscription) continue;
+
+                if (throttle_events_ws_state(throttles, published.first, *published.second, subscription->data, now)) continue;
+
+                const bool binary = is_events_ws_binary(listener, published.first);
+                auto& message = serialized[binary][published.second.get()];
+                if (message.empty()) message = serialize_events_ws_message(*published.second, binary);
+
+                prepare_events_ws_state_message(batches, outgoing_messages, published.first, message, nmos::experimental::fields::batch(subscription->data), binary, due);
+            }
+        }
+
+        // prepare the batches which are full or due, for websocket connections which are still open, and determine when the others are due
+        static void flush_events_ws_batches(events_ws_batches& batches, const nmos::websockets& websockets, size_t batch_limit, const tai_clock::time_point& now, tai_clock::time_point& earliest_necessary_update, events_ws_outgoing_messages& outgoing_messages)
+        {
+            for (auto batch = batches.begin(); batches.end() != batch;)
+            {
+                if (websockets.right.end() != websockets.right.find(batch->first))
+                {
+                    if (batch_limit <= batch->second.messages.size() || batch->second.due <= now)
+                    {
+                        flush_events_ws_batch(batch->second, batch->first, batch_limit, outgoing_messages);
+                    }
+                    else if (!batch->second.messages.empty())
+                    {
+                        if (batch->second.due < earliest_necessary_update) earliest_necessary_update = batch->second.due;
+                        ++batch;
+                        continue;
+                    }
+                }
+                batch = batches.erase(batch);
+            }
+        }
+    }
+
+    namespace experimental
     {
-        nmos::details::omanip_gate gate(gate_, nmos::stash_category(nmos::categories::send_events_ws_messages));
+        // publish a state change of the specified source with lower latency than modifying the events resource
+        bool publish_events_state(nmos::node_model& model, const nmos::websockets& websockets, events_ws_publisher& publisher, const nmos::id& source_id, const web::json::value& state)
+        {
+            auto& resources = model.events_resources;
+
+            auto source = find_resource(resources, { source_id, nmos::types::source });
+            if (resources.end() == source) return false;
+
+            // update the state for the Events API /state endpoint, without inserting resource events into the grain resources
+            // which also wakes send_events_ws_messages_thread when the caller notifies
+            resources.modify(source, [&resources, &state](nmos::resource& resource)
+            {
+                nmos::fields::endpoint_state(resource.data) = state;
+                resource.updated = strictly_increasing_update(resources);
+            });
+            // the pre-serialized Events API /state response is now stale
+            nmos::details::erase_resource_views(resources, source_id);
+
+            // share the state message between all the subscribed websocket connections, to be serialized by send_events_ws_messages_thread
+            // at most once for each encoding
+            const auto message = std::make_shared<const web::json::value>(state);
+
+            // only the subscribed websocket connections are touched; any which have since been closed are skipped by send_events_ws_messages_thread
+            for (const auto& connection_id : publisher.subscribed(source_id))
+            {
+                publisher.push(connection_id, message);
+            }
+
+            return true;
+        }
+    }
+
+    void send_events_ws_messages_thread(web::websockets::experimental::listener::websocket_listener& listener, nmos::node_model& model, nmos::websockets& websockets, slog::base_gate& gate)
+    {
+        nmos::experimental::events_ws_publisher publisher;
+        send_events_ws_messages_thread(listener, model, websockets, publisher, gate);
+    }
+
+    void send_events_ws_messages_thread(web::websockets::experimental::listener::websocket_listener& listener, nmos::node_model& model, nmos::websockets& websockets, nmos::experimental::events_ws_publisher& publisher, slog::base_gate& gate_)
+    {
+        nmos::details::omanip_gate gate(gate_, nmos::categories::send_events_ws_messages);
 
         using web::json::value;
         using web::json::value_of;
 
-        // could start out as a shared/read lock, only upgraded to an exclusive/write lock when a grain in the resources is actually modified
-        auto lock = model.write_lock();
+        // start out as a shared/read lock, only upgraded to an exclusive/write lock when a grain in the resources actually needs to be modified
+        // since this thread is woken by every change to the model, and most of those changes don't result in any messages to send
+        auto lock = model.read_lock();
         auto& condition = model.condition;
         auto& shutdown = model.shutdown;
         auto& resources = model.events_resources;
@@ -326,64 +753,121 @@ namespace nmos
         tai most_recent_message{};
         auto earliest_necessary_update = (tai_clock::time_point::max)();
 
+        // state messages held back for websocket connections which requested batching
+        details::events_ws_batches batches;
+
+        // state messages held back, and coalesced, for websocket connections which requested a maximum update rate
+        details::events_ws_throttles throttles;
+
         for (;;)
         {
             // wait for the thread to be interrupted either because there are resource changes, or because the server is being shut down
             // or because message sending was throttled earlier
             details::wait_until(condition, lock, earliest_necessary_update, [&] { return shutdown || most_recent_message < most_recent_update(resources); });
             if (shutdown) break;
+            // only the grains updated since the last time need to be considered
+            const auto since = most_recent_message;
             most_recent_message = most_recent_update(resources);
 
             slog::log<slog::severities::too_much_info>(gate, SLOG_FLF) << "Got notification on events websockets thread";
 
             earliest_necessary_update = (tai_clock::time_point::max)();
 
-            std::vector<std::pair<web::websockets::experimental::listener::connection_id, web::websockets::websocket_outgoing_message>> outgoing_messages;
+            // check whether there's actually any work to do...
+            if (!details::has_events_ws_messages_to_send(resources, websockets, since) && publisher.empty() && batches.empty() && throttles.empty()) continue;
 
-            for (auto wit = websockets.left.begin(); websockets.left.end() != wit;)
+            // otherwise, upgrade to an exclusive/write lock
+            details::reverse_lock_guard<nmos::read_lock> unlock{ lock };
+
+            details::events_ws_outgoing_messages outgoing_messages;
+            // the websocket connections to be closed are only closed once the lock has been released
+            std::vector<web::websockets::experimental::listener::connection_id> closing_websockets;
+
+            // note, without atomic upgrade, another thread may preempt, hence the need to recheck everything
+            auto upgrade = model.write_lock();
+            most_recent_message = most_recent_update(resources);
+
+            const auto batch_limit = (size_t)(std::max)(1, nmos::experimental::fields::events_ws_batch_limit(model.settings));
+            const auto batch_latency = std::chrono::milliseconds(nmos::experimental::fields::events_ws_batch_latency(model.settings));
+            const auto now = tai_clock::now();
+
+            // close the websocket connections whose grain has been erased, e.g. because a health command was not received soon enough
+            if (details::has_erased_events_ws_grains(resources, websockets))
             {
-                const auto& websocket = *wit;
+                for (const auto& websocket : details::find_expired_events_ws_grains(resources, websockets))
+                {
+                    closing_websockets.push_back(websocket.second);
 
-                // for each websocket connection that has valid grain and subscription resources
-                const auto grain = find_resource(resources, { websocket.first, nmos::types::grain });
-                if (resources.end() == grain)
+                    publisher.unsubscribe(websocket.second);
+                    model.metrics.websockets.erase(websocket.first);
+                    websockets.left.erase(websocket.first);
+                }
+            }
+
+            // any others, e.g. whose grain was explicitly erased and forgotten, are only found by checking every websocket connection
+            if (details::has_erased_events_ws_grains(resources, websockets))
+            {
+                for (auto wit = websockets.left.begin(); websockets.left.end() != wit;)
                 {
-                    // theoretically blocking, but in fact not
-                    listener.close(websocket.second, web::websockets::websocket_close_status::server_terminate, U("Expired")).wait();
+                    if (resources.end() != find_resource(resources, { wit->first, nmos::types::grain }))
+                    {
+                        ++wit;
+                        continue;
+                    }
 
+                    closing_websockets.push_back(wit->second);
+
+                    publisher.unsubscribe(wit->second);
+                    model.metrics.websockets.erase(wit->first);
                     wit = websockets.left.erase(wit);
-                    continue;
                 }
+            }
+
+            // only the websocket connections whose grain has been updated since the last time can have events to send
+            for (const auto& id : details::find_updated_events_ws_grains(resources, since))
+            {
+                const auto websocket_ = websockets.left.find(id);
+                if (websockets.left.end() == websocket_) continue;
+                const auto websocket = *websocket_;
+
+                // for each websocket connection that has valid grain and subscription resources
+                const auto grain = find_resource(resources, { websocket.first, nmos::types::grain });
+                if (resources.end() == grain) continue;
                 const auto subscription = find_resource(resources, { nmos::fields::subscription_id(grain->data), nmos::types::subscription });
                 if (resources.end() == subscription)
                 {
                     // a grain without a subscription shouldn't be possible, but let's be tidy
                     erase_resource(resources, grain->id);
 
-                    // theoretically blocking, but in fact not
-                    listener.close(websocket.second, web::websockets::websocket_close_status::server_terminate, U("Expired")).wait();
+                    closing_websockets.push_back(websocket.second);
 
-                    wit = websockets.left.erase(wit);
+                    publisher.unsubscribe(websocket.second);
+                    model.metrics.websockets.erase(websocket.first);
+                    websockets.left.erase(websocket_);
                     continue;
                 }
                 // and has events to send
-                if (0 == nmos::fields::message_grain_data(grain->data).size())
-                {
-                    ++wit;
-                    continue;
-                }
+                if (0 == nmos::fields::message_grain_data(grain->data).size()) continue;
 
                 slog::log<slog::severities::info>(gate, SLOG_FLF) << "Preparing to send " << nmos::fields::message_grain_data(grain->data).size() << " events on websocket connection: " << grain->id;
 
+                const bool batching = nmos::experimental::fields::batch(subscription->data);
+                const bool binary = details::is_events_ws_binary(listener, websocket.second);
+
                 for (const auto& event : nmos::fields::message_grain_data(grain->data).as_array())
                 {
-                    web::websockets::websocket_outgoing_message message;
-
                     if (event.has_field(U("message_type")))
                     {
                         // reboot, shutdown or health message
-                        message.set_utf8_message(utility::us2s(event.serialize()));
-                        outgoing_messages.push_back({ websocket.second, message });
+                        // these are never batched or held back, but any state messages held back for the connection are sent first
+                        if (batching)
+                        {
+                            auto batch = batches.find(websocket.second);
+                            if (batches.end() != batch) details::flush_events_ws_batch(batch->second, websocket.second, batch_limit, outgoing_messages);
+                        }
+                        details::push_back(outgoing_messages, websocket.second, details::is_events_ws_health_message(event, binary)
+                            ? details::serialize_events_ws_health_message(event)
+                            : details::serialize_events_ws_message(event, binary), binary);
                     }
                     else if (event.has_field(U("post")))
                     {
@@ -392,8 +876,9 @@ namespace nmos
                         // and nmos::make_events_boolean_state, nmos::make_events_number_state, etc.
                         // and nmos::details::make_resource_event
                         const web::json::value& state = nmos::fields::endpoint_state(event.at(U("post")));
-                        message.set_utf8_message(utility::us2s(state.serialize()));
-                        outgoing_messages.push_back({ websocket.second, message });
+                        if (details::throttle_events_ws_state(throttles, websocket.second, state, subscription->data, now)) continue;
+
+                        details::prepare_events_ws_state_message(batches, outgoing_messages, websocket.second, details::serialize_events_ws_message(state, binary), batching, binary, now + batch_latency);
                     }
                 }
 
@@ -404,19 +889,54 @@ namespace nmos
                     nmos::fields::message_grain_data(grain.data) = value::array();
                     grain.updated = strictly_increasing_update(resources);
                 });
+            }
+
+            // published state messages are sent after the messages from the grains, e.g. the current state after a subscription command
+            details::take_events_ws_published_messages(publisher, listener, resources, websockets, now, now + batch_latency, throttles, batches, outgoing_messages);
 
-                ++wit;
+            // within each window, only the latest state of each source is sent, at the end of the window, to websocket connections which requested a maximum update rate
+            // this only holds one state message for each source, however many state changes there are, so the grains do not grow without bound
+            std::vector<std::pair<web::websockets::experimental::listener::connection_id, web::json::value>> throttled_states;
+            details::take_events_ws_throttled_states(throttles, websockets, now, earliest_necessary_update, throttled_states);
+            for (const auto& throttled_state : throttled_states)
+            {
+                const auto subscription = details::find_events_ws_subscription(resources, websockets, throttled_state.first);
+                if (resources.end() == subscription) continue;
+
+                const bool binary = details::is_events_ws_binary(listener, throttled_state.first);
+                details::prepare_events_ws_state_message(batches, outgoing_messages, throttled_state.first, details::serialize_events_ws_message(throttled_state.second, binary), nmos::experimental::fields::batch(subscription->data), binary, now + batch_latency);
             }
 
-            // send the messages without the lock on resources
-            details::reverse_lock_guard<nmos::write_lock> unlock{ lock };
+            // batched state messages are sent when the batch is full or the first message has been held back for the maximum latency
+            details::flush_events_ws_batches(batches, websockets, batch_limit, now, earliest_necessary_update, outgoing_messages);
+
+            // the grains which have just been reset don't need to be considered again
+            most_recent_message = most_recent_update(resources);
+
+            // identify the websocket for each message, for the websocket connection metrics, while the websockets are still protected
+            std::vector<nmos::id> outgoing_websockets;
+            outgoing_websockets.reserve(outgoing_messages.size());
+            for (const auto& outgoing_message : outgoing_messages)
+            {
+                const auto websocket = websockets.right.find(outgoing_message.connection);
+                outgoing_websockets.push_back(websockets.right.end() != websocket ? websocket->second : nmos::id{});
+            }
+
+            // close the websocket connections and send the messages without the lock on resources
+            upgrade.unlock();
+
+            details::close_websockets(listener, closing_websockets, U("Expired"), gate);
 
             if (!outgoing_messages.empty()) slog::log<slog::severities::info>(gate, SLOG_FLF) << "Sending " << outgoing_messages.size() << " websocket messages";
 
-            for (auto& outgoing_message : outgoing_messages)
+            for (size_t i = 0; i < outgoing_messages.size(); ++i)
             {
+                auto& outgoing_message = outgoing_messages[i];
+                model.metrics.websockets.send_begin(outgoing_websockets[i]);
+
                 // hmmm, no way to cancel this currently...
-                auto send = listener.send(outgoing_message.first, outgoing_message.second).then([&](pplx::task<void> finally)
+                // IS-07 event messages are small and latency-sensitive, so are never compressed
+                auto send = listener.send(outgoing_message.connection, outgoing_message.message, false).then([&](pplx::task<void> finally)
                 {
                     try
                     {
@@ -430,60 +950,16 @@ namespace nmos
                 // current websocket_listener implementation is synchronous in any case, but just to make clear...
                 // for now, wait for the message to be sent
                 send.wait();
+
+                model.metrics.websockets.send_end(outgoing_websockets[i], outgoing_message.bytes);
             }
         }
     }
 
     void erase_expired_events_resources_thread(nmos::node_model& model, slog::base_gate& gate_)
     {
-        nmos::details::omanip_gate gate(gate_, nmos::stash_category(nmos::categories::events_expiry));
-
-        // start out as a shared/read lock, only upgraded to an exclusive/write lock when an expired resource actually needs to be deleted from the resources
-        auto lock = model.read_lock();
-        auto& shutdown_condition = model.shutdown_condition;
-        auto& shutdown = model.shutdown;
-        auto& resources = model.events_resources;
-
-        auto least_health = nmos::least_health(resources);
-
-        // wait until the next connection could potentially expire, or the server is being shut down
-        // (since health is truncated to seconds, and we want to be certain the expiry interval has passed, there's an extra second to wait here)
-        while (!shutdown_condition.wait_until(lock, time_point_from_health(least_health.first + nmos::fields::events_expiry_interval(model.settings) + 1), [&] { return shutdown; }))
-        {
-            // hmmm, it needs to be possible to enable/disable periodic logging like this independently of the severity...
-            slog::log<slog::severities::more_info>(gate, SLOG_FLF) << "At " << nmos::make_version(nmos::tai_now()) << ", the node events' resources contains " << nmos::put_resources_statistics(resources);
+        nmos::details::omanip_gate gate(gate_, nmos::categories::events_expiry);
 
-            // most connections will have had a heartbeat during the wait, so the least health will have been increased
-            // so this thread will be able to go straight back to waiting
-            auto expire_health = health_now() - nmos::fields::events_expiry_interval(model.settings);
-            auto forget_health = expire_health - nmos::fields::events_expiry_interval(model.settings);
-            least_health = nmos::least_health(resources);
-            if (least_health.first >= expire_health && least_health.second >= forget_health) continue;
-
-            // otherwise, there's actually work to do...
-
-            details::reverse_lock_guard<nmos::read_lock> unlock(lock);
-            // note, without atomic upgrade, another thread may preempt hence the need to recalculate expire_health/forget_health and least_health
-            auto upgrade = model.write_lock();
-
-            expire_health = health_now() - nmos::fields::events_expiry_interval(model.settings);
-            forget_health = expire_health - nmos::fields::events_expiry_interval(model.settings);
-
-            // forget all resources expired in the previous interval
-            forget_erased_resources(resources, forget_health);
-
-            // expire all nodes for which there hasn't been a heartbeat in the last expiry interval
-            const auto expired = erase_expired_resources(resources, expire_health, false);
-
-            if (0 != expired)
-            {
-                slog::log<slog::severities::info>(gate, SLOG_FLF) << expired << " resources have expired";
-
-                slog::log<slog::severities::too_much_info>(gate, SLOG_FLF) << "Notifying events websockets thread"; // and anyone else who cares...
-                model.notify();
-            }
-
-            least_health = nmos::least_health(resources);
-        }
+        details::erase_expired_resources_thread(model, model.events_resources, nmos::fields::events_expiry_interval, "the node events' resources", "events websockets thread", gate);
     }
 }
@@ -1,6 +1,9 @@
 #ifndef NMOS_EVENTS_WS_API_H
 #define NMOS_EVENTS_WS_API_H
 
+#include <map>
+#include <mutex>
+#include <set>
 #include "nmos/events_resources.h"
 #include "nmos/websockets.h"
 
@@ -20,6 +23,21 @@ namespace nmos
     web::websockets::experimental::listener::close_handler make_events_ws_close_handler(nmos::node_model& model, nmos::websockets& websockets, slog::base_gate& gate);
     web::websockets::experimental::listener::message_handler make_events_ws_message_handler(nmos::node_model& model, nmos::websockets& websockets, slog::base_gate& gate);
 
+    namespace experimental
+    {
+        class events_ws_publisher;
+
+        // the websocket subprotocol which a client may request in the opening handshake, to receive state, health, reboot and shutdown messages
+        // in binary frames using the Concise Binary Object Representation instead of json text frames; commands are still sent as json text frames
+        // see web::websockets::experimental::listener::websocket_listener_config::set_subprotocols and web::json::experimental::serialize_cbor
+        const utility::string_t events_ws_cbor_subprotocol{ U("x-nmos-events-cbor") };
+    }
+
+    // these overloads also maintain the publisher's index of the websocket connections subscribed to each source
+    // see nmos::experimental::publish_events_state
+    web::websockets::experimental::listener::close_handler make_events_ws_close_handler(nmos::node_model& model, nmos::websockets& websockets, nmos::experimental::events_ws_publisher& publisher, slog::base_gate& gate);
+    web::websockets::experimental::listener::message_handler make_events_ws_message_handler(nmos::node_model& model, nmos::websockets& websockets, nmos::experimental::events_ws_publisher& publisher, slog::base_gate& gate);
+
     // reboot message
     // see https://github.com/AMWA-TV/nmos-event-tally/blob/v1.0.x/docs/2.0.%20Message%20types.md#12-the-reboot-message-type
     web::json::value make_events_reboot_message(const nmos::details::events_state_identity& identity, const nmos::details::events_state_timing& timing = {});
@@ -32,7 +50,96 @@ namespace nmos
     // see https://github.com/AMWA-TV/nmos-event-tally/blob/v1.0/docs/2.0.%20Message%20types.md#15-the-health-message
     web::json::value make_events_health_message(const nmos::details::events_state_timing& timing);
 
+    namespace experimental
+    {
+        // state messages which have been queued for each subscribed websocket connection, by publish_events_state
+        // and which are sent by send_events_ws_messages_thread, after any messages for the same connections from the grain resources
+        class events_ws_publisher
+        {
+        public:
+            typedef std::vector<std::pair<web::websockets::experimental::listener::connection_id, std::shared_ptr<const web::json::value>>> messages;
+
+            void push(const web::websockets::experimental::listener::connection_id& connection_id, const std::shared_ptr<const web::json::value>& message)
+            {
+                std::lock_guard<std::mutex> lock(mutex);
+                queued.push_back({ connection_id, message });
+            }
+
+            messages take()
+            {
+                messages taken;
+                std::lock_guard<std::mutex> lock(mutex);
+                taken.swap(queued);
+                return taken;
+            }
+
+            bool empty() const
+            {
+                std::lock_guard<std::mutex> lock(mutex);
+                return queued.empty();
+            }
+
+            // the index of the websocket connections subscribed to each source, maintained by the Events WebSocket API message and close handlers
+            // so that a state change touches only the interested connections
+            // note, unlike the queued messages, the index is protected by the model mutex
+            typedef std::set<web::websockets::experimental::listener::connection_id> connection_ids;
+
+            void subscribe(const web::websockets::experimental::listener::connection_id& connection_id, const std::set<nmos::id>& source_ids)
+            {
+                unsubscribe(connection_id);
+                for (const auto& source_id : source_ids)
+                {
+                    subscribers[source_id].insert(connection_id);
+                }
+                if (!source_ids.empty()) subscriptions[connection_id] = source_ids;
+            }
+
+            void unsubscribe(const web::websockets::experimental::listener::connection_id& connection_id)
+            {
+                auto subscription = subscriptions.find(connection_id);
+                if (subscriptions.end() == subscription) return;
+                for (const auto& source_id : subscription->second)
+                {
+                    auto source = subscribers.find(source_id);
+                    if (subscribers.end() == source) continue;
+                    source->second.erase(connection_id);
+                    if (source->second.empty()) subscribers.erase(source);
+                }
+                subscriptions.erase(subscription);
+            }
+
+            const connection_ids& subscribed(const nmos::id& source_id) const
+            {
+                static const connection_ids none;
+                auto source = subscribers.find(source_id);
+                return subscribers.end() != source ? source->second : none;
+            }
+
+        private:
+            mutable std::mutex mutex;
+            messages queued;
+
+            std::map<nmos::id, connection_ids> subscribers;
+            std::map<web::websockets::experimental::listener::connection_id, std::set<nmos::id>> subscriptions;
+        };
+
+        // publish a state change of the specified source with lower latency than modifying the events resource, for sources
+        // with high-rate state changes; the source's state is updated so that the Events API /state endpoint is consistent,
+        // but the subscribed websocket connections are looked up in the publisher's index, which requires the Events WebSocket API
+        // message and close handlers to have been made with the same publisher, and the state message is serialized at most once for each encoding, bypassing the
+        // resource events for the grain resources, so a source's state should be changed either this way or the other, not both
+        // returns false if the source does not exist
+        // note, a write lock on the model must be held by the caller, which should then call model.notify()
+        bool publish_events_state(nmos::node_model& model, const nmos::websockets& websockets, events_ws_publisher& publisher, const nmos::id& source_id, const web::json::value& state);
+    }
+
+    // when the client's subscription command requested batching (an experimental extension, see nmos::experimental::fields::batch)
+    // pending state messages are sent in frames containing a JSON array of state messages, see nmos::experimental::fields::events_ws_batch_limit
+    // and nmos::experimental::fields::events_ws_batch_latency
+    // when the client's subscription command requested a maximum update rate (see nmos::experimental::fields::max_update_rate_ms)
+    // state messages for each source are coalesced, so that within each window only the latest state is sent
     void send_events_ws_messages_thread(web::websockets::experimental::listener::websocket_listener& listener, nmos::node_model& model, nmos::websockets& websockets, slog::base_gate& gate);
+    void send_events_ws_messages_thread(web::websockets::experimental::listener::websocket_listener& listener, nmos::node_model& model, nmos::websockets& websockets, nmos::experimental::events_ws_publisher& publisher, slog::base_gate& gate);
     void erase_expired_events_resources_thread(nmos::node_model& model, slog::base_gate& gate);
 }
 
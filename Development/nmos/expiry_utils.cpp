@@ -0,0 +1,91 @@
+#include "nmos/expiry_utils.h"
+
+#include <algorithm>
+#include "nmos/log_manip.h"
+#include "nmos/model.h"
+#include "nmos/slog.h"
+#include "nmos/thread_utils.h" // for reverse_lock_guard
+#include "nmos/tracepoints.h"
+
+namespace nmos
+{
+    // returns the time at which the next resource could need to be expired or forgotten, given the expiry interval
+    // (since health is truncated to seconds, and we want to be certain the expiry interval has passed, there's an extra second to wait)
+    // note, this relies on the health index, so the result is found without scanning the resources
+    health next_expiry_health(const resources& resources, health expiry_interval)
+    {
+        const auto least_health = nmos::least_health(resources);
+        // extant resources are expired after one interval, and then forgotten after another
+        return (std::min)(least_health.first + expiry_interval + 1, least_health.second + expiry_interval + expiry_interval + 1);
+    }
+
+    namespace details
+    {
+        // erase resources for which there hasn't been a heartbeat in the expiry interval, and forget them after a further interval,
+        // until the server is shut down; the description and notified strings are only used for logging
+        void erase_expired_resources_thread(nmos::base_model& model, nmos::resources& resources, const web::json::field_as_integer_or& expiry_interval, const std::string& description, const std::string& notified, slog::base_gate& gate)
+        {
+            // start out as a shared/read lock, only upgraded to an exclusive/write lock when an expired resource actually needs to be deleted from the resources
+            auto lock = model.read_lock();
+            auto& shutdown_condition = model.shutdown_condition;
+            auto& shutdown = model.shutdown;
+
+            // wait until the next resource could potentially expire or need to be forgotten, or the server is being shut down
+            // each heartbeat only updates the health index, and each wake-up only touches the resources which have actually expired,
+            // so a slow heartbeat from one client doesn't cause a scan of all the resources
+            auto next_expiry = next_expiry_health(resources, expiry_interval(model.settings));
+            while (!shutdown_condition.wait_until(lock, time_point_from_health(next_expiry), [&]{ return shutdown; }))
+            {
+                // hmmm, it needs to be possible to enable/disable periodic logging like this independently of the severity...
+                slog::log<slog::severities::more_info>(gate, SLOG_FLF) << "At " << nmos::make_version(nmos::tai_now()) << ", " << description << " contains " << nmos::put_resources_statistics(resources);
+
+                // most clients will have had a heartbeat during the wait, so the least health will have been increased
+                // so this thread will be able to go straight back to waiting
+                auto expire_health = health_now() - expiry_interval(model.settings);
+                auto forget_health = expire_health - expiry_interval(model.settings);
+                auto least_health = nmos::least_health(resources);
+                if (least_health.first >= expire_health && least_health.second >= forget_health)
+                {
+                    next_expiry = next_expiry_health(resources, expiry_interval(model.settings));
+                    continue;
+                }
+
+                // otherwise, there's actually work to do...
+
+                details::reverse_lock_guard<nmos::read_lock> unlock(lock);
+                // note, without atomic upgrade, another thread may preempt hence the need to recalculate expire_health/forget_health and the next expiry
+                auto upgrade = model.write_lock();
+
+                expire_health = health_now() - expiry_interval(model.settings);
+                forget_health = expire_health - expiry_interval(model.settings);
+
+                NMOS_CPP_TRACE(expiry_begin, description.c_str());
+
+                // forget all resources expired in the previous interval
+                const auto forgotten = forget_erased_resources(resources, forget_health);
+
+                // expire all resources for which there hasn't been a heartbeat in the last expiry interval
+                const auto expired = erase_expired_resources(resources, expire_health, false);
+
+                NMOS_CPP_TRACE(expiry_end, description.c_str(), expired, forgotten);
+
+                if (0 != forgotten)
+                {
+                    slog::log<slog::severities::too_much_info>(gate, SLOG_FLF) << forgotten << " expired resources have been forgotten";
+                }
+
+                if (0 != expired)
+                {
+                    model.metrics.expired_resources += expired;
+
+                    slog::log<slog::severities::info>(gate, SLOG_FLF) << expired << " resources have expired";
+
+                    slog::log<slog::severities::too_much_info>(gate, SLOG_FLF) << "Notifying " << notified; // and anyone else who cares...
+                    model.notify();
+                }
+
+                next_expiry = next_expiry_health(resources, expiry_interval(model.settings));
+            }
+        }
+    }
+}
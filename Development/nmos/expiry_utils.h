@@ -0,0 +1,32 @@
+#ifndef NMOS_EXPIRY_UTILS_H
+#define NMOS_EXPIRY_UTILS_H
+
+#include <string>
+#include "cpprest/json_utils.h"
+#include "nmos/health.h"
+
+namespace slog
+{
+    class base_gate;
+}
+
+// Resource expiry, shared by the IS-04 Registration API and the IS-07 Events WebSocket API
+namespace nmos
+{
+    struct base_model;
+    struct resources;
+
+    // returns the time at which the next resource could need to be expired or forgotten, given the expiry interval
+    // (since health is truncated to seconds, and we want to be certain the expiry interval has passed, there's an extra second to wait)
+    // note, this relies on the health index, so the result is found without scanning the resources
+    health next_expiry_health(const resources& resources, health expiry_interval);
+
+    namespace details
+    {
+        // erase resources for which there hasn't been a heartbeat in the expiry interval, and forget them after a further interval,
+        // until the server is shut down; the description and notified strings are only used for logging
+        void erase_expired_resources_thread(nmos::base_model& model, nmos::resources& resources, const web::json::field_as_integer_or& expiry_interval, const std::string& description, const std::string& notified, slog::base_gate& gate);
+    }
+}
+
+#endif
@@ -1,8 +1,16 @@
 #include "nmos/filesystem_route.h"
 
+#include <fstream>
+#include <mutex>
+#include <boost/algorithm/string/case_conv.hpp>
+#include <boost/algorithm/string/split.hpp>
+#include <boost/algorithm/string/trim.hpp>
 #include "bst/filesystem.h"
 
+#include "cpprest/containerstream.h"
 #include "cpprest/filestream.h"
+#include "cpprest/http_utils.h"
+#include "nmos/api_utils.h" // for nmos::details::set_not_modified_reply
 #include "nmos/slog.h"
 
 namespace nmos
@@ -16,6 +24,163 @@ namespace nmos
 #else
             using native_path = bst_filesystem::wpath;
 #endif
+
+            typedef decltype(bst::filesystem::last_write_time(native_path())) file_time;
+
+            // the contents of a file, and of its precompressed gzip variant if one is found alongside it, e.g. "index.js.gz" for "index.js",
+            // with the last write time and size of each, since these are checked in order to reload the file when it is changed
+            struct cached_file
+            {
+                file_time last_write_time;
+                utility::size64_t size;
+                std::string body;
+                utility::string_t entity_tag;
+
+                bool has_gzip;
+                file_time gzip_last_write_time;
+                utility::size64_t gzip_size;
+                std::string gzip_body;
+                utility::string_t gzip_entity_tag;
+            };
+
+            // read the whole of the specified file, or return false if it cannot be read
+            static bool read_file(std::string& contents, const utility::string_t& filesystem_path, utility::size64_t size)
+            {
+                std::ifstream file(filesystem_path, std::ios::in | std::ios::binary);
+                contents.resize((size_t)size);
+                return file.read(&contents[0], (std::streamsize)size) && file.gcount() == (std::streamsize)size;
+            }
+
+            // make a strong entity-tag for the specified file contents (the gzip variant is a different representation so must have a different entity-tag)
+            static utility::string_t make_file_entity_tag(const std::string& contents, const utility::string_t& suffix = {})
+            {
+                return U("\"") + utility::ostringstreamed(contents.size()) + U("-") + utility::ostringstreamed(std::hash<std::string>()(contents)) + suffix + U("\"");
+            }
+
+            // the files that have been requested, so that the admin UI's static assets are read from disk only when they have been changed,
+            // rather than on every request
+            // files larger than the maximum file size are not cached, and the cache is simply cleared when it reaches its capacity
+            class file_cache
+            {
+            public:
+                explicit file_cache(utility::size64_t max_file_size = 4 * 1024 * 1024, utility::size64_t capacity = 64 * 1024 * 1024)
+                    : max_file_size(max_file_size)
+                    , capacity(capacity)
+                    , total_size(0)
+                {}
+
+                // returns null if the file does not exist or is not to be cached, in which case it should be served directly from the filesystem
+                std::shared_ptr<const cached_file> get(const utility::string_t& filesystem_path)
+                {
+                    const native_path path(filesystem_path);
+                    if (!bst::filesystem::exists(path)) return{};
+                    const auto last_write_time = bst::filesystem::last_write_time(path);
+                    const utility::size64_t size = bst::filesystem::file_size(path);
+                    if (max_file_size < size) return{};
+
+                    const auto gzip_filesystem_path = filesystem_path + U(".gz");
+                    const native_path gzip_path(gzip_filesystem_path);
+                    const bool has_gzip = bst::filesystem::exists(gzip_path);
+                    const auto gzip_last_write_time = has_gzip ? bst::filesystem::last_write_time(gzip_path) : file_time{};
+                    const utility::size64_t gzip_size = has_gzip ? bst::filesystem::file_size(gzip_path) : 0;
+
+                    {
+                        std::lock_guard<std::mutex> lock(mutex);
+                        auto found = entries.find(filesystem_path);
+                        if (entries.end() != found
+                            && found->second->last_write_time == last_write_time && found->second->size == size
+                            && found->second->has_gzip == has_gzip && (!has_gzip || (found->second->gzip_last_write_time == gzip_last_write_time && found->second->gzip_size == gzip_size)))
+                        {
+                            return found->second;
+                        }
+                    }
+
+                    // read the file without the lock, since concurrent requests for the same file that has been changed are rare
+                    std::shared_ptr<cached_file> file(new cached_file{ last_write_time, size, {}, {}, has_gzip && max_file_size >= gzip_size, gzip_last_write_time, gzip_size, {}, {} });
+                    if (!read_file(file->body, filesystem_path, size)) return{};
+                    file->entity_tag = make_file_entity_tag(file->body);
+                    if (file->has_gzip)
+                    {
+                        // an unreadable gzip variant is simply not used
+                        file->has_gzip = read_file(file->gzip_body, gzip_filesystem_path, gzip_size);
+                        if (file->has_gzip) file->gzip_entity_tag = make_file_entity_tag(file->gzip_body, U("-gzip"));
+                        else file->gzip_body.clear();
+                    }
+
+                    std::lock_guard<std::mutex> lock(mutex);
+                    auto& entry = entries[filesystem_path];
+                    if (entry) total_size -= entry->body.size() + entry->gzip_body.size();
+                    if (capacity < total_size + file->body.size() + file->gzip_body.size())
+                    {
+                        entries.clear();
+                        total_size = 0;
+                    }
+                    entries[filesystem_path] = file;
+                    total_size += file->body.size() + file->gzip_body.size();
+                    return file;
+                }
+
+            private:
+                const utility::size64_t max_file_size;
+                const utility::size64_t capacity;
+                std::mutex mutex;
+                utility::size64_t total_size;
+                std::map<utility::string_t, std::shared_ptr<const cached_file>> entries;
+            };
+
+            // check whether the gzip content-coding is acceptable according to the specified Accept-Encoding header
+            // See https://tools.ietf.org/html/rfc7231#section-5.3.4
+            static bool is_gzip_acceptable(const utility::string_t& accept_encoding)
+            {
+                bool acceptable = false;
+
+                std::vector<utility::string_t> elements;
+                boost::algorithm::split(elements, accept_encoding, [](utility::char_t c) { return U(',') == c; });
+                for (const auto& element : elements)
+                {
+                    std::vector<utility::string_t> params;
+                    boost::algorithm::split(params, element, [](utility::char_t c) { return U(';') == c; });
+                    const auto coding = boost::algorithm::to_lower_copy(boost::algorithm::trim_copy(params.front()));
+
+                    double qvalue = 1;
+                    for (auto param = std::next(params.begin()); params.end() != param; ++param)
+                    {
+                        const auto trimmed = boost::algorithm::trim_copy(*param);
+                        if (0 == trimmed.compare(0, 2, U("q=")) || 0 == trimmed.compare(0, 2, U("Q=")))
+                        {
+                            qvalue = utility::istringstreamed<double>(trimmed.substr(2), 0);
+                        }
+                    }
+
+                    // an explicit "gzip" takes precedence over "*"
+                    if (U("gzip") == coding || U("x-gzip") == coding) return 0 < qvalue;
+                    else if (U("*") == coding) acceptable = 0 < qvalue;
+                }
+
+                return acceptable;
+            }
+
+            // set the response to the cached file, or its gzip variant, or to 304 (Not Modified) if the request's If-None-Match header matches
+            static void set_cached_file_reply(const web::http::http_request& req, web::http::http_response& res, const cached_file& file, const utility::string_t& content_type)
+            {
+                using web::http::header_names;
+
+                const bool gzip = file.has_gzip && is_gzip_acceptable(req.headers().has(header_names::accept_encoding) ? req.headers()[header_names::accept_encoding] : utility::string_t{});
+                const auto& body = gzip ? file.gzip_body : file.body;
+                const auto& entity_tag = gzip ? file.gzip_entity_tag : file.entity_tag;
+
+                // the response depends on the Accept-Encoding header when the file has a gzip variant
+                if (file.has_gzip) web::http::add_header_value(res.headers(), header_names::vary, header_names::accept_encoding);
+                // the files may be changed, e.g. when the admin UI is updated, so clients must revalidate, but usually get 304 (Not Modified)
+                res.headers().set_cache_control(U("no-cache"));
+
+                if (nmos::details::set_not_modified_reply(req, res, entity_tag)) return;
+
+                web::http::set_reply(res, web::http::status_codes::OK, concurrency::streams::container_buffer<std::string>(body).create_istream(), body.size(), content_type);
+                res.headers().add(header_names::etag, entity_tag);
+                // setting the Content-Encoding header also prevents the response body being compressed again
+                if (gzip) res.headers().add(header_names::content_encoding, U("gzip"));
+            }
         }
 
         web::http::experimental::listener::api_router make_filesystem_route(const utility::string_t& filesystem_root, const relative_path_content_type_validator& validate, slog::base_gate& gate_)
@@ -24,7 +189,9 @@ namespace nmos
 
             api_router filesystem_route;
 
-            filesystem_route.support(U("(?<filesystem-relative-path>/.+)"), web::http::methods::GET, [filesystem_root, validate, &gate_](http_request req, http_response res, const string_t&, const route_parameters& parameters)
+            auto cache = std::make_shared<details::file_cache>();
+
+            filesystem_route.support(U("(?<filesystem-relative-path>/.+)"), web::http::methods::GET, [filesystem_root, validate, cache, &gate_](http_request req, http_response res, const string_t&, const route_parameters& parameters)
             {
                 nmos::api_gate gate(gate_, req, parameters);
                 slog::log<slog::severities::more_info>(gate, SLOG_FLF) << "Filesystem request received";
@@ -40,7 +207,21 @@ namespace nmos
                 {
                     const auto filesystem_path = filesystem_root + relative_path;
 
-                    if (bst::filesystem::exists(details::native_path(filesystem_path)))
+                    std::shared_ptr<const details::cached_file> cached;
+                    try
+                    {
+                        cached = cache->get(filesystem_path);
+                    }
+                    catch (const bst::filesystem::filesystem_error& e)
+                    {
+                        slog::log<slog::severities::warning>(gate, SLOG_FLF) << "Filesystem error: " << e.what();
+                    }
+
+                    if (cached)
+                    {
+                        details::set_cached_file_reply(req, res, *cached, content_type);
+                    }
+                    else if (bst::filesystem::exists(details::native_path(filesystem_path)))
                     {
                         const utility::size64_t content_length = bst::filesystem::file_size(details::native_path(filesystem_path));
                         return concurrency::streams::fstream::open_istream(filesystem_path, std::ios::in).then([res, content_length, content_type](concurrency::streams::istream is) mutable
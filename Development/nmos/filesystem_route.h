@@ -40,6 +40,8 @@ namespace nmos
             };
         }
 
+        // files are served from an in-memory cache, which is reloaded when a file is changed, with a strong entity-tag to support conditional requests,
+        // and a precompressed gzip variant, e.g. "index.js.gz" for "index.js", is served instead when one is found and the request indicates it is acceptable
         web::http::experimental::listener::api_router make_filesystem_route(const utility::string_t& filesystem_root, const relative_path_content_type_validator& validate, slog::base_gate& gate);
     }
 }
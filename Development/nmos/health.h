@@ -13,8 +13,9 @@ namespace nmos
 
     inline health health_now()
     {
+        // only to the nearest second, so the coarse clock is more than good enough
         return std::chrono::duration_cast<std::chrono::seconds>(
-            tai_clock::now().time_since_epoch()).count();
+            tai_clock::coarse_now().time_since_epoch()).count();
     }
 
     inline tai_clock::time_point time_point_from_health(health health)
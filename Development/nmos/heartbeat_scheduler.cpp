@@ -0,0 +1,223 @@
+#include "nmos/heartbeat_scheduler.h"
+
+#include <algorithm>
+#include <map>
+#include <mutex>
+#include "pplx/pplx_utils.h" // for pplx::complete_after
+#include "nmos/json_fields.h"
+
+namespace nmos
+{
+    namespace experimental
+    {
+        namespace details
+        {
+            class heartbeat_scheduler_impl : public std::enable_shared_from_this<heartbeat_scheduler_impl>
+            {
+            public:
+                heartbeat_scheduler_impl(std::chrono::milliseconds batch_window, size_t batch_limit)
+                    : batch_window(batch_window)
+                    , batch_limit((std::max)(size_t(1), batch_limit))
+                {}
+
+                pplx::task<web::http::http_response> update_node_health(const web::uri& base_uri, const web::http::client::http_client_config& config, const nmos::id& id, const pplx::cancellation_token& token)
+                {
+                    std::unique_lock<std::mutex> lock(mutex);
+
+                    auto& registry = registries[base_uri.to_string()];
+                    if (!registry) registry.reset(new registry_heartbeats(base_uri, config));
+
+                    if (1 == batch_limit || !registry->bulk_supported)
+                    {
+                        lock.unlock();
+                        return request_node_health(registry->client, id, token);
+                    }
+
+                    pplx::task_completion_event<web::http::http_response> tce;
+                    registry->pending.push_back({ id, tce });
+
+                    if (registry->pending.size() >= batch_limit)
+                    {
+                        flush(registry, lock);
+                    }
+                    else if (!registry->flush_scheduled)
+                    {
+                        registry->flush_scheduled = true;
+                        auto self = shared_from_this();
+                        auto flushed = registry;
+                        pplx::complete_after(batch_window).then([self, flushed]
+                        {
+                            std::unique_lock<std::mutex> lock(self->mutex);
+                            self->flush(flushed, lock);
+                        });
+                    }
+
+                    return pplx::create_task(tce, token);
+                }
+
+            private:
+                typedef std::vector<std::pair<nmos::id, pplx::task_completion_event<web::http::http_response>>> pending_heartbeats;
+
+                struct registry_heartbeats
+                {
+                    registry_heartbeats(const web::uri& base_uri, const web::http::client::http_client_config& config)
+                        : client(base_uri, config)
+                        , bulk_supported(true)
+                        , flush_scheduled(false)
+                    {}
+
+                    web::http::client::http_client client;
+                    // optimistic until the Registration API responds that the bulk health endpoint is not found
+                    bool bulk_supported;
+                    bool flush_scheduled;
+                    pending_heartbeats pending;
+                };
+
+                static pplx::task<web::http::http_response> request_node_health(web::http::client::http_client client, const nmos::id& id, const pplx::cancellation_token& token = pplx::cancellation_token::none())
+                {
+                    return client.request(web::http::methods::POST, U("/health/nodes/") + id, token);
+                }
+
+                template <typename Task>
+                static void link(pplx::task_completion_event<web::http::http_response> tce, Task task)
+                {
+                    task.then([tce](pplx::task<web::http::http_response> finally)
+                    {
+                        try
+                        {
+                            tce.set(finally.get());
+                        }
+                        catch (...)
+                        {
+                            tce.set_exception(std::current_exception());
+                        }
+                    });
+                }
+
+                // make the requests for the pending heartbeats (with the mutex locked, but it is unlocked before returning)
+                void flush(std::shared_ptr<registry_heartbeats> registry, std::unique_lock<std::mutex>& lock)
+                {
+                    pending_heartbeats pending;
+                    pending.swap(registry->pending);
+                    registry->flush_scheduled = false;
+                    const bool bulk_supported = registry->bulk_supported;
+                    lock.unlock();
+
+                    for (size_t first = 0; first < pending.size(); first += batch_limit)
+                    {
+                        const auto last = (std::min)(first + batch_limit, pending.size());
+                        pending_heartbeats batch(pending.begin() + first, pending.begin() + last);
+
+                        if (1 == batch.size() || !bulk_supported)
+                        {
+                            for (auto& heartbeat : batch)
+                            {
+                                link(heartbeat.second, request_node_health(registry->client, heartbeat.first));
+                            }
+                        }
+                        else
+                        {
+                            request_bulk_node_health(registry, std::move(batch));
+                        }
+                    }
+                }
+
+                void request_bulk_node_health(std::shared_ptr<registry_heartbeats> registry, pending_heartbeats batch)
+                {
+                    auto ids = web::json::value::array();
+                    for (const auto& heartbeat : batch)
+                    {
+                        web::json::push_back(ids, web::json::value::string(heartbeat.first));
+                    }
+
+                    auto self = shared_from_this();
+                    registry->client.request(web::http::methods::POST, U("/bulk/health/nodes"), ids).then([self, registry, batch](pplx::task<web::http::http_response> response_task) -> pplx::task<void>
+                    {
+                        try
+                        {
+                            auto response = response_task.get();
+
+                            if (web::http::status_codes::OK == response.status_code())
+                            {
+                                return response.extract_json().then([batch](pplx::task<web::json::value> body_task)
+                                {
+                                    try
+                                    {
+                                        const auto body = body_task.get();
+
+                                        std::map<nmos::id, web::json::value> results;
+                                        for (const auto& result : body.as_array())
+                                        {
+                                            results[nmos::fields::id(result)] = result;
+                                        }
+
+                                        for (const auto& heartbeat : batch)
+                                        {
+                                            auto found = results.find(heartbeat.first);
+                                            // missing results are treated as a server error, in the same way as an invalid response
+                                            web::http::http_response response(results.end() != found ? (web::http::status_code)found->second.at(U("code")).as_integer() : web::http::status_codes::InternalError);
+                                            if (results.end() != found) response.set_body(found->second);
+                                            heartbeat.second.set(response);
+                                        }
+                                    }
+                                    catch (...)
+                                    {
+                                        for (const auto& heartbeat : batch)
+                                        {
+                                            heartbeat.second.set(web::http::http_response(web::http::status_codes::InternalError));
+                                        }
+                                    }
+                                });
+                            }
+                            else if (web::http::status_codes::NotFound == response.status_code() || web::http::status_codes::MethodNotAllowed == response.status_code())
+                            {
+                                // the Registration API does not support the experimental extension, so heartbeats are made individually from now on
+                                {
+                                    std::lock_guard<std::mutex> lock(self->mutex);
+                                    registry->bulk_supported = false;
+                                }
+                                for (const auto& heartbeat : batch)
+                                {
+                                    link(heartbeat.second, request_node_health(registry->client, heartbeat.first));
+                                }
+                            }
+                            else
+                            {
+                                // e.g. a server (5xx) error applies to all the nodes
+                                for (const auto& heartbeat : batch)
+                                {
+                                    heartbeat.second.set(response);
+                                }
+                            }
+                        }
+                        catch (...)
+                        {
+                            // e.g. http_exception, inability to connect or a timeout, also applies to all the nodes
+                            for (const auto& heartbeat : batch)
+                            {
+                                heartbeat.second.set_exception(std::current_exception());
+                            }
+                        }
+                        return pplx::task_from_result();
+                    });
+                }
+
+                const std::chrono::milliseconds batch_window;
+                const size_t batch_limit;
+
+                std::mutex mutex;
+                std::map<utility::string_t, std::shared_ptr<registry_heartbeats>> registries;
+            };
+        }
+
+        heartbeat_scheduler::heartbeat_scheduler(std::chrono::milliseconds batch_window, size_t batch_limit)
+            : impl(std::make_shared<details::heartbeat_scheduler_impl>(batch_window, batch_limit))
+        {
+        }
+
+        pplx::task<web::http::http_response> heartbeat_scheduler::update_node_health(const web::uri& base_uri, const web::http::client::http_client_config& config, const nmos::id& id, const pplx::cancellation_token& token)
+        {
+            return impl->update_node_health(base_uri, config, id, token);
+        }
+    }
+}
@@ -0,0 +1,40 @@
+#ifndef NMOS_HEARTBEAT_SCHEDULER_H
+#define NMOS_HEARTBEAT_SCHEDULER_H
+
+#include <chrono>
+#include "cpprest/http_client.h"
+#include "nmos/id.h"
+
+// Heartbeats for several logical nodes in one process
+namespace nmos
+{
+    namespace experimental
+    {
+        namespace details
+        {
+            class heartbeat_scheduler_impl;
+        }
+
+        // a heartbeat scheduler may be shared by the node behaviour of several node models in one process
+        // heartbeats on the same Registration API share one HTTP client, and so its connections, and heartbeats which fall due
+        // within the batch window are combined in one request on the experimental bulk health endpoint, when the Registration API supports it
+        // see nmos::node_behaviour_thread
+        class heartbeat_scheduler
+        {
+        public:
+            // batch_window is how long a heartbeat may be held back to be combined with others, and batch_limit is the maximum number of nodes
+            // in one request, or 1 to only share the HTTP client
+            explicit heartbeat_scheduler(std::chrono::milliseconds batch_window = std::chrono::milliseconds(100), size_t batch_limit = 100);
+
+            // asynchronously perform a heartbeat for the specified node on the Registration API with the specified base URI, like http://example.api.com/x-nmos/registration/{version}
+            // and return the response for that node; when heartbeats are combined, the response has just the status code and response body for the node
+            // note, the client configuration of the first heartbeat on each Registration API is used for all of them
+            pplx::task<web::http::http_response> update_node_health(const web::uri& base_uri, const web::http::client::http_client_config& config, const nmos::id& id, const pplx::cancellation_token& token = pplx::cancellation_token::none());
+
+        private:
+            std::shared_ptr<details::heartbeat_scheduler_impl> impl;
+        };
+    }
+}
+
+#endif
@@ -1,16 +1,74 @@
 #include "nmos/id.h"
 
+#include <cstdint>
+#include <random>
 #include <boost/uuid/name_generator.hpp>
-#include <boost/uuid/random_generator.hpp>
 #include <boost/uuid/string_generator.hpp>
 #include <boost/uuid/uuid_io.hpp>
 #include "cpprest/basic_utils.h"
 
 namespace nmos
 {
+    namespace details
+    {
+        // a 64-bit Mersenne Twister is much cheaper per UUID than boost::uuids::random_generator, especially where that reads
+        // from the operating system's random device every time (and make_id constructs one every time); NMOS identifiers need
+        // to be unique, not unpredictable, so seeding the engine from the random device once is sufficient
+        class random_id_engine
+        {
+        public:
+            random_id_engine()
+            {
+                std::random_device device;
+                std::seed_seq seed{ device(), device(), device(), device(), device(), device(), device(), device() };
+                engine.seed(seed);
+            }
+
+            id operator()()
+            {
+                const std::uint64_t hi = engine();
+                const std::uint64_t lo = engine();
+
+                // "set the four most significant bits [...] of the time_hi_and_version field to the 4-bit version number"
+                // and "the two most significant bits [...] of the clock_seq_hi_and_reserved to zero and one, respectively"
+                // See https://tools.ietf.org/html/rfc4122#section-4.4
+                std::uint8_t bytes[16];
+                for (int i = 0; i < 8; ++i) bytes[i] = std::uint8_t(hi >> (56 - 8 * i));
+                for (int i = 0; i < 8; ++i) bytes[8 + i] = std::uint8_t(lo >> (56 - 8 * i));
+                bytes[6] = (bytes[6] & 0x0F) | 0x40;
+                bytes[8] = (bytes[8] & 0x3F) | 0x80;
+
+                return format(bytes);
+            }
+
+        private:
+            // format the canonical 36-character, lowercase, hyphenated form, identical to boost::uuids::to_string
+            static id format(const std::uint8_t (&bytes)[16])
+            {
+                static const char hex_digits[] = "0123456789abcdef";
+
+                id result(36, U('-'));
+                auto out = result.begin();
+                for (int i = 0; i < 16; ++i)
+                {
+                    if (4 == i || 6 == i || 8 == i || 10 == i) ++out;
+                    *out++ = utility::char_t(hex_digits[bytes[i] >> 4]);
+                    *out++ = utility::char_t(hex_digits[bytes[i] & 0x0F]);
+                }
+                return result;
+            }
+
+            std::mt19937_64 engine;
+        };
+
+        template <typename StringT> StringT to(const boost::uuids::uuid& u);
+        template <> inline std::string to(const boost::uuids::uuid& u) { return boost::uuids::to_string(u); }
+        template <> inline std::wstring to(const boost::uuids::uuid& u) { return boost::uuids::to_wstring(u); }
+    }
+
     struct id_generator::impl_t
     {
-        boost::uuids::random_generator gen;
+        details::random_id_engine gen;
     };
 
     id_generator::id_generator()
@@ -23,23 +81,17 @@ namespace nmos
         // explicitly defined so that impl_t is a complete type for the unique_ptr destructor
     }
 
-    namespace details
-    {
-        template <typename StringT> StringT to(const boost::uuids::uuid& u);
-        template <> inline std::string to(const boost::uuids::uuid& u) { return boost::uuids::to_string(u); }
-        template <> inline std::wstring to(const boost::uuids::uuid& u) { return boost::uuids::to_wstring(u); }
-    }
-
     id id_generator::operator()()
     {
-        return details::to<id>(impl->gen());
+        return impl->gen();
     }
 
     // generate a random number-based UUID (v4)
-    // note, when creating multiple UUIDs, using a generator can be more efficient depending on platform and dependencies
+    // each thread has its own generator, so that seeding it isn't repeated for every UUID
     id make_id()
     {
-        return id_generator()();
+        static thread_local details::random_id_engine gen;
+        return gen();
     }
 
     // generate a name-based UUID (v5)
@@ -11,6 +11,9 @@ namespace nmos
 
     // Since identifiers are passed as strings in the APIs, and the formatting of identifiers has been a little
     // inconsistent between implementations in the past, they are currently stored simply as strings...
+    // A compact 16-byte representation would halve the cost of hashing and comparing ids in the resources id index,
+    // but would require canonicalising (or rejecting) every id at the API boundary, and a round-trip that preserves
+    // whatever formatting the client used, since ids are echoed back to clients and compared with the resource data.
     typedef utility::string_t id;
 
     // a random number-based UUID (v4) generator
@@ -28,7 +31,7 @@ namespace nmos
     };
 
     // generate a random number-based UUID (v4)
-    // note, when creating multiple UUIDs, using an id_generator can be more efficient depending on platform and dependencies
+    // thread-safe, using a generator per thread
     id make_id();
 
     // generate a name-based UUID (v5)
@@ -2,6 +2,7 @@
 #define NMOS_IS04_VERSIONS_H
 
 #include <set>
+#include <boost/range/adaptor/filtered.hpp>
 #include <boost/range/adaptor/transformed.hpp>
 #include "nmos/api_version.h"
 #include "nmos/settings.h"
@@ -15,12 +16,29 @@ namespace nmos
         const api_version v1_2{ 1, 2 };
         const api_version v1_3{ 1, 3 };
 
-        const std::set<api_version> all{ nmos::is04_versions::v1_0, nmos::is04_versions::v1_1, nmos::is04_versions::v1_2, nmos::is04_versions::v1_3 };
+        // the versions which are built in, see NMOS_CPP_IS04_VERSIONS in NmosCppCommon.cmake
+        const std::set<api_version> all
+        {
+#if !defined(NMOS_CPP_EXCLUDE_IS04_V1_0)
+            nmos::is04_versions::v1_0,
+#endif
+#if !defined(NMOS_CPP_EXCLUDE_IS04_V1_1)
+            nmos::is04_versions::v1_1,
+#endif
+#if !defined(NMOS_CPP_EXCLUDE_IS04_V1_2)
+            nmos::is04_versions::v1_2,
+#endif
+#if !defined(NMOS_CPP_EXCLUDE_IS04_V1_3)
+            nmos::is04_versions::v1_3,
+#endif
+        };
 
         inline std::set<api_version> from_settings(const nmos::settings& settings)
         {
             return settings.has_field(nmos::fields::is04_versions)
-                ? boost::copy_range<std::set<api_version>>(nmos::fields::is04_versions(settings) | boost::adaptors::transformed([](const web::json::value& v) { return nmos::parse_api_version(v.as_string()); }))
+                ? boost::copy_range<std::set<api_version>>(nmos::fields::is04_versions(settings)
+                    | boost::adaptors::transformed([](const web::json::value& v) { return nmos::parse_api_version(v.as_string()); })
+                    | boost::adaptors::filtered([](const api_version& v) { return 0 != nmos::is04_versions::all.count(v); })) // versions which are not built in are ignored
                 : nmos::is04_versions::all;
         }
     }
@@ -2,6 +2,7 @@
 #define NMOS_IS05_VERSIONS_H
 
 #include <set>
+#include <boost/range/adaptor/filtered.hpp>
 #include <boost/range/adaptor/transformed.hpp>
 #include "nmos/api_version.h"
 #include "nmos/settings.h"
@@ -13,12 +14,23 @@ namespace nmos
         const api_version v1_0{ 1, 0 };
         const api_version v1_1{ 1, 1 };
 
-        const std::set<api_version> all{ nmos::is05_versions::v1_0, nmos::is05_versions::v1_1 };
+        // the versions which are built in, see NMOS_CPP_IS05_VERSIONS in NmosCppCommon.cmake
+        const std::set<api_version> all
+        {
+#if !defined(NMOS_CPP_EXCLUDE_IS05_V1_0)
+            nmos::is05_versions::v1_0,
+#endif
+#if !defined(NMOS_CPP_EXCLUDE_IS05_V1_1)
+            nmos::is05_versions::v1_1,
+#endif
+        };
 
         inline std::set<api_version> from_settings(const nmos::settings& settings)
         {
             return settings.has_field(nmos::fields::is05_versions)
-                ? boost::copy_range<std::set<api_version>>(nmos::fields::is05_versions(settings) | boost::adaptors::transformed([](const web::json::value& v) { return nmos::parse_api_version(v.as_string()); }))
+                ? boost::copy_range<std::set<api_version>>(nmos::fields::is05_versions(settings)
+                    | boost::adaptors::transformed([](const web::json::value& v) { return nmos::parse_api_version(v.as_string()); })
+                    | boost::adaptors::filtered([](const api_version& v) { return 0 != nmos::is05_versions::all.count(v); })) // versions which are not built in are ignored
                 : nmos::is05_versions::all;
         }
     }
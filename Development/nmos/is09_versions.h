@@ -2,6 +2,7 @@
 #define NMOS_IS09_VERSIONS_H
 
 #include <set>
+#include <boost/range/adaptor/filtered.hpp>
 #include <boost/range/adaptor/transformed.hpp>
 #include "nmos/api_version.h"
 #include "nmos/settings.h"
@@ -12,12 +13,20 @@ namespace nmos
     {
         const api_version v1_0{ 1, 0 };
 
-        const std::set<api_version> all{ nmos::is09_versions::v1_0 };
+        // the versions which are built in, see NMOS_CPP_IS09_VERSIONS in NmosCppCommon.cmake
+        const std::set<api_version> all
+        {
+#if !defined(NMOS_CPP_EXCLUDE_IS09_V1_0)
+            nmos::is09_versions::v1_0,
+#endif
+        };
 
         inline std::set<api_version> from_settings(const nmos::settings& settings)
         {
             return settings.has_field(nmos::fields::is09_versions)
-                ? boost::copy_range<std::set<api_version>>(nmos::fields::is09_versions(settings) | boost::adaptors::transformed([](const web::json::value& v) { return nmos::parse_api_version(v.as_string()); }))
+                ? boost::copy_range<std::set<api_version>>(nmos::fields::is09_versions(settings)
+                    | boost::adaptors::transformed([](const web::json::value& v) { return nmos::parse_api_version(v.as_string()); })
+                    | boost::adaptors::filtered([](const api_version& v) { return 0 != nmos::is09_versions::all.count(v); })) // versions which are not built in are ignored
                 : nmos::is09_versions::all;
         }
     }
@@ -134,6 +134,8 @@ namespace nmos
         const web::json::field_as_value_or rtcp_source_port{ U("rtcp_source_port"), {} }; // string or integer
         const web::json::field_as_value_or fec_mode{ U("fec_mode"), {} }; // string
         const web::json::field_as_value_or connection_uri{ U("connection_uri"), {} }; // string or null
+        const web::json::field_as_value_or destination_host{ U("destination_host"), {} }; // string or null
+        const web::json::field_as_value_or broker_topic{ U("broker_topic"), {} }; // string or null
 
         // IS-07 Event & Tally
 
@@ -160,6 +162,15 @@ namespace nmos
         namespace fields
         {
             const web::json::field<nmos::api_version> api_version{ U("api_version") };
+
+            // batch [node]: in an Events API websocket subscription command, whether the client accepts frames containing a JSON array of state messages
+            // see nmos::make_events_ws_message_handler
+            const web::json::field_as_bool_or batch{ U("batch"), false };
+
+            // max_update_rate_ms [node]: in an Events API websocket subscription command, the minimum interval in milliseconds between state messages for each source
+            // within which only the latest state is sent, or 0 for no throttling
+            // see nmos::send_events_ws_messages_thread
+            const web::json::field_as_integer_or max_update_rate_ms{ U("max_update_rate_ms"), 0 };
         }
     }
 }
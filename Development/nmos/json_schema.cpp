@@ -1,5 +1,7 @@
 #include "nmos/json_schema.h"
 
+#include <map>
+#include <mutex>
 #include "cpprest/basic_utils.h"
 #include "nmos/is04_versions.h"
 #include "nmos/is04_schemas/is04_schemas.h"
@@ -111,17 +113,19 @@ namespace nmos
 {
     namespace details
     {
-        static web::json::value make_schema(const char* schema)
+        // the schemas are only parsed when they are first loaded, since most processes only use a few of the many versions
+        static const char* make_schema(const char* schema)
         {
-            return web::json::value::parse(utility::s2us(schema));
+            return schema;
         }
 
-        static std::map<web::uri, web::json::value> make_is04_schemas()
+        static std::map<web::uri, const char*> make_is04_schemas()
         {
             using namespace nmos::is04_schemas;
 
             return
             {
+#if !defined(NMOS_CPP_EXCLUDE_IS04_V1_3)
                 // v1.3
                 { make_schema_uri(v1_3::tag, _XPLATSTR("registrationapi-resource-post-request.json")), make_schema(v1_3::registrationapi_resource_post_request) },
                 { make_schema_uri(v1_3::tag, _XPLATSTR("clock_internal.json")), make_schema(v1_3::clock_internal) },
@@ -153,6 +157,8 @@ namespace nmos
                 { make_schema_uri(v1_3::tag, _XPLATSTR("source_core.json")), make_schema(v1_3::source_core) },
                 { make_schema_uri(v1_3::tag, _XPLATSTR("queryapi-subscriptions-post-request.json")), make_schema(v1_3::queryapi_subscriptions_post_request) },
                 { make_schema_uri(v1_3::tag, _XPLATSTR("nodeapi-receiver-target.json")), make_schema(v1_3::nodeapi_receiver_target) },
+#endif
+#if !defined(NMOS_CPP_EXCLUDE_IS04_V1_2)
                 // v1.2
                 { make_schema_uri(v1_2::tag, _XPLATSTR("registrationapi-resource-post-request.json")), make_schema(v1_2::registrationapi_resource_post_request) },
                 { make_schema_uri(v1_2::tag, _XPLATSTR("clock_internal.json")), make_schema(v1_2::clock_internal) },
@@ -184,6 +190,8 @@ namespace nmos
                 { make_schema_uri(v1_2::tag, _XPLATSTR("source_core.json")), make_schema(v1_2::source_core) },
                 { make_schema_uri(v1_2::tag, _XPLATSTR("queryapi-subscriptions-post-request.json")), make_schema(v1_2::queryapi_subscriptions_post_request) },
                 { make_schema_uri(v1_2::tag, _XPLATSTR("nodeapi-receiver-target.json")), make_schema(v1_2::nodeapi_receiver_target) },
+#endif
+#if !defined(NMOS_CPP_EXCLUDE_IS04_V1_1)
                 // v1.1
                 { make_schema_uri(v1_1::tag, _XPLATSTR("registrationapi-resource-post-request.json")), make_schema(v1_1::registrationapi_resource_post_request) },
                 { make_schema_uri(v1_1::tag, _XPLATSTR("clock_internal.json")), make_schema(v1_1::clock_internal) },
@@ -215,6 +223,8 @@ namespace nmos
                 { make_schema_uri(v1_1::tag, _XPLATSTR("source_core.json")), make_schema(v1_1::source_core) },
                 { make_schema_uri(v1_1::tag, _XPLATSTR("queryapi-subscriptions-post-request.json")), make_schema(v1_1::queryapi_subscriptions_post_request) },
                 { make_schema_uri(v1_1::tag, _XPLATSTR("nodeapi-receiver-target.json")), make_schema(v1_1::nodeapi_receiver_target) },
+#endif
+#if !defined(NMOS_CPP_EXCLUDE_IS04_V1_0)
                 // v1.0
                 { make_schema_uri(v1_0::tag, _XPLATSTR("registrationapi-v1.0-resource-post-request.json")), make_schema(v1_0::registrationapi_v1_0_resource_post_request) },
                 { make_schema_uri(v1_0::tag, _XPLATSTR("device.json")), make_schema(v1_0::device) },
@@ -225,15 +235,17 @@ namespace nmos
                 { make_schema_uri(v1_0::tag, _XPLATSTR("source.json")), make_schema(v1_0::source) },
                 { make_schema_uri(v1_0::tag, _XPLATSTR("queryapi-v1.0-subscriptions-post-request.json")), make_schema(v1_0::queryapi_v1_0_subscriptions_post_request) },
                 { make_schema_uri(v1_0::tag, _XPLATSTR("nodeapi-receiver-target.json")), make_schema(v1_0::nodeapi_receiver_target) },
+#endif
             };
         }
 
-        static std::map<web::uri, web::json::value> make_is05_schemas()
+        static std::map<web::uri, const char*> make_is05_schemas()
         {
             using namespace nmos::is05_schemas;
 
             return
             {
+#if !defined(NMOS_CPP_EXCLUDE_IS05_V1_1)
                 // v1.1
                 { make_schema_uri(v1_1::tag, _XPLATSTR("sender-stage-schema.json")), make_schema(v1_1::sender_stage_schema) },
                 { make_schema_uri(v1_1::tag, _XPLATSTR("receiver-stage-schema.json")), make_schema(v1_1::receiver_stage_schema) },
@@ -248,6 +260,8 @@ namespace nmos
                 { make_schema_uri(v1_1::tag, _XPLATSTR("receiver_transport_params_websocket.json")), make_schema(v1_1::receiver_transport_params_websocket) },
                 { make_schema_uri(v1_1::tag, _XPLATSTR("receiver_transport_params_mqtt.json")), make_schema(v1_1::receiver_transport_params_mqtt) },
                 { make_schema_uri(v1_1::tag, _XPLATSTR("receiver_transport_params_ext.json")), make_schema(v1_1::receiver_transport_params_ext) },
+#endif
+#if !defined(NMOS_CPP_EXCLUDE_IS05_V1_0)
                 // v1.0
                 { make_schema_uri(v1_0::tag, _XPLATSTR("v1.0-sender-stage-schema.json")), make_schema(v1_0::v1_0_sender_stage_schema) },
                 { make_schema_uri(v1_0::tag, _XPLATSTR("v1.0-receiver-stage-schema.json")), make_schema(v1_0::v1_0_receiver_stage_schema) },
@@ -256,27 +270,30 @@ namespace nmos
                 { make_schema_uri(v1_0::tag, _XPLATSTR("v1.0_sender_transport_params_dash.json")), make_schema(v1_0::v1_0_sender_transport_params_dash) },
                 { make_schema_uri(v1_0::tag, _XPLATSTR("v1.0_receiver_transport_params_rtp.json")), make_schema(v1_0::v1_0_receiver_transport_params_rtp) },
                 { make_schema_uri(v1_0::tag, _XPLATSTR("v1.0_receiver_transport_params_dash.json")), make_schema(v1_0::v1_0_receiver_transport_params_dash) }
+#endif
             };
         }
 
-        static std::map<web::uri, web::json::value> make_is09_schemas()
+        static std::map<web::uri, const char*> make_is09_schemas()
         {
             using namespace nmos::is09_schemas;
 
             return
             {
+#if !defined(NMOS_CPP_EXCLUDE_IS09_V1_0)
                 // v1.0
                 { make_schema_uri(v1_0::tag, _XPLATSTR("global.json")), make_schema(v1_0::global) },
                 { make_schema_uri(v1_0::tag, _XPLATSTR("resource_core.json")), make_schema(v1_0::resource_core) }
+#endif
             };
         }
 
-        inline void merge(std::map<web::uri, web::json::value>& to, std::map<web::uri, web::json::value>&& from)
+        inline void merge(std::map<web::uri, const char*>& to, std::map<web::uri, const char*>&& from)
         {
             to.insert(from.begin(), from.end()); // std::map::merge in C++17
         }
 
-        static std::map<web::uri, web::json::value> make_schemas()
+        static std::map<web::uri, const char*> make_schemas()
         {
             auto result = make_is04_schemas();
             merge(result, make_is05_schemas());
@@ -284,7 +301,10 @@ namespace nmos
             return result;
         }
 
-        static std::map<web::uri, web::json::value> schemas = make_schemas();
+        static const std::map<web::uri, const char*> schemas = make_schemas();
+
+        static std::mutex parsed_schemas_mutex;
+        static std::map<web::uri, web::json::value> parsed_schemas;
     }
 
     namespace experimental
@@ -302,6 +322,17 @@ namespace nmos
             return is04_schemas::v1_0::registrationapi_resource_post_request_uri;
         }
 
+        web::uri make_registrationapi_resource_post_request_data_schema_uri(const nmos::api_version& version, const nmos::type& type)
+        {
+            // e.g. "node.json", "device.json", etc. in each version
+            const auto& tag
+                = is04_versions::v1_3 <= version ? is04_schemas::v1_3::tag
+                : is04_versions::v1_2 <= version ? is04_schemas::v1_2::tag
+                : is04_versions::v1_1 <= version ? is04_schemas::v1_1::tag
+                : is04_schemas::v1_0::tag;
+            return is04_schemas::make_schema_uri(tag, type.name + _XPLATSTR(".json"));
+        }
+
         web::uri make_queryapi_subscriptions_post_request_schema_uri(const nmos::api_version& version)
         {
             if (is04_versions::v1_3 <= version) return is04_schemas::v1_3::queryapi_subscriptions_post_request_uri;
@@ -331,6 +362,11 @@ namespace nmos
         // load the json schema for the specified base URI
         web::json::value load_json_schema(const web::uri& id)
         {
+            std::lock_guard<std::mutex> lock(nmos::details::parsed_schemas_mutex);
+
+            auto parsed = nmos::details::parsed_schemas.find(id);
+            if (nmos::details::parsed_schemas.end() != parsed) return parsed->second;
+
             auto found = nmos::details::schemas.find(id);
 
             if (nmos::details::schemas.end() == found)
@@ -338,7 +374,7 @@ namespace nmos
                 throw web::json::json_exception((_XPLATSTR("schema not found for ") + id.to_string()).c_str());
             }
 
-            return found->second;
+            return nmos::details::parsed_schemas.insert({ id, web::json::value::parse(utility::s2us(found->second)) }).first->second;
         }
     }
 }
@@ -14,6 +14,9 @@ namespace nmos
         web::uri make_systemapi_global_schema_uri(const nmos::api_version& version);
 
         web::uri make_registrationapi_resource_post_request_schema_uri(const nmos::api_version& version);
+        // the schema for the "data" of a Registration API resource POST request of the specified type, which can be used to validate the resource
+        // data directly rather than evaluating each alternative of the full request schema
+        web::uri make_registrationapi_resource_post_request_data_schema_uri(const nmos::api_version& version, const nmos::type& type);
         web::uri make_queryapi_subscriptions_post_request_schema_uri(const nmos::api_version& version);
 
         web::uri make_nodeapi_receiver_target_put_request_schema_uri(const nmos::api_version& version);
@@ -0,0 +1,180 @@
+#include "nmos/log_filebuf.h"
+
+#include <cstdio>
+
+namespace nmos
+{
+    namespace experimental
+    {
+        log_filebuf::log_filebuf()
+            : buffer(4096)
+            , flush_interval()
+            , rotation_size(0)
+            , rotation_count(0)
+            , buffer_limit(0)
+            , file_size(0)
+            , discarded(0)
+            , stopping(true)
+        {
+            setp(buffer.data(), buffer.data() + buffer.size());
+        }
+
+        log_filebuf::~log_filebuf()
+        {
+            close();
+        }
+
+        bool log_filebuf::open(const std::string& filename_, std::chrono::milliseconds flush_interval_, std::size_t rotation_size_, std::size_t rotation_count_, std::size_t buffer_limit_)
+        {
+            close();
+
+            file.open(filename_, std::ios_base::out | std::ios_base::app);
+            if (!file.is_open()) return false;
+            file.seekp(0, std::ios_base::end);
+            const auto pos = file.tellp();
+            file_size = std::streampos(-1) != pos ? (std::size_t)pos : 0;
+
+            filename = filename_;
+            flush_interval = flush_interval_;
+            rotation_size = rotation_size_;
+            rotation_count = rotation_count_;
+            buffer_limit = buffer_limit_;
+            {
+                std::lock_guard<std::mutex> lock(mutex);
+                stopping = false;
+            }
+
+            thread = std::thread([this] { run(); });
+            return true;
+        }
+
+        bool log_filebuf::is_open() const
+        {
+            return thread.joinable();
+        }
+
+        void log_filebuf::close()
+        {
+            if (!is_open()) return;
+
+            hand_over();
+            {
+                std::lock_guard<std::mutex> lock(mutex);
+                stopping = true;
+            }
+            condition.notify_all();
+            thread.join();
+
+            file.close();
+        }
+
+        log_filebuf::int_type log_filebuf::overflow(int_type c)
+        {
+            hand_over();
+            if (!traits_type::eq_int_type(c, traits_type::eof()))
+            {
+                *pptr() = traits_type::to_char_type(c);
+                pbump(1);
+            }
+            return traits_type::not_eof(c);
+        }
+
+        int log_filebuf::sync()
+        {
+            // rather than writing to disk, just hand the output over to the background thread
+            hand_over();
+            if (flush_interval == std::chrono::milliseconds::zero()) condition.notify_all();
+            return 0;
+        }
+
+        void log_filebuf::hand_over()
+        {
+            const auto count = (std::size_t)(pptr() - pbase());
+            if (0 == count) return;
+
+            {
+                std::lock_guard<std::mutex> lock(mutex);
+                if (!stopping && pending.size() + count <= buffer_limit)
+                {
+                    pending.append(pbase(), count);
+                }
+                else
+                {
+                    discarded += count;
+                }
+            }
+            setp(buffer.data(), buffer.data() + buffer.size());
+        }
+
+        void log_filebuf::run()
+        {
+            std::unique_lock<std::mutex> lock(mutex);
+            for (;;)
+            {
+                if (flush_interval == std::chrono::milliseconds::zero())
+                {
+                    condition.wait(lock, [&] { return stopping || !pending.empty(); });
+                }
+                else
+                {
+                    // write early if the pending output is getting close to the limit
+                    condition.wait_for(lock, flush_interval, [&] { return stopping || pending.size() >= buffer_limit / 2; });
+                }
+
+                if (pending.empty() && 0 == discarded)
+                {
+                    if (stopping) break;
+                    continue;
+                }
+
+                std::string batch;
+                batch.swap(pending);
+                const auto batch_discarded = discarded;
+                discarded = 0;
+
+                lock.unlock();
+                if (0 != batch_discarded)
+                {
+                    batch.append("log output discarded: " + std::to_string(batch_discarded) + " bytes\n");
+                }
+                write(batch);
+                lock.lock();
+            }
+        }
+
+        void log_filebuf::write(const std::string& batch)
+        {
+            file.write(batch.data(), batch.size());
+            file.flush();
+            file_size += batch.size();
+
+            if (0 != rotation_size && file_size >= rotation_size)
+            {
+                rotate();
+            }
+        }
+
+        void log_filebuf::rotate()
+        {
+            file.close();
+
+            // e.g. remove "error.log.5", rename "error.log.4" to "error.log.5", ..., "error.log" to "error.log.1"
+            std::remove((filename + "." + std::to_string(rotation_count)).c_str());
+            for (auto i = rotation_count; i > 1; --i)
+            {
+                std::rename((filename + "." + std::to_string(i - 1)).c_str(), (filename + "." + std::to_string(i)).c_str());
+            }
+            if (0 != rotation_count)
+            {
+                std::rename(filename.c_str(), (filename + ".1").c_str());
+            }
+            else
+            {
+                std::remove(filename.c_str());
+            }
+
+            file.open(filename, std::ios_base::out | std::ios_base::app);
+            file_size = 0;
+        }
+    }
+}
@@ -0,0 +1,76 @@
+#ifndef NMOS_LOG_FILEBUF_H
+#define NMOS_LOG_FILEBUF_H
+
+#include <chrono>
+#include <condition_variable>
+#include <fstream>
+#include <mutex>
+#include <streambuf>
+#include <string>
+#include <thread>
+#include <vector>
+
+// This is an experimental extension to write log files without blocking the logging thread on disk
+namespace nmos
+{
+    namespace experimental
+    {
+        // a stream buffer for log files, which hands output to a background thread to be written in batches
+        // rather than writing and flushing the file on every std::endl, and rotates the file when it exceeds a maximum size
+        // output which exceeds the buffer limit while the background thread is still writing is discarded
+        // see nmos::experimental::log_gate
+        class log_filebuf : public std::streambuf
+        {
+        public:
+            log_filebuf();
+            virtual ~log_filebuf();
+
+            // open the specified file for appending, returning false on failure
+            // flush_interval is how long output may be held in memory before it is written, or zero to write it as soon as possible
+            // when rotation_size is non-zero, the file is renamed with the suffix ".1" when it reaches that size in bytes, keeping rotation_count
+            // previous files, e.g. ".1" to ".5"
+            bool open(const std::string& filename, std::chrono::milliseconds flush_interval = {}, std::size_t rotation_size = 0, std::size_t rotation_count = 5, std::size_t buffer_limit = 16 * 1024 * 1024);
+            bool is_open() const;
+
+            // write any remaining output and close the file
+            void close();
+
+            log_filebuf(const log_filebuf&) = delete;
+            log_filebuf& operator=(const log_filebuf&) = delete;
+
+        protected:
+            virtual int_type overflow(int_type c);
+            virtual int sync();
+
+        private:
+            // move the output in the put area into the pending output for the background thread
+            void hand_over();
+
+            void run();
+            void write(const std::string& batch);
+            void rotate();
+
+            std::vector<char> buffer;
+
+            std::string filename;
+            std::chrono::milliseconds flush_interval;
+            std::size_t rotation_size;
+            std::size_t rotation_count;
+            std::size_t buffer_limit;
+
+            // only accessed by the background thread while the file is open
+            std::ofstream file;
+            std::size_t file_size;
+
+            std::mutex mutex;
+            std::condition_variable condition;
+            std::string pending;
+            std::size_t discarded;
+            bool stopping;
+
+            std::thread thread;
+        };
+    }
+}
+
+#endif
@@ -7,6 +7,7 @@
 #include <boost/algorithm/string/find_format.hpp>
 #include <boost/algorithm/string/finder.hpp>
 #include <boost/algorithm/string/formatter.hpp>
+#include "nmos/binary_log.h"
 #include "nmos/log_model.h"
 #include "nmos/slog.h"
 
@@ -41,20 +42,30 @@ namespace nmos
         }
 
         // An example logging gateway
-        class log_gate : public slog::base_gate
+        class log_gate : public nmos::details::category_gate
         {
         public:
             log_gate(std::ostream& error_log, std::ostream& access_log, nmos::experimental::log_model& model)
-                : error_log(error_log), access_log(access_log), model(model), async_service({ *this }) {}
+                : error_log(error_log), access_log(access_log), model(model), binary(nullptr), async_service({ *this }) {}
+            // messages are also recorded in the binary log, if it is open, which may have a more verbose logging level
+            log_gate(std::ostream& error_log, std::ostream& access_log, nmos::experimental::log_model& model, nmos::experimental::binary_log& binary)
+                : error_log(error_log), access_log(access_log), model(model), binary(&binary), async_service({ *this }) {}
             virtual ~log_gate() {}
 
-            virtual bool pertinent(slog::severity level) const { return model.level <= level; }
+            virtual bool pertinent(slog::severity level) const { return model.level <= level || (nullptr != binary && binary->pertinent(level)); }
             virtual void log(const slog::log_message& message) const { async_service(message); }
 
+            virtual const std::atomic<slog::severity>* category_level(const nmos::category& category) const
+            {
+                auto lock = model.write_lock();
+                return &nmos::experimental::insert_category_level(model, category);
+            }
+
         private:
             std::ostream& error_log;
             std::ostream& access_log;
             nmos::experimental::log_model& model;
+            nmos::experimental::binary_log* binary;
             nmos::id_generator generate_id;
 
             struct service_function
@@ -70,17 +81,27 @@ namespace nmos
 
             void service(const slog::async_log_message& message)
             {
-                auto lock = model.write_lock();
-                if (pertinent(message.level()))
+                // a read lock is enough to prevent the log streams being reconfigured while they are written
+                // since only the log service writes to them, and the log record is pushed without the lock
+                auto lock = model.read_lock();
+                auto categories = nmos::get_categories_stash(message.stream());
+                if (nmos::experimental::pertinent(model, message.level(), categories))
                 {
                     error_log << details::error_log_format(message);
                 }
-                auto categories = nmos::get_categories_stash(message.stream());
                 if (categories.end() != std::find(categories.begin(), categories.end(), nmos::categories::access))
                 {
                     access_log << nmos::common_log_format(message);
                 }
-                nmos::experimental::insert_log_event(model.events, message, generate_id(), nmos::experimental::fields::logging_limit(model.settings));
+                if (nullptr != binary && binary->pertinent(message.level()))
+                {
+                    binary->write(message, categories);
+                }
+                // messages which are only pertinent to the binary log aren't formatted as JSON for the Logging API
+                if (model.level <= message.level())
+                {
+                    nmos::experimental::push_log_record(model.records, message, generate_id());
+                }
             }
 
             mutable slog::async_log_service<service_function> async_service;
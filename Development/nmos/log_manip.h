@@ -30,18 +30,18 @@ namespace nmos
     {
         return slog::log_manip([&](slog::log_statement& s)
         {
-            auto& by_type = resources.get<tags::type>();
-            s << by_type.count(true) << " resources ("
-                << by_type.count(details::has_data(types::node)) << " nodes, "
-                << by_type.count(details::has_data(types::device)) << " devices, "
-                << by_type.count(details::has_data(types::source)) << " sources, "
-                << by_type.count(details::has_data(types::flow)) << " flows, "
-                << by_type.count(details::has_data(types::sender)) << " senders, "
-                << by_type.count(details::has_data(types::receiver)) << " receivers, "
-                << by_type.count(details::has_data(types::subscription)) << " subscriptions, "
-                << by_type.count(details::has_data(types::grain)) << " grains), "
+            // the maintained resource counts are used rather than counting the resources of each type in the type index
+            s << count_resources(resources) << " resources ("
+                << count_resources(resources, types::node) << " nodes, "
+                << count_resources(resources, types::device) << " devices, "
+                << count_resources(resources, types::source) << " sources, "
+                << count_resources(resources, types::flow) << " flows, "
+                << count_resources(resources, types::sender) << " senders, "
+                << count_resources(resources, types::receiver) << " receivers, "
+                << count_resources(resources, types::subscription) << " subscriptions, "
+                << count_resources(resources, types::grain) << " grains), "
                 << "most recent update: " << make_version(most_recent_update(resources)) << ", least health: " << least_health(resources).first << ", "
-                << by_type.count(false) << " non-extant resources";
+                << count_non_extant_resources(resources) << " non-extant resources";
         });
     }
 }
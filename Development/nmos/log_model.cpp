@@ -1,5 +1,8 @@
 #include "nmos/log_model.h"
 
+#include <algorithm>
+#include <tuple>
+#include <vector>
 #include <boost/range/adaptor/transformed.hpp>
 #include "nmos/api_utils.h"
 #include "nmos/query_utils.h"
@@ -49,8 +52,96 @@ namespace nmos
             }
         }
 
+        namespace details
+        {
+            inline std::size_t ceil_power_of_two(std::size_t value)
+            {
+                std::size_t result = 1;
+                while (result < value) result <<= 1;
+                return result;
+            }
+
+            log_record_ring::log_record_ring(std::size_t capacity)
+                : mask(ceil_power_of_two((std::max)(std::size_t(2), capacity)) - 1)
+                , cells(new cell[mask + 1])
+                , enqueue_pos(0)
+                , dequeue_pos(0)
+            {
+                for (std::size_t i = 0; i <= mask; ++i)
+                {
+                    cells[i].sequence.store(i, std::memory_order_relaxed);
+                }
+            }
+
+            void log_record_ring::push(std::unique_ptr<log_record> record)
+            {
+                while (!try_push(record))
+                {
+                    pop();
+                }
+            }
+
+            bool log_record_ring::try_push(std::unique_ptr<log_record>& record)
+            {
+                auto pos = enqueue_pos.load(std::memory_order_relaxed);
+                for (;;)
+                {
+                    auto& cell = cells[pos & mask];
+                    const auto sequence = cell.sequence.load(std::memory_order_acquire);
+                    const auto diff = (std::ptrdiff_t)sequence - (std::ptrdiff_t)pos;
+                    if (0 == diff)
+                    {
+                        if (enqueue_pos.compare_exchange_weak(pos, pos + 1, std::memory_order_relaxed))
+                        {
+                            cell.record = std::move(record);
+                            cell.sequence.store(pos + 1, std::memory_order_release);
+                            return true;
+                        }
+                    }
+                    else if (diff < 0)
+                    {
+                        // full
+                        return false;
+                    }
+                    else
+                    {
+                        pos = enqueue_pos.load(std::memory_order_relaxed);
+                    }
+                }
+            }
+
+            std::unique_ptr<log_record> log_record_ring::pop()
+            {
+                auto pos = dequeue_pos.load(std::memory_order_relaxed);
+                for (;;)
+                {
+                    auto& cell = cells[pos & mask];
+                    const auto sequence = cell.sequence.load(std::memory_order_acquire);
+                    const auto diff = (std::ptrdiff_t)sequence - (std::ptrdiff_t)(pos + 1);
+                    if (0 == diff)
+                    {
+                        if (dequeue_pos.compare_exchange_weak(pos, pos + 1, std::memory_order_relaxed))
+                        {
+                            auto record = std::move(cell.record);
+                            cell.sequence.store(pos + mask + 1, std::memory_order_release);
+                            return record;
+                        }
+                    }
+                    else if (diff < 0)
+                    {
+                        // empty
+                        return{};
+                    }
+                    else
+                    {
+                        pos = dequeue_pos.load(std::memory_order_relaxed);
+                    }
+                }
+            }
+        }
+
         // logically necessary, practically not!
-        inline tai strictly_increasing_cursor(const log_events& events, tai cursor = tai_now())
+        inline tai strictly_increasing_cursor(const log_events& events, tai cursor = tai_coarse_now())
         {
             const auto most_recent = events.empty() ? tai{} : events.front().cursor;
             return cursor > most_recent ? cursor : tai_from_time_point(time_point_from_tai(most_recent) + tai_clock::duration(1));
@@ -70,5 +161,85 @@ namespace nmos
             }
             events.push_front({ details::json_from_message(message, id), strictly_increasing_cursor(events) });
         }
+
+        void push_log_record(details::log_record_ring& records, const slog::async_log_message& message, const id& id)
+        {
+            records.push(std::unique_ptr<details::log_record>(new details::log_record{ message, id, tai_coarse_now() }));
+        }
+
+        void insert_log_records(log_events& events, details::log_record_ring& records, std::size_t max_size)
+        {
+            std::vector<std::unique_ptr<details::log_record>> pending;
+            while (auto record = records.pop())
+            {
+                pending.push_back(std::move(record));
+            }
+
+            if (0 == max_size)
+            {
+                events.clear();
+                return;
+            }
+
+            // records which would immediately be discarded again need not be formatted at all
+            const auto first = pending.size() > max_size ? pending.size() - max_size : 0;
+            for (auto record = pending.begin() + first; pending.end() != record; ++record)
+            {
+                while (events.size() >= max_size)
+                {
+                    events.pop_back();
+                }
+                events.push_front({ details::json_from_message((*record)->message, (*record)->id), strictly_increasing_cursor(events, (*record)->cursor) });
+            }
+        }
+
+        std::atomic<slog::severity>& insert_category_level(log_model& model, const std::string& category)
+        {
+            auto found = model.category_levels.find(category);
+            if (model.category_levels.end() == found)
+            {
+                found = model.category_levels.emplace(std::piecewise_construct, std::forward_as_tuple(category), std::forward_as_tuple(nmos::details::no_category_level)).first;
+            }
+            return found->second;
+        }
+
+        void update_category_levels(log_model& model)
+        {
+            model.level = nmos::fields::logging_level(model.settings);
+
+            const auto& logging_categories = nmos::experimental::fields::logging_categories(model.settings);
+
+            // categories which are no longer specified revert to the logging level
+            for (auto& category_level : model.category_levels)
+            {
+                if (!logging_categories.has_field(utility::s2us(category_level.first)))
+                {
+                    category_level.second = nmos::details::no_category_level;
+                }
+            }
+
+            if (logging_categories.is_object())
+            {
+                for (const auto& category_level : logging_categories.as_object())
+                {
+                    insert_category_level(model, utility::us2s(category_level.first)) = category_level.second.as_integer();
+                }
+            }
+        }
+
+        bool pertinent(const log_model& model, slog::severity level, const std::list<std::string>& categories)
+        {
+            // when a message has several categories with per-category logging levels, the most verbose applies
+            auto threshold = nmos::details::no_category_level;
+            for (const auto& category : categories)
+            {
+                const auto found = model.category_levels.find(category);
+                if (model.category_levels.end() == found) continue;
+                const slog::severity category_level = found->second;
+                if (nmos::details::no_category_level == category_level) continue;
+                if (nmos::details::no_category_level == threshold || category_level < threshold) threshold = category_level;
+            }
+            return (nmos::details::no_category_level != threshold ? threshold : (slog::severity)model.level) <= level;
+        }
     }
 }
@@ -2,9 +2,15 @@
 #define NMOS_LOG_MODEL_H
 
 #include <atomic>
+#include <list>
+#include <map>
+#include <memory>
+#include <vector>
 #include <boost/multi_index_container.hpp>
+#include <boost/multi_index/composite_key.hpp>
 #include <boost/multi_index/hashed_index.hpp>
 #include <boost/multi_index/member.hpp>
+#include <boost/multi_index/ordered_index.hpp>
 #include <boost/multi_index/sequenced_index.hpp>
 #include "nmos/id.h"
 #include "nmos/json_fields.h" // only for nmos::fields::id
@@ -17,10 +23,37 @@ namespace nmos
 {
     namespace experimental
     {
+        namespace details
+        {
+            inline int extract_level(const web::json::value& data)
+            {
+                return data.has_field(U("level")) && data.at(U("level")).is_integer() ? data.at(U("level")).as_integer() : 0;
+            }
+
+            inline std::vector<utility::string_t> extract_categories(const web::json::value& data)
+            {
+                std::vector<utility::string_t> categories;
+                if (data.has_field(U("tags")) && data.at(U("tags")).has_field(U("category")))
+                {
+                    for (const auto& category : data.at(U("tags")).at(U("category")).as_array())
+                    {
+                        categories.push_back(category.as_string());
+                    }
+                }
+                return categories;
+            }
+        }
+
         // Log events just consist of their json data, plus some API metadata
         struct log_event
         {
-            log_event(web::json::value data, const nmos::tai& cursor) : data(std::move(data)), id(nmos::fields::id(this->data)), cursor(cursor) {}
+            log_event(web::json::value data, const nmos::tai& cursor)
+                : data(std::move(data))
+                , id(nmos::fields::id(this->data))
+                , cursor(cursor)
+                , level(details::extract_level(this->data))
+                , categories(details::extract_categories(this->data))
+            {}
 
             // event data
             web::json::value data;
@@ -30,28 +63,84 @@ namespace nmos
 
             // unique cursor, just to allow the API to provide paginated access to events
             nmos::tai cursor;
+
+            // level and categories, extracted from the event data to allow the API to match events without the json data
+            int level;
+            std::vector<utility::string_t> categories;
         };
 
         namespace tags
         {
             struct id;
             struct sequenced;
+            struct cursor;
+            struct level;
         }
 
         namespace details
         {
             typedef boost::multi_index::member<log_event, id, &log_event::id> log_event_id_extractor;
-            // could use an ordered_unique index on cursor, rather than the sequenced index?
+            typedef boost::multi_index::member<log_event, nmos::tai, &log_event::cursor> log_event_cursor_extractor;
+            typedef boost::multi_index::member<log_event, int, &log_event::level> log_event_level_extractor;
+
+            // the ordered indices on cursor are most recent first, like the sequenced index, so that each level is a contiguous sub-range in the same order
+            typedef boost::multi_index::composite_key<log_event, log_event_level_extractor, log_event_cursor_extractor> log_event_level_cursor_extractor;
+            typedef boost::multi_index::composite_key_compare<std::less<int>, std::greater<nmos::tai>> log_event_level_cursor_compare;
         }
 
         typedef boost::multi_index_container<
             log_event,
             boost::multi_index::indexed_by<
                 boost::multi_index::sequenced<boost::multi_index::tag<tags::sequenced>>,
-                boost::multi_index::hashed_unique<boost::multi_index::tag<tags::id>, details::log_event_id_extractor>
+                boost::multi_index::hashed_unique<boost::multi_index::tag<tags::id>, details::log_event_id_extractor>,
+                boost::multi_index::ordered_unique<boost::multi_index::tag<tags::cursor>, details::log_event_cursor_extractor, std::greater<nmos::tai>>,
+                boost::multi_index::ordered_non_unique<boost::multi_index::tag<tags::level>, details::log_event_level_cursor_extractor, details::log_event_level_cursor_compare>
             >
         > log_events;
 
+        namespace details
+        {
+            // a raw log message, which is only formatted as a log event when the events are read
+            struct log_record
+            {
+                slog::async_log_message message;
+                nmos::id id;
+                nmos::tai cursor;
+            };
+
+            // a fixed-capacity lock-free queue of log records, which may be pushed and popped by several threads concurrently
+            // (based on Dmitry Vyukov's bounded multi-producer multi-consumer queue)
+            class log_record_ring
+            {
+            public:
+                // capacity is rounded up to a power of two
+                explicit log_record_ring(std::size_t capacity = 4096);
+
+                log_record_ring(const log_record_ring&) = delete;
+                log_record_ring& operator=(const log_record_ring&) = delete;
+
+                // push a record, discarding the oldest one if the ring is full
+                void push(std::unique_ptr<log_record> record);
+
+                // pop the oldest record, or return nullptr if the ring is empty
+                std::unique_ptr<log_record> pop();
+
+            private:
+                bool try_push(std::unique_ptr<log_record>& record);
+
+                struct cell
+                {
+                    std::atomic<std::size_t> sequence;
+                    std::unique_ptr<log_record> record;
+                };
+
+                const std::size_t mask;
+                std::unique_ptr<cell[]> cells;
+                std::atomic<std::size_t> enqueue_pos;
+                std::atomic<std::size_t> dequeue_pos;
+            };
+        }
+
         struct log_model
         {
             // mutex to be used to protect the members of the model from simultaneous access by multiple threads
@@ -64,17 +153,60 @@ namespace nmos
             // that can be read by logging statements without locking the mutex protecting the settings
             std::atomic<slog::severity> level{ nmos::fields::logging_level.default_value };
 
+            // per-category logging levels, which override the logging level for log messages in those categories
+            // entries are only added (with the mutex locked) and never removed, so that logging statements can read the atomic value without
+            // locking the mutex; see nmos::experimental::update_category_levels and nmos::experimental::insert_category_level
+            std::map<std::string, std::atomic<slog::severity>> category_levels;
+
             // log events themselves
             nmos::experimental::log_events events;
 
+            // log messages which have not yet been formatted and inserted into the log events
+            // these can be pushed without locking the mutex, so that logging is cheap, and are only formatted when the log events are read
+            // see nmos::experimental::push_log_record and nmos::experimental::insert_log_records
+            details::log_record_ring records;
+
+            // condition to be used to wait until, and notify other threads when, shutdown is initiated by setting the shutdown flag
+            // e.g. by nmos::experimental::send_logging_ws_events_thread
+            mutable nmos::condition_variable shutdown_condition;
+
+            // flag indicating whether shutdown has been initiated
+            bool shutdown = false;
+
             // convenience functions
 
-            nmos::read_lock read_lock() const { return nmos::read_lock{ mutex }; }
-            nmos::write_lock write_lock() const { return nmos::write_lock{ mutex }; }
+            nmos::read_lock read_lock(const nmos::lock_site& site = nmos::lock_site::current()) const { return nmos::make_read_lock(mutex, site); }
+            nmos::write_lock write_lock(const nmos::lock_site& site = nmos::lock_site::current()) const { return nmos::make_write_lock(mutex, site); }
+
+            void controlled_shutdown()
+            {
+                {
+                    auto lock = write_lock();
+                    shutdown = true;
+                }
+                shutdown_condition.notify_all();
+            }
         };
 
         // push a log event into the model keeping a maximum size (lock the mutex before calling this)
         void insert_log_event(log_events& events, const slog::async_log_message& message, const id& id, std::size_t max_size = 1234);
+
+        // return the logging level for the specified category, adding an entry with no per-category logging level if necessary (lock the mutex before calling this)
+        std::atomic<slog::severity>& insert_category_level(log_model& model, const std::string& category);
+
+        // update the logging level and per-category logging levels from the settings (lock the mutex before calling this)
+        void update_category_levels(log_model& model);
+
+        // determine whether a log message with the specified level and categories is pertinent, taking account of the per-category logging levels
+        // (lock the mutex before calling this)
+        bool pertinent(const log_model& model, slog::severity level, const std::list<std::string>& categories);
+
+        // push a log message into the ring of records to be inserted as log events later (there is no need to lock the mutex)
+        // if the ring is full, the oldest record is discarded
+        void push_log_record(details::log_record_ring& records, const slog::async_log_message& message, const id& id);
+
+        // insert the pushed log records as log events keeping a maximum size (lock the mutex before calling this)
+        void insert_log_records(log_events& events, details::log_record_ring& records, std::size_t max_size = 1234);
     }
 }
 
@@ -1,9 +1,13 @@
 #include "nmos/logging_api.h"
 
+#include <algorithm>
+#include <boost/algorithm/string/find.hpp>
 #include <boost/range/adaptor/transformed.hpp>
+#include "cpprest/json_utils.h" // for web::json::experimental::serialize_utf8
 #include "nmos/api_utils.h"
 #include "nmos/query_utils.h"
 #include "nmos/slog.h"
+#include "nmos/thread_utils.h" // for nmos::details::reverse_lock_guard and nmos::details::wait_for
 #include "rql/rql.h"
 
 namespace nmos
@@ -57,15 +61,29 @@ namespace nmos
 
             result_type operator()(argument_type event) const;
 
-            // the query/exemplar object for a Basic Query
+            // the query/exemplar object for a Basic Query, without the level and category which are matched separately
             web::json::value basic_query;
 
+            // the level for a Basic Query, which can be matched using the ordered index on level and cursor
+            bool level_specified;
+            int level;
+
+            // the category for a Basic Query, which is matched against the extracted categories rather than the json data
+            bool category_specified;
+            utility::string_t category;
+
             // a representation of the RQL abstract syntax tree for an Advanced Query
             web::json::value rql_query;
+
+            // the Basic Query compiled once, rather than being interpreted for every event
+            web::json::compiled_match_query compiled_basic_query;
         };
 
         log_event_query::log_event_query(const web::json::value& flat_query_params)
             : basic_query(web::json::unflatten(flat_query_params))
+            , level_specified(false)
+            , level(0)
+            , category_specified(false)
         {
             if (basic_query.has_field(U("paging")))
             {
@@ -88,11 +106,41 @@ namespace nmos
                 }
                 basic_query.erase(U("query"));
             }
+            if (basic_query.has_field(U("level")) && basic_query.at(U("level")).is_string())
+            {
+                // like web::json::match_query, treat the query string as serialized json
+                std::error_code ec;
+                const auto parsed_level = web::json::value::parse(basic_query.at(U("level")).as_string(), ec);
+                if (!ec && parsed_level.is_integer())
+                {
+                    level_specified = true;
+                    level = parsed_level.as_integer();
+                    basic_query.erase(U("level"));
+                }
+            }
+            if (basic_query.has_field(U("tags")) && basic_query.at(U("tags")).has_field(U("category")) && basic_query.at(U("tags")).at(U("category")).is_string())
+            {
+                category_specified = true;
+                category = basic_query.at(U("tags")).at(U("category")).as_string();
+                auto& tags = basic_query.at(U("tags"));
+                tags.erase(U("category"));
+                if (0 == tags.size()) basic_query.erase(U("tags"));
+            }
+            if (0 != basic_query.size())
+            {
+                compiled_basic_query = web::json::compiled_match_query(basic_query, web::json::match_icase | web::json::match_substr);
+            }
         }
 
         log_event_query::result_type log_event_query::operator()(argument_type event) const
         {
-            return web::json::match_query(event.data, basic_query, web::json::match_icase | web::json::match_substr)
+            // one of the event's categories must contain the query category as a case-insensitive substring, as for web::json::match_query
+            return (!level_specified || level == event.level)
+                && (!category_specified || event.categories.end() != std::find_if(event.categories.begin(), event.categories.end(), [&](const utility::string_t& c)
+                {
+                    return (bool)boost::algorithm::ifind_first(c, category);
+                }))
+                && compiled_basic_query(event.data)
                 && match_logging_rql(event.data, rql_query);
         }
 
@@ -117,8 +165,9 @@ namespace nmos
             // where a resulting data set is constrained by the server's value of 'limit'
             bool since_specified;
 
-            template <typename Predicate>
-            boost::any_range<const nmos::experimental::log_event, boost::bidirectional_traversal_tag, const nmos::experimental::log_event&, std::ptrdiff_t> page(const nmos::experimental::log_events& events, Predicate match)
+            // the events may be a log_events container, or a sub-range such as log_events_level_range
+            template <typename Range, typename Predicate>
+            boost::any_range<const nmos::experimental::log_event, boost::bidirectional_traversal_tag, const nmos::experimental::log_event&, std::ptrdiff_t> page(const Range& events, Predicate match)
             {
                 return paging::cursor_based_page(events, match, until, since, limit, !since_specified);
             }
@@ -190,10 +239,33 @@ namespace nmos
 
         inline nmos::experimental::log_events::const_iterator lower_bound(const nmos::experimental::log_events& index, const nmos::tai& cursor)
         {
-            return std::lower_bound(index.begin(), index.end(), cursor, [](const nmos::experimental::log_event& event, const nmos::tai& cursor)
-            {
-                return event.cursor > cursor;
-            });
+            // seek using the ordered index on cursor, which is in the same order as the sequenced index
+            return index.project<tags::sequenced>(index.get<tags::cursor>().lower_bound(cursor));
+        }
+
+        // the events with the specified level, most recent first
+        typedef nmos::experimental::log_events::index<tags::level>::type log_events_level_index;
+
+        struct log_events_level_range : boost::iterator_range<log_events_level_index::const_iterator>
+        {
+            log_events_level_range(const nmos::experimental::log_events& events, int level)
+                : boost::iterator_range<log_events_level_index::const_iterator>(boost::make_iterator_range(events.get<tags::level>().equal_range(boost::make_tuple(level))))
+                , index(&events.get<tags::level>())
+                , level(level)
+            {}
+
+            const log_events_level_index* index;
+            int level;
+        };
+
+        inline nmos::tai extract_cursor(const log_events_level_range&, log_events_level_index::const_iterator it)
+        {
+            return it->cursor;
+        }
+
+        inline log_events_level_index::const_iterator lower_bound(const log_events_level_range& range, const nmos::tai& cursor)
+        {
+            return range.index->lower_bound(boost::make_tuple(range.level, cursor));
         }
 
         namespace details
@@ -316,6 +388,16 @@ namespace nmos
             }
         }
 
+        namespace details
+        {
+            // format the log records which have been pushed since the log events were last read
+            void insert_log_records(nmos::experimental::log_model& model)
+            {
+                auto lock = model.write_lock();
+                nmos::experimental::insert_log_records(model.events, model.records, nmos::experimental::fields::logging_limit(model.settings));
+            }
+        }
+
         web::http::experimental::listener::api_router make_unmounted_logging_api(nmos::experimental::log_model& model, slog::base_gate& gate_)
         {
             using namespace web::http::experimental::listener::api_router_using_declarations;
@@ -331,6 +413,7 @@ namespace nmos
             logging_api.support(U("/events/?"), methods::GET, [&model, &gate_](http_request req, http_response res, const string_t&, const route_parameters& parameters)
             {
                 nmos::api_gate gate(gate_, req, parameters);
+                details::insert_log_records(model);
                 auto lock = model.read_lock();
 
                 // Extract and decode the query string
@@ -350,7 +433,10 @@ namespace nmos
                 {
                     // Get the payload and update the paging parameters
                     struct default_constructible_event_query_wrapper { const log_event_query* impl; bool operator()(const log_event& e) const { return (*impl)(e); } };
-                    auto page = paging.page(model.events, default_constructible_event_query_wrapper{ &match });
+                    // when a level is specified, only the events with that level need to be considered
+                    auto page = match.level_specified
+                        ? paging.page(log_events_level_range(model.events, match.level), default_constructible_event_query_wrapper{ &match })
+                        : paging.page(model.events, default_constructible_event_query_wrapper{ &match });
 
                     size_t count = 0;
 
@@ -377,7 +463,7 @@ namespace nmos
 
                 if (req.request_uri().query().empty())
                 {
-                    model.events.clear();
+                    nmos::experimental::insert_log_records(model.events, model.records, 0);
                     set_reply(res, status_codes::NoContent);
                 }
                 else
@@ -390,6 +476,7 @@ namespace nmos
 
             logging_api.support(U("/events/") + nmos::patterns::resourceId.pattern + U("/?"), methods::GET, [&model](http_request, http_response res, const string_t&, const route_parameters& parameters)
             {
+                details::insert_log_records(model);
                 auto lock = model.read_lock();
 
                 const string_t eventId = parameters.at(nmos::patterns::resourceId.name);
@@ -410,5 +497,174 @@ namespace nmos
 
             return logging_api;
         }
+
+        namespace details
+        {
+            // the path of the Logging WebSocket API, e.g. "/log/v1.0/events?level=-40"
+            static bool is_logging_ws_path(const utility::string_t& ws_resource_path)
+            {
+                const auto ws_path = ws_resource_path.substr(0, ws_resource_path.find(U('?')));
+                return U("/log/v1.0/events") == ws_path || U("/log/v1.0/events/") == ws_path;
+            }
+
+            // the query to match for the websocket connection, from the same query parameters as the /log/v1.0/events endpoint (except paging)
+            // may throw e.g. for an unimplemented parameter or an invalid RQL query
+            static std::shared_ptr<const log_event_query> make_logging_ws_query(const utility::string_t& ws_resource_path)
+            {
+                const auto query = ws_resource_path.find(U('?'));
+                const auto flat_query_params = utility::string_t::npos != query
+                    ? parse_query_parameters(ws_resource_path.substr(query + 1))
+                    : web::json::value::object();
+                return std::make_shared<const log_event_query>(flat_query_params);
+            }
+        }
+
+        web::websockets::experimental::listener::validate_handler make_logging_ws_validate_handler(nmos::experimental::log_model& model, slog::base_gate& gate_)
+        {
+            // note, the log model lock isn't held while logging, since the log gate may need it
+            return [&gate_](const utility::string_t& ws_resource_path)
+            {
+                nmos::ws_api_gate gate(gate_, ws_resource_path);
+
+                slog::log<slog::severities::more_info>(gate, SLOG_FLF) << "Validating websocket connection to: " << ws_resource_path;
+
+                bool valid = details::is_logging_ws_path(ws_resource_path);
+                if (valid)
+                {
+                    try
+                    {
+                        details::make_logging_ws_query(ws_resource_path);
+                    }
+                    catch (const std::exception& e)
+                    {
+                        slog::log<slog::severities::error>(gate, SLOG_FLF) << "Invalid query for websocket connection to: " << ws_resource_path << ": " << e.what();
+                        valid = false;
+                    }
+                }
+
+                if (!valid) slog::log<slog::severities::error>(gate, SLOG_FLF) << "Invalid websocket connection to: " << ws_resource_path;
+                return valid;
+            };
+        }
+
+        web::websockets::experimental::listener::open_handler make_logging_ws_open_handler(nmos::experimental::log_model& model, logging_websockets& websockets, slog::base_gate& gate_)
+        {
+            return [&model, &websockets, &gate_](const utility::string_t& ws_resource_path, const web::websockets::experimental::listener::connection_id& connection_id)
+            {
+                nmos::ws_api_gate gate(gate_, ws_resource_path);
+
+                slog::log<slog::severities::info>(gate, SLOG_FLF) << "Opening websocket connection to: " << ws_resource_path;
+
+                // the query was already validated, so this isn't expected to throw
+                auto query = details::make_logging_ws_query(ws_resource_path);
+
+                // only the log events inserted from now on are sent, since the earlier ones can be fetched from the /log/v1.0/events endpoint
+                auto lock = model.write_lock();
+                websockets[connection_id] = std::move(query);
+            };
+        }
+
+        web::websockets::experimental::listener::close_handler make_logging_ws_close_handler(nmos::experimental::log_model& model, logging_websockets& websockets, slog::base_gate& gate_)
+        {
+            return [&model, &websockets, &gate_](const utility::string_t& ws_resource_path, const web::websockets::experimental::listener::connection_id& connection_id, web::websockets::websocket_close_status close_status, const utility::string_t& close_reason)
+            {
+                nmos::ws_api_gate gate(gate_, ws_resource_path);
+
+                slog::log<slog::severities::info>(gate, SLOG_FLF) << "Closing websocket connection to: " << ws_resource_path << " [" << (int)close_status << ": " << close_reason << "]";
+
+                auto lock = model.write_lock();
+                websockets.erase(connection_id);
+            };
+        }
+
+        void send_logging_ws_events_thread(web::websockets::experimental::listener::websocket_listener& listener, nmos::experimental::log_model& model, logging_websockets& websockets, slog::base_gate& gate_)
+        {
+            // construct the gate first, since that may need the log model lock
+            nmos::details::omanip_gate gate(gate_, nmos::categories::send_logging_ws_events);
+
+            auto lock = model.write_lock();
+
+            const auto interval = std::chrono::milliseconds((std::max)(1, nmos::experimental::fields::logging_ws_interval(model.settings)));
+
+            // the log events are sent from the most recent cursor at the previous interval
+            nmos::tai most_recent_cursor = model.events.empty() ? nmos::tai{} : model.events.front().cursor;
+
+            for (;;)
+            {
+                nmos::details::wait_for(model.shutdown_condition, lock, interval, [&] { return model.shutdown; });
+                if (model.shutdown) break;
+
+                if (websockets.empty())
+                {
+                    // no need to format the log records until they are read, but the cursor must be moved on
+                    // so that events inserted by the /log/v1.0/events endpoint meanwhile aren't sent to a later connection
+                    most_recent_cursor = model.events.empty() ? most_recent_cursor : (std::max)(most_recent_cursor, model.events.front().cursor);
+                    continue;
+                }
+
+                nmos::experimental::insert_log_records(model.events, model.records, nmos::experimental::fields::logging_limit(model.settings));
+
+                // the new log events, oldest first
+                std::vector<const log_event*> events;
+                for (const auto& event : model.events)
+                {
+                    if (event.cursor <= most_recent_cursor) break;
+                    events.push_back(&event);
+                }
+                if (events.empty()) continue;
+                std::reverse(events.begin(), events.end());
+                most_recent_cursor = events.back()->cursor;
+
+                // serialize each log event at most once, and only if it matches the query of any connection
+                std::vector<std::string> serialized(events.size());
+
+                std::vector<std::pair<web::websockets::experimental::listener::connection_id, web::websockets::websocket_outgoing_message>> outgoing_messages;
+                for (const auto& websocket : websockets)
+                {
+                    const auto& match = *websocket.second;
+
+                    std::string message;
+                    for (size_t index = 0; index < events.size(); ++index)
+                    {
+                        if (!match(*events[index])) continue;
+                        if (serialized[index].empty()) serialized[index] = web::json::experimental::serialize_utf8(events[index]->data);
+                        message.append(message.empty() ? "[" : ",").append(serialized[index]);
+                    }
+                    if (message.empty()) continue;
+                    message.append("]");
+
+                    web::websockets::websocket_outgoing_message outgoing_message;
+                    outgoing_message.set_utf8_message(std::move(message));
+                    outgoing_messages.push_back({ websocket.first, outgoing_message });
+                }
+
+                if (outgoing_messages.empty()) continue;
+
+                // send the messages without the lock on the log model, and without logging anything while it is held
+                nmos::details::reverse_lock_guard<nmos::write_lock> unlock{ lock };
+
+                // note, at this level, logging this doesn't itself produce more log events to send, unless the logging level is very verbose
+                slog::log<slog::severities::too_much_info>(gate, SLOG_FLF) << "Sending " << outgoing_messages.size() << " websocket messages";
+
+                for (auto& outgoing_message : outgoing_messages)
+                {
+                    // hmmm, no way to cancel this currently...
+                    auto send = listener.send(outgoing_message.first, outgoing_message.second).then([&](pplx::task<void> finally)
+                    {
+                        try
+                        {
+                            finally.get();
+                        }
+                        catch (const web::websockets::websocket_exception& e)
+                        {
+                            slog::log<slog::severities::error>(gate, SLOG_FLF) << "WebSocket error: " << e.what() << " [" << e.error_code() << "]";
+                        }
+                    });
+                    // current websocket_listener implementation is synchronous in any case, but just to make clear...
+                    // for now, wait for the message to be sent
+                    send.wait();
+                }
+            }
+        }
     }
 }
@@ -1,7 +1,10 @@
 #ifndef NMOS_LOGGING_API_H
 #define NMOS_LOGGING_API_H
 
+#include <map>
+#include <memory>
 #include "cpprest/api_router.h"
+#include "cpprest/ws_listener.h" // for web::websockets::experimental::listener::connection_id, etc.
 #include "nmos/log_model.h"
 
 namespace slog
@@ -15,6 +18,24 @@ namespace nmos
     namespace experimental
     {
         web::http::experimental::listener::api_router make_logging_api(nmos::experimental::log_model& model, slog::base_gate& gate);
+
+        // Logging WebSocket API, to stream log events as they are inserted, rather than polling the /log/v1.0/events endpoint
+        // the connection is made to /log/v1.0/events with the same Basic Query and RQL query parameters (but no paging parameters)
+        // and each message is a JSON array of the matching log events, oldest first, each of which is serialized just once for all the connections
+
+        struct log_event_query;
+
+        // the websocket connections streaming log events, and the query of each (protected by the log model mutex)
+        typedef std::map<web::websockets::experimental::listener::connection_id, std::shared_ptr<const log_event_query>> logging_websockets;
+
+        web::websockets::experimental::listener::validate_handler make_logging_ws_validate_handler(nmos::experimental::log_model& model, slog::base_gate& gate);
+        web::websockets::experimental::listener::open_handler make_logging_ws_open_handler(nmos::experimental::log_model& model, logging_websockets& websockets, slog::base_gate& gate);
+        web::websockets::experimental::listener::close_handler make_logging_ws_close_handler(nmos::experimental::log_model& model, logging_websockets& websockets, slog::base_gate& gate);
+
+        // the log records are pushed without locking the log model mutex, so that logging is cheap, which means there's no notification
+        // when there are new log events; instead, they are inserted and sent at the interval specified by nmos::experimental::fields::logging_ws_interval
+        // until nmos::experimental::log_model::controlled_shutdown is called
+        void send_logging_ws_events_thread(web::websockets::experimental::listener::websocket_listener& listener, nmos::experimental::log_model& model, logging_websockets& websockets, slog::base_gate& gate);
     }
 }
 
@@ -1,5 +1,8 @@
 #include "nmos/mdns.h"
 
+#include <map>
+#include <mutex>
+#include <tuple>
 #include <boost/algorithm/string/join.hpp>
 #include <boost/algorithm/string/replace.hpp>
 #include <boost/algorithm/string/split.hpp>
@@ -285,67 +288,69 @@ namespace nmos
             typedef std::pair<api_ver_pri, web::uri> resolved_service;
             typedef std::vector<resolved_service> resolved_services;
 
-            pplx::task<bool> resolve_service(std::shared_ptr<resolved_services> results, mdns::service_discovery& discovery, const nmos::service_type& service, const std::string& browse_domain, const std::set<nmos::api_version>& api_ver, const std::pair<nmos::service_priority, nmos::service_priority>& priorities, const std::set<nmos::service_protocol>& api_proto, const std::chrono::steady_clock::time_point& timeout, const pplx::cancellation_token& token)
+            // add the uris of a resolved instance of the specified service, unless it has an unsuitable priority, protocol or version
+            void add_resolved_service(resolved_services& results, const mdns::resolve_result& resolved, const nmos::service_type& service, const std::set<nmos::api_version>& api_ver, const std::pair<nmos::service_priority, nmos::service_priority>& priorities, const std::set<nmos::service_protocol>& api_proto)
             {
-                return discovery.browse([=, &discovery](const mdns::browse_result& resolving)
-                {
-                    const bool cancel = pplx::canceled == discovery.resolve([=](const mdns::resolve_result& resolved)
-                    {
-                        // "The Node [filters] out any APIs which do not support its required API version and protocol (TXT api_ver and api_proto)."
-                        // See https://github.com/AMWA-TV/nmos-discovery-registration/blob/v1.2/docs/3.1.%20Discovery%20-%20Registered%20Operation.md#registration
+                // "The Node [filters] out any APIs which do not support its required API version and protocol (TXT api_ver and api_proto)."
+                // See https://github.com/AMWA-TV/nmos-discovery-registration/blob/v1.2/docs/3.1.%20Discovery%20-%20Registered%20Operation.md#registration
 
-                        // note, since we specified the interface_id, we expect only one result...
+                // note, since we specified the interface_id, we expect only one result...
 
-                        // parse into structured TXT records
-                        auto records = mdns::parse_txt_records(resolved.txt_records);
+                // parse into structured TXT records
+                auto records = mdns::parse_txt_records(resolved.txt_records);
 
-                        // 'pri' must not be omitted for Registration API and Query API (see nmos::make_txt_records)
-                        auto resolved_pri = nmos::parse_pri_record(records);
-                        if (service != nmos::service_types::node)
-                        {
-                            // ignore results with unsuitable priorities (too high or too low) to avoid development and live systems colliding
-                            // only services between priorities.first and priorities.second (inclusive) should be returned
-                            if (resolved_pri < priorities.first) return true;
-                            if (priorities.second < resolved_pri) return true;
-                        }
+                // 'pri' must not be omitted for Registration API and Query API (see nmos::make_txt_records)
+                auto resolved_pri = nmos::parse_pri_record(records);
+                if (service != nmos::service_types::node)
+                {
+                    // ignore results with unsuitable priorities (too high or too low) to avoid development and live systems colliding
+                    // only services between priorities.first and priorities.second (inclusive) should be returned
+                    if (resolved_pri < priorities.first) return;
+                    if (priorities.second < resolved_pri) return;
+                }
 
-                        // check advertisement has a matching 'api_proto' value
-                        auto resolved_proto = nmos::parse_api_proto_record(records);
-                        if (api_proto.end() == api_proto.find(resolved_proto)) return true;
+                // check advertisement has a matching 'api_proto' value
+                auto resolved_proto = nmos::parse_api_proto_record(records);
+                if (api_proto.end() == api_proto.find(resolved_proto)) return;
 
-                        // check the advertisement includes a version we support
-                        auto resolved_vers = nmos::parse_api_ver_record(records);
-                        auto resolved_ver = std::find_first_of(resolved_vers.rbegin(), resolved_vers.rend(), api_ver.rbegin(), api_ver.rend());
-                        if (resolved_vers.rend() == resolved_ver) return true;
+                // check the advertisement includes a version we support
+                auto resolved_vers = nmos::parse_api_ver_record(records);
+                auto resolved_ver = std::find_first_of(resolved_vers.rbegin(), resolved_vers.rend(), api_ver.rbegin(), api_ver.rend());
+                if (resolved_vers.rend() == resolved_ver) return;
 
-                        auto resolved_uri = web::uri_builder()
-                            .set_scheme(utility::s2us(resolved_proto))
-                            .set_port(resolved.port)
-                            .set_path(U("/x-nmos/") + utility::s2us(details::service_api(service)));
+                auto resolved_uri = web::uri_builder()
+                    .set_scheme(utility::s2us(resolved_proto))
+                    .set_port(resolved.port)
+                    .set_path(U("/x-nmos/") + utility::s2us(details::service_api(service)));
 
-                        if (nmos::service_protocols::https == resolved_proto)
-                        {
-                            auto host_name = utility::s2us(resolved.host_name);
-                            // remove a trailing '.' to turn an FQDN into a DNS name, for SSL certificate matching
-                            // hmm, this might be more appropriately done by tweaking the Host header in the client request?
-                            if (!host_name.empty() && U('.') == host_name.back()) host_name.pop_back();
-
-                            results->push_back({ { *resolved_ver, resolved_pri }, resolved_uri
-                                .set_host(host_name)
-                                .to_uri()
-                            });
-                        }
-                        else for (const auto& ip_address : resolved.ip_addresses)
-                        {
-                            results->push_back({ { *resolved_ver, resolved_pri }, resolved_uri
-                                .set_host(utility::s2us(ip_address))
-                                .to_uri()
-                            });
-                        }
+                if (nmos::service_protocols::https == resolved_proto)
+                {
+                    auto host_name = utility::s2us(resolved.host_name);
+                    // remove a trailing '.' to turn an FQDN into a DNS name, for SSL certificate matching
+                    // hmm, this might be more appropriately done by tweaking the Host header in the client request?
+                    if (!host_name.empty() && U('.') == host_name.back()) host_name.pop_back();
+
+                    results.push_back({ { *resolved_ver, resolved_pri }, resolved_uri
+                        .set_host(host_name)
+                        .to_uri()
+                    });
+                }
+                else for (const auto& ip_address : resolved.ip_addresses)
+                {
+                    results.push_back({ { *resolved_ver, resolved_pri }, resolved_uri
+                        .set_host(utility::s2us(ip_address))
+                        .to_uri()
+                    });
+                }
+            }
 
-                        return true;
-                    }, resolving.name, resolving.type, resolving.domain, resolving.interface_id, timeout - std::chrono::steady_clock::now(), token).wait();
-                    return cancel || !results->empty();
+            pplx::task<bool> resolve_service(std::shared_ptr<resolved_services> results, mdns::service_discovery& discovery, const nmos::service_type& service, const std::string& browse_domain, const std::set<nmos::api_version>& api_ver, const std::pair<nmos::service_priority, nmos::service_priority>& priorities, const std::set<nmos::service_protocol>& api_proto, const std::chrono::steady_clock::time_point& timeout, const pplx::cancellation_token& token)
+            {
+                // each instance is resolved as soon as it is discovered, rather than holding up the browse
+                return discovery.browse_resolve([=](const mdns::browse_result&, const mdns::resolve_result& resolved)
+                {
+                    add_resolved_service(*results, resolved, service, api_ver, priorities, api_proto);
+                    return !results->empty();
                 }, service, browse_domain, 0, timeout - std::chrono::steady_clock::now(), token);
             }
 
@@ -355,6 +360,44 @@ namespace nmos
                 // the higher version is preferred; for the same version, the 'higher' priority is preferred
                 return lhs.first > rhs.first || (lhs.first == rhs.first && lhs.second < rhs.second);
             }
+
+            // order the uris of the resolved instances with the highest version, highest priority instances at the front
+            // and services with the same priority ordered randomly if specified
+            std::list<web::uri> make_service_uris(resolved_services results, bool randomize)
+            {
+                // since each advertisement may be discovered via multiple interfaces and, in the case of the Registration API, via two service types
+                // remove duplicate uris, after sorting to ensure the highest advertised priority is kept for each
+                std::stable_sort(results.begin(), results.end(), [](const resolved_service& lhs, const resolved_service& rhs)
+                {
+                    return lhs.second < rhs.second || (lhs.second == rhs.second && less_api_ver_pri(lhs.first, rhs.first));
+                });
+                results.erase(std::unique(results.begin(), results.end(), [](const resolved_service& lhs, const resolved_service& rhs)
+                {
+                    return lhs.second == rhs.second;
+                }), results.end());
+
+                if (randomize)
+                {
+                    // "The Node selects a Registration API to use based on the priority, and a random selection if multiple Registration APIs
+                    // with the same priority are identified."
+                    // Therefore shuffle the results before inserting any into the resulting priority queue...
+                    nmos::details::seed_generator seeder;
+                    std::shuffle(results.begin(), results.end(), std::default_random_engine(seeder));
+                }
+
+                // "Given multiple returned Registration APIs, the Node orders these based on their advertised priority (TXT pri)"
+                std::stable_sort(results.begin(), results.end(), [](const resolved_service& lhs, const resolved_service& rhs)
+                {
+                    // hmm, for the moment, the scheme is *not* considered; one might want to prefer 'https' over 'http'?
+                    return less_api_ver_pri(lhs.first, rhs.first);
+                });
+
+                // add the version to each uri
+                return boost::copy_range<std::list<web::uri>>(results | boost::adaptors::transformed([](const resolved_service& s)
+                {
+                    return web::uri_builder(s.second).append_path(U("/") + make_api_version(s.first.first)).to_uri();
+                }));
+            }
         }
 
         // helper function for resolving instances of the specified service (API)
@@ -426,39 +469,156 @@ namespace nmos
 
             return resolve_task.then([results, randomize](bool)
             {
-                // since each advertisement may be discovered via multiple interfaces and, in the case of the Registration API, via two service types
-                // remove duplicate uris, after sorting to ensure the highest advertised priority is kept for each
-                std::stable_sort(results->begin(), results->end(), [](const details::resolved_service& lhs, const details::resolved_service& rhs)
+                return details::make_service_uris(std::move(*results), randomize);
+            });
+        }
+
+        namespace details
+        {
+            class service_cache_impl
+            {
+            public:
+                service_cache_impl(mdns::service_discovery& discovery, const nmos::service_type& service, const std::string& browse_domain, const std::set<nmos::api_version>& api_ver, const std::pair<nmos::service_priority, nmos::service_priority>& priorities, const std::set<nmos::service_protocol>& api_proto)
+                    : discovery(discovery)
+                    , service(service)
+                    , api_ver(api_ver)
+                    , priorities(priorities)
+                    , api_proto(api_proto)
                 {
-                    return lhs.second < rhs.second || (lhs.second == rhs.second && details::less_api_ver_pri(lhs.first, rhs.first));
-                });
-                results->erase(std::unique(results->begin(), results->end(), [](const details::resolved_service& lhs, const details::resolved_service& rhs)
+                    // also browse for "_nmos-register._tcp" for v1.3, as in resolve_service
+                    std::vector<nmos::service_type> browse_types;
+                    if (nmos::service_types::registration == service)
+                    {
+                        browse_types.push_back(nmos::service_types::register_);
+                        if (!api_ver.empty() && *api_ver.begin() < nmos::is04_versions::v1_3) browse_types.push_back(service);
+                    }
+                    else
+                    {
+                        browse_types.push_back(service);
+                    }
+
+                    const auto token = cancellation_source.get_token();
+                    std::lock_guard<std::mutex> lock(mutex);
+                    for (const auto& browse_type : browse_types)
+                    {
+                        tasks.push_back(discovery.browse_changes([this](const mdns::browse_result& instance, bool added)
+                        {
+                            if (added) add(instance); else remove(instance);
+                        }, browse_type, browse_domain, 0, token));
+                    }
+                }
+
+                ~service_cache_impl()
                 {
-                    return lhs.second == rhs.second;
-                }), results->end());
+                    cancellation_source.cancel();
 
-                if (randomize)
+                    // wait for the browse tasks, and any resolve tasks they started before they completed
+                    for (;;)
+                    {
+                        std::vector<pplx::task<void>> pending;
+                        {
+                            std::lock_guard<std::mutex> lock(mutex);
+                            pending.swap(tasks);
+                        }
+                        if (pending.empty()) break;
+
+                        for (auto& task : pending)
+                        {
+                            try
+                            {
+                                task.wait();
+                            }
+                            catch (...) {}
+                        }
+                    }
+                }
+
+                std::list<web::uri> services(bool randomize) const
                 {
-                    // "The Node selects a Registration API to use based on the priority, and a random selection if multiple Registration APIs
-                    // with the same priority are identified."
-                    // Therefore shuffle the results before inserting any into the resulting priority queue...
-                    nmos::details::seed_generator seeder;
-                    std::shuffle(results->begin(), results->end(), std::default_random_engine(seeder));
+                    resolved_services results;
+                    {
+                        std::lock_guard<std::mutex> lock(mutex);
+                        for (const auto& instance : instances)
+                        {
+                            results.insert(results.end(), instance.second.begin(), instance.second.end());
+                        }
+                    }
+                    return make_service_uris(std::move(results), randomize);
                 }
 
-                // "Given multiple returned Registration APIs, the Node orders these based on their advertised priority (TXT pri)"
-                std::stable_sort(results->begin(), results->end(), [](const details::resolved_service& lhs, const details::resolved_service& rhs)
+            private:
+                typedef std::tuple<std::string, std::string, std::string, std::uint32_t> instance_key;
+
+                static instance_key make_instance_key(const mdns::browse_result& instance)
                 {
-                    // hmm, for the moment, the scheme is *not* considered; one might want to prefer 'https' over 'http'?
-                    return details::less_api_ver_pri(lhs.first, rhs.first);
-                });
+                    return instance_key{ instance.name, instance.type, instance.domain, instance.interface_id };
+                }
 
-                // add the version to each uri
-                return boost::copy_range<std::list<web::uri>>(*results | boost::adaptors::transformed([](const details::resolved_service& s)
+                void add(const mdns::browse_result& instance)
                 {
-                    return web::uri_builder(s.second).append_path(U("/") + make_api_version(s.first.first)).to_uri();
-                }));
-            });
+                    const auto key = make_instance_key(instance);
+
+                    std::lock_guard<std::mutex> lock(mutex);
+
+                    // the instance is cached as soon as it is added, but without any uris until it has been resolved
+                    instances[key];
+
+                    // discard the tasks that have already completed
+                    tasks.erase(std::remove_if(tasks.begin(), tasks.end(), [](const pplx::task<void>& task) { return task.is_done(); }), tasks.end());
+
+                    std::shared_ptr<resolved_services> results(new resolved_services);
+                    tasks.push_back(discovery.resolve([this, results](const mdns::resolve_result& resolved)
+                    {
+                        add_resolved_service(*results, resolved, service, api_ver, priorities, api_proto);
+                        return true;
+                    }, instance.name, instance.type, instance.domain, instance.interface_id, std::chrono::seconds(mdns::default_timeout_seconds), cancellation_source.get_token()).then([this, key, results](pplx::task<bool> finally)
+                    {
+                        try
+                        {
+                            finally.wait();
+                        }
+                        catch (...) {}
+
+                        std::lock_guard<std::mutex> lock(mutex);
+
+                        // the instance may have been removed while it was being resolved
+                        auto found = instances.find(key);
+                        if (instances.end() != found) found->second = std::move(*results);
+                    }));
+                }
+
+                void remove(const mdns::browse_result& instance)
+                {
+                    std::lock_guard<std::mutex> lock(mutex);
+                    instances.erase(make_instance_key(instance));
+                }
+
+                mdns::service_discovery& discovery;
+                const nmos::service_type service;
+                const std::set<nmos::api_version> api_ver;
+                const std::pair<nmos::service_priority, nmos::service_priority> priorities;
+                const std::set<nmos::service_protocol> api_proto;
+
+                pplx::cancellation_token_source cancellation_source;
+
+                mutable std::mutex mutex;
+                std::map<instance_key, resolved_services> instances;
+                std::vector<pplx::task<void>> tasks;
+            };
+        }
+
+        service_cache::service_cache(mdns::service_discovery& discovery, const nmos::service_type& service, const std::string& browse_domain, const std::set<nmos::api_version>& api_ver, const std::pair<nmos::service_priority, nmos::service_priority>& priorities, const std::set<nmos::service_protocol>& api_proto)
+            : impl(new details::service_cache_impl(discovery, service, browse_domain, api_ver, priorities, api_proto))
+        {
+        }
+
+        service_cache::~service_cache()
+        {
+        }
+
+        std::list<web::uri> service_cache::services(bool randomize) const
+        {
+            return impl->services(randomize);
         }
     }
 }
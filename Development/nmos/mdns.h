@@ -2,6 +2,7 @@
 #define NMOS_MDNS_H
 
 #include <list>
+#include <memory>
 #include "cpprest/base_uri.h"
 #include "mdns/core.h" // for mdns::structured_txt_records
 #include "nmos/is04_versions.h"
@@ -133,6 +134,31 @@ namespace nmos
         {
             return resolve_service(discovery, service, browse_domain, api_ver, api_proto, randomize, std::chrono::duration_cast<std::chrono::steady_clock::duration>(timeout), token);
         }
+
+        namespace details
+        {
+            class service_cache_impl;
+        }
+
+        // a service cache continuously browses for instances of the specified service (API), resolving each one as it is added
+        // so that the resolved instances are immediately available, e.g. to fail over from one Registration API to another
+        // without waiting for a fresh browse, resolve and address lookup
+        // note, the service discovery must outlive the service cache
+        class service_cache
+        {
+        public:
+            service_cache(mdns::service_discovery& discovery, const nmos::service_type& service, const std::string& browse_domain = {}, const std::set<nmos::api_version>& api_ver = nmos::is04_versions::all, const std::pair<nmos::service_priority, nmos::service_priority>& priorities = { service_priorities::highest_active_priority, service_priorities::no_priority }, const std::set<nmos::service_protocol>& api_proto = nmos::service_protocols::all);
+            ~service_cache();
+
+            // the currently resolved instances, ordered as by resolve_service
+            std::list<web::uri> services(bool randomize = true) const;
+
+            service_cache(const service_cache&) = delete;
+            service_cache& operator=(const service_cache&) = delete;
+
+        private:
+            std::unique_ptr<details::service_cache_impl> impl;
+        };
     }
 }
 
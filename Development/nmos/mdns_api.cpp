@@ -1,7 +1,7 @@
 #include "nmos/mdns_api.h"
 
 #include <boost/range/adaptor/transformed.hpp>
-#include "mdns/service_discovery.h"
+#include "mdns/discovery_cache.h"
 #include "nmos/api_utils.h"
 #include "nmos/mdns.h"
 #include "nmos/model.h"
@@ -61,17 +61,29 @@ namespace nmos
             return result;
         }
 
+        namespace details
+        {
+            // the discovery cache is shared by all the requests, and must be destroyed before the service discovery
+            struct mdns_api_discovery
+            {
+                explicit mdns_api_discovery(slog::base_gate& gate) : discovery(gate), cache(discovery, gate) {}
+
+                ::mdns::service_discovery discovery;
+                ::mdns::discovery_cache cache;
+            };
+        }
+
         web::http::experimental::listener::api_router make_unmounted_mdns_api(nmos::base_model& model, slog::base_gate& gate_)
         {
             using namespace web::http::experimental::listener::api_router_using_declarations;
 
             api_router mdns_api;
 
-            mdns_api.support(U("/?"), methods::GET, [&model, &gate_](http_request req, http_response res, const string_t&, const route_parameters& parameters)
-            {
-                // hmmm, fragile; make shared, and capture into continuation below, in order to extend lifetime until after discovery
-                std::shared_ptr<nmos::api_gate> gate(new nmos::api_gate(gate_, req, parameters));
+            // results are served from a cache maintained by continuous browsing, rather than each request starting a fresh browse and resolve
+            std::shared_ptr<details::mdns_api_discovery> shared(new details::mdns_api_discovery(gate_));
 
+            mdns_api.support(U("/?"), methods::GET, [&model, shared](http_request req, http_response res, const string_t&, const route_parameters&)
+            {
                 // get the browse domain from the query parameters or settings
 
                 auto flat_query_params = web::json::value_from_query(req.request_uri().query());
@@ -80,15 +92,15 @@ namespace nmos
                 const auto settings_domain = with_read_lock(model.mutex, [&] { return nmos::fields::domain(model.settings); });
                 const auto browse_domain = utility::us2s(web::json::field_as_string_or{ { nmos::fields::domain }, settings_domain }(flat_query_params));
 
-                std::shared_ptr<::mdns::service_discovery> discovery(new ::mdns::service_discovery(*gate));
-
                 // note, only the list of available service types that are explicitly being advertised is returned by "_services._dns-sd._udp"
                 // see https://tools.ietf.org/html/rfc6763#section-9
-                return discovery->browse("_services._dns-sd._udp", browse_domain).then([res, gate](std::vector<::mdns::browse_result> browsed) mutable
+                // and these aren't service instances, so can't be resolved
+                return shared->cache.services("_services._dns-sd._udp", browse_domain, false).then([res](std::vector<::mdns::cached_service> browsed) mutable
                 {
-                    const auto results = boost::copy_range<std::set<utility::string_t>>(browsed | boost::adaptors::transformed([](const ::mdns::browse_result& br)
+                    const auto results = boost::copy_range<std::set<utility::string_t>>(browsed | boost::adaptors::transformed([](const ::mdns::cached_service& cs)
                     {
                         // results for this query seem to be e.g. name = "_nmos-query", type = "_tcp.local."
+                        const auto& br = cs.instance;
                         return utility::s2us(br.name + '.' + br.type.substr(0, br.type.find('.')) + '/');
                     }));
                     set_reply(res, status_codes::OK,
@@ -99,11 +111,8 @@ namespace nmos
                 });
             });
 
-            mdns_api.support(U("/") + nmos::experimental::patterns::mdnsServiceType.pattern + U("/?"), methods::GET, [&model, &gate_](http_request req, http_response res, const string_t&, const route_parameters& parameters)
+            mdns_api.support(U("/") + nmos::experimental::patterns::mdnsServiceType.pattern + U("/?"), methods::GET, [&model, shared](http_request req, http_response res, const string_t&, const route_parameters& parameters)
             {
-                // hmmm, fragile; make shared, and capture into continuation below, in order to extend lifetime until after discovery
-                std::shared_ptr<nmos::api_gate> gate(new nmos::api_gate(gate_, req, parameters));
-
                 // hmm, something to think about... the regex patterns are presumably being used on encoded paths?
                 const std::string serviceType = utility::us2s(web::uri::decode(parameters.at(nmos::experimental::patterns::mdnsServiceType.name)));
 
@@ -115,67 +124,32 @@ namespace nmos
                 const auto settings_domain = with_read_lock(model.mutex, [&] { return nmos::fields::domain(model.settings); });
                 const auto browse_domain = utility::us2s(web::json::field_as_string_or{ { nmos::fields::domain }, settings_domain }(flat_query_params));
 
-                std::shared_ptr<::mdns::service_discovery> discovery(new ::mdns::service_discovery(*gate));
-
-                // hmm, how to add cancellation on shutdown to the browse and resolve operations?
-                return discovery->browse(serviceType, browse_domain).then([res, discovery, gate](std::vector<::mdns::browse_result> browsed) mutable
+                return shared->cache.services(serviceType, browse_domain).then([res](std::vector<::mdns::cached_service> browsed) mutable
                 {
-                    if (!browsed.empty())
+                    // there may be more than one instance with the same name, e.g. one per interface, so just pick the first that has been resolved
+                    std::map<std::string, value> results;
+                    for (const auto& cs : browsed)
                     {
-                        std::shared_ptr<std::map<std::string, value>> results(new std::map<std::string, value>());
+                        if (cs.resolved.empty() || results.end() != results.find(cs.instance.name)) continue;
+                        results[cs.instance.name] = make_mdns_result(cs.instance.name, cs.resolved.front());
+                    }
 
-                        // add a continuation for each discovered service to resolve it
-                        // but, to simplify inserting these into the priority map, the continuations are sequential
-                        // rather than parallelised using pplx::when_all
-                        auto resolve_all = pplx::task_from_result();
-                        for (const auto& resolving : browsed)
-                        {
-                            resolve_all = resolve_all.then([discovery, results, resolving, gate]
-                            {
-                                const auto& serviceName = resolving.name;
-
-                                // check if we already have resolved this service
-                                if (results->end() != results->find(serviceName)) return pplx::task_from_result();
-
-                                // if not, resolve and add a result for it
-                                return discovery->resolve(resolving.name, resolving.type, resolving.domain, resolving.interface_id)
-                                    .then([results, serviceName, gate](std::vector<::mdns::resolve_result> resolved)
-                                {
-                                    if (!resolved.empty())
-                                    {
-                                        (*results)[serviceName] = make_mdns_result(serviceName, resolved.front());
-                                    }
-                                });
-                            });
-                        }
-                        return resolve_all.then([res, results]() mutable
-                        {
-                            if (!results->empty())
-                            {
-                                set_reply(res, status_codes::OK,
-                                    web::json::serialize(*results, [](const std::map<std::string, value>::value_type& kv) { return kv.second; }),
-                                    web::http::details::mime_types::application_json);
-                                res.headers().add(U("X-Total-Count"), results->size());
-                            }
-                            else
-                            {
-                                set_reply(res, status_codes::NotFound);
-                            }
-                            return true;
-                        });
+                    if (!results.empty())
+                    {
+                        set_reply(res, status_codes::OK,
+                            web::json::serialize(results, [](const std::map<std::string, value>::value_type& kv) { return kv.second; }),
+                            web::http::details::mime_types::application_json);
+                        res.headers().add(U("X-Total-Count"), results.size());
                     }
                     else
                     {
-                        return pplx::create_task([] {}).then([res]() mutable
-                        {
-                            set_reply(res, status_codes::NotFound);
-                            return true;
-                        });
+                        set_reply(res, status_codes::NotFound);
                     }
+                    return true;
                 });
             });
 
-            mdns_api.support(U("/") + nmos::experimental::patterns::mdnsServiceType.pattern + U("/") + nmos::experimental::patterns::mdnsServiceName.pattern + U("/?"), methods::GET, [&model, &gate_](http_request req, http_response res, const string_t&, const route_parameters& parameters)
+            mdns_api.support(U("/") + nmos::experimental::patterns::mdnsServiceType.pattern + U("/") + nmos::experimental::patterns::mdnsServiceName.pattern + U("/?"), methods::GET, [&model, &gate_, shared](http_request req, http_response res, const string_t&, const route_parameters& parameters)
             {
                 // hmmm, fragile; make shared, and capture into continuation below, in order to extend lifetime until after discovery
                 std::shared_ptr<nmos::api_gate> gate(new nmos::api_gate(gate_, req, parameters));
@@ -191,26 +165,42 @@ namespace nmos
                 const auto settings_domain = with_read_lock(model.mutex, [&] { return nmos::fields::domain(model.settings); });
                 const auto service_domain = utility::us2s(web::json::field_as_string_or{ { nmos::fields::domain }, settings_domain }(flat_query_params));
 
-                std::shared_ptr<::mdns::service_discovery> discovery(new ::mdns::service_discovery(*gate));
-
-                // When browsing, we resolve using the browse results' domain and interface
-                // so this can give different results...
-                return discovery->resolve(serviceName, serviceType, service_domain.empty() ? "local." : service_domain)
-                    .then([res, serviceName, gate](std::vector<::mdns::resolve_result> resolved) mutable
+                // look for the service in the cached results for its type first, and only resolve it directly if it hasn't been browsed
+                return shared->cache.services(serviceType, service_domain).then([res, shared, serviceName, serviceType, service_domain, gate](std::vector<::mdns::cached_service> browsed) mutable
                 {
-                    if (!resolved.empty())
+                    auto found = std::find_if(browsed.begin(), browsed.end(), [&](const ::mdns::cached_service& cs)
+                    {
+                        return serviceName == cs.instance.name && !cs.resolved.empty();
+                    });
+                    if (browsed.end() != found)
                     {
                         // for now, pick one result, even though there may be one per interface
-                        value result = make_mdns_result(serviceName, resolved.front());
-
-                        set_reply(res, status_codes::OK, result);
+                        set_reply(res, status_codes::OK, make_mdns_result(serviceName, found->resolved.front()));
+                        return pplx::task_from_result(true);
                     }
-                    else
+
+                    // hmm, how to add cancellation on shutdown to the resolve operation?
+                    std::shared_ptr<::mdns::service_discovery> discovery(new ::mdns::service_discovery(*gate));
+
+                    // When browsing, we resolve using the browse results' domain and interface
+                    // so this can give different results...
+                    return discovery->resolve(serviceName, serviceType, service_domain.empty() ? "local." : service_domain)
+                        .then([res, serviceName, discovery, gate](std::vector<::mdns::resolve_result> resolved) mutable
                     {
-                        set_reply(res, status_codes::NotFound);
-                    }
+                        if (!resolved.empty())
+                        {
+                            // for now, pick one result, even though there may be one per interface
+                            value result = make_mdns_result(serviceName, resolved.front());
 
-                    return true;
+                            set_reply(res, status_codes::OK, result);
+                        }
+                        else
+                        {
+                            set_reply(res, status_codes::NotFound);
+                        }
+
+                        return true;
+                    });
                 });
             });
 
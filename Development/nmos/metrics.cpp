@@ -0,0 +1,195 @@
+#include "nmos/metrics.h"
+
+#include <algorithm>
+#include <iomanip>
+#include <mutex>
+#include <sstream>
+#include "cpprest/asyncrt_utils.h" // for utility::conversions
+
+namespace nmos
+{
+    namespace experimental
+    {
+        const std::array<long long, 19>& latency_histogram::bounds()
+        {
+            // 10 us to 10 s, roughly 1-2.5-5 per decade
+            static const std::array<long long, 19> bounds{ { 10, 25, 50, 100, 250, 500, 1000, 2500, 5000, 10000, 25000, 50000, 100000, 250000, 500000, 1000000, 2500000, 5000000, 10000000 } };
+            return bounds;
+        }
+
+        latency_histogram::latency_histogram()
+            : sum_microseconds(0)
+            , count(0)
+        {
+            for (auto& bucket : buckets) bucket = 0;
+        }
+
+        void latency_histogram::record(std::chrono::microseconds latency)
+        {
+            const auto& bounds = latency_histogram::bounds();
+            const auto bucket = std::lower_bound(bounds.begin(), bounds.end(), (long long)latency.count()) - bounds.begin();
+
+            buckets[bucket].fetch_add(1, std::memory_order_relaxed);
+            sum_microseconds.fetch_add((unsigned long long)(std::max)(latency.count(), decltype(latency.count())(0)), std::memory_order_relaxed);
+            count.fetch_add(1, std::memory_order_relaxed);
+        }
+
+        void latency_histogram::write(std::ostream& os, const std::string& name, const std::string& labels) const
+        {
+            const auto separator = labels.empty() ? "" : ",";
+
+            // the bucket counts are read individually, so may be very slightly inconsistent with each other, and the sum and count, during a scrape
+            const auto& bounds = latency_histogram::bounds();
+            unsigned long long cumulative = 0;
+            for (size_t bucket = 0; bucket < bounds.size(); ++bucket)
+            {
+                cumulative += buckets[bucket].load(std::memory_order_relaxed);
+                os << name << "_bucket{" << labels << separator << "le=\"" << bounds[bucket] / 1e6 << "\"} " << cumulative << "\n";
+            }
+            cumulative += buckets[bounds.size()].load(std::memory_order_relaxed);
+            os << name << "_bucket{" << labels << separator << "le=\"+Inf\"} " << cumulative << "\n";
+            os << name << "_sum{" << labels << "} " << std::fixed << std::setprecision(6) << sum_microseconds.load(std::memory_order_relaxed) / 1e6 << std::defaultfloat << "\n";
+            os << name << "_count{" << labels << "} " << count.load(std::memory_order_relaxed) << "\n";
+        }
+
+        route_metrics::route_metrics()
+        {
+            for (auto& response : responses) response = 0;
+        }
+
+        void websocket_metrics::insert(const utility::string_t& id)
+        {
+            std::lock_guard<std::mutex> lock(mutex);
+            connections[id] = {};
+        }
+
+        // the send threads may still be sending on a websocket connection after it has been closed, so only connections being tracked are updated
+        void websocket_metrics::send_begin(const utility::string_t& id)
+        {
+            const auto now = std::chrono::steady_clock::now();
+            std::lock_guard<std::mutex> lock(mutex);
+            auto found = connections.find(id);
+            if (connections.end() == found) return;
+            found->second.sending = now;
+        }
+
+        void websocket_metrics::send_end(const utility::string_t& id, std::size_t bytes)
+        {
+            std::lock_guard<std::mutex> lock(mutex);
+            auto found = connections.find(id);
+            if (connections.end() == found) return;
+            ++found->second.messages_sent;
+            found->second.bytes_sent += bytes;
+            found->second.sending = (std::chrono::steady_clock::time_point::max)();
+        }
+
+        void websocket_metrics::erase(const utility::string_t& id)
+        {
+            std::lock_guard<std::mutex> lock(mutex);
+            connections.erase(id);
+        }
+
+        bool websocket_metrics::find(const utility::string_t& id, websocket_connection_metrics& connection) const
+        {
+            std::lock_guard<std::mutex> lock(mutex);
+            auto found = connections.find(id);
+            if (connections.end() == found) return false;
+            connection = found->second;
+            return true;
+        }
+
+        void metrics::record(const utility::string_t& route, const utility::string_t& method, unsigned short status_code, std::chrono::microseconds latency)
+        {
+            const auto key = std::make_pair(route, method);
+
+            route_metrics* recorded = nullptr;
+            {
+                bst::shared_lock<bst::shared_mutex> lock(mutex);
+                auto found = routes.find(key);
+                if (routes.end() != found) recorded = found->second.get();
+            }
+            if (nullptr == recorded)
+            {
+                std::unique_lock<bst::shared_mutex> lock(mutex);
+                auto& inserted = routes[key];
+                if (!inserted) inserted.reset(new route_metrics);
+                recorded = inserted.get();
+            }
+
+            // status codes outside the range 100-599 are counted as server errors
+            const auto status_class = 100 <= status_code && status_code < 600 ? status_code / 100 - 1 : 4;
+            recorded->responses[status_class].fetch_add(1, std::memory_order_relaxed);
+            recorded->latency.record(latency);
+        }
+
+        void metrics::write(std::ostream& os) const
+        {
+            os << "# HELP nmos_expired_resources_total Count of resources erased by the expiry threads.\n";
+            os << "# TYPE nmos_expired_resources_total counter\n";
+            os << "nmos_expired_resources_total " << expired_resources.load(std::memory_order_relaxed) << "\n";
+
+            os << "# HELP nmos_registration_heartbeats_total Count of node heartbeats handled by the Registration API.\n";
+            os << "# TYPE nmos_registration_heartbeats_total counter\n";
+            os << "nmos_registration_heartbeats_total " << heartbeats.load(std::memory_order_relaxed) << "\n";
+
+            os << "# HELP nmos_query_ws_change_propagation_seconds Time from receiving each change, e.g. a Registration API request, to sending a Query API websocket message including it, on any connection.\n";
+            os << "# TYPE nmos_query_ws_change_propagation_seconds histogram\n";
+            change_propagation.write(os, "nmos_query_ws_change_propagation_seconds", "");
+
+            os << "# HELP nmos_connection_patch_stage_duration_seconds Time spent in each stage of handling Connection API PATCH requests, for each sender or receiver.\n";
+            os << "# TYPE nmos_connection_patch_stage_duration_seconds histogram\n";
+            connection_patch.validation.write(os, "nmos_connection_patch_stage_duration_seconds", "stage=\"validation\"");
+            connection_patch.staging.write(os, "nmos_connection_patch_stage_duration_seconds", "stage=\"staging\"");
+            connection_patch.activation.write(os, "nmos_connection_patch_stage_duration_seconds", "stage=\"activation\"");
+            connection_patch.response.write(os, "nmos_connection_patch_stage_duration_seconds", "stage=\"response\"");
+
+            bst::shared_lock<bst::shared_mutex> lock(mutex);
+
+            os << "# HELP nmos_http_responses_total Count of HTTP responses by API route, method and status code class.\n";
+            os << "# TYPE nmos_http_responses_total counter\n";
+            for (const auto& route : routes)
+            {
+                for (size_t status_class = 0; status_class < route.second->responses.size(); ++status_class)
+                {
+                    const auto count = route.second->responses[status_class].load(std::memory_order_relaxed);
+                    if (0 == count) continue;
+                    os << "nmos_http_responses_total{route=\"";
+                    details::write_label_value(os, route.first.first);
+                    os << "\",method=\"";
+                    details::write_label_value(os, route.first.second);
+                    os << "\",code=\"" << status_class + 1 << "xx\"} " << count << "\n";
+                }
+            }
+
+            os << "# HELP nmos_http_request_duration_seconds Time from receiving each HTTP request to sending the response, by API route and method.\n";
+            os << "# TYPE nmos_http_request_duration_seconds histogram\n";
+            for (const auto& route : routes)
+            {
+                std::ostringstream labels;
+                labels << "route=\"";
+                details::write_label_value(labels, route.first.first);
+                labels << "\",method=\"";
+                details::write_label_value(labels, route.first.second);
+                labels << "\"";
+                route.second->latency.write(os, "nmos_http_request_duration_seconds", labels.str());
+            }
+        }
+
+        namespace details
+        {
+            void write_label_value(std::ostream& os, const utility::string_t& value)
+            {
+                for (auto c : utility::conversions::to_utf8string(value))
+                {
+                    switch (c)
+                    {
+                    case '\\': os << "\\\\"; break;
+                    case '"': os << "\\\""; break;
+                    case '\n': os << "\\n"; break;
+                    default: os << c; break;
+                    }
+                }
+            }
+        }
+    }
+}
@@ -0,0 +1,145 @@
+#ifndef NMOS_METRICS_H
+#define NMOS_METRICS_H
+
+#include <array>
+#include <atomic>
+#include <chrono>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <ostream>
+#include "bst/shared_mutex.h"
+#include "cpprest/details/basic_types.h"
+
+// This is an experimental extension to collect metrics, e.g. for the Metrics API (see nmos/metrics_api.h)
+// Recording only uses atomic counters, so doesn't require the model mutex to be locked
+namespace nmos
+{
+    namespace experimental
+    {
+        // a histogram of latencies, using fixed bucket bounds rather like a Prometheus histogram
+        struct latency_histogram
+        {
+            // upper bounds of the buckets, in microseconds, excluding the final "+Inf" bucket
+            static const std::array<long long, 19>& bounds();
+
+            latency_histogram();
+
+            void record(std::chrono::microseconds latency);
+
+            // write the cumulative bucket counts, sum (in seconds) and count, in the Prometheus text exposition format
+            void write(std::ostream& os, const std::string& name, const std::string& labels) const;
+
+            // non-cumulative count of each bucket, including the final "+Inf" bucket
+            std::array<std::atomic<unsigned long long>, 20> buckets;
+            std::atomic<unsigned long long> sum_microseconds;
+            std::atomic<unsigned long long> count;
+        };
+
+        // the request counts by status code class, and latency histogram, of each route and method of an API
+        struct route_metrics
+        {
+            route_metrics();
+
+            // count of responses by status code class, i.e. 1xx, 2xx, 3xx, 4xx and 5xx
+            std::array<std::atomic<unsigned long long>, 5> responses;
+            latency_histogram latency;
+        };
+
+        // the time spent in each stage of handling Connection API PATCH requests, for each sender or receiver in the request
+        struct connection_patch_metrics
+        {
+            // validating the patch against the schema, before the model lock is acquired
+            latency_histogram validation;
+            // merging the patch into the staged endpoint, including validating it against the constraints
+            latency_histogram staging;
+            // waiting for the node implementation to complete an immediate activation, e.g. by calling nmos::set_connection_resource_active
+            latency_histogram activation;
+            // preparing the response (for each request, rather than each sender or receiver)
+            latency_histogram response;
+        };
+
+        // the counters of one websocket connection, maintained by the websocket send threads
+        struct websocket_connection_metrics
+        {
+            websocket_connection_metrics() : messages_sent(0), bytes_sent(0), sending((std::chrono::steady_clock::time_point::max)()) {}
+
+            unsigned long long messages_sent;
+            unsigned long long bytes_sent;
+            // when the message now being sent started to be sent, or max if none is being sent
+            std::chrono::steady_clock::time_point sending;
+        };
+
+        // the counters of the Query API and Events API websocket connections, by the id of the event queue or grain of each connection
+        // unlike the other metrics, these are protected by a mutex, since connections come and go
+        class websocket_metrics
+        {
+        public:
+            // start tracking a websocket connection which has been opened
+            void insert(const utility::string_t& id);
+
+            // record that a message is about to be sent on the specified websocket connection
+            void send_begin(const utility::string_t& id);
+
+            // record that the message has been sent, or that sending failed
+            void send_end(const utility::string_t& id, std::size_t bytes);
+
+            // discard the counters of a websocket connection which has been closed
+            void erase(const utility::string_t& id);
+
+            // get the counters of the specified websocket connection, or return false if it isn't being tracked
+            bool find(const utility::string_t& id, websocket_connection_metrics& connection) const;
+
+        private:
+            mutable std::mutex mutex;
+            std::map<utility::string_t, websocket_connection_metrics> connections;
+        };
+
+        // the time elapsed since the specified time point, for recording in a latency histogram
+        inline std::chrono::microseconds elapsed_since(std::chrono::steady_clock::time_point start)
+        {
+            return std::chrono::duration_cast<std::chrono::microseconds>(std::chrono::steady_clock::now() - start);
+        }
+
+        struct metrics
+        {
+            // record a response to a request for the specified route and method
+            void record(const utility::string_t& route, const utility::string_t& method, unsigned short status_code, std::chrono::microseconds latency);
+
+            // write all the metrics collected from the APIs and other threads, in the Prometheus text exposition format
+            void write(std::ostream& os) const;
+
+            // count of resources erased by the expiry threads
+            std::atomic<unsigned long long> expired_resources{ 0 };
+
+            // count of node heartbeats handled by the Registration API
+            std::atomic<unsigned long long> heartbeats{ 0 };
+
+            // the time from each change being received, e.g. by the Registration API, to a Query API websocket message including its events having been sent
+            // see nmos::event_queues::latencies for the histogram of each subscription
+            latency_histogram change_propagation;
+
+            // the stages of handling Connection API PATCH requests, e.g. to see how much of the latency of a salvo is spent waiting for the node implementation
+            connection_patch_metrics connection_patch;
+
+            // the messages and bytes sent on each websocket connection, e.g. to tell a slow client from a registry that is behind
+            // see the /websockets endpoint of the Metrics API
+            websocket_metrics websockets;
+
+        private:
+            // the mutex only protects the set of routes, not the route metrics themselves
+            // and is only locked exclusively the first time a route and method is recorded
+            // note, this isn't an nmos::mutex in order that it isn't itself instrumented (see NMOS_CPP_INSTRUMENT_MUTEX)
+            mutable bst::shared_mutex mutex;
+            std::map<std::pair<utility::string_t, utility::string_t>, std::unique_ptr<route_metrics>> routes;
+        };
+
+        namespace details
+        {
+            // write a string as a Prometheus label value, escaping backslash, double-quote and line feed
+            void write_label_value(std::ostream& os, const utility::string_t& value);
+        }
+    }
+}
+
+#endif
@@ -0,0 +1,410 @@
+#include "nmos/metrics_api.h"
+
+#include <algorithm>
+#include <sstream>
+#include <unordered_set>
+#include "nmos/allocator.h"
+#include "nmos/api_utils.h"
+#include "nmos/event_queues.h"
+#include "nmos/log_model.h"
+#include "nmos/metrics.h"
+#include "nmos/model.h"
+#include "nmos/query_utils.h" // for nmos::fields::message_grain_data
+#include "nmos/slog.h"
+
+namespace nmos
+{
+    namespace experimental
+    {
+        namespace details
+        {
+            typedef std::vector<std::pair<utility::string_t, const nmos::resources*>> named_resources;
+
+            // write the metrics of the model, in the Prometheus text exposition format
+            // the model mutex must be locked (shared or exclusive) by the caller
+            void write_model_metrics(std::ostream& os, const named_resources& named_resources)
+            {
+                os << "# HELP nmos_resources Count of resources (including subscriptions and websocket grains) by type.\n";
+                os << "# TYPE nmos_resources gauge\n";
+                for (const auto& named : named_resources)
+                {
+                    for (const auto& type : nmos::types::all)
+                    {
+                        os << "nmos_resources{resources=\"";
+                        write_label_value(os, named.first);
+                        os << "\",type=\"";
+                        write_label_value(os, type.name);
+                        os << "\"} " << nmos::count_resources(*named.second, type) << "\n";
+                    }
+                }
+
+                os << "# HELP nmos_non_extant_resources Count of resources which have been deleted or have expired, but have not yet been forgotten, by type.\n";
+                os << "# TYPE nmos_non_extant_resources gauge\n";
+                for (const auto& named : named_resources)
+                {
+                    for (const auto& type : nmos::types::all)
+                    {
+                        os << "nmos_non_extant_resources{resources=\"";
+                        write_label_value(os, named.first);
+                        os << "\",type=\"";
+                        write_label_value(os, type.name);
+                        os << "\"} " << nmos::count_non_extant_resources(*named.second, type) << "\n";
+                    }
+                }
+
+                os << "# HELP nmos_subscriptions Count of subscriptions by whether they are persistent.\n";
+                os << "# TYPE nmos_subscriptions gauge\n";
+                for (const auto& named : named_resources)
+                {
+                    size_t persistent = 0, non_persistent = 0;
+                    auto subscriptions = named.second->get<tags::type>().equal_range(nmos::details::has_data(nmos::types::subscription));
+                    for (; subscriptions.first != subscriptions.second; ++subscriptions.first)
+                    {
+                        ++(nmos::fields::persist(subscriptions.first->data) ? persistent : non_persistent);
+                    }
+                    os << "nmos_subscriptions{resources=\"";
+                    write_label_value(os, named.first);
+                    os << "\",persist=\"true\"} " << persistent << "\n";
+                    os << "nmos_subscriptions{resources=\"";
+                    write_label_value(os, named.first);
+                    os << "\",persist=\"false\"} " << non_persistent << "\n";
+                }
+
+                os << "# HELP nmos_resources_memory_bytes Approximate memory used by resources (including subscriptions and websocket grains).\n";
+                os << "# TYPE nmos_resources_memory_bytes gauge\n";
+                for (const auto& named : named_resources)
+                {
+                    os << "nmos_resources_memory_bytes{resources=\"";
+                    write_label_value(os, named.first);
+                    os << "\"} " << nmos::experimental::memory_usage(*named.second) << "\n";
+                }
+
+                // the largest nodes are easily found, e.g. with the PromQL expression topk(10, nmos_node_memory_bytes)
+                os << "# HELP nmos_node_memory_bytes Approximate memory used by each node and all its sub-resources.\n";
+                os << "# TYPE nmos_node_memory_bytes gauge\n";
+                for (const auto& named : named_resources)
+                {
+                    for (const auto& node : named.second->memory_usage.nodes)
+                    {
+                        os << "nmos_node_memory_bytes{resources=\"";
+                        write_label_value(os, named.first);
+                        os << "\",node_id=\"";
+                        write_label_value(os, node.first);
+                        os << "\"} " << node.second << "\n";
+                    }
+                }
+
+                // each websocket connection has a grain or an event queue, which accumulates the events waiting to be sent
+                os << "# HELP nmos_websocket_queued_events Total number of events waiting to be sent on all websocket connections.\n";
+                os << "# TYPE nmos_websocket_queued_events gauge\n";
+                std::vector<std::pair<size_t, size_t>> queued;
+                for (const auto& named : named_resources)
+                {
+                    size_t total = 0, most = 0;
+                    auto grains = named.second->get<tags::type>().equal_range(nmos::details::has_data(nmos::types::grain));
+                    for (; grains.first != grains.second; ++grains.first)
+                    {
+                        const size_t depth = nmos::fields::message_grain_data(grains.first->data).size();
+                        total += depth;
+                        most = (std::max)(most, depth);
+                    }
+                    if (named.second->event_queues)
+                    {
+                        std::lock_guard<std::mutex> lock(named.second->event_queues->mutex);
+                        for (const auto& queue : named.second->event_queues->queues)
+                        {
+                            const size_t depth = queue.second.events.size();
+                            total += depth;
+                            most = (std::max)(most, depth);
+                        }
+                    }
+                    queued.push_back({ total, most });
+                    os << "nmos_websocket_queued_events{resources=\"";
+                    write_label_value(os, named.first);
+                    os << "\"} " << total << "\n";
+                }
+
+                os << "# HELP nmos_websocket_queued_events_max Greatest number of events waiting to be sent on any one websocket connection.\n";
+                os << "# TYPE nmos_websocket_queued_events_max gauge\n";
+                for (size_t i = 0; i < named_resources.size(); ++i)
+                {
+                    os << "nmos_websocket_queued_events_max{resources=\"";
+                    write_label_value(os, named_resources[i].first);
+                    os << "\"} " << queued[i].second << "\n";
+                }
+
+                // the events are usually shared between the event queues of several websocket connections, so each is only counted once
+                os << "# HELP nmos_websocket_queued_events_memory_bytes Approximate memory used by the events waiting to be sent on all websocket connections.\n";
+                os << "# TYPE nmos_websocket_queued_events_memory_bytes gauge\n";
+                for (const auto& named : named_resources)
+                {
+                    size_t bytes = 0;
+                    auto grains = named.second->get<tags::type>().equal_range(nmos::details::has_data(nmos::types::grain));
+                    for (; grains.first != grains.second; ++grains.first)
+                    {
+                        bytes += nmos::experimental::approximate_memory_usage(nmos::fields::message_grain_data(grains.first->data));
+                    }
+                    if (named.second->event_queues)
+                    {
+                        std::unordered_set<const web::json::value*> counted;
+                        std::lock_guard<std::mutex> lock(named.second->event_queues->mutex);
+                        for (const auto& queue : named.second->event_queues->queues)
+                        {
+                            for (const auto& event : queue.second.events)
+                            {
+                                bytes += sizeof(event);
+                                if (counted.insert(event.get()).second) bytes += nmos::experimental::approximate_memory_usage(*event);
+                            }
+                        }
+                    }
+                    os << "nmos_websocket_queued_events_memory_bytes{resources=\"";
+                    write_label_value(os, named.first);
+                    os << "\"} " << bytes << "\n";
+                }
+
+                os << "# HELP nmos_query_ws_subscription_change_propagation_seconds Time from receiving each change to sending a Query API websocket message including it, by subscription.\n";
+                os << "# TYPE nmos_query_ws_subscription_change_propagation_seconds histogram\n";
+                for (const auto& named : named_resources)
+                {
+                    if (!named.second->event_queues) continue;
+                    std::lock_guard<std::mutex> lock(named.second->event_queues->mutex);
+                    for (const auto& latency : named.second->event_queues->latencies)
+                    {
+                        std::ostringstream labels;
+                        labels << "resources=\"";
+                        write_label_value(labels, named.first);
+                        labels << "\",subscription_id=\"";
+                        write_label_value(labels, latency.first);
+                        labels << "\"";
+                        latency.second.write(os, "nmos_query_ws_subscription_change_propagation_seconds", labels.str());
+                    }
+                }
+            }
+
+            // write the metrics of the log model, in the Prometheus text exposition format
+            // the log model mutex must be locked (shared or exclusive) by the caller
+            void write_log_model_metrics(std::ostream& os, const nmos::experimental::log_model& log_model)
+            {
+                size_t bytes = 0;
+                for (const auto& event : log_model.events)
+                {
+                    bytes += sizeof(log_event) + nmos::experimental::approximate_memory_usage(event.data) + event.id.size() * sizeof(utility::char_t);
+                    for (const auto& category : event.categories)
+                    {
+                        bytes += sizeof(category) + category.size() * sizeof(utility::char_t);
+                    }
+                }
+
+                os << "# HELP nmos_log_events Count of log events cached for the Logging API.\n";
+                os << "# TYPE nmos_log_events gauge\n";
+                os << "nmos_log_events " << log_model.events.size() << "\n";
+
+                os << "# HELP nmos_log_events_memory_bytes Approximate memory used by the log events cached for the Logging API.\n";
+                os << "# TYPE nmos_log_events_memory_bytes gauge\n";
+                os << "nmos_log_events_memory_bytes " << bytes << "\n";
+            }
+
+            // write the statistics of the memory allocator, if available, in the Prometheus text exposition format
+            void write_allocator_metrics(std::ostream& os)
+            {
+                allocator_statistics statistics;
+                if (!get_allocator_statistics(statistics)) return;
+
+                os << "# HELP nmos_allocator_allocated_bytes Bytes allocated by the application from the memory allocator.\n";
+                os << "# TYPE nmos_allocator_allocated_bytes gauge\n";
+                os << "nmos_allocator_allocated_bytes{allocator=\"" << allocator_name() << "\"} " << statistics.allocated << "\n";
+
+                os << "# HELP nmos_allocator_resident_bytes Bytes held by the memory allocator, including free memory not yet returned to the operating system.\n";
+                os << "# TYPE nmos_allocator_resident_bytes gauge\n";
+                os << "nmos_allocator_resident_bytes{allocator=\"" << allocator_name() << "\"} " << statistics.resident << "\n";
+            }
+
+            // make the diagnostics of each Query API and Events API websocket connection, e.g. to tell a slow client from a registry that is behind
+            // the model mutex must be locked (shared or exclusive) by the caller
+            web::json::value make_websockets_body(const nmos::experimental::metrics& metrics, const named_resources& named_resources)
+            {
+                using web::json::value;
+                using web::json::value_of;
+
+                const auto now = std::chrono::steady_clock::now();
+                const auto tai_now = tai_clock::now();
+
+                auto seconds_since = [&now](const std::chrono::steady_clock::time_point& since)
+                {
+                    return (std::chrono::steady_clock::time_point::max)() != since
+                        ? value(std::chrono::duration_cast<std::chrono::duration<double>>(now - since).count())
+                        : value::null();
+                };
+
+                auto add_sent = [&metrics, &seconds_since](value& connection, const nmos::id& id)
+                {
+                    websocket_connection_metrics sent;
+                    if (!metrics.websockets.find(id, sent)) return;
+                    connection[U("messages_sent")] = value(uint64_t(sent.messages_sent));
+                    connection[U("bytes_sent")] = value(uint64_t(sent.bytes_sent));
+                    connection[U("sending")] = seconds_since(sent.sending);
+                };
+
+                auto result = value::array();
+
+                for (const auto& named : named_resources)
+                {
+                    // Query API websocket connections each have an event queue
+                    if (named.second->event_queues)
+                    {
+                        std::lock_guard<std::mutex> lock(named.second->event_queues->mutex);
+                        for (const auto& queue_ : named.second->event_queues->queues)
+                        {
+                            const auto& queue = queue_.second;
+                            auto connection = value_of({
+                                { U("id"), queue.id },
+                                { U("resources"), named.first },
+                                { U("subscription_id"), queue.subscription_id },
+                                { U("pending_events"), queue.events.size() },
+                                { U("oldest_pending_event_age"), seconds_since(queue.ingress) },
+                                { U("throttled"), (tai_clock::time_point::max)() != queue.scheduled && tai_now < queue.scheduled }
+                            });
+                            add_sent(connection, queue.id);
+                            web::json::push_back(result, std::move(connection));
+                        }
+                    }
+
+                    // Events API websocket connections each have a grain, whose events have no ingress time
+                    auto grains = named.second->get<tags::type>().equal_range(nmos::details::has_data(nmos::types::grain));
+                    for (; grains.first != grains.second; ++grains.first)
+                    {
+                        const auto& grain = *grains.first;
+                        const auto subscription_id = nmos::fields::subscription_id(grain.data);
+                        const auto subscription = find_resource(*named.second, { subscription_id, nmos::types::subscription });
+                        const auto max_update_rate_ms = named.second->end() != subscription && subscription->has_data()
+                            ? nmos::experimental::fields::max_update_rate_ms(subscription->data)
+                            : 0;
+                        auto connection = value_of({
+                            { U("id"), grain.id },
+                            { U("resources"), named.first },
+                            { U("subscription_id"), subscription_id },
+                            { U("pending_events"), nmos::fields::message_grain_data(grain.data).size() },
+                            { U("oldest_pending_event_age"), value::null() },
+                            { U("throttled"), 0 != max_update_rate_ms },
+                            { U("max_update_rate_ms"), max_update_rate_ms }
+                        });
+                        add_sent(connection, grain.id);
+                        web::json::push_back(result, std::move(connection));
+                    }
+                }
+
+                return result;
+            }
+
+            web::json::value make_allocator_body()
+            {
+                using web::json::value_of;
+
+                allocator_statistics statistics;
+                if (!get_allocator_statistics(statistics))
+                {
+                    return value_of({ { U("allocator"), utility::s2us(allocator_name()) } });
+                }
+                return value_of({
+                    { U("allocator"), utility::s2us(allocator_name()) },
+                    { U("allocated"), statistics.allocated },
+                    { U("resident"), statistics.resident }
+                });
+            }
+
+            web::http::experimental::listener::api_router make_metrics_api(nmos::base_model& model, const nmos::experimental::log_model* log_model, const named_resources& named_resources, slog::base_gate& gate)
+            {
+                using namespace web::http::experimental::listener::api_router_using_declarations;
+
+                api_router metrics_api;
+
+                metrics_api.support(U("/?"), methods::GET, [](http_request, http_response res, const string_t&, const route_parameters&)
+                {
+                    set_reply(res, status_codes::OK, nmos::make_sub_routes_body({ U("metrics/"), U("memory/"), U("websockets/") }, res));
+                    return pplx::task_from_result(true);
+                });
+
+                metrics_api.support(U("/metrics/?"), methods::GET, [&model, log_model, named_resources](http_request, http_response res, const string_t&, const route_parameters&)
+                {
+                    std::ostringstream os;
+
+                    // the metrics recorded by the listeners and other threads don't require the model mutex
+                    model.metrics.write(os);
+
+#ifdef NMOS_CPP_INSTRUMENT_MUTEX
+                    model.mutex.write_statistics(os, "model");
+#endif
+
+                    {
+                        auto lock = model.read_lock();
+                        write_model_metrics(os, named_resources);
+                    }
+
+                    if (log_model)
+                    {
+                        auto lock = log_model->read_lock();
+                        write_log_model_metrics(os, *log_model);
+                    }
+
+                    write_allocator_metrics(os);
+
+                    set_reply(res, status_codes::OK, utility::s2us(os.str()), U("text/plain; version=0.0.4"));
+                    return pplx::task_from_result(true);
+                });
+
+                metrics_api.support(U("/websockets/?"), methods::GET, [&model, named_resources](http_request, http_response res, const string_t&, const route_parameters&)
+                {
+                    auto lock = model.read_lock();
+                    set_reply(res, status_codes::OK, make_websockets_body(model.metrics, named_resources));
+                    return pplx::task_from_result(true);
+                });
+
+                metrics_api.support(U("/memory/?"), methods::GET, [](http_request, http_response res, const string_t&, const route_parameters&)
+                {
+                    set_reply(res, status_codes::OK, make_allocator_body());
+                    return pplx::task_from_result(true);
+                });
+
+                // after a burst of activity, e.g. a registration storm, the memory allocator may hold a lot of free memory, which can be
+                // returned to the operating system on demand, rather than the allocator being configured to do so more eagerly all the time
+                metrics_api.support(U("/memory/?"), methods::POST, [&gate](http_request, http_response res, const string_t&, const route_parameters&)
+                {
+                    const auto before = make_allocator_body();
+                    if (!release_free_memory())
+                    {
+                        set_error_reply(res, status_codes::NotImplemented, U("Not Implemented; the memory allocator does not support releasing free memory"));
+                        return pplx::task_from_result(true);
+                    }
+                    const auto after = make_allocator_body();
+
+                    slog::log<slog::severities::info>(gate, SLOG_FLF) << "Released free memory held by the memory allocator: " << allocator_name();
+
+                    set_reply(res, status_codes::OK, web::json::value_of({ { U("before"), before }, { U("after"), after } }));
+                    return pplx::task_from_result(true);
+                });
+
+                return metrics_api;
+            }
+        }
+
+        web::http::experimental::listener::api_router make_metrics_api(nmos::registry_model& model, slog::base_gate& gate)
+        {
+            return details::make_metrics_api(model, nullptr, { { U("registry"), &model.registry_resources }, { U("self"), &model.node_resources } }, gate);
+        }
+
+        web::http::experimental::listener::api_router make_metrics_api(nmos::registry_model& model, const nmos::experimental::log_model& log_model, slog::base_gate& gate)
+        {
+            return details::make_metrics_api(model, &log_model, { { U("registry"), &model.registry_resources }, { U("self"), &model.node_resources } }, gate);
+        }
+
+        web::http::experimental::listener::api_router make_metrics_api(nmos::node_model& model, slog::base_gate& gate)
+        {
+            return details::make_metrics_api(model, nullptr, { { U("node"), &model.node_resources }, { U("connection"), &model.connection_resources }, { U("events"), &model.events_resources } }, gate);
+        }
+
+        web::http::experimental::listener::api_router make_metrics_api(nmos::node_model& model, const nmos::experimental::log_model& log_model, slog::base_gate& gate)
+        {
+            return details::make_metrics_api(model, &log_model, { { U("node"), &model.node_resources }, { U("connection"), &model.connection_resources }, { U("events"), &model.events_resources } }, gate);
+        }
+    }
+}
@@ -0,0 +1,34 @@
+#ifndef NMOS_METRICS_API_H
+#define NMOS_METRICS_API_H
+
+#include "cpprest/api_router.h"
+
+namespace slog
+{
+    class base_gate;
+}
+
+// This is an experimental extension to expose metrics via a REST API, in the Prometheus text exposition format
+// See https://prometheus.io/docs/instrumenting/exposition_formats/
+namespace nmos
+{
+    struct node_model;
+    struct registry_model;
+
+    namespace experimental
+    {
+        struct log_model;
+
+        // the metrics include the response counts and latency histograms recorded by listeners constructed with the model's metrics
+        // (see nmos::make_api_listener), as well as the resource counts, subscription counts and websocket queue depths and memory of the model,
+        // the count and memory of the log events, when the log model is specified, and the statistics of the memory allocator (see nmos/allocator.h)
+        // the /memory endpoint also allows free memory held by the memory allocator to be released, with a POST request
+        // the /websockets endpoint lists the pending events, throttling, and messages and bytes sent, of each Query API and Events API websocket connection
+        web::http::experimental::listener::api_router make_metrics_api(nmos::registry_model& model, slog::base_gate& gate);
+        web::http::experimental::listener::api_router make_metrics_api(nmos::registry_model& model, const nmos::experimental::log_model& log_model, slog::base_gate& gate);
+        web::http::experimental::listener::api_router make_metrics_api(nmos::node_model& model, slog::base_gate& gate);
+        web::http::experimental::listener::api_router make_metrics_api(nmos::node_model& model, const nmos::experimental::log_model& log_model, slog::base_gate& gate);
+    }
+}
+
+#endif
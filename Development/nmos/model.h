@@ -1,6 +1,8 @@
 #ifndef NMOS_MODEL_H
 #define NMOS_MODEL_H
 
+#include <memory>
+#include "nmos/metrics.h"
 #include "nmos/mutex.h"
 #include "nmos/resources.h"
 #include "nmos/settings.h"
@@ -16,6 +18,8 @@ namespace nmos
 
         // condition to be used to wait for, and notify other threads about, changes to any member of the model
         // including the shutdown flag
+        // note, every waiting thread is woken by each notification, so waiters should use a cheap predicate (e.g. comparing
+        // most_recent_update or a grain update timestamp) and only take an exclusive/write lock when there is actually work to do
         mutable nmos::condition_variable condition;
 
         // condition to be used to wait until, and notify other threads when, shutdown is initiated
@@ -28,11 +32,33 @@ namespace nmos
         // flag indicating whether shutdown has been initiated
         bool shutdown = false;
 
+        // see get_settings_snapshot and update_settings_snapshot
+        std::shared_ptr<const nmos::experimental::settings_snapshot> typed_settings;
+
+        // experimental metrics, e.g. for the Metrics API
+        // note, these are recorded without locking the mutex
+        nmos::experimental::metrics metrics;
+
+        // experimental extension, a typed snapshot of the settings which are read on hot paths, which may be read without locking the mutex
+        // since it is published atomically, but must be rebuilt (with the exclusive/write lock) whenever the settings are changed
+        // until it has been built, a snapshot is made from the settings on every call, which requires at least the shared/read lock
+        // see nmos::experimental::settings_snapshot
+        std::shared_ptr<const nmos::experimental::settings_snapshot> get_settings_snapshot() const
+        {
+            auto snapshot = std::atomic_load(&typed_settings);
+            return snapshot ? snapshot : std::make_shared<const nmos::experimental::settings_snapshot>(settings);
+        }
+
+        void update_settings_snapshot()
+        {
+            std::atomic_store(&typed_settings, std::make_shared<const nmos::experimental::settings_snapshot>(settings));
+        }
+
         // convenience functions
         // (the mutex and conditions may be used directly as well)
 
-        nmos::read_lock read_lock() const { return nmos::read_lock{ mutex }; }
-        nmos::write_lock write_lock() const { return nmos::write_lock{ mutex }; }
+        nmos::read_lock read_lock(const nmos::lock_site& site = nmos::lock_site::current()) const { return nmos::make_read_lock(mutex, site); }
+        nmos::write_lock write_lock(const nmos::lock_site& site = nmos::lock_site::current()) const { return nmos::make_write_lock(mutex, site); }
         void notify() const { return condition.notify_all(); }
 
         template <class ReadOrWriteLock>
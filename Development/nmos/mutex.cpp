@@ -0,0 +1,72 @@
+#include "nmos/mutex.h"
+
+#ifdef NMOS_CPP_INSTRUMENT_MUTEX
+
+#include <sstream>
+#include "cpprest/asyncrt_utils.h" // for utility::conversions
+
+namespace nmos
+{
+    namespace details
+    {
+        lock_site_statistics& instrumented_mutex::statistics(const lock_site& site, bool shared)
+        {
+            const auto key = std::make_tuple(site.file, site.line, shared);
+            {
+                bst::shared_lock<bst::shared_mutex> lock(statistics_mutex);
+                auto found = sites.find(key);
+                if (sites.end() != found) return *found->second;
+            }
+            std::unique_lock<bst::shared_mutex> lock(statistics_mutex);
+            auto& inserted = sites[key];
+            if (!inserted) inserted.reset(new lock_site_statistics(site, shared));
+            return *inserted;
+        }
+
+        static std::string make_site_labels(const std::string& name, const lock_site_statistics& statistics)
+        {
+            // just the file name, not the whole path, keeps the labels readable
+            const std::string file(statistics.site.file);
+            const auto slash = file.find_last_of("/\\");
+
+            std::ostringstream labels;
+            labels << "mutex=\"";
+            experimental::details::write_label_value(labels, utility::conversions::to_string_t(name));
+            labels << "\",mode=\"" << (statistics.shared ? "shared" : "exclusive") << "\",site=\"";
+            experimental::details::write_label_value(labels, utility::conversions::to_string_t((std::string::npos != slash ? file.substr(slash + 1) : file) + ":" + std::to_string(statistics.site.line)));
+            labels << "\",function=\"";
+            experimental::details::write_label_value(labels, utility::conversions::to_string_t(statistics.site.function));
+            labels << "\"";
+            return labels.str();
+        }
+
+        void instrumented_mutex::write_statistics(std::ostream& os, const std::string& name) const
+        {
+            bst::shared_lock<bst::shared_mutex> lock(statistics_mutex);
+
+            os << "# HELP nmos_mutex_wait_seconds Time spent waiting to acquire each lock, by mutex, mode and call site.\n";
+            os << "# TYPE nmos_mutex_wait_seconds histogram\n";
+            for (const auto& site : sites)
+            {
+                site.second->wait.write(os, "nmos_mutex_wait_seconds", make_site_labels(name, *site.second));
+            }
+
+            os << "# HELP nmos_mutex_hold_seconds Time for which each lock was held, by mutex, mode and call site.\n";
+            os << "# TYPE nmos_mutex_hold_seconds histogram\n";
+            for (const auto& site : sites)
+            {
+                site.second->hold.write(os, "nmos_mutex_hold_seconds", make_site_labels(name, *site.second));
+            }
+
+            // the longest holders are easily found, e.g. with the PromQL expression topk(10, nmos_mutex_hold_max_seconds)
+            os << "# HELP nmos_mutex_hold_max_seconds Longest time for which a lock was held, by mutex, mode and call site.\n";
+            os << "# TYPE nmos_mutex_hold_max_seconds gauge\n";
+            for (const auto& site : sites)
+            {
+                os << "nmos_mutex_hold_max_seconds{" << make_site_labels(name, *site.second) << "} " << site.second->max_hold_microseconds.load(std::memory_order_relaxed) / 1e6 << "\n";
+            }
+        }
+    }
+}
+
+#endif
@@ -1,30 +1,225 @@
 #ifndef NMOS_MUTEX_H
 #define NMOS_MUTEX_H
 
+#include <chrono>
 #include <condition_variable>
+#include <utility>
 #include "bst/shared_mutex.h"
+#include "nmos/request_accounting.h"
+#include "nmos/tracepoints.h"
 
+#ifdef NMOS_CPP_INSTRUMENT_MUTEX
+#include <cstring>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <ostream>
+#include <tuple>
+#include "nmos/metrics.h" // for nmos::experimental::latency_histogram
+#endif
+
+// When NMOS_CPP_INSTRUMENT_MUTEX is defined, nmos::mutex records the time spent waiting for and holding each lock, by the call site
+// at which the lock was acquired, so that contention can be measured, e.g. via the Metrics API (see nmos/metrics_api.h)
+// Otherwise, nmos::mutex is simply bst::shared_mutex and the call site is discarded at no cost, unless it's needed for the tracepoints (see nmos/tracepoints.h)
 namespace nmos
 {
+    // the source location at which a lock is acquired, rather like C++20 std::source_location
+    // note, when used as a default argument, lock_site::current() is evaluated at the call site
+    struct lock_site
+    {
+        const char* file;
+        int line;
+        const char* function;
+
+#if (defined(NMOS_CPP_INSTRUMENT_MUTEX) || defined(NMOS_CPP_USDT)) && (defined(__GNUC__) || defined(__clang__) || (defined(_MSC_VER) && _MSC_VER >= 1926))
+        static lock_site current(const char* file = __builtin_FILE(), int line = __builtin_LINE(), const char* function = __builtin_FUNCTION()) { return{ file, line, function }; }
+#else
+        static lock_site current() { return{ "", 0, "" }; }
+#endif
+    };
+
+    namespace details
+    {
+        // acquire a lock, firing the tracepoints, and recording the time spent waiting for it for the request being handled on this thread, if any
+        // (see nmos/tracepoints.h and nmos/request_accounting.h)
+        template <typename Lock, typename... Args>
+        inline Lock make_lock(const lock_site& site, bool shared, Args&&... args)
+        {
+            (void)site; (void)shared; // only used by the tracepoints
+            NMOS_CPP_TRACE(lock_acquire, site.file, site.line, shared ? 1 : 0);
+            auto& accounting = nmos::experimental::details::this_thread_request_accounting();
+            const auto start = 0 != accounting.depth ? std::chrono::steady_clock::now() : std::chrono::steady_clock::time_point{};
+            Lock lock{ std::forward<Args>(args)... };
+            if (0 != accounting.depth) accounting.lock_wait += std::chrono::duration_cast<std::chrono::microseconds>(std::chrono::steady_clock::now() - start);
+            NMOS_CPP_TRACE(lock_acquired, site.file, site.line, shared ? 1 : 0);
+            return lock;
+        }
+    }
+
+#ifndef NMOS_CPP_INSTRUMENT_MUTEX
     typedef bst::shared_mutex mutex;
 
     typedef bst::shared_lock<mutex> read_lock;
     typedef std::unique_lock<mutex> write_lock;
 
+    inline read_lock make_read_lock(nmos::mutex& mutex, const lock_site& site) { return details::make_lock<read_lock>(site, true, mutex); }
+    inline write_lock make_write_lock(nmos::mutex& mutex, const lock_site& site) { return details::make_lock<write_lock>(site, false, mutex); }
+#else
+    namespace details
+    {
+        // the statistics of the shared or exclusive locks acquired at one call site
+        struct lock_site_statistics
+        {
+            lock_site_statistics(const lock_site& site, bool shared) : site(site), shared(shared), max_hold_microseconds(0) {}
+
+            void record_hold(std::chrono::microseconds held)
+            {
+                hold.record(held);
+                auto max_hold = max_hold_microseconds.load(std::memory_order_relaxed);
+                while (max_hold < held.count() && !max_hold_microseconds.compare_exchange_weak(max_hold, held.count(), std::memory_order_relaxed)) {}
+            }
+
+            const lock_site site;
+            const bool shared;
+            experimental::latency_histogram wait;
+            experimental::latency_histogram hold;
+            std::atomic<long long> max_hold_microseconds;
+        };
+
+        // a shared mutex which, used with instrumented_lock, records the lock statistics of each call site
+        class instrumented_mutex
+        {
+        public:
+            // Lockable and SharedLockable, although locks acquired directly like this aren't recorded
+            void lock() { mutex.lock(); }
+            bool try_lock() { return mutex.try_lock(); }
+            void unlock() { mutex.unlock(); }
+            void lock_shared() { mutex.lock_shared(); }
+            bool try_lock_shared() { return mutex.try_lock_shared(); }
+            void unlock_shared() { mutex.unlock_shared(); }
+
+            // find or insert the statistics of the specified call site
+            lock_site_statistics& statistics(const lock_site& site, bool shared);
+
+            // write the statistics of every call site, in the Prometheus text exposition format
+            void write_statistics(std::ostream& os, const std::string& name) const;
+
+        private:
+            // call sites are compared by file name rather than pointer, since the same string literal may have different addresses in different translation units
+            struct site_less
+            {
+                bool operator()(const std::tuple<const char*, int, bool>& lhs, const std::tuple<const char*, int, bool>& rhs) const
+                {
+                    if (std::get<1>(lhs) != std::get<1>(rhs)) return std::get<1>(lhs) < std::get<1>(rhs);
+                    if (std::get<2>(lhs) != std::get<2>(rhs)) return std::get<2>(lhs) < std::get<2>(rhs);
+                    return std::get<0>(lhs) != std::get<0>(rhs) && 0 > std::strcmp(std::get<0>(lhs), std::get<0>(rhs));
+                }
+            };
+
+            bst::shared_mutex mutex;
+
+            // the statistics mutex only protects the set of call sites, and is only locked exclusively the first time each call site acquires a lock
+            mutable bst::shared_mutex statistics_mutex;
+            std::map<std::tuple<const char*, int, bool>, std::unique_ptr<lock_site_statistics>, site_less> sites;
+        };
+
+        // a lock, like bst::shared_lock (if Shared) or std::unique_lock, which records the wait time and hold time of each acquisition
+        template <bool Shared>
+        class instrumented_lock
+        {
+        public:
+            typedef instrumented_mutex mutex_type;
+            typedef std::chrono::steady_clock clock;
+
+            instrumented_lock() : m(nullptr), site(lock_site::current()), owns(false), statistics(nullptr) {}
+            explicit instrumented_lock(mutex_type& m, const lock_site& site = lock_site::current()) : m(&m), site(site), owns(false), statistics(nullptr) { lock(); }
+            instrumented_lock(mutex_type& m, std::defer_lock_t, const lock_site& site = lock_site::current()) : m(&m), site(site), owns(false), statistics(nullptr) {}
+            instrumented_lock(instrumented_lock&& other) : m(other.m), site(other.site), owns(other.owns), acquired_time(other.acquired_time), statistics(other.statistics) { other.m = nullptr; other.owns = false; }
+            instrumented_lock& operator=(instrumented_lock&& other)
+            {
+                if (this != &other)
+                {
+                    if (owns) unlock();
+                    m = other.m; site = other.site; owns = other.owns; acquired_time = other.acquired_time; statistics = other.statistics;
+                    other.m = nullptr; other.owns = false;
+                }
+                return *this;
+            }
+            ~instrumented_lock() { if (owns) unlock(); }
+
+            instrumented_lock(const instrumented_lock&) = delete;
+            instrumented_lock& operator=(const instrumented_lock&) = delete;
+
+            void lock()
+            {
+                const auto start = clock::now();
+                if (Shared) m->lock_shared(); else m->lock();
+                acquired(start);
+            }
+
+            bool try_lock()
+            {
+                const auto start = clock::now();
+                if (!(Shared ? m->try_lock_shared() : m->try_lock())) return false;
+                acquired(start);
+                return true;
+            }
+
+            void unlock()
+            {
+                const auto held = std::chrono::duration_cast<std::chrono::microseconds>(clock::now() - acquired_time);
+                owns = false;
+                if (Shared) m->unlock_shared(); else m->unlock();
+                statistics->record_hold(held);
+                auto& accounting = nmos::experimental::details::this_thread_request_accounting();
+                if (0 != accounting.depth) accounting.lock_hold += held;
+                NMOS_CPP_TRACE(lock_release, site.file, site.line, Shared ? 1 : 0, (long long)held.count());
+            }
+
+            bool owns_lock() const { return owns; }
+            explicit operator bool() const { return owns; }
+            mutex_type* mutex() const { return m; }
+
+        private:
+            void acquired(clock::time_point start)
+            {
+                acquired_time = clock::now();
+                owns = true;
+                if (nullptr == statistics) statistics = &m->statistics(site, Shared);
+                statistics->wait.record(std::chrono::duration_cast<std::chrono::microseconds>(acquired_time - start));
+            }
+
+            mutex_type* m;
+            lock_site site;
+            bool owns;
+            clock::time_point acquired_time;
+            lock_site_statistics* statistics;
+        };
+    }
+
+    typedef details::instrumented_mutex mutex;
+
+    typedef details::instrumented_lock<true> read_lock;
+    typedef details::instrumented_lock<false> write_lock;
+
+    inline read_lock make_read_lock(nmos::mutex& mutex, const lock_site& site) { return details::make_lock<read_lock>(site, true, mutex, site); }
+    inline write_lock make_write_lock(nmos::mutex& mutex, const lock_site& site) { return details::make_lock<write_lock>(site, false, mutex, site); }
+#endif
+
     typedef std::condition_variable_any condition_variable;
     typedef std::cv_status cv_status;
 
     template <typename Func>
-    auto with_read_lock(nmos::mutex& mutex, Func&& func) -> decltype(func())
+    auto with_read_lock(nmos::mutex& mutex, Func&& func, const lock_site& site = lock_site::current()) -> decltype(func())
     {
-        nmos::read_lock lock(mutex);
+        auto lock = make_read_lock(mutex, site);
         return func();
     }
 
     template <typename Func>
-    auto with_write_lock(nmos::mutex& mutex, Func&& func) -> decltype(func())
+    auto with_write_lock(nmos::mutex& mutex, Func&& func, const lock_site& site = lock_site::current()) -> decltype(func())
     {
-        nmos::write_lock lock(mutex);
+        auto lock = make_write_lock(mutex, site);
         return func();
     }
 }
@@ -1,6 +1,8 @@
 #include "nmos/node_api.h"
 
+#include <mutex>
 #include <boost/range/adaptor/transformed.hpp>
+#include "cpprest/json_utils.h" // for web::json::experimental::serialize_utf8
 #include "cpprest/json_validator.h"
 #include "nmos/api_downgrade.h"
 #include "nmos/api_utils.h"
@@ -44,12 +46,58 @@ namespace nmos
         return node_api;
     }
 
+    namespace details
+    {
+        // a pre-serialized Node API response body, and the entity-tag of the resources from which it was made
+        struct node_api_view
+        {
+            utility::string_t entity_tag;
+            std::string body; // UTF-8
+            std::size_t count;
+        };
+
+        // the most recent pre-serialized response body of the self resource and each resource list, for each API version,
+        // which is only rebuilt after the resources have been modified, i.e. when the entity-tag has changed,
+        // so that controllers and peer-to-peer registries polling the node don't cause the resources to be serialized again each time
+        // it is protected by its own mutex, since it is populated with only a shared/read lock on the resources
+        class node_api_views
+        {
+        public:
+            typedef std::pair<nmos::api_version, utility::string_t> key_type;
+
+            std::shared_ptr<const node_api_view> find(const key_type& key, const utility::string_t& entity_tag) const
+            {
+                std::lock_guard<std::mutex> lock(mutex);
+                auto found = views.find(key);
+                return views.end() != found && found->second->entity_tag == entity_tag ? found->second : std::shared_ptr<const node_api_view>();
+            }
+
+            void insert(const key_type& key, std::shared_ptr<const node_api_view> view)
+            {
+                std::lock_guard<std::mutex> lock(mutex);
+                views[key] = std::move(view);
+            }
+
+        private:
+            mutable std::mutex mutex;
+            std::map<key_type, std::shared_ptr<const node_api_view>> views;
+        };
+
+        static void set_view_reply(web::http::http_response& res, const node_api_view& view)
+        {
+            set_utf8_json_reply(res, web::http::status_codes::OK, view.body);
+            res.headers().add(web::http::header_names::etag, view.entity_tag);
+        }
+    }
+
     web::http::experimental::listener::api_router make_unmounted_node_api(const nmos::model& model, node_api_target_handler target_handler, slog::base_gate& gate_)
     {
         using namespace web::http::experimental::listener::api_router_using_declarations;
 
         api_router node_api;
 
+        const auto views = std::make_shared<details::node_api_views>();
+
         // check for supported API version
         const auto versions = with_read_lock(model.mutex, [&model] { return nmos::is04_versions::from_settings(model.settings); });
         node_api.support(U(".*"), details::make_api_version_handler(versions, gate_));
@@ -60,7 +108,7 @@ namespace nmos
             return pplx::task_from_result(true);
         });
 
-        node_api.support(U("/self/?"), methods::GET, [&model, &gate_](http_request req, http_response res, const string_t&, const route_parameters& parameters)
+        node_api.support(U("/self/?"), methods::GET, [&model, views, &gate_](http_request req, http_response res, const string_t&, const route_parameters& parameters)
         {
             nmos::api_gate gate(gate_, req, parameters);
             auto lock = model.read_lock();
@@ -73,8 +121,25 @@ namespace nmos
             {
                 if (nmos::is_permitted_downgrade(*resource, version))
                 {
+                    const auto entity_tag = details::make_resource_entity_tag(*resource);
+                    if (details::set_not_modified_reply(req, res, entity_tag))
+                    {
+                        slog::log<slog::severities::more_info>(gate, SLOG_FLF) << "Not modified";
+                        return pplx::task_from_result(true);
+                    }
+
+                    const details::node_api_views::key_type key{ version, U("self") };
+                    auto view = views->find(key, entity_tag);
+                    if (!view)
+                    {
+                        view.reset(new details::node_api_view{ entity_tag, web::json::experimental::serialize_utf8(nmos::downgrade(*resource, version)), 1 });
+                        views->insert(key, view);
+                    }
+
+                    lock.unlock();
+
                     slog::log<slog::severities::more_info>(gate, SLOG_FLF) << "Returning self resource: " << resource->id;
-                    set_reply(res, status_codes::OK, nmos::downgrade(*resource, version));
+                    details::set_view_reply(res, *view);
                 }
                 else
                 {
@@ -91,26 +156,42 @@ namespace nmos
             return pplx::task_from_result(true);
         });
 
-        node_api.support(U("/") + nmos::patterns::subresourceType.pattern + U("/?"), methods::GET, [&model, &gate_](http_request req, http_response res, const string_t&, const route_parameters& parameters)
+        node_api.support(U("/") + nmos::patterns::subresourceType.pattern + U("/?"), methods::GET, [&model, views, &gate_](http_request req, http_response res, const string_t&, const route_parameters& parameters)
         {
             nmos::api_gate gate(gate_, req, parameters);
             auto lock = model.read_lock();
             auto& resources = model.node_resources;
 
+            // the entity-tag changes whenever any resource changes, not only those of the requested type, but it's cheap to determine
+            const auto entity_tag = details::make_resources_entity_tag(resources);
+            if (details::set_not_modified_reply(req, res, entity_tag))
+            {
+                slog::log<slog::severities::more_info>(gate, SLOG_FLF) << "Not modified";
+                return pplx::task_from_result(true);
+            }
+
             const nmos::api_version version = nmos::parse_api_version(parameters.at(nmos::patterns::version.name));
             const string_t resourceType = parameters.at(nmos::patterns::subresourceType.name);
 
-            const auto match = [&](const nmos::resources::value_type& resource) { return resource.type == nmos::type_from_resourceType(resourceType) && nmos::is_permitted_downgrade(resource, version); };
-
-            size_t count = 0;
+            const details::node_api_views::key_type key{ version, resourceType };
+            auto view = views->find(key, entity_tag);
+            if (!view)
+            {
+                const auto match = [&](const nmos::resources::value_type& resource) { return resource.type == nmos::type_from_resourceType(resourceType) && nmos::is_permitted_downgrade(resource, version); };
 
-            set_reply(res, status_codes::OK,
-                web::json::serialize_if(resources,
+                std::shared_ptr<details::node_api_view> rebuilt(new details::node_api_view{ entity_tag, {}, 0 });
+                web::json::experimental::serialize_utf8_if(rebuilt->body, resources,
                     match,
-                    [&count, &version](const nmos::resources::value_type& resource) { ++count; return nmos::downgrade(resource, version); }),
-                web::http::details::mime_types::application_json);
+                    [&rebuilt, &version](const nmos::resources::value_type& resource) { ++rebuilt->count; return nmos::downgrade(resource, version); });
+
+                views->insert(key, rebuilt);
+                view = rebuilt;
+            }
 
-            slog::log<slog::severities::info>(gate, SLOG_FLF) << "Returning " << count << " matching " << resourceType;
+            lock.unlock();
+
+            slog::log<slog::severities::info>(gate, SLOG_FLF) << "Returning " << view->count << " matching " << resourceType;
+            details::set_view_reply(res, *view);
 
             return pplx::task_from_result(true);
         });
@@ -130,8 +211,16 @@ namespace nmos
             {
                 if (nmos::is_permitted_downgrade(*resource, version))
                 {
+                    const auto entity_tag = details::make_resource_entity_tag(*resource);
+                    if (details::set_not_modified_reply(req, res, entity_tag))
+                    {
+                        slog::log<slog::severities::more_info>(gate, SLOG_FLF) << "Not modified: " << resourceId;
+                        return pplx::task_from_result(true);
+                    }
+
                     slog::log<slog::severities::more_info>(gate, SLOG_FLF) << "Returning resource: " << resourceId;
                     set_reply(res, status_codes::OK, nmos::downgrade(*resource, version));
+                    res.headers().add(web::http::header_names::etag, entity_tag);
                 }
                 else
                 {
@@ -1,5 +1,8 @@
 #include "nmos/node_behaviour.h"
 
+#include <algorithm>
+#include <list>
+#include <map>
 #include "pplx/pplx_utils.h" // for pplx::complete_at
 #include "cpprest/http_client.h"
 #include "mdns/service_advertiser.h"
@@ -7,39 +10,59 @@
 #include "nmos/api_downgrade.h"
 #include "nmos/api_utils.h" // for nmos::type_from_resourceType
 #include "nmos/client_utils.h"
+#include "nmos/heartbeat_scheduler.h"
 #include "nmos/mdns.h"
 #include "nmos/model.h"
 #include "nmos/query_utils.h"
 #include "nmos/random.h"
 #include "nmos/rational.h"
 #include "nmos/slog.h"
-#include "nmos/thread_utils.h" // for wait_until, reverse_lock_guard
+#include "nmos/thread_utils.h" // for reverse_lock_guard
 #include "nmos/version.h"
 
 namespace nmos
 {
     namespace details
     {
+        void node_behaviour_thread(nmos::model& model, nmos::experimental::heartbeat_scheduler* heartbeat_scheduler, slog::base_gate& gate);
+
         // registered operation
-        void initial_registration(nmos::id& self_id, nmos::model& model, const nmos::id& grain_id, slog::base_gate& gate);
-        void registered_operation(const nmos::id& self_id, nmos::model& model, const nmos::id& grain_id, slog::base_gate& gate);
+
+        // experimental extension, the resources acknowledged by each Registration API, keyed by its base URI, so that after failing over to a Registration API
+        // on which the node is still registered, only the resources that have been added, modified or removed since then need to be registered again
+        typedef std::map<nmos::id, std::pair<nmos::type, web::json::value>> registered_resources;
+        typedef std::map<utility::string_t, registered_resources> registry_registrations;
+
+        void initial_registration(nmos::id& self_id, nmos::model& model, const nmos::id& grain_id, registry_registrations& registrations, slog::base_gate& gate);
+        void registered_operation(const nmos::id& self_id, nmos::model& model, const nmos::id& grain_id, nmos::experimental::heartbeat_scheduler* heartbeat_scheduler, registry_registrations& registrations, slog::base_gate& gate);
 
         // peer to peer operation
-        void peer_to_peer_operation(nmos::model& model, const nmos::id& grain_id, mdns::service_discovery& discovery, mdns::service_advertiser& advertiser, slog::base_gate& gate);
+        void peer_to_peer_operation(nmos::model& model, const nmos::id& grain_id, mdns::service_discovery& discovery, const nmos::experimental::service_cache* cache, mdns::service_advertiser& advertiser, slog::base_gate& gate);
 
         // service advertisement/discovery
         void advertise_node_service(const nmos::base_model& model, mdns::service_advertiser& advertiser);
-        bool discover_registration_services(nmos::base_model& model, mdns::service_discovery& discovery, slog::base_gate& gate, const pplx::cancellation_token& token = pplx::cancellation_token::none());
+        bool discover_registration_services(nmos::base_model& model, mdns::service_discovery& discovery, const nmos::experimental::service_cache* cache, slog::base_gate& gate, const pplx::cancellation_token& token = pplx::cancellation_token::none());
         bool has_discovered_registration_services(const nmos::model& model);
 
         // a (fake) subscription to keep track of all resource events
         nmos::resource make_node_behaviour_subscription(const nmos::id& id);
-        nmos::resource make_node_behaviour_grain(const nmos::id& id, const nmos::id& subscription_id);
+        nmos::resource make_node_behaviour_grain(const nmos::id& id, const nmos::id& subscription_id, bool coalesce_events);
+    }
+
+    void node_behaviour_thread(nmos::model& model, slog::base_gate& gate)
+    {
+        details::node_behaviour_thread(model, nullptr, gate);
+    }
+
+    // experimental extension, to share heartbeats between several node models in one process
+    void node_behaviour_thread(nmos::model& model, nmos::experimental::heartbeat_scheduler& heartbeat_scheduler, slog::base_gate& gate)
+    {
+        details::node_behaviour_thread(model, &heartbeat_scheduler, gate);
     }
 
-    void node_behaviour_thread(nmos::model& model, slog::base_gate& gate_)
+    void details::node_behaviour_thread(nmos::model& model, nmos::experimental::heartbeat_scheduler* heartbeat_scheduler, slog::base_gate& gate_)
     {
-        nmos::details::omanip_gate gate(gate_, nmos::stash_category(nmos::categories::node_behaviour));
+        nmos::details::omanip_gate gate(gate_, nmos::categories::node_behaviour);
 
         // The possible states of node behaviour represent the two primary modes (registered operation and peer-to-peer operation)
         // and a few hopefully ephemeral states as the node works through the "Standard Registration Sequences".
@@ -58,16 +81,34 @@ namespace nmos
         // These should have happened by now...
 
         // "3. The Node produces an mDNS advertisement of type '_nmos-node._tcp' in the '.local' domain as specified in Node API."
-        mdns::service_advertiser advertiser(gate);
+        // updates to the DNS-SD daemon are throttled (because otherwise it may report that it's having to do that itself)
+        // "to protect the network against excessive packet flooding due to software
+        // bugs or malicious attack, a Multicast DNS responder MUST NOT multicast a
+        // record on a given interface until at least one second has elapsed since
+        // the last time that record was multicast on that particular interface."
+        // see https://tools.ietf.org/html/rfc6762#section-6
+        // so a burst of resource events results in only one update of the 'ver_' TXT records per interval
+        const auto advertisement_update_interval = with_read_lock(model.mutex, [&] { return std::chrono::milliseconds(nmos::experimental::fields::advertisement_update_interval(model.settings)); });
+        mdns::service_advertiser advertiser(gate, advertisement_update_interval);
         mdns::service_advertiser_guard advertiser_guard(advertiser);
         details::advertise_node_service(model, advertiser);
 
         // "If the chosen Registration API does not respond correctly at any time, another Registration API should be selected from the discovered list."
         // See https://github.com/AMWA-TV/nmos-discovery-registration/blob/v1.2/docs/3.1.%20Discovery%20-%20Registered%20Operation.md
         mdns::service_discovery discovery(gate);
+        // experimental extension, to keep the discovered list up-to-date by continuously browsing, so that failover need not wait for a fresh discovery
+        std::unique_ptr<nmos::experimental::service_cache> cache;
+        with_read_lock(model.mutex, [&]
+        {
+            auto& settings = model.settings;
+            if (nmos::experimental::fields::registration_services_cache(settings) && nmos::service_priorities::no_priority != nmos::fields::highest_pri(settings))
+            {
+                cache.reset(new nmos::experimental::service_cache(discovery, nmos::service_types::registration, utility::us2s(nmos::fields::domain(settings)), nmos::is04_versions::from_settings(settings), { nmos::fields::highest_pri(settings), nmos::fields::lowest_pri(settings) }, { nmos::get_service_protocol(settings) }));
+            }
+        });
         // hmm, it seems inefficient to store the discovered list in settings, when it's currently only used by this thread, but TR-1001-1:2018 insists
         // "Media Nodes should, through product-specific means, provide a status parameter indicating which registration service is currently in use."
-        with_write_lock(model.mutex, [&model] { model.settings[nmos::fields::registration_services] = web::json::value::array(); });
+        with_write_lock(model.mutex, [&model] { model.settings[nmos::fields::registration_services] = web::json::value::array(); model.update_settings_snapshot(); });
 
         nmos::details::seed_generator discovery_backoff_seeder;
         std::default_random_engine discovery_backoff_engine(discovery_backoff_seeder);
@@ -80,7 +121,7 @@ namespace nmos
             auto subscription_id = nmos::make_id();
 
             insert_resource(model.node_resources, details::make_node_behaviour_subscription(subscription_id));
-            insert_resource(model.node_resources, details::make_node_behaviour_grain(grain_id, subscription_id));
+            insert_resource(model.node_resources, details::make_node_behaviour_grain(grain_id, subscription_id, nmos::experimental::fields::registration_coalesce_events(model.settings)));
         });
 
         // there should be exactly one node resource, but it may not have been added yet
@@ -88,6 +129,9 @@ namespace nmos
         // during initial registration for use in registered operation
         nmos::id self_id;
 
+        // the resources acknowledged by each Registration API are only accessed by this thread, and its background tasks with the model lock
+        details::registry_registrations registrations;
+
         // continue until the server is being shut down
         for (;;)
         {
@@ -107,7 +151,7 @@ namespace nmos
                 }
 
                 // "4. The Node performs a DNS-SD browse for services of type '_nmos-registration._tcp' as specified."
-                if (details::discover_registration_services(model, discovery, gate))
+                if (details::discover_registration_services(model, discovery, cache.get(), gate))
                 {
                     mode = initial_discovery == mode ? initial_registration : registered_operation;
 
@@ -126,7 +170,7 @@ namespace nmos
 
             case initial_registration:
                 // "5. The Node registers itself with the Registration API by taking the object it holds under the Node API's /self resource and POSTing this to the Registration API."
-                details::initial_registration(self_id, model, grain_id, gate);
+                details::initial_registration(self_id, model, grain_id, registrations, gate);
 
                 if (details::has_discovered_registration_services(model))
                 {
@@ -143,7 +187,7 @@ namespace nmos
             case registered_operation:
                 // "6. The Node persists itself in the registry by issuing heartbeats."
                 // "7. The Node registers its other resources (from /devices, /sources etc) with the Registration API."
-                details::registered_operation(self_id, model, grain_id, gate);
+                details::registered_operation(self_id, model, grain_id, heartbeat_scheduler, registrations, gate);
 
                 if (details::has_discovered_registration_services(model))
                 {
@@ -160,7 +204,7 @@ namespace nmos
                 break;
 
             case peer_to_peer_operation:
-                details::peer_to_peer_operation(model, grain_id, discovery, advertiser, gate);
+                details::peer_to_peer_operation(model, grain_id, discovery, cache.get(), advertiser, gate);
 
                 if (details::has_discovered_registration_services(model))
                 {
@@ -191,16 +235,30 @@ namespace nmos
         }
 
         // query DNS Service Discovery for any Registration API in the specified browse domain, having priority in the specified range
+        // (using the cached list if there is one and it isn't empty)
         // otherwise, after timeout or cancellation, returning the fallback registration service
-        web::json::value discover_registration_services(mdns::service_discovery& discovery, const std::string& browse_domain, const std::set<nmos::api_version>& versions, const std::pair<nmos::service_priority, nmos::service_priority>& priorities, const std::set<nmos::service_protocol>& protocols, const web::uri& fallback_registration_service, slog::base_gate& gate, const std::chrono::steady_clock::duration& timeout, const pplx::cancellation_token& token = pplx::cancellation_token::none())
+        web::json::value discover_registration_services(mdns::service_discovery& discovery, const nmos::experimental::service_cache* cache, const std::string& browse_domain, const std::set<nmos::api_version>& versions, const std::pair<nmos::service_priority, nmos::service_priority>& priorities, const std::set<nmos::service_protocol>& protocols, const web::uri& fallback_registration_service, slog::base_gate& gate, const std::chrono::steady_clock::duration& timeout, const pplx::cancellation_token& token = pplx::cancellation_token::none())
         {
             std::list<web::uri> registration_services;
 
             if (nmos::service_priorities::no_priority != priorities.first)
             {
-                slog::log<slog::severities::info>(gate, SLOG_FLF) << "Attempting discovery of a Registration API";
+                if (cache)
+                {
+                    registration_services = cache->services();
+
+                    if (!registration_services.empty())
+                    {
+                        slog::log<slog::severities::info>(gate, SLOG_FLF) << "Found " << registration_services.size() << " cached Registration API(s)";
+                    }
+                }
+
+                if (registration_services.empty())
+                {
+                    slog::log<slog::severities::info>(gate, SLOG_FLF) << "Attempting discovery of a Registration API";
 
-                registration_services = nmos::experimental::resolve_service(discovery, nmos::service_types::registration, browse_domain, versions, priorities, protocols, true, timeout, token).get();
+                    registration_services = nmos::experimental::resolve_service(discovery, nmos::service_types::registration, browse_domain, versions, priorities, protocols, true, timeout, token).get();
+                }
 
                 if (!registration_services.empty())
                 {
@@ -237,7 +295,7 @@ namespace nmos
         }
 
         // query DNS Service Discovery for any Registration API based on settings
-        bool discover_registration_services(nmos::base_model& model, mdns::service_discovery& discovery, slog::base_gate& gate, const pplx::cancellation_token& token)
+        bool discover_registration_services(nmos::base_model& model, mdns::service_discovery& discovery, const nmos::experimental::service_cache* cache, slog::base_gate& gate, const pplx::cancellation_token& token)
         {
             std::string browse_domain;
             std::set<nmos::api_version> versions;
@@ -260,8 +318,8 @@ namespace nmos
             });
 
             slog::log<slog::severities::more_info>(gate, SLOG_FLF) << "Trying Registration API discovery for about " << std::fixed << std::setprecision(3) << (double)timeout << " seconds";
-            auto registration_services = discover_registration_services(discovery, browse_domain, versions, priorities, protocols, fallback_registration_service, gate, std::chrono::seconds(timeout), token);
-            with_write_lock(model.mutex, [&] { model.settings[nmos::fields::registration_services] = registration_services; });
+            auto registration_services = discover_registration_services(discovery, cache, browse_domain, versions, priorities, protocols, fallback_registration_service, gate, std::chrono::seconds(timeout), token);
+            with_write_lock(model.mutex, [&] { model.settings[nmos::fields::registration_services] = registration_services; model.update_settings_snapshot(); });
             model.notify();
 
             return !web::json::empty(registration_services);
@@ -312,7 +370,7 @@ namespace nmos
             return{ nmos::is04_versions::v1_3, nmos::types::subscription, data, true };
         }
 
-        nmos::resource make_node_behaviour_grain(const nmos::id& id, const nmos::id& subscription_id)
+        nmos::resource make_node_behaviour_grain(const nmos::id& id, const nmos::id& subscription_id, bool coalesce_events)
         {
             using web::json::value;
             value data;
@@ -320,6 +378,8 @@ namespace nmos
             data[nmos::fields::subscription_id] = value::string(subscription_id);
             data[nmos::fields::message] = details::make_grain(nmos::make_id(), subscription_id, node_behaviour_topic);
             nmos::fields::message_grain_data(data) = value::array();
+            // optionally, coalesce the pending resource events, since only the most recent state of each resource needs to be registered
+            data[nmos::experimental::fields::coalesce_events] = value::boolean(coalesce_events);
             return{ nmos::is04_versions::v1_3, nmos::types::grain, data, true };
         }
 
@@ -458,8 +518,57 @@ namespace nmos
             return config;
         }
 
+        // experimental extension, to retry registration requests when the Registration API is busy, e.g. because every node is re-registering after it was restarted,
+        // and responds 503 (Service Unavailable) with a Retry-After header (see nmos::experimental::fields::registration_admission_limit)
+        struct registration_busy_policy
+        {
+            int retries;
+            double backoff_max;
+            double backoff_factor;
+        };
+
+        registration_busy_policy make_registration_busy_policy(const nmos::settings& settings)
+        {
+            return{ nmos::experimental::fields::registration_busy_retries(settings), (double)nmos::fields::discovery_backoff_max(settings), nmos::fields::discovery_backoff_factor(settings) };
+        }
+
+        // make an asynchronous request on the Registration API specified by the client, and while it responds 503 (Service Unavailable) with a Retry-After header,
+        // wait for the specified delay plus a random jitter up to an exponentially increasing back-off, so that the retries of many nodes are spread out, and try again,
+        // up to the specified number of times, after which the response is returned to be handled like any other server error
+        pplx::task<web::http::http_response> request_with_busy_retries(web::http::client::http_client client, const web::http::method& method, const utility::string_t& path, const web::json::value& body, const registration_busy_policy& busy, slog::base_gate& gate, const pplx::cancellation_token& token, int attempt = 0, double backoff = 0)
+        {
+            web::http::http_request request(method);
+            request.set_request_uri(path);
+            if (!body.is_null()) request.set_body(body);
+
+            return client.request(request, token).then([=, &gate](web::http::http_response response)
+            {
+                unsigned int retry_after = 0;
+                if (web::http::status_codes::ServiceUnavailable != response.status_code()
+                    || attempt >= busy.retries
+                    || !response.headers().match(web::http::header_names::retry_after, retry_after)
+                    || 0 == retry_after)
+                {
+                    return pplx::task_from_result(response);
+                }
+
+                const auto next_backoff = (std::min)((std::max)((double)retry_after, backoff * busy.backoff_factor), (std::max)((double)retry_after, busy.backoff_max));
+
+                nmos::details::seed_generator busy_jitter_seeder;
+                std::default_random_engine busy_jitter_engine(busy_jitter_seeder);
+                const auto delay = retry_after + std::uniform_real_distribution<>(0, next_backoff)(busy_jitter_engine);
+
+                slog::log<slog::severities::warning>(gate, SLOG_FLF) << "Registration API is busy; waiting to retry for about " << std::fixed << std::setprecision(3) << delay << " seconds";
+
+                return pplx::complete_after(std::chrono::duration<double>(delay), token).then([=, &gate]
+                {
+                    return request_with_busy_retries(client, method, path, body, busy, gate, token, attempt + 1, next_backoff);
+                });
+            });
+        }
+
         // make an asynchronous POST or DELETE request on the Registration API specified by the client for the specified resource event
-        pplx::task<void> request_registration(web::http::client::http_client client, const web::json::value& event, slog::base_gate& gate, const pplx::cancellation_token& token = pplx::cancellation_token::none())
+        pplx::task<void> request_registration(web::http::client::http_client client, const web::json::value& event, const registration_busy_policy& busy, slog::base_gate& gate, const pplx::cancellation_token& token = pplx::cancellation_token::none())
         {
             // base uri should be like http://example.api.com/x-nmos/registration/{version}
             const auto registry_version = parse_api_version(web::uri::split_path(client.base_uri().path()).back());
@@ -484,7 +593,7 @@ namespace nmos
 
                 auto body = make_registration_request_body(id_type.second, event.at(U("post")), registry_version);
 
-                return client.request(web::http::methods::POST, U("/resource"), body, token).then([=, &gate](web::http::http_response response) mutable
+                return request_with_busy_retries(client, web::http::methods::POST, U("/resource"), body, busy, gate, token).then([=, &gate](web::http::http_response response) mutable
                 {
                     // hmm, when I tried to make this a task-based continuation in order to just return the response_task argument (in most cases)
                     // the enclosing then call failed to compile
@@ -509,7 +618,7 @@ namespace nmos
                         // with the Node's view, an HTTP DELETE should be performed in this situation to explicitly clear the
                         // registry of the Node and any sub-resources."
 
-                        return client.request(web::http::methods::DEL, U("/resource/") + path, token).then([=, &gate](web::http::http_response response) mutable
+                        return request_with_busy_retries(client, web::http::methods::DEL, U("/resource/") + path, {}, busy, gate, token).then([=, &gate](web::http::http_response response) mutable
                         {
                             if (web::http::status_codes::NoContent == response.status_code())
                             {
@@ -523,7 +632,7 @@ namespace nmos
                             slog::log<slog::severities::info>(gate, SLOG_FLF) << "Re-requesting registration creation for " << id_type;
 
                             // "A new Node registration after this point should result in the correct 201 response code."
-                            return client.request(web::http::methods::POST, U("/resource"), body, token);
+                            return request_with_busy_retries(client, web::http::methods::POST, U("/resource"), body, busy, gate, token);
                         });
                     }
                     else
@@ -553,7 +662,7 @@ namespace nmos
 
                 auto body = make_registration_request_body(id_type.second, event.at(U("post")), registry_version);
 
-                return client.request(web::http::methods::POST, U("/resource"), body, token).then([=, &gate](web::http::http_response response)
+                return request_with_busy_retries(client, web::http::methods::POST, U("/resource"), body, busy, gate, token).then([=, &gate](web::http::http_response response)
                 {
                     if (web::http::status_codes::OK == response.status_code())
                     {
@@ -569,7 +678,7 @@ namespace nmos
             {
                 slog::log<slog::severities::info>(gate, SLOG_FLF) << "Requesting registration deletion for " << id_type;
 
-                return client.request(web::http::methods::DEL, U("/resource/") + path, token).then([=, &gate](web::http::http_response response)
+                return request_with_busy_retries(client, web::http::methods::DEL, U("/resource/") + path, {}, busy, gate, token).then([=, &gate](web::http::http_response response)
                 {
                     if (web::http::status_codes::NoContent == response.status_code())
                     {
@@ -586,6 +695,233 @@ namespace nmos
             return pplx::task_from_result();
         }
 
+        // experimental extension, to register many resources in one request
+
+        // asynchronously determine whether the Registration API specified by the client supports the experimental bulk endpoint
+        pplx::task<bool> request_bulk_registration_support(web::http::client::http_client client, slog::base_gate& gate, const pplx::cancellation_token& token = pplx::cancellation_token::none())
+        {
+            return client.request(web::http::methods::GET, U("/"), token).then([](web::http::http_response response) -> pplx::task<bool>
+            {
+                if (web::http::status_codes::OK != response.status_code()) return pplx::task_from_result(false);
+
+                return response.extract_json().then([](const web::json::value& sub_routes)
+                {
+                    const auto& elements = sub_routes.as_array();
+                    return elements.end() != std::find(elements.begin(), elements.end(), web::json::value::string(U("bulk/")));
+                });
+            }, token).then([=, &gate](pplx::task<bool> finally)
+            {
+                bool supported = false;
+                try
+                {
+                    supported = finally.get();
+                }
+                catch (const std::exception& e)
+                {
+                    // errors interacting with the Registration API will be identified by the heartbeats and other requests
+                    slog::log<slog::severities::more_info>(gate, SLOG_FLF) << "Bulk registration support could not be determined: " << e.what();
+                }
+
+                slog::log<slog::severities::info>(gate, SLOG_FLF) << "Bulk registration is " << (supported ? "" : "not ") << "supported";
+                return supported;
+            });
+        }
+
+        // count the leading resource creation and update events, up to the specified limit, which can be handled by a bulk registration request
+        size_t count_bulk_registration_events(const web::json::value& events, size_t limit)
+        {
+            size_t count = 0;
+            for (; count < limit && count < events.size(); ++count)
+            {
+                const auto event_type = get_resource_event_type(events.at(count));
+                if (!(resource_added_event == event_type || resource_unchanged_event == event_type || resource_modified_event == event_type)) break;
+            }
+            return count;
+        }
+
+        // make an asynchronous POST request on the bulk endpoint of the Registration API specified by the client for the specified number of resource events
+        // which must all be creation or update events
+        pplx::task<void> request_bulk_registration(web::http::client::http_client client, const web::json::value& events, size_t count, const registration_busy_policy& busy, slog::base_gate& gate, const pplx::cancellation_token& token = pplx::cancellation_token::none())
+        {
+            // base uri should be like http://example.api.com/x-nmos/registration/{version}
+            const auto registry_version = parse_api_version(web::uri::split_path(client.base_uri().path()).back());
+
+            std::vector<std::pair<nmos::id, nmos::type>> id_types;
+            std::vector<web::json::value> bodies;
+            for (size_t index = 0; index < count; ++index)
+            {
+                const auto& event = events.at(index);
+                id_types.push_back(get_resource_event_resource(node_behaviour_topic, event));
+                bodies.push_back(make_registration_request_body(id_types.back().second, event.at(U("post")), registry_version));
+            }
+
+            slog::log<slog::severities::info>(gate, SLOG_FLF) << "Requesting bulk registration for " << count << " resources";
+
+            return request_with_busy_retries(client, web::http::methods::POST, U("/bulk/resource"), web::json::value_from_elements(bodies), busy, gate, token).then([=, &gate](web::http::http_response response) -> pplx::task<void>
+            {
+                if (web::http::status_codes::OK != response.status_code())
+                {
+                    handle_registration_error_conditions(response, gate, "bulk");
+                    return pplx::task_from_result();
+                }
+
+                return response.extract_json().then([=, &gate](const web::json::value& results)
+                {
+                    bool server_error = false;
+
+                    try
+                    {
+                        // results are in the same order as the requests
+                        const auto& elements = results.as_array();
+                        auto id_type = id_types.begin();
+                        for (auto result = elements.begin(); elements.end() != result && id_types.end() != id_type; ++result, ++id_type)
+                        {
+                            const web::http::status_code code = result->at(U("code")).as_integer();
+
+                            // unlike individual registration, a creation request with a 200 'OK' response is not handled specially, since the registration
+                            // has been updated anyway, and any out of sync sub-resources will have been re-registered by the same bulk request
+                            if (web::http::status_codes::Created == code)
+                            {
+                                slog::log<slog::severities::more_info>(gate, SLOG_FLF) << "Registration created for " << *id_type;
+                            }
+                            else if (web::http::status_codes::OK == code)
+                            {
+                                slog::log<slog::severities::more_info>(gate, SLOG_FLF) << "Registration updated for " << *id_type;
+                            }
+                            else
+                            {
+                                // as with individual registration, a client (4xx) error is only logged, but a server (5xx) error indicates an issue with the registration service
+                                slog::log<slog::severities::error>(gate, SLOG_FLF) << "Registration bulk error for " << *id_type << ": " << code << " " << (result->has_field(U("error")) ? result->at(U("error")).serialize() : utility::string_t{});
+
+                                if (web::http::is_server_error_status_code(code)) server_error = true;
+                            }
+                        }
+                    }
+                    catch (const web::json::json_exception& e)
+                    {
+                        slog::log<slog::severities::error>(gate, SLOG_FLF) << "Registration bulk error: " << e.what();
+
+                        server_error = true;
+                    }
+
+                    if (server_error) throw registration_service_exception();
+                });
+            });
+        }
+
+        // get the super-resource of the resource for the specified node behaviour resource event
+        std::pair<nmos::id, nmos::type> get_resource_event_super_resource(const web::json::value& event)
+        {
+            const auto id_type = get_resource_event_resource(node_behaviour_topic, event);
+            const bool has_post = event.has_field(U("post")) && !event.at(U("post")).is_null();
+            // the node behaviour subscription version is currently fixed (see make_node_behaviour_subscription)
+            return nmos::get_super_resource(nmos::is04_versions::v1_3, id_type.second, event.at(has_post ? U("post") : U("pre")));
+        }
+
+        // determine whether the resource events must be handled in order, because they are for the same resource, or one is for the super-resource of the other
+        bool is_dependent_resource_event(const web::json::value& event, const web::json::value& other)
+        {
+            const auto id = get_resource_event_resource(node_behaviour_topic, event).first;
+            const auto other_id = get_resource_event_resource(node_behaviour_topic, other).first;
+            return id == other_id
+                || get_resource_event_super_resource(event).first == other_id
+                || get_resource_event_super_resource(other).first == id;
+        }
+
+        // a request on the Registration API for one or more resource events
+        // successful requests are discarded, so a request that is done was unsuccessful and its resource events are restored
+        struct registration_request
+        {
+            web::json::value events;
+            bool done;
+        };
+        typedef std::list<registration_request> registration_requests;
+
+        // record the resource for the specified resource event as acknowledged by a Registration API
+        void update_registered_resources(registered_resources& registered, const web::json::value& event)
+        {
+            const auto id_type = get_resource_event_resource(node_behaviour_topic, event);
+            if (resource_removed_event == get_resource_event_type(event))
+            {
+                registered.erase(id_type.first);
+            }
+            else
+            {
+                registered[id_type.first] = { id_type.second, event.at(U("post")) };
+            }
+        }
+
+        // make the resource events to reconcile the resources acknowledged by a Registration API with the current resources
+        // i.e. 'removed' events for resources that no longer exist, 'modified' events for resources with a different version
+        // and 'sync' events for resources that have not been acknowledged, but none for those that are unchanged
+        web::json::value make_reconciliation_events(const nmos::resources& resources, const registered_resources& registered)
+        {
+            std::vector<web::json::value> events;
+
+            // sub-resources are removed before their super-resources, i.e. in the reverse order of nmos::types::all
+            std::vector<std::pair<nmos::id, nmos::type>> removed;
+            for (const auto& resource : registered)
+            {
+                if (resources.end() == nmos::find_resource(resources, { resource.first, resource.second.first }))
+                {
+                    removed.push_back({ resource.first, resource.second.first });
+                }
+            }
+            const auto& all = nmos::types::all;
+            std::stable_sort(removed.begin(), removed.end(), [&all](const std::pair<nmos::id, nmos::type>& lhs, const std::pair<nmos::id, nmos::type>& rhs)
+            {
+                return std::find(all.begin(), all.end(), rhs.second) < std::find(all.begin(), all.end(), lhs.second);
+            });
+            for (const auto& id_type : removed)
+            {
+                events.push_back(make_resource_event(U(""), id_type.second, registered.at(id_type.first).second, web::json::value::null()));
+            }
+
+            // the node behaviour subscription version, resource_path and params are currently fixed (see make_node_behaviour_subscription)
+            auto sync_events = make_resource_events(resources, nmos::is04_versions::v1_3, U(""), web::json::value::object());
+            for (auto& event : web::json::storage_of(sync_events.as_array()))
+            {
+                const auto found = registered.find(get_resource_event_resource(node_behaviour_topic, event).first);
+                if (registered.end() != found)
+                {
+                    const auto& post = event.at(U("post"));
+                    if (nmos::fields::version(found->second.second) == nmos::fields::version(post)) continue;
+
+                    event[U("pre")] = found->second.second;
+                }
+                events.push_back(std::move(event));
+            }
+
+            return web::json::value_from_elements(events);
+        }
+
+        // handle the response to a heartbeat and return a result that indicates whether the heartbeat was successful
+        bool handle_node_health_response(const web::http::http_response& response, slog::base_gate& gate)
+        {
+            if (web::http::status_codes::OK == response.status_code())
+            {
+                return true;
+            }
+            else if (web::http::status_codes::NotFound == response.status_code())
+            {
+                // although there's a recovery strategy here, so this could be regarded as a 'warning'
+                // it is definitely unexpected, so log it as an 'error'
+                slog::log<slog::severities::error>(gate, SLOG_FLF) << "Registration heartbeat error: " << response.status_code() << " " << response.reason_phrase();
+
+                // "On encountering this code, a Node must re-register each of its resources with the Registration API in order."
+                // See https://github.com/AMWA-TV/nmos-discovery-registration/blob/v1.2/docs/4.1.%20Behaviour%20-%20Registration.md#node-encounters-http-404-on-heartbeat
+                return false;
+            }
+            else
+            {
+                handle_registration_error_conditions(response, gate, "heartbeat");
+
+                // if we get here, it's not a server (5xx) error, so the best option seems to be to continue
+                // even though we don't really know what's going on...
+                return true;
+            }
+        }
+
         // asynchronously perform a heartbeat and return a result that indicates whether the heartbeat was successful
         pplx::task<bool> update_node_health(web::http::client::http_client client, const nmos::id& id, slog::base_gate& gate, const pplx::cancellation_token& token = pplx::cancellation_token::none())
         {
@@ -593,35 +929,107 @@ namespace nmos
 
             return client.request(web::http::methods::POST, U("/health/nodes/") + id, token).then([=, &gate](pplx::task<web::http::http_response> response_task)
             {
-                auto response = response_task.get(); // may throw http_exception
+                return handle_node_health_response(response_task.get(), gate); // may throw http_exception
+            }, token);
+        }
+
+        // asynchronously perform a heartbeat with the specified timeout and return a result that indicates whether the heartbeat was successful
+        // this allows heartbeats to be made on the same client as the registration requests, and so share its persistent connections
+        // (and avoid additional TCP connection setup and TLS handshakes), even though the client has the timeout for those requests
+        pplx::task<bool> update_node_health(web::http::client::http_client client, const nmos::id& id, const std::chrono::seconds& timeout, slog::base_gate& gate, const pplx::cancellation_token& token = pplx::cancellation_token::none())
+        {
+            slog::log<slog::severities::too_much_info>(gate, SLOG_FLF) << "Posting registration heartbeat for node: " << id;
+
+            const auto request_source = pplx::cancellation_token_source::create_linked_source(token);
+            const pplx::cancellation_token_source timeout_source;
+            pplx::complete_after(timeout, timeout_source.get_token()).then([request_source]
+            {
+                request_source.cancel();
+            });
+
+            return client.request(web::http::methods::POST, U("/health/nodes/") + id, request_source.get_token()).then([=, &gate](pplx::task<web::http::http_response> response_task) -> bool
+            {
+                timeout_source.cancel();
 
-                if (web::http::status_codes::OK == response.status_code())
+                try
                 {
-                    return true;
+                    return handle_node_health_response(response_task.get(), gate); // may throw http_exception
                 }
-                else if (web::http::status_codes::NotFound == response.status_code())
+                catch (const pplx::task_canceled&)
                 {
-                    // although there's a recovery strategy here, so this could be regarded as a 'warning'
-                    // it is definitely unexpected, so log it as an 'error'
-                    slog::log<slog::severities::error>(gate, SLOG_FLF) << "Registration heartbeat error: " << response.status_code() << " " << response.reason_phrase();
+                    if (token.is_canceled()) throw;
 
-                    // "On encountering this code, a Node must re-register each of its resources with the Registration API in order."
-                    // See https://github.com/AMWA-TV/nmos-discovery-registration/blob/v1.2/docs/4.1.%20Behaviour%20-%20Registration.md#node-encounters-http-404-on-heartbeat
-                    return false;
+                    // handle the heartbeat timeout like the client timeout
+                    throw web::http::http_exception(std::make_error_code(std::errc::timed_out), "Registration heartbeat timed out");
                 }
-                else
+            });
+        }
+
+        // asynchronously perform a heartbeat using the heartbeat scheduler shared with other nodes in the process
+        // and return a result that indicates whether the heartbeat was successful
+        pplx::task<bool> update_node_health(nmos::experimental::heartbeat_scheduler& heartbeat_scheduler, const web::uri& base_uri, const web::http::client::http_client_config& config, const nmos::id& id, slog::base_gate& gate, const pplx::cancellation_token& token = pplx::cancellation_token::none())
+        {
+            slog::log<slog::severities::too_much_info>(gate, SLOG_FLF) << "Scheduling registration heartbeat for node: " << id;
+
+            return heartbeat_scheduler.update_node_health(base_uri, config, id, token).then([=, &gate](pplx::task<web::http::http_response> response_task)
+            {
+                return handle_node_health_response(response_task.get(), gate); // may throw http_exception
+            }, token);
+        }
+
+        // experimental extension, to detect a dead Registration API sooner than the heartbeat timeout, when a heartbeat hasn't been answered within the failover time,
+        // make a request on the next-priority Registration API, and if that responds, fail the heartbeat immediately, so that the node fails over to it,
+        // otherwise, e.g. because the node itself has lost connectivity, wait for the heartbeat to succeed or time out as usual
+        pplx::task<bool> update_node_health_or_fail_over(const std::function<pplx::task<bool>(const pplx::cancellation_token&)>& update_health, web::http::client::http_client standby, const std::chrono::seconds& failover_max, slog::base_gate& gate, const pplx::cancellation_token& token = pplx::cancellation_token::none())
+        {
+            const auto request_source = pplx::cancellation_token_source::create_linked_source(token);
+            pplx::task_completion_event<bool> result;
+
+            update_health(request_source.get_token()).then([result, request_source](pplx::task<bool> heartbeat_task)
+            {
+                try
                 {
-                    handle_registration_error_conditions(response, gate, "heartbeat");
+                    result.set(heartbeat_task.get());
+                }
+                catch (...)
+                {
+                    result.set_exception(std::current_exception());
+                }
+                // no need to check the standby once the heartbeat is answered
+                request_source.cancel();
+            });
 
-                    // if we get here, it's not a server (5xx) error, so the best option seems to be to continue
-                    // even though we don't really know what's going on...
-                    return true;
+            const auto request_token = request_source.get_token();
+            pplx::complete_after(failover_max, request_token).then([standby, request_token]() mutable
+            {
+                return standby.request(web::http::methods::GET, request_token);
+            }).then([=, &gate](pplx::task<web::http::http_response> standby_task)
+            {
+                try
+                {
+                    const auto response = standby_task.get();
+                    // any response other than a server error shows that the standby is reachable
+                    if (web::http::status_codes::InternalError > response.status_code())
+                    {
+                        if (result.set_exception(registration_service_exception()))
+                        {
+                            slog::log<slog::severities::error>(gate, SLOG_FLF) << "Registration heartbeat not answered within " << failover_max.count() << " seconds while the next-priority Registration API at: "
+                                << standby.base_uri().host() << ":" << standby.base_uri().port() << " is responding";
+                            request_source.cancel();
+                        }
+                    }
                 }
-            }, token);
+                catch (...)
+                {
+                    // either the heartbeat was answered, or the standby isn't responding either
+                }
+            });
+
+            return pplx::create_task(result);
         }
 
         // there is significant similarity between initial_registration and registered_operation but I'm too tired to refactor again right now...
-        void initial_registration(nmos::id& self_id, nmos::model& model, const nmos::id& grain_id, slog::base_gate& gate)
+        void initial_registration(nmos::id& self_id, nmos::model& model, const nmos::id& grain_id, registry_registrations& registrations, slog::base_gate& gate)
         {
             slog::log<slog::severities::info>(gate, SLOG_FLF) << "Attempting initial registration";
 
@@ -713,7 +1121,7 @@ namespace nmos
                     slog::log<slog::severities::info>(gate, SLOG_FLF) << "Registering nmos-cpp node with the Registration API at: " << registration_client->base_uri().host() << ":" << registration_client->base_uri().port();
 
                     auto token = cancellation_source.get_token();
-                    request = details::request_registration(*registration_client, events.at(0), gate, token).then([&](pplx::task<void> finally)
+                    request = details::request_registration(*registration_client, events.at(0), make_registration_busy_policy(model.settings), gate, token).then([&](pplx::task<void> finally)
                     {
                         auto lock = model.write_lock(); // in order to update local state
 
@@ -724,6 +1132,11 @@ namespace nmos
                             // on success (or an ignored failure), discard the resource event
                             if (0 != events.size())
                             {
+                                // any previous registration of the node has been replaced, along with its sub-resources
+                                auto& registered = registrations[registration_client->base_uri().to_string()];
+                                registered.clear();
+                                update_registered_resources(registered, events.at(0));
+
                                 events.erase(0);
                             }
 
@@ -758,7 +1171,7 @@ namespace nmos
             request.wait();
         }
 
-        void registered_operation(const nmos::id& self_id, nmos::model& model, const nmos::id& grain_id, slog::base_gate& gate)
+        void registered_operation(const nmos::id& self_id, nmos::model& model, const nmos::id& grain_id, nmos::experimental::heartbeat_scheduler* heartbeat_scheduler, registry_registrations& registrations, slog::base_gate& gate)
         {
             slog::log<slog::severities::info>(gate, SLOG_FLF) << "Adopting registered operation";
 
@@ -772,15 +1185,36 @@ namespace nmos
 
             std::unique_ptr<web::http::client::http_client> registration_client;
             std::unique_ptr<web::http::client::http_client> heartbeat_client;
+            registered_resources* registered = nullptr;
 
             bool registration_service_error(false);
             bool node_registered(false);
             bool node_unregistered(false);
 
+            // experimental extension, to register many resources in one request when the Registration API supports it
+            const size_t bulk_limit = (std::max)(0, nmos::experimental::fields::registration_bulk_limit(model.settings));
+            bool bulk_registration(false);
+
+            // maximum number of concurrent requests on the Registration API /resource endpoint
+            const size_t request_window = (std::max)(1, nmos::experimental::fields::registration_request_window(model.settings));
+
+            // experimental extension, to retry requests while the Registration API is busy
+            const auto busy = make_registration_busy_policy(model.settings);
+
+            // the per-registration log messages are rate limited so that verbose logging stays affordable when many resources change at once
+            nmos::experimental::rate_limited_gate registration_gate(gate, (std::max)(0, nmos::experimental::fields::log_rate_limit(model.settings)));
+
             web::json::value events;
 
+            // heartbeats are made either on this node's own client, or by the heartbeat scheduler shared with other nodes in the process
+            std::function<pplx::task<bool>(const pplx::cancellation_token&)> update_health;
             std::chrono::steady_clock::time_point heartbeat_time;
 
+            // experimental extension, each heartbeat interval may be reduced by a random amount, to spread out the heartbeats of many nodes
+            const int heartbeat_jitter = (std::max)(0, nmos::experimental::fields::registration_heartbeat_jitter(model.settings));
+            nmos::details::seed_generator heartbeat_jitter_seeder;
+            std::default_random_engine heartbeat_jitter_engine(heartbeat_jitter_seeder);
+
             // background tasks may read/write the above local state by reference
             pplx::cancellation_token_source cancellation_source;
             pplx::task<void> request = pplx::task_from_result();
@@ -820,7 +1254,34 @@ namespace nmos
                 {
                     const auto base_uri = top_registration_service(model.settings);
                     registration_client.reset(new web::http::client::http_client(base_uri, make_registration_client_config(model.settings)));
-                    heartbeat_client.reset(new web::http::client::http_client(base_uri, make_heartbeat_client_config(model.settings)));
+                    registered = &registrations[base_uri.to_string()];
+                    if (heartbeat_scheduler)
+                    {
+                        const auto config = make_heartbeat_client_config(model.settings);
+                        update_health = [=, &gate](const pplx::cancellation_token& token) { return update_node_health(*heartbeat_scheduler, base_uri, config, self_id, gate, token); };
+                    }
+                    else if (nmos::fields::registration_heartbeat_max(model.settings) <= nmos::fields::registration_request_max(model.settings))
+                    {
+                        // heartbeats share the registration client, and so its persistent connections, when they don't need a longer timeout
+                        const std::chrono::seconds heartbeat_max(nmos::fields::registration_heartbeat_max(model.settings));
+                        update_health = [=, &registration_client, &gate](const pplx::cancellation_token& token) { return update_node_health(*registration_client, self_id, heartbeat_max, gate, token); };
+                    }
+                    else
+                    {
+                        heartbeat_client.reset(new web::http::client::http_client(base_uri, make_heartbeat_client_config(model.settings)));
+                        update_health = [=, &heartbeat_client, &gate](const pplx::cancellation_token& token) { return update_node_health(*heartbeat_client, self_id, gate, token); };
+                    }
+
+                    // experimental extension, to check the next-priority Registration API when a heartbeat isn't answered quickly
+                    const std::chrono::seconds failover_max((std::max)(0, nmos::experimental::fields::registration_heartbeat_failover_max(model.settings)));
+                    const auto& services = nmos::fields::registration_services(model.settings);
+                    if (0 != failover_max.count() && 1 < services.size() && failover_max.count() < nmos::fields::registration_heartbeat_max(model.settings))
+                    {
+                        const web::http::client::http_client standby(web::uri(services.at(1).as_string()), make_heartbeat_client_config(model.settings));
+                        update_health = [=, &gate](const pplx::cancellation_token& token) { return update_node_health_or_fail_over(update_health, standby, failover_max, gate, token); };
+
+                        slog::log<slog::severities::more_info>(gate, SLOG_FLF) << "Checking the next-priority Registration API at: " << standby.base_uri().host() << ":" << standby.base_uri().port() << " when heartbeats are not answered within " << failover_max.count() << " seconds";
+                    }
 
                     // "The first interaction with a new Registration API [after a server side or connectivity issue]
                     // should be a heartbeat to confirm whether whether the Node is still present in the registry"
@@ -832,7 +1293,7 @@ namespace nmos
                     const std::chrono::seconds heartbeat_interval(nmos::fields::registration_heartbeat_interval(model.settings));
                     auto token = cancellation_source.get_token();
                     heartbeat_time = std::chrono::steady_clock::now();
-                    heartbeats = update_node_health(*heartbeat_client, self_id, gate, token).then([&](bool success)
+                    heartbeats = update_health(token).then([&](bool success)
                     {
                         auto lock = model.write_lock(); // in order to update local state
 
@@ -843,16 +1304,17 @@ namespace nmos
                         }
 
                         model.notify();
-                    }).then([=, &heartbeat_time, &heartbeat_client, &gate]
+                    }).then([=, &heartbeat_time, &heartbeat_jitter_engine]
                     {
                         // "6. The Node persists itself in the registry by issuing heartbeats."
 
-                        return pplx::do_while([=, &heartbeat_time, &heartbeat_client, &gate]
+                        return pplx::do_while([=, &heartbeat_time, &heartbeat_jitter_engine]
                         {
-                            return pplx::complete_at(heartbeat_time + heartbeat_interval, token).then([=, &heartbeat_time, &heartbeat_client, &gate]() mutable
+                            const auto jitter = std::chrono::milliseconds(0 != heartbeat_jitter ? std::uniform_int_distribution<int>(0, heartbeat_jitter)(heartbeat_jitter_engine) : 0);
+                            return pplx::complete_at(heartbeat_time + heartbeat_interval - jitter, token).then([=, &heartbeat_time]() mutable
                             {
                                 heartbeat_time = std::chrono::steady_clock::now();
-                                return update_node_health(*heartbeat_client, self_id, gate, token);
+                                return update_health(token);
                             });
                         }, token);
                     }).then([&](pplx::task<void> finally)
@@ -882,21 +1344,94 @@ namespace nmos
                     // wait for the response from the first heartbeat that the Node is still registered (or not!)
                     condition.wait(lock, [&]{ return shutdown || registration_service_error || node_unregistered || node_registered; });
                     if (shutdown || registration_service_error || node_unregistered) continue;
+
+                    // experimental extension, the Registration API advertises the bulk endpoint in its sub-routes
+                    bulk_registration = false;
+                    if (1 < bulk_limit)
+                    {
+                        request = request_bulk_registration_support(*registration_client, gate, token).then([&](bool supported)
+                        {
+                            auto lock = model.write_lock(); // in order to update local state
+
+                            bulk_registration = supported;
+                        });
+                        // avoid race condition between condition.notify_all() and request.is_done()
+                        request.then([&]
+                        {
+                            condition.notify_all();
+                        });
+
+                        condition.wait(lock, [&]{ return shutdown || registration_service_error || node_unregistered || request.is_done(); });
+                        if (shutdown || registration_service_error || node_unregistered) continue;
+                    }
+
+                    // when this Registration API has acknowledged resources before, the pending resource events are replaced by just those
+                    // required to bring it up to date, since they may include events that it already had, and not those that it missed
+                    if (!registered->empty())
+                    {
+                        auto reconciliation_events = make_reconciliation_events(resources, *registered);
+
+                        slog::log<slog::severities::info>(gate, SLOG_FLF) << "Reconciling " << reconciliation_events.size() << " resources with those previously registered";
+
+                        resources.modify(grain, [&](nmos::resource& grain)
+                        {
+                            nmos::fields::message_grain_data(grain.data) = std::move(reconciliation_events);
+                            grain.updated = strictly_increasing_update(resources);
+                        });
+                    }
                 }
 
                 events = web::json::value::array();
                 node_behaviour_grain_guard guard(resources, grain, events);
                 most_recent_update = grain->updated;
 
-                while (0 != events.size())
+                // requests for independent resources may be in flight concurrently, but a resource event must wait for any request for the same resource
+                // or its super-resource or sub-resources, e.g. a device must be registered before its senders, and its senders deleted before the device
+                registration_requests in_flight;
+
+                const auto can_dispatch = [&]
                 {
+                    if (0 == events.size() || request_window <= in_flight.size()) return false;
+                    const auto& event = events.at(0);
+                    return in_flight.end() == std::find_if(in_flight.begin(), in_flight.end(), [&](const registration_request& flight)
+                    {
+                        const auto& flight_events = flight.events.as_array();
+                        return flight_events.end() != std::find_if(flight_events.begin(), flight_events.end(), [&](const web::json::value& other)
+                        {
+                            return is_dependent_resource_event(event, other);
+                        });
+                    });
+                };
+
+                for (;;)
+                {
+                    // wait for the thread to be interrupted because a request has completed (or this is the first time through)
+                    condition.wait(lock, [&]{ return shutdown || registration_service_error || node_unregistered || in_flight.empty() || can_dispatch(); });
                     if (shutdown || registration_service_error || node_unregistered) break;
+                    if (0 == events.size() && in_flight.empty()) break;
+                    if (!can_dispatch()) continue;
+
+                    // register a run of several resource creation and update events in one request if possible
+                    // (only when no other requests are in flight, since the run may include dependent resources)
+                    const auto bulk_count = bulk_registration && in_flight.empty() ? count_bulk_registration_events(events, bulk_limit) : 0;
+                    const size_t count = 1 < bulk_count ? bulk_count : 1;
+
+                    // move the resource event(s) from the pending events to the in-flight request
+                    auto& storage = web::json::storage_of(events.as_array());
+                    const auto flight = in_flight.insert(in_flight.end(), registration_request{ web::json::value::array(), false });
+                    for (size_t n = 0; n < count; ++n)
+                    {
+                        web::json::push_back(flight->events, std::move(storage[n]));
+                    }
+                    storage.erase(storage.begin(), storage.begin() + count);
 
-                    const auto id_type = get_resource_event_resource(node_behaviour_topic, events.at(0));
-                    const auto event_type = get_resource_event_type(events.at(0));
+                    const auto id_type = get_resource_event_resource(node_behaviour_topic, flight->events.at(0));
+                    const auto event_type = get_resource_event_type(flight->events.at(0));
 
                     auto token = cancellation_source.get_token();
-                    request = details::request_registration(*registration_client, events.at(0), gate, token).then([&](pplx::task<void> finally)
+                    (1 < count
+                        ? details::request_bulk_registration(*registration_client, flight->events, count, busy, registration_gate, token)
+                        : details::request_registration(*registration_client, flight->events.at(0), busy, registration_gate, token)).then([&, flight, id_type, event_type](pplx::task<void> finally)
                     {
                         auto lock = model.write_lock(); // in order to update local state
 
@@ -904,11 +1439,12 @@ namespace nmos
                         {
                             finally.get();
 
-                            // on success (or an ignored failure), discard the resource event
-                            if (0 != events.size())
+                            // on success (or an ignored failure), record and discard the resource event(s)
+                            for (const auto& event : flight->events.as_array())
                             {
-                                events.erase(0);
+                                update_registered_resources(*registered, event);
                             }
+                            in_flight.erase(flight);
 
                             // "Following deletion of all other resources, the Node resource may be deleted and heartbeating stopped."
                             // See https://github.com/AMWA-TV/nmos-discovery-registration/blob/v1.2/docs/4.1.%20Behaviour%20-%20Registration.md#controlled-unregistration
@@ -921,22 +1457,38 @@ namespace nmos
                         {
                             slog::log<slog::severities::error>(gate, SLOG_FLF) << "Registration request HTTP error: " << e.what() << " [" << e.error_code() << "]";
 
+                            flight->done = true;
                             registration_service_error = true;
                         }
                         catch (const registration_service_exception&)
                         {
+                            flight->done = true;
                             registration_service_error = true;
                         }
+                        catch (...)
+                        {
+                            // e.g. the request was cancelled
+                            flight->done = true;
+                        }
+
+                        model.notify();
                     });
-                    // avoid race condition between condition.notify_all() and request.is_done()
-                    request.then([&]
-                    {
-                        condition.notify_all();
-                    });
+                }
 
-                    // wait for the request because interactions with the Registration API /resource endpoint must be sequential
-                    condition.wait(lock, [&]{ return shutdown || registration_service_error || node_unregistered || request.is_done(); });
+                // wait for any requests still in flight, which are cancelled if registered operation is being interrupted
+                if (shutdown || registration_service_error || node_unregistered) cancellation_source.cancel();
+                condition.wait(lock, [&]{ return in_flight.end() == std::find_if(in_flight.begin(), in_flight.end(), [](const registration_request& flight) { return !flight.done; }); });
+
+                // restore the resource events of any unsuccessful requests, in order, so they are restored to the grain with any other remaining events
+                std::vector<web::json::value> unsuccessful;
+                for (auto& flight : in_flight)
+                {
+                    auto& flight_storage = web::json::storage_of(flight.events.as_array());
+                    unsuccessful.insert(unsuccessful.end(), std::make_move_iterator(flight_storage.begin()), std::make_move_iterator(flight_storage.end()));
                 }
+                auto& storage = web::json::storage_of(events.as_array());
+                storage.insert(storage.begin(), std::make_move_iterator(unsuccessful.begin()), std::make_move_iterator(unsuccessful.end()));
+                in_flight.clear();
             }
 
             cancellation_source.cancel();
@@ -981,7 +1533,7 @@ namespace nmos
             }
         }
 
-        void peer_to_peer_operation(nmos::model& model, const nmos::id& grain_id, mdns::service_discovery& discovery, mdns::service_advertiser& advertiser, slog::base_gate& gate)
+        void peer_to_peer_operation(nmos::model& model, const nmos::id& grain_id, mdns::service_discovery& discovery, const nmos::experimental::service_cache* cache, mdns::service_advertiser& advertiser, slog::base_gate& gate)
         {
             slog::log<slog::severities::info>(gate, SLOG_FLF) << "Adopting peer-to-peer operation";
 
@@ -1009,7 +1561,7 @@ namespace nmos
                 // though that would be better indicated by an exception from discover_registration_services)
                 return pplx::complete_after(std::chrono::seconds(1), token).then([&]
                 {
-                    return !discover_registration_services(model, discovery, gate, token);
+                    return !discover_registration_services(model, discovery, cache, gate, token);
                 });
             }, token).then([&]
             {
@@ -1021,21 +1573,15 @@ namespace nmos
             });
 
             tai most_recent_update{};
-            auto earliest_allowed_update = (tai_clock::time_point::min)();
-            auto earliest_necessary_update = (tai_clock::time_point::max)();
 
             for (;;)
             {
                 // wait for the thread to be interrupted because there are resource events (or this is the first time through)
                 // or because a Registration API has been discovered so registered operation should be attempted
                 // or because the server is being shut down
-                // or because message sending was throttled earlier
-                details::wait_until(condition, lock, earliest_necessary_update, [&] { return shutdown || registration_services_discovered || most_recent_update < grain->updated; });
+                condition.wait(lock, [&] { return shutdown || registration_services_discovered || most_recent_update < grain->updated; });
                 if (shutdown || registration_services_discovered) break;
 
-                // usually the daemon will be updated
-                earliest_necessary_update = (tai_clock::time_point::max)();
-
                 auto events = web::json::value::array();
                 node_behaviour_grain_guard guard(resources, grain, events);
                 most_recent_update = grain->updated;
@@ -1052,27 +1598,8 @@ namespace nmos
                 // job done
                 events = web::json::value::array();
 
-                // throttle updates to the DNS-SD daemon
-                // (because otherwise it may report that it's having to do that itself)
-                // "to protect the network against excessive packet flooding due to software
-                // bugs or malicious attack, a Multicast DNS responder MUST NOT multicast a
-                // record on a given interface until at least one second has elapsed since
-                // the last time that record was multicast on that particular interface."
-                // see https://tools.ietf.org/html/rfc6762#section-6
-                const auto max_update_rate = std::chrono::seconds(1);
-                const auto now = tai_clock::now();
-                if (earliest_allowed_update > now)
-                {
-                    // make sure to update the daemon as soon as allowed
-                    earliest_necessary_update = earliest_allowed_update;
-
-                    // just don't do it now!
-                    continue;
-                }
-
+                // the advertiser coalesces updates made within the minimum update interval
                 update_node_service(advertiser, model.settings, ver);
-
-                earliest_allowed_update = now + max_update_rate;
             }
 
             // withdraw the 'ver_' TXT records
@@ -13,7 +13,16 @@ namespace nmos
 {
     struct model;
 
+    namespace experimental
+    {
+        class heartbeat_scheduler;
+    }
+
     void node_behaviour_thread(nmos::model& model, slog::base_gate& gate);
+
+    // experimental extension, to share heartbeats between several node models in one process
+    // see nmos::experimental::heartbeat_scheduler
+    void node_behaviour_thread(nmos::model& model, nmos::experimental::heartbeat_scheduler& heartbeat_scheduler, slog::base_gate& gate);
 }
 
 #endif
@@ -1,7 +1,12 @@
 #include "nmos/query_api.h"
 
+#include <algorithm>
+#include <chrono>
+#include <map>
+#include <set>
 #include <boost/range/adaptor/transformed.hpp>
 #include "cpprest/json_validator.h"
+#include "cpprest/producerconsumerstream.h"
 #include "cpprest/uri_schemes.h"
 #include "nmos/api_downgrade.h"
 #include "nmos/api_utils.h"
@@ -9,8 +14,11 @@
 #include "nmos/json_schema.h"
 #include "nmos/model.h"
 #include "nmos/query_utils.h"
+#include "nmos/rate_limiter.h"
+#include "nmos/resource_journal.h"
 #include "nmos/slog.h"
 #include "nmos/version.h"
+#include "pplx/pplx_utils.h"
 
 namespace nmos
 {
@@ -72,38 +80,47 @@ namespace nmos
             return web::json::query_from_value(flat_query_params);
         }
 
+        // equivalent to web::json::value_from_query followed by nmos::details::decode_elements, except that RQL is kept as the URI-encoded string,
+        // and the non-string query parameters are parsed after decoding, but in a single pass over the query string
         web::json::value parse_query_parameters(const utility::string_t& query)
         {
-            auto flat_query_params = web::json::value_from_query(query);
+            auto flat_query_params = web::json::value::object(true); // keep order, like web::json::value_from_query
 
-            // special case, RQL is kept as the URI-encoded string
-            const auto encoded_rql = nmos::fields::query_rql(flat_query_params);
-
-            // all other string values need decoding
-            nmos::details::decode_elements(flat_query_params);
-
-            if (flat_query_params.has_field(nmos::fields::query_rql))
-            {
-                flat_query_params[nmos::fields::query_rql] = web::json::value::string(encoded_rql);
-            }
-
-            // any non-string query parameters need parsing after decoding...
-            if (flat_query_params.has_field(nmos::fields::paging_limit))
+            utility::string_t::size_type field_first = 0;
+            do
             {
-                flat_query_params[nmos::fields::paging_limit] = web::json::value::parse(nmos::fields::paging_limit(flat_query_params));
-            }
-            if (flat_query_params.has_field(nmos::experimental::fields::query_strip))
-            {
-                flat_query_params[nmos::experimental::fields::query_strip] = web::json::value::parse(nmos::experimental::fields::query_strip(flat_query_params));
-            }
+                const auto field_last = query.find_first_of(U("=&;"), field_first);
+                const auto value_first = utility::string_t::npos != field_last && U('=') == query[field_last] ? field_last + 1 : field_last;
+                const auto value_last = query.find_first_of(U("&;"), value_first);
+                const auto field = web::uri::decode(query.substr(field_first, utility::string_t::npos != field_last ? field_last - field_first : utility::string_t::npos));
+                const auto value = utility::string_t::npos == value_first ? utility::string_t() : query.substr(value_first, utility::string_t::npos != value_last ? value_last - value_first : utility::string_t::npos);
+                if (!field.empty() || !value.empty())
+                {
+                    auto& param = flat_query_params[field];
+                    if (nmos::fields::query_rql.key == field)
+                    {
+                        // special case, RQL is kept as the URI-encoded string
+                        param = web::json::value::string(value);
+                    }
+                    else if (nmos::fields::paging_limit.key == field || nmos::experimental::fields::query_strip.key == field || nmos::experimental::fields::query_patch.key == field || nmos::experimental::fields::paging_wait.key == field)
+                    {
+                        // any non-string query parameters need parsing after decoding...
+                        param = web::json::value::parse(web::uri::decode(value));
+                    }
+                    else
+                    {
+                        // all other string values need decoding
+                        param = web::json::value::string(web::uri::decode(value));
+                    }
+                }
+                field_first = utility::string_t::npos != value_last ? value_last + 1 : value_last;
+            } while (utility::string_t::npos != field_first);
 
             return flat_query_params;
         }
 
-        web::uri make_query_uri_with_no_paging(const web::http::http_request& req, const nmos::settings& settings)
+        static web::uri make_query_uri_with_no_paging(const web::http::http_request& req, web::json::value query_params, const nmos::settings& settings)
         {
-            // could rebuild the query parameters from the decoded and parsed query string, rather than individually deleting the paging parameters from the request?
-            auto query_params = parse_query_parameters(req.request_uri().query());
             if (query_params.has_field(U("paging.order")))
             {
                 query_params.erase(U("paging.order"));
@@ -145,6 +162,67 @@ namespace nmos
                 .to_uri();
         }
 
+        web::uri make_query_uri_with_no_paging(const web::http::http_request& req, const nmos::settings& settings)
+        {
+            return make_query_uri_with_no_paging(req, parse_query_parameters(req.request_uri().query()), settings);
+        }
+
+        // write the (serialized) elements to the stream buffer as a json array, in UTF-8 chunks of about the specified size, and then close it,
+        // pausing while more than the specified amount of data is waiting to be read, so that a (potentially large) response body can be streamed
+        // without being assembled in memory all at once; if the reader makes no progress for too long, the buffer is closed with an exception
+        pplx::task<void> write_json_array(concurrency::streams::producer_consumer_buffer<uint8_t> buffer, std::vector<std::shared_ptr<const std::string>> elements, size_t chunk_size, size_t buffered_limit)
+        {
+            struct writer_state
+            {
+                std::vector<std::shared_ptr<const std::string>> elements;
+                size_t next;
+                std::string chunk;
+                std::chrono::steady_clock::time_point progress;
+            };
+            auto state = std::make_shared<writer_state>(writer_state{ std::move(elements), 0, {}, std::chrono::steady_clock::now() });
+
+            const auto stalled_timeout = std::chrono::seconds(60);
+            const auto stalled_interval = std::chrono::milliseconds(10);
+
+            return pplx::do_while([buffer, state, chunk_size, buffered_limit, stalled_timeout, stalled_interval]() mutable -> pplx::task<bool>
+            {
+                if (buffer.in_avail() > buffered_limit)
+                {
+                    if (std::chrono::steady_clock::now() - state->progress > stalled_timeout) throw std::runtime_error("response body reader stalled");
+                    return pplx::complete_after(stalled_interval).then([] { return true; });
+                }
+                state->progress = std::chrono::steady_clock::now();
+
+                auto& chunk = state->chunk;
+                chunk.clear();
+                if (0 == state->next) chunk.push_back('[');
+                while (state->elements.size() > state->next && chunk_size > chunk.size())
+                {
+                    if (0 != state->next) chunk.push_back(',');
+                    chunk.append(*state->elements[state->next]);
+                    // release this element as soon as possible
+                    state->elements[state->next].reset();
+                    ++state->next;
+                }
+                const bool more = state->elements.size() > state->next;
+                if (!more) chunk.push_back(']');
+
+                // the chunk must remain valid until the write has completed
+                return buffer.putn_nocopy((const uint8_t*)chunk.data(), chunk.size()).then([state, more](size_t) { return more; });
+            }).then([buffer](pplx::task<void> finally) mutable -> pplx::task<void>
+            {
+                try
+                {
+                    finally.get();
+                    return buffer.close(std::ios_base::out);
+                }
+                catch (...)
+                {
+                    return buffer.close(std::ios_base::out, std::current_exception());
+                }
+            });
+        }
+
         void add_paging_headers(web::http::http_headers& headers, const nmos::resource_paging& paging, const web::uri& base_link)
         {
             // X-Paging-Limit "identifies the current limit being used for paging. This may not match the requested value if the requested value was too high for the implementation"
@@ -178,6 +256,163 @@ namespace nmos
 
             headers.add(U("Link"), U("<") + link + U(">; rel=\"last\""));
         }
+
+        // make the key of the query page cache entry for a request, from the request path and all the query parameters (including the paging parameters),
+        // the host, which is used in the paging Link headers, and the paging limits from settings
+        // note, the fields of a json object are kept in order of their keys, so the key doesn't depend on the order of the query parameters
+        static utility::string_t make_query_page_key(const web::http::http_request& req, const web::json::value& flat_query_params, const nmos::experimental::settings_snapshot& settings)
+        {
+            auto query_params = web::json::value::object();
+            for (const auto& field : flat_query_params.as_object())
+            {
+                query_params[field.first] = field.second;
+            }
+            const auto host_port = web::http::get_host_port(req);
+            return req.request_uri().path() + U('?') + query_params.serialize()
+                + U(' ') + host_port.first + U(':') + utility::ostringstreamed(host_port.second)
+                + U(' ') + utility::ostringstreamed(settings.query_paging_default) + U('/') + utility::ostringstreamed(settings.query_paging_limit);
+        }
+
+        // make a query page cache entry from the serialized response body, its entity-tag, and the count and paging headers of the response
+        static std::shared_ptr<const query_page> make_query_page(std::string body, const utility::string_t& entity_tag, const web::http::http_headers& headers)
+        {
+            auto page = std::make_shared<query_page>();
+            page->body = std::move(body);
+            page->entity_tag = entity_tag;
+            for (const auto& name : { U("X-Total-Count"), U("X-Paging-Limit"), U("X-Paging-Since"), U("X-Paging-Until"), U("Link") })
+            {
+                const auto found = headers.find(name);
+                if (headers.end() != found) page->headers.push_back(*found);
+            }
+            return page;
+        }
+
+        // set the response from a query page cache entry, or a not modified response if the client already has that page
+        static void set_query_page_reply(const web::http::http_request& req, web::http::http_response& res, const query_page& page)
+        {
+            if (set_not_modified_reply(req, res, page.entity_tag)) return;
+
+            set_utf8_json_reply(res, web::http::status_codes::OK, page.body);
+            res.headers().add(web::http::header_names::etag, page.entity_tag);
+            for (const auto& header : page.headers)
+            {
+                res.headers().add(header.first, header.second);
+            }
+        }
+
+        // experimental extension, for query.include=descendants, get the serialized (downgraded) resource and all its extant descendants, by type,
+        // walking the sub-resources, e.g. from a node to its devices, and from each device to its senders, receivers, sources and flows
+        // note, like serialize_downgrade, this only requires a shared/read lock on the resources, and the result remains valid without the lock
+        static std::map<nmos::type, std::vector<std::shared_ptr<const std::string>>> serialize_downgrade_subtree(const nmos::resources& resources, const nmos::resource& resource, const resource_query& match)
+        {
+            std::map<nmos::type, std::vector<std::shared_ptr<const std::string>>> subtree;
+
+            std::vector<const nmos::resource*> pending{ &resource };
+            std::set<nmos::id> visited{ resource.id };
+            while (!pending.empty())
+            {
+                const auto& current = *pending.back();
+                pending.pop_back();
+
+                subtree[current.type].push_back(details::serialize_downgrade(resources, current, match));
+
+                for (const auto& id : current.sub_resources)
+                {
+                    if (!visited.insert(id).second) continue;
+                    auto sub_resource = find_resource(resources, id);
+                    if (resources.end() == sub_resource || !sub_resource->has_data()) continue;
+                    if (!nmos::is_permitted_downgrade(*sub_resource, match.version, match.downgrade_version)) continue;
+                    pending.push_back(&*sub_resource);
+                }
+            }
+
+            return subtree;
+        }
+
+        // assemble the response body for query.include=descendants, an object with an array of resources for each type, e.g. { "nodes": [...], "devices": [...], ... }
+        static std::string make_subtree_body(const std::map<nmos::type, std::vector<std::shared_ptr<const std::string>>>& subtree)
+        {
+            static const nmos::type types[] = { nmos::types::node, nmos::types::device, nmos::types::source, nmos::types::flow, nmos::types::sender, nmos::types::receiver };
+
+            std::string body;
+            body.push_back('{');
+            for (const auto& type : types)
+            {
+                if (&type != &types[0]) body.push_back(',');
+                body.append("\"" + utility::us2s(nmos::resourceType_from_type(type)) + "\":[");
+                auto found = subtree.find(type);
+                if (subtree.end() != found)
+                {
+                    for (const auto& element : found->second)
+                    {
+                        if (&element != &found->second.front()) body.push_back(',');
+                        body.append(*element);
+                    }
+                }
+                body.push_back(']');
+            }
+            body.push_back('}');
+            return body;
+        }
+
+        // experimental extension, to wait until resources which match the query have been created/updated since the paging.since cursor,
+        // or until the timeout has elapsed, or shutdown is initiated; the most recent update is checked periodically by a timer task,
+        // since waiting on the model condition would tie up a thread for each request, and it's cheap to determine whether anything has changed,
+        // and only the resources created/updated since the previous check need be matched, from the resource journal without the model lock, if it
+        // retains them, or otherwise from the resources themselves
+        pplx::task<void> wait_for_matching_resources(nmos::registry_model& model, const resource_query& match, const resource_paging& paging, std::chrono::seconds timeout)
+        {
+            struct waiter_state
+            {
+                resource_query match;
+                resource_paging changes;
+                std::chrono::steady_clock::time_point deadline;
+            };
+            auto state = std::make_shared<waiter_state>(waiter_state{ match, paging, std::chrono::steady_clock::now() + timeout });
+            state->changes.limit = 1;
+            state->changes.since_specified = true;
+
+            const auto check_interval = std::chrono::milliseconds(100);
+
+            return pplx::do_while([&model, state, check_interval]() -> pplx::task<bool>
+            {
+                std::shared_ptr<const nmos::experimental::resource_journal> journal;
+                {
+                    auto lock = model.read_lock();
+                    if (model.shutdown) return pplx::task_from_result(false);
+                    journal = model.registry_resources.journal;
+                }
+
+                auto& changes = state->changes;
+                std::vector<nmos::experimental::shared_journal_entry> entries;
+                if (journal && journal->read_since(changes.since, entries))
+                {
+                    for (const auto& entry : entries)
+                    {
+                        if (entry->post && state->match(entry->version, entry->type, *entry->post)) return pplx::task_from_result(false);
+                    }
+                    if (!entries.empty()) changes.since = entries.back()->updated;
+                }
+                else
+                {
+                    auto lock = model.read_lock();
+                    if (model.shutdown) return pplx::task_from_result(false);
+
+                    const auto& resources = model.registry_resources;
+                    const auto most_recent = most_recent_update(resources);
+                    if (changes.since < most_recent)
+                    {
+                        struct default_constructible_resource_query_wrapper { const resource_query* impl; bool operator()(const nmos::resource& r) const { return (*impl)(r); } };
+                        changes.until = most_recent;
+                        if (!changes.page(resources, default_constructible_resource_query_wrapper{ &state->match }).empty()) return pplx::task_from_result(false);
+                        changes.since = most_recent;
+                    }
+                }
+
+                if (state->deadline <= std::chrono::steady_clock::now()) return pplx::task_from_result(false);
+                return pplx::complete_after(check_interval).then([] { return true; });
+            });
+        }
     }
 
     inline web::http::experimental::listener::api_router make_unmounted_query_api(nmos::registry_model& model, slog::base_gate& gate_)
@@ -190,52 +425,158 @@ namespace nmos
         const auto versions = with_read_lock(model.mutex, [&model] { return nmos::is04_versions::from_settings(model.settings); });
         query_api.support(U(".*"), details::make_api_version_handler(versions, gate_));
 
+        // experimental extension, to limit the rate of requests from each client, so that one misbehaving client cannot starve the others
+        const auto rate_limiter = with_read_lock(model.mutex, [&model] { return nmos::experimental::make_rate_limiter(model.settings); });
+        if (rate_limiter)
+        {
+            query_api.support(U(".*"), nmos::experimental::make_api_rate_limit_handler(rate_limiter, gate_));
+        }
+
         query_api.support(U("/?"), methods::GET, [](http_request, http_response res, const string_t&, const route_parameters&)
         {
             set_reply(res, status_codes::OK, nmos::make_sub_routes_body({ U("nodes/"), U("devices/"), U("sources/"), U("flows/"), U("senders/"), U("receivers/"), U("subscriptions/") }, res));
             return pplx::task_from_result(true);
         });
 
-        query_api.support(U("/") + nmos::patterns::queryType.pattern + U("/?"), methods::GET, [&model, &gate_](http_request req, http_response res, const string_t&, const route_parameters& parameters)
+        // pages larger than this are streamed, and never cached
+        const std::size_t query_page_cache_max_body_size = 1024 * 1024;
+
+        const auto query_resources = [&model, &gate_, query_page_cache_max_body_size](http_request req, http_response res, const string_t&, const route_parameters& parameters)
         {
             nmos::api_gate gate(gate_, req, parameters);
-            auto lock = model.read_lock();
             auto& resources = model.registry_resources;
 
             const nmos::api_version version = nmos::parse_api_version(parameters.at(nmos::patterns::version.name));
             const string_t resourceType = parameters.at(nmos::patterns::queryType.name);
-
-            // Extract and decode the query string
+            const auto type = nmos::type_from_resourceType(resourceType);
 
             const auto flat_query_params = details::parse_query_parameters(req.request_uri().query());
+            const auto settings = model.get_settings_snapshot();
 
-            // Configure the query predicate
+            // experimental extension, since many clients make the same requests, a page that has already been served is served again from the query page cache,
+            // without evaluating the query or even locking the model, while no resources of the queried type have been changed since it was built
+            // (the paging cursors in the headers are the same as for the earlier response, but still identify the same data set)
+            auto page_key = 0 != settings->query_page_cache_size ? details::make_query_page_key(req, flat_query_params, *settings) : utility::string_t{};
+            if (!page_key.empty())
+            {
+                const auto page = details::find_query_page(resources, page_key);
+                if (page)
+                {
+                    slog::log<slog::severities::info>(gate, SLOG_FLF) << "Returning cached page of matching " << resourceType;
+                    details::set_query_page_reply(req, res, *page);
+                    return pplx::task_from_result(true);
+                }
+            }
+
+            auto lock = model.read_lock();
 
-            const resource_query match(version, U('/') + resourceType, flat_query_params);
+            // the watermark is read with the lock held, so that it's consistent with the page, if that is then cached
+            const auto watermark = details::get_query_page_watermark(resources, type);
+
+            // The response only depends on the request URI and the resources, so a polling client can be told nothing has changed
+            // before going to the trouble of evaluating the query and serializing the results
+            // (the entity-tag changes whenever any resource changes, not only those that match the query, but it's cheap to determine)
+            const auto entity_tag = details::make_resources_entity_tag(resources);
+            if (details::set_not_modified_reply(req, res, entity_tag))
+            {
+                slog::log<slog::severities::more_info>(gate, SLOG_FLF) << "Not modified";
+                return pplx::task_from_result(true);
+            }
+
+            // Configure the query predicate, which is usually already compiled
+
+            const auto query = details::get_resource_query(resources, version, U('/') + resourceType, flat_query_params);
+            const auto& match = *query;
 
             slog::log<slog::severities::more_info>(gate, SLOG_FLF) << "Querying " << resourceType;
 
             // Configure the paging parameters
 
             // Limit queries to the current resources (although tai_now() would also be an option?) and use the paging limit (default and max) from the setings
-            resource_paging paging(flat_query_params, most_recent_update(resources), (size_t)nmos::fields::query_paging_default(model.settings), (size_t)nmos::fields::query_paging_limit(model.settings));
+            resource_paging paging(flat_query_params, most_recent_update(resources), settings->query_paging_default, settings->query_paging_limit);
 
             if (paging.valid())
             {
+                // experimental extension, to report the count of matching resources regardless of the limit, without serializing any of them
+                // (this must be done before the paging parameters are updated for this page)
+                if (!paging.count.empty())
+                {
+                    const auto total_count = paging.total_count(resources, match);
+                    res.headers().add(U("X-Total-Count"), total_count);
+
+                    if (U("only") == paging.count)
+                    {
+                        lock.unlock();
+
+                        slog::log<slog::severities::info>(gate, SLOG_FLF) << "Returning count of " << total_count << " matching " << resourceType;
+
+                        set_reply(res, status_codes::OK, web::json::value::array());
+                        res.headers().add(web::http::header_names::etag, entity_tag);
+
+                        if (!page_key.empty())
+                        {
+                            details::insert_query_page(resources, std::move(page_key), type, watermark, details::make_query_page("[]", entity_tag, res.headers()), settings->query_page_cache_size);
+                        }
+                        return pplx::task_from_result(true);
+                    }
+                }
+
                 // Get the payload and update the paging parameters
+                // take a consistent snapshot of the serialized (downgraded) resource data in the page, which is usually already cached,
+                // so that the (potentially large) response can be assembled without holding the lock, which would otherwise block e.g. Registration API writers
+                // the resources are filtered, downgraded and serialized in a single pass
                 struct default_constructible_resource_query_wrapper { const resource_query* impl; bool operator()(const nmos::resource& r) const { return (*impl)(r); } };
-                auto page = paging.page(resources, default_constructible_resource_query_wrapper{ &match }); // std::cref(match) is OK from Boost.Range 1.56.0
+                std::vector<std::shared_ptr<const std::string>> page_data;
+                paging.for_each_in_page(resources, default_constructible_resource_query_wrapper{ &match }, match, settings->query_parallel_threshold, [&](const nmos::resource& resource)
+                {
+                    page_data.push_back(details::serialize_downgrade(resources, resource, match));
+                });
+
+                const auto base_link = details::make_query_uri_with_no_paging(req, flat_query_params, model.settings);
+
+                lock.unlock();
 
-                size_t count = 0;
+                slog::log<slog::severities::info>(gate, SLOG_FLF) << "Returning " << page_data.size() << " matching " << resourceType;
 
-                set_reply(res, status_codes::OK,
-                    web::json::serialize(page,
-                        [&count, &match](const nmos::resources::value_type& resource) { ++count; return match.downgrade(resource); }),
-                    web::http::details::mime_types::application_json);
+                // a page that isn't too large is assembled in memory, so that it can be cached
+                std::size_t body_size = 2;
+                for (const auto& element : page_data)
+                {
+                    body_size += element->size() + 1;
+                }
+                if (!page_key.empty() && query_page_cache_max_body_size >= body_size)
+                {
+                    std::string body;
+                    body.reserve(body_size);
+                    body.push_back('[');
+                    for (const auto& element : page_data)
+                    {
+                        if (&element != &page_data.front()) body.push_back(',');
+                        body.append(*element);
+                    }
+                    body.push_back(']');
+
+                    details::set_utf8_json_reply(res, status_codes::OK, body);
+                    res.headers().add(web::http::header_names::etag, entity_tag);
+                    details::add_paging_headers(res.headers(), paging, base_link);
 
-                slog::log<slog::severities::info>(gate, SLOG_FLF) << "Returning " << count << " matching " << resourceType;
+                    details::insert_query_page(resources, std::move(page_key), type, watermark, details::make_query_page(std::move(body), entity_tag, res.headers()), settings->query_page_cache_size);
+                    return pplx::task_from_result(true);
+                }
+
+                // stream the response body, so that the first chunk can be sent while the rest are still being converted to UTF-8,
+                // and the response is never held in memory all at once; the writer continues after this handler has completed
+                concurrency::streams::producer_consumer_buffer<uint8_t> body;
+                set_reply(res, status_codes::OK, body.create_istream(), web::http::details::mime_types::application_json);
+                res.headers().add(web::http::header_names::etag, entity_tag);
+
+                details::write_json_array(body, std::move(page_data), 64 * 1024, 1024 * 1024).then([](pplx::task<void> finally)
+                {
+                    // the writer has already closed the buffer, with any exception, so there's nothing else to do
+                    try { finally.get(); } catch (...) {}
+                });
 
-                details::add_paging_headers(res.headers(), paging, details::make_query_uri_with_no_paging(req, model.settings));
+                details::add_paging_headers(res.headers(), paging, base_link);
             }
             else
             {
@@ -243,6 +584,50 @@ namespace nmos
             }
 
             return pplx::task_from_result(true);
+        };
+
+        query_api.support(U("/") + nmos::patterns::queryType.pattern + U("/?"), methods::GET, [&model, &gate_, query_resources](http_request req, http_response res, const string_t& route_path, const route_parameters& parameters)
+        {
+            const nmos::api_version version = nmos::parse_api_version(parameters.at(nmos::patterns::version.name));
+            const string_t resourceType = parameters.at(nmos::patterns::queryType.name);
+
+            // experimental extension, a long-poll change feed, for clients which cannot use the Query WebSocket API
+            // when paging.wait is specified as well as paging.since, and there are no matching resources yet, the response
+            // is postponed until there are, or the specified number of seconds has elapsed
+            const auto flat_query_params = details::parse_query_parameters(req.request_uri().query());
+            if (!flat_query_params.has_field(nmos::experimental::fields::paging_wait))
+            {
+                return query_resources(req, res, route_path, parameters);
+            }
+
+            nmos::api_gate gate(gate_, req, parameters);
+            auto lock = model.read_lock();
+            auto& resources = model.registry_resources;
+
+            const auto query = details::get_resource_query(resources, version, U('/') + resourceType, flat_query_params);
+            const auto& match = *query;
+
+            const auto most_recent = most_recent_update(resources);
+            const resource_paging paging(flat_query_params, most_recent);
+            const auto wait_limit = model.get_settings_snapshot()->query_paging_wait_limit;
+
+            // there's no point waiting when the client has restricted the results to those created/updated before now
+            if (0 >= wait_limit || 0 == paging.wait || !paging.since_specified || !paging.valid() || paging.until < most_recent)
+            {
+                lock.unlock();
+                return query_resources(req, res, route_path, parameters);
+            }
+
+            lock.unlock();
+
+            const auto timeout = std::chrono::seconds((std::min)(paging.wait, (unsigned int)wait_limit));
+
+            slog::log<slog::severities::more_info>(gate, SLOG_FLF) << "Waiting up to " << timeout.count() << " seconds for " << resourceType << " since: " << nmos::make_version(paging.since);
+
+            return details::wait_for_matching_resources(model, match, paging, timeout).then([query_resources, req, res, route_path, parameters]() mutable
+            {
+                return query_resources(req, res, route_path, parameters);
+            });
         });
 
         query_api.support(U("/") + nmos::patterns::queryType.pattern + U("/") + nmos::patterns::resourceId.pattern + U("/?"), methods::GET, [&model, &gate_](http_request req, http_response res, const string_t&, const route_parameters& parameters)
@@ -260,15 +645,44 @@ namespace nmos
             const auto flat_query_params = details::parse_query_parameters(req.request_uri().query());
 
             // Configure a query predicate, though only downgrade queries are supported on this endpoint, no basic or advanced (RQL) query parameters
-            const resource_query match(version, U('/') + resourceType, flat_query_params);
+            const auto query = details::get_resource_query(resources, version, U('/') + resourceType, flat_query_params);
+            const auto& match = *query;
 
             auto resource = find_resource(resources, { resourceId, nmos::type_from_resourceType(resourceType) });
             if (resources.end() != resource)
             {
-                if (nmos::is_permitted_downgrade(*resource, match.version, match.downgrade_version))
+                if (nmos::is_permitted_downgrade(*resource, match.version, match.downgrade_version) && match.include_descendants)
                 {
+                    // experimental extension, the resource and all its descendants, under one lock, so they are consistent with each other
+                    // the entity-tag changes whenever any resource changes, since the descendants aren't otherwise tracked
+                    const auto entity_tag = details::make_resources_entity_tag(resources);
+                    if (details::set_not_modified_reply(req, res, entity_tag))
+                    {
+                        slog::log<slog::severities::more_info>(gate, SLOG_FLF) << "Not modified: " << resourceId;
+                        return pplx::task_from_result(true);
+                    }
+
+                    const auto subtree = details::serialize_downgrade_subtree(resources, *resource, match);
+
+                    lock.unlock();
+
+                    slog::log<slog::severities::more_info>(gate, SLOG_FLF) << "Returning resource: " << resourceId << " with its descendants";
+                    details::set_utf8_json_reply(res, status_codes::OK, details::make_subtree_body(subtree));
+                    res.headers().add(web::http::header_names::etag, entity_tag);
+                }
+                else if (nmos::is_permitted_downgrade(*resource, match.version, match.downgrade_version))
+                {
+                    const auto entity_tag = details::make_resource_entity_tag(*resource);
+                    if (details::set_not_modified_reply(req, res, entity_tag))
+                    {
+                        slog::log<slog::severities::more_info>(gate, SLOG_FLF) << "Not modified: " << resourceId;
+                        return pplx::task_from_result(true);
+                    }
+
                     slog::log<slog::severities::more_info>(gate, SLOG_FLF) << "Returning resource: " << resourceId;
-                    set_reply(res, status_codes::OK, match.downgrade(*resource));
+                    // the serialized (downgraded) resource data is shared with the list responses
+                    set_reply(res, status_codes::OK, utility::conversions::to_string_t(*details::serialize_downgrade(resources, *resource, match)), web::http::details::mime_types::application_json);
+                    res.headers().add(web::http::header_names::etag, entity_tag);
 
                     // experimental extension, see also nmos::make_resource_events for equivalent WebSockets extension
                     if (!match.strip || resource->version < match.version)
@@ -314,7 +728,7 @@ namespace nmos
 
                 // Validate JSON syntax according to the schema
 
-                const bool allow_invalid_resources = nmos::fields::allow_invalid_resources(model.settings);
+                const bool allow_invalid_resources = model.get_settings_snapshot()->allow_invalid_resources;
                 if (!allow_invalid_resources)
                 {
                     validator.validate(data, experimental::make_queryapi_subscriptions_post_request_schema_uri(version));
@@ -376,18 +790,11 @@ namespace nmos
                     }
 
                     // search for a matching existing subscription
-                    auto resource = find_resource_if(resources, nmos::types::subscription, [&req_host, &version, &data](const nmos::resource& resource)
-                    {
-                        return version == resource.version
-                            && nmos::fields::max_update_rate_ms(data) == nmos::fields::max_update_rate_ms(resource.data)
-                            && nmos::fields::persist(data) == nmos::fields::persist(resource.data)
-                            && (nmos::is04_versions::v1_0 == version || nmos::fields::secure(data) == nmos::fields::secure(resource.data))
-                            && nmos::fields::resource_path(data) == nmos::fields::resource_path(resource.data)
-                            && nmos::fields::params(data) == nmos::fields::params(resource.data)
-                            // and finally, a matching subscription must be being served via the same interface as this request
-                            // (which, let's approximate by checking the host matches)
-                            && req_host == web::uri(nmos::fields::ws_href(resource.data)).host();
-                    });
+                    // a matching subscription must be being served via the same interface as this request
+                    // (which, let's approximate by checking the host matches)
+                    const auto& subscription_ids = resources.subscription_keys.ids;
+                    const auto found = subscription_ids.find(nmos::details::make_subscription_key(version, data, req_host));
+                    auto resource = subscription_ids.end() != found ? find_resource(resources, { found->second, nmos::types::subscription }) : resources.end();
                     const bool creating = resources.end() == resource;
 
                     if (creating)
@@ -428,7 +835,7 @@ namespace nmos
                         // however, it won't be set to health_forever without a lock, so no need for compare-and-exchange here
                         if (resource->health != health_forever)
                         {
-                            resource->health = health_now();
+                            details::set_resource_health(resources, *resource, health_now());
                         }
                     }
 
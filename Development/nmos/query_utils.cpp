@@ -1,12 +1,23 @@
 #include "nmos/query_utils.h"
 
+#include <algorithm>
+#include <functional>
+#include <future>
+#include <iterator>
 #include <set>
+#include <thread>
+#include <boost/algorithm/string/predicate.hpp>
 #include <boost/algorithm/string/split.hpp>
+#include <boost/make_shared.hpp>
 #include <boost/range/adaptor/reversed.hpp>
 #include "cpprest/basic_utils.h"
+#include "cpprest/json_utils.h" // for web::json::experimental::serialize_utf8, etc.
 #include "nmos/api_downgrade.h"
 #include "nmos/api_utils.h" // for nmos::resourceType_from_type
+#include "nmos/event_queues.h"
 #include "nmos/rational.h"
+#include "nmos/resource_journal.h"
+#include "nmos/tracepoints.h"
 #include "nmos/version.h"
 #include "rql/rql.h"
 
@@ -26,6 +37,10 @@ namespace nmos
         }
     }
 
+    // Extend RQL with some NMOS-specific types (see below)
+    web::json::value equal_to(const web::json::value& lhs, const web::json::value& rhs);
+    web::json::value less(const web::json::value& lhs, const web::json::value& rhs);
+
     resource_query::resource_query(const nmos::api_version& version, const utility::string_t& resource_path, const web::json::value& flat_query_params)
         : version(version)
         , resource_path(resource_path)
@@ -33,7 +48,18 @@ namespace nmos
         , downgrade_version(version)
         , strip(true)
         , match_flags(web::json::match_default)
+        , patch(false)
+        , include_descendants(false)
     {
+        if (!resource_path.empty())
+        {
+            const auto found = std::find_if(nmos::types::all.begin(), nmos::types::all.end(), [&resource_path](const nmos::type& type)
+            {
+                return resource_path == U('/') + nmos::resourceType_from_type(type);
+            });
+            if (nmos::types::all.end() != found) resource_path_type = *found;
+        }
+
         // extract the supported advanced query options
         if (basic_query.has_field(U("paging")))
         {
@@ -59,11 +85,42 @@ namespace nmos
                 {
                     strip = field.second.as_bool();
                 }
+                // extract the experimental field projection, a comma-separated list of the top-level properties to be included in each resource
+                // e.g. query.fields=id,label,device_id
+                else if (field.first == U("fields"))
+                {
+                    const auto& value = field.second.as_string();
+                    boost::algorithm::split(fields, value, [](utility::char_t c) { return U(',') == c; });
+                    fields.erase(std::remove(fields.begin(), fields.end(), utility::string_t{}), fields.end());
+                }
                 // extract the experimental match flags, which extend Basic Queries with really simple per-query control of string matching
                 else if (field.first == U("match_type"))
                 {
                     match_flags = experimental::parse_match_type(field.second.as_string());
                 }
+                // extract the experimental flag, used to send a JSON Patch in the 'modified' events for a subscription
+                // e.g. so that a receiver whose subscription.active changes doesn't result in two complete receivers being sent
+                else if (field.first == U("patch"))
+                {
+                    patch = field.second.as_bool();
+                }
+                // extract the experimental subtree fetch, so that discovering a node or device takes one request rather than one for each of its sub-resources
+                // e.g. query.include=descendants
+                else if (field.first == U("include"))
+                {
+                    if (U("descendants") != field.second.as_string()) throw std::runtime_error("unimplemented parameter - query.include=" + utility::us2s(field.second.as_string()));
+                    include_descendants = true;
+                }
+                // extract the experimental receiver compatibility query, so that the receivers that can accept a flow are found via an index rather than by comparing every receiver's caps
+                // e.g. query.compatible=urn:x-nmos:format:video,video/raw
+                else if (field.first == U("compatible"))
+                {
+                    const auto& value = field.second.as_string();
+                    const auto comma = value.find(U(','));
+                    compatible_format = value.substr(0, comma);
+                    if (utility::string_t::npos != comma) compatible_media_type = value.substr(comma + 1);
+                    if (compatible_format.empty()) throw std::runtime_error("unimplemented parameter - query.compatible=" + utility::us2s(value));
+                }
                 // taking query.ancestry_id as an example, an error should be reported for unimplemented parameters
                 // "A 501 HTTP status code should be returned where an ancestry query is attempted against a Query API which does not implement it."
                 // See https://github.com/AMWA-TV/nmos-discovery-registration/blob/v1.2/docs/2.5.%20APIs%20-%20Query%20Parameters.md#ancestry-queries-optional
@@ -74,6 +131,63 @@ namespace nmos
             }
             basic_query.erase(U("query"));
         }
+
+        compiled_basic_query = web::json::compiled_match_query(basic_query, match_flags);
+
+        if (!rql_query.is_null())
+        {
+            compiled_rql_query = rql::compile_any_query(rql_query, equal_to, less);
+        }
+    }
+
+    namespace details
+    {
+        // make the canonical key for a query, ignoring the paging parameters
+        // note, the fields of a json object are kept in order of their keys, so the serialization doesn't depend on the order of the query parameters
+        static utility::string_t make_resource_query_key(const nmos::api_version& version, const utility::string_t& resource_path, const web::json::value& flat_query_params)
+        {
+            auto query_params = web::json::value::object();
+            for (const auto& field : flat_query_params.as_object())
+            {
+                if (boost::algorithm::starts_with(field.first, U("paging."))) continue;
+                query_params[field.first] = field.second;
+            }
+            return make_api_version(version) + resource_path + U('?') + query_params.serialize();
+        }
+
+        // get the query for the specified Query API version, resource path and flat query parameters, only parsing and compiling it the first time
+        std::shared_ptr<const resource_query> get_resource_query(const nmos::resources& resources, const nmos::api_version& version, const utility::string_t& resource_path, const web::json::value& flat_query_params)
+        {
+            auto& cache = resources.query_cache;
+
+            auto key = make_resource_query_key(version, resource_path, flat_query_params);
+            {
+                std::lock_guard<std::mutex> lock(cache.mutex);
+                auto found = cache.entries.find(key);
+                if (cache.entries.end() != found)
+                {
+                    cache.usage.splice(cache.usage.begin(), cache.usage, found->second.second);
+                    return found->second.first;
+                }
+            }
+
+            // compile without the lock held; if the query is invalid, the exception is propagated and nothing is cached
+            std::shared_ptr<const resource_query> compiled = std::make_shared<resource_query>(version, resource_path, flat_query_params);
+
+            std::lock_guard<std::mutex> lock(cache.mutex);
+            if (0 == cache.capacity) return compiled;
+            auto found = cache.entries.find(key);
+            if (cache.entries.end() != found) return found->second.first;
+
+            cache.usage.push_front(key);
+            cache.entries.insert({ std::move(key), { compiled, cache.usage.begin() } });
+            if (cache.capacity < cache.entries.size())
+            {
+                cache.entries.erase(cache.usage.back());
+                cache.usage.pop_back();
+            }
+            return compiled;
+        }
     }
 
     resource_paging::resource_paging(const web::json::value& flat_query_params, const nmos::tai& max_until, size_t default_limit, size_t max_limit)
@@ -82,6 +196,7 @@ namespace nmos
         , since(nmos::tai_min())
         , limit(default_limit)
         , since_specified(false)
+        , wait(0)
     {
         auto query_params = web::json::unflatten(flat_query_params);
 
@@ -117,6 +232,25 @@ namespace nmos
                     limit = (size_t)field.second.as_integer();
                     if (limit > max_limit) limit = max_limit;
                 }
+                // experimental extension, paging.count is "total" or "only"
+                else if (field.first == U("count"))
+                {
+                    count = field.second.as_string();
+                    if (U("total") != count && U("only") != count)
+                    {
+                        throw std::runtime_error("unimplemented parameter value - paging.count=" + utility::us2s(count));
+                    }
+                }
+                // experimental extension, paging.wait is a number of seconds
+                else if (field.first == U("wait"))
+                {
+                    const auto seconds = field.second.as_integer();
+                    if (seconds < 0)
+                    {
+                        throw std::runtime_error("unimplemented parameter value - paging.wait=" + utility::us2s(field.second.serialize()));
+                    }
+                    wait = (unsigned int)seconds;
+                }
                 // as for resource_query, an error is reported for unimplemented parameters
                 else
                 {
@@ -133,11 +267,497 @@ namespace nmos
 
     namespace details
     {
+        // a query with no Basic Query or Advanced Query matches every resource of the type whose API version is permitted by the downgrade parameters
+        static bool is_type_only_query(const resource_query& query)
+        {
+            return !query.resource_path.empty()
+                && (query.basic_query.is_null() || (query.basic_query.is_object() && 0 == query.basic_query.size()))
+                && query.rql_query.is_null();
+        }
+
+        // the resource type named by the resource path of the query, or an empty type if the query isn't restricted to one type
+        nmos::type get_query_resource_type(const resource_query& query)
+        {
+            // the resource path is e.g. "/nodes" or empty, for all types (experimental extension for subscriptions)
+            static const std::set<utility::string_t> resourceTypes{ U("nodes"), U("devices"), U("sources"), U("flows"), U("senders"), U("receivers") };
+            if (query.resource_path.empty() || 0 == resourceTypes.count(query.resource_path.substr(1))) return{};
+            return nmos::type_from_resourceType(query.resource_path.substr(1));
+        }
+
+        // call the function for each resource created/updated in the range (since, until], in descending order,
+        // using the typed created/updated index if a type is specified, so that the resources of all the other types are skipped
+        template <typename Function>
+        static void for_each_resource_in_range(const nmos::resources& resources, const nmos::type& type, bool order_by_created, const nmos::tai& until, const nmos::tai& since, Function f)
+        {
+            // all the indices are in descending order, so the range (since, until] is [lower_bound(until), lower_bound(since))
+            if (!type.name.empty())
+            {
+                if (order_by_created)
+                {
+                    const typed_resources<tags::type_created> typed(resources.get<tags::type_created>(), type);
+                    std::for_each(lower_bound(typed, until), lower_bound(typed, since), f);
+                }
+                else
+                {
+                    const typed_resources<tags::type_updated> typed(resources.get<tags::type_updated>(), type);
+                    std::for_each(lower_bound(typed, until), lower_bound(typed, since), f);
+                }
+            }
+            else if (order_by_created)
+            {
+                auto& by_created = resources.get<tags::created>();
+                std::for_each(by_created.lower_bound(until), by_created.lower_bound(since), f);
+            }
+            else
+            {
+                auto& by_updated = resources.get<tags::updated>();
+                std::for_each(by_updated.lower_bound(until), by_updated.lower_bound(since), f);
+            }
+        }
+
+        // count the resources created/updated in the range (since, until], of the specified type if any, without stepping through them
+        // where the indices are ranked
+        static size_t count_resources_in_range(const nmos::resources& resources, const nmos::type& type, bool order_by_created, const nmos::tai& until, const nmos::tai& since)
+        {
+            if (!type.name.empty())
+            {
+                if (order_by_created)
+                {
+                    const typed_resources<tags::type_created> typed(resources.get<tags::type_created>(), type);
+                    return index_distance(typed.index, lower_bound(typed, until), lower_bound(typed, since));
+                }
+                else
+                {
+                    const typed_resources<tags::type_updated> typed(resources.get<tags::type_updated>(), type);
+                    return index_distance(typed.index, lower_bound(typed, until), lower_bound(typed, since));
+                }
+            }
+            else if (order_by_created)
+            {
+                auto& by_created = resources.get<tags::created>();
+                return index_distance(by_created, by_created.lower_bound(until), by_created.lower_bound(since));
+            }
+            else
+            {
+                auto& by_updated = resources.get<tags::updated>();
+                return index_distance(by_updated, by_updated.lower_bound(until), by_updated.lower_bound(since));
+            }
+        }
+    }
+
+    size_t resource_paging::total_count(const nmos::resources& resources, const resource_query& query) const
+    {
+        if (details::is_type_only_query(query))
+        {
+            const auto type = nmos::type_from_resourceType(query.resource_path.substr(1));
+
+            size_t total = 0;
+            bool all_permitted = true;
+            for (const auto& count : resources.counts)
+            {
+                if (type != count.first.first) continue;
+                if (nmos::is_permitted_downgrade(count.first.second, type, query.version, query.downgrade_version))
+                {
+                    total += count.second;
+                }
+                else if (0 != count.second)
+                {
+                    all_permitted = false;
+                }
+            }
+            if (nmos::tai_min() == since && most_recent_update(resources) <= until) return total;
+
+            // when every resource of the type matches the query, only the range needs to be considered
+            if (all_permitted) return details::count_resources_in_range(resources, type, order_by_created, until, since);
+        }
+
+        const auto in_range = [this](const nmos::resource& resource)
+        {
+            const auto& cursor = order_by_created ? resource.created : resource.updated;
+            return since < cursor && cursor <= until;
+        };
+
+        auto candidates = details::find_indexed_resources(resources, query, order_by_created);
+        if (candidates)
+        {
+            return (size_t)std::count_if(candidates->begin(), candidates->end(), [&](const nmos::resource* resource)
+            {
+                return in_range(*resource) && query(*resource);
+            });
+        }
+
+        size_t total = 0;
+        details::for_each_resource_in_range(resources, details::get_query_resource_type(query), order_by_created, until, since, [&](const nmos::resource& resource)
+        {
+            if (query(resource)) ++total;
+        });
+        return total;
+    }
+
+    namespace details
+    {
+        // a Basic Query value can only make use of a secondary index if it's a string that isn't also valid JSON
+        // since web::json::match_query will, as a last resort, treat the query string as serialized JSON
+        static bool is_indexable_query_value(const web::json::value& query_value)
+        {
+            if (!query_value.is_string()) return false;
+            std::error_code error;
+            web::json::value::parse(query_value.as_string(), error);
+            return bool(error);
+        }
+
+        // find the candidates with any of the specified keys via the specified index, if more selective than the current candidates
+        template <typename Index>
+        static void find_indexed_resources(const Index& index, const std::set<utility::string_t>& keys, boost::shared_ptr<resources_subset::storage_type>& candidates)
+        {
+            size_t count = 0;
+            for (const auto& key : keys)
+            {
+                count += index.count(key);
+                if (candidates && candidates->size() <= count) return;
+            }
+
+            candidates = boost::make_shared<resources_subset::storage_type>();
+            candidates->reserve(count);
+            for (const auto& key : keys)
+            {
+                const auto range = index.equal_range(key);
+                for (auto it = range.first; range.second != it; ++it)
+                {
+                    candidates->push_back(&*it);
+                }
+            }
+        }
+
+        // find the candidates via the specified secondary index, if applicable and more selective than the current candidates
+        template <typename Tag>
+        static void find_indexed_resources(const nmos::resources& resources, const web::json::object& basic_query, boost::shared_ptr<resources_subset::storage_type>& candidates)
+        {
+            const auto found = basic_query.find(secondary_index_property<Tag>::key());
+            if (basic_query.end() == found || !is_indexable_query_value(found->second)) return;
+
+            find_indexed_resources(resources.get<Tag>(), { found->second.as_string() }, candidates);
+        }
+
+        // find the candidates via the specified secondary index, if applicable to the property and more selective than the current candidates
+        template <typename Tag>
+        static void find_indexed_resources(const nmos::resources& resources, const utility::string_t& property, const std::set<utility::string_t>& values, boost::shared_ptr<resources_subset::storage_type>& candidates)
+        {
+            if (secondary_index_property<Tag>::key() != property) return;
+
+            find_indexed_resources(resources.get<Tag>(), values, candidates);
+        }
+
+        // find the candidates with any of the specified values of the specified tag via the tag index, if more selective than the current candidates
+        static void find_tagged_candidates(const nmos::resources& resources, const utility::string_t& name, const std::set<utility::string_t>& values, boost::shared_ptr<resources_subset::storage_type>& candidates)
+        {
+            std::vector<const std::set<nmos::id>*> tagged;
+            size_t count = 0;
+            for (const auto& value : values)
+            {
+                tagged.push_back(&details::find_tagged_resources(resources, name, value));
+                count += tagged.back()->size();
+                if (candidates && candidates->size() <= count) return;
+            }
+
+            candidates = boost::make_shared<resources_subset::storage_type>();
+            candidates->reserve(count);
+            for (const auto& ids : tagged)
+            {
+                for (const auto& id : *ids)
+                {
+                    const auto resource = resources.find(id);
+                    if (resources.end() != resource) candidates->push_back(&*resource);
+                }
+            }
+
+            // unlike the secondary indices, a resource may have more than one of the values
+            if (1 < tagged.size())
+            {
+                std::sort(candidates->begin(), candidates->end());
+                candidates->erase(std::unique(candidates->begin(), candidates->end()), candidates->end());
+            }
+        }
+
+        // find the candidates via the tag index, for each tag in the Basic Query, if more selective than the current candidates
+        static void find_tagged_candidates(const nmos::resources& resources, const web::json::object& basic_query, boost::shared_ptr<resources_subset::storage_type>& candidates)
+        {
+            const auto found = basic_query.find(U("tags"));
+            if (basic_query.end() == found || !found->second.is_object()) return;
+
+            for (const auto& tag : found->second.as_object())
+            {
+                if (is_indexable_query_value(tag.second)) find_tagged_candidates(resources, tag.first, { tag.second.as_string() }, candidates);
+            }
+        }
+
+        // find the candidates for a receiver compatibility query via the receiver compatibility index, if more selective than the current candidates
+        static void find_compatible_candidates(const nmos::resources& resources, const resource_query& query, boost::shared_ptr<resources_subset::storage_type>& candidates)
+        {
+            if (query.compatible_format.empty()) return;
+
+            const auto ids = details::find_compatible_receivers(resources, query.compatible_format, query.compatible_media_type);
+            if (candidates && candidates->size() <= ids.size()) return;
+
+            candidates = boost::make_shared<resources_subset::storage_type>();
+            candidates->reserve(ids.size());
+            for (const auto& id : ids)
+            {
+                const auto resource = resources.find(id);
+                if (resources.end() != resource) candidates->push_back(&*resource);
+            }
+        }
+
+        // an RQL value can only make use of an index if it's a string, since the indices are on string properties
+        static bool is_indexable_rql_value(const web::json::value& value)
+        {
+            return value.is_string();
+        }
+
+        // find the conjuncts of an RQL query that are exact matches on a top-level property, i.e. eq(<property>,<string>) or in(<property>,<array-of-strings>)
+        // any resource that matches the query must have one of the values of each of these properties, so the candidates can be found via an index
+        // note, with the array-friendly call-operators, a resource for which the property is an array containing one of the values also matches,
+        // but the indexed properties of valid resources are never arrays
+        static void find_rql_exact_matches(const web::json::value& arg, std::vector<std::pair<utility::string_t, std::set<utility::string_t>>>& exact_matches)
+        {
+            if (!rql::is_call_operator(arg)) return;
+
+            const auto& name = arg.at(U("name"));
+            const auto& args = arg.at(U("args"));
+            if (!name.is_string() || !args.is_array()) return;
+
+            if (U("and") == name.as_string())
+            {
+                for (const auto& conjunct : args.as_array())
+                {
+                    find_rql_exact_matches(conjunct, exact_matches);
+                }
+            }
+            else if ((U("eq") == name.as_string() || U("in") == name.as_string()) && 2 == args.size() && args.at(0).is_string())
+            {
+                const auto& values = args.at(1);
+
+                // for eq, an array value can only match an array property
+                if (U("eq") == name.as_string() && values.is_array()) return;
+
+                std::set<utility::string_t> keys;
+                if (values.is_array())
+                {
+                    for (const auto& value : values.as_array())
+                    {
+                        if (!is_indexable_rql_value(value)) return;
+                        keys.insert(value.as_string());
+                    }
+                }
+                else
+                {
+                    if (!is_indexable_rql_value(values)) return;
+                    keys.insert(values.as_string());
+                }
+
+                exact_matches.push_back({ args.at(0).as_string(), std::move(keys) });
+            }
+        }
+
+        // if the query is a Basic Query, or an Advanced Query using RQL, with an exact match on one of the properties with an index, return the subset
+        // of candidate resources from the most selective index, in the specified order; otherwise, return an empty pointer
+        boost::shared_ptr<resources_subset::storage_type> find_indexed_resources(const nmos::resources& resources, const resource_query& query, bool order_by_created)
+        {
+            boost::shared_ptr<resources_subset::storage_type> candidates;
+
+            // the experimental match flags mean the match isn't necessarily exact
+            if (web::json::match_default == query.match_flags && query.basic_query.is_object())
+            {
+                const auto& basic_query = query.basic_query.as_object();
+                // the id index is keyed by the resource id, which is the same as the id property of the resource data
+                const auto found_id = basic_query.find(U("id"));
+                if (basic_query.end() != found_id && is_indexable_query_value(found_id->second)) find_indexed_resources(resources.get<tags::id>(), { found_id->second.as_string() }, candidates);
+                find_indexed_resources<tags::node_id>(resources, basic_query, candidates);
+                find_indexed_resources<tags::device_id>(resources, basic_query, candidates);
+                find_indexed_resources<tags::source_id>(resources, basic_query, candidates);
+                find_indexed_resources<tags::flow_id>(resources, basic_query, candidates);
+                find_indexed_resources<tags::format>(resources, basic_query, candidates);
+                find_indexed_resources<tags::label>(resources, basic_query, candidates);
+                find_tagged_candidates(resources, basic_query, candidates);
+            }
+
+            // the rest of the RQL query is evaluated for the candidates, along with the Basic Query, by the query predicate itself
+            std::vector<std::pair<utility::string_t, std::set<utility::string_t>>> exact_matches;
+            find_rql_exact_matches(query.rql_query, exact_matches);
+            for (const auto& exact_match : exact_matches)
+            {
+                // the id index is keyed by the resource id, which is the same as the id property of the resource data
+                if (U("id") == exact_match.first) find_indexed_resources(resources.get<tags::id>(), exact_match.second, candidates);
+                find_indexed_resources<tags::node_id>(resources, exact_match.first, exact_match.second, candidates);
+                find_indexed_resources<tags::device_id>(resources, exact_match.first, exact_match.second, candidates);
+                find_indexed_resources<tags::source_id>(resources, exact_match.first, exact_match.second, candidates);
+                find_indexed_resources<tags::flow_id>(resources, exact_match.first, exact_match.second, candidates);
+                find_indexed_resources<tags::format>(resources, exact_match.first, exact_match.second, candidates);
+                find_indexed_resources<tags::label>(resources, exact_match.first, exact_match.second, candidates);
+                // the tag index is keyed by the tag name, i.e. the rest of the property key path after "tags."
+                // note, the key path is split on '.', so a tag name that itself contains '.' can't be matched anyway
+                static const utility::string_t tags_prefix{ U("tags.") };
+                if (0 == exact_match.first.compare(0, tags_prefix.size(), tags_prefix) && utility::string_t::npos == exact_match.first.find(U('.'), tags_prefix.size()))
+                {
+                    find_tagged_candidates(resources, exact_match.first.substr(tags_prefix.size()), exact_match.second, candidates);
+                }
+            }
+
+            find_compatible_candidates(resources, query, candidates);
+
+            if (candidates)
+            {
+                // descending order, like the created and updated indices
+                // the timestamps are copied alongside the pointers, so that the comparisons don't each have to dereference two resources
+                std::vector<std::pair<nmos::tai, const nmos::resource*>> keyed;
+                keyed.reserve(candidates->size());
+                for (const auto& resource : *candidates)
+                {
+                    keyed.push_back({ order_by_created ? resource->created : resource->updated, resource });
+                }
+                std::sort(keyed.begin(), keyed.end(), [](const std::pair<nmos::tai, const nmos::resource*>& lhs, const std::pair<nmos::tai, const nmos::resource*>& rhs) { return lhs.first > rhs.first; });
+                std::transform(keyed.begin(), keyed.end(), candidates->begin(), [](const std::pair<nmos::tai, const nmos::resource*>& key) { return key.second; });
+            }
+
+            return candidates;
+        }
+
+        // if there are at least the specified number of candidates, or resources, created/updated in the range (since, until], return the subset
+        // that match the query, in the specified order, evaluating the query concurrently for partitions of the range; otherwise, return an empty pointer
+        boost::shared_ptr<resources_subset::storage_type> find_matching_resources(const nmos::resources& resources, boost::shared_ptr<resources_subset::storage_type> candidates, const resource_query& query, bool order_by_created, const nmos::tai& until, const nmos::tai& since, size_t threshold)
+        {
+            // the descending order means the range (since, until] is bounded by the lower bounds of until and since
+            resources_subset::storage_type bounded;
+            if (candidates)
+            {
+                const resources_subset subset(candidates, order_by_created);
+                for (const auto& resource : boost::make_iterator_range(lower_bound(subset, until), lower_bound(subset, since))) bounded.push_back(&resource);
+            }
+            else
+            {
+                const auto type = get_query_resource_type(query);
+                if (count_resources_in_range(resources, type, order_by_created, until, since) < threshold) return{};
+                for_each_resource_in_range(resources, type, order_by_created, until, since, [&bounded](const nmos::resource& resource) { bounded.push_back(&resource); });
+            }
+
+            if (bounded.size() < threshold) return{};
+
+            // the caller's lock on the resources is sufficient since the query is only reading them
+            const size_t partitions = (std::min)((size_t)(std::max)(std::thread::hardware_concurrency(), 1u), bounded.size());
+            std::vector<resources_subset::storage_type> results(partitions);
+            auto evaluate = [&](size_t partition)
+            {
+                const auto first = bounded.begin() + bounded.size() * partition / partitions;
+                const auto last = bounded.begin() + bounded.size() * (partition + 1) / partitions;
+                std::copy_if(first, last, std::back_inserter(results[partition]), [&query](const nmos::resource* resource) { return query(*resource); });
+            };
+
+            std::vector<std::future<void>> workers;
+            for (size_t partition = 1; partition < partitions; ++partition)
+            {
+                workers.push_back(std::async(std::launch::async, evaluate, partition));
+            }
+            evaluate(0);
+            // rethrows any exception evaluating the query, as the serial evaluation would
+            for (auto& worker : workers) worker.get();
+
+            // merge the results, in the order of the partitions
+            size_t count = 0;
+            for (const auto& result : results) count += result.size();
+
+            auto matching = boost::make_shared<resources_subset::storage_type>();
+            matching->reserve(count);
+            for (const auto& result : results) matching->insert(matching->end(), result.begin(), result.end());
+            return matching;
+        }
+
+        // Cursor-based paging customisation point
+        resources_subset::iterator lower_bound(const resources_subset& subset, const nmos::tai& timestamp)
+        {
+            auto& storage = *subset.storage;
+            const auto found = subset.order_by_created
+                ? std::lower_bound(storage.begin(), storage.end(), timestamp, [](const nmos::resource* resource, const nmos::tai& timestamp) { return resource->created > timestamp; })
+                : std::lower_bound(storage.begin(), storage.end(), timestamp, [](const nmos::resource* resource, const nmos::tai& timestamp) { return resource->updated > timestamp; });
+            return resources_subset::iterator(boost::shared_container_iterator<resources_subset::storage_type>(found, subset.storage));
+        }
+
         // make user error information (to be used with status_codes::BadRequest)
         utility::string_t make_valid_paging_error(const nmos::resource_paging& paging)
         {
             return U("the value of the 'paging.since' parameter must be less than or equal to the value of the 'paging.until' parameter");
         }
+
+        // get the serialized (UTF-8) form of the resource data, downgraded as specified by the query, using the serialization cache of the resources
+        std::shared_ptr<const std::string> serialize_downgrade(const nmos::resources& resources, const nmos::resource& resource, const resource_query& match)
+        {
+            auto& cache = resources.serialization_cache;
+            const serialization_cache::variant_type variant{ match.version, match.downgrade_version, match.strip, match.fields };
+
+            {
+                std::lock_guard<std::mutex> lock(cache.mutex);
+                auto entries = cache.entries.find(resource.id);
+                if (cache.entries.end() != entries)
+                {
+                    auto entry = entries->second.find(variant);
+                    if (entries->second.end() != entry && resource.updated == entry->second.first) return entry->second.second;
+                }
+            }
+
+            // serialize without the cache mutex held, since this is the expensive part
+            // when the downgrade is trivial, the resource data can be serialized directly rather than copied first,
+            // and when there's no projection, the downgrade is applied while serializing
+            std::string utf8;
+            if (match.is_identity_downgrade(resource.version) && nmos::is_permitted_downgrade(resource, match.version, match.downgrade_version))
+            {
+                web::json::experimental::serialize_utf8(utf8, resource.data);
+            }
+            else if (!match.is_identity_downgrade(resource.version) && match.fields.empty())
+            {
+                nmos::serialize_downgrade_utf8(utf8, resource.version, resource.type, resource.data, match.version, match.downgrade_version);
+            }
+            else
+            {
+                web::json::experimental::serialize_utf8(utf8, *details::downgrade(resources, resource, match));
+            }
+            auto serialized = std::make_shared<const std::string>(std::move(utf8));
+
+            {
+                std::lock_guard<std::mutex> lock(cache.mutex);
+                cache.entries[resource.id][variant] = { resource.updated, serialized };
+            }
+
+            return serialized;
+        }
+
+        // get the resource data, downgraded as specified by the query, using the downgrade cache of the resources when the downgrade isn't trivial
+        std::shared_ptr<const web::json::value> downgrade(const nmos::resources& resources, const nmos::resource& resource, const resource_query& match)
+        {
+            // there's no point caching a copy of the resource data
+            if (match.is_identity_downgrade(resource.version)) return std::make_shared<const web::json::value>(match.downgrade(resource));
+
+            auto& cache = resources.downgrade_cache;
+            const downgrade_cache::variant_type variant{ match.version, match.downgrade_version, match.strip, match.fields };
+
+            {
+                std::lock_guard<std::mutex> lock(cache.mutex);
+                auto entries = cache.entries.find(resource.id);
+                if (cache.entries.end() != entries)
+                {
+                    auto entry = entries->second.find(variant);
+                    if (entries->second.end() != entry && resource.updated == entry->second.first) return entry->second.second;
+                }
+            }
+
+            // downgrade without the cache mutex held
+            auto downgraded = std::make_shared<const web::json::value>(match.downgrade(resource));
+
+            {
+                std::lock_guard<std::mutex> lock(cache.mutex);
+                cache.entries[resource.id][variant] = { resource.updated, downgraded };
+            }
+
+            return downgraded;
+        }
     }
 
     // Extend RQL with some NMOS-specific types
@@ -206,25 +826,81 @@ namespace nmos
         }(query) == rql::value_true;
     }
 
+    namespace details
+    {
+        // determine whether the receiver's caps admit a flow of the specified format and media type (or any media type of the format, if empty),
+        // exactly as the receiver compatibility index does, so that the query can also be evaluated for other candidates, and for subscriptions
+        static bool is_compatible_receiver(const nmos::type& resource_type, const web::json::value& resource_data, const utility::string_t& format, const utility::string_t& media_type)
+        {
+            if (nmos::types::receiver != resource_type) return false;
+            if (!resource_data.has_field(U("format")) || !resource_data.at(U("format")).is_string() || format != resource_data.at(U("format")).as_string()) return false;
+
+            // "If this field is not present, the media types are not constrained"
+            if (!resource_data.has_field(U("caps"))) return true;
+            const auto& caps = resource_data.at(U("caps"));
+            if (!caps.has_field(U("media_types")) || !caps.at(U("media_types")).is_array()) return true;
+
+            const auto& media_types = caps.at(U("media_types")).as_array();
+            return media_types.end() != std::find_if(media_types.begin(), media_types.end(), [&](const web::json::value& value)
+            {
+                return value.is_string() && (media_type.empty() || media_type == value.as_string());
+            });
+        }
+    }
+
     resource_query::result_type resource_query::operator()(const nmos::api_version& resource_version, const nmos::type& resource_type, const web::json::value& resource_data) const
     {
         // in theory, should be performing match_query against the downgraded resource_data but
         // in practice, I don't think that can make a difference?
-        return !resource_data.is_null()
-            && (resource_path.empty() || resource_path == U('/') + nmos::resourceType_from_type(resource_type))
+        // the type and version, which are held in the resource itself, are checked before anything that touches the resource data
+        return (resource_path.empty() || resource_path_type == resource_type)
             && nmos::is_permitted_downgrade(resource_version, resource_type, version, downgrade_version)
-            && web::json::match_query(resource_data, basic_query, match_flags)
-            && match_rql(resource_data, rql_query);
+            && !resource_data.is_null()
+            && compiled_basic_query(resource_data)
+            && (compiled_rql_query ? rql::value_true == compiled_rql_query(resource_data) : match_rql(resource_data, rql_query))
+            && (compatible_format.empty() || details::is_compatible_receiver(resource_type, resource_data, compatible_format, compatible_media_type));
+    }
+
+    namespace details
+    {
+        // copy just the specified top-level properties of the resource data, when present
+        static web::json::value project(const web::json::value& resource_data, const std::vector<utility::string_t>& fields)
+        {
+            if (!resource_data.is_object()) return resource_data;
+
+            web::json::value result = web::json::value::object();
+            for (const auto& field : fields)
+            {
+                if (resource_data.has_field(field)) result[field] = resource_data.at(field);
+            }
+            return result;
+        }
     }
 
     web::json::value resource_query::downgrade(const nmos::api_version& resource_version, const nmos::type& resource_type, const web::json::value& resource_data) const
     {
+        // the projection is done first, so that only the projected properties are ever copied
+        if (!fields.empty())
+        {
+            if (!nmos::is_permitted_downgrade(resource_version, resource_type, version, downgrade_version)) return web::json::value::null();
+
+            const auto projected = details::project(resource_data, fields);
+            if (!strip && resource_version.major == version.major && resource_version.minor > version.minor) return projected;
+            return nmos::downgrade(resource_version, resource_type, projected, version, downgrade_version);
+        }
+
         // when requested, return the resource not stripped
         if (!strip && resource_version.major == version.major && resource_version.minor > version.minor) return resource_data;
 
         return nmos::downgrade(resource_version, resource_type, resource_data, version, downgrade_version);
     }
 
+    bool resource_query::is_identity_downgrade(const nmos::api_version& resource_version) const
+    {
+        // see resource_query::downgrade and nmos::downgrade
+        return fields.empty() && (resource_version <= version || (!strip && resource_version.major == version.major));
+    }
+
     // Helpers for constructing /subscriptions websocket grains
 
     namespace details
@@ -293,7 +969,8 @@ namespace nmos
 
             if (!has_pre && !has_post)
             {
-                return resource_continued_nonexistence_event;
+                // experimental extension, for the query.patch flag
+                return event.has_field(U("patch")) ? resource_modified_event : resource_continued_nonexistence_event;
             }
             else if (!has_pre && has_post)
             {
@@ -310,10 +987,38 @@ namespace nmos
         }
     }
 
+    namespace details
+    {
+        // make the 'sync' resource event for the specified resource
+        static web::json::value make_sync_resource_event(const nmos::resources& resources, const resource_query& match, const utility::string_t& resource_path, const nmos::resource& resource)
+        {
+            const auto resource_data = details::downgrade(resources, resource, match);
+            auto event = details::make_resource_event(resource_path, resource.type, *resource_data, *resource_data);
+
+            // experimental extension, for the query.strip flag
+
+            // api_version: the API version of the Node API exposing this resource, omitted when equal to the subscription Query API version (an equivalent HTTP response header has been discussed for v1.3)
+            // also omitted unless resource_path is empty (since that's also an extension);
+            // ironically, the latter is a schema violation, but the former wouldn't be because the schema
+            // does not have "additionalProperties": false
+            // see nmos-discovery-registration/APIs/schemas/queryapi-subscriptions-websocket.json
+            if (resource_path.empty())
+            {
+                if (!match.strip || resource.version < match.version)
+                {
+                    event[nmos::experimental::fields::api_version] = web::json::value::string(nmos::make_api_version(resource.version));
+                }
+            }
+
+            return event;
+        }
+    }
+
     // make the initial 'sync' resource events for a new grain, including all resources that match the specified version, resource path and flat query parameters
     web::json::value make_resource_events(const nmos::resources& resources, const nmos::api_version& version, const utility::string_t& resource_path, const web::json::value& params)
     {
-        const resource_query match(version, resource_path, params);
+        const auto query = details::get_resource_query(resources, version, resource_path, params);
+        const auto& match = *query;
 
         std::vector<web::json::value> events;
 
@@ -327,70 +1032,244 @@ namespace nmos
 
             if (match(resource))
             {
-                const auto resource_data = match.downgrade(resource);
-                auto event = details::make_resource_event(resource_path, resource.type, resource_data, resource_data);
+                events.push_back(details::make_sync_resource_event(resources, match, resource_path, resource));
+            }
+        }
 
-                // experimental extension, for the query.strip flag
+        return web::json::value_from_elements(events);
+    }
 
-                // api_version: the API version of the Node API exposing this resource, omitted when equal to the subscription Query API version (an equivalent HTTP response header has been discussed for v1.3)
-                // also omitted unless resource_path is empty (since that's also an extension);
-                // ironically, the latter is a schema violation, but the former wouldn't be because the schema
-                // does not have "additionalProperties": false
-                // see nmos-discovery-registration/APIs/schemas/queryapi-subscriptions-websocket.json
-                if (resource_path.empty())
+    // make the next 'sync' resource events for a grain, including up to the specified number of resources that match the specified version, resource path and flat query parameters,
+    // from those created after the specified cursor and at or before the specified snapshot point
+    // if a size limit is specified, the events are also limited to about that number of bytes when serialized, although at least one event is included
+    web::json::value make_resource_events(const nmos::resources& resources, const nmos::api_version& version, const utility::string_t& resource_path, const web::json::value& params, nmos::tai& cursor, const nmos::tai& until, size_t limit, size_t size_limit)
+    {
+        const auto query = details::get_resource_query(resources, version, resource_path, params);
+        const auto& match = *query;
+
+        std::vector<web::json::value> events;
+        size_t size = 0;
+
+        // as above, resources are traversed in order of increasing creation timestamp
+        // since the created index is in descending order, the resources created after the cursor and at or before the snapshot point
+        // are those from the lower bound of the snapshot point up to the lower bound of the cursor
+        auto& by_created = resources.get<tags::created>();
+        const auto range = boost::make_iterator_range(by_created.lower_bound(until), by_created.lower_bound(cursor));
+        for (const auto& resource : range | boost::adaptors::reversed)
+        {
+            if (limit <= events.size()) return web::json::value_from_elements(events);
+
+            if (details::is_queryable_resource(resource.type) && match(resource))
+            {
+                auto event = details::make_sync_resource_event(resources, match, resource_path, resource);
+                if (0 != size_limit)
                 {
-                    if (!match.strip || resource.version < match.version)
-                    {
-                        event[nmos::experimental::fields::api_version] = web::json::value::string(nmos::make_api_version(resource.version));
-                    }
+                    // the cursor isn't advanced, so this resource is the first one considered next time
+                    const auto event_size = web::json::experimental::serialized_utf8_size(event);
+                    if (!events.empty() && size_limit < size + event_size) return web::json::value_from_elements(events);
+                    size += event_size + 1;
                 }
-
-                events.push_back(event);
+                events.push_back(std::move(event));
             }
+
+            cursor = resource.created;
         }
 
+        // all the resources up to the snapshot point have now been considered
+        cursor = until;
+
         return web::json::value_from_elements(events);
     }
 
-    // insert 'added', 'removed' or 'modified' resource events into all grains whose subscriptions match the specified version, type and "pre" or "post" values
-    void insert_resource_events(nmos::resources& resources, const nmos::api_version& version, const nmos::type& type, const web::json::value& pre, const web::json::value& post)
+    namespace details
     {
-        using utility::string_t;
-        using web::json::value;
+        // get the query for the specified subscription, only parsing the subscription params the first time
+        static const resource_query& subscription_query(nmos::resources& resources, const nmos::resource& subscription)
+        {
+            auto& entry = resources.subscription_queries[subscription.id];
+            if (!entry.second || subscription.created != entry.first)
+            {
+                entry = { subscription.created, get_resource_query(resources, subscription.version, nmos::fields::resource_path(subscription.data), nmos::fields::params(subscription.data)) };
+            }
+            return *entry.second;
+        }
 
-        if (!details::is_queryable_resource(type)) return;
+        // the pending events of a grain are held directly in its grain data, while those of an event queue are shared between queues
+        static const web::json::value& event_of(const web::json::value& event) { return event; }
+        static const web::json::value& event_of(const nmos::event_queue::shared_event& event) { return *event; }
+
+        // replace a pending event with the coalesced event, which is never shared with another grain or event queue
+        static void assign_event(web::json::value& event, web::json::value&& coalesced) { event = std::move(coalesced); }
+        static void assign_event(nmos::event_queue::shared_event& event, web::json::value&& coalesced) { event = std::make_shared<const web::json::value>(std::move(coalesced)); }
 
-        auto& by_type = resources.get<tags::type>();
-        const auto subscriptions = by_type.equal_range(details::has_data(nmos::types::subscription));
-        for (auto it = subscriptions.first; subscriptions.second != it; ++it)
+        // insert the resource event into the pending events of a grain or event queue, optionally coalescing it with any pending event for the same resource
+        // e.g. 'added' then 'modified' becomes 'added', 'added' then 'removed' becomes nothing, 'modified' then 'removed' becomes 'removed'
+        // and a pending 'sync' event is treated like an 'added' event, i.e. 'sync' then 'modified' becomes 'sync', 'sync' then 'removed' becomes nothing
+        template <typename Events>
+        static void insert_resource_event(Events& storage, const typename Events::value_type& event, bool coalesce)
         {
-            // for each subscription
-            const auto& subscription = *it;
+            if (coalesce)
+            {
+                const auto& path = event_of(event).at(U("path"));
+                const auto found = std::find_if(storage.rbegin(), storage.rend(), [&path](const typename Events::value_type& pending) { return event_of(pending).at(U("path")) == path; });
+                // a JSON Patch only applies to the resource as it was after the previous event, so neither it nor a subsequent event can be coalesced
+                if (storage.rend() != found && !event_of(*found).has_field(U("patch")) && !event_of(event).has_field(U("patch")))
+                {
+                    const auto pending = std::prev(found.base());
+                    const auto& pending_event = event_of(*pending);
+
+                    // the coalesced event has the "pre" of the pending event and the "post" of the new event
+                    // except that a 'sync' event stays a 'sync' event (with the "pre" also being the "post" of the new event)
+                    const bool pending_sync = resource_unchanged_event == get_resource_event_type(pending_event);
+                    auto coalesced = event_of(event);
+                    if (pending_sync && coalesced.has_field(U("post")))
+                        coalesced[U("pre")] = coalesced.at(U("post"));
+                    else if (pending_sync)
+                        coalesced.erase(U("pre"));
+                    else if (pending_event.has_field(U("pre")))
+                        coalesced[U("pre")] = pending_event.at(U("pre"));
+                    else if (coalesced.has_field(U("pre")))
+                        coalesced.erase(U("pre"));
+
+                    const bool has_pre = coalesced.has_field(U("pre"));
+                    const bool has_post = coalesced.has_field(U("post"));
+
+                    if (!has_pre && !has_post)
+                    {
+                        // the resource was added and then removed, so the client need never know
+                        storage.erase(pending);
+                    }
+                    else if (!has_pre || pending_sync)
+                    {
+                        // an 'added' (or 'sync') event stays where it was, so that it remains before the events for any sub-resources
+                        assign_event(*pending, std::move(coalesced));
+                    }
+                    else
+                    {
+                        // a 'modified' or 'removed' event goes at the end, so that a 'removed' event remains after those for any sub-resources
+                        storage.erase(pending);
+                        typename Events::value_type last;
+                        assign_event(last, std::move(coalesced));
+                        storage.push_back(std::move(last));
+                    }
+                    return;
+                }
+            }
+
+            storage.push_back(event);
+        }
+
+        // many subscriptions share the same resource path, Query API version, downgrade version, strip and patch flags and projected fields, and therefore get exactly the same
+        // (downgraded) resource event, so for each resource change, the events are made just once for each such variant, and whether "pre" and "post" match
+        // and each event is then shared by the event queues of all the websocket connections to those subscriptions
+        typedef std::tuple<utility::string_t, api_version, api_version, bool, std::vector<utility::string_t>, bool, bool, bool> resource_event_variant;
+
+        // the variants that differ only in resource path, patch flag, or whether "pre" and "post" match, e.g. subscriptions of the same Query API version with different queries,
+        // still have the same downgraded "pre" and "post" values, so for each resource change, the values are downgraded just once for each Query API version, downgrade version,
+        // strip flag and projected fields, and then copied into each event
+        typedef std::tuple<api_version, api_version, bool, std::vector<utility::string_t>> resource_downgrade_variant;
+
+        struct resource_event_cache
+        {
+            std::map<resource_event_variant, nmos::event_queue::shared_event> events;
+            std::map<resource_downgrade_variant, std::pair<std::shared_ptr<const web::json::value>, std::shared_ptr<const web::json::value>>> downgrades;
+        };
+
+        // downgrade the "pre" or "post" value of a resource change for the specified query, just once for each downgrade variant
+        // when the resource isn't actually being downgraded or projected, downgrade just returns a copy, so there's nothing to share
+        static web::json::value downgrade_resource_event_value(const resource_query& match, const nmos::api_version& version, const nmos::type& type, const web::json::value& value, std::shared_ptr<const web::json::value>& downgraded)
+        {
+            if (!(match.version < version) && match.fields.empty()) return match.downgrade(version, type, value);
+            if (!downgraded) downgraded = std::make_shared<const web::json::value>(match.downgrade(version, type, value));
+            return *downgraded;
+        }
+
+        // make the resource event for the specified subscription, if its query matches the "pre" or "post" values, or return nullptr
+        // the event is made just once for each variant, and kept in the cache
+        static nmos::event_queue::shared_event make_subscription_resource_event(nmos::resources& resources, const nmos::resource& subscription, const nmos::api_version& version, const nmos::type& type, const web::json::value& pre, const web::json::value& post, resource_event_cache& events_cache)
+        {
+            using web::json::value;
 
             // check whether the resource_path matches the resource type and the query parameters match either the "pre" or "post" resource
 
-            const auto resource_path = nmos::fields::resource_path(subscription.data);
-            const resource_query match(subscription.version, resource_path, nmos::fields::params(subscription.data));
+            const auto& resource_path = nmos::fields::resource_path(subscription.data);
+            const auto& match = subscription_query(resources, subscription);
 
             const bool pre_match = match(version, type, pre);
             const bool post_match = match(version, type, post);
 
-            if (!pre_match && !post_match) continue;
+            if (!pre_match && !post_match) return nullptr;
 
-            // add the event to the grain for each websocket connection to this subscription
+            const resource_event_variant variant{ resource_path, match.version, match.downgrade_version, match.strip, match.fields, match.patch, pre_match, post_match };
+            auto cached = events_cache.events.find(variant);
+            if (events_cache.events.end() == cached)
+            {
+                // note: downgrade just returns a copy in the case that version <= match.version
+                auto& downgraded = events_cache.downgrades[resource_downgrade_variant{ match.version, match.downgrade_version, match.strip, match.fields }];
+                auto event = details::make_resource_event(resource_path, type,
+                    pre_match ? downgrade_resource_event_value(match, version, type, pre, downgraded.first) : value::null(),
+                    post_match ? downgrade_resource_event_value(match, version, type, post, downgraded.second) : value::null()
+                    );
 
-            // note: downgrade just returns a copy in the case that version <= match.version
-            auto event = details::make_resource_event(resource_path, type,
-                pre_match ? match.downgrade(version, type, pre) : value::null(),
-                post_match ? match.downgrade(version, type, post) : value::null()
-                );
+                // experimental extension, for the query.patch flag
+                // a 'modified' event has the JSON Patch from "pre" to "post" instead, computed once for all the subscriptions that share this variant
+                if (match.patch && resource_modified_event == get_resource_event_type(event))
+                {
+                    event[U("patch")] = web::json::experimental::make_patch(event.at(U("pre")), event.at(U("post")));
+                    event.erase(U("pre"));
+                    event.erase(U("post"));
+                }
 
-            // see explanation in nmos::make_resource_events
-            if (resource_path.empty())
+                // see explanation in nmos::make_resource_events
+                if (resource_path.empty())
+                {
+                    if (!match.strip || version < match.version)
+                    {
+                        event[nmos::experimental::fields::api_version] = web::json::value::string(nmos::make_api_version(version));
+                    }
+                }
+
+                cached = events_cache.events.insert({ variant, std::make_shared<const web::json::value>(std::move(event)) }).first;
+            }
+            return cached->second;
+        }
+
+        // insert the resource event into the event queues (or grains) of all websocket connections to the specified subscription, if its query matches the "pre" or "post" values
+        // (with the event queues mutex locked, if there are any)
+        static void insert_resource_events(nmos::resources& resources, const nmos::resource& subscription, const nmos::api_version& version, const nmos::type& type, const web::json::value& pre, const web::json::value& post, resource_event_cache& events_cache)
+        {
+            // there's no need to match the query if there are no websocket connections to this subscription
+            // the Query WebSocket API uses event queues, and the Events WebSocket API uses grain sub-resources of the subscription
+
+            const nmos::event_queues::connection_ids* connections = nullptr;
+            if (resources.event_queues)
             {
-                if (!match.strip || version < match.version)
+                auto found = resources.event_queues->subscriptions.find(subscription.id);
+                if (resources.event_queues->subscriptions.end() != found) connections = &found->second;
+            }
+            if (nullptr == connections && subscription.sub_resources.empty()) return;
+
+            const auto event = make_subscription_resource_event(resources, subscription, version, type, pre, post, events_cache);
+            if (nullptr == event) return;
+            NMOS_CPP_TRACE(subscription_match, subscription.id.c_str(), 1);
+
+            // add the event to the queue or grain for each websocket connection to this subscription
+
+            // note: unlike modifying a grain resource, pushing onto a queue doesn't re-index anything or update the most recent update timestamp
+            // and doesn't copy the event either
+            if (nullptr != connections)
+            {
+                auto& queues = *resources.event_queues;
+                const auto ingress = std::chrono::steady_clock::time_point{} != queues.ingress ? queues.ingress : std::chrono::steady_clock::now();
+                for (const auto& id : *connections)
                 {
-                    event[nmos::experimental::fields::api_version] = web::json::value::string(nmos::make_api_version(version));
+                    auto queue = queues.queues.find(id);
+                    if (queues.queues.end() == queue) continue;
+
+                    insert_resource_event(queue->second.events, event, queue->second.coalesce);
+                    NMOS_CPP_TRACE(ws_enqueue, id.c_str(), 1);
+                    queue->second.ingress = (std::min)(queue->second.ingress, ingress);
+                    queues.notify(queue->second);
                 }
             }
 
@@ -401,11 +1280,189 @@ namespace nmos
 
                 resources.modify(grain, [&resources, &event](nmos::resource& grain)
                 {
+                    const bool coalesce = nmos::experimental::fields::coalesce_events(grain.data);
                     auto& events = nmos::fields::message_grain_data(grain.data);
-                    web::json::push_back(events, event);
+                    insert_resource_event(web::json::storage_of(events.as_array()), *event, coalesce);
+                    grain.updated = strictly_increasing_update(resources);
+                });
+            }
+        }
+
+        // insert the resource events for a batch of resource changes into the event queues (or grains) of all websocket connections to the specified subscription,
+        // for each change whose type matches its resource_path and whose "pre" or "post" values match its query (with the event queues mutex locked, if there are any)
+        static void insert_resource_events(nmos::resources& resources, const nmos::resource& subscription, const std::vector<nmos::resource_change>& changes, const std::vector<utility::string_t>& change_paths, std::vector<resource_event_cache>& events_caches)
+        {
+            const nmos::event_queues::connection_ids* connections = nullptr;
+            if (resources.event_queues)
+            {
+                auto found = resources.event_queues->subscriptions.find(subscription.id);
+                if (resources.event_queues->subscriptions.end() != found) connections = &found->second;
+            }
+            if (nullptr == connections && subscription.sub_resources.empty()) return;
+
+            // make the events for this subscription, in the order of the changes
+
+            const auto& resource_path = nmos::fields::resource_path(subscription.data);
+            std::vector<nmos::event_queue::shared_event> events;
+            for (size_t i = 0; i < changes.size(); ++i)
+            {
+                const auto& change = changes[i];
+                if (change_paths[i].empty() || (!resource_path.empty() && resource_path != change_paths[i])) continue;
+
+                const auto made = make_subscription_resource_event(resources, subscription, change.version, change.type, change.pre, change.post, events_caches[i]);
+                if (nullptr != made) events.push_back(made);
+            }
+            if (events.empty()) return;
+            NMOS_CPP_TRACE(subscription_match, subscription.id.c_str(), events.size());
+
+            // add the events to the queue or grain for each websocket connection to this subscription
+
+            if (nullptr != connections)
+            {
+                auto& queues = *resources.event_queues;
+                const auto ingress = std::chrono::steady_clock::time_point{} != queues.ingress ? queues.ingress : std::chrono::steady_clock::now();
+                for (const auto& id : *connections)
+                {
+                    auto queue = queues.queues.find(id);
+                    if (queues.queues.end() == queue) continue;
+
+                    for (const auto& event : events)
+                    {
+                        insert_resource_event(queue->second.events, event, queue->second.coalesce);
+                    }
+                    NMOS_CPP_TRACE(ws_enqueue, id.c_str(), events.size());
+                    queue->second.ingress = (std::min)(queue->second.ingress, ingress);
+                    queues.notify(queue->second);
+                }
+            }
+
+            // modifying a grain re-indexes it, so all the events are inserted in a single modification
+            for (const auto& id : subscription.sub_resources)
+            {
+                auto grain = find_resource(resources, { id, nmos::types::grain });
+                if (resources.end() == grain) continue; // check websocket connection is still open
+
+                resources.modify(grain, [&resources, &events](nmos::resource& grain)
+                {
+                    const bool coalesce = nmos::experimental::fields::coalesce_events(grain.data);
+                    auto& pending = web::json::storage_of(nmos::fields::message_grain_data(grain.data).as_array());
+                    for (const auto& event : events)
+                    {
+                        insert_resource_event(pending, *event, coalesce);
+                    }
                     grain.updated = strictly_increasing_update(resources);
                 });
             }
         }
     }
+
+    // insert 'added', 'removed' or 'modified' resource events into the event queues (or grains) of all websocket connections whose subscriptions match the specified version, type and "pre" or "post" values
+    void insert_resource_events(nmos::resources& resources, const nmos::api_version& version, const nmos::type& type, const web::json::value& pre, const web::json::value& post)
+    {
+        std::unique_lock<std::mutex> lock;
+        if (resources.event_queues) lock = std::unique_lock<std::mutex>(resources.event_queues->mutex);
+
+        // the websocket connections to a subscription which has been erased need to be closed by nmos::send_query_ws_events_thread
+        if (nmos::types::subscription == type && post.is_null() && resources.event_queues)
+        {
+            auto& queues = *resources.event_queues;
+            auto connections = queues.subscriptions.find(nmos::fields::id(pre));
+            if (queues.subscriptions.end() != connections) queues.ready.insert(connections->second.begin(), connections->second.end());
+        }
+
+        if (!details::is_queryable_resource(type)) return;
+
+        // only subscriptions whose resource_path matches the resource type, or is empty (experimental extension), need to be considered
+        auto& by_resource_path = resources.get<tags::subscription_resource_path>();
+        const utility::string_t resource_paths[] = { U("/") + nmos::resourceType_from_type(type), {} };
+        details::resource_event_cache events_cache;
+        for (const auto& path : resource_paths)
+        {
+            const auto subscriptions = by_resource_path.equal_range(path);
+            for (auto it = subscriptions.first; subscriptions.second != it; ++it)
+            {
+                // for each subscription
+                details::insert_resource_events(resources, *it, version, type, pre, post, events_cache);
+            }
+        }
+    }
+
+    // insert the resource events for a batch of resource changes, in order, e.g. for all the resources erased by a cascaded deletion or expiry,
+    // locking the event queues mutex, finding the subscriptions to consider, and modifying the grain for each websocket connection, just once for the whole batch
+    // (each change has the most recent update timestamp of the resources when it was made)
+    void insert_resource_events(nmos::resources& resources, const std::vector<nmos::resource_change>& changes)
+    {
+        if (changes.empty()) return;
+
+        std::unique_lock<std::mutex> lock;
+        if (resources.event_queues) lock = std::unique_lock<std::mutex>(resources.event_queues->mutex);
+
+        // the resource path that matches each change, or empty for a change to a resource which isn't queryable
+        std::vector<utility::string_t> change_paths;
+        change_paths.reserve(changes.size());
+        std::set<utility::string_t> resource_paths;
+
+        for (const auto& change : changes)
+        {
+            // the websocket connections to a subscription which has been erased need to be closed by nmos::send_query_ws_events_thread
+            if (nmos::types::subscription == change.type && change.post.is_null() && resources.event_queues)
+            {
+                auto& queues = *resources.event_queues;
+                auto connections = queues.subscriptions.find(nmos::fields::id(change.pre));
+                if (queues.subscriptions.end() != connections) queues.ready.insert(connections->second.begin(), connections->second.end());
+            }
+
+            if (!details::is_queryable_resource(change.type))
+            {
+                change_paths.push_back({});
+                continue;
+            }
+
+            change_paths.push_back(U("/") + nmos::resourceType_from_type(change.type));
+            resource_paths.insert(change_paths.back());
+        }
+
+        if (resource_paths.empty()) return;
+
+        // subscriptions whose resource_path is empty (experimental extension) need to be considered too
+        resource_paths.insert({});
+
+        // each subscription is considered just once, for all the changes
+        auto& by_resource_path = resources.get<tags::subscription_resource_path>();
+        std::vector<details::resource_event_cache> events_caches(changes.size());
+        for (const auto& path : resource_paths)
+        {
+            const auto subscriptions = by_resource_path.equal_range(path);
+            for (auto it = subscriptions.first; subscriptions.second != it; ++it)
+            {
+                // for each subscription
+                details::insert_resource_events(resources, *it, changes, change_paths, events_caches);
+            }
+        }
+    }
+
+    // insert the resource changes since the specified cursor, from the resource journal, into the event queue of a websocket connection to the specified subscription, if its query matches,
+    // and return true, or return false, without inserting anything, if the changes since the cursor are no longer all retained, or there are more than the specified limit
+    // (with the event queues mutex locked)
+    bool insert_resource_events(nmos::resources& resources, nmos::event_queue& queue, const nmos::resource& subscription, const nmos::tai& cursor, size_t limit)
+    {
+        if (!resources.journal || 0 == limit || most_recent_update(resources) < cursor) return false;
+
+        std::vector<nmos::experimental::shared_journal_entry> changes;
+        if (!resources.journal->read_since(cursor, changes)) return false;
+
+        // the journal may retain more changes than a resumed connection is allowed
+        if (limit < (size_t)std::count_if(changes.begin(), changes.end(), [](const nmos::experimental::shared_journal_entry& change) { return details::is_queryable_resource(change->type); })) return false;
+
+        const auto null = web::json::value::null();
+        for (const auto& change : changes)
+        {
+            if (!details::is_queryable_resource(change->type)) continue;
+
+            details::resource_event_cache events_cache;
+            const auto event = details::make_subscription_resource_event(resources, subscription, change->version, change->type, change->pre ? *change->pre : null, change->post ? *change->post : null, events_cache);
+            if (nullptr != event) details::insert_resource_event(queue.events, event, queue.coalesce);
+        }
+        return true;
+    }
 }
@@ -1,9 +1,12 @@
 #ifndef NMOS_QUERY_UTILS_H
 #define NMOS_QUERY_UTILS_H
 
+#include <boost/iterator/indirect_iterator.hpp>
 #include <boost/range/any_range.hpp>
+#include <boost/shared_container_iterator.hpp>
 #include "nmos/paging_utils.h"
 #include "nmos/resources.h"
+#include "rql/rql.h"
 
 namespace nmos
 {
@@ -28,12 +31,19 @@ namespace nmos
         result_type operator()(const nmos::api_version& resource_version, const nmos::type& resource_type, const web::json::value& resource_data) const;
         web::json::value downgrade(const nmos::api_version& resource_version, const nmos::type& resource_type, const web::json::value& resource_data) const;
 
+        // whether downgrade returns the resource data unchanged, when the downgrade is permitted
+        bool is_identity_downgrade(const nmos::api_version& resource_version) const;
+
         // the Query API version (since a registry being queried may contain resources of more than one version of IS-04 Discovery and Registration)
         nmos::api_version version;
 
         // resource_path may be empty (matching all resource types) or e.g. "/nodes"
         utility::string_t resource_path;
 
+        // the resource type named by resource_path, found once rather than for every resource,
+        // or an empty type if resource_path is empty, or names no type (in which case no resource matches)
+        nmos::type resource_path_type;
+
         // the query/exemplar object for a Basic Query
         web::json::value basic_query;
 
@@ -46,10 +56,99 @@ namespace nmos
         // a representation of the RQL abstract syntax tree for an Advanced Query
         web::json::value rql_query;
 
+        // the Advanced Query compiled once, rather than being interpreted for every resource
+        rql::compiled_query compiled_rql_query;
+
         // flags that affect the Basic Query (experimental)
         web::json::match_flag_type match_flags;
+
+        // the Basic Query compiled once, with the match flags, rather than being interpreted for every resource
+        web::json::compiled_match_query compiled_basic_query;
+
+        // the top-level properties to which each resource is projected (experimental), or empty for the whole resource
+        std::vector<utility::string_t> fields;
+
+        // whether the 'modified' events for a subscription carry an RFC 6902 JSON Patch from "pre" to "post" rather than both values (experimental)
+        bool patch;
+
+        // whether a request for a single resource also returns all its descendants, e.g. a node with its devices and their senders, receivers, sources and flows (experimental)
+        bool include_descendants;
+
+        // the format and media type of a flow, for which only the receivers whose caps admit it are matched (experimental), or empty to match all resources
+        // an empty media type matches the receivers that admit any media type of the format
+        utility::string_t compatible_format;
+        utility::string_t compatible_media_type;
     };
 
+    namespace details
+    {
+        // get the query for the specified Query API version, resource path and flat query parameters, only parsing and compiling it the first time
+        // the paging parameters are ignored, since they don't affect the query, and are different for each page
+        // throws like the resource_query constructor if the query is invalid, in which case nothing is cached
+        std::shared_ptr<const resource_query> get_resource_query(const nmos::resources& resources, const nmos::api_version& version, const utility::string_t& resource_path, const web::json::value& flat_query_params);
+
+        // a subset of the resources in descending order of creation or update timestamp, like the created or updated index,
+        // e.g. the candidates for a query found via one of the secondary indices
+        // note, iterators share ownership of the storage so a range (e.g. a page) may outlive the subset itself
+        struct resources_subset
+        {
+            typedef std::vector<const nmos::resource*> storage_type;
+            typedef boost::indirect_iterator<boost::shared_container_iterator<storage_type>> iterator;
+            typedef iterator const_iterator;
+            typedef storage_type::size_type size_type;
+
+            resources_subset(boost::shared_ptr<storage_type> storage, bool order_by_created) : storage(storage), order_by_created(order_by_created) {}
+
+            iterator begin() const { return iterator(boost::shared_container_iterator<storage_type>(storage->begin(), storage)); }
+            iterator end() const { return iterator(boost::shared_container_iterator<storage_type>(storage->end(), storage)); }
+
+            boost::shared_ptr<storage_type> storage;
+            bool order_by_created;
+        };
+
+        // the extant resources of one type, in descending order of creation or update timestamp, like the created or updated index
+        // see tags::type_created and tags::type_updated
+        template <typename Tag>
+        struct typed_resources
+        {
+            typedef typename nmos::resources::index<Tag>::type index_type;
+            typedef typename index_type::const_iterator iterator;
+            typedef iterator const_iterator;
+            typedef typename index_type::size_type size_type;
+
+            typed_resources(const index_type& index, const nmos::type& type) : index(index), type(type), range(index.equal_range(has_data(type))) {}
+
+            iterator begin() const { return range.first; }
+            iterator end() const { return range.second; }
+
+            const index_type& index;
+            nmos::type type;
+            std::pair<iterator, iterator> range;
+        };
+
+        // the resource type named by the resource path of the query, or an empty type if the query isn't restricted to one type
+        nmos::type get_query_resource_type(const resource_query& query);
+
+        // if the query is a Basic Query, or an Advanced Query using RQL, with an exact match on one of the properties with an index, return the subset
+        // of candidate resources from the most selective index, in the specified order; otherwise, return an empty pointer
+        boost::shared_ptr<resources_subset::storage_type> find_indexed_resources(const nmos::resources& resources, const resource_query& query, bool order_by_created);
+
+        // an Advanced Query using RQL, or a Basic Query using the experimental match flags, is relatively expensive to evaluate for each resource
+        inline bool is_expensive_query(const resource_query& query) { return !query.rql_query.is_null() || web::json::match_default != query.match_flags; }
+
+        // if there are at least the specified number of candidates, or resources, created/updated in the range (since, until], return the subset
+        // that match the query, in the specified order, evaluating the query concurrently for partitions of the range; otherwise, return an empty pointer
+        boost::shared_ptr<resources_subset::storage_type> find_matching_resources(const nmos::resources& resources, boost::shared_ptr<resources_subset::storage_type> candidates, const resource_query& query, bool order_by_created, const nmos::tai& until, const nmos::tai& since, size_t threshold);
+
+        // a default-constructible predicate for the resources in a subset that have already been matched
+        struct match_any_resource
+        {
+            typedef const nmos::resource& argument_type;
+            typedef bool result_type;
+            result_type operator()(argument_type) const { return true; }
+        };
+    }
+
     // Cursor-based paging parameters
     struct resource_paging
     {
@@ -74,6 +173,20 @@ namespace nmos
         // where a resulting data set is constrained by the server's value of 'limit'"
         bool since_specified;
 
+        // experimental extension, "total" to report the count of all the resources which match the query in the range [until, since), regardless of the limit,
+        // or "only" to report just that count, with an empty page; or an empty string for neither
+        utility::string_t count;
+
+        // experimental extension, the maximum number of seconds to wait for resources which match the query to be created/updated since the time specified,
+        // when there are none yet, rather than immediately returning an empty page; or 0 not to wait
+        // see nmos::experimental::fields::query_paging_wait_limit
+        unsigned int wait;
+
+        // count the resources which match the query in the range [until, since), without serializing any of them
+        // when the whole range is requested for a query that only depends on the resource type, this uses the maintained resource counts,
+        // otherwise the query is evaluated for the candidates from one of the secondary indices if possible, or for all the resources in the range
+        size_t total_count(const nmos::resources& resources, const resource_query& query) const;
+
         template <typename Predicate>
         boost::any_range<const nmos::resource, boost::bidirectional_traversal_tag, const nmos::resource&, std::ptrdiff_t> page(const nmos::resources& resources, Predicate match)
         {
@@ -86,12 +199,110 @@ namespace nmos
                 return paging::cursor_based_page(resources.get<tags::updated>(), match, until, since, limit, !since_specified);
             }
         }
+
+        // page through just the extant resources of the specified type, using the typed created/updated index
+        template <typename Predicate>
+        boost::any_range<const nmos::resource, boost::bidirectional_traversal_tag, const nmos::resource&, std::ptrdiff_t> page(const nmos::resources& resources, Predicate match, const nmos::type& type)
+        {
+            if (order_by_created)
+            {
+                const details::typed_resources<tags::type_created> typed(resources.get<tags::type_created>(), type);
+                return paging::cursor_based_page(typed, match, until, since, limit, !since_specified);
+            }
+            else
+            {
+                const details::typed_resources<tags::type_updated> typed(resources.get<tags::type_updated>(), type);
+                return paging::cursor_based_page(typed, match, until, since, limit, !since_specified);
+            }
+        }
+
+        // where possible, use one of the secondary indices to find the candidates for the query, rather than filtering all the resources
+        // or otherwise, when the query names a resource type, the typed created/updated index
+        // and when the query is expensive to evaluate and there are at least parallel_threshold resources to consider (0 means never),
+        // evaluate it concurrently for partitions of the candidates; the match predicate must be equivalent to the query
+        template <typename Predicate>
+        boost::any_range<const nmos::resource, boost::bidirectional_traversal_tag, const nmos::resource&, std::ptrdiff_t> page(const nmos::resources& resources, Predicate match, const resource_query& query, size_t parallel_threshold = 0)
+        {
+            auto candidates = details::find_indexed_resources(resources, query, order_by_created);
+            if (0 != parallel_threshold && details::is_expensive_query(query))
+            {
+                auto matching = details::find_matching_resources(resources, candidates, query, order_by_created, until, since, parallel_threshold);
+                if (matching)
+                {
+                    // the page and paging parameters are exactly as if the match predicate was being evaluated for the candidates
+                    const details::resources_subset subset(matching, order_by_created);
+                    return paging::cursor_based_page(subset, details::match_any_resource(), until, since, limit, !since_specified);
+                }
+            }
+            if (candidates)
+            {
+                const details::resources_subset subset(candidates, order_by_created);
+                return paging::cursor_based_page(subset, match, until, since, limit, !since_specified);
+            }
+            const auto type = details::get_query_resource_type(query);
+            if (!type.name.empty())
+            {
+                return page(resources, match, type);
+            }
+            return page(resources, match);
+        }
+
+        // call the function for each resource in the page, in order, choosing the index exactly as page does, and updating the paging parameters similarly
+        // but without the type erasure of the returned range, so that evaluating the match predicate and the function for each resource are fused into
+        // one pass that can be fully inlined, e.g. to filter, downgrade and serialize a large page
+        template <typename Predicate, typename Function>
+        void for_each_in_page(const nmos::resources& resources, Predicate match, const resource_query& query, size_t parallel_threshold, Function f)
+        {
+            auto candidates = details::find_indexed_resources(resources, query, order_by_created);
+            if (0 != parallel_threshold && details::is_expensive_query(query))
+            {
+                auto matching = details::find_matching_resources(resources, candidates, query, order_by_created, until, since, parallel_threshold);
+                if (matching)
+                {
+                    return for_each_in_range(details::resources_subset(matching, order_by_created), details::match_any_resource(), f);
+                }
+            }
+            if (candidates)
+            {
+                return for_each_in_range(details::resources_subset(candidates, order_by_created), match, f);
+            }
+            const auto type = details::get_query_resource_type(query);
+            if (!type.name.empty())
+            {
+                if (order_by_created)
+                    return for_each_in_range(details::typed_resources<tags::type_created>(resources.get<tags::type_created>(), type), match, f);
+                else
+                    return for_each_in_range(details::typed_resources<tags::type_updated>(resources.get<tags::type_updated>(), type), match, f);
+            }
+            if (order_by_created)
+                return for_each_in_range(resources.get<tags::created>(), match, f);
+            else
+                return for_each_in_range(resources.get<tags::updated>(), match, f);
+        }
+
+    private:
+        template <typename Range, typename Predicate, typename Function>
+        void for_each_in_range(const Range& range, Predicate match, Function& f)
+        {
+            for (const auto& resource : paging::cursor_based_page(range, match, until, since, limit, !since_specified))
+            {
+                f(resource);
+            }
+        }
     };
 
     namespace details
     {
         // make user error information (to be used with status_codes::BadRequest)
         utility::string_t make_valid_paging_error(const nmos::resource_paging& paging);
+
+        // get the serialized (UTF-8) form of the resource data, downgraded as specified by the query, using the serialization cache of the resources
+        // note, like set_resource_health, this only requires a shared/read lock on the resources, and the result remains valid without the lock
+        std::shared_ptr<const std::string> serialize_downgrade(const nmos::resources& resources, const nmos::resource& resource, const resource_query& match);
+
+        // get the resource data, downgraded as specified by the query, using the downgrade cache of the resources when the downgrade isn't trivial
+        // note, like serialize_downgrade, this only requires a shared/read lock on the resources, and the result remains valid without the lock
+        std::shared_ptr<const web::json::value> downgrade(const nmos::resources& resources, const nmos::resource& resource, const resource_query& match);
     }
 
     // Cursor-based paging customisation points
@@ -102,15 +313,49 @@ namespace nmos
     inline nmos::resources::index_iterator<tags::created>::type lower_bound(const nmos::resources::index<tags::created>::type& index, const nmos::tai& timestamp) { return index.lower_bound(timestamp); }
     inline nmos::resources::index_iterator<tags::updated>::type lower_bound(const nmos::resources::index<tags::updated>::type& index, const nmos::tai& timestamp) { return index.lower_bound(timestamp); }
 
+    namespace details
+    {
+        inline nmos::tai extract_cursor(const resources_subset& subset, resources_subset::iterator it) { return subset.order_by_created ? it->created : it->updated; }
+
+        inline nmos::tai extract_cursor(const typed_resources<tags::type_created>&, typed_resources<tags::type_created>::iterator it) { return it->created; }
+        inline nmos::tai extract_cursor(const typed_resources<tags::type_updated>&, typed_resources<tags::type_updated>::iterator it) { return it->updated; }
+
+        inline typed_resources<tags::type_created>::iterator lower_bound(const typed_resources<tags::type_created>& typed, const nmos::tai& timestamp) { return typed.index.lower_bound(boost::make_tuple(true, typed.type, timestamp)); }
+        inline typed_resources<tags::type_updated>::iterator lower_bound(const typed_resources<tags::type_updated>& typed, const nmos::tai& timestamp) { return typed.index.lower_bound(boost::make_tuple(true, typed.type, timestamp)); }
+
+        resources_subset::iterator lower_bound(const resources_subset& subset, const nmos::tai& timestamp);
+    }
+
     // Helpers for constructing /subscriptions websocket grains
     // See https://github.com/AMWA-TV/nmos-discovery-registration/blob/v1.2/docs/4.2.%20Behaviour%20-%20Querying.md
 
     // make the initial 'sync' resource events for a new grain, including all resources that match the specified version, resource path and flat query parameters
     web::json::value make_resource_events(const nmos::resources& resources, const nmos::api_version& version, const utility::string_t& resource_path, const web::json::value& params);
 
-    // insert 'added', 'removed' or 'modified' resource events into all grains whose subscriptions match the specified version, type and "pre" or "post" values
+    // make the next 'sync' resource events for a grain, including up to the specified number of resources that match the specified version, resource path and flat query parameters,
+    // from those created after the specified cursor and at or before the specified snapshot point; the cursor is advanced past the resources that have been considered
+    // if a size limit is specified, the events are also limited to about that number of bytes when serialized, although at least one event is included
+    web::json::value make_resource_events(const nmos::resources& resources, const nmos::api_version& version, const utility::string_t& resource_path, const web::json::value& params, nmos::tai& cursor, const nmos::tai& until, size_t limit, size_t size_limit = 0);
+
+    // insert 'added', 'removed' or 'modified' resource events into the event queues (or grains) of all websocket connections whose subscriptions match the specified version, type and "pre" or "post" values
     void insert_resource_events(nmos::resources& resources, const nmos::api_version& version, const nmos::type& type, const web::json::value& pre, const web::json::value& post);
 
+    struct resource_change;
+
+    // insert the resource events for a batch of resource changes, in order, e.g. for all the resources erased by a cascaded deletion or expiry,
+    // locking the event queues mutex, finding the subscriptions to consider, and modifying the grain for each websocket connection, just once for the whole batch
+    // (each change has the most recent update timestamp of the resources when it was made)
+    void insert_resource_events(nmos::resources& resources, const std::vector<nmos::resource_change>& changes);
+
+    struct event_queue;
+
+    // experimental extension, to resume a websocket connection from a cursor rather than starting again with a full 'sync'
+    // insert the resource changes since the specified cursor, from the resource journal, into the event queue of a websocket connection to the specified subscription, if its query matches,
+    // and return true, or return false, without inserting anything, if the changes since the cursor are no longer all retained, or there are more than the specified limit
+    // (with the event queues mutex locked)
+    // see nmos::experimental::fields::query_ws_resume_limit
+    bool insert_resource_events(nmos::resources& resources, nmos::event_queue& queue, const nmos::resource& subscription, const nmos::tai& cursor, size_t limit);
+
     namespace fields
     {
         const web::json::field_as_string_or query_rql{ U("query.rql"), {} };
@@ -127,6 +372,11 @@ namespace nmos
         namespace fields
         {
             const web::json::field_as_string_or query_strip{ U("query.strip"), {} };
+            const web::json::field_as_string_or query_patch{ U("query.patch"), {} };
+            const web::json::field_as_string_or paging_wait{ U("paging.wait"), {} };
+
+            // for coalescing the pending resource events of a grain, so that there is at most one event for each resource
+            const web::json::field_as_bool_or coalesce_events{ U("coalesce_events"), false };
         }
     }
 
@@ -144,7 +394,7 @@ namespace nmos
             resource_unchanged_event // also known as 'sync'
         };
 
-        // determine the type of the resource event from "pre" and "post"
+        // determine the type of the resource event from "pre" and "post", or "patch" (experimental)
         resource_event_type get_resource_event_type(const web::json::value& event);
 
         // resource_path may be empty (matching all resource types) or e.g. "/nodes"
@@ -1,14 +1,68 @@
 #include "nmos/query_ws_api.h"
 
+#include <algorithm>
+#include <future>
+#include <thread>
+#include <boost/algorithm/string/split.hpp>
+#include "cpprest/json_utils.h" // for web::json::experimental::serialize_utf8, etc.
+#include "nmos/api_utils.h" // for nmos::details::decode_elements
+#include "nmos/event_queues.h"
 #include "nmos/model.h"
 #include "nmos/query_utils.h"
 #include "nmos/rational.h"
 #include "nmos/thread_utils.h" // for wait_until
 #include "nmos/slog.h"
+#include "nmos/tracepoints.h"
 #include "nmos/version.h"
 
 namespace nmos
 {
+    namespace details
+    {
+        // the resource path of the websocket connection, without any query
+        static utility::string_t get_ws_path(const utility::string_t& ws_resource_path)
+        {
+            return ws_resource_path.substr(0, ws_resource_path.find(U('?')));
+        }
+
+        // experimental extension, the cursor from which to resume, from the "resume" query parameter of the websocket connection, or zero if there isn't one
+        static nmos::tai get_ws_resume_cursor(const utility::string_t& ws_resource_path)
+        {
+            const auto query = ws_resource_path.find(U('?'));
+            if (utility::string_t::npos == query) return{};
+
+            auto flat_query_params = web::json::value_from_query(ws_resource_path.substr(query + 1));
+            nmos::details::decode_elements(flat_query_params);
+            return nmos::parse_version(web::json::field_as_string_or{ U("resume"), {} }(flat_query_params));
+        }
+
+        // experimental extension, the ids of further subscriptions to be multiplexed over the websocket connection, from the comma-separated "multiplex" query parameter
+        static std::vector<nmos::id> get_ws_multiplexed_subscriptions(const utility::string_t& ws_resource_path)
+        {
+            std::vector<nmos::id> ids;
+
+            const auto query = ws_resource_path.find(U('?'));
+            if (utility::string_t::npos == query) return ids;
+
+            auto flat_query_params = web::json::value_from_query(ws_resource_path.substr(query + 1));
+            nmos::details::decode_elements(flat_query_params);
+            const auto multiplex = web::json::field_as_string_or{ U("multiplex"), {} }(flat_query_params);
+            if (!multiplex.empty()) boost::algorithm::split(ids, multiplex, [](utility::char_t c) { return U(',') == c; });
+            return ids;
+        }
+
+        // get the event queues of the registry resources, creating them if necessary (with the exclusive/write lock on the model)
+        static nmos::event_queues& get_event_queues(nmos::registry_model& model)
+        {
+            auto& resources = model.registry_resources;
+            if (!resources.event_queues)
+            {
+                resources.event_queues = std::make_shared<nmos::event_queues>();
+            }
+            return *resources.event_queues;
+        }
+    }
+
     web::websockets::experimental::listener::validate_handler make_query_ws_validate_handler(nmos::registry_model& model, slog::base_gate& gate_)
     {
         return [&model, &gate_](const utility::string_t& ws_resource_path)
@@ -19,13 +73,28 @@ namespace nmos
 
             slog::log<slog::severities::more_info>(gate, SLOG_FLF) << "Validating websocket connection to: " << ws_resource_path;
 
-            const bool has_ws_resource_path = resources.end() != find_resource_if(resources, nmos::types::subscription, [&ws_resource_path](const nmos::resource& resource)
+            const auto ws_path = details::get_ws_path(ws_resource_path);
+            const bool has_ws_resource_path = resources.end() != find_resource_if(resources, nmos::types::subscription, [&ws_path](const nmos::resource& resource)
             {
-                return ws_resource_path == web::uri(nmos::fields::ws_href(resource.data)).path();
+                return ws_path == web::uri(nmos::fields::ws_href(resource.data)).path();
             });
 
-            if (!has_ws_resource_path) slog::log<slog::severities::error>(gate, SLOG_FLF) << "Invalid websocket connection to: " << ws_resource_path;
-            return has_ws_resource_path;
+            if (!has_ws_resource_path)
+            {
+                slog::log<slog::severities::error>(gate, SLOG_FLF) << "Invalid websocket connection to: " << ws_resource_path;
+                return false;
+            }
+
+            for (const auto& multiplexed_id : details::get_ws_multiplexed_subscriptions(ws_resource_path))
+            {
+                if (resources.end() == find_resource(resources, { multiplexed_id, nmos::types::subscription }))
+                {
+                    slog::log<slog::severities::error>(gate, SLOG_FLF) << "Invalid websocket connection to: " << ws_resource_path << " with unknown multiplexed subscription: " << multiplexed_id;
+                    return false;
+                }
+            }
+
+            return true;
         };
     }
 
@@ -33,6 +102,12 @@ namespace nmos
     {
         using web::json::value;
 
+        {
+            // create the event queues up front, so that the resource changes are retained from the start, if that's enabled
+            auto lock = model.write_lock();
+            details::get_event_queues(model);
+        }
+
         return [source_id, &model, &websockets, &gate_](const utility::string_t& ws_resource_path, const web::websockets::experimental::listener::connection_id& connection_id)
         {
             nmos::ws_api_gate gate(gate_, ws_resource_path);
@@ -41,45 +116,99 @@ namespace nmos
 
             slog::log<slog::severities::info>(gate, SLOG_FLF) << "Opening websocket connection to: " << ws_resource_path;
 
-            auto subscription = find_resource_if(resources, nmos::types::subscription, [&ws_resource_path](const nmos::resource& resource)
+            const auto ws_path = details::get_ws_path(ws_resource_path);
+            auto subscription = find_resource_if(resources, nmos::types::subscription, [&ws_path](const nmos::resource& resource)
             {
-                return ws_resource_path == web::uri(nmos::fields::ws_href(resource.data)).path();
+                return ws_path == web::uri(nmos::fields::ws_href(resource.data)).path();
             });
 
             if (resources.end() != subscription)
             {
-                // create a websocket connection resource
+                // experimental extension, further subscriptions multiplexed over the same websocket connection, each with its own event queue
+                std::vector<nmos::resources::const_iterator> subscriptions{ subscription };
+                for (const auto& multiplexed_id : details::get_ws_multiplexed_subscriptions(ws_resource_path))
+                {
+                    auto multiplexed = find_resource(resources, { multiplexed_id, nmos::types::subscription });
+                    if (resources.end() == multiplexed)
+                    {
+                        // e.g. deleted since the websocket connection was validated
+                        slog::log<slog::severities::warning>(gate, SLOG_FLF) << "Not multiplexing unknown subscription: " << multiplexed_id;
+                        continue;
+                    }
+                    if (subscriptions.end() != std::find(subscriptions.begin(), subscriptions.end(), multiplexed)) continue;
+                    subscriptions.push_back(multiplexed);
+                }
 
-                value data;
-                nmos::id id = nmos::make_id();
-                data[nmos::fields::id] = value::string(id);
-                data[nmos::fields::subscription_id] = value::string(subscription->id);
+                // create an event queue for the websocket connection, and for each multiplexed subscription
+                // unlike a grain resource, this is kept outside the resources, so that queuing events doesn't re-index anything
 
-                // create an initial websocket message with no data
+                auto& queues = details::get_event_queues(model);
 
-                const auto resource_path = nmos::fields::resource_path(subscription->data);
-                const auto topic = resource_path + U('/');
-                data[U("message")] = details::make_grain(source_id, subscription->id, topic);
+                const nmos::id id = nmos::make_id();
 
-                // populate it with the initial (unchanged, a.k.a. sync) data
+                // optionally, coalesce the pending resource events, e.g. during registration storms
+                const auto coalesce = model.get_settings_snapshot()->query_ws_coalesce_events;
 
-                nmos::fields::message_grain_data(data) = make_resource_events(resources, subscription->version, resource_path, nmos::fields::params(subscription->data));
+                // experimental extension, to resume from the origin_timestamp of the last message received on a previous connection to the same subscription
+                // e.g. after a network blip, with just the changes since then, rather than starting again with a full 'sync', as long as those are still retained
+                // when subscriptions are multiplexed, each is resumed from the same cursor, so the client should specify the least recent of their timestamps
+                const auto resume_cursor = details::get_ws_resume_cursor(ws_resource_path);
+                const auto resume_limit = (size_t)(std::max)(0, nmos::experimental::fields::query_ws_resume_limit(model.settings));
 
-                // track the grain for the websocket connection as a sub-resource of the subscription
+                {
+                    std::lock_guard<std::mutex> queues_lock(queues.mutex);
 
-                // never expire the grain resource, they are only deleted when the connection is closed
-                resource grain{ subscription->version, nmos::types::grain, data, true };
+                    for (const auto& queued : subscriptions)
+                    {
+                        nmos::event_queue queue;
+                        queue.id = subscription == queued ? id : nmos::make_id();
+                        queue.subscription_id = queued->id;
+                        queue.websocket_id = id;
 
-                insert_resource(resources, std::move(grain));
+                        // create an initial websocket message with no data
+                        // each message identifies its subscription, so multiplexed subscriptions can be told apart by the client
+
+                        const auto resource_path = nmos::fields::resource_path(queued->data);
+                        const auto topic = resource_path + U('/');
+                        queue.message = details::make_grain(source_id, queued->id, topic);
+
+                        queue.coalesce = coalesce;
+
+                        if (nmos::tai{} < resume_cursor && insert_resource_events(resources, queue, *queued, resume_cursor, resume_limit))
+                        {
+                            slog::log<slog::severities::info>(gate, SLOG_FLF) << "Resuming websocket connection from: " << nmos::make_version(resume_cursor) << " with " << queue.events.size() << " changes to subscription: " << queued->id;
+
+                            queue.sync_cursor = queue.sync_until = {};
+                            queue.resume_cursor = resume_cursor;
+                        }
+                        else
+                        {
+                            // the initial (unchanged, a.k.a. sync) data is streamed by the send_query_ws_events_thread, rather than being generated here all at once
+                            // which on a large registry would hold the exclusive/write lock for a long time, and produce a huge grain
+                            // note, all the resources currently in the registry were created at or before the most recent update
+
+                            queue.sync_cursor = {};
+                            queue.sync_until = most_recent_update(resources);
+                            queue.resume_cursor = {};
+                        }
+
+                        queues.insert(std::move(queue));
+                    }
+                }
 
                 // never expire a subscription while it has connections
                 // note, since health is mutable, no need for:
                 // model.resources.modify(subscription, [](nmos::resource& subscription){ subscription.health = health_forever; });
-                subscription->health = health_forever;
+                for (const auto& queued : subscriptions)
+                {
+                    details::set_resource_health(resources, *queued, health_forever);
+                }
 
                 websockets.insert({ id, connection_id });
+                model.metrics.websockets.insert(id);
 
                 slog::log<slog::severities::info>(gate, SLOG_FLF) << "Creating websocket connection: " << id << " to subscription: " << subscription->id;
+                if (1 < subscriptions.size()) slog::log<slog::severities::info>(gate, SLOG_FLF) << "Multiplexing " << subscriptions.size() - 1 << " more subscriptions on websocket connection: " << id;
 
                 slog::log<slog::severities::too_much_info>(gate, SLOG_FLF) << "Notifying query websockets thread"; // and anyone else who cares...
                 model.notify();
@@ -104,25 +233,38 @@ namespace nmos
             auto websocket = websockets.right.find(connection_id);
             if (websockets.right.end() != websocket)
             {
-                auto grain = find_resource(resources, { websocket->second, nmos::types::grain });
-
-                if (resources.end() != grain)
+                if (resources.event_queues)
                 {
-                    slog::log<slog::severities::info>(gate, SLOG_FLF) << "Deleting websocket connection: " << grain->id;
+                    auto& queues = *resources.event_queues;
+                    std::lock_guard<std::mutex> queues_lock(queues.mutex);
 
-                    // a non-persistent subscription for which this was the last websocket connection should now expire unless a new connection is made soon
-                    modify_resource(resources, nmos::fields::subscription_id(grain->data), [&](nmos::resource& subscription)
+                    auto queue = queues.queues.find(websocket->second);
+                    if (queues.queues.end() != queue)
                     {
-                        subscription.sub_resources.erase(grain->id);
-                        if (!nmos::fields::persist(subscription.data) && subscription.sub_resources.empty())
+                        slog::log<slog::severities::info>(gate, SLOG_FLF) << "Deleting websocket connection: " << queue->first;
+                    }
+
+                    // the event queues of any multiplexed subscriptions are erased along with that of the websocket connection itself
+                    auto ids = queues.multiplexed_queues(websocket->second);
+                    ids.insert(websocket->second);
+                    for (const auto& id : ids)
+                    {
+                        queue = queues.queues.find(id);
+                        if (queues.queues.end() == queue) continue;
+
+                        const auto subscription_id = queue->second.subscription_id;
+                        const auto remaining = queues.erase(id);
+
+                        // a non-persistent subscription for which this was the last websocket connection should now expire unless a new connection is made soon
+                        auto subscription = find_resource(resources, { subscription_id, nmos::types::subscription });
+                        if (resources.end() != subscription && !nmos::fields::persist(subscription->data) && 0 == remaining)
                         {
-                            subscription.health = health_now();
+                            details::set_resource_health(resources, *subscription, health_now());
                         }
-                    });
-
-                    erase_resource(resources, grain->id, false);
+                    }
                 }
 
+                model.metrics.websockets.erase(websocket->second);
                 websockets.right.erase(websocket);
 
                 model.notify();
@@ -130,90 +272,187 @@ namespace nmos
         };
     }
 
+    namespace details
+    {
+        // determine whether the initial 'sync' resource events for a websocket connection have yet to be completely sent
+        static bool is_sync_pending(const nmos::event_queue& queue)
+        {
+            return queue.sync_cursor < queue.sync_until;
+        }
+
+        // determine whether there are any websocket connections which may have something to send now, or which may need to be closed
+        // note, the ready set is only modified with the exclusive/write lock on the resources, or by nmos::send_query_ws_events_thread itself
+        static bool has_ready_event_queues(const nmos::resources& resources)
+        {
+            return resources.event_queues && !resources.event_queues->ready.empty();
+        }
+    }
+
+    namespace details
+    {
+        // serialize the messages, concurrently for partitions of them by a number of threads if there are at least the specified number, or serially if the threshold is 0
+        static std::vector<std::string> serialize_messages(const std::vector<web::json::value>& messages, size_t threshold)
+        {
+            std::vector<std::string> serialized(messages.size());
+
+            const size_t partitions = 0 != threshold && threshold <= messages.size()
+                ? (std::min)((size_t)(std::max)(std::thread::hardware_concurrency(), 1u), messages.size())
+                : 1;
+            auto serialize = [&](size_t partition)
+            {
+                const auto first = messages.size() * partition / partitions;
+                const auto last = messages.size() * (partition + 1) / partitions;
+                for (auto index = first; index < last; ++index)
+                {
+                    serialized[index] = web::json::experimental::serialize_utf8(messages[index]);
+                }
+            };
+
+            std::vector<std::future<void>> workers;
+            for (size_t partition = 1; partition < partitions; ++partition)
+            {
+                workers.push_back(std::async(std::launch::async, serialize, partition));
+            }
+            serialize(0);
+            for (auto& worker : workers) worker.get();
+
+            return serialized;
+        }
+    }
+
     void send_query_ws_events_thread(web::websockets::experimental::listener::websocket_listener& listener, nmos::registry_model& model, nmos::websockets& websockets, slog::base_gate& gate_)
     {
-        nmos::details::omanip_gate gate(gate_, nmos::stash_category(nmos::categories::send_query_ws_events));
+        nmos::details::omanip_gate gate(gate_, nmos::categories::send_query_ws_events);
 
         using web::json::value;
 
-        // could start out as a shared/read lock, only upgraded to an exclusive/write lock when a grain in the resources is actually modified
-        auto lock = model.write_lock();
+        // a shared/read lock is sufficient to prepare the messages, since the events waiting to be sent are in the event queues rather than in the resources
+        // (the event queues have their own mutex); an exclusive/write lock is only required to tidy up after closing websocket connections
+        auto lock = model.read_lock();
         auto& condition = model.condition;
         auto& shutdown = model.shutdown;
         auto& resources = model.registry_resources;
 
+        // the per-event log messages are rate limited so that verbose logging stays affordable when there are many changes
+        nmos::experimental::rate_limited_gate event_gate(gate, (std::max)(0, nmos::experimental::fields::log_rate_limit(model.settings)));
+
         tai most_recent_message{};
         auto earliest_necessary_update = (tai_clock::time_point::max)();
 
         for (;;)
         {
-            // wait for the thread to be interrupted either because there are resource changes, or because the server is being shut down
-            // or because message sending was throttled earlier
-            details::wait_until(condition, lock, earliest_necessary_update, [&]{ return shutdown || most_recent_message < most_recent_update(resources); });
+            // wait for the thread to be interrupted either because events have been queued or websocket connections have been opened or their subscriptions erased,
+            // or because the server is being shut down, or because message sending was throttled earlier
+            // resource changes which didn't result in any events for the websocket connections don't need to wake this thread
+            details::wait_until(condition, lock, earliest_necessary_update, [&]{ return shutdown || details::has_ready_event_queues(resources); });
             if (shutdown) break;
             most_recent_message = most_recent_update(resources);
 
             slog::log<slog::severities::too_much_info>(gate, SLOG_FLF) << "Got notification on query websockets thread";
 
+            earliest_necessary_update = (tai_clock::time_point::max)();
+
+            // the event queues are always created before any websocket connection is tracked
+            if (!resources.event_queues) continue;
+            auto& queues = *resources.event_queues;
+
+            // the messages are serialized once the lock on the resources has been released, so each outgoing message is the index of a distinct prepared message
+            std::vector<web::json::value> prepared_messages;
+            std::vector<std::pair<web::websockets::experimental::listener::connection_id, size_t>> outgoing_messages;
+            std::vector<std::pair<nmos::id, web::websockets::experimental::listener::connection_id>> closing_websockets;
+            // for the change-propagation latency metrics, the subscription id and least recent change ingress time of each outgoing message, or max for a 'sync' message
+            std::vector<std::pair<nmos::id, std::chrono::steady_clock::time_point>> outgoing_ingresses;
+            // for the websocket connection metrics, the websocket id of each outgoing message
+            std::vector<nmos::id> outgoing_websockets;
+
             const auto now = tai_clock::now();
 
-            earliest_necessary_update = (tai_clock::time_point::max)();
+            // the index of the most recently prepared message for each subscription with more than one websocket connection
+            std::map<nmos::id, size_t> subscription_messages;
 
-            std::vector<std::pair<web::websockets::experimental::listener::connection_id, web::websockets::websocket_outgoing_message>> outgoing_messages;
+            std::unique_lock<std::mutex> queues_lock(queues.mutex);
 
-            for (auto wit = websockets.left.begin(); websockets.left.end() != wit;)
-            {
-                const auto& websocket = *wit;
+            // only the websocket connections which are ready, or whose throttled messages are now due, are considered, rather than every connection
+            queues.wake(now);
+            std::unordered_set<nmos::id> ready;
+            ready.swap(queues.ready);
 
-                // for each websocket connection that has valid grain and subscription resources
-                const auto grain = find_resource(resources, { websocket.first, nmos::types::grain });
-                if (resources.end() == grain)
-                {
-                    // theoretically blocking, but in fact not
-                    listener.close(websocket.second, web::websockets::websocket_close_status::server_terminate, U("Deleted")).wait();
+            const auto settings = model.get_settings_snapshot();
 
-                    wit = websockets.left.erase(wit);
-                    continue;
-                }
-                const auto subscription = find_resource(resources, { nmos::fields::subscription_id(grain->data), nmos::types::subscription });
+            for (const auto& id : ready)
+            {
+                // the event queue may be for one of several subscriptions multiplexed over a websocket connection
+                auto found = queues.queues.find(id);
+
+                // e.g. already closed
+                const auto websocket_ = websockets.left.find(queues.queues.end() != found ? found->second.websocket_id : id);
+                if (websockets.left.end() == websocket_) continue;
+                const auto& websocket = *websocket_;
+
+                // for each websocket connection that has a valid event queue and subscription
+                const auto subscription = queues.queues.end() != found
+                    ? find_resource(resources, { found->second.subscription_id, nmos::types::subscription })
+                    : resources.end();
                 if (resources.end() == subscription)
                 {
-                    // a grain without a subscription shouldn't be possible, but let's be tidy
-                    erase_resource(resources, grain->id);
-
-                    // theoretically blocking, but in fact not
-                    listener.close(websocket.second, web::websockets::websocket_close_status::server_terminate, U("Deleted")).wait();
-
-                    wit = websockets.left.erase(wit);
+                    if (websocket.first == id)
+                    {
+                        closing_websockets.push_back({ websocket.first, websocket.second });
+                    }
+                    else if (queues.queues.end() != found)
+                    {
+                        // a multiplexed subscription which has been deleted is just dropped, leaving the websocket connection open for the others
+                        slog::log<slog::severities::info>(gate, SLOG_FLF) << "Deleting multiplexed subscription: " << found->second.subscription_id << " from websocket connection: " << websocket.first;
+                        queues.erase(id);
+                    }
                     continue;
                 }
+                auto& queue = found->second;
+                auto& message = queue.message;
+                auto& events = queue.events;
+
                 // and has events to send
-                if (0 == nmos::fields::message_grain_data(grain->data).size())
-                {
-                    ++wit;
-                    continue;
-                }
+                const bool sync_pending = details::is_sync_pending(queue);
+                if (0 == events.size() && !sync_pending) continue;
 
                 // throttle messages according to the subscription's max_update_rate_ms
                 // see discussion about sync_timestamp below...
                 const auto max_update_rate = std::chrono::milliseconds(nmos::fields::max_update_rate_ms(subscription->data));
-                const auto earliest_allowed_update = time_point_from_tai(nmos::fields::sync_timestamp(nmos::fields::message(grain->data))) + max_update_rate;
+                const auto earliest_allowed_update = time_point_from_tai(nmos::fields::sync_timestamp(message)) + max_update_rate;
                 if (earliest_allowed_update > now)
                 {
                     // make sure to send a message as soon as allowed
-                    if (earliest_allowed_update < earliest_necessary_update)
-                    {
-                        earliest_necessary_update = earliest_allowed_update;
-                    }
+                    queues.reschedule(queue, earliest_allowed_update);
                     // just don't do it now!
-                    ++wit;
+                    continue;
+                }
+
+                // experimental extension, to postpone messages to a slow consumer rather than letting the unsent data grow without bound
+                // websocketpp writes to the network asynchronously, so a congested connection doesn't delay sending to the others
+                // but messages would otherwise keep being queued; instead, events stay in the event queue (and may be combined) until the client catches up
+                const auto buffered_limit = settings->query_ws_buffered_limit;
+                const auto buffered = 0 != buffered_limit ? listener.buffered_amount(websocket.second) : 0;
+                if (0 != buffered_limit && buffered_limit < buffered)
+                {
+                    slog::log<slog::severities::more_info>(event_gate, SLOG_FLF) << "Postponing changes on slow websocket connection: " << queue.id;
+
+                    // try again soon, but no sooner than allowed
+                    queues.reschedule(queue, now + (std::max)(max_update_rate, std::chrono::milliseconds(100)));
                     continue;
                 }
 
                 // experimental extension, to limit maximum number of events per message
 
-                resource_paging paging(nmos::fields::params(subscription->data), most_recent_message, (size_t)nmos::fields::query_paging_default(model.settings), (size_t)nmos::fields::query_paging_limit(model.settings));
-                auto next_events = value::array();
+                resource_paging paging(nmos::fields::params(subscription->data), most_recent_message, settings->query_paging_default, settings->query_paging_limit);
+
+                // experimental extension, to also limit the size of each message, so that a grain of many large resources does not produce a huge frame
+                // and a connection approaching the buffered limit is sent smaller messages, rather than one that takes it far beyond
+                size_t size_limit = settings->query_ws_message_size_limit;
+                if (0 != buffered_limit)
+                {
+                    const auto remaining = buffered_limit - buffered;
+                    size_limit = 0 != size_limit ? (std::min)(size_limit, remaining) : remaining;
+                }
 
                 // determine the grain timestamps
 
@@ -225,49 +464,76 @@ namespace nmos
                 // it has therefore been subject to the usual adjustments to make it unique and strictly increasing
                 // another possibility would be to make it the timestamp of the most recent update *actually* included
                 // or it could be the timestamp of (or the timestamp before, like paging.since) the least recent update included
-                const auto origin_timestamp = value::string(nmos::make_version(most_recent_message));
+                // however, when events are postponed to the next message, or the initial 'sync' events haven't all been sent, the origin_timestamp
+                // remains that of the most recent message after which all the events up to that point had been sent, so that it can be used to resume
+                // (see below)
 
                 // sync_timestamp currently reflects the time that the message is actually being prepared
                 // this may be more recent if messages have been throttled
                 // or less recent since it hasn't been adjusted in the same way as the update timestamps
                 const auto sync_timestamp = value::string(nmos::make_version(tai_from_time_point(now)));
 
+                // experimental extension, to stream the initial 'sync' resource events, limited to the maximum number of events per message
+                // any further events are postponed, since they occurred after the snapshot point
+                auto sync_events = sync_pending
+                    ? make_resource_events(resources, subscription->version, nmos::fields::resource_path(subscription->data), nmos::fields::params(subscription->data), queue.sync_cursor, queue.sync_until, (std::max)(paging.limit, (size_t)1), size_limit)
+                    : value::array();
+
+                // no more matching resources, and nothing else to send
+                if (sync_pending && 0 == sync_events.size() && 0 == events.size()) continue;
+
                 // prepare the message
 
-                resources.modify(grain, [&paging, &next_events, &origin_timestamp, &sync_timestamp](nmos::resource& grain)
+                // the queued events are shared with other event queues, so are only copied into the message now, with just the shared/read lock
+                auto& message_events = nmos::fields::grain_data(message);
+                auto& message_storage = web::json::storage_of(message_events.as_array());
+                size_t sent_events = 0;
+                if (0 != sync_events.size())
                 {
-                    auto& message = nmos::fields::message(grain.data);
-
-                    // postpone all the events after the specified limit
-                    auto& next_storage = web::json::storage_of(next_events.as_array());
-                    auto& message_storage = web::json::storage_of(nmos::fields::grain_data(message).as_array());
-                    if (paging.limit < message_storage.size())
+                    // postpone all the events other than the sync events
+                    message_storage.swap(web::json::storage_of(sync_events.as_array()));
+                }
+                else
+                {
+                    // postpone all the events after the specified limits
+                    const auto limit = (std::min)(paging.limit, events.size());
+                    message_storage.reserve(limit);
+                    size_t size = 0;
+                    for (; sent_events < limit; ++sent_events)
                     {
-                        const auto b = message_storage.begin() + paging.limit, e = message_storage.end();
-                        next_storage.assign(std::make_move_iterator(b), std::make_move_iterator(e));
-                        message_storage.erase(b, e);
-                        // hmm, feels like origin_timestamp should be adjusted in this case, but how?
+                        const auto& event = *events[sent_events];
+                        if (0 != size_limit)
+                        {
+                            // a message always includes at least one event
+                            const auto event_size = web::json::experimental::serialized_utf8_size(event);
+                            if (0 != sent_events && size_limit < size + event_size) break;
+                            size += event_size + 1;
+                        }
+                        message_storage.push_back(event);
                     }
+                }
+                const bool postponed_events = sent_events < events.size();
 
-                    // set the timestamps
-                    message[nmos::fields::origin_timestamp] = origin_timestamp;
-                    message[nmos::fields::sync_timestamp] = sync_timestamp;
-                    message[nmos::fields::creation_timestamp] = sync_timestamp;
-                });
+                // set the timestamps
+                if (!postponed_events && !details::is_sync_pending(queue)) queue.resume_cursor = most_recent_message;
+                const auto origin_timestamp = value::string(nmos::make_version(queue.resume_cursor));
+                message[nmos::fields::origin_timestamp] = origin_timestamp;
+                message[nmos::fields::sync_timestamp] = sync_timestamp;
+                message[nmos::fields::creation_timestamp] = sync_timestamp;
 
-                slog::log<slog::severities::info>(gate, SLOG_FLF) << "Preparing to send " << nmos::fields::message_grain_data(grain->data).size() << " changes on websocket connection: " << grain->id;
+                slog::log<slog::severities::info>(gate, SLOG_FLF) << "Preparing to send " << message_events.size() << " changes on websocket connection: " << queue.id;
 
                 //+ additional logging, cf. nmos::details::request_registration
                 // see nmos/node_behaviour.cpp
-                const auto topic = nmos::fields::grain_topic(nmos::fields::message(grain->data));
-                const auto message_origin_timestamp = nmos::fields::origin_timestamp(nmos::fields::message(grain->data));
-                for (const auto& event : nmos::fields::message_grain_data(grain->data).as_array())
+                const auto topic = nmos::fields::grain_topic(message);
+                const auto message_origin_timestamp = nmos::fields::origin_timestamp(message);
+                for (const auto& event : message_events.as_array())
                 {
                     const auto id_type = nmos::details::get_resource_event_resource(topic, event);
                     const auto event_type = nmos::details::get_resource_event_type(event);
                     const auto event_origin_timestamp = web::json::field_with_default<tai>{ nmos::fields::origin_timestamp, message_origin_timestamp }(event);
 
-                    slog::log<slog::severities::more_info>(gate, SLOG_FLF) << "Sending registration " << slog::omanip([&event_type](std::ostream& s)
+                    slog::log<slog::severities::more_info>(event_gate, SLOG_FLF) << "Sending registration " << slog::omanip([&event_type](std::ostream& s)
                     {
                         switch (event_type)
                         {
@@ -281,42 +547,78 @@ namespace nmos
                 }
                 //- additional logging, cf. nmos::details::request_registration
 
-                auto serialized = utility::us2s(nmos::fields::message(grain->data).serialize());
-                web::websockets::websocket_outgoing_message message;
-                message.set_utf8_message(serialized);
-
-                outgoing_messages.push_back({ websocket.second, message });
+                // when there are several websocket connections to the same subscription, their messages are often identical
+                // (they share source_id, flow_id, timestamps and usually events), so only prepare, and serialize, each distinct message once
+                const bool shared = 1 < queues.connections(subscription->id);
+                const auto previous = shared ? subscription_messages.find(subscription->id) : subscription_messages.end();
+                if (subscription_messages.end() != previous && prepared_messages[previous->second] == message)
+                {
+                    outgoing_messages.push_back({ websocket.second, previous->second });
+                }
+                else
+                {
+                    // the events are moved rather than copied into the prepared message, leaving the message ready for next time
+                    web::json::details::array_storage_t prepared_events;
+                    prepared_events.swap(message_storage);
+                    prepared_messages.push_back(message);
+                    web::json::storage_of(nmos::fields::grain_data(prepared_messages.back()).as_array()).swap(prepared_events);
+
+                    if (shared) subscription_messages[subscription->id] = prepared_messages.size() - 1;
+                    outgoing_messages.push_back({ websocket.second, prepared_messages.size() - 1 });
+                }
+                outgoing_ingresses.push_back({ subscription->id, 0 == sync_events.size() ? queue.ingress : (std::chrono::steady_clock::time_point::max)() });
+                outgoing_websockets.push_back(websocket.first);
+                if (0 == sync_events.size() && !postponed_events) queue.ingress = (std::chrono::steady_clock::time_point::max)();
 
-                if (0 != next_events.size())
+                if (postponed_events || details::is_sync_pending(queue))
                 {
                     // make sure to send a message as soon as allowed
-                    if (now + max_update_rate < earliest_necessary_update)
-                    {
-                        earliest_necessary_update = now + max_update_rate;
-                    }
+                    queues.reschedule(queue, now + max_update_rate);
                 }
 
-                // reset the grain for next time
-                resources.modify(grain, [&next_events, &resources](nmos::resource& grain)
-                {
-                    using std::swap;
-                    swap(nmos::fields::message_grain_data(grain.data), next_events);
-                    next_events = value::array(); // unnecessary
-                    grain.updated = strictly_increasing_update(resources);
-                });
+                // reset the event queue for next time
+                events.erase(events.begin(), events.begin() + sent_events);
+                message_storage.clear();
+            }
+
+            // any messages which are due now are prepared straight away, since the ready set isn't empty
+            earliest_necessary_update = queues.wake(now);
+
+            queues_lock.unlock();
+
+            if (outgoing_messages.empty() && closing_websockets.empty()) continue;
 
-                ++wit;
+            // serialize and send the messages without the lock on resources, so the time the lock is held doesn't depend on the size of the messages
+            details::reverse_lock_guard<nmos::read_lock> unlock{ lock };
+
+            // each distinct message is shared by all the websocket connections on which it is sent, rather than being copied for each of them
+            std::vector<web::websockets::experimental::listener::websocket_shared_message> shared_messages;
+            {
+                auto serialized_messages = details::serialize_messages(prepared_messages, settings->query_ws_parallel_threshold);
+                shared_messages.reserve(serialized_messages.size());
+                for (auto& serialized_message : serialized_messages) shared_messages.emplace_back(std::move(serialized_message));
             }
+            prepared_messages.clear();
 
-            // send the messages without the lock on resources
-            details::reverse_lock_guard<nmos::write_lock> unlock{ lock };
+            {
+                std::vector<web::websockets::experimental::listener::connection_id> connections;
+                connections.reserve(closing_websockets.size());
+                for (const auto& websocket : closing_websockets) connections.push_back(websocket.second);
+                details::close_websockets(listener, connections, U("Deleted"), gate);
+            }
 
             if (!outgoing_messages.empty()) slog::log<slog::severities::info>(gate, SLOG_FLF) << "Sending " << outgoing_messages.size() << " websocket messages";
 
-            for (auto& outgoing_message : outgoing_messages)
+            std::vector<std::pair<nmos::id, std::chrono::microseconds>> latencies;
+
+            for (size_t index = 0; index < outgoing_messages.size(); ++index)
             {
+                const auto& shared_message = shared_messages[outgoing_messages[index].second];
+                NMOS_CPP_TRACE(ws_send, outgoing_ingresses[index].first.c_str(), shared_message.size());
+                model.metrics.websockets.send_begin(outgoing_websockets[index]);
+
                 // hmmm, no way to cancel this currently...
-                auto send = listener.send(outgoing_message.first, outgoing_message.second).then([&](pplx::task<void> finally)
+                auto send = listener.send(outgoing_messages[index].first, shared_message).then([&](pplx::task<void> finally)
                 {
                     try
                     {
@@ -330,6 +632,44 @@ namespace nmos
                 // current websocket_listener implementation is synchronous in any case, but just to make clear...
                 // for now, wait for the message to be sent
                 send.wait();
+                NMOS_CPP_TRACE(ws_sent, outgoing_ingresses[index].first.c_str(), shared_message.size());
+                model.metrics.websockets.send_end(outgoing_websockets[index], shared_message.size());
+
+                // experimental extension, the change-propagation latency includes any throttling delay, and the time to send the message
+                const auto& ingress = outgoing_ingresses[index].second;
+                if ((std::chrono::steady_clock::time_point::max)() != ingress)
+                {
+                    const auto latency = std::chrono::duration_cast<std::chrono::microseconds>(std::chrono::steady_clock::now() - ingress);
+                    model.metrics.change_propagation.record(latency);
+                    latencies.push_back({ outgoing_ingresses[index].first, latency });
+                }
+            }
+
+            if (!latencies.empty())
+            {
+                std::lock_guard<std::mutex> queues_lock(queues.mutex);
+                for (const auto& latency : latencies)
+                {
+                    // only recorded while there are websocket connections to the subscription, see nmos::event_queues::erase
+                    if (0 != queues.connections(latency.first)) queues.latencies[latency.first].record(latency.second);
+                }
+            }
+
+            if (!closing_websockets.empty())
+            {
+                // stop tracking the closed websocket connections and their event queues, unless the close handler has already done so
+                auto write_lock = model.write_lock();
+                for (const auto& websocket : closing_websockets)
+                {
+                    auto found = websockets.left.find(websocket.first);
+                    if (websockets.left.end() == found) continue;
+                    websockets.left.erase(found);
+
+                    std::lock_guard<std::mutex> queues_lock(queues.mutex);
+                    for (const auto& id : queues.multiplexed_queues(websocket.first)) queues.erase(id);
+                    queues.erase(websocket.first);
+                    model.metrics.websockets.erase(websocket.first);
+                }
             }
         }
     }
@@ -10,6 +10,9 @@ namespace slog
 
 // Query API websocket implementation
 // See https://github.com/AMWA-TV/nmos-discovery-registration/blob/v1.2/docs/4.2.%20Behaviour%20-%20Querying.md
+// Experimental extensions, a connection to the ws_href of a subscription may specify the query parameters "resume", the origin_timestamp
+// of the last message received on a previous connection, and "multiplex", the comma-separated ids of further subscriptions whose messages
+// are to be sent on the same connection, which can be told apart by the subscription_id of each message
 namespace nmos
 {
     struct registry_model;
@@ -0,0 +1,87 @@
+#include "nmos/rate_limiter.h"
+
+#include <algorithm>
+#include <cmath>
+#include "nmos/api_utils.h"
+#include "nmos/slog.h"
+
+namespace nmos
+{
+    namespace experimental
+    {
+        rate_limiter::rate_limiter(double rate, double burst)
+            : rate(rate)
+            , burst((std::max)(burst, 1.0))
+        {}
+
+        rate_limiter::clock::duration rate_limiter::admit(const utility::string_t& client, clock::time_point now)
+        {
+            std::lock_guard<std::mutex> lock(mutex);
+
+            // forget the clients whose buckets would have been refilled by now, once in every interval in which an empty bucket is refilled,
+            // so that the number of buckets is bounded by the number of clients active recently
+            const auto refill = std::chrono::duration_cast<clock::duration>(std::chrono::duration<double>(burst / rate));
+            if (pruned + refill < now)
+            {
+                for (auto it = buckets.begin(); buckets.end() != it;)
+                {
+                    if (it->second.updated + refill < now) it = buckets.erase(it);
+                    else ++it;
+                }
+                pruned = now;
+            }
+
+            auto inserted = buckets.insert({ client, { burst, now } });
+            auto& bucket = inserted.first->second;
+            if (!inserted.second)
+            {
+                const auto elapsed = std::chrono::duration_cast<std::chrono::duration<double>>(now - bucket.updated).count();
+                bucket.tokens = (std::min)(burst, bucket.tokens + elapsed * rate);
+                bucket.updated = now;
+            }
+
+            if (1.0 <= bucket.tokens)
+            {
+                bucket.tokens -= 1.0;
+                return clock::duration::zero();
+            }
+
+            return std::chrono::duration_cast<clock::duration>(std::chrono::duration<double>((1.0 - bucket.tokens) / rate));
+        }
+
+        // construct a rate limiter based on settings, or return nullptr if rate limiting is disabled
+        std::shared_ptr<rate_limiter> make_rate_limiter(const nmos::settings& settings)
+        {
+            const auto rate = nmos::experimental::fields::api_rate_limit(settings);
+            if (0 >= rate) return{};
+            return std::make_shared<rate_limiter>(rate, nmos::experimental::fields::api_rate_limit_burst(settings));
+        }
+
+        // make a route handler which replies 429 (Too Many Requests) with a Retry-After header to requests which exceed the rate limit for the client address
+        web::http::experimental::listener::route_handler make_api_rate_limit_handler(std::shared_ptr<rate_limiter> limiter, slog::base_gate& gate_)
+        {
+            using namespace web::http::experimental::listener::api_router_using_declarations;
+
+            // not all versions of C++ REST SDK define this status code
+            const web::http::status_code too_many_requests = 429;
+
+            return [limiter, too_many_requests, &gate_](http_request req, http_response res, const string_t&, const route_parameters& parameters)
+            {
+                const auto retry_after = limiter->admit(req.remote_address());
+                if (rate_limiter::clock::duration::zero() != retry_after)
+                {
+                    nmos::api_gate gate(gate_, req, parameters);
+                    slog::log<slog::severities::warning>(gate, SLOG_FLF) << "Rate limit exceeded";
+
+                    set_error_reply(res, too_many_requests, U("Too Many Requests; rate limit exceeded"));
+                    // "The value of this field can be either an HTTP-date or a number of seconds to delay after the response is received."
+                    // See https://tools.ietf.org/html/rfc7231#section-7.1.3
+                    const auto seconds = std::ceil(std::chrono::duration_cast<std::chrono::duration<double>>(retry_after).count());
+                    res.headers().add(web::http::header_names::retry_after, (std::max)(1, (int)seconds));
+                    throw details::to_api_finally_handler{}; // in order to skip other route handlers and then send the response
+                }
+                return pplx::task_from_result(true);
+            };
+        }
+    }
+}
@@ -0,0 +1,60 @@
+#ifndef NMOS_RATE_LIMITER_H
+#define NMOS_RATE_LIMITER_H
+
+#include <chrono>
+#include <memory>
+#include <mutex>
+#include <unordered_map>
+#include "cpprest/api_router.h"
+#include "nmos/settings.h"
+
+namespace slog
+{
+    class base_gate;
+}
+
+// This is an experimental extension to limit the rate of requests from each client address to an API
+// See nmos::experimental::fields::api_rate_limit
+namespace nmos
+{
+    namespace experimental
+    {
+        // a token bucket for each client, which is refilled at the specified rate (per second) up to the specified burst size
+        class rate_limiter
+        {
+        public:
+            typedef std::chrono::steady_clock clock;
+
+            rate_limiter(double rate, double burst);
+
+            // take a token from the client's bucket, if there is one, and return zero to admit the request,
+            // otherwise return the time until the next token will be available
+            clock::duration admit(const utility::string_t& client, clock::time_point now = clock::now());
+
+            rate_limiter(const rate_limiter&) = delete;
+            rate_limiter& operator=(const rate_limiter&) = delete;
+
+        private:
+            struct bucket
+            {
+                double tokens;
+                clock::time_point updated;
+            };
+
+            const double rate;
+            const double burst;
+
+            std::mutex mutex;
+            std::unordered_map<utility::string_t, bucket> buckets;
+            clock::time_point pruned;
+        };
+
+        // construct a rate limiter based on settings, or return nullptr if rate limiting is disabled
+        std::shared_ptr<rate_limiter> make_rate_limiter(const nmos::settings& settings);
+
+        // make a route handler which replies 429 (Too Many Requests) with a Retry-After header to requests which exceed the rate limit for the client address
+        web::http::experimental::listener::route_handler make_api_rate_limit_handler(std::shared_ptr<rate_limiter> limiter, slog::base_gate& gate);
+    }
+}
+
+#endif
@@ -1,69 +1,31 @@
 #include "nmos/registration_api.h"
 
-#include <boost/range/adaptor/transformed.hpp>
+#include <algorithm>
+#include <condition_variable>
+#include <list>
+#include <mutex>
 #include "cpprest/json_validator.h"
 #include "nmos/api_downgrade.h" // for details::make_permitted_downgrade_error
 #include "nmos/api_utils.h"
+#include "nmos/event_queues.h"
+#include "nmos/expiry_utils.h"
 #include "nmos/is04_versions.h"
 #include "nmos/json_schema.h"
 #include "nmos/log_manip.h"
 #include "nmos/model.h"
 #include "nmos/query_utils.h"
+#include "nmos/rate_limiter.h"
+#include "nmos/registration_validation.h"
 #include "nmos/thread_utils.h"
+#include "nmos/tracepoints.h"
 
 namespace nmos
 {
     void erase_expired_resources_thread(nmos::registry_model& model, slog::base_gate& gate_)
     {
-        nmos::details::omanip_gate gate(gate_, nmos::stash_category(nmos::categories::registration_expiry));
+        nmos::details::omanip_gate gate(gate_, nmos::categories::registration_expiry);
 
-        // start out as a shared/read lock, only upgraded to an exclusive/write lock when an expired resource actually needs to be deleted from the resources
-        auto lock = model.read_lock();
-        auto& shutdown_condition = model.shutdown_condition;
-        auto& shutdown = model.shutdown;
-        auto& resources = model.registry_resources;
-
-        auto least_health = nmos::least_health(resources);
-
-        // wait until the next node could potentially expire, or the server is being shut down
-        // (since health is truncated to seconds, and we want to be certain the expiry interval has passed, there's an extra second to wait here)
-        while (!shutdown_condition.wait_until(lock, time_point_from_health(least_health.first + nmos::fields::registration_expiry_interval(model.settings) + 1), [&]{ return shutdown; }))
-        {
-            // hmmm, it needs to be possible to enable/disable periodic logging like this independently of the severity...
-            slog::log<slog::severities::more_info>(gate, SLOG_FLF) << "At " << nmos::make_version(nmos::tai_now()) << ", the registry contains " << nmos::put_resources_statistics(resources);
-
-            // most nodes will have had a heartbeat during the wait, so the least health will have been increased
-            // so this thread will be able to go straight back to waiting
-            auto expire_health = health_now() - nmos::fields::registration_expiry_interval(model.settings);
-            auto forget_health = expire_health - nmos::fields::registration_expiry_interval(model.settings);
-            least_health = nmos::least_health(resources);
-            if (least_health.first >= expire_health && least_health.second >= forget_health) continue;
-
-            // otherwise, there's actually work to do...
-
-            details::reverse_lock_guard<nmos::read_lock> unlock(lock);
-            // note, without atomic upgrade, another thread may preempt hence the need to recalculate expire_health/forget_health and least_health
-            auto upgrade = model.write_lock();
-
-            expire_health = health_now() - nmos::fields::registration_expiry_interval(model.settings);
-            forget_health = expire_health - nmos::fields::registration_expiry_interval(model.settings);
-
-            // forget all resources expired in the previous interval
-            forget_erased_resources(resources, forget_health);
-
-            // expire all nodes for which there hasn't been a heartbeat in the last expiry interval
-            const auto expired = erase_expired_resources(resources, expire_health, false);
-
-            if (0 != expired)
-            {
-                slog::log<slog::severities::info>(gate, SLOG_FLF) << expired << " resources have expired";
-
-                slog::log<slog::severities::too_much_info>(gate, SLOG_FLF) << "Notifying query websockets thread"; // and anyone else who cares...
-                model.notify();
-            }
-
-            least_health = nmos::least_health(resources);
-        }
+        details::erase_expired_resources_thread(model, model.registry_resources, nmos::fields::registration_expiry_interval, "the registry", "query websockets thread", gate);
     }
 
     inline web::http::experimental::listener::api_router make_unmounted_registration_api(nmos::registry_model& model, slog::base_gate& gate);
@@ -105,9 +67,14 @@ namespace nmos
         return result;
     }
 
+    inline utility::string_t make_registration_api_resource_location(const nmos::api_version& version, const nmos::type& type, const nmos::id& id)
+    {
+        return U("/x-nmos/registration/") + nmos::make_api_version(version) + U("/resource/") + nmos::resourceType_from_type(type) + U("/") + id;
+    }
+
     inline utility::string_t make_registration_api_resource_location(const nmos::resource& resource)
     {
-        return U("/x-nmos/registration/") + nmos::make_api_version(resource.version) + U("/resource/") + nmos::resourceType_from_type(resource.type) + U("/") + resource.id;
+        return make_registration_api_resource_location(resource.version, resource.type, resource.id);
     }
 
     inline utility::string_t make_registration_api_health_location(const nmos::resource& resource)
@@ -170,6 +137,764 @@ namespace nmos
         }
     }
 
+    namespace details
+    {
+        // the status code, response body and Location header (if any) of a resource registration request
+        struct resource_registration_response
+        {
+            web::http::status_code code;
+            web::json::value body;
+            utility::string_t location;
+        };
+
+        // check whether registering the resource would exceed the configured memory limits, and if so return an explanation
+        // see nmos::experimental::fields::registry_node_memory_limit and nmos::experimental::fields::registry_memory_limit
+        static utility::string_t check_memory_limits(const nmos::resources& resources, const nmos::api_version& version, const nmos::type& type, const web::json::value& data, const nmos::settings& settings)
+        {
+            const auto node_memory_limit = nmos::experimental::fields::registry_node_memory_limit(settings);
+            const auto memory_limit = nmos::experimental::fields::registry_memory_limit(settings);
+            if (0 == node_memory_limit && 0 == memory_limit) return{};
+
+            const nmos::resource registered{ version, type, data, false };
+
+            // a registration that doesn't increase the memory usage, e.g. an unchanged resource, is always allowed
+            const std::uint64_t bytes = nmos::experimental::approximate_memory_usage(registered);
+            const std::uint64_t prev_bytes = nmos::experimental::resource_memory_usage(resources, registered.id);
+            if (bytes <= prev_bytes) return{};
+            const auto growth = bytes - prev_bytes;
+
+            if (0 != memory_limit && nmos::experimental::memory_usage(resources) + growth > memory_limit)
+            {
+                return U("registration would exceed the registry memory limit");
+            }
+
+            if (0 != node_memory_limit)
+            {
+                const auto node_id = nmos::experimental::get_memory_usage_node(resources, registered);
+                if (!node_id.empty() && nmos::experimental::node_memory_usage(resources, node_id) + growth > node_memory_limit)
+                {
+                    return U("registration would exceed the memory limit for node ") + node_id;
+                }
+            }
+
+            return{};
+        }
+
+        // the outcome of validating the semantics of a resource registration request, i.e. the response, and the creation or update of the resource (if any)
+        // which is then carried out by commit_resource_registration, with the state of the existing resource and super-resource on which it depends
+        // see plan_resource_registration
+        struct resource_registration_plan
+        {
+            enum action_type { respond, create, modify, refresh };
+
+            resource_registration_plan() : action(respond) {}
+
+            // respond just sends the response, e.g. an error, or for an unchanged resource; refresh also sets the health of an unchanged node
+            action_type action;
+            resource_registration_response response;
+
+            nmos::api_version version;
+            nmos::type type;
+            nmos::id id;
+            web::json::value data;
+
+            // the update timestamps of the existing resource and super-resource, or tai_min() if they weren't found
+            nmos::tai resource_updated;
+            std::pair<nmos::id, nmos::type> super_id_type;
+            nmos::tai super_resource_updated;
+        };
+
+        // validate the semantics of a resource registration request, including referential integrity, and determine the outcome, without modifying the resources
+        // so this only requires a shared/read lock on the resources
+        // the resource data is moved out of the request body, which is consumed, and only copied into the response body if requested
+        static resource_registration_plan plan_resource_registration(const nmos::resources& resources, const nmos::api_version& version, web::json::value&& body, bool allow_invalid_resources, bool respond_with_data, const nmos::settings& settings, slog::base_gate& gate)
+        {
+            using web::json::value;
+            using web::http::status_codes;
+
+            resource_registration_plan plan;
+            auto& response = plan.response;
+
+            value data = std::move(nmos::fields::data(body));
+            const std::pair<nmos::id, nmos::type> id_type{ nmos::fields::id(data), nmos::type{ nmos::fields::type(body) } };
+            const auto& id = id_type.first;
+            const auto& type = id_type.second;
+
+            // Validate request semantics, including referential integrity
+            // such as the requested super-resource
+
+            bool valid = true;
+
+            // a modification request must not change the existing type
+            const auto resource = nmos::find_resource(resources, id);
+            const bool creating = resources.end() == resource;
+            const bool valid_type = creating || resource->type == type;
+            valid = valid && valid_type;
+
+            // a modification request must not change the API version
+            const bool valid_api_version = creating || resource->version == version;
+            valid = valid && valid_api_version;
+
+            // it must not change the super-resource either
+            const std::pair<nmos::id, nmos::type> no_resource{};
+            const auto super_id_type = nmos::get_super_resource(version, type, data);
+            const bool valid_super_id_type = creating || nmos::get_super_resource(*resource) == super_id_type;
+            valid = valid && valid_super_id_type;
+
+            // the super-resource should exist in this registry (and must be of the right type)
+            const auto super_resource = nmos::find_resource(resources, super_id_type.first);
+            const bool no_super_resource = resources.end() == super_resource;
+            const bool valid_super_resource = no_resource == super_id_type || !no_super_resource;
+            valid = valid && valid_super_resource;
+
+            const bool valid_super_type = no_resource == super_id_type || no_super_resource || super_resource->type == super_id_type.second;
+            valid = valid && valid_super_type;
+
+            // all the sub-resources of each node must have the same version
+            const bool valid_super_api_version = no_resource == super_id_type || no_super_resource || super_resource->version == version;
+            valid = valid && valid_super_api_version;
+
+            plan.version = version;
+            plan.type = type;
+            plan.id = id;
+            plan.resource_updated = creating ? nmos::tai_min() : resource->updated;
+            plan.super_id_type = super_id_type;
+            plan.super_resource_updated = no_super_resource ? nmos::tai_min() : super_resource->updated;
+
+            // registration of an unchanged resource is considered as an acceptable "update" even though it's a no-op, but seems worth logging?
+            // (comparing the version timestamps first avoids a deep comparison of the data for almost every modification)
+            const web::json::field_as_value_or version_or_null{ nmos::fields::version, {} };
+            const bool unchanged = !creating && version_or_null(data) == version_or_null(resource->data) && data == resource->data;
+
+            // each modification of a resource should update the version timestamp
+            const bool valid_version = creating || unchanged || nmos::fields::version(data) > nmos::fields::version(resource->data);
+            valid = valid && valid_version;
+
+            if (!valid_type)
+                slog::log<slog::severities::error>(gate, SLOG_FLF) << "Registration requested for " << id_type << " would modify type from " << resource->type.name;
+            else if (!valid_api_version)
+                slog::log<slog::severities::error>(gate, SLOG_FLF) << "Registration requested for " << id_type << " would modify API version from " << nmos::make_api_version(resource->version);
+            else if (!valid_super_id_type)
+                slog::log<slog::severities::error>(gate, SLOG_FLF) << "Registration requested for " << id_type << " on " << super_id_type << " would modify super-resource from " << nmos::get_super_resource(*resource);
+            else if (!valid_super_resource)
+                slog::log<slog::severities::error>(gate, SLOG_FLF) << "Registration requested for " << id_type << " on unknown " << super_id_type;
+            else if (!valid_super_type)
+                slog::log<slog::severities::error>(gate, SLOG_FLF) << "Registration requested for " << id_type << " on " << super_id_type << " with inconsistent type of " << super_resource->type.name;
+            else if (!valid_super_api_version)
+                slog::log<slog::severities::error>(gate, SLOG_FLF) << "Registration requested for " << id_type << " with API version inconsistent with super-resource " << nmos::make_api_version(super_resource->version);
+            else if (!valid_version)
+                slog::log<slog::severities::error>(gate, SLOG_FLF) << "Registration requested for " << id_type << " with invalid version";
+            else if (no_resource == super_id_type) // i.e. just nodes, basically
+                slog::log<slog::severities::info>(gate, SLOG_FLF) << "Registration requested for " << (unchanged ? "unchanged " : "") << id_type;
+            else
+                slog::log<slog::severities::info>(gate, SLOG_FLF) << "Registration requested for " << (unchanged ? "unchanged " : "") << id_type << " on " << super_id_type;
+
+            if (nmos::types::node == type)
+            {
+                // no extra validation yet
+            }
+            else if (nmos::types::device == type)
+            {
+                // "The 'senders' and 'receivers' arrays in a Device have been deprecated, but will continue to be present until v2.0."
+                // Therefore, issue warnings rather than errors here and don't worry too much about other issues such as whether to
+                // merge senders and receivers with existing device if present?
+                // or remove previous senders and receivers?
+                // See https://github.com/AMWA-TV/nmos-discovery-registration/blob/v1.2.1/docs/4.2.%20Behaviour%20-%20Querying.md#referential-integrity
+
+                for (auto& element : nmos::fields::senders(data))
+                {
+                    const auto& sender_id = element.as_string();
+                    const bool valid_sender = nmos::has_resource(resources, { sender_id, nmos::types::sender });
+                    if (!valid_sender) slog::log<slog::severities::warning>(gate, SLOG_FLF) << "Registration requested for " << id_type << " with unknown sender: " << sender_id;
+                }
+
+                for (auto& element : nmos::fields::receivers(data))
+                {
+                    const auto& receiver_id = element.as_string();
+                    const bool valid_receiver = nmos::has_resource(resources, { receiver_id, nmos::types::receiver });
+                    if (!valid_receiver) slog::log<slog::severities::warning>(gate, SLOG_FLF) << "Registration requested for " << id_type << " with unknown receiver: " << receiver_id;
+                }
+            }
+            else if (nmos::types::source == type)
+            {
+                // the parent sources might not be registered in this registry, so issue a warning not an error, and don't treat this as invalid?
+                for (auto& element : nmos::fields::parents(data))
+                {
+                    const auto& source_id = element.as_string();
+                    const bool valid_parent = nmos::has_resource(resources, { source_id, nmos::types::source });
+                    if (!valid_parent) slog::log<slog::severities::warning>(gate, SLOG_FLF) << "Registration requested for " << id_type << " with unknown parent source: " << source_id;
+                }
+            }
+            else if (nmos::types::flow == type)
+            {
+                // v1.1 introduced device_id for flow, and uses it for referential integrity rather than source_id
+                // so if the source is not (yet) registered, issue a warning not an error, and don't treat this as invalid?
+                // see https://github.com/AMWA-TV/nmos-discovery-registration/blob/v1.2.1/docs/4.1.%20Behaviour%20-%20Registration.md#referential-integrity
+                if (nmos::is04_versions::v1_1 <= version)
+                {
+                    const auto& source_id = nmos::fields::source_id(data);
+                    const bool valid_source = nmos::has_resource(resources, { source_id, nmos::types::source });
+                    if (!valid_source) slog::log<slog::severities::warning>(gate, SLOG_FLF) << "Registration requested for " << id_type << " from unknown source: " << source_id;
+                }
+
+                // the parent flows might not be registered in this registry, so issue a warning not an error, and don't treat this as invalid?
+                for (auto& element : nmos::fields::parents(data))
+                {
+                    const auto& flow_id = element.as_string();
+                    const bool valid_parent = nmos::has_resource(resources, { flow_id, nmos::types::flow });
+                    if (!valid_parent) slog::log<slog::severities::warning>(gate, SLOG_FLF) << "Registration requested for " << id_type << " with unknown parent flow: " << flow_id;
+                }
+            }
+            else if (nmos::types::sender == type)
+            {
+                // v1.1 introduced null for flow_id to "permit Senders without attached Flows to model a Device before internal routing has been performed"
+                const auto& flow_id = nmos::fields::flow_id(data);
+                const bool valid_flow = flow_id.is_null() || nmos::has_resource(resources, { flow_id.as_string(), nmos::types::flow });
+                if (!valid_flow)
+                    slog::log<slog::severities::warning>(gate, SLOG_FLF) << "Registration requested for " << id_type << " of unknown flow: " << flow_id.as_string();
+                else
+                    slog::log<slog::severities::more_info>(gate, SLOG_FLF) << "Registration requested for " << id_type << " of flow: " << details::as_string_or_null(flow_id);
+
+                // v1.2 introduced subscription for sender
+                if (nmos::is04_versions::v1_2 <= version)
+                {
+                    // the receiver might not be registered in this registry, so issue a warning not an error, and don't treat this as invalid?
+                    const value& receiver_id = nmos::fields::receiver_id(nmos::fields::subscription(data));
+                    const bool valid_receiver = receiver_id.is_null() || nmos::has_resource(resources, { receiver_id.as_string(), nmos::types::receiver });
+                    if (!valid_receiver)
+                        slog::log<slog::severities::warning>(gate, SLOG_FLF) << "Registration requested for " << id_type << " subscribed to unknown receiver: " << receiver_id.as_string();
+                    else
+                        slog::log<slog::severities::more_info>(gate, SLOG_FLF) << "Registration requested for " << id_type << " subscribed to receiver: " << details::as_string_or_null(receiver_id);
+                }
+            }
+            else if (nmos::types::receiver == type)
+            {
+                // the sender might not be registered in this registry, so issue a warning not an error, and don't treat this as invalid?
+                const value& sender_id = nmos::fields::sender_id(nmos::fields::subscription(data));
+                const bool valid_sender = sender_id.is_null() || nmos::has_resource(resources, { sender_id.as_string(), nmos::types::sender });
+                if (!valid_sender)
+                    slog::log<slog::severities::warning>(gate, SLOG_FLF) << "Registration requested for " << id_type << " subscribed to unknown sender: " << sender_id.as_string();
+                else
+                    slog::log<slog::severities::more_info>(gate, SLOG_FLF) << "Registration requested for " << id_type << " subscribed to sender: " << details::as_string_or_null(sender_id);
+            }
+            else // bad type
+            {
+                slog::log<slog::severities::error>(gate, SLOG_FLF) << "Registration requested for unrecognised resource type: " << type.name;
+                valid = false;
+            }
+
+            // always reject updates that would modify resource type or super-resource
+            const auto memory_limit_error = valid_type && valid_super_id_type && (valid || allow_invalid_resources)
+                ? details::check_memory_limits(resources, version, type, data, settings)
+                : utility::string_t{};
+            if (!memory_limit_error.empty())
+            {
+                slog::log<slog::severities::error>(gate, SLOG_FLF) << "Registration requested for " << id_type << " rejected; " << memory_limit_error;
+
+                // the resource is valid, but cannot be accommodated; the existing resource (if any) is left alone
+                response = { status_codes::RequestEntityTooLarge, nmos::make_error_response_body(status_codes::RequestEntityTooLarge, U("Payload Too Large; ") + memory_limit_error) };
+            }
+            else if (valid_type && valid_super_id_type && (valid || allow_invalid_resources))
+            {
+                if (creating)
+                {
+                    response = { status_codes::Created, respond_with_data ? data : value{}, make_registration_api_resource_location(version, type, id) };
+
+                    plan.action = resource_registration_plan::create;
+                    plan.data = std::move(data);
+                }
+                else if (unchanged)
+                {
+                    response = { status_codes::OK, respond_with_data ? std::move(data) : value{}, make_registration_api_resource_location(*resource) };
+
+                    // e.g. after a failover or a heartbeat 404, a node re-registers every resource, which mostly haven't changed
+                    // so the update timestamp isn't bumped, the indices aren't updated and no resource events are generated
+                    // but the re-registration of a node is as good as a heartbeat
+                    if (nmos::types::node == resource->type)
+                    {
+                        plan.action = resource_registration_plan::refresh;
+                    }
+                }
+                else
+                {
+                    response = { status_codes::OK, respond_with_data ? data : value{}, make_registration_api_resource_location(*resource) };
+
+                    plan.action = resource_registration_plan::modify;
+                    plan.data = std::move(data);
+                }
+            }
+            else if (!valid_api_version)
+            {
+                // experimental extension, proposed for v1.3, using a more specific status code to distinguish conflicts from validation errors
+                // when that conflict may be resolvable automatically by the Node
+                // see https://github.com/AMWA-TV/nmos-discovery-registration/pull/85
+                response = { status_codes::Conflict, nmos::make_error_response_body(status_codes::Conflict, U("Conflict; ") + details::make_valid_api_version_error(version, resource->version)) };
+
+                // the Location header would enable an HTTP DELETE to be performed to explicitly clear the registry of the conflicting registration
+                // (assert !creating, i.e. resources.end() != resource in all these cases)
+                response.location = make_registration_api_resource_location(*resource);
+            }
+            else if (!valid_type)
+            {
+                // the following errors are more likely to require a human to investigate so result in a simple 400 response
+                // but provide additional information in the error body, and as an experimental extension, via the Location header
+                response = { status_codes::BadRequest, nmos::make_error_response_body(status_codes::BadRequest, U("Bad Request; ") + details::make_valid_type_error(id_type, resource->type)) };
+                response.location = make_registration_api_resource_location(*resource);
+            }
+            else if (!valid_super_id_type)
+            {
+                response = { status_codes::BadRequest, nmos::make_error_response_body(status_codes::BadRequest, U("Bad Request; ") + details::make_valid_super_id_type_error(super_id_type, nmos::get_super_resource(*resource))) };
+                response.location = make_registration_api_resource_location(*resource);
+            }
+            else if (!valid_version)
+            {
+                response = { status_codes::BadRequest, nmos::make_error_response_body(status_codes::BadRequest, U("Bad Request; ") + details::make_valid_version_error(nmos::fields::version(data), nmos::fields::version(resource->data))) };
+                response.location = make_registration_api_resource_location(*resource);
+            }
+            else if (!valid_super_type)
+            {
+                // the difference here is that it's the super-resource that conflicts
+                response = { status_codes::BadRequest, nmos::make_error_response_body(status_codes::BadRequest, U("Bad Request; ") + details::make_valid_super_type_error(super_id_type, super_resource->type)) };
+
+                // since the conflict is with the super-resource, a single HTTP DELETE cannot be enough to resolve the issue in this case...
+                // (assert !no_super_resource, i.e. resources.end() != super_resource in all these cases)
+                response.location = make_registration_api_resource_location(*super_resource);
+            }
+            else if (!valid_super_api_version)
+            {
+                // another super-resource conflict
+                response = { status_codes::BadRequest, nmos::make_error_response_body(status_codes::BadRequest, U("Bad Request; ") + details::make_valid_super_api_version_error(version, super_resource->version)) };
+                response.location = make_registration_api_resource_location(*super_resource);
+            }
+            else if (!valid_super_resource)
+            {
+                response = { status_codes::BadRequest, nmos::make_error_response_body(status_codes::BadRequest, U("Bad Request; ") + details::make_valid_super_resource_error(super_id_type)) };
+            }
+            else
+            {
+                response = { status_codes::BadRequest, nmos::make_error_response_body(status_codes::BadRequest) };
+            }
+
+            return plan;
+        }
+
+        // determine whether the existing resource and super-resource on which a registration plan depends are unchanged, so that it can still be committed
+        static bool is_current_resource_registration_plan(const nmos::resources& resources, const resource_registration_plan& plan)
+        {
+            const auto resource = nmos::find_resource(resources, plan.id);
+            if ((resources.end() == resource ? nmos::tai_min() : resource->updated) != plan.resource_updated) return false;
+            const auto super_resource = nmos::find_resource(resources, plan.super_id_type.first);
+            if ((resources.end() == super_resource ? nmos::tai_min() : super_resource->updated) != plan.super_resource_updated) return false;
+            return true;
+        }
+
+        // make the registration request body again from a registration plan which creates or modifies a resource, so that it can be planned again
+        static web::json::value make_resource_registration_body(resource_registration_plan&& plan)
+        {
+            return web::json::value_of({
+                { nmos::fields::type, web::json::value::string(plan.type.name) },
+                { nmos::fields::data, std::move(plan.data) }
+            });
+        }
+
+        // carry out a registration plan, creating or updating the resource, and return the response
+        // a plan which creates or modifies a resource requires the exclusive/write lock on the resources, and must still be current
+        // (the caller is responsible for notifying the model when any resource has been modified or inserted)
+        static resource_registration_response commit_resource_registration(nmos::resources& resources, resource_registration_plan&& plan, bool allow_invalid_resources)
+        {
+            NMOS_CPP_TRACE(registration_commit, (int)plan.action, plan.type.name.c_str(), plan.id.c_str());
+            switch (plan.action)
+            {
+            case resource_registration_plan::create:
+                insert_resource(resources, { plan.version, plan.type, std::move(plan.data), false }, allow_invalid_resources);
+                break;
+            case resource_registration_plan::modify:
+            {
+                auto& data = plan.data;
+                modify_resource(resources, plan.id, [&data](nmos::resource& resource)
+                {
+                    resource.data = std::move(data);
+                });
+                break;
+            }
+            case resource_registration_plan::refresh:
+                // since health is mutable, this only requires a shared/read lock
+                set_resource_health(resources, plan.id, nmos::health_now());
+                break;
+            default:
+                break;
+            }
+            NMOS_CPP_TRACE(registration_committed, (int)plan.action, plan.type.name.c_str(), plan.id.c_str());
+            return std::move(plan.response);
+        }
+
+        // handle a validated resource registration request, creating or updating the resource as long as the request semantics are valid
+        // the resource data is moved out of the request body, which is consumed, and only copied into the response body if requested
+        // (the caller is responsible for notifying the model when any resource has been modified or inserted)
+        static resource_registration_response handle_resource_registration(nmos::resources& resources, const nmos::api_version& version, web::json::value&& body, bool allow_invalid_resources, bool respond_with_data, const nmos::settings& settings, slog::base_gate& gate)
+        {
+            return commit_resource_registration(resources, plan_resource_registration(resources, version, std::move(body), allow_invalid_resources, respond_with_data, settings, gate), allow_invalid_resources);
+        }
+
+        // the node id of the resource in a registration request, i.e. its own id for a node, or that of the node of which it is (indirectly) a sub-resource,
+        // or an empty string if the super-resource isn't registered
+        static nmos::id get_resource_registration_node_id(const nmos::resources& resources, const nmos::api_version& version, const web::json::value& body)
+        {
+            const auto& data = nmos::fields::data(body);
+            const nmos::type type{ nmos::fields::type(body) };
+            if (nmos::types::node == type) return nmos::fields::id(data);
+
+            const auto super_id_type = nmos::get_super_resource(version, type, data);
+            if (nmos::types::node == super_id_type.second) return super_id_type.first;
+            const auto super_resource = nmos::find_resource(resources, super_id_type);
+            return resources.end() != super_resource ? nmos::experimental::get_memory_usage_node(resources, *super_resource) : nmos::id{};
+        }
+
+        // experimental extension, registration requests for the resources of one node are handled in order in one lane, while those of independent nodes
+        // are validated concurrently, with just a shared/read lock on the resources, and only take the exclusive/write lock to commit the change
+        // see nmos::experimental::fields::registration_lanes
+        struct registration_lanes
+        {
+            explicit registration_lanes(std::size_t count) : lanes(count) {}
+
+            std::mutex& lane(const nmos::id& node_id) { return lanes[std::hash<nmos::id>()(node_id) % lanes.size()]; }
+
+        private:
+            std::vector<std::mutex> lanes;
+        };
+
+        // experimental extension, to limit the number of registration requests being handled at once, e.g. when every node re-registers all its resources
+        // after the registry is restarted, rejecting further requests with 503 (Service Unavailable) and a Retry-After header that paces their retries
+        // see nmos::experimental::fields::registration_admission_limit
+        class registration_admission
+        {
+        public:
+            typedef std::chrono::steady_clock clock;
+
+            explicit registration_admission(std::size_t limit) : limit(limit), in_flight(0), rejected(0) {}
+
+            // admit a request, returning zero, in which case release must be called when it has been handled,
+            // otherwise return the number of seconds after which to retry; the requests rejected in each second are spread
+            // over the following seconds, about the limit in each, so that their retries don't arrive all at once
+            unsigned int admit(clock::time_point now = clock::now())
+            {
+                std::lock_guard<std::mutex> lock(mutex);
+                if (in_flight < limit)
+                {
+                    ++in_flight;
+                    return 0;
+                }
+                if (now - window >= std::chrono::seconds(1))
+                {
+                    window = now;
+                    rejected = 0;
+                }
+                return 1 + (unsigned int)(rejected++ / limit);
+            }
+
+            void release()
+            {
+                std::lock_guard<std::mutex> lock(mutex);
+                if (0 != in_flight) --in_flight;
+            }
+
+        private:
+            std::mutex mutex;
+            const std::size_t limit;
+            std::size_t in_flight;
+            std::size_t rejected;
+            clock::time_point window;
+        };
+
+        // admit a registration request, returning a guard that releases it when destroyed (or a null guard if there's no admission limit),
+        // or set the 503 (Service Unavailable) response with a Retry-After header and throw to skip other route handlers
+        static std::shared_ptr<void> admit_registration(const std::shared_ptr<registration_admission>& admission, web::http::http_response& res, slog::base_gate& gate)
+        {
+            if (!admission) return{};
+
+            const auto retry_after = admission->admit();
+            if (0 != retry_after)
+            {
+                slog::log<slog::severities::warning>(gate, SLOG_FLF) << "Registration admission limit reached; retry after " << retry_after << " seconds";
+
+                set_error_reply(res, web::http::status_codes::ServiceUnavailable, U("Service Unavailable; registration admission limit reached"));
+                // "The value of this field can be either an HTTP-date or a number of seconds to delay after the response is received."
+                // See https://tools.ietf.org/html/rfc7231#section-7.1.3
+                res.headers().add(web::http::header_names::retry_after, retry_after);
+                throw details::to_api_finally_handler{}; // in order to skip other route handlers and then send the response
+            }
+            return std::shared_ptr<void>(nullptr, [admission](void*) { admission->release(); });
+        }
+
+        // experimental extension, to prioritise Registration API work during registration storms, so that heartbeats aren't queued behind
+        // thousands of other requests for the model lock, and healthy nodes don't expire; requests take turns to acquire the lock, the highest
+        // priority first, and in order of arrival within each priority, but a request waiting longer than the aging interval is promoted one
+        // priority for each interval so that lower priority requests aren't starved
+        // see nmos::experimental::fields::registration_priority_aging
+        enum registration_priority
+        {
+            health_registration_priority,
+            node_registration_priority, // node or device
+            other_registration_priority
+        };
+
+        inline registration_priority get_registration_priority(const nmos::type& type)
+        {
+            return nmos::types::node == type || nmos::types::device == type ? node_registration_priority : other_registration_priority;
+        }
+
+        class registration_scheduler
+        {
+        public:
+            typedef std::chrono::steady_clock clock;
+
+            explicit registration_scheduler(clock::duration aging) : aging(aging), busy(false), granted(waiters.end()) {}
+
+            // wait for the turn of a request of the specified priority
+            void acquire(registration_priority priority)
+            {
+                std::unique_lock<std::mutex> lock(mutex);
+                const auto waiter = waiters.insert(waiters.end(), { priority, clock::now() });
+                if (!busy) grant();
+                condition.wait(lock, [&] { return waiter == granted; });
+                waiters.erase(waiter);
+                granted = waiters.end();
+            }
+
+            // end the turn, once the request has acquired the model lock
+            void release()
+            {
+                std::lock_guard<std::mutex> lock(mutex);
+                busy = false;
+                if (!waiters.empty()) grant();
+            }
+
+        private:
+            struct waiter
+            {
+                registration_priority priority;
+                clock::time_point arrival;
+            };
+
+            // the next turn is chosen just once, under the mutex, so that all the waiters agree on it
+            void grant()
+            {
+                const auto now = clock::now();
+                auto best = waiters.end();
+                long long best_priority = 0;
+                for (auto candidate = waiters.begin(); waiters.end() != candidate; ++candidate)
+                {
+                    const long long promotion = clock::duration::zero() < aging ? (now - candidate->arrival) / aging : 0;
+                    const long long priority = (long long)candidate->priority - promotion;
+                    // waiters are in order of arrival, so ties go to the earliest
+                    if (waiters.end() == best || priority < best_priority)
+                    {
+                        best = candidate;
+                        best_priority = priority;
+                    }
+                }
+                granted = best;
+                busy = true;
+                condition.notify_all();
+            }
+
+            std::mutex mutex;
+            std::condition_variable condition;
+            const clock::duration aging;
+            bool busy;
+            std::list<waiter> waiters;
+            std::list<waiter>::iterator granted;
+        };
+
+        // acquire the model lock made by the specified function in turn with other requests of the same or higher priority (or immediately if there's no scheduler)
+        template <typename MakeLock>
+        inline auto make_scheduled_lock(registration_scheduler* scheduler, registration_priority priority, MakeLock make_lock) -> decltype(make_lock())
+        {
+            if (!scheduler) return make_lock();
+
+            scheduler->acquire(priority);
+            struct turn_guard { registration_scheduler& scheduler; ~turn_guard() { scheduler.release(); } } guard{ *scheduler };
+            return make_lock();
+        }
+
+        // handle a validated resource registration request in the lane for its node, validating the request semantics with just a shared/read lock on the resources,
+        // and only taking the exclusive/write lock to create or update the resource, as long as the existing resource and super-resource haven't been changed meanwhile
+        // (the caller is responsible for notifying the model when any resource has been modified or inserted)
+        static resource_registration_response handle_resource_registration_in_lane(nmos::registry_model& model, registration_lanes& lanes, registration_scheduler* scheduler, const nmos::api_version& version, web::json::value&& body, bool allow_invalid_resources, std::chrono::steady_clock::time_point ingress, slog::base_gate& gate)
+        {
+            auto& resources = model.registry_resources;
+
+            auto lock = model.read_lock();
+            const auto node_id = get_resource_registration_node_id(resources, version, body);
+            lock.unlock();
+
+            std::lock_guard<std::mutex> lane_lock(lanes.lane(node_id));
+
+            lock.lock();
+            auto plan = plan_resource_registration(resources, version, std::move(body), allow_invalid_resources, true, model.settings, gate);
+
+            // an error, or an unchanged resource, doesn't need the exclusive/write lock
+            if (resource_registration_plan::create != plan.action && resource_registration_plan::modify != plan.action)
+            {
+                auto response = commit_resource_registration(resources, std::move(plan), allow_invalid_resources);
+
+                if (web::http::is_success_status_code(response.code))
+                {
+                    slog::log<slog::severities::more_info>(gate, SLOG_FLF) << "At " << nmos::make_version(nmos::tai_now()) << ", the registry contains " << nmos::put_resources_statistics(resources);
+                }
+
+                return response;
+            }
+
+            lock.unlock();
+
+            auto write_lock = make_scheduled_lock(scheduler, get_registration_priority(plan.type), [&model] { return model.write_lock(); });
+            const nmos::event_ingress_guard ingress_guard(resources.event_queues, ingress);
+
+            // requests in other lanes can't change the resources of this node, but e.g. it may have expired or been deleted meanwhile
+            if (!is_current_resource_registration_plan(resources, plan))
+            {
+                slog::log<slog::severities::more_info>(gate, SLOG_FLF) << "Registration requested for " << std::make_pair(plan.id, plan.type) << " is being validated again";
+                plan = plan_resource_registration(resources, version, make_resource_registration_body(std::move(plan)), allow_invalid_resources, true, model.settings, gate);
+            }
+
+            auto response = commit_resource_registration(resources, std::move(plan), allow_invalid_resources);
+
+            if (web::http::is_success_status_code(response.code))
+            {
+                slog::log<slog::severities::more_info>(gate, SLOG_FLF) << "At " << nmos::make_version(nmos::tai_now()) << ", the registry contains " << nmos::put_resources_statistics(resources);
+            }
+
+            return response;
+        }
+
+        // the resource types that may be registered
+        static const std::vector<nmos::type>& registration_types()
+        {
+            static const std::vector<nmos::type> types{ nmos::types::node, nmos::types::device, nmos::types::source, nmos::types::flow, nmos::types::sender, nmos::types::receiver };
+            return types;
+        }
+
+        // make the validator for registration request bodies, which includes the schemas for the resource data of each type
+        static web::json::experimental::json_validator make_resource_registration_validator(const std::set<nmos::api_version>& versions)
+        {
+            std::vector<web::uri> ids;
+            for (const auto& version : versions)
+            {
+                ids.push_back(experimental::make_registrationapi_resource_post_request_schema_uri(version));
+                for (const auto& type : registration_types())
+                {
+                    ids.push_back(experimental::make_registrationapi_resource_post_request_data_schema_uri(version, type));
+                }
+            }
+            return web::json::experimental::json_validator(nmos::experimental::load_json_schema, ids);
+        }
+
+        // validate the registration request body according to the schema
+        // when the request has a recognised type, only its data needs to be validated against the schema for that type, since the request schema
+        // is just a 'oneOf' of those alternatives, distinguished by the type; otherwise, the full request schema provides the error information
+        static void validate_resource_registration(const web::json::experimental::json_validator& validator, const nmos::api_version& version, const web::json::value& body)
+        {
+            if (body.is_object() && body.has_field(nmos::fields::data) && body.has_field(nmos::fields::type) && body.at(nmos::fields::type).is_string())
+            {
+                const nmos::type type{ nmos::fields::type(body) };
+                const auto& types = registration_types();
+                if (types.end() != std::find(types.begin(), types.end(), type))
+                {
+                    validator.validate(nmos::fields::data(body), experimental::make_registrationapi_resource_post_request_data_schema_uri(version, type));
+                    return;
+                }
+            }
+
+            validator.validate(body, experimental::make_registrationapi_resource_post_request_schema_uri(version));
+        }
+
+        // validate the registration request body according to the schema, or only log a warning if invalid resources are allowed
+        static void validate_resource_registration(const web::json::experimental::json_validator& validator, const nmos::api_version& version, const web::json::value& body, bool allow_invalid_resources, slog::base_gate& gate)
+        {
+            if (!allow_invalid_resources)
+            {
+                validate_resource_registration(validator, version, body);
+            }
+            else
+            {
+                try
+                {
+                    validate_resource_registration(validator, version, body);
+                }
+                catch (const web::json::json_exception& e)
+                {
+                    slog::log<slog::severities::warning>(gate, SLOG_FLF) << "JSON error: " << e.what();
+                }
+            }
+        }
+
+        // determine the node id of the resource being registered, for the registration validation policies, without assuming the request body is valid
+        // a node or device refers to the node directly, while the other resources refer to their device, which must be looked up
+        static nmos::id get_registration_node_id(const nmos::registry_model& model, const web::json::value& body)
+        {
+            if (!body.is_object() || !body.has_field(nmos::fields::type) || !body.at(nmos::fields::type).is_string()) return{};
+            if (!body.has_field(nmos::fields::data) || !body.at(nmos::fields::data).is_object()) return{};
+            const auto& data = nmos::fields::data(body);
+
+            const nmos::type type{ nmos::fields::type(body) };
+            const auto& field = nmos::types::node == type ? nmos::fields::id.key : nmos::types::device == type ? nmos::fields::node_id.key : nmos::fields::device_id.key;
+            if (!data.has_field(field) || !data.at(field).is_string()) return{};
+            const auto& id = data.at(field).as_string();
+            if (nmos::types::node == type || nmos::types::device == type) return id;
+
+            auto lock = model.read_lock();
+            const auto& resources = model.registry_resources;
+            auto device = find_resource(resources, { id, nmos::types::device });
+            return resources.end() != device ? nmos::fields::node_id(device->data) : nmos::id{};
+        }
+
+        // validate the registration request body according to the schema, unless the registration validation policies skip the request
+        static void validate_resource_registration(const web::json::experimental::json_validator& validator, nmos::experimental::registration_validation_policies* policies, const nmos::registry_model& model, const utility::string_t& address, const nmos::api_version& version, const web::json::value& body, bool allow_invalid_resources, slog::base_gate& gate)
+        {
+            if (nullptr != policies && !policies->validate(address, [&] { return get_registration_node_id(model, body); }))
+            {
+                slog::log<slog::severities::too_much_info>(gate, SLOG_FLF) << "Schema validation skipped by registration validation policy";
+                return;
+            }
+            validate_resource_registration(validator, version, body, allow_invalid_resources, gate);
+        }
+
+        // handle a heartbeat for the specified node, as long as it is registered with the same API version
+        static resource_registration_response handle_node_heartbeat(const nmos::resources& resources, const nmos::api_version& version, const nmos::id& id, slog::base_gate& gate)
+        {
+            using web::http::status_codes;
+
+            auto resource = find_resource(resources, { id, nmos::types::node });
+            if (resources.end() != resource)
+            {
+                if (resource->version == version)
+                {
+                    slog::log<slog::severities::too_much_info>(gate, SLOG_FLF) << "Heartbeat received for node: " << id;
+                    NMOS_CPP_TRACE(heartbeat, id.c_str());
+
+                    const auto health = nmos::health_now();
+                    set_resource_health(resources, resource->id, health);
+
+                    return{ status_codes::OK, make_health_response_body(health) };
+                }
+                else
+                {
+                    // experimental extension, proposed for v1.3, to distinguish from Not Found
+                    return{ status_codes::Conflict, nmos::make_error_response_body(status_codes::Conflict, U("Conflict; ") + details::make_valid_api_version_error(version, resource->version)), make_registration_api_health_location(*resource) };
+                }
+            }
+            else if (details::is_erased_resource(resources, { id, nmos::types::node }))
+            {
+                return{ status_codes::NotFound, nmos::make_error_response_body(status_codes::NotFound, U("Not Found; ") + details::make_erased_resource_error()) };
+            }
+            else
+            {
+                return{ status_codes::NotFound, nmos::make_error_response_body(status_codes::NotFound) };
+            }
+        }
+    }
+
     inline web::http::experimental::listener::api_router make_unmounted_registration_api(nmos::registry_model& model, slog::base_gate& gate_)
     {
         using namespace web::http::experimental::listener::api_router_using_declarations;
@@ -192,299 +917,256 @@ namespace nmos
             return pplx::task_from_result(true);
         });
 
+        // experimental extension, to limit the rate of requests from each client, so that one misbehaving client cannot starve the others
+        // heartbeats are exempt, since if they are held up, resources expire
+        const auto rate_limiter = with_read_lock(model.mutex, [&model] { return nmos::experimental::make_rate_limiter(model.settings); });
+        if (rate_limiter)
+        {
+            registration_api.support(U("(?!/health/).*"), nmos::experimental::make_api_rate_limit_handler(rate_limiter, gate_));
+        }
+
         registration_api.support(U("/?"), methods::GET, [](http_request, http_response res, const string_t&, const route_parameters&)
+        {
+            // experimental extension, to enable a node to register many resources in one request
+            set_reply(res, status_codes::OK, nmos::make_sub_routes_body({ U("resource/"), U("health/"), U("bulk/") }, res));
+            return pplx::task_from_result(true);
+        });
+
+        registration_api.support(U("/bulk/?"), methods::GET, [](http_request, http_response res, const string_t&, const route_parameters&)
         {
             set_reply(res, status_codes::OK, nmos::make_sub_routes_body({ U("resource/"), U("health/") }, res));
             return pplx::task_from_result(true);
         });
 
-        const web::json::experimental::json_validator validator
+        registration_api.support(U("/bulk/health/?"), methods::GET, [](http_request, http_response res, const string_t&, const route_parameters&)
         {
-            nmos::experimental::load_json_schema,
-            boost::copy_range<std::vector<web::uri>>(versions | boost::adaptors::transformed(experimental::make_registrationapi_resource_post_request_schema_uri))
-        };
+            set_reply(res, status_codes::OK, nmos::make_sub_routes_body({ U("nodes/") }, res));
+            return pplx::task_from_result(true);
+        });
+
+        // the schemas are compiled just once, and validation is performed without the model lock so that many requests may be validated concurrently
+        const auto validator = details::make_resource_registration_validator(versions);
+
+        // experimental extension, to validate the semantics of requests for the resources of independent nodes concurrently too
+        const auto lanes_count = with_read_lock(model.mutex, [&model] { return nmos::experimental::fields::registration_lanes(model.settings); });
+        const auto lanes = 0 < lanes_count ? std::make_shared<details::registration_lanes>((std::size_t)lanes_count) : std::shared_ptr<details::registration_lanes>();
 
-        registration_api.support(U("/resource/?"), methods::POST, [&model, validator, &gate_](http_request req, http_response res, const string_t&, const route_parameters& parameters)
+        // experimental extension, to limit the number of registration requests being handled at once
+        const auto admission_limit = with_read_lock(model.mutex, [&model] { return nmos::experimental::fields::registration_admission_limit(model.settings); });
+        const auto admission = 0 < admission_limit ? std::make_shared<details::registration_admission>((std::size_t)admission_limit) : std::shared_ptr<details::registration_admission>();
+
+        // experimental extension, to prioritise heartbeats, then node and device registrations, over everything else
+        const auto priority_aging = with_read_lock(model.mutex, [&model] { return nmos::experimental::fields::registration_priority_aging(model.settings); });
+        const auto scheduler = 0 <= priority_aging ? std::make_shared<details::registration_scheduler>(std::chrono::milliseconds(priority_aging)) : std::shared_ptr<details::registration_scheduler>();
+
+        // experimental extension, to skip, or only sample, the schema validation of the registration requests from trusted clients
+        const auto validation_policies = with_read_lock(model.mutex, [&model] { return nmos::experimental::make_registration_validation_policies(model.settings); });
+
+        registration_api.support(U("/resource/?"), methods::POST, [&model, validator, validation_policies, lanes, admission, scheduler, &gate_](http_request req, http_response res, const string_t&, const route_parameters& parameters)
         {
             nmos::api_gate gate(gate_, req, parameters);
 
+            // the request is released when the continuation, which holds the guard, is destroyed
+            auto admitted = details::admit_registration(admission, res, gate);
+
+            // experimental extension, the change-propagation latency metrics are measured from when the request was received
+            const auto ingress = std::chrono::steady_clock::now();
+
             // note that, as elsewhere, http_exception and json_exception are handled by the exception handler added by add_api_finally_handler
-            return details::extract_json(req, gate).then([&model, &validator, req, res, parameters, gate](value body) mutable
+            return details::extract_json(req, gate, model.get_settings_snapshot()->max_request_body_size).then([&model, &validator, validation_policies, lanes, scheduler, admitted, req, res, parameters, gate, ingress](value body) mutable
             {
-                // could start out as a shared/read lock, only upgraded to an exclusive/write lock when the resource is actually modified or inserted into resources
-                auto lock = model.write_lock();
-                auto& resources = model.registry_resources;
-
                 const nmos::api_version version = nmos::parse_api_version(parameters.at(nmos::patterns::version.name));
 
-                // Validate JSON syntax according to the schema
+                // Validate JSON syntax according to the schema, before taking the lock
 
-                const bool allow_invalid_resources = nmos::fields::allow_invalid_resources(model.settings);
-                if (!allow_invalid_resources)
+                const bool allow_invalid_resources = model.get_settings_snapshot()->allow_invalid_resources;
+                details::validate_resource_registration(validator, validation_policies.get(), model, req.remote_address(), version, body, allow_invalid_resources, gate);
+
+                details::resource_registration_response response;
+                if (lanes)
                 {
-                    validator.validate(body, experimental::make_registrationapi_resource_post_request_schema_uri(version));
+                    response = details::handle_resource_registration_in_lane(model, *lanes, scheduler.get(), version, std::move(body), allow_invalid_resources, ingress, gate);
                 }
                 else
                 {
-                    try
-                    {
-                        validator.validate(body, experimental::make_registrationapi_resource_post_request_schema_uri(version));
-                    }
-                    catch (const web::json::json_exception& e)
+                    auto lock = details::make_scheduled_lock(scheduler.get(), details::get_registration_priority(nmos::type{ nmos::fields::type(body) }), [&model] { return model.write_lock(); });
+                    auto& resources = model.registry_resources;
+                    const nmos::event_ingress_guard ingress_guard(resources.event_queues, ingress);
+
+                    response = details::handle_resource_registration(resources, version, std::move(body), allow_invalid_resources, true, model.settings, gate);
+
+                    if (web::http::is_success_status_code(response.code))
                     {
-                        slog::log<slog::severities::warning>(gate, SLOG_FLF) << "JSON error: " << e.what();
+                        slog::log<slog::severities::more_info>(gate, SLOG_FLF) << "At " << nmos::make_version(nmos::tai_now()) << ", the registry contains " << nmos::put_resources_statistics(resources);
                     }
                 }
 
-                const value data = nmos::fields::data(body);
-                const std::pair<nmos::id, nmos::type> id_type{ nmos::fields::id(data), nmos::type{ nmos::fields::type(body) } };
-                const auto& id = id_type.first;
-                const auto& type = id_type.second;
-
-                // Validate request semantics, including referential integrity
-                // such as the requested super-resource
-
-                bool valid = true;
-
-                // a modification request must not change the existing type
-                const auto resource = nmos::find_resource(resources, id);
-                const bool creating = resources.end() == resource;
-                const bool valid_type = creating || resource->type == type;
-                valid = valid && valid_type;
-
-                // a modification request must not change the API version
-                const bool valid_api_version = creating || resource->version == version;
-                valid = valid && valid_api_version;
-
-                // it must not change the super-resource either
-                const std::pair<nmos::id, nmos::type> no_resource{};
-                const auto super_id_type = nmos::get_super_resource(version, type, data);
-                const bool valid_super_id_type = creating || nmos::get_super_resource(*resource) == super_id_type;
-                valid = valid && valid_super_id_type;
-
-                // the super-resource should exist in this registry (and must be of the right type)
-                const auto super_resource = nmos::find_resource(resources, super_id_type.first);
-                const bool no_super_resource = resources.end() == super_resource;
-                const bool valid_super_resource = no_resource == super_id_type || !no_super_resource;
-                valid = valid && valid_super_resource;
-
-                const bool valid_super_type = no_resource == super_id_type || no_super_resource || super_resource->type == super_id_type.second;
-                valid = valid && valid_super_type;
-
-                // all the sub-resources of each node must have the same version
-                const bool valid_super_api_version = no_resource == super_id_type || no_super_resource || super_resource->version == version;
-                valid = valid && valid_super_api_version;
-
-                // registration of an unchanged resource is considered as an acceptable "update" even though it's a no-op, but seems worth logging?
-                const bool unchanged = !creating && data == resource->data;
-
-                // each modification of a resource should update the version timestamp
-                const bool valid_version = creating || unchanged || nmos::fields::version(data) > nmos::fields::version(resource->data);
-                valid = valid && valid_version;
-
-                if (!valid_type)
-                    slog::log<slog::severities::error>(gate, SLOG_FLF) << "Registration requested for " << id_type << " would modify type from " << resource->type.name;
-                else if (!valid_api_version)
-                    slog::log<slog::severities::error>(gate, SLOG_FLF) << "Registration requested for " << id_type << " would modify API version from " << nmos::make_api_version(resource->version);
-                else if (!valid_super_id_type)
-                    slog::log<slog::severities::error>(gate, SLOG_FLF) << "Registration requested for " << id_type << " on " << super_id_type << " would modify super-resource from " << nmos::get_super_resource(*resource);
-                else if (!valid_super_resource)
-                    slog::log<slog::severities::error>(gate, SLOG_FLF) << "Registration requested for " << id_type << " on unknown " << super_id_type;
-                else if (!valid_super_type)
-                    slog::log<slog::severities::error>(gate, SLOG_FLF) << "Registration requested for " << id_type << " on " << super_id_type << " with inconsistent type of " << super_resource->type.name;
-                else if (!valid_super_api_version)
-                    slog::log<slog::severities::error>(gate, SLOG_FLF) << "Registration requested for " << id_type << " with API version inconsistent with super-resource " << nmos::make_api_version(super_resource->version);
-                else if (!valid_version)
-                    slog::log<slog::severities::error>(gate, SLOG_FLF) << "Registration requested for " << id_type << " with invalid version";
-                else if (no_resource == super_id_type) // i.e. just nodes, basically
-                    slog::log<slog::severities::info>(gate, SLOG_FLF) << "Registration requested for " << (unchanged ? "unchanged " : "") << id_type;
-                else
-                    slog::log<slog::severities::info>(gate, SLOG_FLF) << "Registration requested for " << (unchanged ? "unchanged " : "") << id_type << " on " << super_id_type;
-
-                if (nmos::types::node == type)
+                set_reply(res, response.code, response.body);
+                if (!response.location.empty())
                 {
-                    // no extra validation yet
+                    res.headers().add(web::http::header_names::location, response.location);
                 }
-                else if (nmos::types::device == type)
-                {
-                    // "The 'senders' and 'receivers' arrays in a Device have been deprecated, but will continue to be present until v2.0."
-                    // Therefore, issue warnings rather than errors here and don't worry too much about other issues such as whether to
-                    // merge senders and receivers with existing device if present?
-                    // or remove previous senders and receivers?
-                    // See https://github.com/AMWA-TV/nmos-discovery-registration/blob/v1.2.1/docs/4.2.%20Behaviour%20-%20Querying.md#referential-integrity
 
-                    for (auto& element : nmos::fields::senders(data))
-                    {
-                        const auto& sender_id = element.as_string();
-                        const bool valid_sender = nmos::has_resource(resources, { sender_id, nmos::types::sender });
-                        if (!valid_sender) slog::log<slog::severities::warning>(gate, SLOG_FLF) << "Registration requested for " << id_type << " with unknown sender: " << sender_id;
-                    }
-
-                    for (auto& element : nmos::fields::receivers(data))
-                    {
-                        const auto& receiver_id = element.as_string();
-                        const bool valid_receiver = nmos::has_resource(resources, { receiver_id, nmos::types::receiver });
-                        if (!valid_receiver) slog::log<slog::severities::warning>(gate, SLOG_FLF) << "Registration requested for " << id_type << " with unknown receiver: " << receiver_id;
-                    }
-                }
-                else if (nmos::types::source == type)
+                if (web::http::is_success_status_code(response.code))
                 {
-                    // the parent sources might not be registered in this registry, so issue a warning not an error, and don't treat this as invalid?
-                    for (auto& element : nmos::fields::parents(data))
-                    {
-                        const auto& source_id = element.as_string();
-                        const bool valid_parent = nmos::has_resource(resources, { source_id, nmos::types::source });
-                        if (!valid_parent) slog::log<slog::severities::warning>(gate, SLOG_FLF) << "Registration requested for " << id_type << " with unknown parent source: " << source_id;
-                    }
+                    slog::log<slog::severities::too_much_info>(gate, SLOG_FLF) << "Notifying query websockets thread"; // and anyone else who cares...
+                    model.notify();
                 }
-                else if (nmos::types::flow == type)
-                {
-                    // v1.1 introduced device_id for flow, and uses it for referential integrity rather than source_id
-                    // so if the source is not (yet) registered, issue a warning not an error, and don't treat this as invalid?
-                    // see https://github.com/AMWA-TV/nmos-discovery-registration/blob/v1.2.1/docs/4.1.%20Behaviour%20-%20Registration.md#referential-integrity
-                    if (nmos::is04_versions::v1_1 <= version)
-                    {
-                        const auto& source_id = nmos::fields::source_id(data);
-                        const bool valid_source = nmos::has_resource(resources, { source_id, nmos::types::source });
-                        if (!valid_source) slog::log<slog::severities::warning>(gate, SLOG_FLF) << "Registration requested for " << id_type << " from unknown source: " << source_id;
-                    }
 
-                    // the parent flows might not be registered in this registry, so issue a warning not an error, and don't treat this as invalid?
-                    for (auto& element : nmos::fields::parents(data))
-                    {
-                        const auto& flow_id = element.as_string();
-                        const bool valid_parent = nmos::has_resource(resources, { flow_id, nmos::types::flow });
-                        if (!valid_parent) slog::log<slog::severities::warning>(gate, SLOG_FLF) << "Registration requested for " << id_type << " with unknown parent flow: " << flow_id;
-                    }
-                }
-                else if (nmos::types::sender == type)
-                {
-                    // v1.1 introduced null for flow_id to "permit Senders without attached Flows to model a Device before internal routing has been performed"
-                    const auto& flow_id = nmos::fields::flow_id(data);
-                    const bool valid_flow = flow_id.is_null() || nmos::has_resource(resources, { flow_id.as_string(), nmos::types::flow });
-                    if (!valid_flow)
-                        slog::log<slog::severities::warning>(gate, SLOG_FLF) << "Registration requested for " << id_type << " of unknown flow: " << flow_id.as_string();
-                    else
-                        slog::log<slog::severities::more_info>(gate, SLOG_FLF) << "Registration requested for " << id_type << " of flow: " << details::as_string_or_null(flow_id);
+                return true;
+            });
+        });
 
-                    // v1.2 introduced subscription for sender
-                    if (nmos::is04_versions::v1_2 <= version)
-                    {
-                        // the receiver might not be registered in this registry, so issue a warning not an error, and don't treat this as invalid?
-                        const value& receiver_id = nmos::fields::receiver_id(nmos::fields::subscription(data));
-                        const bool valid_receiver = receiver_id.is_null() || nmos::has_resource(resources, { receiver_id.as_string(), nmos::types::receiver });
-                        if (!valid_receiver)
-                            slog::log<slog::severities::warning>(gate, SLOG_FLF) << "Registration requested for " << id_type << " subscribed to unknown receiver: " << receiver_id.as_string();
-                        else
-                            slog::log<slog::severities::more_info>(gate, SLOG_FLF) << "Registration requested for " << id_type << " subscribed to receiver: " << details::as_string_or_null(receiver_id);
-                    }
-                }
-                else if (nmos::types::receiver == type)
-                {
-                    // the sender might not be registered in this registry, so issue a warning not an error, and don't treat this as invalid?
-                    const value& sender_id = nmos::fields::sender_id(nmos::fields::subscription(data));
-                    const bool valid_sender = sender_id.is_null() || nmos::has_resource(resources, { sender_id.as_string(), nmos::types::sender });
-                    if (!valid_sender)
-                        slog::log<slog::severities::warning>(gate, SLOG_FLF) << "Registration requested for " << id_type << " subscribed to unknown sender: " << sender_id.as_string();
-                    else
-                        slog::log<slog::severities::more_info>(gate, SLOG_FLF) << "Registration requested for " << id_type << " subscribed to sender: " << details::as_string_or_null(sender_id);
-                }
-                else // bad type
+        // experimental extension, to enable a node to register many resources in one request, e.g. a node and all its sub-resources on startup,
+        // or after failing over to another registry; the request body is an array of registration request bodies, which are handled in order,
+        // and the response body is an array of the status code (and error information) for each, in the style of the IS-05 Connection API bulk requests
+        registration_api.support(U("/bulk/resource/?"), methods::POST, [&model, validator, validation_policies, admission, scheduler, &gate_](http_request req, http_response res, const string_t&, const route_parameters& parameters)
+        {
+            nmos::api_gate gate(gate_, req, parameters);
+
+            auto admitted = details::admit_registration(admission, res, gate);
+
+            const auto ingress = std::chrono::steady_clock::now();
+
+            return details::extract_json(req, gate, model.get_settings_snapshot()->max_request_body_size).then([&model, &validator, validation_policies, scheduler, admitted, req, res, parameters, gate, ingress](value body) mutable
+            {
+                const nmos::api_version version = nmos::parse_api_version(parameters.at(nmos::patterns::version.name));
+
+                auto& registrations = body.as_array();
+
+                slog::log<slog::severities::info>(gate, SLOG_FLF) << "Bulk registration requested for " << registrations.size() << " resources";
+
+                // Validate JSON syntax according to the schema, for all the registration requests before taking the lock and handling any of them
+
+                const bool allow_invalid_resources = model.get_settings_snapshot()->allow_invalid_resources;
+                auto priority = details::other_registration_priority;
+                for (const auto& registration : registrations)
                 {
-                    slog::log<slog::severities::error>(gate, SLOG_FLF) << "Registration requested for unrecognised resource type: " << type.name;
-                    valid = false;
+                    details::validate_resource_registration(validator, validation_policies.get(), model, req.remote_address(), version, registration, allow_invalid_resources, gate);
+                    priority = (std::min)(priority, details::get_registration_priority(nmos::type{ nmos::fields::type(registration) }));
                 }
 
-                // always reject updates that would modify resource type or super-resource
-                if (valid_type && valid_super_id_type && (valid || allow_invalid_resources))
+                auto lock = details::make_scheduled_lock(scheduler.get(), priority, [&model] { return model.write_lock(); });
+                auto& resources = model.registry_resources;
+                const nmos::event_ingress_guard ingress_guard(resources.event_queues, ingress);
+
+                // Handle each registration request in order, so that each may refer to the super-resources registered by those before it
+
+                std::vector<value> results;
+                results.reserve(registrations.size());
+
+                bool modified = false;
+                for (auto& registration : registrations)
                 {
-                    if (creating)
-                    {
-                        nmos::resource created_resource{ version, type, data, false };
+                    const auto id = nmos::fields::id(nmos::fields::data(registration));
 
-                        set_reply(res, status_codes::Created, data);
-                        res.headers().add(web::http::header_names::location, make_registration_api_resource_location(created_resource));
+                    // the bulk response doesn't include the resource data, so it is simply moved into the resource
+                    const auto response = details::handle_resource_registration(resources, version, std::move(registration), allow_invalid_resources, false, model.settings, gate);
 
-                        insert_resource(resources, std::move(created_resource), allow_invalid_resources);
+                    if (web::http::is_success_status_code(response.code))
+                    {
+                        modified = true;
+
+                        results.push_back(value_of({
+                            { nmos::fields::id, id },
+                            { U("code"), response.code }
+                        }));
                     }
                     else
                     {
-                        set_reply(res, status_codes::OK, data);
-                        res.headers().add(web::http::header_names::location, make_registration_api_resource_location(*resource));
-
-                        modify_resource(resources, id, [&data](nmos::resource& resource)
-                        {
-                            resource.data = data;
-                        });
+                        // make a bulk response error item from the standard NMOS error response
+                        auto result = response.body;
+                        result[nmos::fields::id] = value::string(id);
+                        results.push_back(result);
                     }
+                }
+
+                set_reply(res, status_codes::OK, web::json::value_from_elements(results));
 
+                // all the resource events have been inserted, so the query websockets thread can send them together
+                if (modified)
+                {
                     slog::log<slog::severities::more_info>(gate, SLOG_FLF) << "At " << nmos::make_version(nmos::tai_now()) << ", the registry contains " << nmos::put_resources_statistics(resources);
 
                     slog::log<slog::severities::too_much_info>(gate, SLOG_FLF) << "Notifying query websockets thread"; // and anyone else who cares...
                     model.notify();
                 }
-                else if (!valid_api_version)
-                {
-                    // experimental extension, proposed for v1.3, using a more specific status code to distinguish conflicts from validation errors
-                    // when that conflict may be resolvable automatically by the Node
-                    // see https://github.com/AMWA-TV/nmos-discovery-registration/pull/85
-                    set_error_reply(res, status_codes::Conflict, U("Conflict; ") + details::make_valid_api_version_error(version, resource->version));
 
-                    // the Location header would enable an HTTP DELETE to be performed to explicitly clear the registry of the conflicting registration
-                    // (assert !creating, i.e. resources.end() != resource in all these cases)
-                    res.headers().add(web::http::header_names::location, make_registration_api_resource_location(*resource));
-                }
-                else if (!valid_type)
-                {
-                    // the following errors are more likely to require a human to investigate so result in a simple 400 response
-                    // but provide additional information in the error body, and as an experimental extension, via the Location header
-                    set_error_reply(res, status_codes::BadRequest, U("Bad Request; ") + details::make_valid_type_error(id_type, resource->type));
-                    res.headers().add(web::http::header_names::location, make_registration_api_resource_location(*resource));
-                }
-                else if (!valid_super_id_type)
-                {
-                    set_error_reply(res, status_codes::BadRequest, U("Bad Request; ") + details::make_valid_super_id_type_error(super_id_type, nmos::get_super_resource(*resource)));
-                    res.headers().add(web::http::header_names::location, make_registration_api_resource_location(*resource));
-                }
-                else if (!valid_version)
-                {
-                    set_error_reply(res, status_codes::BadRequest, U("Bad Request; ") + details::make_valid_version_error(nmos::fields::version(data), nmos::fields::version(resource->data)));
-                    res.headers().add(web::http::header_names::location, make_registration_api_resource_location(*resource));
-                }
-                else if (!valid_super_type)
-                {
-                    // the difference here is that it's the super-resource that conflicts
-                    set_error_reply(res, status_codes::BadRequest, U("Bad Request; ") + details::make_valid_super_type_error(super_id_type, super_resource->type));
+                return true;
+            });
+        });
 
-                    // since the conflict is with the super-resource, a single HTTP DELETE cannot be enough to resolve the issue in this case...
-                    // (assert !no_super_resource, i.e. resources.end() != super_resource in all these cases)
-                    res.headers().add(web::http::header_names::location, make_registration_api_resource_location(*super_resource));
-                }
-                else if (!valid_super_api_version)
-                {
-                    // another super-resource conflict
-                    set_error_reply(res, status_codes::BadRequest, U("Bad Request; ") + details::make_valid_super_api_version_error(version, super_resource->version));
-                    res.headers().add(web::http::header_names::location, make_registration_api_resource_location(*super_resource));
-                }
-                else if (!valid_super_resource)
-                {
-                    set_error_reply(res, status_codes::BadRequest, U("Bad Request; ") + details::make_valid_super_resource_error(super_id_type));
-                }
-                else
+        // experimental extension, to enable a process with many nodes, or a proxy, to perform their heartbeats in one request
+        // the request body is an array of node ids, and the response body is an array of the status code and health (or error information) for each
+        registration_api.support(U("/bulk/health/nodes/?"), methods::POST, [&model, scheduler, &gate_](http_request req, http_response res, const string_t&, const route_parameters& parameters)
+        {
+            nmos::api_gate gate(gate_, req, parameters);
+
+            return details::extract_json(req, gate, model.get_settings_snapshot()->max_request_body_size).then([&model, scheduler, req, res, parameters, gate](value body) mutable
+            {
+                const nmos::api_version version = nmos::parse_api_version(parameters.at(nmos::patterns::version.name));
+
+                auto& ids = body.as_array();
+
+                slog::log<slog::severities::too_much_info>(gate, SLOG_FLF) << "Bulk heartbeat received for " << ids.size() << " nodes";
+
+                // since health is mutable, no need to get an exclusive/write lock even to handle a POST request
+                auto lock = details::make_scheduled_lock(scheduler.get(), details::health_registration_priority, [&model] { return model.read_lock(); });
+                auto& resources = model.registry_resources;
+
+                std::vector<value> results;
+                results.reserve(ids.size());
+
+                for (const auto& id : ids)
                 {
-                    set_reply(res, status_codes::BadRequest);
+                    const auto response = details::handle_node_heartbeat(resources, version, id.as_string(), gate);
+                    if (status_codes::OK == response.code) ++model.metrics.heartbeats;
+
+                    // make a bulk response item from the health response body, or the standard NMOS error response
+                    auto result = response.body;
+                    result[nmos::fields::id] = id;
+                    result[U("code")] = response.code;
+                    results.push_back(result);
                 }
 
+                set_reply(res, status_codes::OK, web::json::value_from_elements(results));
+
                 return true;
             });
         });
 
-        registration_api.support(U("/health/nodes/") + nmos::patterns::resourceId.pattern + U("/?"), [&model, &gate_](http_request req, http_response res, const string_t&, const route_parameters& parameters)
+        // experimental extension, to enable peer registries to merge the health of the nodes they have in common (see nmos/registry_replication.h)
+        // the response body is an array of the id and health of each node
+        registration_api.support(U("/bulk/health/nodes/?"), methods::GET, [&model](http_request req, http_response res, const string_t&, const route_parameters&)
+        {
+            auto lock = model.read_lock();
+            auto& resources = model.registry_resources;
+
+            std::vector<value> results;
+
+            auto& by_type = resources.get<tags::type>();
+            const auto nodes = by_type.equal_range(nmos::details::has_data(nmos::types::node));
+            for (auto node = nodes.first; nodes.second != node; ++node)
+            {
+                const nmos::health health = node->health;
+                if (nmos::health_forever == health) continue;
+
+                auto result = make_health_response_body(health);
+                result[nmos::fields::id] = value::string(node->id);
+                results.push_back(result);
+            }
+
+            set_reply(res, status_codes::OK, web::json::value_from_elements(results));
+
+            return pplx::task_from_result(true);
+        });
+
+        registration_api.support(U("/health/nodes/") + nmos::patterns::resourceId.pattern + U("/?"), [&model, scheduler, &gate_](http_request req, http_response res, const string_t&, const route_parameters& parameters)
         {
             nmos::api_gate gate(gate_, req, parameters);
 
             // since health is mutable, no need to get an exclusive/write lock even to handle a POST request
-            auto lock = model.read_lock();
+            auto lock = details::make_scheduled_lock(scheduler.get(), details::health_registration_priority, [&model] { return model.read_lock(); });
             auto& resources = model.registry_resources;
 
             const nmos::api_version version = nmos::parse_api_version(parameters.at(nmos::patterns::version.name));
@@ -498,9 +1180,11 @@ namespace nmos
                     if (methods::POST == req.method())
                     {
                         slog::log<slog::severities::too_much_info>(gate, SLOG_FLF) << "Heartbeat received for node: " << resourceId;
+                        NMOS_CPP_TRACE(heartbeat, resourceId.c_str());
 
                         const auto health = nmos::health_now();
                         set_resource_health(resources, resource->id, health);
+                        ++model.metrics.heartbeats;
 
                         set_reply(res, web::http::status_codes::OK, make_health_response_body(health));
                     }
@@ -572,13 +1256,18 @@ namespace nmos
             return pplx::task_from_result(true);
         });
 
-        registration_api.support(U("/resource/") + nmos::patterns::resourceType.pattern + U("/") + nmos::patterns::resourceId.pattern + U("/?"), methods::DEL, [&model, &gate_](http_request req, http_response res, const string_t&, const route_parameters& parameters)
+        registration_api.support(U("/resource/") + nmos::patterns::resourceType.pattern + U("/") + nmos::patterns::resourceId.pattern + U("/?"), methods::DEL, [&model, scheduler, &gate_](http_request req, http_response res, const string_t&, const route_parameters& parameters)
         {
             nmos::api_gate gate(gate_, req, parameters);
 
+            const auto ingress = std::chrono::steady_clock::now();
+
+            const auto priority = details::get_registration_priority(nmos::type_from_resourceType(parameters.at(nmos::patterns::resourceType.name)));
+
             // could start out as a shared/read lock, only upgraded to an exclusive/write lock when the resource is actually deleted from resources
-            auto lock = model.write_lock();
+            auto lock = details::make_scheduled_lock(scheduler.get(), priority, [&model] { return model.write_lock(); });
             auto& resources = model.registry_resources;
+            const nmos::event_ingress_guard ingress_guard(resources.event_queues, ingress);
 
             const nmos::api_version version = nmos::parse_api_version(parameters.at(nmos::patterns::version.name));
             const string_t resourceType = parameters.at(nmos::patterns::resourceType.name);
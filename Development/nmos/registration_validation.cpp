@@ -0,0 +1,142 @@
+#include "nmos/registration_validation.h"
+
+#include <algorithm>
+#include <boost/asio/ip/address.hpp>
+
+namespace nmos
+{
+    namespace experimental
+    {
+        namespace details
+        {
+            // parse an address, returning false if it is invalid
+            static bool parse_address(const std::string& address, std::array<unsigned char, 16>& bytes, bool& v4)
+            {
+                boost::system::error_code error;
+                const auto parsed = boost::asio::ip::make_address(address, error);
+                if (error) return false;
+
+                v4 = parsed.is_v4();
+                const auto v6 = v4 ? boost::asio::ip::make_address_v6(boost::asio::ip::v4_mapped, parsed.to_v4()) : parsed.to_v6();
+                const auto v6_bytes = v6.to_bytes();
+                std::copy(v6_bytes.begin(), v6_bytes.end(), bytes.begin());
+                return true;
+            }
+        }
+
+        // parse an address range, throwing web::json::json_exception if it is invalid
+        address_range parse_address_range(const utility::string_t& range)
+        {
+            const auto range_ = utility::us2s(range);
+            const auto slash = range_.find('/');
+
+            address_range result;
+            bool v4 = false;
+            if (!details::parse_address(range_.substr(0, slash), result.address, v4))
+            {
+                throw web::json::json_exception("invalid address range");
+            }
+
+            // the prefix length of an IPv4 range is relative to the IPv4-mapped prefix
+            const unsigned int mapped = v4 ? 96 : 0;
+            result.prefix_length = 128;
+            if (std::string::npos != slash)
+            {
+                const auto prefix_length = range_.substr(slash + 1);
+                if (prefix_length.empty() || prefix_length.size() > 3 || !std::all_of(prefix_length.begin(), prefix_length.end(), [](char c) { return '0' <= c && c <= '9'; }))
+                {
+                    throw web::json::json_exception("invalid address range");
+                }
+                result.prefix_length = mapped + (unsigned int)std::stoi(prefix_length);
+                if (128 < result.prefix_length)
+                {
+                    throw web::json::json_exception("invalid address range");
+                }
+            }
+            return result;
+        }
+
+        // determine whether the specified address, which may be an IPv4-mapped IPv6 address, is in the range
+        bool in_address_range(const address_range& range, const utility::string_t& address)
+        {
+            std::array<unsigned char, 16> bytes;
+            bool v4 = false;
+            if (!details::parse_address(utility::us2s(address), bytes, v4)) return false;
+
+            const auto whole = range.prefix_length / 8;
+            if (!std::equal(range.address.begin(), range.address.begin() + whole, bytes.begin())) return false;
+            const auto bits = range.prefix_length % 8;
+            if (0 == bits) return true;
+            const unsigned char mask = (unsigned char)(0xFF << (8 - bits));
+            return (range.address[whole] & mask) == (bytes[whole] & mask);
+        }
+
+        registration_validation_policies::registration_validation_policies(const web::json::value& policies_)
+        {
+            for (const auto& policy_ : policies_.as_array())
+            {
+                std::unique_ptr<policy> parsed(new policy);
+                if (policy_.has_field(U("addresses")))
+                {
+                    for (const auto& range : policy_.at(U("addresses")).as_array())
+                    {
+                        parsed->addresses.push_back(parse_address_range(range.as_string()));
+                    }
+                }
+                if (policy_.has_field(U("node_ids")))
+                {
+                    for (const auto& node_id : policy_.at(U("node_ids")).as_array())
+                    {
+                        parsed->node_ids.insert(node_id.as_string());
+                    }
+                }
+                parsed->interval = policy_.has_field(U("validation_interval")) ? (std::uint64_t)(std::max)(0, policy_.at(U("validation_interval")).as_integer()) : 0;
+                parsed->count = 0;
+                policies.push_back(std::move(parsed));
+            }
+        }
+
+        // determine whether the request from the specified client address should be validated, where the node id of the resource being registered
+        // is only determined, which may require looking up its device, if a policy depends on it
+        bool registration_validation_policies::validate(const utility::string_t& address, const std::function<nmos::id()>& node_id)
+        {
+            bool node_id_found = false;
+            nmos::id node_id_;
+
+            for (auto& policy : policies)
+            {
+                // each criterion that is specified must match
+                if (!policy->addresses.empty() && policy->addresses.end() == std::find_if(policy->addresses.begin(), policy->addresses.end(), [&](const address_range& range)
+                {
+                    return in_address_range(range, address);
+                }))
+                {
+                    continue;
+                }
+                if (!policy->node_ids.empty())
+                {
+                    if (!node_id_found)
+                    {
+                        node_id_ = node_id();
+                        node_id_found = true;
+                    }
+                    if (policy->node_ids.end() == policy->node_ids.find(node_id_)) continue;
+                }
+
+                if (0 == policy->interval) return false;
+                return 0 == policy->count++ % policy->interval;
+            }
+
+            // untrusted clients always have full validation
+            return true;
+        }
+
+        // construct the registration validation policies based on settings, or return nullptr if every request is to be validated
+        std::shared_ptr<registration_validation_policies> make_registration_validation_policies(const nmos::settings& settings)
+        {
+            const auto& policies = nmos::experimental::fields::registration_validation_policies(settings);
+            if (!policies.is_array() || 0 == policies.size()) return{};
+            return std::make_shared<registration_validation_policies>(policies);
+        }
+    }
+}
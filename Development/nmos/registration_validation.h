@@ -0,0 +1,65 @@
+#ifndef NMOS_REGISTRATION_VALIDATION_H
+#define NMOS_REGISTRATION_VALIDATION_H
+
+#include <array>
+#include <atomic>
+#include <functional>
+#include <memory>
+#include <set>
+#include <vector>
+#include "nmos/id.h"
+#include "nmos/settings.h"
+
+// This is an experimental extension to skip, or only sample, the schema validation of the registration requests from trusted clients
+// See nmos::experimental::fields::registration_validation_policies
+namespace nmos
+{
+    namespace experimental
+    {
+        // an IPv4 or IPv6 address range, in CIDR notation, e.g. "192.0.2.0/24" or "2001:db8::/32", or a single address
+        struct address_range
+        {
+            // IPv4 addresses are held as IPv4-mapped IPv6 addresses, so that both can be matched the same way
+            std::array<unsigned char, 16> address;
+            unsigned int prefix_length;
+        };
+
+        // parse an address range, throwing web::json::json_exception if it is invalid
+        address_range parse_address_range(const utility::string_t& range);
+
+        // determine whether the specified address, which may be an IPv4-mapped IPv6 address, is in the range
+        bool in_address_range(const address_range& range, const utility::string_t& address);
+
+        // the policies for the schema validation of registration requests, of which the first that matches a request determines whether it is validated
+        class registration_validation_policies
+        {
+        public:
+            // the policies are an array of objects, see nmos::experimental::fields::registration_validation_policies
+            explicit registration_validation_policies(const web::json::value& policies);
+
+            // determine whether the request from the specified client address should be validated, where the node id of the resource being registered
+            // is only determined, which may require looking up its device, if a policy depends on it
+            bool validate(const utility::string_t& address, const std::function<nmos::id()>& node_id);
+
+            registration_validation_policies(const registration_validation_policies&) = delete;
+            registration_validation_policies& operator=(const registration_validation_policies&) = delete;
+
+        private:
+            struct policy
+            {
+                std::vector<address_range> addresses;
+                std::set<nmos::id> node_ids;
+                // 0 to skip validation, or N to validate one in every N requests
+                std::uint64_t interval;
+                std::atomic<std::uint64_t> count;
+            };
+
+            std::vector<std::unique_ptr<policy>> policies;
+        };
+
+        // construct the registration validation policies based on settings, or return nullptr if every request is to be validated
+        std::shared_ptr<registration_validation_policies> make_registration_validation_policies(const nmos::settings& settings);
+    }
+}
+
+#endif
@@ -0,0 +1,434 @@
+#include "nmos/registry_federation.h"
+
+#include <mutex>
+#include "cpprest/http_client.h"
+#include "nmos/api_utils.h"
+#include "nmos/client_utils.h"
+#include "nmos/json_fields.h"
+#include "nmos/model.h"
+#include "nmos/slog.h"
+
+namespace nmos
+{
+    namespace experimental
+    {
+        namespace details
+        {
+            // FNV-1a, followed by the splitmix64 finalizer, since FNV-1a alone leaves similar strings, like the points of one shard, close together on the ring
+            static std::uint64_t ring_hash(const std::string& s)
+            {
+                std::uint64_t h = 14695981039346656037ULL;
+                for (const auto c : s)
+                {
+                    h ^= (unsigned char)c;
+                    h *= 1099511628211ULL;
+                }
+                h ^= h >> 30;
+                h *= 0xbf58476d1ce4e5b9ULL;
+                h ^= h >> 27;
+                h *= 0x94d049bb133111ebULL;
+                h ^= h >> 31;
+                return h;
+            }
+
+            shard_ring::shard_ring(const std::vector<utility::string_t>& shard_uris, std::size_t points_per_shard)
+                : shards(shard_uris.size())
+            {
+                for (std::size_t index = 0; index < shard_uris.size(); ++index)
+                {
+                    const auto uri = utility::us2s(shard_uris[index]);
+                    for (std::size_t point = 0; point < points_per_shard; ++point)
+                    {
+                        points.insert({ ring_hash(uri + "#" + std::to_string(point)), index });
+                    }
+                }
+            }
+
+            std::size_t shard_ring::find(const nmos::id& node_id) const
+            {
+                // the node is owned by the first point clockwise from its hash
+                auto found = points.lower_bound(ring_hash(utility::us2s(node_id)));
+                if (points.end() == found) found = points.begin();
+                return found->second;
+            }
+
+            // the shard registries of the Registration API front end
+            struct registration_federation
+            {
+                registration_federation(const std::vector<utility::string_t>& registration_uris, const web::http::client::http_client_config& config)
+                    : ring(registration_uris)
+                {
+                    for (const auto& registration_uri : registration_uris)
+                    {
+                        // requests are forwarded with their own path, including the API version, so only the authority of the configured base URL is used
+                        const web::uri uri(registration_uri);
+                        clients.push_back(web::http::client::http_client(web::uri_builder().set_scheme(uri.scheme()).set_host(uri.host()).set_port(uri.port()).to_uri(), config));
+                    }
+                }
+
+                const shard_ring ring;
+                std::vector<web::http::client::http_client> clients;
+
+                // the node which owns each resource registered via this front end, so that its sub-resources, and requests to delete it, are forwarded to the same shard
+                std::mutex mutex;
+                std::map<nmos::id, nmos::id> owners;
+            };
+
+            // find the node which owns the resource with the specified id from the resources replicated from the shards, e.g. after a restart of the front end
+            static nmos::id find_replicated_owner(const nmos::resources& resources, nmos::id id)
+            {
+                // walk up from the resource to its node, e.g. from a v1.0 flow, to its source, to its device, to its node
+                for (;;)
+                {
+                    auto found = nmos::find_resource(resources, id);
+                    if (resources.end() == found || !found->has_data()) return{};
+                    if (nmos::types::node == found->type) return id;
+                    if (nmos::types::device == found->type) return nmos::fields::node_id(found->data);
+                    id = found->data.has_field(nmos::fields::device_id) ? nmos::fields::device_id(found->data) : nmos::fields::source_id(found->data);
+                }
+            }
+
+            // find the node which owns the resource with the specified id, or return an empty id if it is unknown
+            static nmos::id find_owner(registration_federation& federation, nmos::registry_model& model, const nmos::id& id)
+            {
+                {
+                    std::lock_guard<std::mutex> lock(federation.mutex);
+                    auto found = federation.owners.find(id);
+                    if (federation.owners.end() != found) return found->second;
+                }
+
+                auto lock = model.read_lock();
+                return find_replicated_owner(model.registry_resources, id);
+            }
+
+            // find the node which owns the resource in a registration request body, looking first at the owners of the resources earlier in the same request, if any
+            static nmos::id find_registration_owner(registration_federation& federation, nmos::registry_model& model, const web::json::value& registration, const std::map<nmos::id, nmos::id>& pending = {})
+            {
+                const nmos::type type{ nmos::fields::type(registration) };
+                const auto& data = nmos::fields::data(registration);
+                if (nmos::types::node == type) return nmos::fields::id(data);
+                if (nmos::types::device == type) return nmos::fields::node_id(data);
+
+                // sources, senders, receivers and flows (since v1.1) have a device_id, but v1.0 flows only have a source_id
+                const auto super_id = data.has_field(nmos::fields::device_id) ? nmos::fields::device_id(data) : nmos::fields::source_id(data);
+                auto found = pending.find(super_id);
+                return pending.end() != found ? found->second : find_owner(federation, model, super_id);
+            }
+
+            static void insert_owners(registration_federation& federation, const std::map<nmos::id, nmos::id>& owners)
+            {
+                std::lock_guard<std::mutex> lock(federation.mutex);
+                for (const auto& owner : owners)
+                {
+                    federation.owners[owner.first] = owner.second;
+                }
+            }
+
+            // forward the request to a shard, with the specified body, if any
+            static pplx::task<web::http::http_response> forward_request(web::http::client::http_client& client, const web::http::http_request& req, const web::json::value& body = {})
+            {
+                web::http::http_request forwarded(req.method());
+                forwarded.set_request_uri(req.request_uri().resource());
+                if (!body.is_null()) forwarded.set_body(body);
+                return client.request(forwarded);
+            }
+
+            // relay the response from a shard, or reply with 502 (Bad Gateway) if the shard couldn't be reached
+            static pplx::task<bool> relay_response(pplx::task<web::http::http_response> response_task, web::http::http_response res)
+            {
+                return response_task.then([res](web::http::http_response response) mutable
+                {
+                    return response.extract_vector().then([res, response](std::vector<unsigned char> body) mutable
+                    {
+                        res.set_status_code(response.status_code());
+                        if (!body.empty())
+                        {
+                            res.set_body(std::move(body));
+                            res.headers().set_content_type(response.headers().content_type());
+                        }
+                        // the Location header from the shard is a path, so is equally valid for the front end
+                        const auto location = response.headers().find(web::http::header_names::location);
+                        if (response.headers().end() != location) res.headers().add(web::http::header_names::location, location->second);
+                        return true;
+                    });
+                }).then([res](pplx::task<bool> finally) mutable
+                {
+                    try
+                    {
+                        return finally.get();
+                    }
+                    catch (const web::http::http_exception& e)
+                    {
+                        nmos::set_error_reply(res, web::http::status_codes::BadGateway, e);
+                        return true;
+                    }
+                });
+            }
+
+            // forward the items of a bulk request to the shards which own them, i.e. the item at each index to the shard at the same index in item_shards,
+            // and merge the response items of all the shards into the results, in the order of the request
+            static pplx::task<void> forward_bulk_request(std::shared_ptr<registration_federation> federation, const web::http::http_request& req, const web::json::value& items, const std::vector<std::size_t>& item_shards, const std::vector<nmos::id>& item_ids, std::shared_ptr<std::vector<web::json::value>> results)
+            {
+                std::vector<std::vector<std::size_t>> shard_items(federation->clients.size());
+                for (std::size_t index = 0; index < item_shards.size(); ++index)
+                {
+                    if (federation->clients.size() > item_shards[index]) shard_items[item_shards[index]].push_back(index);
+                }
+
+                std::vector<pplx::task<void>> tasks;
+                for (std::size_t shard = 0; shard < shard_items.size(); ++shard)
+                {
+                    const auto& indexes = shard_items[shard];
+                    if (indexes.empty()) continue;
+
+                    auto body = web::json::value::array();
+                    for (const auto index : indexes)
+                    {
+                        web::json::push_back(body, items.at(index));
+                    }
+
+                    tasks.push_back(forward_request(federation->clients[shard], req, body).then([](web::http::http_response response)
+                    {
+                        if (web::http::status_codes::OK != response.status_code())
+                        {
+                            throw web::http::http_exception(U("Unexpected response from shard registry [") + utility::ostringstreamed(response.status_code()) + U("]"));
+                        }
+                        return response.extract_json();
+                    }).then([indexes, item_ids, results](pplx::task<web::json::value> shard_results)
+                    {
+                        try
+                        {
+                            const auto body = shard_results.get();
+                            const auto& shard_results_array = body.as_array();
+                            for (std::size_t i = 0; i < indexes.size() && i < shard_results_array.size(); ++i)
+                            {
+                                (*results)[indexes[i]] = shard_results_array.at(i);
+                            }
+                        }
+                        catch (const std::exception& e)
+                        {
+                            for (const auto index : indexes)
+                            {
+                                auto result = nmos::make_error_response_body(web::http::status_codes::BadGateway, U("Bad Gateway; ") + utility::s2us(e.what()));
+                                result[nmos::fields::id] = web::json::value::string(item_ids[index]);
+                                (*results)[index] = result;
+                            }
+                        }
+                    }));
+                }
+
+                return pplx::when_all(tasks.begin(), tasks.end());
+            }
+        }
+
+        web::http::experimental::listener::api_router make_registration_federation_api(nmos::registry_model& model, slog::base_gate& gate_)
+        {
+            using namespace web::http::experimental::listener::api_router_using_declarations;
+
+            const auto federation = with_read_lock(model.mutex, [&model]
+            {
+                std::vector<utility::string_t> registration_uris;
+                for (const auto& shard : nmos::experimental::fields::registry_shards(model.settings).as_array())
+                {
+                    registration_uris.push_back(shard.at(U("registration")).as_string());
+                }
+                return std::make_shared<details::registration_federation>(registration_uris, nmos::make_http_client_config(model.settings));
+            });
+
+            api_router federation_api;
+
+            if (federation->clients.empty()) return federation_api;
+
+            // the sub-routes, and the API version check, are the same in every shard, so these requests are simply forwarded to the first one
+            auto forward_to_first_shard = [federation](http_request req, http_response res, const string_t&, const route_parameters&)
+            {
+                return details::relay_response(details::forward_request(federation->clients.front(), req), res);
+            };
+
+            const auto version_path = U("/x-nmos/") + nmos::patterns::registration_api.pattern + U("/") + nmos::patterns::version.pattern;
+
+            federation_api.support(U("/?"), methods::GET, forward_to_first_shard);
+            federation_api.support(U("/x-nmos/?"), methods::GET, forward_to_first_shard);
+            federation_api.support(U("/x-nmos/") + nmos::patterns::registration_api.pattern + U("/?"), methods::GET, forward_to_first_shard);
+            federation_api.support(version_path + U("/?"), methods::GET, forward_to_first_shard);
+            federation_api.support(version_path + U("/bulk/?"), methods::GET, forward_to_first_shard);
+            federation_api.support(version_path + U("/bulk/health/?"), methods::GET, forward_to_first_shard);
+
+            federation_api.support(version_path + U("/resource/?"), methods::POST, [&model, federation, &gate_](http_request req, http_response res, const string_t&, const route_parameters& parameters)
+            {
+                nmos::api_gate gate(gate_, req, parameters);
+
+                return nmos::details::extract_json(req, gate, model.get_settings_snapshot()->max_request_body_size).then([&model, federation, req, res, gate](value body) mutable
+                {
+                    const auto owner = details::find_registration_owner(*federation, model, body);
+                    if (owner.empty())
+                    {
+                        // like the Registration API itself, reject the registration of a resource whose parent is unknown
+                        set_error_reply(res, status_codes::BadRequest, U("Bad Request; request for registration on unknown parent"));
+                        return pplx::task_from_result(true);
+                    }
+
+                    const auto shard = federation->ring.find(owner);
+                    slog::log<slog::severities::too_much_info>(gate, SLOG_FLF) << "Forwarding registration of " << nmos::fields::type(body) << " " << nmos::fields::id(nmos::fields::data(body)) << " to shard " << shard;
+
+                    const auto id = nmos::fields::id(nmos::fields::data(body));
+                    return details::relay_response(details::forward_request(federation->clients[shard], req, body), res).then([federation, res, id, owner](bool continue_matching)
+                    {
+                        if (web::http::is_success_status_code(res.status_code())) details::insert_owners(*federation, { { id, owner } });
+                        return continue_matching;
+                    });
+                });
+            });
+
+            federation_api.support(version_path + U("/bulk/resource/?"), methods::POST, [&model, federation, &gate_](http_request req, http_response res, const string_t&, const route_parameters& parameters)
+            {
+                nmos::api_gate gate(gate_, req, parameters);
+
+                return nmos::details::extract_json(req, gate, model.get_settings_snapshot()->max_request_body_size).then([&model, federation, req, res, gate](value body) mutable
+                {
+                    const auto& registrations = body.as_array();
+
+                    // the sub-resources in the request may belong to nodes registered earlier in the same request
+                    std::map<nmos::id, nmos::id> pending;
+                    std::vector<std::size_t> item_shards;
+                    std::vector<nmos::id> item_ids;
+                    auto results = std::make_shared<std::vector<value>>(registrations.size());
+                    for (std::size_t index = 0; index < registrations.size(); ++index)
+                    {
+                        const auto& registration = registrations.at(index);
+                        const auto& id = nmos::fields::id(nmos::fields::data(registration));
+                        const auto owner = details::find_registration_owner(*federation, model, registration, pending);
+                        item_ids.push_back(id);
+                        if (owner.empty())
+                        {
+                            auto result = nmos::make_error_response_body(status_codes::BadRequest, U("Bad Request; request for registration on unknown parent"));
+                            result[nmos::fields::id] = value::string(id);
+                            (*results)[index] = result;
+                            item_shards.push_back(federation->clients.size());
+                            continue;
+                        }
+                        pending[id] = owner;
+                        item_shards.push_back(federation->ring.find(owner));
+                    }
+
+                    slog::log<slog::severities::info>(gate, SLOG_FLF) << "Forwarding bulk registration of " << registrations.size() << " resources";
+
+                    return details::forward_bulk_request(federation, req, body, item_shards, item_ids, results).then([federation, res, results, item_ids, pending]() mutable
+                    {
+                        std::map<nmos::id, nmos::id> owners;
+                        for (std::size_t index = 0; index < results->size(); ++index)
+                        {
+                            const auto& result = (*results)[index];
+                            if (result.has_field(U("code")) && web::http::is_success_status_code((web::http::status_code)result.at(U("code")).as_integer()))
+                            {
+                                owners[item_ids[index]] = pending[item_ids[index]];
+                            }
+                        }
+                        details::insert_owners(*federation, owners);
+
+                        set_reply(res, status_codes::OK, web::json::value_from_elements(*results));
+                        return true;
+                    });
+                });
+            });
+
+            federation_api.support(version_path + U("/bulk/health/nodes/?"), methods::POST, [&model, federation, &gate_](http_request req, http_response res, const string_t&, const route_parameters& parameters)
+            {
+                nmos::api_gate gate(gate_, req, parameters);
+
+                return nmos::details::extract_json(req, gate, model.get_settings_snapshot()->max_request_body_size).then([federation, req, res](value body) mutable
+                {
+                    std::vector<std::size_t> item_shards;
+                    std::vector<nmos::id> item_ids;
+                    for (const auto& id : body.as_array())
+                    {
+                        item_ids.push_back(id.as_string());
+                        item_shards.push_back(federation->ring.find(id.as_string()));
+                    }
+                    auto results = std::make_shared<std::vector<value>>(item_ids.size());
+
+                    return details::forward_bulk_request(federation, req, body, item_shards, item_ids, results).then([res, results]() mutable
+                    {
+                        set_reply(res, status_codes::OK, web::json::value_from_elements(*results));
+                        return true;
+                    });
+                });
+            });
+
+            // the health of the nodes of every shard, e.g. for a peer of the front end
+            federation_api.support(version_path + U("/bulk/health/nodes/?"), methods::GET, [federation](http_request req, http_response res, const string_t&, const route_parameters&)
+            {
+                std::vector<pplx::task<value>> tasks;
+                for (auto& client : federation->clients)
+                {
+                    tasks.push_back(details::forward_request(client, req).then([](web::http::http_response response)
+                    {
+                        if (web::http::status_codes::OK != response.status_code())
+                        {
+                            throw web::http::http_exception(U("Unexpected response from shard registry [") + utility::ostringstreamed(response.status_code()) + U("]"));
+                        }
+                        return response.extract_json();
+                    }));
+                }
+
+                return pplx::when_all(tasks.begin(), tasks.end()).then([res](pplx::task<std::vector<value>> shard_results) mutable
+                {
+                    try
+                    {
+                        auto results = value::array();
+                        for (const auto& healths : shard_results.get())
+                        {
+                            for (const auto& health : healths.as_array())
+                            {
+                                web::json::push_back(results, health);
+                            }
+                        }
+                        set_reply(res, status_codes::OK, results);
+                    }
+                    catch (const web::http::http_exception& e)
+                    {
+                        set_error_reply(res, status_codes::BadGateway, e);
+                    }
+                    return true;
+                });
+            });
+
+            // heartbeats are forwarded to the shard which owns the node, with no need to look up the owner
+            federation_api.support(version_path + U("/health/nodes/") + nmos::patterns::resourceId.pattern + U("/?"), [federation](http_request req, http_response res, const string_t&, const route_parameters& parameters)
+            {
+                const auto shard = federation->ring.find(parameters.at(nmos::patterns::resourceId.name));
+                return details::relay_response(details::forward_request(federation->clients[shard], req), res);
+            });
+
+            federation_api.support(version_path + U("/resource/") + nmos::patterns::resourceType.pattern + U("/") + nmos::patterns::resourceId.pattern + U("/?"), [&model, federation](http_request req, http_response res, const string_t&, const route_parameters& parameters)
+            {
+                if (methods::GET != req.method() && methods::DEL != req.method())
+                {
+                    set_reply(res, status_codes::MethodNotAllowed);
+                    return pplx::task_from_result(true);
+                }
+
+                const auto& id = parameters.at(nmos::patterns::resourceId.name);
+                const auto owner = details::find_owner(*federation, model, id);
+                if (owner.empty())
+                {
+                    set_error_reply(res, status_codes::NotFound);
+                    return pplx::task_from_result(true);
+                }
+
+                const bool deletion = methods::DEL == req.method();
+                return details::relay_response(details::forward_request(federation->clients[federation->ring.find(owner)], req), res).then([federation, res, id, deletion](bool continue_matching)
+                {
+                    if (deletion && web::http::is_success_status_code(res.status_code()))
+                    {
+                        std::lock_guard<std::mutex> lock(federation->mutex);
+                        federation->owners.erase(id);
+                    }
+                    return continue_matching;
+                });
+            });
+
+            return federation_api;
+        }
+    }
+}
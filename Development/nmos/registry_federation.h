@@ -0,0 +1,51 @@
+#ifndef NMOS_REGISTRY_FEDERATION_H
+#define NMOS_REGISTRY_FEDERATION_H
+
+#include <cstdint>
+#include <map>
+#include <vector>
+#include "cpprest/api_router.h"
+#include "nmos/id.h"
+
+namespace slog
+{
+    class base_gate;
+}
+
+// This is an experimental extension to spread the nodes across a number of shard registries, each of which owns the nodes in its partition of a consistent-hash ring,
+// behind a front end which forwards each Registration API request to the shard that owns the node, and serves the Query API from the resources of every shard
+// See nmos::experimental::fields::registry_shards
+namespace nmos
+{
+    struct registry_model;
+
+    namespace experimental
+    {
+        // the Registration API of the front end of a federated registry, which forwards each request to the shard registry that owns the node,
+        // splitting bulk requests between the shards and merging their responses
+        web::http::experimental::listener::api_router make_registration_federation_api(nmos::registry_model& model, slog::base_gate& gate);
+
+        namespace details
+        {
+            // a consistent-hash ring of the shard registries, so that each node, and therefore all its sub-resources, is owned by one shard,
+            // and adding or removing a shard only moves the nodes in (about) 1/N of the ring
+            // the points of each shard are derived from its URL rather than its index, so every front end agrees whatever order the shards are listed in
+            class shard_ring
+            {
+            public:
+                explicit shard_ring(const std::vector<utility::string_t>& shards, std::size_t points_per_shard = 64);
+
+                // the index of the shard which owns the specified node
+                std::size_t find(const nmos::id& node_id) const;
+
+                std::size_t size() const { return shards; }
+
+            private:
+                std::map<std::uint64_t, std::size_t> points;
+                std::size_t shards;
+            };
+        }
+    }
+}
+
+#endif
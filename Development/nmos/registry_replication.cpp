@@ -0,0 +1,331 @@
+#include "nmos/registry_replication.h"
+
+#include <atomic>
+#include <memory>
+#include <set>
+#include "cpprest/http_client.h"
+#include "cpprest/ws_client.h"
+#include "nmos/client_utils.h"
+#include "nmos/model.h"
+#include "nmos/query_utils.h" // for nmos::fields::grain_data, etc.
+#include "nmos/slog.h"
+#include "nmos/thread_utils.h" // for reverse_lock_guard
+#include "nmos/version.h"
+
+namespace nmos
+{
+    namespace experimental
+    {
+        namespace details
+        {
+            bool apply_replicated_event(nmos::resources& resources, const nmos::api_version& version, const utility::string_t& topic, const web::json::value& event, bool primary)
+            {
+                const auto id_type = nmos::details::get_resource_event_resource(topic, event);
+
+                auto found = resources.find(id_type.first);
+                const bool extant = resources.end() != found && found->has_data();
+
+                if (!event.has_field(U("post")))
+                {
+                    // the resource was deleted or expired in the peer registry
+                    if (!extant) return false;
+
+                    // a newer version, e.g. of a node that has since re-registered with this registry, isn't erased
+                    if (!primary && event.has_field(U("pre")) && nmos::parse_version(nmos::fields::version(found->data)) > nmos::parse_version(nmos::fields::version(event.at(U("pre"))))) return false;
+
+                    return 0 != nmos::erase_resource(resources, id_type.first, false);
+                }
+
+                const auto& post = event.at(U("post"));
+
+                if (extant)
+                {
+                    if (primary ? post == found->data : nmos::parse_version(nmos::fields::version(post)) <= nmos::parse_version(nmos::fields::version(found->data))) return false;
+
+                    return nmos::modify_resource(resources, id_type.first, [&post](nmos::resource& resource)
+                    {
+                        resource.data = post;
+                    });
+                }
+
+                // the sub-resources may be inserted out-of-order, since each resource type has its own subscription
+                // the resources of a primary never expire in the replica, since the primary's events include their expiry
+                return nmos::insert_resource(resources, { version, id_type.second, post, primary }, true).second;
+            }
+
+            std::size_t merge_replicated_health(const nmos::resources& resources, const web::json::value& healths)
+            {
+                std::size_t count = 0;
+                for (const auto& node_health : healths.as_array())
+                {
+                    auto found = nmos::find_resource(resources, { nmos::fields::id(node_health), nmos::types::node });
+                    if (resources.end() == found || !found->has_data() || nmos::health_forever == found->health) continue;
+
+                    const auto health = utility::istringstreamed<nmos::health>(node_health.at(U("health")).as_string());
+                    if (found->health < health)
+                    {
+                        nmos::set_resource_health(resources, found->id, health);
+                        ++count;
+                    }
+                }
+                return count;
+            }
+
+            // the Query API websocket subscriptions to a peer registry, or to the primary registry of a query replica
+            struct registry_peer
+            {
+                registry_peer(const utility::string_t& query_uri, const utility::string_t& registration_uri)
+                    : query_uri(query_uri)
+                    , registration_uri(registration_uri)
+                    , version(nmos::parse_api_version(web::uri::split_path(web::uri(query_uri).path()).back()))
+                    , primary(registration_uri.empty())
+                    , connected(false)
+                    , generation(0)
+                {}
+
+                const utility::string_t query_uri;
+                const utility::string_t registration_uri;
+                const nmos::api_version version;
+                const bool primary;
+
+                std::vector<web::websockets::client::websocket_callback_client> websockets;
+
+                // cleared by the close handler of any of the current generation of websockets
+                std::atomic<bool> connected;
+                std::atomic<unsigned int> generation;
+
+                // for a primary, the ids of the replicated resources, those which haven't been seen since the connection was (re)established,
+                // and when the most recent 'sync' event was received, so that resources deleted while disconnected are erased once the sync is complete
+                // protected by the model mutex
+                std::set<nmos::id> replicated;
+                std::set<nmos::id> stale;
+                std::chrono::steady_clock::time_point sync_time;
+            };
+
+            // keep track of the resources replicated from a primary (lock the mutex before calling this)
+            static void track_replicated_event(registry_peer& peer, const utility::string_t& topic, const web::json::value& event)
+            {
+                const auto id = nmos::details::get_resource_event_resource(topic, event).first;
+                peer.stale.erase(id);
+                if (event.has_field(U("post")))
+                {
+                    peer.replicated.insert(id);
+                    if (event.has_field(U("pre")) && event.at(U("pre")) == event.at(U("post"))) peer.sync_time = std::chrono::steady_clock::now();
+                }
+                else
+                {
+                    peer.replicated.erase(id);
+                }
+            }
+
+            // erase the resources replicated from a primary that have not been seen since the connection was (re)established,
+            // once no 'sync' events have been received for the specified interval (lock the mutex before calling this)
+            static std::size_t erase_stale_resources(registry_peer& peer, nmos::resources& resources, std::chrono::steady_clock::duration interval)
+            {
+                if (peer.stale.empty() || std::chrono::steady_clock::now() < peer.sync_time + interval) return 0;
+
+                std::size_t count = 0;
+                for (const auto& id : peer.stale)
+                {
+                    count += nmos::erase_resource(resources, id, false);
+                    peer.replicated.erase(id);
+                }
+                peer.stale.clear();
+                return count;
+            }
+
+            static void disconnect(registry_peer& peer)
+            {
+                ++peer.generation;
+                peer.connected = false;
+
+                for (auto& websocket : peer.websockets)
+                {
+                    websocket.close().then([](pplx::task<void> finally)
+                    {
+                        try { finally.get(); } catch (const web::websockets::websocket_exception&) {}
+                    });
+                }
+                peer.websockets.clear();
+            }
+
+            // subscribe to every resource type in the peer registry, and apply the resource events to the registry resources
+            // the initial 'sync' events on each websocket mean the replicas converge whenever the connection is (re)established
+            static void connect(std::shared_ptr<registry_peer> peer, nmos::registry_model& model, const web::http::client::http_client_config& http_config, const web::websockets::client::websocket_client_config& websocket_config, slog::base_gate& gate)
+            {
+                web::http::client::http_client query_client(peer->query_uri, http_config);
+
+                const auto generation = peer->generation.load();
+
+                if (peer->primary)
+                {
+                    auto lock = model.write_lock();
+                    peer->stale = peer->replicated;
+                    peer->sync_time = std::chrono::steady_clock::now();
+                }
+
+                // a query replica uses one subscription to all the resources of the primary, i.e. with an empty resource path
+                const std::vector<utility::string_t> resource_paths = peer->primary
+                    ? std::vector<utility::string_t>{ utility::string_t{} }
+                    : std::vector<utility::string_t>{ U("/nodes"), U("/devices"), U("/sources"), U("/flows"), U("/senders"), U("/receivers") };
+
+                for (const auto& resource_path : resource_paths)
+                {
+                    const auto body = web::json::value_of(
+                    {
+                        { nmos::fields::max_update_rate_ms, 0 },
+                        { nmos::fields::resource_path, resource_path },
+                        { nmos::fields::params, web::json::value::object() },
+                        { nmos::fields::persist, false },
+                        { nmos::fields::secure, U("https") == query_client.base_uri().scheme() }
+                    });
+
+                    auto response = query_client.request(web::http::methods::POST, U("/subscriptions"), body).get();
+                    if (web::http::status_codes::Created != response.status_code() && web::http::status_codes::OK != response.status_code())
+                    {
+                        throw web::http::http_exception(U("Unexpected response for subscription [") + utility::ostringstreamed(response.status_code()) + U("]"));
+                    }
+                    const auto subscription = response.extract_json().get();
+
+                    web::websockets::client::websocket_callback_client websocket(websocket_config);
+                    websocket.set_message_handler([&model, &gate, peer](const web::websockets::client::websocket_incoming_message& message)
+                    {
+                        message.extract_string().then([&model, &gate, peer](pplx::task<std::string> message_task)
+                        {
+                            try
+                            {
+                                const auto message = web::json::value::parse(utility::s2us(message_task.get()));
+                                const auto& topic = nmos::fields::grain_topic(message);
+
+                                auto lock = model.write_lock();
+
+                                bool changed = false;
+                                for (const auto& event : nmos::fields::grain_data(message).as_array())
+                                {
+                                    changed = apply_replicated_event(model.registry_resources, peer->version, topic, event, peer->primary) || changed;
+                                    if (peer->primary) track_replicated_event(*peer, topic, event);
+                                }
+
+                                if (changed) model.notify();
+                            }
+                            catch (const std::exception& e)
+                            {
+                                slog::log<slog::severities::error>(gate, SLOG_FLF) << "Unexpected message from " << (peer->primary ? "primary" : "peer") << " registry: " << e.what();
+                            }
+                        });
+                    });
+                    websocket.set_close_handler([peer, generation](web::websockets::client::websocket_close_status, const utility::string_t&, const std::error_code&)
+                    {
+                        if (peer->generation == generation) peer->connected = false;
+                    });
+                    websocket.connect(nmos::fields::ws_href(subscription)).wait();
+
+                    peer->websockets.push_back(websocket);
+                }
+
+                peer->connected = true;
+            }
+        }
+
+        void registry_replication_thread(nmos::registry_model& model, slog::base_gate& gate_)
+        {
+            nmos::details::omanip_gate gate(gate_, nmos::categories::registry_replication);
+
+            auto lock = model.read_lock();
+
+            std::vector<std::shared_ptr<details::registry_peer>> peers;
+            for (const auto& peer : nmos::experimental::fields::registry_peers(model.settings).as_array())
+            {
+                peers.push_back(std::make_shared<details::registry_peer>(peer.at(U("query")).as_string(), peer.at(U("registration")).as_string()));
+            }
+            const auto primary = nmos::experimental::fields::registry_primary(model.settings);
+            if (!primary.empty())
+            {
+                peers.push_back(std::make_shared<details::registry_peer>(primary, utility::string_t{}));
+            }
+            // the front end of a federated registry is a query replica of every shard
+            for (const auto& shard : nmos::experimental::fields::registry_shards(model.settings).as_array())
+            {
+                peers.push_back(std::make_shared<details::registry_peer>(shard.at(U("query")).as_string(), utility::string_t{}));
+            }
+            if (peers.empty()) return;
+
+            const auto interval = std::chrono::seconds(nmos::experimental::fields::registry_replication_interval(model.settings));
+            const auto http_config = nmos::make_http_client_config(model.settings);
+            const auto websocket_config = nmos::make_websocket_client_config(model.settings);
+
+            bool shutdown = false;
+            while (!shutdown)
+            {
+                {
+                    // the requests are made without the lock
+                    nmos::details::reverse_lock_guard<nmos::read_lock> unlock{ lock };
+
+                    for (auto& peer : peers)
+                    {
+                        try
+                        {
+                            if (!peer->connected)
+                            {
+                                details::disconnect(*peer);
+
+                                slog::log<slog::severities::info>(gate, SLOG_FLF) << "Connecting to " << (peer->primary ? "primary" : "peer") << " registry: " << utility::us2s(peer->query_uri);
+                                details::connect(peer, model, http_config, websocket_config, gate_);
+                            }
+
+                            if (peer->primary)
+                            {
+                                auto stale_lock = model.write_lock();
+                                const auto erased = details::erase_stale_resources(*peer, model.registry_resources, interval);
+                                if (0 != erased)
+                                {
+                                    slog::log<slog::severities::info>(gate, SLOG_FLF) << "Erased " << erased << " resources no longer in the primary registry";
+                                    model.notify();
+                                }
+                                continue;
+                            }
+
+                            web::http::client::http_client registration_client(peer->registration_uri, http_config);
+                            auto response = registration_client.request(web::http::methods::GET, U("/bulk/health/nodes")).get();
+                            if (web::http::status_codes::OK == response.status_code())
+                            {
+                                const auto healths = response.extract_json().get();
+
+                                auto health_lock = model.read_lock();
+                                const auto merged = details::merge_replicated_health(model.registry_resources, healths);
+                                slog::log<slog::severities::too_much_info>(gate, SLOG_FLF) << "Merged the health of " << merged << " nodes from peer registry: " << utility::us2s(peer->registration_uri);
+                            }
+                            else
+                            {
+                                slog::log<slog::severities::error>(gate, SLOG_FLF) << "Unexpected response for node health from peer registry: " << utility::us2s(peer->registration_uri) << " [" << response.status_code() << "]";
+                            }
+                        }
+                        catch (const web::http::http_exception& e)
+                        {
+                            slog::log<slog::severities::error>(gate, SLOG_FLF) << "Peer registry HTTP error: " << e.what() << " [" << e.error_code() << "]";
+                            details::disconnect(*peer);
+                        }
+                        catch (const web::websockets::websocket_exception& e)
+                        {
+                            slog::log<slog::severities::error>(gate, SLOG_FLF) << "Peer registry WebSocket error: " << e.what() << " [" << e.error_code() << "]";
+                            details::disconnect(*peer);
+                        }
+                        catch (const web::json::json_exception& e)
+                        {
+                            slog::log<slog::severities::error>(gate, SLOG_FLF) << "Peer registry JSON error: " << e.what();
+                            details::disconnect(*peer);
+                        }
+                    }
+                }
+
+                shutdown = model.shutdown_condition.wait_for(lock, interval, [&] { return model.shutdown; });
+            }
+
+            nmos::details::reverse_lock_guard<nmos::read_lock> unlock{ lock };
+            for (auto& peer : peers)
+            {
+                details::disconnect(*peer);
+            }
+        }
+    }
+}
@@ -0,0 +1,42 @@
+#ifndef NMOS_REGISTRY_REPLICATION_H
+#define NMOS_REGISTRY_REPLICATION_H
+
+#include "nmos/resources.h"
+
+namespace slog
+{
+    class base_gate;
+}
+
+// This is an experimental extension to replicate the resources of peer registries, so that a registry can take over from a peer without the nodes re-registering,
+// or of a primary registry, so that the Query API load can be spread across read-only query replicas
+// See nmos::experimental::fields::registry_peers and nmos::experimental::fields::registry_primary
+namespace nmos
+{
+    struct registry_model;
+
+    namespace experimental
+    {
+        // subscribe to the resources of each peer registry (and the primary registry, if any) via its Query API, and apply the resource events to the registry resources,
+        // and periodically merge the health of the nodes from each peer via its Registration API, reconnecting when necessary,
+        // until the server is shut down
+        void registry_replication_thread(nmos::registry_model& model, slog::base_gate& gate);
+
+        namespace details
+        {
+            // apply a resource event from a peer's Query API websocket grain, if it is for a newer version of the resource than the current one
+            // and return whether the resources were changed; since the same or older versions are ignored, the events that each registry receives
+            // for the replicas of its own resources have no effect, so the replication doesn't loop
+            // events from a primary are applied whatever the version, and the resources are inserted so as never to expire, since the primary's events include their expiry
+            bool apply_replicated_event(nmos::resources& resources, const nmos::api_version& version, const utility::string_t& topic, const web::json::value& event, bool primary = false);
+
+            // merge the health of the nodes from a peer, i.e. the array of the id and health of each node, keeping the more recent health
+            // and return the number of nodes whose health was updated; since health is a timestamp, rather than refreshed by the replication,
+            // nodes which stop heartbeating expire at (about) the same time in every registry
+            // note, like set_resource_health, this only requires a shared/read lock on the resources
+            std::size_t merge_replicated_health(const nmos::resources& resources, const web::json::value& healths);
+        }
+    }
+}
+
+#endif
@@ -0,0 +1,338 @@
+#include "nmos/registry_snapshot.h"
+
+#include <algorithm>
+#include <cstdio>
+#include <fstream>
+#include "cpprest/json_utils.h" // for web::json::experimental::serialize_utf8
+#include "nmos/api_version.h"
+#include "nmos/model.h"
+#include "nmos/slog.h"
+#include "nmos/thread_utils.h" // for reverse_lock_guard
+
+namespace nmos
+{
+    namespace experimental
+    {
+        namespace details
+        {
+            // the header line identifies the format, in case it ever needs to change
+            const web::json::field_as_integer_or snapshot_format{ U("nmos_cpp_registry_snapshot"), 0 };
+            const web::json::field_as_value_or snapshot_journal_sequence{ U("journal_sequence"), 0 };
+
+            void write_snapshot(std::string& snapshot, const nmos::resources& resources, snapshot_cache& cache, nmos::health now)
+            {
+                // the journal sequence number is stable, since entries are only pushed with the exclusive/write lock
+                snapshot.append("{\"nmos_cpp_registry_snapshot\":1,\"journal_sequence\":");
+                snapshot.append(std::to_string(resources.journal ? resources.journal->sequence() : 0));
+                snapshot.append("}\n");
+
+                snapshot_cache next;
+                next.reserve(resources.size());
+
+                auto& by_type = resources.get<tags::type>();
+                for (const auto& type : nmos::types::all)
+                {
+                    // the grains track individual websocket connections, which don't survive a restart
+                    if (nmos::types::grain == type) continue;
+
+                    const auto typed = by_type.equal_range(nmos::details::has_data(type));
+                    for (auto resource = typed.first; typed.second != resource; ++resource)
+                    {
+                        auto found = cache.find(resource->id);
+                        auto& entry = next[resource->id];
+                        if (cache.end() != found && found->second.first == resource->updated)
+                        {
+                            entry = std::move(found->second);
+                        }
+                        else
+                        {
+                            entry.first = resource->updated;
+                            entry.second.clear();
+                            entry.second.append(",\"type\":");
+                            web::json::experimental::serialize_utf8(entry.second, web::json::value::string(resource->type.name));
+                            entry.second.append(",\"version\":");
+                            web::json::experimental::serialize_utf8(entry.second, web::json::value::string(nmos::make_api_version(resource->version)));
+                            entry.second.append(",\"data\":");
+                            web::json::experimental::serialize_utf8(entry.second, resource->data);
+                            entry.second.push_back('}');
+                        }
+
+                        // health is written as the age, i.e. the number of seconds since the most recent heartbeat, or null for resources which never expire
+                        const nmos::health health = resource->health;
+                        snapshot.append("{\"age\":");
+                        snapshot.append(nmos::health_forever != health ? std::to_string(now - health) : std::string("null"));
+                        snapshot.append(entry.second).push_back('\n');
+                    }
+                }
+
+                cache.swap(next);
+            }
+
+            std::size_t read_snapshot(nmos::resources& resources, std::istream& snapshot, slog::base_gate& gate, nmos::health now, std::uint64_t* journal_sequence)
+            {
+                std::string line;
+                std::error_code error;
+                const auto header = std::getline(snapshot, line) ? web::json::value::parse(utility::s2us(line), error) : web::json::value::null();
+                if (error || !header.is_object() || 1 != snapshot_format(header))
+                {
+                    slog::log<slog::severities::error>(gate, SLOG_FLF) << "Unrecognised registry snapshot";
+                    return 0;
+                }
+                if (journal_sequence) *journal_sequence = snapshot_journal_sequence(header).as_number().to_uint64();
+
+                std::vector<std::pair<nmos::id, nmos::health>> healths;
+                while (std::getline(snapshot, line))
+                {
+                    if (line.empty()) continue;
+
+                    const auto entry = web::json::value::parse(utility::s2us(line), error);
+                    if (error || !entry.is_object() || !entry.has_field(U("data")))
+                    {
+                        // e.g. a truncated final line
+                        slog::log<slog::severities::warning>(gate, SLOG_FLF) << "Skipping malformed registry snapshot entry";
+                        continue;
+                    }
+
+                    const auto& age = entry.at(U("age"));
+                    nmos::resource resource{ nmos::parse_api_version(entry.at(U("version")).as_string()), nmos::type{ entry.at(U("type")).as_string() }, entry.at(U("data")), age.is_null() };
+
+                    // join sub-resources in case the registry allowed out-of-order insertion (see nmos::fields::allow_invalid_resources)
+                    const auto id = resource.id;
+                    if (nmos::insert_resource(resources, std::move(resource), true).second && !age.is_null())
+                    {
+                        healths.push_back({ id, now - age.as_number().to_int64() });
+                    }
+                }
+
+                // insert_resource sets the health of each sub-resource from its super-resource, so the restored health is only set once all have been inserted
+                for (const auto& health : healths)
+                {
+                    auto found = resources.find(health.first);
+                    if (resources.end() != found) nmos::details::set_resource_health(resources, *found, health.second);
+                }
+
+                return healths.size();
+            }
+
+            void write_journal(std::string& journal, const std::vector<shared_journal_entry>& entries)
+            {
+                for (const auto& entry : entries)
+                {
+                    journal.append("{\"sequence\":");
+                    journal.append(std::to_string(entry->sequence));
+                    journal.append(",\"id\":");
+                    web::json::experimental::serialize_utf8(journal, web::json::value::string(entry->id));
+                    journal.append(",\"type\":");
+                    web::json::experimental::serialize_utf8(journal, web::json::value::string(entry->type.name));
+                    journal.append(",\"version\":");
+                    web::json::experimental::serialize_utf8(journal, web::json::value::string(nmos::make_api_version(entry->version)));
+                    journal.append(entry->never_expire ? ",\"never_expire\":true" : ",\"never_expire\":false");
+                    journal.append(",\"data\":");
+                    web::json::experimental::serialize_utf8(journal, entry->post ? *entry->post : web::json::value::null());
+                    journal.append("}\n");
+                }
+            }
+
+            std::pair<std::size_t, std::uint64_t> read_journal(nmos::resources& resources, std::istream& journal, slog::base_gate& gate, std::uint64_t journal_sequence)
+            {
+                std::size_t count = 0;
+                std::string line;
+                while (std::getline(journal, line))
+                {
+                    if (line.empty()) continue;
+
+                    std::error_code error;
+                    const auto entry = web::json::value::parse(utility::s2us(line), error);
+                    if (error || !entry.is_object() || !entry.has_field(U("sequence")) || !entry.has_field(U("data")))
+                    {
+                        // e.g. a truncated final line, if the registry crashed while the journal was being written
+                        slog::log<slog::severities::warning>(gate, SLOG_FLF) << "Skipping malformed registry journal entry";
+                        continue;
+                    }
+
+                    // changes already included in the snapshot are skipped
+                    const auto sequence = entry.at(U("sequence")).as_number().to_uint64();
+                    if (sequence <= journal_sequence) continue;
+                    journal_sequence = sequence;
+
+                    const auto id = entry.at(U("id")).as_string();
+                    const auto& data = entry.at(U("data"));
+                    if (data.is_null())
+                    {
+                        nmos::erase_resource(resources, id);
+                    }
+                    else
+                    {
+                        auto found = resources.find(id);
+                        if (resources.end() != found && found->has_data())
+                        {
+                            nmos::modify_resource(resources, id, [&](nmos::resource& resource) { resource.data = data; });
+                        }
+                        else
+                        {
+                            nmos::resource resource{ nmos::parse_api_version(entry.at(U("version")).as_string()), nmos::type{ entry.at(U("type")).as_string() }, data, entry.at(U("never_expire")).as_bool() };
+                            nmos::insert_resource(resources, std::move(resource), true);
+                        }
+                    }
+                    ++count;
+                }
+                return{ count, journal_sequence };
+            }
+
+            // write the snapshot to a temporary file and then replace the previous snapshot, so that there is always a complete snapshot
+            static bool write_snapshot_file(const std::string& file, const std::string& snapshot)
+            {
+                const std::string temporary = file + ".tmp";
+                {
+                    std::ofstream os(temporary, std::ios::binary | std::ios::trunc);
+                    os.write(snapshot.data(), (std::streamsize)snapshot.size());
+                    os.close();
+                    if (!os) return false;
+                }
+                if (0 == std::rename(temporary.c_str(), file.c_str())) return true;
+                // on Windows, rename fails if the file already exists
+                std::remove(file.c_str());
+                return 0 == std::rename(temporary.c_str(), file.c_str());
+            }
+
+            // append the journal entries to the journal file, flushing them to the operating system as a group
+            static bool append_journal_file(const std::string& file, const std::string& journal)
+            {
+                std::ofstream os(file, std::ios::binary | std::ios::app);
+                os.write(journal.data(), (std::streamsize)journal.size());
+                os.close();
+                return !os.fail();
+            }
+        }
+
+        std::size_t restore_registry_snapshot(nmos::registry_model& model, slog::base_gate& gate_)
+        {
+            nmos::details::omanip_gate gate(gate_, nmos::categories::registry_snapshot);
+
+            auto lock = model.write_lock();
+
+            const auto file = utility::us2s(nmos::experimental::fields::registry_snapshot_file(model.settings));
+            if (file.empty()) return 0;
+
+            std::size_t restored = 0;
+            std::uint64_t journal_sequence = 0;
+
+            std::ifstream is(file, std::ios::binary);
+            if (is)
+            {
+                restored = details::read_snapshot(model.registry_resources, is, gate, nmos::health_now(), &journal_sequence);
+
+                slog::log<slog::severities::info>(gate, SLOG_FLF) << "Restored " << restored << " resources from registry snapshot: " << file;
+            }
+            else
+            {
+                slog::log<slog::severities::info>(gate, SLOG_FLF) << "No registry snapshot to restore from: " << file;
+            }
+
+            if (nmos::experimental::fields::registry_journal(model.settings))
+            {
+                const auto journal_file = file + ".journal";
+
+                std::ifstream journal(journal_file, std::ios::binary);
+                if (journal)
+                {
+                    const auto replayed = details::read_journal(model.registry_resources, journal, gate, journal_sequence);
+                    journal_sequence = replayed.second;
+
+                    slog::log<slog::severities::info>(gate, SLOG_FLF) << "Replayed " << replayed.first << " changes from registry journal: " << journal_file;
+                }
+            }
+
+            // the restored resources are not themselves journaled, but subsequent changes continue the sequence
+            model.registry_resources.journal = make_resource_journal(model.settings, journal_sequence, most_recent_update(model.registry_resources));
+
+            model.notify();
+
+            return restored;
+        }
+
+        void registry_snapshot_thread(nmos::registry_model& model, slog::base_gate& gate_)
+        {
+            nmos::details::omanip_gate gate(gate_, nmos::categories::registry_snapshot);
+
+            // only a shared/read lock is required to take a snapshot
+            auto lock = model.read_lock();
+
+            const auto file = utility::us2s(nmos::experimental::fields::registry_snapshot_file(model.settings));
+            if (file.empty()) return;
+
+            const auto journal_file = file + ".journal";
+            const auto journal = nmos::experimental::fields::registry_journal(model.settings) ? model.registry_resources.journal : std::shared_ptr<resource_journal>();
+
+            // the sequence number of the most recent change written to the journal file, or included in the snapshot
+            std::uint64_t journal_sequence = journal ? journal->origin_sequence() : 0;
+            std::vector<shared_journal_entry> entries;
+            bool journal_gap = false;
+
+            details::snapshot_cache cache;
+            std::string snapshot;
+            std::string changes;
+
+            const auto snapshot_interval = std::chrono::seconds(nmos::experimental::fields::registry_snapshot_interval(model.settings));
+            const auto journal_interval = std::chrono::milliseconds(nmos::experimental::fields::registry_journal_interval(model.settings));
+            auto snapshot_time = std::chrono::steady_clock::now() + snapshot_interval;
+
+            bool shutdown = false;
+            while (!shutdown)
+            {
+                // when the journal is enabled, wake up frequently to write the changes, i.e. group commit
+                const auto wake_time = journal ? (std::min)(snapshot_time, std::chrono::steady_clock::now() + journal_interval) : snapshot_time;
+                shutdown = model.shutdown_condition.wait_until(lock, wake_time, [&] { return model.shutdown; });
+
+                // while the lock is held, no further changes can be appended, so all these changes are included in the snapshot (if taken)
+                // if some changes were missed, the journal file can't be appended to until a snapshot has been written
+                entries.clear();
+                if (journal && !journal->read(journal_sequence, entries))
+                {
+                    if (!journal_gap) slog::log<slog::severities::warning>(gate, SLOG_FLF) << "Registry journal fell behind the resource journal; taking a registry snapshot instead";
+                    journal_gap = true;
+                    entries.clear();
+                }
+                if (journal) journal_sequence = journal->sequence();
+
+                const bool snapshot_due = shutdown || journal_gap || snapshot_time <= std::chrono::steady_clock::now();
+                if (snapshot_due)
+                {
+                    snapshot.clear();
+                    details::write_snapshot(snapshot, model.registry_resources, cache);
+                }
+
+                // the files are written without the lock
+                nmos::details::reverse_lock_guard<nmos::read_lock> unlock{ lock };
+
+                if (snapshot_due)
+                {
+                    snapshot_time = std::chrono::steady_clock::now() + snapshot_interval;
+
+                    if (details::write_snapshot_file(file, snapshot))
+                    {
+                        slog::log<slog::severities::too_much_info>(gate, SLOG_FLF) << "Wrote registry snapshot of " << cache.size() << " resources";
+
+                        // the journal only needs the changes after the most recent snapshot
+                        // (it is also removed when the journal is disabled, so that stale changes are never replayed)
+                        std::remove(journal_file.c_str());
+                        journal_gap = false;
+                        continue;
+                    }
+
+                    slog::log<slog::severities::error>(gate, SLOG_FLF) << "Failed to write registry snapshot: " << file;
+                }
+
+                if (!entries.empty() && !journal_gap)
+                {
+                    changes.clear();
+                    details::write_journal(changes, entries);
+                    if (!details::append_journal_file(journal_file, changes))
+                    {
+                        slog::log<slog::severities::error>(gate, SLOG_FLF) << "Failed to write registry journal: " << journal_file;
+                    }
+                }
+            }
+        }
+    }
+}
@@ -0,0 +1,63 @@
+#ifndef NMOS_REGISTRY_SNAPSHOT_H
+#define NMOS_REGISTRY_SNAPSHOT_H
+
+#include <cstdint>
+#include <iosfwd>
+#include <string>
+#include <unordered_map>
+#include <vector>
+#include "nmos/health.h"
+#include "nmos/resource_journal.h"
+#include "nmos/resources.h"
+
+namespace slog
+{
+    class base_gate;
+}
+
+// This is an experimental extension to snapshot the registry resources and subscriptions to disk, for a fast warm restart
+// and optionally to journal the changes between snapshots
+// See nmos::experimental::fields::registry_snapshot_file and nmos::experimental::fields::registry_journal
+namespace nmos
+{
+    struct registry_model;
+
+    namespace experimental
+    {
+        // restore the registry resources and subscriptions from the snapshot file, if one is configured and exists, and replay the subsequent changes from the journal
+        // and return the number of resources restored; the health of each resource is restored relative to the time of the snapshot
+        // this also sets up the resource journal, if it is needed, continuing the sequence of the journal file
+        // this should be called before the APIs are opened
+        std::size_t restore_registry_snapshot(nmos::registry_model& model, slog::base_gate& gate);
+
+        // write snapshots of the registry resources and subscriptions to the snapshot file periodically, and when the server is shut down
+        // and if the journal is enabled, append the changes from the resource journal to the journal file, and discard the file after each snapshot
+        // if the changes since the previous write are no longer all retained by the resource journal, a snapshot is taken instead
+        void registry_snapshot_thread(nmos::registry_model& model, slog::base_gate& gate);
+
+        namespace details
+        {
+            // the UTF-8 serialization of each resource and the update timestamp from which it was made,
+            // so that only resources that have been updated since the previous snapshot are serialized again
+            typedef std::unordered_map<nmos::id, std::pair<nmos::tai, std::string>> snapshot_cache;
+
+            // append a snapshot of the resources (and subscriptions, but not websocket grains) to the specified buffer
+            // a snapshot is line-delimited JSON, with a header line followed by one line per resource, in an order that maintains referential integrity
+            // the header records the sequence number of the most recent journal entry (if any), whose changes are therefore included
+            void write_snapshot(std::string& snapshot, const nmos::resources& resources, snapshot_cache& cache, nmos::health now = nmos::health_now());
+
+            // insert the resources from a snapshot, with their health relative to the specified time, and return the number of resources inserted
+            // resources that already exist, e.g. the registry's own node resources, are left alone
+            std::size_t read_snapshot(nmos::resources& resources, std::istream& snapshot, slog::base_gate& gate, nmos::health now = nmos::health_now(), std::uint64_t* journal_sequence = nullptr);
+
+            // append the journal entries to the specified buffer, as line-delimited JSON
+            void write_journal(std::string& journal, const std::vector<shared_journal_entry>& entries);
+
+            // replay the changes from a journal that followed the specified sequence number, and return the number of changes
+            // and the sequence number of the last one
+            std::pair<std::size_t, std::uint64_t> read_journal(nmos::resources& resources, std::istream& journal, slog::base_gate& gate, std::uint64_t journal_sequence);
+        }
+    }
+}
+
+#endif
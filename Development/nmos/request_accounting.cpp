@@ -0,0 +1,32 @@
+#include "nmos/request_accounting.h"
+
+#if defined(_WIN32)
+#include <windows.h>
+#else
+#include <time.h>
+#endif
+
+namespace nmos
+{
+    namespace experimental
+    {
+        // the CPU time consumed by the calling thread so far, or zero if that isn't supported on this platform
+        std::chrono::microseconds this_thread_cpu_time()
+        {
+#if defined(_WIN32)
+            FILETIME creation_time, exit_time, kernel_time, user_time;
+            if (!GetThreadTimes(GetCurrentThread(), &creation_time, &exit_time, &kernel_time, &user_time)) return std::chrono::microseconds::zero();
+            // FILETIME is in 100 ns units
+            const auto ticks = (((unsigned long long)kernel_time.dwHighDateTime << 32) | kernel_time.dwLowDateTime)
+                + (((unsigned long long)user_time.dwHighDateTime << 32) | user_time.dwLowDateTime);
+            return std::chrono::microseconds(ticks / 10);
+#elif defined(CLOCK_THREAD_CPUTIME_ID)
+            timespec cpu_time;
+            if (0 != clock_gettime(CLOCK_THREAD_CPUTIME_ID, &cpu_time)) return std::chrono::microseconds::zero();
+            return std::chrono::seconds(cpu_time.tv_sec) + std::chrono::duration_cast<std::chrono::microseconds>(std::chrono::nanoseconds(cpu_time.tv_nsec));
+#else
+            return std::chrono::microseconds::zero();
+#endif
+        }
+    }
+}
@@ -0,0 +1,40 @@
+#ifndef NMOS_REQUEST_ACCOUNTING_H
+#define NMOS_REQUEST_ACCOUNTING_H
+
+#include <chrono>
+
+// This is an experimental extension to account for the work done by the route handlers for each request, e.g. to find expensive
+// and lock-heavy requests from the access log (see nmos::experimental::initialize_request_accounting)
+namespace nmos
+{
+    namespace experimental
+    {
+        // the work done on one thread by the route handler for the request it is currently handling, if any
+        struct request_accounting
+        {
+            request_accounting() : depth(0), lock_wait(0), lock_hold(0), cpu_time(0) {}
+
+            // the nesting depth of route handler calls, e.g. when one api_router is mounted in another, or zero if no request is being handled
+            int depth;
+            // the time spent waiting for, and holding, the model lock (the latter is only recorded when NMOS_CPP_INSTRUMENT_MUTEX is defined)
+            std::chrono::microseconds lock_wait;
+            std::chrono::microseconds lock_hold;
+            // the thread CPU time when the outermost route handler call began
+            std::chrono::microseconds cpu_time;
+        };
+
+        namespace details
+        {
+            inline request_accounting& this_thread_request_accounting()
+            {
+                static thread_local request_accounting accounting;
+                return accounting;
+            }
+        }
+
+        // the CPU time consumed by the calling thread so far, or zero if that isn't supported on this platform
+        std::chrono::microseconds this_thread_cpu_time();
+    }
+}
+
+#endif
@@ -1,7 +1,7 @@
 #ifndef NMOS_RESOURCE_H
 #define NMOS_RESOURCE_H
 
-#include <set>
+#include <boost/container/flat_set.hpp>
 #include "nmos/api_version.h"
 #include "nmos/copyable_atomic.h"
 #include "nmos/json_fields.h"
@@ -29,7 +29,7 @@ namespace nmos
             , type(type)
             , data(std::move(data))
             , id(fields::id(this->data))
-            , created(tai_now())
+            , created(tai_coarse_now())
             , updated(created)
             , health(never_expire ? health_forever : created.seconds)
         {}
@@ -43,6 +43,8 @@ namespace nmos
 
         // resource data is stored directly as json rather than e.g. being deserialized to a class hierarchy to allow quick
         // prototyping; json validation at the API boundary ensures the data met the schema for the specified version
+        // note, web::json::value has no allocator support, so each object field, string and array element is a separate heap allocation;
+        // any arena or pool-based storage for resource data would require replacing the json representation throughout
         web::json::value data;
         // when the resource data is null, the resource has been deleted or expired
         bool has_data() const { return !data.is_null(); }
@@ -52,7 +54,10 @@ namespace nmos
         nmos::id id;
 
         // sub-resources are tracked in order to optimise resource expiry and deletion
-        std::set<nmos::id> sub_resources;
+        // they are kept in a sorted vector rather than a tree, since they are mostly iterated, e.g. to propagate health or cascade an erasure,
+        // and a device may have hundreds of senders and receivers
+        typedef boost::container::flat_set<nmos::id> sub_resources_type;
+        sub_resources_type sub_resources;
 
         // see https://github.com/AMWA-TV/nmos-discovery-registration/blob/v1.2/docs/2.5.%20APIs%20-%20Query%20Parameters.md#pagination
         tai created;
@@ -0,0 +1,105 @@
+#include "nmos/resource_journal.h"
+
+#include <algorithm>
+
+namespace nmos
+{
+    namespace experimental
+    {
+        resource_journal::resource_journal(std::size_t capacity, std::uint64_t sequence, const nmos::tai& updated)
+            : ring((std::max)(capacity, std::size_t(1)))
+            , first(0)
+            , size(0)
+            , origin(sequence)
+            , last_sequence(sequence)
+            , truncated(updated)
+        {
+        }
+
+        void resource_journal::append(const nmos::resource& resource, web::json::value pre, const nmos::tai& updated)
+        {
+            // the websocket grains are frequently modified, aren't queryable, and aren't restored anyway
+            if (nmos::types::grain == resource.type) return;
+
+            // copying the data is the only significant cost while the lock is held; it is then shared by every reader
+            // entries are serialized by the journal thread, and matched by the Query API readers, without any lock on the model
+            std::shared_ptr<resource_journal_entry> entry(new resource_journal_entry{
+                last_sequence + 1,
+                updated,
+                resource.version,
+                resource.type,
+                resource.id,
+                pre.is_null() ? nullptr : std::make_shared<const web::json::value>(std::move(pre)),
+                resource.has_data() ? std::make_shared<const web::json::value>(resource.data) : nullptr,
+                nmos::health_forever == resource.health
+            });
+
+            std::lock_guard<std::mutex> lock(mutex);
+            if (ring.size() == size)
+            {
+                truncated = ring[first]->updated;
+                ring[first] = std::move(entry);
+                first = (first + 1) % ring.size();
+            }
+            else
+            {
+                ring[(first + size) % ring.size()] = std::move(entry);
+                ++size;
+            }
+            ++last_sequence;
+        }
+
+        bool resource_journal::read(std::uint64_t sequence, std::vector<shared_journal_entry>& entries) const
+        {
+            std::lock_guard<std::mutex> lock(mutex);
+            const auto last = last_sequence.load();
+            if (last < sequence) return false;
+
+            // the oldest retained change has the sequence number after last - size
+            const auto count = last - sequence;
+            if (size < count) return false;
+
+            entries.reserve(entries.size() + count);
+            for (auto i = size - count; i < size; ++i)
+            {
+                entries.push_back(ring[(first + i) % ring.size()]);
+            }
+            return true;
+        }
+
+        bool resource_journal::read_since(const nmos::tai& cursor, std::vector<shared_journal_entry>& entries) const
+        {
+            std::lock_guard<std::mutex> lock(mutex);
+            if (cursor < truncated) return false;
+
+            // the update timestamps are non-decreasing, so search backwards for the first change after the cursor,
+            // which is usually one of the most recent
+            auto count = std::size_t(0);
+            while (count < size && cursor < ring[(first + size - count - 1) % ring.size()]->updated) ++count;
+
+            entries.reserve(entries.size() + count);
+            for (auto i = size - count; i < size; ++i)
+            {
+                entries.push_back(ring[(first + i) % ring.size()]);
+            }
+            return true;
+        }
+
+        // construct the journal based on settings, continuing from the specified sequence number and update timestamp,
+        // or return nullptr if none of the features that use it are enabled
+        std::shared_ptr<resource_journal> make_resource_journal(const nmos::settings& settings, std::uint64_t sequence, const nmos::tai& updated)
+        {
+            const auto limit = (std::size_t)(std::max)(0, nmos::experimental::fields::resource_journal_limit(settings));
+            const auto resume_limit = (std::size_t)(std::max)(0, nmos::experimental::fields::query_ws_resume_limit(settings));
+            const bool registry_journal = nmos::experimental::fields::registry_journal(settings) && !nmos::experimental::fields::registry_snapshot_file(settings).empty();
+
+            // by default, enough changes are retained for the registry journal file to be written between group commits even during a registration storm
+            // if the thread that writes the file does fall behind, it takes a snapshot instead
+            const std::size_t default_registry_journal_limit = 10000;
+            const auto capacity = (std::max)(resume_limit, 0 != limit ? limit : registry_journal ? default_registry_journal_limit : 0);
+            if (0 == capacity) return{};
+
+            return std::make_shared<resource_journal>(capacity, sequence, updated);
+        }
+    }
+}
@@ -0,0 +1,92 @@
+#ifndef NMOS_RESOURCE_JOURNAL_H
+#define NMOS_RESOURCE_JOURNAL_H
+
+#include <atomic>
+#include <cstdint>
+#include <memory>
+#include <mutex>
+#include <vector>
+#include "nmos/resource.h"
+#include "nmos/settings.h"
+
+// This is an experimental extension to keep one ordered, bounded history of the changes to the registry resources, from which
+// Query API websocket connections resume, paging.wait long-polls are answered, and the registry journal file is written between snapshots
+// See nmos::experimental::fields::resource_journal_limit, nmos/registry_snapshot.h and nmos::experimental::fields::registry_journal
+namespace nmos
+{
+    namespace experimental
+    {
+        // a change to a resource, i.e. its insertion, modification or erasure
+        // entries are immutable, so that readers can share them without copying any data
+        struct resource_journal_entry
+        {
+            // the sequence number, which increases by one for each change
+            std::uint64_t sequence;
+            // the update timestamp of the resource when it was changed, i.e. the cursor used by the Query API (but expiry doesn't set it)
+            nmos::tai updated;
+
+            nmos::api_version version;
+            nmos::type type;
+            nmos::id id;
+
+            // the data before the change (nullptr when inserted), and after the change (nullptr when erased)
+            std::shared_ptr<const web::json::value> pre;
+            std::shared_ptr<const web::json::value> post;
+
+            bool never_expire;
+        };
+
+        typedef std::shared_ptr<const resource_journal_entry> shared_journal_entry;
+
+        // a ring of the most recent changes; changes are appended by the resource operations, which already hold the exclusive/write lock
+        // on the resources, and may be read concurrently by any number of readers from their own cursors, without any lock on the model
+        class resource_journal
+        {
+        public:
+            // the journal retains up to the specified number of changes, and continues from the specified sequence number and update timestamp
+            explicit resource_journal(std::size_t capacity, std::uint64_t sequence = 0, const nmos::tai& updated = {});
+
+            resource_journal(const resource_journal&) = delete;
+            resource_journal& operator=(const resource_journal&) = delete;
+
+            // append a change to the resource (with the exclusive/write lock on the resources, which keeps the sequence numbers in order)
+            void append(const nmos::resource& resource, web::json::value pre, const nmos::tai& updated);
+
+            // append the changes after the specified sequence number to the entries, oldest first, and return true,
+            // or return false, without appending anything, if those changes are no longer all retained
+            bool read(std::uint64_t sequence, std::vector<shared_journal_entry>& entries) const;
+
+            // append the changes after the specified update timestamp to the entries, oldest first, and return true,
+            // or return false, without appending anything, if those changes are no longer all retained
+            bool read_since(const nmos::tai& cursor, std::vector<shared_journal_entry>& entries) const;
+
+            // the sequence number of the most recently appended change
+            std::uint64_t sequence() const { return last_sequence.load(); }
+
+            // the sequence number from which the journal continued, i.e. that of the change before the first one appended
+            std::uint64_t origin_sequence() const { return origin; }
+
+            std::size_t capacity() const { return ring.size(); }
+
+        private:
+            mutable std::mutex mutex;
+
+            // the retained changes, of which the oldest is at first, once the ring is full
+            std::vector<shared_journal_entry> ring;
+            std::size_t first;
+            std::size_t size;
+
+            const std::uint64_t origin;
+            std::atomic<std::uint64_t> last_sequence;
+
+            // the update timestamp of the most recent change that is no longer (or was never) retained
+            nmos::tai truncated;
+        };
+
+        // construct the journal based on settings, continuing from the specified sequence number and update timestamp,
+        // or return nullptr if none of the features that use it are enabled
+        std::shared_ptr<resource_journal> make_resource_journal(const nmos::settings& settings, std::uint64_t sequence, const nmos::tai& updated);
+    }
+}
+
+#endif
@@ -1,8 +1,14 @@
 #include "nmos/resources.h"
 
+#include <algorithm>
+#include <boost/mpl/size.hpp>
 #include <boost/range/adaptor/reversed.hpp>
+#include "cpprest/base_uri.h"
+#include "cpprest/json_utils.h" // for web::json::shrink_to_fit
+#include "nmos/event_queues.h" // for nmos::resource_change
 #include "nmos/is04_versions.h"
 #include "nmos/query_utils.h"
+#include "nmos/resource_journal.h"
 
 namespace nmos
 {
@@ -15,25 +21,305 @@ namespace nmos
         return (by_updated.empty() ? tai{} : by_updated.begin()->updated);
     }
 
-    // returns the least health of extant and non-extant resources
-    // note, this is now O(N), not O(1), since resource health is mutable and therefore unindexed
-    std::pair<health, health> least_health(const resources& resources)
+    namespace details
     {
-        const auto now = health_now();
-        std::pair<health, health> results{ now, now };
-        for (const auto& resource : resources)
+        // add the entry to the appropriate set of the health index (with the health index mutex locked)
+        static inline void insert_health_entry(details::health_index& index, const resource& resource, health health)
+        {
+            if (resource.has_data())
+            {
+                if (health_forever != health) index.extant.insert({ health, resource.id });
+            }
+            else
+            {
+                index.non_extant.insert({ health, resource.id });
+            }
+        }
+
+        // remove the entry from the health index (with the health index mutex locked)
+        static inline void erase_health_entry(details::health_index& index, const resource& resource, health health)
+        {
+            const details::health_index::entries_type::value_type entry{ health, resource.id };
+            index.extant.erase(entry);
+            index.non_extant.erase(entry);
+        }
+
+        // move the entry for a resource that has just been "erased" but not forgotten (with the health index mutex unlocked)
+        static inline void erased_health_entry(const resources& resources, const resource& resource)
+        {
+            std::lock_guard<std::mutex> lock(resources.health_index.mutex);
+            const auto health = resource.health.load();
+            erase_health_entry(resources.health_index, resource, health);
+            insert_health_entry(resources.health_index, resource, health);
+        }
+
+        // remove the entry for a resource that is about to be forgotten (with the health index mutex unlocked)
+        static inline void forgotten_health_entry(const resources& resources, const resource& resource)
+        {
+            std::lock_guard<std::mutex> lock(resources.health_index.mutex);
+            erase_health_entry(resources.health_index, resource, resource.health.load());
+        }
+
+        // remove the entry for a subscription from the subscription key index, if it has one
+        static void unindex_subscription(resources& resources, const id& id)
+        {
+            auto& index = resources.subscription_keys;
+            auto found = index.keys.find(id);
+            if (index.keys.end() == found) return;
+
+            auto key = index.ids.find(found->second);
+            if (index.ids.end() != key && id == key->second) index.ids.erase(key);
+            index.keys.erase(found);
+        }
+
+        // update the entry for a subscription that has just been inserted or modified in the subscription key index
+        static void index_subscription(resources& resources, const resource& resource)
+        {
+            if (nmos::types::subscription != resource.type) return;
+
+            unindex_subscription(resources, resource.id);
+
+            auto key = make_subscription_key(resource.version, resource.data, web::uri(nmos::fields::ws_href(resource.data)).host());
+            // if there are already duplicate subscriptions (e.g. restored from a snapshot), only the first is found
+            if (resources.subscription_keys.ids.insert({ key, resource.id }).second)
+            {
+                resources.subscription_keys.keys.insert({ resource.id, std::move(key) });
+            }
+        }
+
+        // remove the entries for a resource from the tag index, if it has any
+        static void unindex_tags(resources& resources, const id& id)
+        {
+            auto& index = resources.tagged_resources;
+            auto found = index.keys.find(id);
+            if (index.keys.end() == found) return;
+
+            for (const auto& key : found->second)
+            {
+                auto ids = index.ids.find(key);
+                if (index.ids.end() == ids) continue;
+                ids->second.erase(id);
+                if (ids->second.empty()) index.ids.erase(ids);
+            }
+            index.keys.erase(found);
+        }
+
+        // update the entries for a resource that has just been inserted or modified in the tag index
+        static void index_tags(resources& resources, const resource& resource)
+        {
+            unindex_tags(resources, resource.id);
+
+            if (!resource.data.has_field(U("tags"))) return;
+            const auto& tags = resource.data.at(U("tags"));
+            if (!tags.is_object()) return;
+
+            // each tag is an array of string values, but a Basic Query would also match a string, so that is indexed too
+            std::vector<details::tag_index::key_type> keys;
+            for (const auto& tag : tags.as_object())
+            {
+                if (tag.second.is_string())
+                {
+                    keys.push_back({ tag.first, tag.second.as_string() });
+                }
+                else if (tag.second.is_array())
+                {
+                    for (const auto& value : tag.second.as_array())
+                    {
+                        if (value.is_string()) keys.push_back({ tag.first, value.as_string() });
+                    }
+                }
+            }
+            if (keys.empty()) return;
+
+            auto& index = resources.tagged_resources;
+            for (const auto& key : keys)
+            {
+                index.ids[key].insert(resource.id);
+            }
+            index.keys.insert({ resource.id, std::move(keys) });
+        }
+
+        // remove the entries for a resource from the receiver compatibility index, if it has any
+        static void unindex_receiver_compatibility(resources& resources, const id& id)
+        {
+            auto& index = resources.compatible_receivers;
+            auto found = index.keys.find(id);
+            if (index.keys.end() == found) return;
+
+            for (const auto& key : found->second)
+            {
+                auto ids = index.ids.find(key);
+                if (index.ids.end() == ids) continue;
+                ids->second.erase(id);
+                if (ids->second.empty()) index.ids.erase(ids);
+            }
+            index.keys.erase(found);
+        }
+
+        // update the entries for a receiver that has just been inserted or modified in the receiver compatibility index
+        static void index_receiver_compatibility(resources& resources, const resource& resource)
+        {
+            if (nmos::types::receiver != resource.type) return;
+
+            unindex_receiver_compatibility(resources, resource.id);
+
+            if (!resource.data.has_field(U("format"))) return;
+            const auto& format = resource.data.at(U("format"));
+            if (!format.is_string()) return;
+
+            // "If this field is not present, the media types are not constrained", i.e. any media type of the format is admitted
+            std::vector<details::receiver_compatibility_index::key_type> keys;
+            const auto caps = resource.data.has_field(U("caps")) ? resource.data.at(U("caps")) : web::json::value::null();
+            if (caps.has_field(U("media_types")) && caps.at(U("media_types")).is_array())
+            {
+                for (const auto& media_type : caps.at(U("media_types")).as_array())
+                {
+                    if (media_type.is_string()) keys.push_back({ format.as_string(), media_type.as_string() });
+                }
+            }
+            else
+            {
+                keys.push_back({ format.as_string(), {} });
+            }
+            if (keys.empty()) return;
+
+            auto& index = resources.compatible_receivers;
+            for (const auto& key : keys)
+            {
+                index.ids[key].insert(resource.id);
+            }
+            index.keys.insert({ resource.id, std::move(keys) });
+        }
+
+        // remove any cached serializations, etc. of a resource that has just been "erased" or is about to be forgotten
+        static inline void erase_cache_entries(resources& resources, const id& id)
+        {
+            {
+                std::lock_guard<std::mutex> lock(resources.serialization_cache.mutex);
+                resources.serialization_cache.entries.erase(id);
+            }
+            {
+                std::lock_guard<std::mutex> lock(resources.downgrade_cache.mutex);
+                resources.downgrade_cache.entries.erase(id);
+            }
+            resources.subscription_queries.erase(id);
+            unindex_subscription(resources, id);
+            unindex_tags(resources, id);
+            unindex_receiver_compatibility(resources, id);
+        }
+
+        // advance the query page cache watermark of the type of a resource that has just been inserted, modified or "erased", invalidating the cached pages of that type
+        // the watermark is strictly increasing, even when a resource is expired without its update timestamp being set
+        static void advance_query_page_watermark(const resources& resources, const nmos::type& type, tai updated)
+        {
+            auto& cache = resources.page_cache;
+            std::lock_guard<std::mutex> lock(cache.mutex);
+            auto& watermark = cache.watermarks[type];
+            if (updated <= watermark) updated = tai_from_time_point(time_point_from_tai(watermark) + tai_clock::duration(1));
+            watermark = updated;
+        }
+
+        // update the memory usage accounted to a resource that has just been inserted, modified or "erased"
+        static void account_memory_usage(resources& resources, const resource& resource)
+        {
+            auto& index = resources.memory_usage;
+            auto found = index.resources.find(resource.id);
+            if (index.resources.end() == found)
+            {
+                found = index.resources.insert({ resource.id, { 0, experimental::get_memory_usage_node(resources, resource) } }).first;
+            }
+
+            const auto bytes = experimental::approximate_memory_usage(resource);
+            auto& entry = found->second;
+            index.total += bytes - entry.first;
+            if (!entry.second.empty())
+            {
+                auto& node = index.nodes[entry.second];
+                node += bytes - entry.first;
+            }
+            entry.first = bytes;
+        }
+
+        // remove the memory usage accounted to a resource that is about to be forgotten
+        static void forgotten_memory_usage(resources& resources, const id& id)
+        {
+            auto& index = resources.memory_usage;
+            auto found = index.resources.find(id);
+            if (index.resources.end() == found) return;
+
+            const auto& entry = found->second;
+            index.total -= entry.first;
+            if (!entry.second.empty())
+            {
+                auto node = index.nodes.find(entry.second);
+                if (index.nodes.end() != node && 0 == (node->second -= entry.first))
+                {
+                    index.nodes.erase(node);
+                }
+            }
+            index.resources.erase(found);
+        }
+
+        // update the count of extant resources of the type and API version, when a resource has just been inserted or "erased"
+        static void count_resource(resources& resources, const resource& resource, bool extant)
         {
-            auto& result = resource.has_data() ? results.first : results.second;
+            auto& count = resources.counts[{ resource.type, resource.version }];
+            if (extant) ++count;
+            else if (0 != count) --count;
+        }
+
+        // update the count of non-extant resources of the type and API version, when a resource has just been "erased" but not forgotten, or is about to be forgotten
+        static void count_non_extant_resource(resources& resources, const resource& resource, bool non_extant)
+        {
+            auto& count = resources.non_extant_counts[{ resource.type, resource.version }];
+            if (non_extant) ++count;
+            else if (0 != count) --count;
+        }
+
+        // sum the counts of the specified type, or of all types
+        static std::size_t sum_counts(const details::resource_counts& counts, const type* type)
+        {
+            std::size_t total = 0;
+            for (const auto& count : counts)
+            {
+                if (nullptr == type || *type == count.first.first) total += count.second;
+            }
+            return total;
+        }
 
-            // since health is mutable, the snapshot may be immediately out of date
-            // but it is reasonable to rely on it not being modified to be *less*
-            const auto health_snapshot = resource.health.load();
-            if (health_snapshot < result)
+        // find the least health in the specified set of the health index (with the health index mutex locked)
+        // purging stale entries along the way
+        static health least_health(const resources& resources, details::health_index::entries_type& entries, details::health_index::entries_type& other_entries, bool extant, health least)
+        {
+            auto entry = entries.begin();
+            while (entries.end() != entry && entry->first < least)
             {
-                result = health_snapshot;
+                const auto resource = resources.find(entry->second);
+                if (resources.end() != resource && resource->health.load() == entry->first)
+                {
+                    if (resource->has_data() == extant) return entry->first;
+
+                    // misplaced entry, which shouldn't happen since resources are only "erased" or reinserted by the operations in this file
+                    other_entries.insert(*entry);
+                }
+                entry = entries.erase(entry);
             }
+            return least;
         }
-        return results;
+    }
+
+    // returns the least health of extant and non-extant resources
+    // note, since resource health is mutable, this relies on the health index rather than the multi_index_container indices
+    std::pair<health, health> least_health(const resources& resources)
+    {
+        const auto now = health_now();
+
+        auto& index = resources.health_index;
+        std::lock_guard<std::mutex> lock(index.mutex);
+
+        const auto extant = details::least_health(resources, index.extant, index.non_extant, true, now);
+        const auto non_extant = details::least_health(resources, index.non_extant, index.extant, false, now);
+        return{ extant, non_extant };
     }
 
     // insert a resource
@@ -48,6 +334,9 @@ namespace nmos
         // set the creation and update timestamps, before inserting the resource
         resource.updated = resource.created = nmos::strictly_increasing_update(resources);
 
+        // resource data is held for a long time, and there may be many resources, so it is worth releasing unused capacity
+        web::json::shrink_to_fit(resource.data);
+
         // all types (other than nodes, and subscriptions) must* be a sub-resource of an existing resource
         // (*assuming not out-of-order insertion by the allow_invalid_resources setting)
         auto super_resource = find_resource(resources, get_super_resource(resource));
@@ -65,6 +354,11 @@ namespace nmos
         // (currently, with no further checks on api_version, type, etc.)
         if (!result.second && !result.first->has_data())
         {
+            details::forgotten_health_entry(resources, *result.first);
+            details::erase_cache_entries(resources, result.first->id);
+            details::forgotten_memory_usage(resources, result.first->id);
+            details::count_non_extant_resource(resources, *result.first, false);
+
             // if the insertion was banned, resource has not been moved from
             result.second = resources.replace(result.first, std::move(resource));
         }
@@ -73,6 +367,14 @@ namespace nmos
         {
             auto& inserted = *result.first;
             insert_resource_events(resources, inserted.version, inserted.type, web::json::value::null(), inserted.data);
+            if (resources.journal) resources.journal->append(inserted, web::json::value::null(), inserted.updated);
+            details::account_memory_usage(resources, inserted);
+            details::count_resource(resources, inserted, true);
+            details::index_subscription(resources, inserted);
+            details::index_tags(resources, inserted);
+            details::index_receiver_compatibility(resources, inserted);
+            details::advance_query_page_watermark(resources, inserted.type, inserted.updated);
+            details::erase_resource_views(resources, inserted.id);
 
             // set the initial health of this resource from the super-resource (if applicable)
             // and update the health of any sub-resources to which the resource has been joined
@@ -113,6 +415,9 @@ namespace nmos
                 modifier_exception = std::current_exception();
             }
 
+            // as for insert_resource, release any capacity left unused by the modification
+            web::json::shrink_to_fit(resource.data);
+
             // set the update timestamp
             resource.updated = resource_updated;
         });
@@ -121,6 +426,13 @@ namespace nmos
         {
             auto& modified = *found;
             insert_resource_events(resources, modified.version, modified.type, pre, modified.data);
+            if (resources.journal) resources.journal->append(modified, std::move(pre), modified.updated);
+            details::account_memory_usage(resources, modified);
+            details::index_subscription(resources, modified);
+            details::index_tags(resources, modified);
+            details::index_receiver_compatibility(resources, modified);
+            details::advance_query_page_watermark(resources, modified.type, modified.updated);
+            details::erase_resource_views(resources, modified.id);
         }
 
         if (modifier_exception)
@@ -131,46 +443,74 @@ namespace nmos
         return result;
     }
 
-    // erase the resource with the specified id from the specified resources (if present)
-    // and return the count of the number of resources erased (including sub-resources)
-    // resources may optionally be initially "erased" by setting data to null, and remain in this non-extant state until they are explicitly forgotten (or reinserted)
-    resources::size_type erase_resource(resources& resources, const id& id, bool forget_now)
+    namespace details
     {
-        // also erase all sub-resources of this resource, i.e.
-        // for a node, all devices with matching node_id
-        // for a device, all sources, senders and receivers with matching device_id
-        // for a sender, all flows with matching source_id
-        // it won't be a very deep recursion...
-        resources::size_type count = 0;
-        auto found = resources.find(id);
-        if (resources.end() != found && found->has_data())
+        // erase the resource with the specified id from the specified resources (if present), and all its sub-resources,
+        // collecting the changes rather than inserting the resource events for each one, and return the count of the number of resources erased
+        static resources::size_type erase_resource(resources& resources, const id& id, bool forget_now, std::vector<resource_change>& changes)
         {
-            for (auto& sub_resource : found->sub_resources)
+            // also erase all sub-resources of this resource, i.e.
+            // for a node, all devices with matching node_id
+            // for a device, all sources, senders and receivers with matching device_id
+            // for a sender, all flows with matching source_id
+            // it won't be a very deep recursion...
+            resources::size_type count = 0;
+            auto found = resources.find(id);
+            if (resources.end() != found && found->has_data())
             {
-                count += erase_resource(resources, sub_resource, forget_now);
-            }
+                for (auto& sub_resource : found->sub_resources)
+                {
+                    count += erase_resource(resources, sub_resource, forget_now, changes);
+                }
 
-            const auto pre = found->data;
+                auto pre = found->data;
 
-            auto resource_updated = nmos::strictly_increasing_update(resources);
-            resources.modify(found, [&resource_updated](resource& resource)
-            {
-                resource.data = web::json::value::null();
+                auto resource_updated = nmos::strictly_increasing_update(resources);
+                resources.modify(found, [&resource_updated](resource& resource)
+                {
+                    resource.data = web::json::value::null();
 
-                // set the update timestamp when a resource is deleted
-                resource.updated = resource_updated;
-            });
+                    // set the update timestamp when a resource is deleted
+                    resource.updated = resource_updated;
+                });
+
+                auto& erased = *found;
+                if (resources.journal) resources.journal->append(erased, pre, resource_updated);
+                changes.push_back({ resource_updated, erased.version, erased.type, std::move(pre), erased.data });
+                count_resource(resources, erased, false);
+                advance_query_page_watermark(resources, erased.type, resource_updated);
+                erase_resource_views(resources, erased.id);
 
-            auto& erased = *found;
-            insert_resource_events(resources, erased.version, erased.type, pre, erased.data);
+                if (forget_now)
+                {
+                    forgotten_health_entry(resources, erased);
+                    erase_cache_entries(resources, erased.id);
+                    forgotten_memory_usage(resources, erased.id);
+                    resources.erase(found);
+                }
+                else
+                {
+                    erased_health_entry(resources, erased);
+                    erase_cache_entries(resources, erased.id);
+                    account_memory_usage(resources, erased);
+                    count_non_extant_resource(resources, erased, true);
+                }
 
-            if (forget_now)
-            {
-                resources.erase(found);
+                ++count;
             }
-
-            ++count;
+            return count;
         }
+    }
+
+    // erase the resource with the specified id from the specified resources (if present)
+    // and return the count of the number of resources erased (including sub-resources)
+    // resources may optionally be initially "erased" by setting data to null, and remain in this non-extant state until they are explicitly forgotten (or reinserted)
+    resources::size_type erase_resource(resources& resources, const id& id, bool forget_now)
+    {
+        // the resource events for the whole cascade, e.g. a node and all its devices, sources, flows, senders and receivers, are inserted together
+        std::vector<resource_change> changes;
+        const auto count = details::erase_resource(resources, id, forget_now, changes);
+        insert_resource_events(resources, changes);
         return count;
     }
 
@@ -179,48 +519,81 @@ namespace nmos
     // resources may optionally be initially "erased" by setting data to null, and remain in this non-extant state until they are explicitly forgotten (or reinserted)
     resources::size_type forget_erased_resources(resources& resources, const health& forget_health)
     {
-        resources::size_type count = 0;
-        auto& by_type = resources.get<tags::type>();
-        const auto range = by_type.equal_range(false);
-        auto found = range.first;
-        while (range.second != found)
+        // the candidates are found from the non-extant entries of the health index, in order of health, stopping at the first which isn't yet due,
+        // rather than by scanning all the erased resources; those with health_forever, at the other end, are always forgotten
+        // (health cannot be modified meanwhile, since that requires at least a shared/read lock)
+        std::vector<id> candidates;
         {
-            if (found->health < forget_health || found->health == health_forever)
+            auto& index = resources.health_index;
+            std::lock_guard<std::mutex> lock(index.mutex);
+
+            const auto due = [&](const details::health_index::entries_type::iterator& entry)
             {
-                found = by_type.erase(found);
-                ++count;
+                const auto resource = resources.find(entry->second);
+                if (resources.end() == resource) return false;
+
+                const auto health = resource->health.load();
+                if (resource->has_data())
+                {
+                    // misplaced entry, which shouldn't happen since resources are only "erased" or reinserted by the operations in this file
+                    if (health == entry->first && health_forever != health) index.extant.insert(*entry);
+                    return false;
+                }
+                if (health == entry->first)
+                {
+                    candidates.push_back(entry->second);
+                    return true;
+                }
+
+                // the health was modified some other way, so replace the stale entry, so that the resource isn't overlooked
+                // (if it's due, it's found again further along)
+                index.non_extant.insert({ health, entry->second });
+                return false;
+            };
+
+            for (auto entry = index.non_extant.begin(); index.non_extant.end() != entry && entry->first < forget_health && health_forever != entry->first;)
+            {
+                // the entries for candidates are erased when they are forgotten
+                if (due(entry)) ++entry; else entry = index.non_extant.erase(entry);
             }
-            else
+            for (auto entry = index.non_extant.lower_bound({ health_forever, {} }); index.non_extant.end() != entry;)
             {
-                ++found;
+                if (due(entry)) ++entry; else entry = index.non_extant.erase(entry);
             }
         }
+
+        resources::size_type count = 0;
+        for (const auto& id : candidates)
+        {
+            auto found = resources.find(id);
+            if (resources.end() == found || found->has_data()) continue;
+
+            details::forgotten_health_entry(resources, *found);
+            details::erase_cache_entries(resources, found->id);
+            details::forgotten_memory_usage(resources, found->id);
+            details::count_non_extant_resource(resources, *found, false);
+            resources.erase(found);
+            ++count;
+        }
         return count;
     }
 
-    // erase all resources of the specified type which expired *before* the specified time from the specified resources
-    // and return the count of the number of resources erased; sub-resources are *not* erased
-    // resources may optionally be initially "erased" by setting data to null, and remain in this non-extant state until they are explicitly forgotten (or reinserted)
-    resources::size_type erase_expired_resources(resources& resources, const nmos::type& type, const health& expire_health, bool forget_now)
+    namespace details
     {
-        resources::size_type count = 0;
-        auto& by_type = resources.get<tags::type>();
-        const auto range = by_type.equal_range(details::has_data(type));
-        auto found = range.first;
-        while (range.second != found)
+        // erase the specified resources of the specified type which expired *before* the specified time from the specified resources
+        // and return the count of the number of resources erased; sub-resources are *not* erased
+        // resources may optionally be initially "erased" by setting data to null, and remain in this non-extant state until they are explicitly forgotten (or reinserted)
+        static resources::size_type erase_expired_resources(resources& resources, const std::vector<id>& candidates, const nmos::type& type, const health& expire_health, bool forget_now, std::vector<resource_change>& changes)
         {
-            if (expire_health <= found->health)
+            resources::size_type count = 0;
+            for (const auto& id : candidates)
             {
-                ++found;
-            }
-            else
-            {
-                // since modify reorders the resource in this index
-                const auto next = std::next(found);
+                auto found = resources.find(id);
+                if (resources.end() == found || !found->has_data() || type != found->type || expire_health <= found->health) continue;
 
-                const auto pre = found->data;
+                auto pre = found->data;
 
-                by_type.modify(found, [](resource& resource)
+                resources.modify(found, [](resource& resource)
                 {
                     resource.data = web::json::value::null();
 
@@ -228,18 +601,31 @@ namespace nmos
                 });
 
                 auto& erased = *found;
-                insert_resource_events(resources, erased.version, erased.type, pre, erased.data);
+                if (resources.journal) resources.journal->append(erased, pre, most_recent_update(resources));
+                changes.push_back({ most_recent_update(resources), erased.version, erased.type, std::move(pre), erased.data });
+                count_resource(resources, erased, false);
+                advance_query_page_watermark(resources, erased.type, tai_now());
+                erase_resource_views(resources, erased.id);
 
                 if (forget_now)
                 {
-                    by_type.erase(found);
+                    forgotten_health_entry(resources, erased);
+                    erase_cache_entries(resources, erased.id);
+                    forgotten_memory_usage(resources, erased.id);
+                    resources.erase(found);
+                }
+                else
+                {
+                    erased_health_entry(resources, erased);
+                    erase_cache_entries(resources, erased.id);
+                    account_memory_usage(resources, erased);
+                    count_non_extant_resource(resources, erased, true);
                 }
 
-                found = next;
                 ++count;
             }
+            return count;
         }
-        return count;
     }
 
     // erase all resources which expired *before* the specified time from the specified resources
@@ -247,31 +633,210 @@ namespace nmos
     // resources may optionally be initially "erased" by setting data to null, and remain in this non-extant state until they are explicitly forgotten (or reinserted)
     resources::size_type erase_expired_resources(resources& resources, const health& expire_health, bool forget_now)
     {
+        // the candidates are found from the health index rather than by scanning all the resources
+        // (health cannot be modified meanwhile, since that requires at least a shared/read lock)
+        std::vector<id> candidates;
+        {
+            auto& index = resources.health_index;
+            std::lock_guard<std::mutex> lock(index.mutex);
+
+            for (auto entry = index.extant.begin(); index.extant.end() != entry && entry->first < expire_health;)
+            {
+                const auto resource = resources.find(entry->second);
+                if (resources.end() != resource && resource->health.load() == entry->first && resource->has_data())
+                {
+                    candidates.push_back(entry->second);
+                    ++entry;
+                }
+                else
+                {
+                    // stale entry
+                    entry = index.extant.erase(entry);
+                }
+            }
+        }
+
         resources::size_type count = 0;
+        // the resource events for all the expired resources are inserted together
+        std::vector<resource_change> changes;
         // reverse order to ensure sub-resources are erased before super-resources
         for (const auto& type : nmos::types::all | boost::adaptors::reversed)
         {
-            count += erase_expired_resources(resources, type, expire_health, forget_now);
+            count += details::erase_expired_resources(resources, candidates, type, expire_health, forget_now, changes);
         }
+        insert_resource_events(resources, changes);
         return count;
     }
 
+    namespace details
+    {
+        // get the current watermark of the resources of the specified type, for a new entry in the query page cache
+        // note, the shared/read lock on the resources must be held while the page is built, so that the watermark is consistent with it
+        tai get_query_page_watermark(const nmos::resources& resources, const nmos::type& type)
+        {
+            auto& cache = resources.page_cache;
+            std::lock_guard<std::mutex> lock(cache.mutex);
+            auto found = cache.watermarks.find(type);
+            return cache.watermarks.end() != found ? found->second : tai{};
+        }
+
+        // find the page with the specified key in the query page cache, if it's still valid; this doesn't require any lock on the resources
+        std::shared_ptr<const query_page> find_query_page(const nmos::resources& resources, const utility::string_t& key)
+        {
+            auto& cache = resources.page_cache;
+            std::lock_guard<std::mutex> lock(cache.mutex);
+            auto found = cache.entries.find(key);
+            if (cache.entries.end() == found) return{};
+
+            auto& entry = found->second;
+            auto watermark = cache.watermarks.find(entry.type);
+            if (entry.watermark != (cache.watermarks.end() != watermark ? watermark->second : tai{}))
+            {
+                // resources of the type have been changed since the page was built
+                cache.usage.erase(entry.usage);
+                cache.entries.erase(found);
+                return{};
+            }
+
+            cache.usage.splice(cache.usage.begin(), cache.usage, entry.usage);
+            return entry.page;
+        }
+
+        // insert the page into the query page cache, evicting the least recently used entries to keep to the specified capacity
+        void insert_query_page(const nmos::resources& resources, utility::string_t key, const nmos::type& type, const tai& watermark, std::shared_ptr<const query_page> page, std::size_t capacity)
+        {
+            auto& cache = resources.page_cache;
+            std::lock_guard<std::mutex> lock(cache.mutex);
+
+            auto found = cache.entries.find(key);
+            if (cache.entries.end() != found)
+            {
+                cache.usage.erase(found->second.usage);
+                cache.entries.erase(found);
+            }
+            if (0 == capacity) return;
+
+            cache.usage.push_front(key);
+            cache.entries.insert({ std::move(key), { type, watermark, std::move(page), cache.usage.begin() } });
+            while (capacity < cache.entries.size())
+            {
+                cache.entries.erase(cache.usage.back());
+                cache.usage.pop_back();
+            }
+        }
+
+        // find the specified view of the resource with the specified id, if it's still valid; this doesn't require any lock on the resources
+        std::shared_ptr<const query_page> find_resource_view(const nmos::resources& resources, const nmos::id& id, const utility::string_t& view)
+        {
+            auto& cache = resources.view_cache;
+            std::lock_guard<std::mutex> lock(cache.mutex);
+            auto found = cache.views.find({ id, view });
+            return cache.views.end() != found ? found->second : std::shared_ptr<const query_page>();
+        }
+
+        // insert the specified view of the resource with the specified id
+        // note, the shared/read lock on the resources must be held while the view is built and inserted, so that it's consistent with the resource
+        void insert_resource_view(const nmos::resources& resources, const nmos::id& id, const utility::string_t& view, std::shared_ptr<const query_page> page)
+        {
+            auto& cache = resources.view_cache;
+            std::lock_guard<std::mutex> lock(cache.mutex);
+            cache.views[{ id, view }] = std::move(page);
+        }
+
+        // discard the views of the resource with the specified id
+        void erase_resource_views(const nmos::resources& resources, const nmos::id& id)
+        {
+            auto& cache = resources.view_cache;
+            std::lock_guard<std::mutex> lock(cache.mutex);
+            if (cache.views.empty()) return;
+            auto first = cache.views.lower_bound({ id, utility::string_t{} });
+            auto last = first;
+            while (cache.views.end() != last && id == last->first.first) ++last;
+            cache.views.erase(first, last);
+        }
+
+        // the ids of the extant resources with the specified tag name and value
+        const std::set<id>& find_tagged_resources(const nmos::resources& resources, const utility::string_t& name, const utility::string_t& value)
+        {
+            static const std::set<id> none;
+            const auto& index = resources.tagged_resources;
+            const auto found = index.ids.find({ name, value });
+            return index.ids.end() != found ? found->second : none;
+        }
+
+        // the ids of the extant receivers that can accept a flow of the specified format and media type (or any media type of the format, if empty) according to their caps
+        std::set<id> find_compatible_receivers(const nmos::resources& resources, const utility::string_t& format, const utility::string_t& media_type)
+        {
+            const auto& index = resources.compatible_receivers;
+            if (media_type.empty())
+            {
+                std::set<id> result;
+                for (auto found = index.ids.lower_bound({ format, {} }); index.ids.end() != found && format == found->first.first; ++found)
+                {
+                    result.insert(found->second.begin(), found->second.end());
+                }
+                return result;
+            }
+
+            // the receivers that admit the media type, and those that don't constrain the media types of the format
+            std::set<id> result;
+            for (const auto& key : { details::receiver_compatibility_index::key_type{ format, media_type }, details::receiver_compatibility_index::key_type{ format, {} } })
+            {
+                const auto found = index.ids.find(key);
+                if (index.ids.end() != found) result.insert(found->second.begin(), found->second.end());
+            }
+            return result;
+        }
+    }
+
     // find the resource with the specified id in the specified resources (if present) and
     // set the health of the resource and all of its sub-resources, to prevent them expiring
     // note, since health is mutable, no need for the resources parameter to be non-const
-    void set_resource_health(const resources& resources, const id& id, health health)
+    namespace details
     {
-        auto found = resources.find(id);
-        if (resources.end() != found && found->has_data())
+        // set the health of the specified resource (but none of its sub-resources), keeping the health index up to date
+        // note, the health index mutex must be held, so that the index is consistent even when there are simultaneous heartbeats for the same resource
+        static void set_resource_health_locked(const resources& resources, const resource& resource, health health)
+        {
+            // since health is mutable, no need for:
+            // resources.modify(found, [&health](nmos::resource& resource){ resource.health = health; });
+            const auto prev_health = resource.health.exchange(health);
+
+            erase_health_entry(resources.health_index, resource, prev_health);
+            insert_health_entry(resources.health_index, resource, health);
+        }
+
+        static void set_resource_health_recursive_locked(const resources& resources, const id& id, health health)
         {
-            for (auto& sub_resource : found->sub_resources)
+            auto found = resources.find(id);
+            if (resources.end() != found && found->has_data())
             {
-                set_resource_health(resources, sub_resource, health);
+                for (auto& sub_resource : found->sub_resources)
+                {
+                    set_resource_health_recursive_locked(resources, sub_resource, health);
+                }
+
+                set_resource_health_locked(resources, *found, health);
             }
+        }
+    }
 
-            // since health is mutable, no need for:
-            // resources.modify(found, [&health](nmos::resource& resource){ resource.health = health; });
-            found->health = health;
+    void set_resource_health(const resources& resources, const id& id, health health)
+    {
+        // heartbeats are by far the most frequent calls, so the health index mutex is acquired just once
+        // for the whole tree of sub-resources, rather than once per resource
+        std::lock_guard<std::mutex> lock(resources.health_index.mutex);
+        details::set_resource_health_recursive_locked(resources, id, health);
+    }
+
+    namespace details
+    {
+        // set the health of the specified resource (but none of its sub-resources), keeping the health index up to date
+        // note, like set_resource_health, this only requires a shared/read lock on the resources
+        void set_resource_health(const resources& resources, const resource& resource, health health)
+        {
+            std::lock_guard<std::mutex> lock(resources.health_index.mutex);
+            set_resource_health_locked(resources, resource, health);
         }
     }
 
@@ -379,22 +944,96 @@ namespace nmos
         return nodes.second != nodes.first ? resources.project<0>(nodes.first) : resources.end();
     }
 
+    // the number of extant resources of the specified type, of any API version, from the maintained resource counts, i.e. without a scan
+    std::size_t count_resources(const resources& resources, const type& type)
+    {
+        return details::sum_counts(resources.counts, &type);
+    }
+
+    // the number of extant resources of all types, from the maintained resource counts
+    std::size_t count_resources(const resources& resources)
+    {
+        return details::sum_counts(resources.counts, nullptr);
+    }
+
+    // the number of non-extant resources of the specified type, i.e. those which have been "erased" but not yet forgotten, from the maintained resource counts
+    std::size_t count_non_extant_resources(const resources& resources, const type& type)
+    {
+        return details::sum_counts(resources.non_extant_counts, &type);
+    }
+
+    // the number of non-extant resources of all types, from the maintained resource counts
+    std::size_t count_non_extant_resources(const resources& resources)
+    {
+        return details::sum_counts(resources.non_extant_counts, nullptr);
+    }
+
     // get the id of each resource with the specified super-resource
-    std::set<nmos::id> get_sub_resources(const resources& resources, const std::pair<id, type>& id_type)
+    resource::sub_resources_type get_sub_resources(const resources& resources, const std::pair<id, type>& id_type)
     {
-        std::set<nmos::id> result;
-        for (const auto& sub_resource : resources)
+        resource::sub_resources_type result;
+        if (no_resource() == id_type) return result;
+
+        std::vector<nmos::id> ids;
+        auto& by_super_resource = resources.get<tags::super_resource>();
+        const auto sub_resources = by_super_resource.equal_range(id_type.first);
+        for (auto sub_resource = sub_resources.first; sub_resources.second != sub_resource; ++sub_resource)
         {
-            if (id_type == get_super_resource(sub_resource))
+            // the super-resource type must match as well
+            if (id_type == get_super_resource(*sub_resource))
             {
-                result.insert(sub_resource.id);
+                ids.push_back(sub_resource->id);
             }
         }
+
+        // sort once, rather than inserting each id into the sorted vector
+        std::sort(ids.begin(), ids.end());
+        ids.erase(std::unique(ids.begin(), ids.end()), ids.end());
+        result.insert(boost::container::ordered_unique_range, ids.begin(), ids.end());
         return result;
     }
 
     namespace details
     {
+        super_resource_id_extractor::result_type super_resource_id_extractor::operator()(const resource& resource) const
+        {
+            return get_super_resource(resource).first;
+        }
+
+        const utility::string_t& subscription_resource_path_extractor::operator()(const resource& resource) const
+        {
+            // a subscription's resource_path is either empty or begins with '/'
+            static const utility::string_t not_a_subscription{ U("-") };
+            return nmos::types::subscription == resource.type && resource.has_data() ? extract_string_property(resource.data, nmos::fields::resource_path) : not_a_subscription;
+        }
+
+        // make the canonical key for a subscription of the specified API version, from its max_update_rate_ms, persist, secure, resource_path and params,
+        // and the host via which it is served
+        utility::string_t make_subscription_key(const api_version& version, const web::json::value& data, const utility::string_t& host)
+        {
+            // the serialization of the params object is canonical since the members of a JSON object are ordered by name
+            // and the secure flag was only introduced in v1.1
+            return web::json::value_of({
+                make_api_version(version),
+                nmos::fields::max_update_rate_ms(data),
+                nmos::fields::persist(data),
+                nmos::is04_versions::v1_0 != version ? web::json::value::boolean(nmos::fields::secure(data)) : web::json::value::null(),
+                nmos::fields::resource_path(data),
+                nmos::fields::params(data),
+                host
+            }).serialize();
+        }
+
+        // get a string property of the resource data, or an empty string if the property is missing or isn't a string
+        const utility::string_t& extract_string_property(const web::json::value& data, const utility::string_t& key)
+        {
+            static const utility::string_t no_property;
+            if (!data.is_object()) return no_property;
+            const auto& object = data.as_object();
+            const auto found = object.find(key);
+            return object.end() != found && found->second.is_string() ? found->second.as_string() : no_property;
+        }
+
         // return true if the resource is "erased" but not forgotten
         bool is_erased_resource(const resources& resources, const std::pair<id, type>& id_type)
         {
@@ -403,4 +1042,94 @@ namespace nmos
             return resources.end() != resource && id_type.second == resource->type && !resource->has_data();
         }
     }
+
+    namespace experimental
+    {
+        namespace details
+        {
+            // the approximate number of bytes used by the value, each of which (other than null) has a separately allocated implementation
+            static std::size_t approximate_memory_usage(const web::json::value& value)
+            {
+                std::size_t bytes = sizeof(web::json::value);
+                switch (value.type())
+                {
+                case web::json::value::Null:
+                    break;
+                case web::json::value::String:
+                    bytes += 2 * sizeof(void*) + sizeof(utility::string_t) + value.as_string().size() * sizeof(utility::char_t);
+                    break;
+                case web::json::value::Array:
+                    bytes += 2 * sizeof(void*) + sizeof(std::vector<web::json::value>);
+                    for (const auto& element : value.as_array())
+                    {
+                        bytes += approximate_memory_usage(element);
+                    }
+                    break;
+                case web::json::value::Object:
+                    bytes += 2 * sizeof(void*) + sizeof(std::vector<std::pair<utility::string_t, web::json::value>>);
+                    for (const auto& field : value.as_object())
+                    {
+                        bytes += sizeof(utility::string_t) + field.first.size() * sizeof(utility::char_t) + approximate_memory_usage(field.second);
+                    }
+                    break;
+                default:
+                    bytes += 2 * sizeof(void*) + sizeof(double);
+                    break;
+                }
+                return bytes;
+            }
+        }
+
+        // the approximate number of bytes used by the json value, e.g. the data of a resource or log event
+        std::size_t approximate_memory_usage(const web::json::value& value)
+        {
+            return details::approximate_memory_usage(value);
+        }
+
+        // the approximate number of bytes used by the resource, including its data, sub-resource ids and index overhead
+        std::size_t approximate_memory_usage(const resource& resource)
+        {
+            // each element of a multi_index_container has a node for each of its indices, estimated at a few pointers apiece
+            const std::size_t index_overhead = boost::mpl::size<resources::index_specifier_type_list>::value * 3 * sizeof(void*);
+
+            // the entry in the super-resource's sorted vector of sub-resources is accounted to this resource, so that the accounting for the super-resource
+            // doesn't change as its sub-resources are inserted or forgotten
+            const std::size_t sub_resource_overhead = sizeof(id) + resource.id.size() * sizeof(utility::char_t);
+
+            return sizeof(nmos::resource) + index_overhead + sub_resource_overhead + sizeof(id) + resource.id.size() * sizeof(utility::char_t) + details::approximate_memory_usage(resource.data);
+        }
+
+        // the id of the node to which the resource would be accounted, i.e. the resource itself, for a node, or the node of which it is (indirectly) a sub-resource
+        // or an empty id, if there is none, e.g. for subscriptions or resources inserted out-of-order
+        id get_memory_usage_node(const resources& resources, const resource& resource)
+        {
+            if (nmos::types::node == resource.type) return resource.id;
+
+            // it won't be a very long chain...
+            auto super_id_type = get_super_resource(resource);
+            while (no_resource() != super_id_type)
+            {
+                if (nmos::types::node == super_id_type.second) return super_id_type.first;
+
+                auto found = find_resource(resources, super_id_type);
+                if (resources.end() == found) break;
+                super_id_type = get_super_resource(*found);
+            }
+            return{};
+        }
+
+        // the approximate number of bytes used by the specified node and all its sub-resources
+        std::size_t node_memory_usage(const resources& resources, const id& node_id)
+        {
+            auto found = resources.memory_usage.nodes.find(node_id);
+            return resources.memory_usage.nodes.end() != found ? found->second : 0;
+        }
+
+        // the approximate number of bytes currently accounted to the resource with the specified id (or zero, if there is none)
+        std::size_t resource_memory_usage(const resources& resources, const id& id)
+        {
+            auto found = resources.memory_usage.resources.find(id);
+            return resources.memory_usage.resources.end() != found ? found->second.first : 0;
+        }
+    }
 }
@@ -2,12 +2,25 @@
 #define NMOS_RESOURCES_H
 
 #include <functional>
+#include <iterator>
+#include <list>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <set>
+#include <tuple>
+#include <unordered_map>
+#include <vector>
 #include <boost/multi_index_container.hpp>
 #include <boost/multi_index/composite_key.hpp>
 #include <boost/multi_index/hashed_index.hpp>
 #include <boost/multi_index/member.hpp>
 #include <boost/multi_index/mem_fun.hpp>
 #include <boost/multi_index/ordered_index.hpp>
+#include <boost/version.hpp>
+#if BOOST_VERSION >= 105900
+#include <boost/multi_index/ranked_index.hpp>
+#endif
 #include "nmos/resource.h"
 
 // This declares a container type suitable for managing a node's resources, or all the resources in a registry,
@@ -23,47 +36,473 @@ namespace nmos
         struct type;
         struct created;
         struct updated;
+        struct type_created;
+        struct type_updated;
+        struct super_resource;
+        struct subscription_resource_path;
+
+        // secondary indices on common Basic Query properties
+        struct node_id;
+        struct device_id;
+        struct source_id;
+        struct flow_id;
+        struct format;
+        struct label;
     }
 
     namespace details
     {
         typedef boost::multi_index::member<resource, id, &resource::id> id_extractor;
+        // note, the resource type names are short enough that comparing them is comparable in cost to comparing interned integer values
         typedef boost::multi_index::composite_key<resource, boost::multi_index::const_mem_fun<resource, bool, &resource::has_data>, boost::multi_index::member<resource, type, &resource::type>> type_extractor;
         typedef boost::tuple<bool, type> type_extractor_tuple;
         typedef boost::multi_index::member<resource, tai, &resource::created> created_extractor;
         typedef boost::multi_index::member<resource, tai, &resource::updated> updated_extractor;
+        // the typed created/updated indices are composite indices on the type index key followed by the timestamp, in descending order
+        typedef boost::multi_index::composite_key<resource, boost::multi_index::const_mem_fun<resource, bool, &resource::has_data>, boost::multi_index::member<resource, type, &resource::type>, created_extractor> type_created_extractor;
+        typedef boost::multi_index::composite_key<resource, boost::multi_index::const_mem_fun<resource, bool, &resource::has_data>, boost::multi_index::member<resource, type, &resource::type>, updated_extractor> type_updated_extractor;
+        typedef boost::multi_index::composite_key_compare<std::less<bool>, std::less<type>, std::greater<tai>> type_timestamp_compare;
+
+        // the created/updated indices are ranked indices where available (from Boost 1.59), so that the number of resources
+        // in a range of timestamps can be determined in logarithmic rather than linear time
+        // see nmos::details::index_distance
+#if BOOST_VERSION >= 105900
+        template <typename... Args> using timestamp_unique_index = boost::multi_index::ranked_unique<Args...>;
+        template <typename... Args> using timestamp_non_unique_index = boost::multi_index::ranked_non_unique<Args...>;
+#else
+        template <typename... Args> using timestamp_unique_index = boost::multi_index::ordered_unique<Args...>;
+        template <typename... Args> using timestamp_non_unique_index = boost::multi_index::ordered_non_unique<Args...>;
+#endif
+
+        // the number of elements in the range [first, last) of one of the created/updated indices
+        template <typename Index>
+        inline std::size_t index_distance(const Index& index, typename Index::const_iterator first, typename Index::const_iterator last)
+        {
+#if BOOST_VERSION >= 105900
+            return index.rank(last) - index.rank(first);
+#else
+            return (std::size_t)std::distance(first, last);
+#endif
+        }
+
+        // the super-resource id is derived from the resource data, according to the guidelines on referential integrity
+        // see nmos::get_super_resource
+        struct super_resource_id_extractor
+        {
+            typedef id result_type;
+            result_type operator()(const resource& resource) const;
+        };
+
+        // the resource path of an extant subscription, so that insert_resource_events only needs to consider the relevant subscriptions
+        // for all other resources, the key is a value that is not a valid resource path
+        struct subscription_resource_path_extractor
+        {
+            typedef utility::string_t result_type;
+            const result_type& operator()(const resource& resource) const;
+        };
+
+        // get a string property of the resource data, or an empty string if the property is missing or isn't a string
+        const utility::string_t& extract_string_property(const web::json::value& data, const utility::string_t& key);
+
+        // the secondary indices are on string properties of the resource data
+        // resources without the property, or for which it isn't a string (e.g. a sender with a null flow_id), have an empty key
+        template <typename Tag> struct secondary_index_property;
+        template <> struct secondary_index_property<tags::node_id> { static const utility::string_t& key() { static const utility::string_t key{ U("node_id") }; return key; } };
+        template <> struct secondary_index_property<tags::device_id> { static const utility::string_t& key() { static const utility::string_t key{ U("device_id") }; return key; } };
+        template <> struct secondary_index_property<tags::source_id> { static const utility::string_t& key() { static const utility::string_t key{ U("source_id") }; return key; } };
+        template <> struct secondary_index_property<tags::flow_id> { static const utility::string_t& key() { static const utility::string_t key{ U("flow_id") }; return key; } };
+        template <> struct secondary_index_property<tags::format> { static const utility::string_t& key() { static const utility::string_t key{ U("format") }; return key; } };
+        template <> struct secondary_index_property<tags::label> { static const utility::string_t& key() { static const utility::string_t key{ U("label") }; return key; } };
+
+        template <typename Tag>
+        struct secondary_index_extractor
+        {
+            typedef utility::string_t result_type;
+            const result_type& operator()(const resource& resource) const { return extract_string_property(resource.data, secondary_index_property<Tag>::key()); }
+        };
+
+        template <typename Tag>
+        using secondary_index = boost::multi_index::hashed_non_unique<boost::multi_index::tag<Tag>, secondary_index_extractor<Tag>>;
 
         // extant resources have non-null data
         inline type_extractor_tuple has_data(const type& type) { return type_extractor_tuple{ true, type }; }
     }
 
-    // the id index ensures resource id is unique
-    // the type index is a composite index incorporating whether the resource has been deleted or expired
-    // the created/updated indices ensure uniqueness to satisfy the requirements of Query API cursor-based paging
-    // and are in descending order to simplify implementation
-    typedef boost::multi_index_container<
-        resource,
-        boost::multi_index::indexed_by<
-            boost::multi_index::hashed_unique<boost::multi_index::tag<tags::id>, details::id_extractor>,
-            boost::multi_index::ordered_non_unique<boost::multi_index::tag<tags::type>, details::type_extractor>,
-            boost::multi_index::ordered_unique<boost::multi_index::tag<tags::created>, details::created_extractor, std::greater<details::created_extractor::result_type>>,
-            boost::multi_index::ordered_unique<boost::multi_index::tag<tags::updated>, details::updated_extractor, std::greater<details::updated_extractor::result_type>>
-        >
-    > resources;
+    namespace details
+    {
+        // the id index ensures resource id is unique
+        // the type index is a composite index incorporating whether the resource has been deleted or expired
+        // the created/updated indices ensure uniqueness to satisfy the requirements of Query API cursor-based paging
+        // and are in descending order to simplify implementation
+        // the typed created/updated indices have the same order within each type, so that paging through the resources of one type skips all the others
+        // the super-resource index is a reverse index to find the sub-resources of a resource, e.g. inserted out-of-order
+        // the subscription resource path index is used to find the subscriptions which may match a resource event
+        // the secondary indices are used to optimise Basic Queries with an exact match on common foreign keys, etc.
+        // see nmos::resource_paging
+        typedef boost::multi_index_container<
+            resource,
+            boost::multi_index::indexed_by<
+                boost::multi_index::hashed_unique<boost::multi_index::tag<tags::id>, details::id_extractor>,
+                boost::multi_index::ordered_non_unique<boost::multi_index::tag<tags::type>, details::type_extractor>,
+                details::timestamp_unique_index<boost::multi_index::tag<tags::created>, details::created_extractor, std::greater<details::created_extractor::result_type>>,
+                details::timestamp_unique_index<boost::multi_index::tag<tags::updated>, details::updated_extractor, std::greater<details::updated_extractor::result_type>>,
+                details::timestamp_non_unique_index<boost::multi_index::tag<tags::type_created>, details::type_created_extractor, details::type_timestamp_compare>,
+                details::timestamp_non_unique_index<boost::multi_index::tag<tags::type_updated>, details::type_updated_extractor, details::type_timestamp_compare>,
+                boost::multi_index::hashed_non_unique<boost::multi_index::tag<tags::super_resource>, details::super_resource_id_extractor>,
+                boost::multi_index::hashed_non_unique<boost::multi_index::tag<tags::subscription_resource_path>, details::subscription_resource_path_extractor>,
+                details::secondary_index<tags::node_id>,
+                details::secondary_index<tags::device_id>,
+                details::secondary_index<tags::source_id>,
+                details::secondary_index<tags::flow_id>,
+                details::secondary_index<tags::format>,
+                details::secondary_index<tags::label>
+            >
+        > resources_container;
+
+        // since resource health is mutable, and may be modified with only a shared/read lock, it cannot be a key of the multi_index_container,
+        // so this side index is used to keep track of the least healthy resources, to avoid a full scan on each wake-up of the expiry thread
+        // it is protected by its own mutex, and kept up to date by set_resource_health and the other resource operations;
+        // entries for resources that are forgotten, or whose health is modified some other way, become stale, and are purged lazily
+        // see nmos::least_health, nmos::erase_expired_resources and nmos::forget_erased_resources
+        struct health_index
+        {
+            typedef std::set<std::pair<health, id>> entries_type;
+
+            health_index() {}
+            health_index(const health_index& other)
+            {
+                std::lock_guard<std::mutex> lock(other.mutex);
+                extant = other.extant;
+                non_extant = other.non_extant;
+            }
+            health_index& operator=(const health_index& other)
+            {
+                if (this != &other)
+                {
+                    health_index copy(other);
+                    std::lock_guard<std::mutex> lock(mutex);
+                    extant.swap(copy.extant);
+                    non_extant.swap(copy.non_extant);
+                }
+                return *this;
+            }
+
+            mutable std::mutex mutex;
+
+            // extant resources with health_forever are never included, but non-extant ones are, so that they can be forgotten
+            entries_type extant;
+            entries_type non_extant;
+        };
+    }
+
+    namespace details
+    {
+        // since a registry may serve the same unchanged resources to many clients, forms of the (downgraded) resource data are cached,
+        // keyed by resource id and by the Query API version, client's downgrade version, strip flag and projected fields (if any)
+        // entries are only valid while the resource update timestamp is unchanged, and are removed when resources are erased or forgotten;
+        // it is protected by its own mutex, since it is populated with only a shared/read lock on the resources
+        template <typename Form>
+        struct resource_variant_cache
+        {
+            typedef std::tuple<api_version, api_version, bool, std::vector<utility::string_t>> variant_type;
+            typedef std::pair<tai, std::shared_ptr<const Form>> entry_type;
+            typedef std::unordered_map<id, std::map<variant_type, entry_type>> entries_type;
+
+            resource_variant_cache() {}
+            resource_variant_cache(const resource_variant_cache& other)
+            {
+                std::lock_guard<std::mutex> lock(other.mutex);
+                entries = other.entries;
+            }
+            resource_variant_cache& operator=(const resource_variant_cache& other)
+            {
+                if (this != &other)
+                {
+                    resource_variant_cache copy(other);
+                    std::lock_guard<std::mutex> lock(mutex);
+                    entries.swap(copy.entries);
+                }
+                return *this;
+            }
+
+            mutable std::mutex mutex;
+
+            entries_type entries;
+        };
+
+        // the serialized (UTF-8) form of the (downgraded) resource data
+        // see nmos::details::serialize_downgrade
+        typedef resource_variant_cache<std::string> serialization_cache;
+
+        // the downgraded resource data, for resources of a higher version than the Query API version, used e.g. for websocket 'sync' events
+        // see nmos::details::downgrade
+        typedef resource_variant_cache<web::json::value> downgrade_cache;
+    }
+
+    struct resource_query;
+    struct event_queues;
+
+    namespace experimental
+    {
+        class resource_journal;
+    }
+
+    namespace details
+    {
+        // the query for each subscription is parsed just once, rather than for every resource event
+        // entries are keyed by subscription id, are only valid for the subscription with the same creation timestamp,
+        // and are removed when the subscription is erased or forgotten
+        // since it is only used when resource events are being inserted, it is protected by the exclusive/write lock on the resources
+        // see nmos::insert_resource_events
+        typedef std::unordered_map<id, std::pair<tai, std::shared_ptr<const resource_query>>> subscription_query_cache;
+
+        // since clients tend to repeat the same few queries, the query for each distinct combination of Query API version, resource path and query parameters
+        // (other than the paging parameters) is parsed and compiled just once, and shared by the Query API requests and subscriptions, up to a limited number of the most recently used
+        // it is protected by its own mutex, since it is used with only a shared/read lock on the resources
+        // see nmos::details::get_resource_query
+        struct resource_query_cache
+        {
+            typedef std::list<utility::string_t> usage_type; // most recently used first
+            typedef std::unordered_map<utility::string_t, std::pair<std::shared_ptr<const resource_query>, usage_type::iterator>> entries_type;
+
+            resource_query_cache() : capacity(256) {}
+            // a copy starts out empty, since a cache can always be repopulated
+            resource_query_cache(const resource_query_cache& other) : capacity(other.capacity) {}
+            resource_query_cache& operator=(const resource_query_cache& other)
+            {
+                if (this != &other)
+                {
+                    std::lock_guard<std::mutex> lock(mutex);
+                    capacity = other.capacity;
+                    usage.clear();
+                    entries.clear();
+                }
+                return *this;
+            }
+
+            mutable std::mutex mutex;
+
+            std::size_t capacity;
+            usage_type usage;
+            entries_type entries;
+        };
+
+        // a fully serialized Query API response page, i.e. the UTF-8 response body, its entity-tag, and the paging headers, etc.
+        struct query_page
+        {
+            std::string body;
+            utility::string_t entity_tag;
+            std::vector<std::pair<utility::string_t, utility::string_t>> headers;
+        };
+
+        // since many clients tend to make the same list requests, the serialized page for each distinct combination of request URI (including the paging parameters)
+        // and host is cached, up to a limited number of the most recently used; since a page only depends on the resources of one type, entries are only valid
+        // while the watermark of that type, which is advanced whenever a resource of that type is inserted, modified, erased or expired, is unchanged
+        // it is protected by its own mutex, so that a cached page can be found and served without any lock on the resources
+        // see nmos::details::find_query_page and nmos::details::insert_query_page
+        struct query_page_cache
+        {
+            typedef std::list<utility::string_t> usage_type; // most recently used first
+            struct entry_type
+            {
+                nmos::type type;
+                tai watermark;
+                std::shared_ptr<const query_page> page;
+                usage_type::iterator usage;
+            };
+            typedef std::unordered_map<utility::string_t, entry_type> entries_type;
+
+            query_page_cache() {}
+            // a copy starts out empty, with no watermarks, since a cache can always be repopulated
+            query_page_cache(const query_page_cache&) {}
+            query_page_cache& operator=(const query_page_cache& other)
+            {
+                if (this != &other)
+                {
+                    std::lock_guard<std::mutex> lock(mutex);
+                    watermarks.clear();
+                    usage.clear();
+                    entries.clear();
+                }
+                return *this;
+            }
+
+            mutable std::mutex mutex;
+
+            std::map<nmos::type, tai> watermarks;
+            usage_type usage;
+            entries_type entries;
+        };
+
+        // experimental extension, the pre-serialized representations of individual resources, e.g. the Events API /state and /type responses of each source,
+        // which are discarded whenever the resource is modified or erased, so that high-rate polling can be served without any lock on the resources
+        // it is protected by its own mutex, like the query page cache
+        // see nmos::details::find_resource_view and nmos::details::insert_resource_view
+        struct resource_view_cache
+        {
+            typedef std::map<std::pair<nmos::id, utility::string_t>, std::shared_ptr<const query_page>> views_type;
+
+            resource_view_cache() {}
+            // a copy starts out empty, since a cache can always be repopulated
+            resource_view_cache(const resource_view_cache&) {}
+            resource_view_cache& operator=(const resource_view_cache& other)
+            {
+                if (this != &other)
+                {
+                    std::lock_guard<std::mutex> lock(mutex);
+                    views.clear();
+                }
+                return *this;
+            }
+
+            mutable std::mutex mutex;
+
+            views_type views;
+        };
+
+        // get the current watermark of the resources of the specified type, for a new entry in the query page cache
+        // note, the shared/read lock on the resources must be held while the page is built, so that the watermark is consistent with it
+        tai get_query_page_watermark(const nmos::resources& resources, const nmos::type& type);
+
+        // find the page with the specified key in the query page cache, if it's still valid; this doesn't require any lock on the resources
+        std::shared_ptr<const query_page> find_query_page(const nmos::resources& resources, const utility::string_t& key);
+
+        // insert the page into the query page cache, evicting the least recently used entries to keep to the specified capacity
+        void insert_query_page(const nmos::resources& resources, utility::string_t key, const nmos::type& type, const tai& watermark, std::shared_ptr<const query_page> page, std::size_t capacity);
+
+        // find the specified view of the resource with the specified id, if it's still valid; this doesn't require any lock on the resources
+        std::shared_ptr<const query_page> find_resource_view(const nmos::resources& resources, const nmos::id& id, const utility::string_t& view);
+
+        // insert the specified view of the resource with the specified id
+        // note, the shared/read lock on the resources must be held while the view is built and inserted, so that it's consistent with the resource
+        void insert_resource_view(const nmos::resources& resources, const nmos::id& id, const utility::string_t& view, std::shared_ptr<const query_page> page);
+
+        // discard the views of the resource with the specified id; this is done by nmos::modify_resource, etc., but must also be done by anything
+        // that modifies a resource directly, such as nmos::experimental::publish_events_state
+        void erase_resource_views(const nmos::resources& resources, const nmos::id& id);
+
+        // the extant subscriptions, by a canonical key of the properties which determine whether a Query API subscription request
+        // matches an existing subscription, so that one can be found without a scan and comparing each one's data
+        // (and the key of each subscription, by subscription id, so that entries can be removed when the subscription is erased)
+        // since it is only updated when resources are inserted, modified, erased and forgotten, it is protected by the exclusive/write lock on the resources
+        // see nmos::details::make_subscription_key
+        struct subscription_key_index
+        {
+            std::unordered_map<utility::string_t, id> ids;
+            std::unordered_map<id, utility::string_t> keys;
+        };
+
+        // make the canonical key for a subscription of the specified API version, from its max_update_rate_ms, persist, secure, resource_path and params,
+        // and the host via which it is served
+        utility::string_t make_subscription_key(const api_version& version, const web::json::value& data, const utility::string_t& host);
+
+        // the extant resources with each tag name and value, e.g. a group hint, so that a Basic Query or RQL query on tags can find its candidates without a scan
+        // (and the tag names and values of each resource, by resource id, so that entries can be removed when the resource is modified or erased)
+        // since it is only updated when resources are inserted, modified, erased and forgotten, it is protected by the exclusive/write lock on the resources
+        // see nmos::details::find_tagged_resources
+        struct tag_index
+        {
+            typedef std::pair<utility::string_t, utility::string_t> key_type;
+
+            std::map<key_type, std::set<id>> ids;
+            std::unordered_map<id, std::vector<key_type>> keys;
+        };
+
+        // the ids of the extant resources with the specified tag name and value
+        const std::set<id>& find_tagged_resources(const nmos::resources& resources, const utility::string_t& name, const utility::string_t& value);
+
+        // the extant receivers for each format and media type that their caps admit, so that a query for the receivers that can accept a flow can find its candidates
+        // without a scan; receivers that don't constrain the media types of their format are indexed with an empty media type
+        // (and the formats and media types of each receiver, by resource id, so that entries can be removed when the receiver is modified or erased)
+        // since it is only updated when resources are inserted, modified, erased and forgotten, it is protected by the exclusive/write lock on the resources
+        // see nmos::details::find_compatible_receivers
+        struct receiver_compatibility_index
+        {
+            typedef std::pair<utility::string_t, utility::string_t> key_type;
+
+            std::map<key_type, std::set<id>> ids;
+            std::unordered_map<id, std::vector<key_type>> keys;
+        };
+
+        // the ids of the extant receivers that can accept a flow of the specified format and media type (or any media type of the format, if empty) according to their caps
+        std::set<id> find_compatible_receivers(const nmos::resources& resources, const utility::string_t& format, const utility::string_t& media_type);
+
+        // the approximate memory usage of the resources, in total and by node, kept up to date as resources are inserted, modified, erased and forgotten
+        // each resource is accounted to the node of which it is (indirectly) a sub-resource, determined when it is inserted
+        // since it is only updated by those operations, it is protected by the exclusive/write lock on the resources
+        // see nmos::experimental::approximate_memory_usage
+        struct memory_usage_index
+        {
+            std::size_t total = 0;
+
+            // bytes and node id, by resource id
+            std::unordered_map<id, std::pair<std::size_t, id>> resources;
+
+            // bytes, by node id
+            std::unordered_map<id, std::size_t> nodes;
+        };
+
+        // the number of extant resources of each type and API version, kept up to date as resources are inserted and erased,
+        // so that e.g. the Query API can count the resources of a type without a scan
+        // (and likewise the number of non-extant resources, i.e. those which have been "erased" but not yet forgotten)
+        // since it is only updated by those operations, it is protected by the exclusive/write lock on the resources
+        typedef std::map<std::pair<type, api_version>, std::size_t> resource_counts;
+    }
+
+    // the multi_index_container, with the additional health index and caches
+    struct resources : details::resources_container
+    {
+        // since health is mutable, so is the health index
+        mutable details::health_index health_index;
+
+        // the cache is logically const, so is also mutable
+        mutable details::serialization_cache serialization_cache;
+        mutable details::downgrade_cache downgrade_cache;
+
+        // the cache is logically const, so is also mutable
+        mutable details::resource_query_cache query_cache;
+
+        // the cache is logically const, so is also mutable
+        mutable details::query_page_cache page_cache;
+
+        // the cache is logically const, so is also mutable
+        mutable details::resource_view_cache view_cache;
+
+        details::subscription_query_cache subscription_queries;
+
+        details::subscription_key_index subscription_keys;
+
+        details::tag_index tagged_resources;
+
+        details::receiver_compatibility_index compatible_receivers;
+
+        details::memory_usage_index memory_usage;
+
+        details::resource_counts counts;
+        details::resource_counts non_extant_counts;
+
+        // if set, every resource insertion, modification and erasure is appended to the journal, exactly once, with the exclusive/write lock held
+        // see nmos::experimental::resource_journal
+        std::shared_ptr<experimental::resource_journal> journal;
+
+        // if set, the resource events for the websocket connections to subscriptions are pushed into the event queues
+        // see nmos::event_queues
+        std::shared_ptr<nmos::event_queues> event_queues;
+    };
 
     // Resource creation/update/deletion operations
 
     // returns the most recent timestamp in the specified resources
     tai most_recent_update(const resources& resources);
 
-    inline tai strictly_increasing_update(const resources& resources, tai update = tai_now())
+    inline tai strictly_increasing_update(const resources& resources, tai update = tai_coarse_now())
     {
         const auto most_recent = most_recent_update(resources);
         return update > most_recent ? update : tai_from_time_point(time_point_from_tai(most_recent) + tai_clock::duration(1));
     }
 
     // returns the least health of extant and non-extant resources
-    // note, this is now O(N), not O(1), since resource health is mutable and therefore unindexed
+    // note, since resource health is mutable, this relies on the health index rather than the multi_index_container indices
     std::pair<health, health> least_health(const resources& resources);
 
     // insert a resource (join_sub_resources can be false if related resources are known to be inserted in order)
@@ -92,6 +531,13 @@ namespace nmos
     // note, since health is mutable, no need for the resources parameter to be non-const
     void set_resource_health(const resources& resources, const id& id, health health = health_now());
 
+    namespace details
+    {
+        // set the health of the specified resource (but none of its sub-resources), keeping the health index up to date
+        // note, like set_resource_health, this only requires a shared/read lock on the resources
+        void set_resource_health(const resources& resources, const resource& resource, health health);
+    }
+
     // Other helper functions for resources
 
     // get the super-resource id and type, according to the guidelines on referential integrity
@@ -127,8 +573,42 @@ namespace nmos
     resources::const_iterator find_self_resource(const resources& resources);
     resources::iterator find_self_resource(resources& resources);
 
+    // the number of extant resources of the specified type, of any API version, from the maintained resource counts, i.e. without a scan
+    std::size_t count_resources(const resources& resources, const type& type);
+
+    // the number of extant resources of all types, from the maintained resource counts
+    std::size_t count_resources(const resources& resources);
+
+    // the number of non-extant resources of the specified type, i.e. those which have been "erased" but not yet forgotten, from the maintained resource counts
+    std::size_t count_non_extant_resources(const resources& resources, const type& type);
+
+    // the number of non-extant resources of all types, from the maintained resource counts
+    std::size_t count_non_extant_resources(const resources& resources);
+
     // get the id of each resource with the specified super-resource
-    std::set<nmos::id> get_sub_resources(const resources& resources, const std::pair<id, type>& id_type);
+    resource::sub_resources_type get_sub_resources(const resources& resources, const std::pair<id, type>& id_type);
+
+    namespace experimental
+    {
+        // the approximate number of bytes used by the json value, e.g. the data of a resource or log event
+        std::size_t approximate_memory_usage(const web::json::value& value);
+
+        // the approximate number of bytes used by the resource, including its data, sub-resource ids and index overhead
+        std::size_t approximate_memory_usage(const resource& resource);
+
+        // the id of the node to which the resource would be accounted, i.e. the resource itself, for a node, or the node of which it is (indirectly) a sub-resource
+        // or an empty id, if there is none, e.g. for subscriptions or resources inserted out-of-order
+        id get_memory_usage_node(const resources& resources, const resource& resource);
+
+        // the approximate number of bytes used by all the resources
+        inline std::size_t memory_usage(const resources& resources) { return resources.memory_usage.total; }
+
+        // the approximate number of bytes used by the specified node and all its sub-resources
+        std::size_t node_memory_usage(const resources& resources, const id& node_id);
+
+        // the approximate number of bytes currently accounted to the resource with the specified id (or zero, if there is none)
+        std::size_t resource_memory_usage(const resources& resources, const id& id);
+    }
 
     namespace details
     {
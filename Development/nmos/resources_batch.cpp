@@ -0,0 +1,94 @@
+#include "nmos/resources_batch.h"
+
+#include <algorithm>
+#include "nmos/model.h"
+#include "nmos/slog.h"
+
+namespace nmos
+{
+    namespace experimental
+    {
+        namespace details
+        {
+            // insert each resource, or replace the data of an existing resource, and return the number of failures
+            static std::size_t insert_resources(nmos::resources& resources, std::vector<nmos::resource>& batch, slog::base_gate& gate)
+            {
+                std::size_t failures = 0;
+                for (auto& resource : batch)
+                {
+                    const std::pair<nmos::id, nmos::type> id_type{ resource.id, resource.type };
+
+                    auto found = nmos::find_resource(resources, id_type);
+                    const bool success = resources.end() != found
+                        ? nmos::modify_resource(resources, resource.id, [&resource](nmos::resource& modified) { modified.data = std::move(resource.data); })
+                        : nmos::insert_resource(resources, std::move(resource)).second;
+
+                    if (success)
+                        slog::log<slog::severities::more_info>(gate, SLOG_FLF) << "Updated model with " << id_type;
+                    else
+                    {
+                        slog::log<slog::severities::severe>(gate, SLOG_FLF) << "Model update error: " << id_type;
+                        ++failures;
+                    }
+                }
+                batch.clear();
+                return failures;
+            }
+        }
+
+        std::size_t insert_resources(nmos::node_model& model, node_resources_batch&& batch, slog::base_gate& gate)
+        {
+            if (batch.empty()) return 0;
+
+            const auto count = batch.node_resources.size() + batch.connection_resources.size() + batch.events_resources.size();
+
+            const auto failures = details::insert_resources(model.node_resources, batch.node_resources, gate)
+                + details::insert_resources(model.connection_resources, batch.connection_resources, gate)
+                + details::insert_resources(model.events_resources, batch.events_resources, gate);
+
+            slog::log<slog::severities::info>(gate, SLOG_FLF) << "Updated model with " << count - failures << " of " << count << " resources";
+
+            slog::log<slog::severities::too_much_info>(gate, SLOG_FLF) << "Notifying node behaviour thread"; // and anyone else who cares...
+            model.notify();
+
+            return failures;
+        }
+
+        void resources_transaction::modify(nmos::resources& resources, const nmos::id& id, modifier modifier)
+        {
+            auto found = std::find_if(staged.begin(), staged.end(), [&](const staged_modification& modification)
+            {
+                return &resources == modification.resources && id == modification.id;
+            });
+            if (staged.end() == found)
+            {
+                found = staged.insert(staged.end(), staged_modification{ &resources, id, {} });
+            }
+            found->modifiers.push_back(std::move(modifier));
+        }
+
+        std::size_t resources_transaction::commit(nmos::base_model& model)
+        {
+            std::vector<staged_modification> committing;
+            committing.swap(staged);
+
+            std::size_t failures = 0;
+            for (auto& modification : committing)
+            {
+                const auto& modifiers = modification.modifiers;
+                const bool success = nmos::modify_resource(*modification.resources, modification.id, [&modifiers](nmos::resource& resource)
+                {
+                    for (const auto& modifier : modifiers)
+                    {
+                        modifier(resource);
+                    }
+                });
+                if (!success) ++failures;
+            }
+
+            if (committing.size() != failures) model.notify();
+
+            return failures;
+        }
+    }
+}
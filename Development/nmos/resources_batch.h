@@ -0,0 +1,72 @@
+#ifndef NMOS_RESOURCES_BATCH_H
+#define NMOS_RESOURCES_BATCH_H
+
+#include <functional>
+#include <vector>
+#include "nmos/resources.h"
+
+namespace slog
+{
+    class base_gate;
+}
+
+// This is an experimental extension to update the resources of a model all at once, e.g. for a device with hundreds of senders and receivers
+namespace nmos
+{
+    struct base_model;
+    struct node_model;
+
+    namespace experimental
+    {
+        // the node (IS-04), connection (IS-05) and events (IS-07) resources to be inserted into a node model together
+        // a resource with the same id as an existing resource replaces its data
+        struct node_resources_batch
+        {
+            std::vector<nmos::resource> node_resources;
+            std::vector<nmos::resource> connection_resources;
+            std::vector<nmos::resource> events_resources;
+
+            bool empty() const { return node_resources.empty() && connection_resources.empty() && events_resources.empty(); }
+        };
+
+        // insert or modify the batched resources in the node model, in the order given, so super-resources must precede their sub-resources,
+        // and then notify the other threads just once, and return the number of resources that couldn't be inserted (which is logged)
+        // since the caller holds the exclusive/write lock on the model throughout, the batch is applied atomically, with consecutive update
+        // timestamps, and the node behaviour finds all the resource events together, so they can be registered in bulk requests
+        // (see nmos::experimental::fields::registration_bulk_limit) and the 'ver_' TXT records are updated once
+        std::size_t insert_resources(nmos::node_model& model, node_resources_batch&& batch, slog::base_gate& gate);
+
+        // modifications of resources in one or more of the containers of a model, e.g. an IS-05 connection resource and the corresponding IS-04 resource
+        // which are staged, and then committed together; successive modifications of the same resource are combined, so that it is only modified once,
+        // with one update timestamp and one resource event
+        class resources_transaction
+        {
+        public:
+            typedef std::function<void(nmos::resource&)> modifier;
+
+            // stage a modification of the resource with the specified id in the specified resources, which must be in the model for which this is committed
+            void modify(nmos::resources& resources, const nmos::id& id, modifier modifier);
+
+            bool empty() const { return staged.empty(); }
+            // the number of resources with staged modifications
+            std::size_t size() const { return staged.size(); }
+
+            // apply the staged modifications, in the order in which each resource was first staged, and then notify the other threads just once,
+            // and return the number of resources that weren't found (or are no longer extant); the caller holds the exclusive/write lock on the model
+            // throughout, so the intermediate states are never visible to observers
+            std::size_t commit(nmos::base_model& model);
+
+        private:
+            struct staged_modification
+            {
+                nmos::resources* resources;
+                nmos::id id;
+                std::vector<modifier> modifiers;
+            };
+
+            std::vector<staged_modification> staged;
+        };
+    }
+}
+
+#endif
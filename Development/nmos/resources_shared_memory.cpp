@@ -0,0 +1,198 @@
+#include "nmos/resources_shared_memory.h"
+
+#include <cstring>
+#include <new>
+#include <stdexcept>
+#include <thread>
+#include <boost/interprocess/mapped_region.hpp>
+#include <boost/interprocess/shared_memory_object.hpp>
+#include "nmos/model.h"
+#include "nmos/registry_snapshot.h" // for nmos::experimental::details::write_snapshot
+#include "nmos/slog.h"
+#include "nmos/thread_utils.h" // for reverse_lock_guard
+
+namespace nmos
+{
+    namespace experimental
+    {
+        namespace details
+        {
+            void init_shared_memory(shared_memory_header& header, std::uint64_t capacity)
+            {
+                header.format = shared_memory_format;
+                header.closed.store(0, std::memory_order_relaxed);
+                header.capacity = capacity;
+                header.sequence.store(0, std::memory_order_relaxed);
+                header.size.store(0, std::memory_order_relaxed);
+                header.change_counter.store(0, std::memory_order_relaxed);
+
+                // the magic is written last, so a reader that opens the region before it has been initialized doesn't recognise it
+                std::atomic_thread_fence(std::memory_order_release);
+                std::memcpy(header.magic, shared_memory_magic, sizeof(header.magic));
+            }
+
+            bool write_shared_memory(shared_memory_header& header, const std::string& snapshot)
+            {
+                if (header.capacity < snapshot.size()) return false;
+
+                // there's only one writer, so the sequence number can be incremented non-atomically
+                const auto sequence = header.sequence.load(std::memory_order_relaxed);
+                header.sequence.store(sequence + 1, std::memory_order_relaxed);
+                std::atomic_thread_fence(std::memory_order_release);
+
+                std::memcpy(shared_memory_payload(header), snapshot.data(), snapshot.size());
+                header.size.store(snapshot.size(), std::memory_order_relaxed);
+                header.change_counter.store(header.change_counter.load(std::memory_order_relaxed) + 1, std::memory_order_relaxed);
+
+                header.sequence.store(sequence + 2, std::memory_order_release);
+                return true;
+            }
+
+            // the publisher's read-write shared memory region, which is removed when the publisher shuts down, though any readers
+            // that have it open can still read the final snapshot
+            class shared_memory_publisher
+            {
+            public:
+                shared_memory_publisher(const std::string& name, std::uint64_t capacity)
+                    : name(name)
+                {
+                    // a region left behind by a publisher that didn't shut down cleanly is replaced
+                    boost::interprocess::shared_memory_object::remove(name.c_str());
+                    shared_memory = boost::interprocess::shared_memory_object(boost::interprocess::create_only, name.c_str(), boost::interprocess::read_write);
+                    shared_memory.truncate(boost::interprocess::offset_t(sizeof(shared_memory_header) + capacity));
+                    region = boost::interprocess::mapped_region(shared_memory, boost::interprocess::read_write);
+                    header = new (region.get_address()) shared_memory_header;
+                    init_shared_memory(*header, capacity);
+                }
+
+                ~shared_memory_publisher()
+                {
+                    header->closed.store(1, std::memory_order_release);
+                    boost::interprocess::shared_memory_object::remove(name.c_str());
+                }
+
+                bool publish(const std::string& snapshot)
+                {
+                    return write_shared_memory(*header, snapshot);
+                }
+
+            private:
+                std::string name;
+                boost::interprocess::shared_memory_object shared_memory;
+                boost::interprocess::mapped_region region;
+                shared_memory_header* header;
+            };
+        }
+
+        void publish_resources_shared_memory_thread(nmos::base_model& model, const nmos::resources& resources, slog::base_gate& gate_)
+        {
+            nmos::details::omanip_gate gate(gate_, nmos::categories::publish_resources_shared_memory);
+
+            // only a shared/read lock is required to serialize the resources
+            auto lock = model.read_lock();
+
+            const auto name = utility::us2s(nmos::experimental::fields::resources_shared_memory_name(model.settings));
+            if (name.empty()) return;
+
+            const auto capacity = nmos::experimental::fields::resources_shared_memory_size(model.settings);
+            const auto interval = std::chrono::milliseconds(nmos::experimental::fields::resources_shared_memory_interval(model.settings));
+
+            std::unique_ptr<details::shared_memory_publisher> publisher;
+            try
+            {
+                publisher.reset(new details::shared_memory_publisher(name, capacity));
+            }
+            catch (const std::exception& e)
+            {
+                slog::log<slog::severities::error>(gate, SLOG_FLF) << "Failed to create shared memory: " << name << ": " << e.what();
+                return;
+            }
+
+            slog::log<slog::severities::info>(gate, SLOG_FLF) << "Publishing resources to shared memory: " << name;
+
+            // the serialization of each resource is reused until it is updated
+            details::snapshot_cache cache;
+            std::string snapshot;
+
+            // the first snapshot is published straight away, even if there are no resources yet
+            bool published = false;
+            tai most_recent_published{};
+            auto earliest_publish = std::chrono::steady_clock::now();
+
+            for (;;)
+            {
+                model.wait(lock, [&] { return model.shutdown || !published || most_recent_published < most_recent_update(resources); });
+                if (model.shutdown) break;
+
+                // changes are coalesced, so that a burst of changes, e.g. a registration storm, results in one snapshot per interval
+                if (model.wait_until(lock, earliest_publish, [&] { return model.shutdown; })) break;
+
+                most_recent_published = most_recent_update(resources);
+                published = true;
+
+                snapshot.clear();
+                details::write_snapshot(snapshot, resources, cache);
+
+                // the snapshot is copied into the shared memory without the lock
+                nmos::details::reverse_lock_guard<nmos::read_lock> unlock{ lock };
+
+                earliest_publish = std::chrono::steady_clock::now() + interval;
+
+                if (publisher->publish(snapshot))
+                {
+                    slog::log<slog::severities::too_much_info>(gate, SLOG_FLF) << "Published " << cache.size() << " resources to shared memory";
+                }
+                else
+                {
+                    slog::log<slog::severities::error>(gate, SLOG_FLF) << "Failed to publish " << cache.size() << " resources (" << snapshot.size() << " bytes) to shared memory: " << name << ", which is too small";
+                }
+            }
+
+            lock.unlock();
+            publisher.reset();
+        }
+
+        struct resources_shared_memory_reader::impl_t
+        {
+            explicit impl_t(const std::string& name)
+                : shared_memory(boost::interprocess::open_only, name.c_str(), boost::interprocess::read_only)
+                , region(shared_memory, boost::interprocess::read_only)
+            {}
+
+            boost::interprocess::shared_memory_object shared_memory;
+            boost::interprocess::mapped_region region;
+        };
+
+        resources_shared_memory_reader::resources_shared_memory_reader(const std::string& name)
+            : impl(new impl_t(name))
+            , header((const details::shared_memory_header*)impl->region.get_address())
+        {
+            if (impl->region.get_size() < sizeof(details::shared_memory_header)
+                || 0 != std::memcmp(header->magic, details::shared_memory_magic, sizeof(header->magic))
+                || details::shared_memory_format != header->format
+                || impl->region.get_size() < sizeof(details::shared_memory_header) + header->capacity)
+            {
+                throw std::runtime_error("unrecognised shared memory: " + name);
+            }
+        }
+
+        resources_shared_memory_reader::~resources_shared_memory_reader()
+        {
+        }
+
+        std::uint64_t resources_shared_memory_reader::read(std::string& snapshot) const
+        {
+            std::uint64_t change_counter = 0;
+            while (!read_in_place([&](const char* first, const char* last, std::uint64_t counter)
+            {
+                snapshot.assign(first, last);
+                change_counter = counter;
+            }))
+            {
+                // the publisher only holds the sequence lock while copying
+                std::this_thread::yield();
+            }
+            return change_counter;
+        }
+    }
+}
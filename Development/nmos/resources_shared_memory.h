@@ -0,0 +1,114 @@
+#ifndef NMOS_RESOURCES_SHARED_MEMORY_H
+#define NMOS_RESOURCES_SHARED_MEMORY_H
+
+#include <atomic>
+#include <cstdint>
+#include <memory>
+#include <string>
+
+namespace slog
+{
+    class base_gate;
+}
+
+// This is an experimental extension to publish a read-only snapshot of the resources in shared memory, so that co-located
+// consumers such as local controllers and monitoring agents can read them without polling the Query API or Node API
+// See nmos::experimental::fields::resources_shared_memory_name
+namespace nmos
+{
+    struct base_model;
+    struct resources;
+
+    namespace experimental
+    {
+        namespace details
+        {
+            // the layout of the shared memory region, this header followed by capacity bytes for the serialized resources,
+            // which are in the same line-delimited JSON format as a registry snapshot (see nmos::experimental::details::write_snapshot)
+            // the serialized resources are protected by a sequence lock, so readers never block the publisher, nor each other
+            struct shared_memory_header
+            {
+                // identifies the format, in case it ever needs to change
+                char magic[16];
+                std::uint32_t format;
+
+                // set when the publisher has shut down, after which the snapshot is never updated again
+                std::atomic<std::uint32_t> closed;
+
+                std::uint64_t capacity;
+
+                // odd while the serialized resources are being written
+                std::atomic<std::uint64_t> sequence;
+
+                // the size of the serialized resources
+                std::atomic<std::uint64_t> size;
+
+                // incremented each time the snapshot is published, i.e. each time the resources have changed
+                std::atomic<std::uint64_t> change_counter;
+            };
+
+            const char shared_memory_magic[16] = "nmos_resources";
+            const std::uint32_t shared_memory_format = 1;
+
+            // initialize the header of a region
+            void init_shared_memory(shared_memory_header& header, std::uint64_t capacity);
+
+            // write the serialized resources, following the header, and return false if they don't fit
+            bool write_shared_memory(shared_memory_header& header, const std::string& snapshot);
+
+            inline const char* shared_memory_payload(const shared_memory_header& header) { return (const char*)(&header + 1); }
+            inline char* shared_memory_payload(shared_memory_header& header) { return (char*)(&header + 1); }
+
+            // call the specified function with the serialized resources in place, i.e. without copying them, and their change counter,
+            // and return whether they were consistent, i.e. whether they were not being written at the same time; if not, whatever the function
+            // made of them must be discarded, so it mustn't assume they are valid (e.g. must catch parse errors)
+            template <typename Read>
+            inline bool read_shared_memory(const shared_memory_header& header, Read read)
+            {
+                const auto sequence = header.sequence.load(std::memory_order_acquire);
+                if (0 != sequence % 2) return false;
+
+                const auto size = header.size.load(std::memory_order_relaxed);
+                if (header.capacity < size) return false;
+                const auto payload = shared_memory_payload(header);
+                read(payload, payload + size, header.change_counter.load(std::memory_order_relaxed));
+
+                std::atomic_thread_fence(std::memory_order_acquire);
+                return header.sequence.load(std::memory_order_relaxed) == sequence;
+            }
+        }
+
+        // publish a snapshot of the specified resources to the configured shared memory region (if any), each time they change,
+        // but no more often than the configured interval, until the server is shut down; the resources are serialized with
+        // only the shared/read lock held and copied into the region without the lock
+        void publish_resources_shared_memory_thread(nmos::base_model& model, const nmos::resources& resources, slog::base_gate& gate);
+
+        // a co-located consumer of the published snapshot
+        class resources_shared_memory_reader
+        {
+        public:
+            // open the named shared memory region, read-only; throws if it doesn't exist, or isn't a snapshot of the resources
+            explicit resources_shared_memory_reader(const std::string& name);
+            ~resources_shared_memory_reader();
+
+            // see nmos::experimental::details::read_shared_memory
+            template <typename Read>
+            bool read_in_place(Read read) const { return details::read_shared_memory(*header, read); }
+
+            // copy the serialized resources, retrying while they are being written, and return their change counter
+            std::uint64_t read(std::string& snapshot) const;
+
+            std::uint64_t change_counter() const { return header->change_counter.load(std::memory_order_acquire); }
+
+            // whether the publisher has shut down, in which case the region should be opened again when it has restarted
+            bool closed() const { return 0 != header->closed.load(std::memory_order_acquire); }
+
+        private:
+            struct impl_t;
+            std::unique_ptr<impl_t> impl;
+            const details::shared_memory_header* header;
+        };
+    }
+}
+
+#endif
@@ -1,5 +1,6 @@
 #include "nmos/sdp_utils.h"
 
+#include <algorithm>
 #include <map>
 #include <boost/asio/ip/address.hpp>
 #include <boost/range/adaptor/transformed.hpp>
@@ -9,6 +10,7 @@
 #include "nmos/json_fields.h"
 #include "nmos/media_type.h"
 #include "nmos/transport.h"
+#include "sdp/sdp.h"
 
 namespace nmos
 {
@@ -678,6 +680,12 @@ namespace nmos
         {
             return std::runtime_error{ "sdp processing error - " + message };
         }
+
+        nmos::rational parse_rational(const utility::string_t& rational_string)
+        {
+            const auto slash = rational_string.find(U('/'));
+            return nmos::rational(utility::istringstreamed<uint64_t>(rational_string.substr(0, slash)), utility::string_t::npos != slash ? utility::istringstreamed<uint64_t>(rational_string.substr(slash + 1)) : 1);
+        }
     }
 
     sdp_parameters get_session_description_sdp_parameters(const web::json::value& sdp)
@@ -830,7 +838,7 @@ namespace nmos
             if (is_audio_sdp)
             {
                 if (attributes.end() == ptime) throw details::sdp_processing_error("missing attribute: ptime");
-                sdp_params.audio.packet_time = sdp::fields::value(*ptime).as_integer();
+                sdp_params.audio.packet_time = sdp::fields::value(*ptime).as_double();
             }
         }
 
@@ -854,14 +862,9 @@ namespace nmos
             if (format_specific_parameters.end() == height) throw details::sdp_processing_error("missing format parameter: height");
             sdp_params.video.height = utility::istringstreamed<uint32_t>(sdp::fields::value(*height).as_string());
 
-            auto parse_rational = [](const utility::string_t& rational_string)
-            {
-                const auto slash = rational_string.find(U('/'));
-                return nmos::rational(utility::istringstreamed<uint64_t>(rational_string.substr(0, slash)), utility::string_t::npos != slash ? utility::istringstreamed<uint64_t>(rational_string.substr(slash + 1)) : 1);
-            };
             const auto exactframerate = sdp::find_name(format_specific_parameters, sdp::fields::exactframerate);
             if (format_specific_parameters.end() == exactframerate) throw details::sdp_processing_error("missing format parameter: exactframerate");
-            sdp_params.video.exactframerate = parse_rational(sdp::fields::value(*exactframerate).as_string());
+            sdp_params.video.exactframerate = details::parse_rational(sdp::fields::value(*exactframerate).as_string());
 
             // optional
             const auto interlace = sdp::find_name(format_specific_parameters, sdp::fields::interlace);
@@ -929,6 +932,555 @@ namespace nmos
         return{ get_session_description_sdp_parameters(session_description), get_session_description_transport_params(session_description) };
     }
 
+    namespace details
+    {
+        // The specialised parser below handles the SDP files typically used by SMPTE ST 2110 senders, including those using
+        // SMPTE 2022-7, in a single pass directly to the SDP parameters and transport parameters, without the generic grammar
+        // or the json representation. It only accepts a strict subset of the SDP syntax, and gives up on anything else, such as
+        // other types of line, unusual attributes or anything that might be a parse or processing error, leaving the generic
+        // grammar to handle, or report, it.
+
+        struct fast_sdp_unsupported {};
+
+        inline void fast_sdp_require(bool condition)
+        {
+            if (!condition) throw fast_sdp_unsupported{};
+        }
+
+        // return the non-empty substring from pos to the delimiter (or end) and set pos to after the delimiter (or npos)
+        std::string fast_sdp_token(const std::string& s, std::string::size_type& pos, char delimiter)
+        {
+            fast_sdp_require(std::string::npos != pos);
+            const auto end = s.find(delimiter, pos);
+            auto token = s.substr(pos, std::string::npos != end ? end - pos : std::string::npos);
+            pos = std::string::npos != end ? end + 1 : std::string::npos;
+            fast_sdp_require(!token.empty());
+            return token;
+        }
+
+        std::vector<std::string> fast_sdp_tokens(const std::string& s, char delimiter = ' ')
+        {
+            std::vector<std::string> tokens;
+            std::string::size_type pos = 0;
+            while (std::string::npos != pos) tokens.push_back(fast_sdp_token(s, pos, delimiter));
+            return tokens;
+        }
+
+        bool fast_sdp_is_digits(const std::string& s)
+        {
+            return !s.empty() && s.end() == std::find_if(s.begin(), s.end(), [](char c) { return c < '0' || '9' < c; });
+        }
+
+        // leading zeros, signs, exponents and very large numbers are left to the generic grammar
+        uint64_t fast_sdp_number(const std::string& s)
+        {
+            fast_sdp_require(fast_sdp_is_digits(s) && s.size() <= 18 && ('0' != s.front() || 1 == s.size()));
+            return std::stoull(s);
+        }
+
+        // decimal fractions are also allowed, e.g. for the ptime attribute
+        double fast_sdp_decimal(const std::string& s)
+        {
+            const auto point = s.find('.');
+            fast_sdp_number(s.substr(0, point));
+            fast_sdp_require(std::string::npos == point || fast_sdp_is_digits(s.substr(point + 1)));
+            return utility::istringstreamed<double>(utility::s2us(s));
+        }
+
+        struct fast_sdp_connection_data
+        {
+            utility::string_t address_type;
+            utility::string_t connection_address;
+        };
+
+        struct fast_sdp_media_description
+        {
+            utility::string_t media_type;
+            uint64_t port = 0;
+            utility::string_t protocol;
+
+            // only the first of each of these is used
+            std::vector<fast_sdp_connection_data> connection_data;
+
+            bool has_source_filter = false;
+            utility::string_t destination_address;
+            std::vector<utility::string_t> source_addresses;
+
+            bool has_ts_refclk = false;
+            sdp_parameters::ts_refclk_t ts_refclk;
+
+            bool has_mediaclk = false;
+            utility::string_t mediaclk;
+
+            bool has_rtpmap = false;
+            uint64_t payload_type = 0;
+            utility::string_t encoding_name;
+            uint64_t clock_rate = 0;
+            uint64_t encoding_parameters = 1;
+
+            bool has_ptime = false;
+            double ptime = 0;
+
+            bool has_fmtp = false;
+            // format specific parameters, and whether each has a value
+            std::vector<std::pair<utility::string_t, std::pair<bool, utility::string_t>>> format_specific_parameters;
+
+            const std::pair<bool, utility::string_t>* find_format_specific_parameter(const utility::string_t& name) const
+            {
+                const auto found = std::find_if(format_specific_parameters.begin(), format_specific_parameters.end(), [&](const std::pair<utility::string_t, std::pair<bool, utility::string_t>>& param)
+                {
+                    return name == param.first;
+                });
+                return format_specific_parameters.end() != found ? &found->second : nullptr;
+            }
+
+            // the value of a required format specific parameter
+            const utility::string_t& format_specific_parameter(const utility::string_t& name) const
+            {
+                const auto found = find_format_specific_parameter(name);
+                fast_sdp_require(nullptr != found && found->first);
+                return found->second;
+            }
+        };
+
+        // parse an attribute line, only recording the values of the first of each attribute in the media description (if any)
+        void fast_sdp_parse_attribute(const std::string& attribute, fast_sdp_media_description* media, std::pair<bool, sdp_parameters::group_t>& group)
+        {
+            const auto colon = attribute.find(':');
+            const auto name = attribute.substr(0, colon);
+            const bool has_value = std::string::npos != colon;
+            const auto value = has_value ? attribute.substr(colon + 1) : std::string{};
+            fast_sdp_require(!has_value || !value.empty());
+
+            if ("group" == name)
+            {
+                fast_sdp_require(has_value);
+                std::string::size_type pos = 0;
+                const auto semantics = fast_sdp_token(value, pos, ' ');
+                const auto mids = std::string::npos != pos ? fast_sdp_tokens(value.substr(pos)) : std::vector<std::string>{};
+                if (!media && !group.first)
+                {
+                    group.first = true;
+                    group.second.semantics = sdp::group_semantics_type{ utility::s2us(semantics) };
+                    for (const auto& mid : mids) group.second.media_stream_ids.push_back(utility::s2us(mid));
+                }
+            }
+            else if ("mid" == name)
+            {
+                fast_sdp_require(has_value);
+            }
+            else if ("recvonly" == name || "sendrecv" == name || "sendonly" == name || "inactive" == name)
+            {
+                fast_sdp_require(!has_value);
+            }
+            else if ("source-filter" == name)
+            {
+                fast_sdp_require(has_value);
+                std::string::size_type pos = ' ' == value.front() ? 1 : 0;
+                fast_sdp_token(value, pos, ' '); // filter-mode
+                fast_sdp_token(value, pos, ' '); // nettype
+                fast_sdp_token(value, pos, ' '); // address-types
+                const auto destination_address = fast_sdp_token(value, pos, ' ');
+                fast_sdp_require(std::string::npos != pos);
+                const auto source_addresses = fast_sdp_tokens(value.substr(pos));
+                if (media && !media->has_source_filter)
+                {
+                    media->has_source_filter = true;
+                    media->destination_address = utility::s2us(destination_address);
+                    for (const auto& source_address : source_addresses) media->source_addresses.push_back(utility::s2us(source_address));
+                }
+            }
+            else if ("ts-refclk" == name)
+            {
+                fast_sdp_require(has_value);
+                auto pos = value.find_first_of("=:");
+                const auto clock_source = value.substr(0, pos);
+                fast_sdp_require(!clock_source.empty() && std::string::npos != pos);
+                sdp_parameters::ts_refclk_t ts_refclk;
+                if ("ptp" == clock_source)
+                {
+                    const auto ptp_version = fast_sdp_token(value, ++pos, ':');
+                    fast_sdp_require(std::string::npos != pos);
+                    const auto ptp_server = value.substr(pos);
+                    fast_sdp_require(!ptp_server.empty());
+                    ts_refclk = sdp_parameters::ts_refclk_t::ptp(sdp::ptp_version{ utility::s2us(ptp_version) }, "traceable" != ptp_server ? utility::s2us(ptp_server) : utility::string_t{});
+                }
+                else if ("localmac" == clock_source)
+                {
+                    const auto mac_address = value.substr(pos + 1);
+                    fast_sdp_require(!mac_address.empty());
+                    ts_refclk = sdp_parameters::ts_refclk_t::local_mac(utility::s2us(mac_address));
+                }
+                else throw fast_sdp_unsupported{};
+                if (media && !media->has_ts_refclk)
+                {
+                    media->has_ts_refclk = true;
+                    media->ts_refclk = ts_refclk;
+                }
+            }
+            else if ("mediaclk" == name)
+            {
+                fast_sdp_require(has_value);
+                if (media && !media->has_mediaclk)
+                {
+                    media->has_mediaclk = true;
+                    media->mediaclk = utility::s2us(value);
+                }
+            }
+            else if ("rtpmap" == name)
+            {
+                fast_sdp_require(has_value);
+                std::string::size_type pos = 0;
+                const auto payload_type = fast_sdp_number(fast_sdp_token(value, pos, ' '));
+                const auto encoding_name = fast_sdp_token(value, pos, '/');
+                const auto clock_rate = fast_sdp_number(fast_sdp_token(value, pos, '/'));
+                const auto encoding_parameters = std::string::npos != pos ? fast_sdp_number(value.substr(pos)) : 1;
+                if (media && !media->has_rtpmap)
+                {
+                    media->has_rtpmap = true;
+                    media->payload_type = payload_type;
+                    media->encoding_name = utility::s2us(encoding_name);
+                    media->clock_rate = clock_rate;
+                    media->encoding_parameters = encoding_parameters;
+                }
+            }
+            else if ("ptime" == name)
+            {
+                fast_sdp_require(has_value);
+                const auto ptime = fast_sdp_decimal(value);
+                if (media && !media->has_ptime)
+                {
+                    media->has_ptime = true;
+                    media->ptime = ptime;
+                }
+            }
+            else if ("fmtp" == name)
+            {
+                fast_sdp_require(has_value);
+                const auto whitespace = value.find_first_of(" \t");
+                const auto format = value.substr(0, whitespace);
+                fast_sdp_require(!format.empty());
+                const auto first = std::string::npos != whitespace ? value.find_first_not_of(" \t", whitespace) : std::string::npos;
+                auto params = std::string::npos != first ? value.substr(first) : std::string{};
+                if (!params.empty() && ';' == params.back()) params.push_back(' ');
+
+                std::vector<std::pair<utility::string_t, std::pair<bool, utility::string_t>>> format_specific_parameters;
+                std::string::size_type pos = 0;
+                while (params.size() != pos)
+                {
+                    // each parameter must be followed by a semicolon and whitespace, or the end
+                    const auto semicolon = params.find(';', pos);
+                    const auto param = params.substr(pos, std::string::npos != semicolon ? semicolon - pos : std::string::npos);
+                    fast_sdp_require(!param.empty());
+                    if (std::string::npos != semicolon)
+                    {
+                        pos = params.find_first_not_of(" \t", semicolon + 1);
+                        fast_sdp_require(semicolon + 1 != pos);
+                        if (std::string::npos == pos) pos = params.size();
+                    }
+                    else pos = params.size();
+
+                    const auto eq = param.find('=');
+                    const auto param_name = param.substr(0, eq);
+                    fast_sdp_require(!param_name.empty());
+                    const auto param_value = std::string::npos != eq ? param.substr(eq + 1) : std::string{};
+                    fast_sdp_require(std::string::npos == eq || !param_value.empty());
+                    format_specific_parameters.push_back({ utility::s2us(param_name), { std::string::npos != eq, utility::s2us(param_value) } });
+                }
+                if (media && !media->has_fmtp)
+                {
+                    media->has_fmtp = true;
+                    media->format_specific_parameters = std::move(format_specific_parameters);
+                }
+            }
+            else if ("cat" == name || "keywds" == name || "tool" == name || "maxptime" == name || "orient" == name || "type" == name
+                || "charset" == name || "sdplang" == name || "lang" == name || "framerate" == name || "quality" == name)
+            {
+                // these have a specific syntax in the generic grammar
+                throw fast_sdp_unsupported{};
+            }
+            // other attributes are ignored, as in the generic grammar
+        }
+
+        // parse the SDP file directly to the SDP parameters and transport parameters, or return false to indicate that the generic grammar must be used
+        bool fast_parse_session_description(const std::string& session_description, std::pair<sdp_parameters, web::json::value>& result)
+        {
+            try
+            {
+                sdp_parameters sdp_params;
+                utility::string_t unicast_address;
+                std::vector<fast_sdp_connection_data> session_connection_data;
+                std::pair<bool, sdp_parameters::group_t> group{ false, {} };
+                std::vector<fast_sdp_media_description> media_descriptions;
+
+                // the lines must appear in this order, v, o, s and t are required, and b, t, and a (and c in a media description) may be repeated
+                const std::string order{ "vosicbtamicba" };
+                const std::string required{ "vost" };
+                const std::string session_repeatable{ "bta" };
+                const std::string media_repeatable{ "cba" };
+                const std::string::size_type media_stage = order.find('m');
+                std::string::size_type stage = std::string::npos;
+                bool timing = false;
+
+                std::string::size_type pos = 0;
+                while (session_description.size() != pos)
+                {
+                    const auto end = session_description.find('\n', pos);
+                    auto line = session_description.substr(pos, std::string::npos != end ? end - pos : std::string::npos);
+                    pos = std::string::npos != end ? end + 1 : session_description.size();
+                    if (!line.empty() && '\r' == line.back()) line.pop_back();
+
+                    fast_sdp_require(2 <= line.size() && '=' == line[1]);
+                    const char type = line[0];
+                    const auto value = line.substr(2);
+
+                    const bool media = std::string::npos != stage && media_stage <= stage;
+                    std::string::size_type next;
+                    if ('m' == type)
+                    {
+                        fast_sdp_require(timing);
+                        next = media_stage;
+                    }
+                    else
+                    {
+                        next = order.find(type, media ? media_stage : 0);
+                        fast_sdp_require(std::string::npos != next && (media || media_stage > next));
+                        const bool repeatable = std::string::npos != (media ? media_repeatable : session_repeatable).find(type);
+                        fast_sdp_require(std::string::npos == stage || stage < next || (stage == next && repeatable));
+                        // no skipping required lines
+                        for (auto skipped = std::string::npos != stage ? stage + 1 : 0; skipped < next; ++skipped)
+                        {
+                            fast_sdp_require(std::string::npos == required.find(order[skipped]));
+                        }
+                    }
+                    stage = next;
+
+                    switch (type)
+                    {
+                    case 'v':
+                        fast_sdp_require("0" == value);
+                        break;
+                    case 'o':
+                    {
+                        const auto tokens = fast_sdp_tokens(value);
+                        fast_sdp_require(6 == tokens.size());
+                        sdp_params.origin = { utility::s2us(tokens[0]), fast_sdp_number(tokens[1]), fast_sdp_number(tokens[2]) };
+                        unicast_address = utility::s2us(tokens[5]);
+                        break;
+                    }
+                    case 's':
+                        sdp_params.session_name = utility::s2us(!value.empty() ? value : " ");
+                        break;
+                    case 'i':
+                        fast_sdp_require(!value.empty());
+                        break;
+                    case 'c':
+                    {
+                        const auto tokens = fast_sdp_tokens(value);
+                        fast_sdp_require(3 == tokens.size());
+                        auto& connection_data = media ? media_descriptions.back().connection_data : session_connection_data;
+                        connection_data.push_back({ utility::s2us(tokens[1]), utility::s2us(tokens[2]) });
+                        break;
+                    }
+                    case 'b':
+                    {
+                        const auto tokens = fast_sdp_tokens(value, ':');
+                        fast_sdp_require(2 == tokens.size());
+                        fast_sdp_number(tokens[1]);
+                        break;
+                    }
+                    case 't':
+                    {
+                        const auto tokens = fast_sdp_tokens(value);
+                        fast_sdp_require(2 == tokens.size());
+                        const sdp_parameters::timing_t t{ fast_sdp_number(tokens[0]), fast_sdp_number(tokens[1]) };
+                        if (!timing) sdp_params.timing = t;
+                        timing = true;
+                        break;
+                    }
+                    case 'a':
+                        fast_sdp_parse_attribute(value, media ? &media_descriptions.back() : nullptr, group);
+                        break;
+                    case 'm':
+                    {
+                        const auto tokens = fast_sdp_tokens(value);
+                        fast_sdp_require(4 <= tokens.size());
+                        const auto port = fast_sdp_tokens(tokens[1], '/');
+                        fast_sdp_require(1 == port.size() || 2 == port.size());
+                        if (2 == port.size()) fast_sdp_number(port[1]);
+
+                        media_descriptions.push_back({});
+                        auto& media_description = media_descriptions.back();
+                        media_description.media_type = utility::s2us(tokens[0]);
+                        media_description.port = fast_sdp_number(port[0]);
+                        media_description.protocol = utility::s2us(tokens[2]);
+                        break;
+                    }
+                    default:
+                        throw fast_sdp_unsupported{};
+                    }
+                }
+                fast_sdp_require(timing);
+
+                // See get_session_description_sdp_parameters
+
+                if (!session_connection_data.empty())
+                {
+                    const auto& connection_data = session_connection_data.front();
+                    const auto connection_address = details::parse_connection_address(sdp::address_type{ connection_data.address_type }, connection_data.connection_address);
+                    sdp_params.connection_data.ttl = connection_address.ttl;
+                }
+
+                if (group.first) sdp_params.group = group.second;
+
+                fast_sdp_require(!media_descriptions.empty());
+                const auto& media_description = media_descriptions.front();
+
+                if (!media_description.connection_data.empty())
+                {
+                    const auto& connection_data = media_description.connection_data.front();
+                    const auto connection_address = details::parse_connection_address(sdp::address_type{ connection_data.address_type }, connection_data.connection_address);
+                    sdp_params.connection_data.ttl = connection_address.ttl;
+                }
+
+                sdp_params.media_type = sdp::media_type{ media_description.media_type };
+                sdp_params.protocol = sdp::protocol{ media_description.protocol };
+
+                if (media_description.has_ts_refclk) sdp_params.ts_refclk = media_description.ts_refclk;
+
+                if (media_description.has_mediaclk)
+                {
+                    const auto& value = media_description.mediaclk;
+                    const auto eq = value.find(U('='));
+                    sdp_params.mediaclk = { sdp::media_clock_source{ value.substr(0, eq) }, utility::string_t::npos != eq ? value.substr(eq + 1) : utility::string_t{} };
+                }
+
+                fast_sdp_require(media_description.has_rtpmap);
+                sdp_params.rtpmap = { media_description.payload_type, media_description.encoding_name, media_description.clock_rate };
+
+                const auto format = details::get_format(sdp_params);
+
+                if (nmos::formats::audio == format)
+                {
+                    const auto& encoding_name = media_description.encoding_name;
+                    sdp_params.audio.bit_depth = !encoding_name.empty() && U('L') == encoding_name.front() ? utility::istringstreamed<uint32_t>(encoding_name.substr(1)) : 0;
+                    sdp_params.audio.sample_rate = nmos::rational{ (nmos::rational::int_type)media_description.clock_rate };
+                    sdp_params.audio.channel_count = (uint32_t)media_description.encoding_parameters;
+
+                    fast_sdp_require(media_description.has_ptime);
+                    sdp_params.audio.packet_time = media_description.ptime;
+
+                    if (media_description.has_fmtp)
+                    {
+                        const auto channel_order = media_description.find_format_specific_parameter(sdp::fields::channel_order);
+                        if (nullptr != channel_order)
+                        {
+                            sdp_params.audio.channel_order = media_description.format_specific_parameter(sdp::fields::channel_order);
+                        }
+                    }
+                }
+                else if (nmos::formats::video == format)
+                {
+                    fast_sdp_require(media_description.has_fmtp);
+
+                    sdp_params.video.width = utility::istringstreamed<uint32_t>(media_description.format_specific_parameter(sdp::fields::width));
+                    sdp_params.video.height = utility::istringstreamed<uint32_t>(media_description.format_specific_parameter(sdp::fields::height));
+                    sdp_params.video.exactframerate = details::parse_rational(media_description.format_specific_parameter(sdp::fields::exactframerate));
+                    sdp_params.video.interlace = nullptr != media_description.find_format_specific_parameter(sdp::fields::interlace);
+                    sdp_params.video.sampling = sdp::sampling{ media_description.format_specific_parameter(sdp::fields::sampling) };
+                    sdp_params.video.depth = utility::istringstreamed<uint32_t>(media_description.format_specific_parameter(sdp::fields::depth));
+                    if (nullptr != media_description.find_format_specific_parameter(sdp::fields::transfer_characteristic_system))
+                    {
+                        sdp_params.video.tcs = sdp::transfer_characteristic_system{ media_description.format_specific_parameter(sdp::fields::transfer_characteristic_system) };
+                    }
+                    sdp_params.video.colorimetry = sdp::colorimetry{ media_description.format_specific_parameter(sdp::fields::colorimetry) };
+                    if (nullptr != media_description.find_format_specific_parameter(sdp::fields::type_parameter))
+                    {
+                        sdp_params.video.tp = sdp::type_parameter{ media_description.format_specific_parameter(sdp::fields::type_parameter) };
+                    }
+                }
+
+                // See get_session_description_transport_params
+
+                using web::json::value;
+
+                web::json::value transport_params;
+
+                for (size_t leg = 0; leg < 2; ++leg)
+                {
+                    web::json::value params;
+
+                    params[nmos::fields::source_ip] = value::string(unicast_address);
+
+                    if (!session_connection_data.empty())
+                    {
+                        const auto& connection_data = session_connection_data.front();
+                        const auto connection_address = details::parse_connection_address(sdp::address_type{ connection_data.address_type }, connection_data.connection_address);
+                        details::set_multicast_ip_interface_ip(params, connection_address.base_address);
+                    }
+
+                    auto source_address = leg;
+                    for (const auto& md : media_descriptions)
+                    {
+                        if (sdp::protocols::RTP_AVP != sdp::protocol{ md.protocol }) continue;
+
+                        const sdp::media_type media_type{ md.media_type };
+                        if (!(sdp::media_types::video == media_type || sdp::media_types::audio == media_type)) continue;
+
+                        if (!md.connection_data.empty())
+                        {
+                            const auto& connection_data = md.connection_data.front();
+                            const auto connection_address = details::parse_connection_address(sdp::address_type{ connection_data.address_type }, connection_data.connection_address);
+                            details::set_multicast_ip_interface_ip(params, connection_address.base_address);
+                        }
+
+                        if (md.has_source_filter)
+                        {
+                            if (md.source_addresses.size() <= source_address)
+                            {
+                                source_address -= md.source_addresses.size();
+                                continue;
+                            }
+
+                            details::set_multicast_ip_interface_ip(params, md.destination_address);
+                            params[nmos::fields::source_ip] = value::string(md.source_addresses.at(source_address));
+                            source_address = 0;
+                        }
+
+                        if (0 != source_address)
+                        {
+                            --source_address;
+                            continue;
+                        }
+
+                        params[nmos::fields::destination_port] = value::number(md.port);
+
+                        params[nmos::fields::rtp_enabled] = value::boolean(true);
+
+                        web::json::push_back(transport_params, params);
+
+                        break;
+                    }
+                }
+
+                result = { std::move(sdp_params), std::move(transport_params) };
+                return true;
+            }
+            catch (...)
+            {
+                // anything unexpected, including any exception from processing the values, is left to the generic grammar
+                return false;
+            }
+        }
+    }
+
+    std::pair<sdp_parameters, web::json::value> parse_session_description(const std::string& session_description)
+    {
+        std::pair<sdp_parameters, web::json::value> result;
+        if (details::fast_parse_session_description(session_description, result)) return result;
+        return parse_session_description(sdp::parse_session_description(session_description));
+    }
+
     void validate_sdp_parameters(const web::json::value& receiver, const sdp_parameters& sdp_params)
     {
         const auto format = details::get_format(sdp_params);
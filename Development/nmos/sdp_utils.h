@@ -26,6 +26,10 @@ namespace nmos
 
     std::pair<sdp_parameters, web::json::value> parse_session_description(const web::json::value& session_description);
 
+    // Get SDP parameters and transport parameters directly from the SDP file, using a specialised single-pass parser for
+    // typical SMPTE ST 2110 and SMPTE 2022-7 SDP files, which falls back to the generic grammar for anything else
+    std::pair<sdp_parameters, web::json::value> parse_session_description(const std::string& session_description);
+
     void validate_sdp_parameters(const web::json::value& receiver, const sdp_parameters& sdp_params);
 
     struct sdp_parameters
@@ -1,6 +1,11 @@
 #include "nmos/server_utils.h"
 
 #include <algorithm>
+#include <atomic>
+#include <condition_variable>
+#include <deque>
+#include <mutex>
+#include <thread>
 #if !defined(_WIN32) || !defined(__cplusplus_winrt) || defined(CPPREST_FORCE_HTTP_CLIENT_ASIO)
 #include "boost/asio/ssl/set_cipher_list.hpp"
 #include "boost/asio/ssl/use_tmp_ecdh.hpp"
@@ -8,21 +13,67 @@
 #include "cpprest/basic_utils.h"
 #include "cpprest/http_listener.h"
 #include "cpprest/ws_listener.h"
+#if !defined(_WIN32)
+#include "pplx/threadpool.h"
+#endif
 #include "nmos/ssl_context_options.h"
+#include "nmos/thread_scheduling.h"
 
 // Utility types, constants and functions for implementing NMOS REST API servers
 namespace nmos
 {
     namespace details
     {
+        // true if all the listeners and task continuations share a single io service on the thread pool initialized by nmos::experimental::initialize_io_thread_pool
+        inline bool shared_io_thread_pool(const nmos::settings& settings)
+        {
+#if !defined(_WIN32)
+            return 0 < nmos::experimental::fields::io_thread_pool_size(settings);
+#else
+            return false;
+#endif
+        }
+
 #if !defined(_WIN32) || !defined(__cplusplus_winrt) || defined(CPPREST_FORCE_HTTP_CLIENT_ASIO)
+        // configure server-side session resumption, so that a client which reconnects can use an abbreviated handshake
+        // note, the listeners share one context between all their connections, which is where sessions are cached
+        inline void set_session_resumption(boost::asio::ssl::context& ctx, int lifetime, int cache_size, bool tickets)
+        {
+            const auto native = ctx.native_handle();
+            if (0 < lifetime)
+            {
+                SSL_CTX_set_session_cache_mode(native, SSL_SESS_CACHE_SERVER);
+                SSL_CTX_sess_set_cache_size(native, (std::max)(cache_size, 0));
+                SSL_CTX_set_timeout(native, lifetime);
+                // a cached session can only be resumed in a context with the same session id context
+                static const unsigned char session_id_context[] = "nmos-cpp";
+                SSL_CTX_set_session_id_context(native, session_id_context, sizeof(session_id_context) - 1);
+            }
+            else
+            {
+                SSL_CTX_set_session_cache_mode(native, SSL_SESS_CACHE_OFF);
+            }
+
+            if (0 >= lifetime || !tickets)
+            {
+                SSL_CTX_set_options(native, SSL_OP_NO_TICKET);
+            }
+#if OPENSSL_VERSION_NUMBER >= 0x10101000L
+            // in TLS 1.3, sessions are only resumed using tickets, which are stateful when SSL_OP_NO_TICKET is set
+            if (0 >= lifetime) SSL_CTX_set_num_tickets(native, 0);
+#endif
+        }
+
         template <typename ExceptionType>
         inline std::function<void(boost::asio::ssl::context&)> make_listener_ssl_context_callback(const nmos::settings& settings)
         {
             const auto& private_key_files = nmos::experimental::fields::private_key_files(settings);
             const auto& certificate_chain_files = nmos::experimental::fields::certificate_chain_files(settings);
             const auto& dh_param_file = utility::us2s(nmos::experimental::fields::dh_param_file(settings));
-            return [private_key_files, certificate_chain_files, dh_param_file](boost::asio::ssl::context& ctx)
+            const auto session_lifetime = nmos::experimental::fields::tls_session_lifetime(settings);
+            const auto session_cache_size = nmos::experimental::fields::tls_session_cache_size(settings);
+            const auto session_tickets = nmos::experimental::fields::tls_session_tickets(settings);
+            return [private_key_files, certificate_chain_files, dh_param_file, session_lifetime, session_cache_size, session_tickets](boost::asio::ssl::context& ctx)
             {
                 try
                 {
@@ -52,6 +103,8 @@ namespace nmos
                     set_cipher_list(ctx, nmos::details::ssl_cipher_list);
 
                     if (!dh_param_file.empty()) ctx.use_tmp_dh_file(dh_param_file);
+
+                    set_session_resumption(ctx, session_lifetime, session_cache_size, session_tickets);
                 }
                 catch (const boost::system::system_error& e)
                 {
@@ -82,9 +135,14 @@ namespace nmos
     {
         web::websockets::experimental::listener::websocket_listener_config config;
         config.set_backlog(nmos::fields::listen_backlog(settings));
+        config.set_thread_pool_size(nmos::experimental::fields::websocket_thread_pool_size(settings));
+        config.set_compression_threshold((size_t)nmos::experimental::fields::websocket_compression_threshold(settings));
 #if !defined(_WIN32) || !defined(__cplusplus_winrt)
         config.set_ssl_context_callback(details::make_listener_ssl_context_callback<web::websockets::websocket_exception>(settings));
 #endif
+#if !defined(_WIN32)
+        if (details::shared_io_thread_pool(settings)) config.set_io_service(&crossplat::threadpool::shared_instance().service());
+#endif
 
         return config;
     }
@@ -101,5 +159,276 @@ namespace nmos
             });
             return port_map.end() != found ? found->at(U("server_port")).as_integer() : client_port;
         }
+
+        namespace details
+        {
+            class listener_scheduler_impl
+            {
+            public:
+                listener_scheduler_impl() : stopping(false) {}
+
+                void schedule(pplx::TaskProc_t proc, void* param)
+                {
+                    {
+                        std::lock_guard<std::mutex> lock(mutex);
+                        work.push_back({ proc, param });
+                    }
+                    condition.notify_one();
+                }
+
+                // run the scheduled work until stopped, and then finish the work that has already been scheduled
+                void run()
+                {
+                    std::unique_lock<std::mutex> lock(mutex);
+                    for (;;)
+                    {
+                        condition.wait(lock, [&] { return stopping || !work.empty(); });
+                        if (work.empty()) break;
+
+                        const auto next = work.front();
+                        work.pop_front();
+
+                        lock.unlock();
+                        next.first(next.second);
+                        lock.lock();
+                    }
+                }
+
+                void stop()
+                {
+                    {
+                        std::lock_guard<std::mutex> lock(mutex);
+                        stopping = true;
+                    }
+                    condition.notify_all();
+                }
+
+                std::vector<std::thread> threads;
+
+            private:
+                std::mutex mutex;
+                std::condition_variable condition;
+                bool stopping;
+                std::deque<std::pair<pplx::TaskProc_t, void*>> work;
+            };
+        }
+
+        listener_scheduler::listener_scheduler(size_t thread_pool_size, std::function<void()> thread_init)
+            : impl(std::make_shared<details::listener_scheduler_impl>())
+        {
+            auto run_impl = impl;
+            for (size_t i = 0; i < (std::max)(size_t(1), thread_pool_size); ++i)
+            {
+                impl->threads.push_back(std::thread([run_impl, thread_init]
+                {
+                    if (thread_init) thread_init();
+                    run_impl->run();
+                }));
+            }
+        }
+
+        listener_scheduler::~listener_scheduler()
+        {
+            impl->stop();
+            for (auto& thread : impl->threads)
+            {
+                // the last reference to the scheduler may be released by a task running on one of its own threads
+                if (std::this_thread::get_id() == thread.get_id()) thread.detach();
+                else thread.join();
+            }
+        }
+
+        void listener_scheduler::schedule(pplx::TaskProc_t proc, void* param)
+        {
+            impl->schedule(proc, param);
+        }
+
+        // construct the scheduler for the API listener on the specified (client) port based on settings,
+        // or return nullptr if the API listener should use the thread pool shared by all the listeners
+        std::shared_ptr<listener_scheduler> make_listener_scheduler(int client_port, const nmos::settings& settings, slog::base_gate& gate)
+        {
+            if (nmos::details::shared_io_thread_pool(settings)) return{};
+
+            const auto registration_thread_pool_size = nmos::experimental::fields::registration_thread_pool_size(settings);
+            const bool registration = nmos::fields::registration_port(settings) == client_port && 0 != registration_thread_pool_size;
+            const auto thread_pool_size = registration
+                ? registration_thread_pool_size
+                : nmos::experimental::fields::http_thread_pool_size(settings);
+            if (0 >= thread_pool_size) return{};
+
+            return std::make_shared<listener_scheduler>((size_t)thread_pool_size, nmos::experimental::make_thread_scheduling_callback(settings, registration ? U("registration_listener") : U("http_listener"), gate));
+        }
+
+        namespace details
+        {
+            class work_stealing_scheduler_impl
+            {
+            public:
+                explicit work_stealing_scheduler_impl(size_t thread_pool_size)
+                    : queues(thread_pool_size)
+                    , next_queue(0)
+                    , pending(0)
+                    , sleeping(0)
+                    , stopping(false)
+                {}
+
+                void schedule(pplx::TaskProc_t proc, void* param)
+                {
+                    // work scheduled by one of this scheduler's own threads goes on its own queue, other work is spread across all the queues
+                    const auto index = this == current_impl ? current_index : next_queue++ % queues.size();
+                    // pending is incremented first so that it can't be decremented by another thread taking this work before it is incremented
+                    ++pending;
+                    {
+                        std::lock_guard<std::mutex> lock(queues[index].mutex);
+                        queues[index].work.push_back({ proc, param });
+                    }
+
+                    // only take the shared lock when a thread may be waiting for work
+                    // (the thread increments sleeping before it checks pending, both with the default sequentially consistent ordering)
+                    if (0 != sleeping)
+                    {
+                        std::lock_guard<std::mutex> lock(mutex);
+                        condition.notify_one();
+                    }
+                }
+
+                // run the scheduled work until stopped, and then finish the work that has already been scheduled
+                void run(size_t index)
+                {
+                    current_impl = this;
+                    current_index = index;
+
+                    std::pair<pplx::TaskProc_t, void*> next;
+                    for (;;)
+                    {
+                        if (pop(index, next))
+                        {
+                            next.first(next.second);
+                            continue;
+                        }
+
+                        std::unique_lock<std::mutex> lock(mutex);
+                        ++sleeping;
+                        condition.wait(lock, [&] { return stopping || 0 != pending; });
+                        --sleeping;
+                        if (stopping && 0 == pending) break;
+                    }
+
+                    current_impl = nullptr;
+                }
+
+                void stop()
+                {
+                    {
+                        std::lock_guard<std::mutex> lock(mutex);
+                        stopping = true;
+                    }
+                    condition.notify_all();
+                }
+
+                std::vector<std::thread> threads;
+
+            private:
+                typedef std::pair<pplx::TaskProc_t, void*> work_item;
+
+                struct work_queue
+                {
+                    std::mutex mutex;
+                    std::deque<work_item> work;
+                };
+
+                // take the newest work from the specified thread's own queue, or else steal the oldest work from another thread's queue
+                bool pop(size_t index, work_item& next)
+                {
+                    {
+                        auto& own = queues[index];
+                        std::lock_guard<std::mutex> lock(own.mutex);
+                        if (!own.work.empty())
+                        {
+                            next = own.work.back();
+                            own.work.pop_back();
+                            --pending;
+                            return true;
+                        }
+                    }
+                    for (size_t i = 1; i < queues.size(); ++i)
+                    {
+                        auto& other = queues[(index + i) % queues.size()];
+                        std::lock_guard<std::mutex> lock(other.mutex);
+                        if (!other.work.empty())
+                        {
+                            next = other.work.front();
+                            other.work.pop_front();
+                            --pending;
+                            return true;
+                        }
+                    }
+                    return false;
+                }
+
+                std::vector<work_queue> queues;
+                std::atomic<size_t> next_queue;
+                std::atomic<size_t> pending;
+                std::atomic<size_t> sleeping;
+
+                std::mutex mutex;
+                std::condition_variable condition;
+                bool stopping;
+
+                // identify the scheduler thread, if any, on which work is being scheduled
+                static thread_local const work_stealing_scheduler_impl* current_impl;
+                static thread_local size_t current_index;
+            };
+
+            thread_local const work_stealing_scheduler_impl* work_stealing_scheduler_impl::current_impl = nullptr;
+            thread_local size_t work_stealing_scheduler_impl::current_index = 0;
+        }
+
+        work_stealing_scheduler::work_stealing_scheduler(size_t thread_pool_size)
+            : impl(std::make_shared<details::work_stealing_scheduler_impl>((std::max)(size_t(1), thread_pool_size)))
+        {
+            auto run_impl = impl;
+            for (size_t i = 0; i < (std::max)(size_t(1), thread_pool_size); ++i)
+            {
+                impl->threads.push_back(std::thread([run_impl, i] { run_impl->run(i); }));
+            }
+        }
+
+        work_stealing_scheduler::~work_stealing_scheduler()
+        {
+            impl->stop();
+            for (auto& thread : impl->threads)
+            {
+                // the last reference to the scheduler may be released by a task running on one of its own threads
+                if (std::this_thread::get_id() == thread.get_id()) thread.detach();
+                else thread.join();
+            }
+        }
+
+        void work_stealing_scheduler::schedule(pplx::TaskProc_t proc, void* param)
+        {
+            impl->schedule(proc, param);
+        }
+
+        // construct the scheduler for task continuations based on settings, to be installed at startup by pplx::set_ambient_scheduler,
+        // or return nullptr if task continuations should use the thread pool shared by all the listeners
+        std::shared_ptr<work_stealing_scheduler> make_task_scheduler(const nmos::settings& settings)
+        {
+            if (nmos::details::shared_io_thread_pool(settings)) return{};
+
+            const auto thread_pool_size = nmos::experimental::fields::task_thread_pool_size(settings);
+            return 0 < thread_pool_size ? std::make_shared<work_stealing_scheduler>((size_t)thread_pool_size) : std::shared_ptr<work_stealing_scheduler>();
+        }
+
+        // initialize the thread pool shared by all the listeners and task continuations based on settings, before any tasks are created or listeners are opened
+        void initialize_io_thread_pool(const nmos::settings& settings)
+        {
+#if !defined(_WIN32)
+            // the C++ REST SDK thread pool runs a single io service, which is used by the HTTP listeners, the default scheduler for task continuations,
+            // and pplx::complete_after, and with this setting, also by the WebSocket listeners (see nmos::make_websocket_listener_config)
+            // note, this throws if the thread pool has already been initialized, e.g. by creating a task
+            if (nmos::details::shared_io_thread_pool(settings)) crossplat::threadpool::initialize_with_threads((size_t)nmos::experimental::fields::io_thread_pool_size(settings));
+#endif
+        }
     }
 }
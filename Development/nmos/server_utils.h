@@ -1,10 +1,17 @@
 #ifndef NMOS_SERVER_UTILS_H
 #define NMOS_SERVER_UTILS_H
 
+#include <functional>
 #include "cpprest/http_listener.h" // forward declaration of web::http::experimental::listener::http_listener_config
+#include "pplx/pplxinterface.h" // for pplx::scheduler_interface
 #include "cpprest/ws_listener.h" // forward declaration of web::websockets::experimental::listener::websocket_listener_config
 #include "nmos/settings.h"
 
+namespace slog
+{
+    class base_gate;
+}
+
 // Utility types, constants and functions for implementing NMOS REST API servers
 namespace nmos
 {
@@ -18,6 +25,67 @@ namespace nmos
     {
         // map the configured client port to the server port on which to listen
         int server_port(int client_port, const nmos::settings& settings);
+
+        namespace details
+        {
+            class listener_scheduler_impl;
+        }
+
+        // a fixed-size pool of threads which can be used as the scheduler for the request handlers of an API listener,
+        // so that one API, e.g. the Registration API, has reserved capacity and is not starved by the handlers of another, e.g. the Query API
+        // see nmos::make_api_listener
+        class listener_scheduler : public pplx::scheduler_interface
+        {
+        public:
+            // if specified, thread_init is called on each of the threads before it runs any work, e.g. to set the CPU affinity or priority of the thread
+            explicit listener_scheduler(size_t thread_pool_size, std::function<void()> thread_init = {});
+            ~listener_scheduler();
+
+            virtual void schedule(pplx::TaskProc_t proc, void* param);
+
+            listener_scheduler(const listener_scheduler&) = delete;
+            listener_scheduler& operator=(const listener_scheduler&) = delete;
+
+        private:
+            std::shared_ptr<details::listener_scheduler_impl> impl;
+        };
+
+        // construct the scheduler for the API listener on the specified (client) port based on settings,
+        // or return nullptr if the API listener should use the thread pool shared by all the listeners
+        // the threads are named "registration_listener" or "http_listener" for nmos::experimental::fields::thread_scheduling
+        std::shared_ptr<listener_scheduler> make_listener_scheduler(int client_port, const nmos::settings& settings, slog::base_gate& gate);
+
+        namespace details
+        {
+            class work_stealing_scheduler_impl;
+        }
+
+        // a fixed-size pool of threads, each with its own queue of work, which can be used as the ambient scheduler for task continuations
+        // work scheduled by one of its own threads, e.g. the continuation of a task that has just completed, is queued by that thread and run next (last in, first out) while it's hot,
+        // and threads with no work of their own steal the oldest work from the others (first in, first out), so there is no single queue for all the threads to contend on
+        // see nmos::experimental::make_task_scheduler
+        class work_stealing_scheduler : public pplx::scheduler_interface
+        {
+        public:
+            explicit work_stealing_scheduler(size_t thread_pool_size);
+            ~work_stealing_scheduler(); // finishes the work that has already been scheduled
+
+            virtual void schedule(pplx::TaskProc_t proc, void* param);
+
+            work_stealing_scheduler(const work_stealing_scheduler&) = delete;
+            work_stealing_scheduler& operator=(const work_stealing_scheduler&) = delete;
+
+        private:
+            std::shared_ptr<details::work_stealing_scheduler_impl> impl;
+        };
+
+        // construct the scheduler for task continuations based on settings, to be installed at startup by pplx::set_ambient_scheduler,
+        // or return nullptr if task continuations should use the thread pool shared by all the listeners
+        std::shared_ptr<work_stealing_scheduler> make_task_scheduler(const nmos::settings& settings);
+
+        // initialize the thread pool shared by all the listeners and task continuations based on settings, before any tasks are created or listeners are opened,
+        // so that a low-footprint process runs a single io service on a small fixed number of threads, instead of the default thread pool plus the threads of each WebSocket listener
+        void initialize_io_thread_pool(const nmos::settings& settings);
     }
 }
 
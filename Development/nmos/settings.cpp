@@ -42,6 +42,7 @@ namespace nmos
                 //if (!registry) web::json::insert(settings, std::make_pair(nmos::fields::events_ws_port, http_port));
                 web::json::insert(settings, std::make_pair(nmos::experimental::fields::settings_port, http_port));
                 web::json::insert(settings, std::make_pair(nmos::experimental::fields::logging_port, http_port));
+                web::json::insert(settings, std::make_pair(nmos::experimental::fields::metrics_port, http_port));
                 if (registry) web::json::insert(settings, std::make_pair(nmos::experimental::fields::admin_port, http_port));
                 if (registry) web::json::insert(settings, std::make_pair(nmos::experimental::fields::mdns_port, http_port));
             }
@@ -58,6 +59,24 @@ namespace nmos
         details::insert_default_settings(settings, true);
     }
 
+    namespace experimental
+    {
+        settings_snapshot::settings_snapshot(const nmos::settings& settings)
+            : allow_invalid_resources(nmos::fields::allow_invalid_resources(settings))
+            , query_paging_default((std::size_t)nmos::fields::query_paging_default(settings))
+            , query_paging_limit((std::size_t)nmos::fields::query_paging_limit(settings))
+            , query_paging_wait_limit(nmos::experimental::fields::query_paging_wait_limit(settings))
+            , query_parallel_threshold((std::size_t)nmos::experimental::fields::query_parallel_threshold(settings))
+            , query_page_cache_size((std::size_t)nmos::experimental::fields::query_page_cache_size(settings))
+            , query_ws_buffered_limit((std::size_t)nmos::experimental::fields::query_ws_buffered_limit(settings))
+            , query_ws_message_size_limit((std::size_t)nmos::experimental::fields::query_ws_message_size_limit(settings))
+            , query_ws_coalesce_events(nmos::experimental::fields::query_ws_coalesce_events(settings))
+            , query_ws_parallel_threshold((std::size_t)nmos::experimental::fields::query_ws_parallel_threshold(settings))
+            , max_request_body_size((std::size_t)nmos::experimental::fields::max_request_body_size(settings))
+        {
+        }
+    }
+
     // Get host name from settings or return the default (system) host name
     utility::string_t get_host_name(const settings& settings)
     {
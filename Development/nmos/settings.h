@@ -1,6 +1,7 @@
 #ifndef NMOS_SETTINGS_H
 #define NMOS_SETTINGS_H
 
+#include <cstddef>
 #include "cpprest/json_utils.h"
 
 // Configuration settings and defaults for the NMOS Node, Query and Registration APIs, and the Connection API
@@ -152,11 +153,51 @@ namespace nmos
             // registration_available [registry]: used to flag the Registration API as temporarily unavailable
             const web::json::field_as_bool_or registration_available{ U("registration_available"), true };
 
+            // registration_lanes [registry]: number of lanes in which Registration API requests for the resources of independent nodes are validated concurrently, with only a brief exclusive lock
+            // to insert or modify each resource, while the requests for the resources of each node are handled in order in one lane, or 0 to handle each request with the exclusive lock held throughout
+            const web::json::field_as_integer_or registration_lanes{ U("registration_lanes"), 64 };
+
+            // registration_admission_limit [registry]: maximum number of Registration API resource registration requests handled at once, further requests being rejected with 503 (Service Unavailable)
+            // and a Retry-After header that spreads their retries over the following seconds, e.g. when every node re-registers after the registry is restarted, or 0 for no limit
+            const web::json::field_as_integer_or registration_admission_limit{ U("registration_admission_limit"), 0 };
+
+            // registration_priority_aging [registry]: Registration API requests take turns to acquire the model lock, heartbeats first, then node and device registrations, then everything else;
+            // this is the interval in milliseconds after which a waiting request is promoted one priority so that it isn't starved, or 0 for strict priority, or -1 to acquire the lock without taking turns
+            const web::json::field_as_integer_or registration_priority_aging{ U("registration_priority_aging"), 1000 };
+
+            // registration_busy_retries [node]: number of times to retry a Registration API resource registration request, after the delay from the Retry-After header plus a jittered exponential back-off,
+            // when the registry responds 503 (Service Unavailable) with a Retry-After header, before treating it as a failure of the registry
+            const web::json::field_as_integer_or registration_busy_retries{ U("registration_busy_retries"), 5 };
+
+            // advertisement_update_interval [node]: minimum interval between updates of the node's DNS-SD TXT records, in milliseconds, so that a burst of changes to the 'ver_' records results in one update
+            const web::json::field_as_integer_or advertisement_update_interval{ U("advertisement_update_interval"), 1000 };
+
+            // registration_bulk_limit [node]: maximum number of resources registered in one request when the Registration API supports the experimental bulk endpoint, or 0 to always register resources individually
+            const web::json::field_as_integer_or registration_bulk_limit{ U("registration_bulk_limit"), 100 };
+
+            // registration_coalesce_events [node]: whether to coalesce the pending resource events for the Registration API, so that rapid changes to a resource result in at most one request
+            const web::json::field_as_bool_or registration_coalesce_events{ U("registration_coalesce_events"), true };
+
+            // registration_services_cache [node]: whether to continuously browse for Registration APIs, so that the discovered list is immediately available on failover
+            const web::json::field_as_bool_or registration_services_cache{ U("registration_services_cache"), true };
+
+            // registration_heartbeat_jitter [node]: maximum random reduction of each registration heartbeat interval, in milliseconds, to spread out the heartbeats of many nodes
+            const web::json::field_as_integer_or registration_heartbeat_jitter{ U("registration_heartbeat_jitter"), 0 };
+
+            // registration_heartbeat_failover_max [node]: time in seconds after which an unanswered registration heartbeat causes the node to check whether the next-priority
+            // Registration API is responding, and if so, to fail over to it immediately rather than waiting for registration_heartbeat_max, or 0 to disable this check
+            const web::json::field_as_integer_or registration_heartbeat_failover_max{ U("registration_heartbeat_failover_max"), 0 };
+
+            // registration_request_window [node]: maximum number of concurrent requests to register independent resources with the Registration API, or 1 to make requests sequentially
+            const web::json::field_as_integer_or registration_request_window{ U("registration_request_window"), 4 };
+
             // port numbers [registry, node]: ports to which clients should connect for each API
             // see http_port
 
             const web::json::field_as_integer_or settings_port{ U("settings_port"), 3209 };
             const web::json::field_as_integer_or logging_port{ U("logging_port"), 5106 };
+            const web::json::field_as_integer_or logging_ws_port{ U("logging_ws_port"), 5107 };
+            const web::json::field_as_integer_or metrics_port{ U("metrics_port"), 3218 };
 
             // port numbers [registry]: ports to which clients should connect for each API
             // see http_port
@@ -168,12 +209,191 @@ namespace nmos
 
             const web::json::field_as_string_or settings_address{ U("settings_address"), U("") };
             const web::json::field_as_string_or logging_address{ U("logging_address"), U("") };
+            const web::json::field_as_string_or metrics_address{ U("metrics_address"), U("") };
 
             // addresses [registry]: addresses on which to listen for each API, or empty string for the wildcard address
 
             const web::json::field_as_string_or admin_address{ U("admin_address"), U("") };
             const web::json::field_as_string_or mdns_address{ U("mdns_address"), U("") };
 
+            // query_paging_wait_limit [registry]: maximum number of seconds for which a Query API request with the experimental "paging.wait" query parameter waits for matching resources to be created or updated since the "paging.since" cursor, or 0 to ignore that parameter
+            const web::json::field_as_integer_or query_paging_wait_limit{ U("query_paging_wait_limit"), 60 };
+
+            // query_parallel_threshold [registry]: minimum number of resources for which an expensive Query API query (using RQL or match_type) is evaluated concurrently by a number of threads, or 0 to always evaluate it serially
+            const web::json::field_as_integer_or query_parallel_threshold{ U("query_parallel_threshold"), 0 };
+
+            // query_page_cache_size [registry]: maximum number of fully serialized Query API response pages which are cached, so that repeated identical requests (including the paging parameters)
+            // are served without evaluating the query or locking the model while no resources of the queried type have changed, or 0 to disable; pages larger than 1 MiB are never cached
+            const web::json::field_as_integer_or query_page_cache_size{ U("query_page_cache_size"), 64 };
+
+            // query_ws_buffered_limit [registry]: maximum number of bytes of messages waiting to be written to a Query API websocket connection
+            // before further messages are postponed (events continue to accumulate in the grain until the client catches up), or 0 for no limit
+            const web::json::field_as_integer_or query_ws_buffered_limit{ U("query_ws_buffered_limit"), 1048576 };
+
+            // query_ws_message_size_limit [registry]: maximum number of bytes of the serialized events in each Query API websocket message, further events being postponed to the next message,
+            // and also limited by the remainder of query_ws_buffered_limit for the connection, so that a grain of many large resources does not produce a huge frame, or 0 for no limit
+            // (a message always includes at least one event)
+            const web::json::field_as_integer_or query_ws_message_size_limit{ U("query_ws_message_size_limit"), 262144 };
+
+            // query_ws_coalesce_events [registry]: whether to coalesce the pending resource events for each Query API websocket connection, so that at most one event for each resource is sent in a message
+            const web::json::field_as_bool_or query_ws_coalesce_events{ U("query_ws_coalesce_events"), false };
+
+            // query_ws_parallel_threshold [registry]: minimum number of distinct Query API websocket messages prepared together which are serialized concurrently by a number of threads,
+            // after the lock on the model has been released, or 0 to always serialize them serially
+            const web::json::field_as_integer_or query_ws_parallel_threshold{ U("query_ws_parallel_threshold"), 0 };
+
+            // query_ws_resume_limit [registry]: maximum number of resource changes retained (see resource_journal_limit) so that a Query API websocket connection made with a "resume"
+            // query parameter, the origin_timestamp of the last message received on a previous connection, is just sent the changes since then, rather than a full 'sync', or 0 to disable
+            const web::json::field_as_integer_or query_ws_resume_limit{ U("query_ws_resume_limit"), 0 };
+
+            // resource_journal_limit [registry]: maximum number of the most recent resource changes retained in memory, from which Query API websocket connections resume,
+            // paging.wait long-polls are answered and the registry journal is written, or 0 to retain just enough for the enabled features, i.e. query_ws_resume_limit,
+            // or 10000 when registry_journal is enabled; when this is non-zero, the changes are retained even if neither of those is enabled
+            const web::json::field_as_integer_or resource_journal_limit{ U("resource_journal_limit"), 0 };
+
+            // events_ws_batch_limit [node]: maximum number of state messages in one Events API websocket frame, for connections which requested batching in the subscription command
+            const web::json::field_as_integer_or events_ws_batch_limit{ U("events_ws_batch_limit"), 100 };
+
+            // events_ws_batch_latency [node]: maximum time in milliseconds a state message may be held back to be combined with others, for connections which requested batching
+            const web::json::field_as_integer_or events_ws_batch_latency{ U("events_ws_batch_latency"), 0 };
+
+            // events_mqtt_broker_host [node]: host name or address of the MQTT broker to which the state of each IS-07 source is published by its MQTT senders, which leaves the fan-out to the subscribers to the broker,
+            // or empty for no MQTT senders
+            // see nmos::make_connection_events_mqtt_sender and nmos::send_events_mqtt_messages_thread
+            const web::json::field_as_string_or events_mqtt_broker_host{ U("events_mqtt_broker_host"), U("") };
+
+            // events_mqtt_broker_port [node]: port of the MQTT broker
+            const web::json::field_as_integer_or events_mqtt_broker_port{ U("events_mqtt_broker_port"), 1883 };
+
+            // websocket_thread_pool_size [registry, node]: number of threads used by each WebSocket listener, e.g. to perform TLS handshakes and frame writes for many connections concurrently
+            const web::json::field_as_integer_or websocket_thread_pool_size{ U("websocket_thread_pool_size"), 1 };
+
+            // websocket_compression_threshold [registry, node]: minimum size in bytes of WebSocket messages to be compressed, when permessage-deflate is supported and negotiated
+            const web::json::field_as_integer_or websocket_compression_threshold{ U("websocket_compression_threshold"), 1024 };
+
+            // http_compression_level [registry, node]: compression level, from 1 (best speed) to 9 (best compression), for API response bodies when gzip or deflate content-coding is supported and acceptable, or 0 to disable compression
+            const web::json::field_as_integer_or http_compression_level{ U("http_compression_level"), 6 };
+
+            // http_compression_threshold [registry, node]: minimum size in bytes of API response bodies to be compressed, when the size is known in advance
+            const web::json::field_as_integer_or http_compression_threshold{ U("http_compression_threshold"), 1024 };
+
+            // http_thread_pool_size [registry, node]: number of threads reserved for the request handlers of each API listener, or 0 to use the thread pool shared by all the listeners
+            const web::json::field_as_integer_or http_thread_pool_size{ U("http_thread_pool_size"), 0 };
+
+            // task_thread_pool_size [registry, node]: number of threads of a work-stealing scheduler installed at startup to run task continuations, instead of the thread pool shared by all the listeners, or 0 not to install one
+            // (ignored on Windows, where the platform's own scheduler is used)
+            const web::json::field_as_integer_or task_thread_pool_size{ U("task_thread_pool_size"), 0 };
+
+            // io_thread_pool_size [registry, node]: number of threads of the thread pool initialized at startup to run a single io service for all the HTTP and WebSocket listeners and task continuations,
+            // e.g. 2 for a low-footprint process on an embedded device, in which case http_thread_pool_size, registration_thread_pool_size, task_thread_pool_size and websocket_thread_pool_size are ignored,
+            // or 0 to use the defaults of the C++ REST SDK thread pool (40 threads) and a separate io service and threads for each WebSocket listener
+            // (ignored on Windows, where the platform's own scheduler and HTTP server are used)
+            const web::json::field_as_integer_or io_thread_pool_size{ U("io_thread_pool_size"), 0 };
+
+            // thread_scheduling [registry, node]: object mapping thread names, e.g. "erase_expired_resources", "node_behaviour", "websocket_listener" or "registration_listener", to objects like { "affinity": [ 2, 3 ], "realtime_priority": 50 } or { "nice": -10 },
+            // which set the CPU affinity and either the real-time (SCHED_FIFO) priority or the nice value of those threads, so that latency-critical threads are not held up by the others
+            // the background threads are "send_query_ws_events", "erase_expired_resources", "registry_snapshot", "registry_replication" and "publish_resources_shared_memory" in the registry, and "node_implementation" (which also processes
+            // the IS-05 activations), "node_behaviour", "send_events_ws_messages", "send_events_mqtt_messages", "erase_expired_resources" and "publish_resources_shared_memory" in the node; the listener threads are "websocket_listener" (when websocket_thread_pool_size applies),
+            // and "registration_listener" and "http_listener" (when registration_thread_pool_size or http_thread_pool_size applies)
+            // (only supported on Linux, and real-time priorities and negative nice values require the relevant privileges, e.g. CAP_SYS_NICE)
+            const web::json::field_as_value_or thread_scheduling{ U("thread_scheduling"), web::json::value::object() };
+
+            // max_request_body_size [registry, node]: maximum size in bytes of the JSON request bodies accepted by the Registration API and Connection API, or 0 for no limit
+            const web::json::field_with_default<uint64_t> max_request_body_size{ U("max_request_body_size"), 0 };
+
+            // registration_thread_pool_size [registry]: number of threads reserved for the request handlers of the Registration API listener, so that registrations and heartbeats are not held up by e.g. slow Query API requests,
+            // or 0 to use http_thread_pool_size
+            const web::json::field_as_integer_or registration_thread_pool_size{ U("registration_thread_pool_size"), 0 };
+
+            // registry_snapshot_file [registry]: path of the file to which the registry resources and subscriptions are periodically written, and from which they are restored at startup
+            // so that a restarted registry can serve queries while its nodes continue heartbeating, or an empty string to disable snapshots
+            const web::json::field_as_string_or registry_snapshot_file{ U("registry_snapshot_file"), U("") };
+
+            // registry_snapshot_interval [registry]: interval in seconds between snapshots of the registry resources, which also preserve the health of each resource
+            const web::json::field_as_integer_or registry_snapshot_interval{ U("registry_snapshot_interval"), 5 };
+
+            // registry_journal [registry]: whether to also append every change to the registry resources and subscriptions to a journal, the snapshot file name with ".journal" appended,
+            // so that changes since the most recent snapshot are also restored at startup
+            const web::json::field_as_bool_or registry_journal{ U("registry_journal"), false };
+
+            // registry_journal_interval [registry]: interval in milliseconds between writes of the changes to the journal, which are committed together
+            const web::json::field_as_integer_or registry_journal_interval{ U("registry_journal_interval"), 100 };
+
+            // registry_peers [registry]: array of objects, each with the "query" and "registration" API base URLs of a peer registry whose resources are replicated into this one,
+            // e.g. { "query": "http://192.0.2.1:3211/x-nmos/query/v1.3", "registration": "http://192.0.2.1:3210/x-nmos/registration/v1.3" }, so that either can take over from the other
+            // without the nodes re-registering
+            const web::json::field_as_value_or registry_peers{ U("registry_peers"), web::json::value::array() };
+
+            // registry_replication_interval [registry]: interval in seconds between merging the health of the nodes from each peer registry, and between attempts to reconnect
+            const web::json::field_as_integer_or registry_replication_interval{ U("registry_replication_interval"), 2 };
+
+            // registry_primary [registry]: Query API base URL of a primary registry, e.g. "http://192.0.2.1:3211/x-nmos/query/v1.3", which makes this registry a read-only query replica,
+            // serving the Query API and Query WebSocket API (but not the Registration API) from the resources of the primary, or an empty string for a normal registry
+            const web::json::field_as_string_or registry_primary{ U("registry_primary"), U("") };
+
+            // registry_shards [registry]: array of objects with the Query API and Registration API base URLs of each shard registry of a federated registry,
+            // e.g. { "query": "http://192.0.2.1:3211/x-nmos/query/v1.3", "registration": "http://192.0.2.1:3210/x-nmos/registration/v1.3" }, which makes this registry the front end,
+            // forwarding each registration to the shard which owns the node on a consistent-hash ring, and serving the Query API and Query WebSocket API from the resources of every shard
+            const web::json::field_as_value_or registry_shards{ U("registry_shards"), web::json::value::array() };
+
+            // registry_node_memory_limit [registry]: approximate number of bytes which may be used by each node and all its sub-resources, beyond which the Registration API rejects
+            // registrations with 413 (Payload Too Large), or 0 for no limit; the memory usage of each node is reported by the Metrics API
+            const web::json::field_with_default<uint64_t> registry_node_memory_limit{ U("registry_node_memory_limit"), 0 };
+
+            // registry_memory_limit [registry]: approximate number of bytes which may be used by all the registry resources, beyond which the Registration API rejects
+            // registrations with 413 (Payload Too Large), or 0 for no limit
+            const web::json::field_with_default<uint64_t> registry_memory_limit{ U("registry_memory_limit"), 0 };
+
+            // api_rate_limit [registry]: maximum sustained rate of requests per second from each client address to each of the Registration and Query APIs,
+            // beyond which requests are rejected with 429 (Too Many Requests) and a Retry-After header, or 0 for no limit; heartbeats are exempt
+            const web::json::field_with_default<double> api_rate_limit{ U("api_rate_limit"), 0.0 };
+
+            // api_rate_limit_burst [registry]: number of requests which may be made by each client address in a burst faster than api_rate_limit
+            const web::json::field_with_default<double> api_rate_limit_burst{ U("api_rate_limit_burst"), 100.0 };
+
+            // registration_validation_policies [registry]: array of objects, each with optional "addresses" (an array of client address ranges in CIDR notation, e.g. "192.0.2.0/24"),
+            // "node_ids" (an array of node ids) and "validation_interval" (0 to skip the schema validation of Registration API requests, or N to validate one in every N requests),
+            // of which the first whose specified criteria all match a request determines its validation; other requests always have full schema validation, and the
+            // referential integrity and API version of every request are always checked
+            const web::json::field_as_value_or registration_validation_policies{ U("registration_validation_policies"), web::json::value::array() };
+
+            // traffic_trace_file [registry]: filename to which every API request (method, path, headers, body and time received) is appended in a compact binary format,
+            // e.g. to be replayed against another registry by nmos-cpp-loadgen, or an empty string to disable the capture mode
+            const web::json::field_as_string_or traffic_trace_file{ U("traffic_trace_file"), U("") };
+
+            // logging_categories [registry, node]: object mapping log message categories, e.g. "send_query_ws_events", to integer logging levels which override logging_level for messages in those categories
+            const web::json::field_as_value_or logging_categories{ U("logging_categories"), web::json::value::object() };
+
+            // log_rate_limit [registry, node]: maximum number of per-event log messages less severe than warning which are logged each second by e.g. the Query API websocket event sender
+            // and the node registration behaviour, the number suppressed being logged instead, or 0 for no limit
+            const web::json::field_as_integer_or log_rate_limit{ U("log_rate_limit"), 100 };
+
+            // log_flush_interval [registry, node]: maximum time in milliseconds output to the error log and access log files may be held in memory before being written,
+            // or 0 to write it as soon as possible (output is still written in batches when messages are logged faster than they can be written)
+            const web::json::field_as_integer_or log_flush_interval{ U("log_flush_interval"), 0 };
+
+            // log_rotation_size [registry, node]: size in bytes at which the error log and access log files are rotated, or 0 to never rotate them
+            const web::json::field_as_integer_or log_rotation_size{ U("log_rotation_size"), 0 };
+
+            // log_rotation_count [registry, node]: number of rotated error log and access log files to keep, with suffixes ".1" (most recent) to e.g. ".5"
+            const web::json::field_as_integer_or log_rotation_count{ U("log_rotation_count"), 5 };
+
+            // binary_log [registry, node]: filename for a compact binary log, a memory-mapped ring file of the most recent log messages, which can be decoded by nmos-cpp-logdecode,
+            // or an empty string to disable it
+            const web::json::field_as_string_or binary_log{ U("binary_log"), U("") };
+
+            // binary_log_size [registry, node]: approximate size in bytes of the binary log ring, beyond which the least recent messages are overwritten
+            const web::json::field_as_integer_or binary_log_size{ U("binary_log_size"), 64 * 1024 * 1024 };
+
+            // binary_log_level [registry, node]: integer value, between 40 (least verbose, only fatal messages) and -40 (most verbose), for the messages recorded in the binary log,
+            // which may be more verbose than logging_level since the messages aren't formatted for the error log or the Logging API
+            const web::json::field_as_integer_or binary_log_level{ U("binary_log_level"), -40 };
+
+            // access_log_accounting [registry, node]: boolean value, true to append the latency, the time spent waiting for and holding the model lock, and the thread CPU time,
+            // in microseconds, to each line of the access log, to help find expensive and lock-heavy requests; the lock hold time is only recorded when nmos-cpp is built
+            // with NMOS_CPP_INSTRUMENT_MUTEX, and otherwise is "-"
+            const web::json::field_as_bool_or access_log_accounting{ U("access_log_accounting"), false };
+
             // logging_limit [registry, node]: maximum number of log events cached for the Logging API
             const web::json::field_as_integer_or logging_limit{ U("logging_limit"), 1234 };
 
@@ -181,6 +401,19 @@ namespace nmos
             const web::json::field_as_integer_or logging_paging_default{ U("logging_paging_default"), 100 };
             const web::json::field_as_integer_or logging_paging_limit{ U("logging_paging_limit"), 100 };
 
+            // logging_ws_interval [registry, node]: interval in milliseconds at which new log events are sent to the Logging WebSocket API connections
+            const web::json::field_as_integer_or logging_ws_interval{ U("logging_ws_interval"), 100 };
+
+            // resources_shared_memory_name [registry, node]: name of a shared memory object, e.g. "nmos-cpp-registry", to which a read-only snapshot of the registry resources or node resources
+            // is published each time they change, for co-located consumers, or an empty string to disable it (see nmos::experimental::resources_shared_memory_reader)
+            const web::json::field_as_string_or resources_shared_memory_name{ U("resources_shared_memory_name"), U("") };
+
+            // resources_shared_memory_size [registry, node]: size in bytes of the shared memory available for the snapshot, which is not published if it is too large
+            const web::json::field_with_default<uint64_t> resources_shared_memory_size{ U("resources_shared_memory_size"), 64 * 1024 * 1024 };
+
+            // resources_shared_memory_interval [registry, node]: minimum interval in milliseconds between snapshots, so that a burst of changes results in one snapshot per interval
+            const web::json::field_as_integer_or resources_shared_memory_interval{ U("resources_shared_memory_interval"), 100 };
+
             // proxy_map [registry, node]: mapping between the port numbers to which the client connects, and the port numbers on which the server should listen, if different
             // for use with a reverse proxy; each element of the array is an object like { "client_port": 80, "server_port": 8080 }
             const web::json::field_as_value_or proxy_map{ U("proxy_map"), web::json::value::array() };
@@ -213,7 +446,40 @@ namespace nmos
 
             // dh_param_file [registry, node]: Diffie-Hellman parameters file in PEM format for ephemeral key exchange support, or empty string for no support
             const web::json::field_as_string_or dh_param_file{ U("dh_param_file"), U("") };
+
+            // tls_session_lifetime [registry, node]: lifetime in seconds of the TLS sessions cached by the HTTP and WebSocket listeners and of their session tickets, so that clients which reconnect,
+            // e.g. after a network interruption, can resume a session with an abbreviated handshake rather than a full handshake, or 0 to disable session resumption
+            const web::json::field_as_integer_or tls_session_lifetime{ U("tls_session_lifetime"), 300 };
+
+            // tls_session_cache_size [registry, node]: maximum number of TLS sessions cached by each listener (when tls_session_lifetime is non-zero), or 0 for no limit
+            const web::json::field_as_integer_or tls_session_cache_size{ U("tls_session_cache_size"), 20480 };
+
+            // tls_session_tickets [registry, node]: whether the HTTP and WebSocket listeners issue TLS session tickets (when tls_session_lifetime is non-zero), so that clients can resume sessions without them being cached by the server
+            const web::json::field_as_bool_or tls_session_tickets{ U("tls_session_tickets"), true };
         }
+
+        // a typed, immutable snapshot of the settings which are read on hot paths, e.g. for every Registration API or Query API request,
+        // or every Query API websocket message, so that these can be read without locking the model mutex or looking up the JSON fields
+        // see nmos::base_model::get_settings_snapshot
+        struct settings_snapshot
+        {
+            explicit settings_snapshot(const nmos::settings& settings);
+
+            bool allow_invalid_resources;
+
+            std::size_t query_paging_default;
+            std::size_t query_paging_limit;
+            int query_paging_wait_limit;
+            std::size_t query_parallel_threshold;
+            std::size_t query_page_cache_size;
+
+            std::size_t query_ws_buffered_limit;
+            std::size_t query_ws_message_size_limit;
+            bool query_ws_coalesce_events;
+            std::size_t query_ws_parallel_threshold;
+
+            std::size_t max_request_body_size;
+        };
     }
 }
 
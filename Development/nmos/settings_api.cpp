@@ -49,13 +49,15 @@ namespace nmos
 
                     web::json::merge_patch(model.settings, body, true);
 
+                    model.update_settings_snapshot();
+
                     // copy to the logging settings
                     // hmm, this is a bit icky, but simplest for now
                     log_model.settings = model.settings;
 
                     // the logging level is a special case because we want to turn it into an atomic value
-                    // that can be read by logging statements without locking the mutex protecting the settings
-                    log_model.level = nmos::fields::logging_level(log_model.settings);
+                    // that can be read by logging statements without locking the mutex protecting the settings, and likewise the per-category logging levels
+                    nmos::experimental::update_category_levels(log_model);
 
                     // notify anyone who cares...
                     model.notify();
@@ -1,6 +1,10 @@
 #ifndef NMOS_SLOG_H
 #define NMOS_SLOG_H
 
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <limits>
 #include "cpprest/basic_utils.h"
 #include "cpprest/api_router.h" // for web::http::experimental::listener::route_parameters
 #include "cpprest/logging_utils.h"
@@ -40,7 +44,12 @@ namespace nmos
         const category send_query_ws_events{ "send_query_ws_events" };
         const category receive_query_ws_events{ "receive_query_ws_events" };
         const category send_events_ws_messages{ "send_events_ws_messages" };
+        const category send_events_mqtt_messages{ "send_events_mqtt_messages" };
+        const category send_logging_ws_events{ "send_logging_ws_events" };
         const category events_expiry{ "events_expiry" };
+        const category registry_replication{ "registry_replication" };
+        const category registry_snapshot{ "registry_snapshot" };
+        const category publish_resources_shared_memory{ "publish_resources_shared_memory" };
 
         // other categories may be defined ad-hoc
     }
@@ -64,6 +73,7 @@ namespace nmos
     DEFINE_STASH_FUNCTIONS(http_version, web::http::http_version)
     DEFINE_STASH_FUNCTIONS(status_code, web::http::status_code)
     DEFINE_STASH_FUNCTIONS(response_length, utility::size64_t)
+    DEFINE_STASH_FUNCTIONS(request_accounting, std::string)
 #undef DEFINE_STASH_FUNCTIONS
 
     inline slog::omanip_function stash_category(const category& category)
@@ -102,6 +112,9 @@ namespace nmos
             // (where the two '-' characters indicate the user identifiers are unknown)
             // See https://www.w3.org/Daemon/User/Config/Logging.html#common-logfile-format
             // and https://httpd.apache.org/docs/1.3/logs.html#common
+            // Experimental extension, when request accounting is enabled, extra fields are appended, i.e.
+            // latency lockwait lockhold cputime
+            // in microseconds, or '-' if unknown (see nmos::experimental::initialize_request_accounting)
 
 #if !defined(_MSC_VER) || _MSC_VER >= 1900
             static const char* time_format = "%d/%b/%Y:%T %z";
@@ -119,8 +132,12 @@ namespace nmos
                 << utility::us2s(get_request_uri_stash(message.stream()).to_string()) << " "
                 << utility::us2s(make_http_protocol(get_http_version_stash(message.stream()))) << "\" "
                 << get_status_code_stash(message.stream()) << " "
-                << get_response_length_stash(message.stream()) // output "-" for 0 or unknown?
-                << std::endl;
+                << get_response_length_stash(message.stream()); // output "-" for 0 or unknown?
+
+            const auto request_accounting = get_request_accounting_stash(message.stream());
+            if (!request_accounting.empty()) os << " " << request_accounting;
+
+            os << std::endl;
         });
     }
 
@@ -141,20 +158,51 @@ namespace nmos
 
     namespace details
     {
-        class omanip_gate : public slog::base_gate
+        // a special per-category logging level value, meaning the gate's own logging level applies
+        const slog::severity no_category_level = (std::numeric_limits<slog::severity>::min)();
+
+        // a gate which supports per-category logging levels
+        class category_gate : public slog::base_gate
+        {
+        public:
+            virtual ~category_gate() {}
+
+            // return the logging level for the specified category, which must remain valid for the lifetime of the gate,
+            // and which may be no_category_level, or nullptr if per-category logging levels are not supported
+            virtual const std::atomic<slog::severity>* category_level(const category& category) const = 0;
+        };
+
+        inline const std::atomic<slog::severity>* category_level(const slog::base_gate& gate, const category& category)
+        {
+            auto cgate = dynamic_cast<const category_gate*>(&gate);
+            return nullptr != cgate ? cgate->category_level(category) : nullptr;
+        }
+
+        class omanip_gate : public category_gate
         {
         public:
             // apart from the gate, arguments are copied in order that this object is safely copyable
             omanip_gate(slog::base_gate& gate, slog::omanip_function omanip)
-                : gate(&gate), omanip(std::move(omanip)) {}
+                : gate(&gate), omanip(std::move(omanip)), level(nullptr) {}
+            // log messages are stashed with the specified category, and are pertinent according to the logging level for the category, if one is set
+            omanip_gate(slog::base_gate& gate, const category& category)
+                : gate(&gate), omanip(stash_category(category)), level(details::category_level(gate, category)) {}
             virtual ~omanip_gate() {}
 
-            virtual bool pertinent(slog::severity level) const { return gate->pertinent(level); }
+            virtual bool pertinent(slog::severity level_) const
+            {
+                // the per-category logging level is checked before any formatting, so a relaxed read is enough
+                const auto threshold = nullptr != level ? level->load(std::memory_order_relaxed) : no_category_level;
+                return no_category_level != threshold ? threshold <= level_ : gate->pertinent(level_);
+            }
             virtual void log(const slog::log_message& message) const { const_cast<slog::log_message&>(message).stream() << omanip; gate->log(message); }
 
+            virtual const std::atomic<slog::severity>* category_level(const category& category) const { return details::category_level(*gate, category); }
+
         private:
             slog::base_gate* gate;
             slog::omanip_function omanip;
+            const std::atomic<slog::severity>* level;
         };
     }
 
@@ -178,6 +226,71 @@ namespace nmos
         virtual ~ws_api_gate() {}
     };
 
+    namespace experimental
+    {
+        // a gate which logs at most the specified number of messages less severe than the specified severity each second,
+        // and then logs the number of messages that were suppressed, e.g. in order to make verbose per-event logging affordable
+        // messages are suppressed when their pertinence is checked, so before any formatting
+        class rate_limited_gate : public details::category_gate
+        {
+        public:
+            rate_limited_gate(slog::base_gate& gate, std::size_t limit, slog::severity limited_below = slog::severities::warning)
+                : gate(&gate), limit(limit), limited_below(limited_below), window(now()), count(0), suppressed(0), suppressed_level(details::no_category_level) {}
+            virtual ~rate_limited_gate() { log_suppressed(); }
+
+            virtual bool pertinent(slog::severity level) const
+            {
+                if (!gate->pertinent(level)) return false;
+                if (0 == limit || limited_below <= level) return true;
+
+                // start a new window once each second, and report what was suppressed in the previous one
+                const auto current = now();
+                auto previous = window.load(std::memory_order_relaxed);
+                if (current != previous && window.compare_exchange_strong(previous, current, std::memory_order_relaxed))
+                {
+                    count.store(0, std::memory_order_relaxed);
+                    log_suppressed();
+                }
+
+                if (count.fetch_add(1, std::memory_order_relaxed) < limit) return true;
+
+                suppressed.fetch_add(1, std::memory_order_relaxed);
+                auto highest = suppressed_level.load(std::memory_order_relaxed);
+                while (highest < level && !suppressed_level.compare_exchange_weak(highest, level, std::memory_order_relaxed)) {}
+                return false;
+            }
+            virtual void log(const slog::log_message& message) const { gate->log(message); }
+
+            virtual const std::atomic<slog::severity>* category_level(const category& category) const { return details::category_level(*gate, category); }
+
+        private:
+            static std::int64_t now()
+            {
+                return std::chrono::duration_cast<std::chrono::seconds>(std::chrono::steady_clock::now().time_since_epoch()).count();
+            }
+
+            void log_suppressed() const
+            {
+                const auto number = suppressed.exchange(0, std::memory_order_relaxed);
+                if (0 == number) return;
+                // the summary is logged at the highest severity of the suppressed messages
+                const auto level = suppressed_level.exchange(details::no_category_level, std::memory_order_relaxed);
+                if (gate->pertinent(level))
+                {
+                    slog::detail::logw<slog::log_statement, slog::base_gate>(*gate, level, __FILE__, __LINE__, __FUNCTION__) << "Suppressed " << number << " log messages";
+                }
+            }
+
+            slog::base_gate* gate;
+            const std::size_t limit;
+            const slog::severity limited_below;
+            mutable std::atomic<std::int64_t> window;
+            mutable std::atomic<std::size_t> count;
+            mutable std::atomic<std::size_t> suppressed;
+            mutable std::atomic<slog::severity> suppressed_level;
+        };
+    }
+
     namespace details
     {
         inline slog::severity severity_from_level(web::logging::experimental::level level)
@@ -1,5 +1,7 @@
 #include "nmos/system_api.h"
 
+#include <mutex>
+#include "cpprest/json_utils.h" // for web::json::experimental::serialize_utf8
 #include "cpprest/json_validator.h"
 #include "nmos/api_utils.h"
 #include "nmos/json_schema.h"
@@ -8,6 +10,54 @@
 
 namespace nmos
 {
+    namespace details
+    {
+        // the serialized (UTF-8) system global configuration resource, with its entity-tag
+        struct system_global_view
+        {
+            utility::string_t entity_tag;
+            std::string body;
+        };
+
+        // the current view of the system global configuration resource, so that the many requests for it when a facility powers up
+        // can be served without the model lock, and without serializing it each time
+        // note, this relies on the view being updated whenever the resource is changed after the System API has been created,
+        // which is only done by the PUT and PATCH handlers below
+        class system_global_view_cache
+        {
+        public:
+            void assign(const nmos::resource& resource)
+            {
+                std::shared_ptr<const system_global_view> updated;
+                if (resource.has_data())
+                {
+                    updated.reset(new system_global_view{ make_resource_entity_tag(resource), web::json::experimental::serialize_utf8(resource.data) });
+                }
+
+                std::lock_guard<std::mutex> lock(mutex);
+                view = updated;
+            }
+
+            // null if the system global configuration resource has not been configured
+            std::shared_ptr<const system_global_view> get() const
+            {
+                std::lock_guard<std::mutex> lock(mutex);
+                return view;
+            }
+
+        private:
+            mutable std::mutex mutex;
+            std::shared_ptr<const system_global_view> view;
+        };
+
+        // ensure the entity-tag of the system global configuration resource changes when it is replaced or modified
+        static void set_strictly_increasing_update(nmos::resource& resource, const nmos::tai& most_recent)
+        {
+            const auto update = tai_now();
+            resource.updated = update > most_recent ? update : tai_from_time_point(time_point_from_tai(most_recent) + tai_clock::duration(1));
+        }
+    }
+
     inline web::http::experimental::listener::api_router make_unmounted_system_api(nmos::registry_model& model, slog::base_gate& gate);
 
     web::http::experimental::listener::api_router make_system_api(nmos::registry_model& model, slog::base_gate& gate)
@@ -46,6 +96,9 @@ namespace nmos
 
         api_router system_api;
 
+        auto view_cache = std::make_shared<details::system_global_view_cache>();
+        with_read_lock(model.mutex, [&model, &view_cache] { view_cache->assign(model.system_global_resource); });
+
         // check for supported API version
         const std::set<api_version> versions{ { 1, 0 } };
         system_api.support(U(".*"), details::make_api_version_handler(versions, gate_));
@@ -56,14 +109,20 @@ namespace nmos
             return pplx::task_from_result(true);
         });
 
-        system_api.support(U("/global/?"), methods::GET, [&model, &gate_](http_request req, http_response res, const string_t&, const route_parameters& parameters)
+        system_api.support(U("/global/?"), methods::GET, [view_cache, &gate_](http_request req, http_response res, const string_t&, const route_parameters& parameters)
         {
             nmos::api_gate gate(gate_, req, parameters);
-            auto lock = model.read_lock();
 
-            if (model.system_global_resource.has_data())
+            const auto view = view_cache->get();
+            if (view)
             {
-                set_reply(res, status_codes::OK, model.system_global_resource.data);
+                // clients must revalidate, since the global configuration may be replaced or modified, but usually get 304 (Not Modified)
+                res.headers().set_cache_control(U("no-cache"));
+                if (!details::set_not_modified_reply(req, res, view->entity_tag))
+                {
+                    details::set_utf8_json_reply(res, status_codes::OK, view->body);
+                    res.headers().add(web::http::header_names::etag, view->entity_tag);
+                }
             }
             else
             {
@@ -81,10 +140,10 @@ namespace nmos
         };
 
         // experimental extension, to allow the global configuration resource to be replaced
-        system_api.support(U("/global/?"), methods::PUT, [&model, validator, &gate_](http_request req, http_response res, const string_t&, const route_parameters& parameters)
+        system_api.support(U("/global/?"), methods::PUT, [&model, validator, view_cache, &gate_](http_request req, http_response res, const string_t&, const route_parameters& parameters)
         {
             nmos::api_gate gate(gate_, req, parameters);
-            return details::extract_json(req, gate).then([&model, &validator, req, res, parameters, gate](value body) mutable
+            return details::extract_json(req, gate).then([&model, &validator, view_cache, req, res, parameters, gate](value body) mutable
             {
                 auto lock = model.write_lock();
 
@@ -111,7 +170,10 @@ namespace nmos
 
                 const auto& data = body;
 
+                const auto most_recent = model.system_global_resource.updated;
                 model.system_global_resource = { version, types::global, data, true };
+                details::set_strictly_increasing_update(model.system_global_resource, most_recent);
+                view_cache->assign(model.system_global_resource);
 
                 // notify anyone who cares...
                 model.notify();
@@ -123,10 +185,10 @@ namespace nmos
         });
 
         // experimental extension, to allow the global configuration resource to be modified
-        system_api.support(U("/global/?"), methods::PATCH, [&model, validator, &gate_](http_request req, http_response res, const string_t&, const route_parameters& parameters)
+        system_api.support(U("/global/?"), methods::PATCH, [&model, validator, view_cache, &gate_](http_request req, http_response res, const string_t&, const route_parameters& parameters)
         {
             nmos::api_gate gate(gate_, req, parameters);
-            return details::extract_json(req, gate).then([&model, &validator, req, res, parameters, gate](value body) mutable
+            return details::extract_json(req, gate).then([&model, &validator, view_cache, req, res, parameters, gate](value body) mutable
             {
                 auto lock = model.write_lock();
 
@@ -161,6 +223,8 @@ namespace nmos
                     if (model.system_global_resource.id == nmos::fields::id(patched))
                     {
                         model.system_global_resource.data = patched;
+                        details::set_strictly_increasing_update(model.system_global_resource, model.system_global_resource.updated);
+                        view_cache->assign(model.system_global_resource);
 
                         // notify anyone who cares...
                         model.notify();
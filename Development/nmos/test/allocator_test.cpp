@@ -0,0 +1,28 @@
+// The first "test" is of course whether the header compiles standalone
+#include "nmos/allocator.h"
+
+#include <memory>
+#include <vector>
+#include "bst/test/test.h"
+
+////////////////////////////////////////////////////////////////////////////////////////////
+BST_TEST_CASE(testAllocatorStatistics)
+{
+    nmos::experimental::allocator_statistics statistics{};
+    if (!nmos::experimental::get_allocator_statistics(statistics)) return;
+
+    // the allocator holds at least as much memory as has been allocated from it
+    BST_REQUIRE(statistics.allocated <= statistics.resident);
+
+    // a burst of allocations is reflected in the statistics
+    {
+        std::vector<std::unique_ptr<char[]>> burst;
+        for (int i = 0; i < 1000; ++i) burst.emplace_back(new char[1000]);
+
+        nmos::experimental::allocator_statistics during{};
+        BST_REQUIRE(nmos::experimental::get_allocator_statistics(during));
+        BST_REQUIRE(statistics.allocated + 500 * 1000 < during.allocated);
+    }
+
+    BST_REQUIRE(nmos::experimental::release_free_memory());
+}
@@ -0,0 +1,57 @@
+// The first "test" is of course whether the header compiles standalone
+#include "nmos/api_downgrade.h"
+
+#include "bst/test/test.h"
+#include "cpprest/json_utils.h"
+#include "nmos/is04_versions.h"
+#include "nmos/type.h"
+
+////////////////////////////////////////////////////////////////////////////////////////////
+BST_TEST_CASE(testDowngradeSender)
+{
+    using web::json::value_of;
+
+    const auto data = value_of({
+        { U("id"), U("a") },
+        { U("version"), U("1:0") },
+        { U("label"), U("") },
+        { U("description"), U("") },
+        { U("tags"), web::json::value::object() },
+        { U("flow_id"), U("b") },
+        { U("transport"), U("urn:x-nmos:transport:rtp") },
+        { U("device_id"), U("c") },
+        { U("manifest_href"), U("") },
+        { U("caps"), web::json::value::object() },
+        { U("interface_bindings"), web::json::value::array() },
+        { U("subscription"), value_of({ { U("receiver_id"), web::json::value::null() }, { U("active"), false } }) }
+    });
+
+    const auto& v1_1 = nmos::is04_versions::v1_1;
+    const auto& v1_2 = nmos::is04_versions::v1_2;
+
+    // v1.2 properties are stripped when downgrading to v1.1
+    const auto downgraded = nmos::downgrade(v1_2, nmos::types::sender, data, v1_1, v1_1);
+    BST_REQUIRE_EQUAL(size_t(9), downgraded.size());
+    BST_REQUIRE(downgraded.has_field(U("manifest_href")));
+    BST_REQUIRE(!downgraded.has_field(U("caps")));
+    BST_REQUIRE(!downgraded.has_field(U("interface_bindings")));
+    BST_REQUIRE(!downgraded.has_field(U("subscription")));
+
+    // no upgrade, and no downgrade between major versions
+    BST_REQUIRE_EQUAL(data, nmos::downgrade(v1_2, nmos::types::sender, data, v1_2, v1_2));
+    BST_REQUIRE(nmos::downgrade(v1_1, nmos::types::sender, data, v1_2, v1_2).is_null());
+    BST_REQUIRE(nmos::downgrade(v1_2, nmos::types::sender, data, v1_1, nmos::api_version{ 0, 1 }).is_null());
+
+    // serializing during the downgrade is equivalent to serializing the downgraded copy
+    std::string utf8;
+    nmos::serialize_downgrade_utf8(utf8, v1_2, nmos::types::sender, data, v1_1, v1_1);
+    BST_REQUIRE_EQUAL(downgraded, web::json::value::parse(utility::conversions::to_string_t(utf8)));
+
+    utf8.clear();
+    nmos::serialize_downgrade_utf8(utf8, v1_2, nmos::types::sender, data, v1_2, v1_2);
+    BST_REQUIRE_EQUAL(data, web::json::value::parse(utility::conversions::to_string_t(utf8)));
+
+    utf8.clear();
+    nmos::serialize_downgrade_utf8(utf8, v1_1, nmos::types::sender, data, v1_2, v1_2);
+    BST_REQUIRE_EQUAL("null", utf8);
+}
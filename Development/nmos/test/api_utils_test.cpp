@@ -97,3 +97,16 @@ BST_TEST_CASE(testMakeErrorResponseBody)
     }
     // successful status code perhaps ought to throw?
 }
+
+////////////////////////////////////////////////////////////////////////////////////////////
+BST_TEST_CASE(testMakeRouteLabel)
+{
+    BST_REQUIRE_EQUAL(U(""), nmos::details::make_route_label(U("")));
+    BST_REQUIRE_EQUAL(U("/"), nmos::details::make_route_label(U("/")));
+    BST_REQUIRE_EQUAL(U("/x-nmos/query/v1.3/nodes/"), nmos::details::make_route_label(U("/x-nmos/query/v1.3/nodes/")));
+    BST_REQUIRE_EQUAL(U("/x-nmos/query/v1.3/nodes/{resourceId}"), nmos::details::make_route_label(U("/x-nmos/query/v1.3/nodes/2aa143ac-0ab7-4d75-bc32-5c00c13d186f")));
+    BST_REQUIRE_EQUAL(U("/x-nmos/connection/v1.1/single/senders/{resourceId}/staged/"), nmos::details::make_route_label(U("/x-nmos/connection/v1.1/single/senders/2aa143ac-0ab7-4d75-bc32-5c00c13d186f/staged/")));
+    // not quite resource ids
+    BST_REQUIRE_EQUAL(U("/nodes/2AA143AC-0AB7-4D75-BC32-5C00C13D186F"), nmos::details::make_route_label(U("/nodes/2AA143AC-0AB7-4D75-BC32-5C00C13D186F")));
+    BST_REQUIRE_EQUAL(U("/nodes/2aa143ac-0ab7-4d75-bc32-5c00c13d186"), nmos::details::make_route_label(U("/nodes/2aa143ac-0ab7-4d75-bc32-5c00c13d186")));
+}
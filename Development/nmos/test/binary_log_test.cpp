@@ -0,0 +1,88 @@
+// The first "test" is of course whether the header compiles standalone
+#include "nmos/binary_log.h"
+
+#include <cstdio>
+#include <fstream>
+#include <iterator>
+#include "bst/test/test.h"
+#include "slog/all_in_one.h"
+
+namespace
+{
+    std::string read_file(const std::string& filename)
+    {
+        std::ifstream file(filename, std::ios::binary);
+        return{ std::istreambuf_iterator<char>(file), std::istreambuf_iterator<char>() };
+    }
+}
+
+////////////////////////////////////////////////////////////////////////////////////////////
+BST_TEST_CASE(testBinaryLogRoundTrip)
+{
+    const std::string filename("binary_log_test.binlog");
+
+    nmos::experimental::binary_log binary_log;
+    BST_REQUIRE(binary_log.open(filename, 0, slog::severities::info));
+    BST_REQUIRE(binary_log.pertinent(slog::severities::info));
+    BST_REQUIRE(!binary_log.pertinent(slog::severities::more_info));
+
+    binary_log.write(slog::async_log_message("foo.cpp", 42, "foo", slog::severities::warning, "hello\nworld"), { "foo", "bar" });
+    binary_log.write(slog::async_log_message("foo.cpp", 42, "foo", slog::severities::info, "again"), {});
+    binary_log.close();
+    BST_REQUIRE(!binary_log.pertinent(slog::severities::severe));
+
+    std::vector<nmos::experimental::binary_log_record> records;
+    BST_REQUIRE(nmos::experimental::read_binary_log(read_file(filename), [&](const nmos::experimental::binary_log_record& record) { records.push_back(record); }));
+    std::remove(filename.c_str());
+
+    BST_REQUIRE_EQUAL(2, records.size());
+    BST_REQUIRE_EQUAL(slog::severities::warning, records[0].level);
+    BST_REQUIRE_EQUAL("foo.cpp", records[0].file);
+    BST_REQUIRE_EQUAL(42, records[0].line);
+    BST_REQUIRE_EQUAL("foo", records[0].function);
+    BST_REQUIRE_EQUAL(2, records[0].categories.size());
+    BST_REQUIRE_EQUAL("bar", records[0].categories[1]);
+    BST_REQUIRE_EQUAL("hello\nworld", records[0].message);
+    BST_REQUIRE(records[0].timestamp <= records[1].timestamp);
+    BST_REQUIRE_EQUAL(records[0].thread_id, records[1].thread_id);
+    BST_REQUIRE(records[1].categories.empty());
+    BST_REQUIRE_EQUAL("again", records[1].message);
+
+    // contents which aren't a binary log aren't recognised
+    BST_REQUIRE(!nmos::experimental::read_binary_log("not a binary log", [](const nmos::experimental::binary_log_record&) {}));
+}
+
+////////////////////////////////////////////////////////////////////////////////////////////
+BST_TEST_CASE(testBinaryLogWrapAround)
+{
+    const std::string filename("binary_log_test.binlog");
+
+    nmos::experimental::binary_log binary_log;
+    BST_REQUIRE(binary_log.open(filename, 0, slog::severities::too_much_info));
+
+    // enough messages of an awkward size to fill the ring several times over
+    const int count = 1000;
+    for (int i = 0; i < count; ++i)
+    {
+        binary_log.write(slog::async_log_message("foo.cpp", 42, "foo", slog::severities::info, std::to_string(i) + std::string(333, 'x')), {});
+    }
+    // a huge message is truncated
+    binary_log.write(slog::async_log_message("foo.cpp", 43, "foo", slog::severities::info, std::string(1024 * 1024, 'y')), {});
+    binary_log.close();
+
+    std::vector<nmos::experimental::binary_log_record> records;
+    BST_REQUIRE(nmos::experimental::read_binary_log(read_file(filename), [&](const nmos::experimental::binary_log_record& record) { records.push_back(record); }));
+    std::remove(filename.c_str());
+
+    // the least recent messages have been overwritten, but the rest are consecutive
+    BST_REQUIRE(1 < records.size());
+    BST_REQUIRE(count + 1 > records.size());
+    const int first = std::stoi(records.front().message);
+    for (size_t i = 0; i + 1 < records.size(); ++i)
+    {
+        BST_REQUIRE_EQUAL(std::to_string(first + (int)i) + std::string(333, 'x'), records[i].message);
+    }
+    BST_REQUIRE_EQUAL(count - 1, first + (int)records.size() - 2);
+    BST_REQUIRE_EQUAL(43, records.back().line);
+    BST_REQUIRE(records.back().message.size() < 1024 * 1024);
+}
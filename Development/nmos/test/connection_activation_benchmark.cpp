@@ -0,0 +1,167 @@
+// The first "test" is of course whether the header compiles standalone
+#include "nmos/connection_api.h"
+
+#include <algorithm>
+#include <iomanip>
+#include <iostream>
+#include <thread>
+#include "bst/test/test.h"
+#include "cpprest/http_client.h"
+#include "nmos/activation_mode.h"
+#include "nmos/api_utils.h"
+#include "nmos/client_utils.h"
+#include "nmos/connection_resources.h"
+#include "nmos/model.h"
+#include "nmos/server_utils.h"
+#include "slog/all_in_one.h"
+
+// This benchmark measures the latency of bulk immediate activations, e.g. routing salvos, end to end through an in-process Connection API,
+// with a minimal node implementation thread which completes each immediate activation as soon as it is noticed, like nmos-cpp-node does,
+// reporting the percentiles of the request latency, and the mean time spent in each stage (see nmos::experimental::connection_patch_metrics)
+namespace
+{
+    struct test_gate : public slog::base_gate
+    {
+        virtual bool pertinent(slog::severity level) const { return false; }
+        virtual void log(const slog::log_message& message) const {}
+    };
+
+    const int connection_port = 23215;
+
+    // complete the pending immediate activations, cf. node_implementation_thread in nmos-cpp-node/node_implementation.cpp
+    void activation_thread(nmos::node_model& model)
+    {
+        auto lock = model.write_lock();
+        auto most_recent_update = nmos::tai_min();
+
+        for (;;)
+        {
+            model.wait(lock, [&] { return model.shutdown || most_recent_update < nmos::most_recent_update(model.connection_resources); });
+            if (model.shutdown) break;
+
+            std::vector<nmos::id> immediate_activations;
+            for (const auto& resource : model.connection_resources.get<nmos::tags::updated>())
+            {
+                if (resource.updated <= most_recent_update) break;
+                if (!resource.has_data()) continue;
+
+                const auto& staged_activation = nmos::fields::activation(nmos::fields::endpoint_staged(resource.data));
+                const auto& mode = nmos::fields::mode(staged_activation);
+                if (mode.is_null() || nmos::activation_modes::activate_immediate.name != mode.as_string()) continue;
+                if (nmos::fields::requested_time(staged_activation).is_null() || !nmos::fields::activation_time(staged_activation).is_null()) continue;
+
+                immediate_activations.push_back(resource.id);
+            }
+
+            const auto activation_time = nmos::tai_now();
+            for (const auto& id : immediate_activations)
+            {
+                nmos::modify_resource(model.connection_resources, id, [&activation_time](nmos::resource& resource)
+                {
+                    nmos::set_connection_resource_active(resource, [](web::json::value&) {}, activation_time);
+                });
+            }
+
+            most_recent_update = nmos::most_recent_update(model.connection_resources);
+            if (!immediate_activations.empty()) model.notify();
+        }
+    }
+
+    double mean_milliseconds(const nmos::experimental::latency_histogram& histogram)
+    {
+        const auto count = histogram.count.load();
+        return 0 != count ? histogram.sum_microseconds.load() / 1e3 / count : 0.0;
+    }
+
+    void benchmark_bulk_immediate_activations(std::size_t receivers, std::size_t requests)
+    {
+        using web::json::value;
+        using web::json::value_of;
+
+        test_gate gate;
+
+        nmos::node_model model;
+        model.settings = value::object();
+        nmos::insert_node_default_settings(model.settings);
+        model.settings[nmos::fields::connection_port] = connection_port;
+
+        std::vector<nmos::id> receiver_ids;
+        {
+            auto lock = model.write_lock();
+            for (std::size_t receiver = 0; receiver < receivers; ++receiver)
+            {
+                const auto id = nmos::make_id();
+                nmos::insert_resource(model.connection_resources, nmos::make_connection_receiver(id, false));
+                receiver_ids.push_back(id);
+            }
+        }
+
+        auto connection_api = nmos::make_connection_api(model, gate);
+        auto listener = nmos::make_api_listener(false, web::http::experimental::listener::host_wildcard, connection_port, connection_api, nmos::make_http_listener_config(model.settings), gate);
+        listener.open().wait();
+
+        std::thread node_thread([&] { activation_thread(model); });
+
+        web::http::client::http_client client(U("http://127.0.0.1:") + utility::ostringstreamed(connection_port), nmos::make_http_client_config(model.settings));
+
+        std::vector<long long> latencies;
+        for (std::size_t request = 0; request < requests; ++request)
+        {
+            // alternately enable and disable all the receivers, so that every request is a real change
+            auto body = value::array();
+            for (const auto& id : receiver_ids)
+            {
+                web::json::push_back(body, value_of({
+                    { nmos::fields::id, id },
+                    { nmos::fields::params, value_of({
+                        { nmos::fields::master_enable, 0 == request % 2 },
+                        { nmos::fields::activation, value_of({
+                            { nmos::fields::mode, nmos::activation_modes::activate_immediate.name }
+                        }) }
+                    }) }
+                }));
+            }
+
+            const auto start = std::chrono::steady_clock::now();
+            auto response = client.request(web::http::methods::POST, U("/x-nmos/connection/v1.1/bulk/receivers"), body).get();
+            const auto results = response.extract_json().get();
+            latencies.push_back(nmos::experimental::elapsed_since(start).count());
+
+            BST_REQUIRE_EQUAL(web::http::status_codes::OK, response.status_code());
+            for (const auto& result : results.as_array())
+            {
+                BST_REQUIRE_EQUAL(web::http::status_codes::OK, result.at(U("code")).as_integer());
+            }
+        }
+
+        std::sort(latencies.begin(), latencies.end());
+        const auto percentile = [&latencies](double p) { return latencies[(std::size_t)(p * (latencies.size() - 1))] / 1e3; };
+
+        std::cout << std::left << std::setw(64) << ("bulk immediate activation of " + std::to_string(receivers) + " receivers") << std::right
+            << std::setw(12) << requests << " requests"
+            << std::fixed << std::setprecision(2)
+            << "   latency (ms) p50 " << percentile(0.5) << " p90 " << percentile(0.9) << " p99 " << percentile(0.99) << " max " << percentile(1.0)
+            << std::endl;
+
+        const auto& stages = model.metrics.connection_patch;
+        std::cout << std::left << std::setw(64) << "" << std::right
+            << std::fixed << std::setprecision(3)
+            << " mean (ms) validation " << mean_milliseconds(stages.validation)
+            << " staging " << mean_milliseconds(stages.staging)
+            << " activation " << mean_milliseconds(stages.activation)
+            << " response " << mean_milliseconds(stages.response)
+            << std::endl;
+
+        model.controlled_shutdown();
+        node_thread.join();
+        listener.close().wait();
+    }
+}
+
+////////////////////////////////////////////////////////////////////////////////////////////
+BST_TEST_CASE(benchmarkBulkImmediateActivations)
+{
+    benchmark_bulk_immediate_activations(10, 200);
+    benchmark_bulk_immediate_activations(100, 100);
+    benchmark_bulk_immediate_activations(500, 50);
+}
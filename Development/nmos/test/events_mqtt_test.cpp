@@ -0,0 +1,32 @@
+// The first "test" is of course whether the header compiles standalone
+#include "nmos/events_mqtt.h"
+
+#include "bst/test/test.h"
+
+////////////////////////////////////////////////////////////////////////////////////////////
+BST_TEST_CASE(testMqttConnectPacket)
+{
+    // CONNECT, remaining length, protocol name, protocol level, clean session, keep alive, empty client identifier
+    const std::string expected{ "\x10\x0C\x00\x04MQTT\x04\x02\x00\x3C\x00\x00", 14 };
+    BST_REQUIRE_EQUAL(expected, nmos::details::make_mqtt_connect_packet({}, 60));
+
+    BST_REQUIRE_EQUAL(std::string("\xE0\x00", 2), nmos::details::make_mqtt_disconnect_packet());
+}
+
+////////////////////////////////////////////////////////////////////////////////////////////
+BST_TEST_CASE(testMqttPublishPacket)
+{
+    // PUBLISH, with the retain flag, remaining length, topic, and payload, without a packet identifier at QoS 0
+    const std::string expected{ "\x31\x0A\x00\x03" "a/b" "hello", 12 };
+    BST_REQUIRE_EQUAL(expected, nmos::details::make_mqtt_publish_packet("a/b", "hello", true));
+
+    // the remaining length uses more bytes for larger packets
+    const std::string payload(200, 'x');
+    const auto packet = nmos::details::make_mqtt_publish_packet("a/b", payload, false);
+    BST_REQUIRE_EQUAL(3 + 5 + payload.size(), packet.size());
+    BST_REQUIRE_EQUAL('\x30', packet[0]);
+    // 205 is 0x4D + 0x01 * 128
+    BST_REQUIRE_EQUAL('\xCD', packet[1]);
+    BST_REQUIRE_EQUAL('\x01', packet[2]);
+    BST_REQUIRE_EQUAL(payload, packet.substr(8));
+}
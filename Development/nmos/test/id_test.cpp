@@ -0,0 +1,27 @@
+// The first "test" is of course whether the header compiles standalone
+#include "nmos/id.h"
+
+#include <set>
+#include "bst/test/test.h"
+#include "cpprest/regex_utils.h"
+
+////////////////////////////////////////////////////////////////////////////////////////////
+BST_TEST_CASE(testMakeId)
+{
+    // lowercase, hyphenated, with the version and variant of a random number-based UUID
+    const utility::regex_t v4(U("[0-9a-f]{8}-[0-9a-f]{4}-4[0-9a-f]{3}-[89ab][0-9a-f]{3}-[0-9a-f]{12}"));
+
+    nmos::id_generator generate_id;
+    std::set<nmos::id> ids;
+    for (int i = 0; i < 100; ++i)
+    {
+        const auto id = nmos::make_id();
+        BST_REQUIRE(bst::regex_match(id, v4));
+        ids.insert(id);
+
+        const auto generated = generate_id();
+        BST_REQUIRE(bst::regex_match(generated, v4));
+        ids.insert(generated);
+    }
+    BST_REQUIRE_EQUAL(200, ids.size());
+}
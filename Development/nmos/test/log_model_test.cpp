@@ -0,0 +1,60 @@
+// The first "test" is of course whether the header compiles standalone
+#include "nmos/log_model.h"
+
+#include "bst/test/test.h"
+#include "cpprest/basic_utils.h" // for utility::s2us
+
+namespace
+{
+    slog::async_log_message make_message(int i)
+    {
+        return slog::async_log_message(__FILE__, __LINE__, "make_message", slog::severities::info, std::to_string(i));
+    }
+}
+
+////////////////////////////////////////////////////////////////////////////////////////////
+BST_TEST_CASE(testLogRecordRing)
+{
+    // capacity is rounded up to 4
+    nmos::experimental::details::log_record_ring records(3);
+    BST_REQUIRE(!records.pop());
+
+    for (int i = 0; i < 6; ++i)
+    {
+        nmos::experimental::push_log_record(records, make_message(i), utility::s2us(std::to_string(i)));
+    }
+
+    // the oldest records have been discarded
+    for (int i = 2; i < 6; ++i)
+    {
+        auto record = records.pop();
+        BST_REQUIRE(!!record);
+        BST_REQUIRE_EQUAL(std::to_string(i), record->message.str());
+    }
+    BST_REQUIRE(!records.pop());
+}
+
+////////////////////////////////////////////////////////////////////////////////////////////
+BST_TEST_CASE(testInsertLogRecords)
+{
+    nmos::experimental::details::log_record_ring records(16);
+    nmos::experimental::log_events events;
+
+    for (int i = 0; i < 5; ++i)
+    {
+        nmos::experimental::push_log_record(records, make_message(i), utility::s2us(std::to_string(i)));
+    }
+
+    nmos::experimental::insert_log_records(events, records, 3);
+    BST_REQUIRE(!records.pop());
+    BST_REQUIRE_EQUAL(3, events.size());
+
+    // most recent first, with strictly increasing cursors
+    BST_REQUIRE_EQUAL(U("4"), events.front().id);
+    BST_REQUIRE_EQUAL(U("2"), events.back().id);
+    BST_REQUIRE(events.back().cursor < events.front().cursor);
+    BST_REQUIRE(events.get<nmos::experimental::tags::id>().end() != events.get<nmos::experimental::tags::id>().find(U("3")));
+
+    nmos::experimental::insert_log_records(events, records, 0);
+    BST_REQUIRE(events.empty());
+}
@@ -0,0 +1,36 @@
+// The first "test" is of course whether the header compiles standalone
+#include "nmos/rate_limiter.h"
+
+#include "bst/test/test.h"
+
+////////////////////////////////////////////////////////////////////////////////////////////
+BST_TEST_CASE(testRateLimiterTokenBucket)
+{
+    using std::chrono::milliseconds;
+    typedef nmos::experimental::rate_limiter::clock::duration duration;
+
+    // 10 requests per second, in bursts of up to 3
+    nmos::experimental::rate_limiter limiter(10, 3);
+    const auto now = nmos::experimental::rate_limiter::clock::now();
+
+    BST_REQUIRE(duration::zero() == limiter.admit(U("192.0.2.1"), now));
+    BST_REQUIRE(duration::zero() == limiter.admit(U("192.0.2.1"), now));
+    BST_REQUIRE(duration::zero() == limiter.admit(U("192.0.2.1"), now));
+
+    // the bucket is empty, and the next token is available after 100 ms
+    const auto retry_after = limiter.admit(U("192.0.2.1"), now);
+    BST_REQUIRE(milliseconds(99) < retry_after && retry_after <= milliseconds(100));
+
+    // each client has its own bucket
+    BST_REQUIRE(duration::zero() == limiter.admit(U("192.0.2.2"), now));
+
+    // tokens are refilled at the specified rate
+    BST_REQUIRE(duration::zero() == limiter.admit(U("192.0.2.1"), now + milliseconds(100)));
+    BST_REQUIRE(duration::zero() != limiter.admit(U("192.0.2.1"), now + milliseconds(100)));
+
+    // but not beyond the burst size
+    BST_REQUIRE(duration::zero() == limiter.admit(U("192.0.2.1"), now + milliseconds(10000)));
+    BST_REQUIRE(duration::zero() == limiter.admit(U("192.0.2.1"), now + milliseconds(10000)));
+    BST_REQUIRE(duration::zero() == limiter.admit(U("192.0.2.1"), now + milliseconds(10000)));
+    BST_REQUIRE(duration::zero() != limiter.admit(U("192.0.2.1"), now + milliseconds(10000)));
+}
@@ -0,0 +1,74 @@
+// The first "test" is of course whether the header compiles standalone
+#include "nmos/registration_validation.h"
+
+#include "bst/test/test.h"
+
+////////////////////////////////////////////////////////////////////////////////////////////
+BST_TEST_CASE(testAddressRange)
+{
+    using nmos::experimental::parse_address_range;
+    using nmos::experimental::in_address_range;
+
+    const auto v4 = parse_address_range(U("192.0.2.0/24"));
+    BST_REQUIRE(in_address_range(v4, U("192.0.2.1")));
+    BST_REQUIRE(in_address_range(v4, U("::ffff:192.0.2.255")));
+    BST_REQUIRE(!in_address_range(v4, U("192.0.3.1")));
+    BST_REQUIRE(!in_address_range(v4, U("2001:db8::1")));
+    BST_REQUIRE(!in_address_range(v4, U("not an address")));
+
+    const auto odd = parse_address_range(U("198.51.100.128/25"));
+    BST_REQUIRE(in_address_range(odd, U("198.51.100.200")));
+    BST_REQUIRE(!in_address_range(odd, U("198.51.100.127")));
+
+    const auto v6 = parse_address_range(U("2001:db8::/32"));
+    BST_REQUIRE(in_address_range(v6, U("2001:db8:1::1")));
+    BST_REQUIRE(!in_address_range(v6, U("2001:db9::1")));
+
+    // a single address
+    const auto single = parse_address_range(U("192.0.2.1"));
+    BST_REQUIRE(in_address_range(single, U("192.0.2.1")));
+    BST_REQUIRE(!in_address_range(single, U("192.0.2.2")));
+
+    BST_REQUIRE_THROW(parse_address_range(U("192.0.2.0/33")), web::json::json_exception);
+    BST_REQUIRE_THROW(parse_address_range(U("192.0.2.0/")), web::json::json_exception);
+    BST_REQUIRE_THROW(parse_address_range(U("example.com/8")), web::json::json_exception);
+}
+
+////////////////////////////////////////////////////////////////////////////////////////////
+BST_TEST_CASE(testRegistrationValidationPolicies)
+{
+    const auto node_id = U("3b8be755-08ff-452b-b217-c9151eb21193");
+    const auto other_node_id = U("d2f58ea1-b81f-4e84-8bd5-4e2d3f7f9b2e");
+
+    nmos::experimental::registration_validation_policies policies(web::json::value_of({
+        // validation is skipped for the trusted node from the trusted range
+        web::json::value_of({
+            { U("addresses"), web::json::value_of({ U("192.0.2.0/24") }) },
+            { U("node_ids"), web::json::value_of({ node_id }) },
+            { U("validation_interval"), 0 }
+        }),
+        // and sampled for any other node from that range
+        web::json::value_of({
+            { U("addresses"), web::json::value_of({ U("192.0.2.0/24") }) },
+            { U("validation_interval"), 3 }
+        })
+    }));
+
+    int lookups = 0;
+    const auto node = [&] { ++lookups; return utility::string_t(node_id); };
+    const auto other_node = [&] { ++lookups; return utility::string_t(other_node_id); };
+
+    BST_REQUIRE(!policies.validate(U("192.0.2.1"), node));
+    BST_REQUIRE(!policies.validate(U("192.0.2.1"), node));
+
+    BST_REQUIRE(policies.validate(U("192.0.2.1"), other_node));
+    BST_REQUIRE(!policies.validate(U("192.0.2.1"), other_node));
+    BST_REQUIRE(!policies.validate(U("192.0.2.1"), other_node));
+    BST_REQUIRE(policies.validate(U("192.0.2.1"), other_node));
+
+    // untrusted clients have full validation, and the node id isn't looked up when no policy matches the address
+    lookups = 0;
+    BST_REQUIRE(policies.validate(U("198.51.100.1"), node));
+    BST_REQUIRE(policies.validate(U("198.51.100.1"), node));
+    BST_REQUIRE_EQUAL(0, lookups);
+}
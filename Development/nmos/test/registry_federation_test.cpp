@@ -0,0 +1,59 @@
+// The first "test" is of course whether the header compiles standalone
+#include "nmos/registry_federation.h"
+
+#include <set>
+#include "bst/test/test.h"
+
+namespace
+{
+    const std::vector<utility::string_t> test_shards
+    {
+        U("http://192.0.2.1:3210/x-nmos/registration/v1.3"),
+        U("http://192.0.2.2:3210/x-nmos/registration/v1.3"),
+        U("http://192.0.2.3:3210/x-nmos/registration/v1.3")
+    };
+}
+
+////////////////////////////////////////////////////////////////////////////////////////////
+BST_TEST_CASE(testShardRingFind)
+{
+    const nmos::experimental::details::shard_ring ring(test_shards);
+    BST_REQUIRE_EQUAL(test_shards.size(), ring.size());
+
+    // the shards are listed in a different order, so the indexes differ, but the owner of each node must not
+    const std::vector<utility::string_t> reversed(test_shards.rbegin(), test_shards.rend());
+    const nmos::experimental::details::shard_ring reversed_ring(reversed);
+
+    std::set<std::size_t> found;
+    for (int i = 0; i < 300; ++i)
+    {
+        const auto node_id = nmos::make_id();
+        const auto shard = ring.find(node_id);
+        BST_REQUIRE(shard < test_shards.size());
+        BST_REQUIRE_EQUAL(shard, ring.find(node_id));
+        BST_REQUIRE(test_shards[shard] == reversed[reversed_ring.find(node_id)]);
+        found.insert(shard);
+    }
+    // every shard owns some of the nodes
+    BST_REQUIRE_EQUAL(test_shards.size(), found.size());
+}
+
+////////////////////////////////////////////////////////////////////////////////////////////
+BST_TEST_CASE(testShardRingRemoveShard)
+{
+    const nmos::experimental::details::shard_ring ring(test_shards);
+
+    const std::vector<utility::string_t> fewer_shards(test_shards.begin(), test_shards.end() - 1);
+    const nmos::experimental::details::shard_ring fewer_ring(fewer_shards);
+
+    // removing a shard only moves the nodes which it owned
+    for (int i = 0; i < 300; ++i)
+    {
+        const auto node_id = nmos::make_id();
+        const auto shard = ring.find(node_id);
+        if (test_shards.size() - 1 != shard)
+        {
+            BST_REQUIRE_EQUAL(shard, fewer_ring.find(node_id));
+        }
+    }
+}
@@ -0,0 +1,181 @@
+// The first "test" is of course whether the header compiles standalone
+#include "nmos/registry_snapshot.h"
+
+#include <sstream>
+#include "bst/test/test.h"
+#include "cpprest/basic_utils.h"
+#include "cpprest/json_utils.h"
+#include "nmos/is04_versions.h"
+#include "nmos/json_fields.h"
+#include "slog/all_in_one.h"
+
+namespace
+{
+    struct test_gate : public slog::base_gate
+    {
+        virtual bool pertinent(slog::severity level) const { return false; }
+        virtual void log(const slog::log_message& message) const {}
+    };
+
+    nmos::resource make_test_resource(const nmos::type& type, const nmos::id& id, const utility::string_t& super_field = {}, const nmos::id& super_id = {}, bool never_expire = false)
+    {
+        auto data = web::json::value_of({ { nmos::fields::id, id } });
+        if (!super_field.empty()) data[super_field] = web::json::value::string(super_id);
+        return{ nmos::is04_versions::v1_2, type, std::move(data), never_expire };
+    }
+}
+
+////////////////////////////////////////////////////////////////////////////////////////////
+BST_TEST_CASE(testRegistrySnapshotRoundTrip)
+{
+    test_gate gate;
+
+    const auto node_id = nmos::make_id();
+    const auto device_id = nmos::make_id();
+    const auto self_id = nmos::make_id();
+
+    nmos::resources resources;
+    nmos::insert_resource(resources, make_test_resource(nmos::types::node, node_id));
+    nmos::insert_resource(resources, make_test_resource(nmos::types::device, device_id, U("node_id"), node_id));
+    nmos::insert_resource(resources, make_test_resource(nmos::types::node, self_id, {}, {}, true));
+    nmos::details::set_resource_health(resources, *resources.find(node_id), 100);
+    nmos::details::set_resource_health(resources, *resources.find(device_id), 100);
+
+    nmos::experimental::details::snapshot_cache cache;
+    std::string snapshot;
+    nmos::experimental::details::write_snapshot(snapshot, resources, cache, 110);
+    BST_REQUIRE_EQUAL(3, cache.size());
+
+    // restore into resources that already include the self resource
+    nmos::resources restored;
+    nmos::insert_resource(restored, make_test_resource(nmos::types::node, self_id, {}, {}, true));
+
+    std::istringstream is(snapshot);
+    BST_REQUIRE_EQUAL(2, nmos::experimental::details::read_snapshot(restored, is, gate, 1000));
+    BST_REQUIRE_EQUAL(3, restored.size());
+
+    // health is relative to the time of the snapshot
+    BST_REQUIRE_EQUAL(990, restored.find(node_id)->health);
+    BST_REQUIRE_EQUAL(990, restored.find(device_id)->health);
+    BST_REQUIRE_EQUAL(nmos::health_forever, restored.find(self_id)->health);
+
+    // sub-resources are joined to their super-resource
+    BST_REQUIRE_EQUAL(1, restored.find(node_id)->sub_resources.count(device_id));
+
+    // an unchanged snapshot is the same when written again from the cache
+    std::string again;
+    nmos::experimental::details::write_snapshot(again, resources, cache, 110);
+    BST_REQUIRE_EQUAL(snapshot, again);
+}
+
+////////////////////////////////////////////////////////////////////////////////////////////
+BST_TEST_CASE(testRegistrySnapshotMalformed)
+{
+    test_gate gate;
+
+    nmos::resources restored;
+    {
+        std::istringstream is("not a snapshot\n");
+        BST_REQUIRE_EQUAL(0, nmos::experimental::details::read_snapshot(restored, is, gate));
+    }
+    {
+        // e.g. truncated while being written
+        std::istringstream is("{\"nmos_cpp_registry_snapshot\":1}\n{\"age\":0,\"type\":\"node\",\"vers");
+        BST_REQUIRE_EQUAL(0, nmos::experimental::details::read_snapshot(restored, is, gate));
+    }
+    BST_REQUIRE(restored.empty());
+}
+
+////////////////////////////////////////////////////////////////////////////////////////////
+BST_TEST_CASE(testRegistryJournalReplay)
+{
+    test_gate gate;
+
+    const auto node_id = nmos::make_id();
+    const auto device_id = nmos::make_id();
+
+    nmos::resources resources;
+    resources.journal = std::make_shared<nmos::experimental::resource_journal>(100, 41);
+    nmos::insert_resource(resources, make_test_resource(nmos::types::node, node_id));
+
+    // a snapshot includes the changes journaled so far
+    nmos::experimental::details::snapshot_cache cache;
+    std::string snapshot;
+    nmos::experimental::details::write_snapshot(snapshot, resources, cache, 110);
+    BST_REQUIRE_EQUAL(42, resources.journal->sequence());
+
+    nmos::insert_resource(resources, make_test_resource(nmos::types::device, device_id, U("node_id"), node_id));
+    nmos::modify_resource(resources, node_id, [](nmos::resource& resource) { resource.data[U("label")] = web::json::value::string(U("modified")); });
+    nmos::erase_resource(resources, device_id);
+
+    std::vector<nmos::experimental::shared_journal_entry> entries;
+    BST_REQUIRE(resources.journal->read(resources.journal->origin_sequence(), entries));
+    BST_REQUIRE_EQUAL(4, entries.size());
+    BST_REQUIRE_EQUAL(42, entries.front()->sequence);
+    BST_REQUIRE_EQUAL(45, entries.back()->sequence);
+    BST_REQUIRE(!entries.back()->post);
+    BST_REQUIRE(entries.back()->pre);
+    std::vector<nmos::experimental::shared_journal_entry> none;
+    BST_REQUIRE(resources.journal->read(45, none));
+    BST_REQUIRE(none.empty());
+
+    std::string journal;
+    nmos::experimental::details::write_journal(journal, entries);
+
+    nmos::resources restored;
+    std::uint64_t journal_sequence = 0;
+    {
+        std::istringstream is(snapshot);
+        BST_REQUIRE_EQUAL(1, nmos::experimental::details::read_snapshot(restored, is, gate, 1000, &journal_sequence));
+        BST_REQUIRE_EQUAL(42, journal_sequence);
+    }
+    {
+        // the change to insert the node is already included in the snapshot
+        std::istringstream is(journal);
+        const auto replayed = nmos::experimental::details::read_journal(restored, is, gate, journal_sequence);
+        BST_REQUIRE_EQUAL(3, replayed.first);
+        BST_REQUIRE_EQUAL(45, replayed.second);
+    }
+
+    BST_REQUIRE_EQUAL(1, restored.size());
+    BST_REQUIRE_EQUAL(U("modified"), nmos::fields::label(restored.find(node_id)->data));
+}
+
+////////////////////////////////////////////////////////////////////////////////////////////
+BST_TEST_CASE(testResourceJournalRing)
+{
+    const auto node_id = nmos::make_id();
+
+    nmos::resources resources;
+    resources.journal = std::make_shared<nmos::experimental::resource_journal>(3);
+    nmos::insert_resource(resources, make_test_resource(nmos::types::node, node_id));
+    const auto inserted = resources.find(node_id)->updated;
+
+    std::vector<nmos::experimental::shared_journal_entry> entries;
+    BST_REQUIRE(resources.journal->read_since({}, entries));
+    BST_REQUIRE_EQUAL(1, entries.size());
+    BST_REQUIRE(!entries.front()->pre);
+    BST_REQUIRE(entries.front()->post);
+    BST_REQUIRE(inserted == entries.front()->updated);
+
+    for (int i = 0; i < 3; ++i)
+    {
+        nmos::modify_resource(resources, node_id, [i](nmos::resource& resource) { resource.data[U("label")] = web::json::value::string(utility::s2us(std::to_string(i))); });
+    }
+
+    // the ring is full, so the insertion is no longer retained, but the modifications are
+    entries.clear();
+    BST_REQUIRE(!resources.journal->read(0, entries));
+    BST_REQUIRE(!resources.journal->read_since({}, entries));
+    BST_REQUIRE(entries.empty());
+    BST_REQUIRE(resources.journal->read_since(inserted, entries));
+    BST_REQUIRE_EQUAL(3, entries.size());
+    BST_REQUIRE_EQUAL(U("2"), nmos::fields::label(*entries.back()->post));
+    BST_REQUIRE_EQUAL(U("1"), nmos::fields::label(*entries.back()->pre));
+
+    // each reader has its own cursor
+    entries.clear();
+    BST_REQUIRE(resources.journal->read(resources.journal->sequence() - 1, entries));
+    BST_REQUIRE_EQUAL(1, entries.size());
+    BST_REQUIRE_EQUAL(4, entries.front()->sequence);
+}
@@ -0,0 +1,172 @@
+// The first "test" is of course whether the header compiles standalone
+#include "nmos/resources.h"
+
+#include <functional> // for std::cref
+#include <random>
+#include "bst/test/benchmark.h"
+#include "bst/test/test.h"
+#include "nmos/api_downgrade.h"
+#include "nmos/is04_versions.h"
+#include "nmos/node_resource.h"
+#include "nmos/node_resources.h"
+#include "nmos/query_utils.h"
+#include "nmos/transport.h"
+
+namespace
+{
+    // each node has one device with 4 senders, each with their own source and flow, and 4 receivers
+    const size_t resources_per_node = 18;
+
+    // insert nodes and their sub-resources until there are at least the specified number of resources,
+    // returning the ids of the senders
+    std::vector<nmos::id> insert_resources(nmos::resources& resources, size_t count, const nmos::settings& settings)
+    {
+        std::vector<nmos::id> sender_ids;
+        for (size_t node = 0; node * resources_per_node < count; ++node)
+        {
+            const auto node_id = nmos::make_id();
+            const auto device_id = nmos::make_id();
+            std::vector<nmos::id> device_sender_ids;
+            std::vector<nmos::id> device_receiver_ids;
+            std::vector<nmos::resource> sub_resources;
+
+            for (int sender = 0; sender < 4; ++sender)
+            {
+                const auto source_id = nmos::make_id();
+                const auto flow_id = nmos::make_id();
+                const auto sender_id = nmos::make_id();
+                sub_resources.push_back(nmos::make_video_source(source_id, device_id, nmos::rational(25, 1), settings));
+                sub_resources.push_back(nmos::make_raw_video_flow(flow_id, source_id, device_id, settings));
+                auto sender_resource = nmos::make_sender(sender_id, flow_id, device_id, {}, settings);
+                sender_resource.data[nmos::fields::label] = web::json::value::string(U("sender ") + sender_id);
+                sub_resources.push_back(std::move(sender_resource));
+                device_sender_ids.push_back(sender_id);
+            }
+            for (int receiver = 0; receiver < 4; ++receiver)
+            {
+                const auto receiver_id = nmos::make_id();
+                sub_resources.push_back(nmos::make_video_receiver(receiver_id, device_id, nmos::transports::rtp_mcast, {}, settings));
+                device_receiver_ids.push_back(receiver_id);
+            }
+
+            nmos::insert_resource(resources, nmos::make_node(node_id, settings));
+            nmos::insert_resource(resources, nmos::make_device(device_id, node_id, device_sender_ids, device_receiver_ids, settings));
+            for (auto& sub_resource : sub_resources)
+            {
+                nmos::insert_resource(resources, std::move(sub_resource));
+            }
+            sender_ids.insert(sender_ids.end(), device_sender_ids.begin(), device_sender_ids.end());
+        }
+        return sender_ids;
+    }
+
+    nmos::settings make_settings()
+    {
+        nmos::settings settings = web::json::value::object();
+        nmos::insert_node_default_settings(settings);
+        return settings;
+    }
+
+    std::string name(const std::string& operation, size_t count)
+    {
+        return operation + " (" + std::to_string(count / 1000) + "k resources)";
+    }
+
+    void benchmark_resources(size_t count)
+    {
+        const auto settings = make_settings();
+        nmos::resources resources;
+        const auto sender_ids = insert_resources(resources, count, settings);
+        BST_REQUIRE_LE(count, resources.size());
+
+        // ids are looked up in a shuffled order, since in practice consecutive lookups are unrelated
+        std::vector<nmos::id> ids;
+        for (const auto& resource : resources) ids.push_back(resource.id);
+        std::shuffle(ids.begin(), ids.end(), std::default_random_engine{});
+
+        size_t next = 0;
+        bst::test::benchmark(name("find_resource by id", count), [&]
+        {
+            bst::test::do_not_optimize(nmos::find_resource(resources, ids[next++ % ids.size()]));
+        });
+
+        bst::test::benchmark(name("find_resource by id and type", count), [&]
+        {
+            bst::test::do_not_optimize(nmos::find_resource(resources, { sender_ids[next++ % sender_ids.size()], nmos::types::sender }));
+        });
+
+        bst::test::benchmark(name("least_health", count), [&]
+        {
+            bst::test::do_not_optimize(nmos::least_health(resources));
+        });
+
+        // a receiver is inserted and erased again, so that the number of resources stays the same
+        const auto device_id = nmos::fields::device_id(nmos::find_resource(resources, { sender_ids.front(), nmos::types::sender })->data);
+        const auto receiver = nmos::make_video_receiver(nmos::make_id(), device_id, nmos::transports::rtp_mcast, {}, settings);
+        bst::test::benchmark(name("insert_resource and erase_resource", count), [&]
+        {
+            auto copy = receiver;
+            nmos::insert_resource(resources, std::move(copy));
+            bst::test::do_not_optimize(nmos::erase_resource(resources, receiver.id));
+        });
+
+        // a Basic Query which matches a single sender, so the whole updated index must be filtered
+        const nmos::resource_query selective_query(nmos::is04_versions::v1_3, U("/senders"), web::json::value_of({ { nmos::fields::label, web::json::value::string(U("sender ") + sender_ids[sender_ids.size() / 2]) } }));
+        bst::test::benchmark(name("cursor_based_page with a selective Basic Query", count), [&]
+        {
+            nmos::resource_paging paging(web::json::value::object(), nmos::tai_max(), 10, 10);
+            auto page = paging.page(resources, std::cref(selective_query));
+            bst::test::do_not_optimize(std::distance(page.begin(), page.end()));
+        });
+
+        // an Advanced Query using RQL which matches all the senders and receivers
+        const nmos::resource_query rql_query(nmos::is04_versions::v1_3, {}, web::json::value_of({ { U("query.rql"), JU("eq(transport,urn%3Ax-nmos%3Atransport%3Artp.mcast)") } }));
+        bst::test::benchmark(name("cursor_based_page with an RQL query", count), [&]
+        {
+            nmos::resource_paging paging(web::json::value::object(), nmos::tai_max(), 10, 10);
+            auto page = paging.page(resources, std::cref(rql_query));
+            bst::test::do_not_optimize(std::distance(page.begin(), page.end()));
+        });
+
+        bst::test::benchmark(name("make_resource_events for /senders", count), [&]
+        {
+            bst::test::do_not_optimize(nmos::make_resource_events(resources, nmos::is04_versions::v1_3, U("/senders"), web::json::value::object()));
+        }, std::chrono::seconds(1));
+    }
+}
+
+////////////////////////////////////////////////////////////////////////////////////////////
+BST_TEST_CASE(benchmarkResources10k)
+{
+    benchmark_resources(10000);
+}
+
+////////////////////////////////////////////////////////////////////////////////////////////
+BST_TEST_CASE(benchmarkResources100k)
+{
+    benchmark_resources(100000);
+}
+
+////////////////////////////////////////////////////////////////////////////////////////////
+BST_TEST_CASE(benchmarkDowngrade)
+{
+    const auto settings = make_settings();
+    const auto sender = nmos::make_sender(nmos::make_id(), nmos::make_id(), nmos::make_id(), {}, settings);
+
+    bst::test::benchmark("downgrade v1.3 sender to v1.2", [&]
+    {
+        bst::test::do_not_optimize(nmos::downgrade(sender.version, sender.type, sender.data, nmos::is04_versions::v1_2, nmos::is04_versions::v1_2));
+    });
+
+    bst::test::benchmark("downgrade v1.3 sender to v1.3 (identity)", [&]
+    {
+        bst::test::do_not_optimize(nmos::downgrade(sender.version, sender.type, sender.data, nmos::is04_versions::v1_3, nmos::is04_versions::v1_3));
+    });
+
+    bst::test::benchmark("serialize v1.3 sender downgraded to v1.1", [&]
+    {
+        std::string utf8;
+        nmos::serialize_downgrade_utf8(utf8, sender.version, sender.type, sender.data, nmos::is04_versions::v1_1, nmos::is04_versions::v1_1);
+        bst::test::do_not_optimize(utf8);
+    });
+}
@@ -0,0 +1,57 @@
+// The first "test" is of course whether the header compiles standalone
+#include "nmos/resources_shared_memory.h"
+
+#include <new>
+#include <vector>
+#include "bst/test/test.h"
+
+////////////////////////////////////////////////////////////////////////////////////////////
+BST_TEST_CASE(testSharedMemorySequenceLock)
+{
+    using namespace nmos::experimental::details;
+
+    // a region in ordinary memory, suitably aligned for the header
+    const std::uint64_t capacity = 64;
+    std::vector<std::uint64_t> region(1 + (sizeof(shared_memory_header) + capacity) / sizeof(std::uint64_t));
+    auto& header = *new (region.data()) shared_memory_header;
+    init_shared_memory(header, capacity);
+
+    std::string snapshot;
+    std::uint64_t change_counter = 42;
+    const auto read = [&](const char* first, const char* last, std::uint64_t counter)
+    {
+        snapshot.assign(first, last);
+        change_counter = counter;
+    };
+
+    // an empty region is consistent
+    BST_REQUIRE(read_shared_memory(header, read));
+    BST_REQUIRE(snapshot.empty());
+    BST_REQUIRE_EQUAL(0, change_counter);
+
+    BST_REQUIRE(write_shared_memory(header, "{\"nmos_cpp_registry_snapshot\":1}\n"));
+    BST_REQUIRE(read_shared_memory(header, read));
+    BST_REQUIRE_EQUAL("{\"nmos_cpp_registry_snapshot\":1}\n", snapshot);
+    BST_REQUIRE_EQUAL(1, change_counter);
+
+    // a snapshot that doesn't fit isn't published, and the previous one remains
+    BST_REQUIRE(!write_shared_memory(header, std::string(capacity + 1, 'x')));
+    BST_REQUIRE(read_shared_memory(header, read));
+    BST_REQUIRE_EQUAL("{\"nmos_cpp_registry_snapshot\":1}\n", snapshot);
+    BST_REQUIRE_EQUAL(1, change_counter);
+
+    // a read that overlaps a write is inconsistent
+    BST_REQUIRE(!read_shared_memory(header, [&](const char* first, const char* last, std::uint64_t counter)
+    {
+        write_shared_memory(header, "{}\n");
+    }));
+    BST_REQUIRE(read_shared_memory(header, read));
+    BST_REQUIRE_EQUAL("{}\n", snapshot);
+    BST_REQUIRE_EQUAL(2, change_counter);
+
+    // as is a read while a write is in progress
+    header.sequence.fetch_add(1);
+    BST_REQUIRE(!read_shared_memory(header, read));
+    header.sequence.fetch_add(1);
+    BST_REQUIRE(read_shared_memory(header, read));
+}
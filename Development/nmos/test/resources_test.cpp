@@ -0,0 +1,577 @@
+// The first "test" is of course whether the header compiles standalone
+#include "nmos/resources.h"
+
+#include <algorithm>
+#include "bst/test/test.h"
+#include "nmos/is04_versions.h"
+#include "nmos/json_fields.h"
+#include "nmos/query_utils.h"
+
+namespace
+{
+    nmos::resource make_test_resource(const nmos::type& type, const nmos::id& id, const utility::string_t& super_field = {}, const nmos::id& super_id = {})
+    {
+        auto data = web::json::value_of({ { nmos::fields::id, id } });
+        if (!super_field.empty()) data[super_field] = web::json::value::string(super_id);
+        return{ nmos::is04_versions::v1_2, type, std::move(data), false };
+    }
+}
+
+////////////////////////////////////////////////////////////////////////////////////////////
+BST_TEST_CASE(testResourcesMemoryUsage)
+{
+    const auto node_id = nmos::make_id();
+    const auto device_id = nmos::make_id();
+    const auto source_id = nmos::make_id();
+
+    nmos::resources resources;
+    BST_REQUIRE_EQUAL(0, nmos::experimental::memory_usage(resources));
+
+    nmos::insert_resource(resources, make_test_resource(nmos::types::node, node_id));
+    nmos::insert_resource(resources, make_test_resource(nmos::types::device, device_id, U("node_id"), node_id));
+    nmos::insert_resource(resources, make_test_resource(nmos::types::source, source_id, U("device_id"), device_id));
+
+    // sub-resources are accounted to the node
+    BST_REQUIRE_EQUAL(node_id, nmos::experimental::get_memory_usage_node(resources, *resources.find(source_id)));
+    const auto node_bytes = nmos::experimental::node_memory_usage(resources, node_id);
+    BST_REQUIRE(0 < node_bytes);
+    BST_REQUIRE_EQUAL(node_bytes, nmos::experimental::memory_usage(resources));
+
+    // modifications are accounted too
+    nmos::modify_resource(resources, source_id, [](nmos::resource& resource) { resource.data[U("description")] = web::json::value::string(utility::string_t(1000, U('x'))); });
+    BST_REQUIRE(node_bytes + 1000 < nmos::experimental::node_memory_usage(resources, node_id));
+
+    // "erased" resources still use some memory, until they are forgotten
+    nmos::erase_resource(resources, node_id, false);
+    BST_REQUIRE(0 < nmos::experimental::node_memory_usage(resources, node_id));
+    BST_REQUIRE(nmos::experimental::node_memory_usage(resources, node_id) < node_bytes);
+
+    nmos::forget_erased_resources(resources);
+    BST_REQUIRE_EQUAL(0, nmos::experimental::node_memory_usage(resources, node_id));
+    BST_REQUIRE_EQUAL(0, nmos::experimental::memory_usage(resources));
+    BST_REQUIRE(resources.memory_usage.nodes.empty());
+}
+
+////////////////////////////////////////////////////////////////////////////////////////////
+BST_TEST_CASE(testResourcesTotalCount)
+{
+    const auto node_id = nmos::make_id();
+    const auto device1_id = nmos::make_id();
+    const auto device2_id = nmos::make_id();
+
+    nmos::resources resources;
+    nmos::insert_resource(resources, make_test_resource(nmos::types::node, node_id));
+    nmos::insert_resource(resources, make_test_resource(nmos::types::device, device1_id, U("node_id"), node_id));
+    nmos::insert_resource(resources, make_test_resource(nmos::types::device, device2_id, U("node_id"), node_id));
+    BST_REQUIRE_EQUAL(2, (resources.counts[{ nmos::types::device, nmos::is04_versions::v1_2 }]));
+
+    const auto total_count = [&](const web::json::value& flat_query_params)
+    {
+        const nmos::resource_query query(nmos::is04_versions::v1_2, U("/devices"), flat_query_params);
+        const nmos::resource_paging paging(flat_query_params, nmos::most_recent_update(resources));
+        return paging.total_count(resources, query);
+    };
+
+    // from the maintained resource counts
+    BST_REQUIRE_EQUAL(2, total_count(web::json::value_of({ { U("paging.count"), U("only") } })));
+    // from the secondary index
+    BST_REQUIRE_EQUAL(2, total_count(web::json::value_of({ { U("paging.count"), U("only") }, { U("node_id"), node_id } })));
+    // from the created index, e.g. for a query in a limited range
+    BST_REQUIRE_EQUAL(1, total_count(web::json::value_of({ { U("paging.count"), U("only") }, { U("paging.order"), U("create") }, { U("paging.since"), nmos::make_version(resources.find(device1_id)->created) } })));
+    // from the id index, for one id or a batch of ids
+    BST_REQUIRE_EQUAL(1, total_count(web::json::value_of({ { U("paging.count"), U("only") }, { U("id"), device1_id } })));
+    BST_REQUIRE_EQUAL(2, total_count(web::json::value_of({ { U("paging.count"), U("only") }, { U("query.rql"), U("in(id,(") + device1_id + U(",") + node_id + U(",") + device2_id + U("))") } })));
+    // the downgrade parameters are taken into account
+    BST_REQUIRE_EQUAL(0, total_count(web::json::value_of({ { U("paging.count"), U("only") }, { U("query.downgrade"), U("v1.3") } })));
+
+    nmos::erase_resource(resources, device1_id, false);
+    BST_REQUIRE_EQUAL(1, total_count(web::json::value_of({ { U("paging.count"), U("only") } })));
+}
+
+////////////////////////////////////////////////////////////////////////////////////////////
+BST_TEST_CASE(testResourcesNonExtantCount)
+{
+    const auto node_id = nmos::make_id();
+    const auto device1_id = nmos::make_id();
+    const auto device2_id = nmos::make_id();
+
+    nmos::resources resources;
+    nmos::insert_resource(resources, make_test_resource(nmos::types::node, node_id));
+    nmos::insert_resource(resources, make_test_resource(nmos::types::device, device1_id, U("node_id"), node_id));
+    nmos::insert_resource(resources, make_test_resource(nmos::types::device, device2_id, U("node_id"), node_id));
+    BST_REQUIRE_EQUAL(3, nmos::count_resources(resources));
+    BST_REQUIRE_EQUAL(2, nmos::count_resources(resources, nmos::types::device));
+    BST_REQUIRE_EQUAL(0, nmos::count_non_extant_resources(resources));
+
+    // "erased" resources are counted until they are forgotten
+    nmos::erase_resource(resources, device1_id, false);
+    BST_REQUIRE_EQUAL(1, nmos::count_resources(resources, nmos::types::device));
+    BST_REQUIRE_EQUAL(1, nmos::count_non_extant_resources(resources, nmos::types::device));
+
+    // or reinserted
+    nmos::insert_resource(resources, make_test_resource(nmos::types::device, device1_id, U("node_id"), node_id));
+    BST_REQUIRE_EQUAL(2, nmos::count_resources(resources, nmos::types::device));
+    BST_REQUIRE_EQUAL(0, nmos::count_non_extant_resources(resources));
+
+    // including the sub-resources of an "erased" resource
+    nmos::erase_resource(resources, node_id, false);
+    BST_REQUIRE_EQUAL(0, nmos::count_resources(resources));
+    BST_REQUIRE_EQUAL(3, nmos::count_non_extant_resources(resources));
+    BST_REQUIRE_EQUAL(resources.size(), nmos::count_non_extant_resources(resources));
+
+    nmos::forget_erased_resources(resources);
+    BST_REQUIRE_EQUAL(0, nmos::count_non_extant_resources(resources));
+    BST_REQUIRE(resources.empty());
+}
+
+////////////////////////////////////////////////////////////////////////////////////////////
+BST_TEST_CASE(testResourcesTypedPaging)
+{
+    const auto node_id = nmos::make_id();
+    const auto device1_id = nmos::make_id();
+    const auto source_id = nmos::make_id();
+    const auto device2_id = nmos::make_id();
+
+    nmos::resources resources;
+    nmos::insert_resource(resources, make_test_resource(nmos::types::node, node_id));
+    nmos::insert_resource(resources, make_test_resource(nmos::types::device, device1_id, U("node_id"), node_id));
+    nmos::insert_resource(resources, make_test_resource(nmos::types::source, source_id, U("device_id"), device1_id));
+    nmos::insert_resource(resources, make_test_resource(nmos::types::device, device2_id, U("node_id"), node_id));
+
+    // the typed index has the same descending order as the created index, but skips the other types
+    const nmos::details::typed_resources<nmos::tags::type_created> typed(resources.get<nmos::tags::type_created>(), nmos::types::device);
+    BST_REQUIRE_EQUAL(2, std::distance(typed.begin(), typed.end()));
+    BST_REQUIRE_EQUAL(device2_id, typed.begin()->id);
+    BST_REQUIRE_EQUAL(device1_id, nmos::details::lower_bound(typed, resources.find(device1_id)->created)->id);
+    BST_REQUIRE(typed.end() == nmos::details::lower_bound(typed, resources.find(node_id)->created));
+    // the number of devices in a range doesn't depend on the other types either
+    BST_REQUIRE_EQUAL(1, nmos::details::index_distance(typed.index, typed.begin(), nmos::details::lower_bound(typed, resources.find(device1_id)->created)));
+
+    const auto flat_query_params = web::json::value_of({ { U("paging.order"), U("create") }, { U("paging.limit"), 1 } });
+    const nmos::resource_query query(nmos::is04_versions::v1_2, U("/devices"), flat_query_params);
+    nmos::resource_paging paging(flat_query_params, nmos::most_recent_update(resources));
+
+    // the most recent device
+    auto page = paging.page(resources, std::cref(query), query);
+    BST_REQUIRE_EQUAL(1, std::distance(page.begin(), page.end()));
+    BST_REQUIRE_EQUAL(device2_id, page.begin()->id);
+
+    // the same page, and paging parameters, without the type erasure
+    nmos::resource_paging visited(flat_query_params, nmos::most_recent_update(resources));
+    std::vector<nmos::id> visited_ids;
+    visited.for_each_in_page(resources, std::cref(query), query, 0, [&](const nmos::resource& resource) { visited_ids.push_back(resource.id); });
+    BST_REQUIRE_EQUAL(1, visited_ids.size());
+    BST_REQUIRE_EQUAL(device2_id, visited_ids.front());
+    BST_REQUIRE_EQUAL(paging.since, visited.since);
+
+    // the previous page is just the other device, not the source created between them
+    paging.until = paging.since;
+    paging.since = nmos::tai_min();
+    page = paging.page(resources, std::cref(query), query);
+    BST_REQUIRE_EQUAL(1, std::distance(page.begin(), page.end()));
+    BST_REQUIRE_EQUAL(device1_id, page.begin()->id);
+}
+
+////////////////////////////////////////////////////////////////////////////////////////////
+BST_TEST_CASE(testResourcesSubscriptionKeys)
+{
+    const auto subscription_id = nmos::make_id();
+
+    auto data = web::json::value_of({
+        { nmos::fields::id, subscription_id },
+        { nmos::fields::max_update_rate_ms, 100 },
+        { nmos::fields::persist, false },
+        { nmos::fields::secure, false },
+        { nmos::fields::resource_path, U("/nodes") },
+        { nmos::fields::params, web::json::value_of({ { U("label"), U("foo") }, { U("description"), U("bar") } }) },
+        { nmos::fields::ws_href, U("ws://example.com:3213/x-nmos/query/v1.2/subscriptions/") + subscription_id }
+    });
+
+    nmos::resources resources;
+    nmos::insert_resource(resources, { nmos::is04_versions::v1_2, nmos::types::subscription, data, false });
+
+    // the key doesn't depend on the order of the params
+    auto request = data;
+    request[nmos::fields::params] = web::json::value_of({ { U("description"), U("bar") }, { U("label"), U("foo") } }, true);
+    const auto key = nmos::details::make_subscription_key(nmos::is04_versions::v1_2, web::json::value::parse(request.serialize()), U("example.com"));
+    BST_REQUIRE_EQUAL(1, resources.subscription_keys.ids.count(key));
+    BST_REQUIRE_EQUAL(subscription_id, resources.subscription_keys.ids.at(key));
+
+    // nor does it match a subscription served via a different host
+    BST_REQUIRE_EQUAL(0, resources.subscription_keys.ids.count(nmos::details::make_subscription_key(nmos::is04_versions::v1_2, data, U("example.org"))));
+
+    nmos::erase_resource(resources, subscription_id, false);
+    BST_REQUIRE(resources.subscription_keys.ids.empty());
+    BST_REQUIRE(resources.subscription_keys.keys.empty());
+}
+
+////////////////////////////////////////////////////////////////////////////////////////////
+BST_TEST_CASE(testResourcesCascadedDeletionEvents)
+{
+    const auto node_id = nmos::make_id();
+    const auto device_id = nmos::make_id();
+    const auto source_id = nmos::make_id();
+    const auto subscription_id = nmos::make_id();
+    const auto grain_id = nmos::make_id();
+
+    nmos::resources resources;
+    nmos::insert_resource(resources, make_test_resource(nmos::types::node, node_id));
+    nmos::insert_resource(resources, make_test_resource(nmos::types::device, device_id, U("node_id"), node_id));
+    nmos::insert_resource(resources, make_test_resource(nmos::types::source, source_id, U("device_id"), device_id));
+
+    // a subscription to all resource types, with a grain for a websocket connection
+    nmos::insert_resource(resources, { nmos::is04_versions::v1_2, nmos::types::subscription, web::json::value_of({
+        { nmos::fields::id, subscription_id },
+        { nmos::fields::max_update_rate_ms, 100 },
+        { nmos::fields::persist, false },
+        { nmos::fields::secure, false },
+        { nmos::fields::resource_path, U("") },
+        { nmos::fields::params, web::json::value::object() },
+        { nmos::fields::ws_href, U("ws://example.com:3213/x-nmos/query/v1.2/subscriptions/") + subscription_id }
+    }), false });
+    nmos::insert_resource(resources, { nmos::is04_versions::v1_2, nmos::types::grain, web::json::value_of({
+        { nmos::fields::id, grain_id },
+        { nmos::fields::subscription_id, subscription_id },
+        { nmos::fields::message, nmos::details::make_grain({}, {}, U("/")) }
+    }), false });
+
+    nmos::erase_resource(resources, node_id, false);
+
+    // the events for the whole cascade are inserted into the grain together, with sub-resources before super-resources
+    const auto grain = resources.find(grain_id);
+    BST_REQUIRE(resources.end() != grain);
+    const auto& events = nmos::fields::message_grain_data(grain->data);
+    BST_REQUIRE_EQUAL(3, events.size());
+    BST_REQUIRE_EQUAL(source_id, nmos::fields::id(events.at(0).at(U("pre"))));
+    BST_REQUIRE_EQUAL(device_id, nmos::fields::id(events.at(1).at(U("pre"))));
+    BST_REQUIRE_EQUAL(node_id, nmos::fields::id(events.at(2).at(U("pre"))));
+    BST_REQUIRE(!events.at(2).has_field(U("post")));
+
+    // and the grain was modified after the resources were erased
+    BST_REQUIRE(resources.find(node_id)->updated < grain->updated);
+}
+
+////////////////////////////////////////////////////////////////////////////////////////////
+BST_TEST_CASE(testResourcesPatchEvents)
+{
+    const auto node_id = nmos::make_id();
+    const auto device_id = nmos::make_id();
+    const auto subscription_id = nmos::make_id();
+    const auto grain_id = nmos::make_id();
+
+    nmos::resources resources;
+    nmos::insert_resource(resources, make_test_resource(nmos::types::node, node_id));
+    nmos::insert_resource(resources, make_test_resource(nmos::types::device, device_id, U("node_id"), node_id));
+
+    // a subscription to devices which requested JSON Patch 'modified' events, with a grain for a websocket connection
+    nmos::insert_resource(resources, { nmos::is04_versions::v1_2, nmos::types::subscription, web::json::value_of({
+        { nmos::fields::id, subscription_id },
+        { nmos::fields::max_update_rate_ms, 100 },
+        { nmos::fields::persist, false },
+        { nmos::fields::secure, false },
+        { nmos::fields::resource_path, U("/devices") },
+        { nmos::fields::params, web::json::value_of({ { U("query.patch"), true } }) },
+        { nmos::fields::ws_href, U("ws://example.com:3213/x-nmos/query/v1.2/subscriptions/") + subscription_id }
+    }), false });
+    nmos::insert_resource(resources, { nmos::is04_versions::v1_2, nmos::types::grain, web::json::value_of({
+        { nmos::fields::id, grain_id },
+        { nmos::fields::subscription_id, subscription_id },
+        { nmos::fields::message, nmos::details::make_grain({}, {}, U("/devices/")) }
+    }), false });
+
+    nmos::modify_resource(resources, device_id, [](nmos::resource& resource) { resource.data[nmos::fields::label] = web::json::value::string(U("example")); });
+    nmos::erase_resource(resources, device_id, false);
+
+    const auto& events = nmos::fields::message_grain_data(resources.find(grain_id)->data);
+    BST_REQUIRE_EQUAL(2, events.size());
+
+    // the 'modified' event has just the differences
+    const auto& modified = events.at(0);
+    BST_REQUIRE_EQUAL(nmos::details::resource_modified_event, nmos::details::get_resource_event_type(modified));
+    BST_REQUIRE(!modified.has_field(U("pre")));
+    BST_REQUIRE(!modified.has_field(U("post")));
+    BST_REQUIRE_EQUAL(web::json::value_of({ web::json::value_of({ { U("op"), U("add") }, { U("path"), U("/label") }, { U("value"), U("example") } }) }), modified.at(U("patch")));
+
+    // whereas the 'removed' event is as usual
+    BST_REQUIRE_EQUAL(nmos::details::resource_removed_event, nmos::details::get_resource_event_type(events.at(1)));
+    BST_REQUIRE_EQUAL(U("example"), nmos::fields::label(events.at(1).at(U("pre"))));
+}
+
+////////////////////////////////////////////////////////////////////////////////////////////
+BST_TEST_CASE(testResourcesJoinSubResources)
+{
+    const auto node_id = nmos::make_id();
+    std::vector<nmos::id> device_ids{ nmos::make_id(), nmos::make_id(), nmos::make_id() };
+
+    // devices inserted before their node, e.g. by the allow_invalid_resources setting
+    nmos::resources resources;
+    for (const auto& device_id : device_ids)
+    {
+        nmos::insert_resource(resources, make_test_resource(nmos::types::device, device_id, U("node_id"), node_id));
+    }
+    nmos::insert_resource(resources, make_test_resource(nmos::types::node, node_id), true);
+
+    // the sub-resources are joined, in order
+    const auto& sub_resources = resources.find(node_id)->sub_resources;
+    std::sort(device_ids.begin(), device_ids.end());
+    BST_REQUIRE_EQUAL(device_ids.size(), sub_resources.size());
+    BST_REQUIRE(std::equal(device_ids.begin(), device_ids.end(), sub_resources.begin()));
+
+    // and are all erased with the node
+    BST_REQUIRE_EQUAL(4, nmos::erase_resource(resources, node_id, true));
+    BST_REQUIRE(resources.empty());
+}
+
+////////////////////////////////////////////////////////////////////////////////////////////
+BST_TEST_CASE(testResourcesForgetErasedResources)
+{
+    const auto node1_id = nmos::make_id();
+    const auto node2_id = nmos::make_id();
+    const auto node3_id = nmos::make_id();
+
+    nmos::resources resources;
+    nmos::insert_resource(resources, make_test_resource(nmos::types::node, node1_id));
+    nmos::insert_resource(resources, make_test_resource(nmos::types::node, node2_id));
+    nmos::insert_resource(resources, { nmos::is04_versions::v1_2, nmos::types::node, web::json::value_of({ { nmos::fields::id, node3_id } }), true });
+
+    const nmos::health health = 1000;
+    nmos::set_resource_health(resources, node1_id, health);
+    nmos::set_resource_health(resources, node2_id, health + 10);
+
+    // "erased" resources keep their health
+    nmos::erase_resource(resources, node1_id, false);
+    nmos::erase_resource(resources, node2_id, false);
+    nmos::erase_resource(resources, node3_id, false);
+    BST_REQUIRE_EQUAL(3, resources.size());
+
+    // only those which expired before the specified time are forgotten, as well as any which never expire
+    BST_REQUIRE_EQUAL(2, nmos::forget_erased_resources(resources, health + 1));
+    BST_REQUIRE(resources.end() == resources.find(node1_id));
+    BST_REQUIRE(resources.end() != resources.find(node2_id));
+    BST_REQUIRE(resources.end() == resources.find(node3_id));
+
+    BST_REQUIRE_EQUAL(1, nmos::forget_erased_resources(resources));
+    BST_REQUIRE(resources.empty());
+    BST_REQUIRE(resources.health_index.non_extant.empty());
+}
+
+////////////////////////////////////////////////////////////////////////////////////////////
+BST_TEST_CASE(testResourcesQueryCache)
+{
+    nmos::resources resources;
+    resources.query_cache.capacity = 2;
+
+    const auto query = web::json::value_of({ { U("label"), U("example") }, { U("query.rql"), U("eq(description,example)") } });
+    const auto page = web::json::value_of({ { U("paging.since"), U("1:0") }, { U("query.rql"), U("eq(description,example)") }, { U("label"), U("example") } });
+
+    // the same query is shared whatever the order of the parameters and the paging parameters
+    const auto first = nmos::details::get_resource_query(resources, nmos::is04_versions::v1_3, U("/senders"), query);
+    BST_REQUIRE(first == nmos::details::get_resource_query(resources, nmos::is04_versions::v1_3, U("/senders"), page));
+
+    // but not for another version or resource path
+    BST_REQUIRE(first != nmos::details::get_resource_query(resources, nmos::is04_versions::v1_2, U("/senders"), query));
+    BST_REQUIRE(first != nmos::details::get_resource_query(resources, nmos::is04_versions::v1_3, U("/receivers"), query));
+
+    // the least recently used queries are evicted
+    BST_REQUIRE_EQUAL(2, resources.query_cache.entries.size());
+    BST_REQUIRE(first != nmos::details::get_resource_query(resources, nmos::is04_versions::v1_3, U("/senders"), query));
+
+    // invalid queries are not cached
+    BST_REQUIRE_THROW(nmos::details::get_resource_query(resources, nmos::is04_versions::v1_3, U("/senders"), web::json::value_of({ { U("query.ancestry_id"), U("example") } })), std::runtime_error);
+    BST_REQUIRE_EQUAL(2, resources.query_cache.entries.size());
+}
+
+////////////////////////////////////////////////////////////////////////////////////////////
+BST_TEST_CASE(testResourcesQueryPageCache)
+{
+    const auto node_id = nmos::make_id();
+    const auto device_id = nmos::make_id();
+
+    nmos::resources resources;
+    nmos::insert_resource(resources, make_test_resource(nmos::types::node, node_id));
+    nmos::insert_resource(resources, make_test_resource(nmos::types::device, device_id, U("node_id"), node_id));
+
+    const auto make_page = [](const std::string& body) { return std::make_shared<const nmos::details::query_page>(nmos::details::query_page{ body, U("\"1:0/1\""), {} }); };
+
+    // a page is found while no resources of its type have changed
+    const auto devices = nmos::details::get_query_page_watermark(resources, nmos::types::device);
+    nmos::details::insert_query_page(resources, U("devices"), nmos::types::device, devices, make_page("[]"), 2);
+    BST_REQUIRE(!!nmos::details::find_query_page(resources, U("devices")));
+
+    // even when resources of other types change
+    nmos::modify_resource(resources, node_id, [](nmos::resource& resource) { resource.data[U("label")] = web::json::value::string(U("example")); });
+    BST_REQUIRE(!!nmos::details::find_query_page(resources, U("devices")));
+
+    // but not once a resource of its type is modified
+    nmos::modify_resource(resources, device_id, [](nmos::resource& resource) { resource.data[U("label")] = web::json::value::string(U("example")); });
+    BST_REQUIRE(!nmos::details::find_query_page(resources, U("devices")));
+    BST_REQUIRE(resources.page_cache.entries.empty());
+
+    // or expired, which doesn't set the update timestamp
+    const auto expiring = nmos::details::get_query_page_watermark(resources, nmos::types::device);
+    nmos::details::insert_query_page(resources, U("devices"), nmos::types::device, expiring, make_page("[]"), 2);
+    nmos::set_resource_health(resources, device_id, 0);
+    nmos::erase_expired_resources(resources, 1);
+    BST_REQUIRE(expiring < nmos::details::get_query_page_watermark(resources, nmos::types::device));
+    BST_REQUIRE(!nmos::details::find_query_page(resources, U("devices")));
+
+    // a page built against an out of date watermark is never found
+    nmos::details::insert_query_page(resources, U("devices"), nmos::types::device, devices, make_page("[]"), 2);
+    BST_REQUIRE(!nmos::details::find_query_page(resources, U("devices")));
+
+    // the least recently used pages are evicted
+    const auto nodes = nmos::details::get_query_page_watermark(resources, nmos::types::node);
+    nmos::details::insert_query_page(resources, U("nodes1"), nmos::types::node, nodes, make_page("[1]"), 2);
+    nmos::details::insert_query_page(resources, U("nodes2"), nmos::types::node, nodes, make_page("[2]"), 2);
+    BST_REQUIRE(!!nmos::details::find_query_page(resources, U("nodes1")));
+    nmos::details::insert_query_page(resources, U("nodes3"), nmos::types::node, nodes, make_page("[3]"), 2);
+    BST_REQUIRE_EQUAL(2, resources.page_cache.entries.size());
+    BST_REQUIRE(!nmos::details::find_query_page(resources, U("nodes2")));
+    BST_REQUIRE_EQUAL("[1]", nmos::details::find_query_page(resources, U("nodes1"))->body);
+}
+
+////////////////////////////////////////////////////////////////////////////////////////////
+BST_TEST_CASE(testResourcesViewCache)
+{
+    const auto node_id = nmos::make_id();
+    const auto device_id = nmos::make_id();
+
+    nmos::resources resources;
+    nmos::insert_resource(resources, make_test_resource(nmos::types::node, node_id));
+    nmos::insert_resource(resources, make_test_resource(nmos::types::device, device_id, U("node_id"), node_id));
+
+    const auto make_view = [](const std::string& body) { return std::make_shared<const nmos::details::query_page>(nmos::details::query_page{ body, U("\"1:0\""), {} }); };
+
+    // the views of a resource are found until it is modified
+    nmos::details::insert_resource_view(resources, device_id, U("state"), make_view("{}"));
+    nmos::details::insert_resource_view(resources, device_id, U("type"), make_view("[]"));
+    nmos::details::insert_resource_view(resources, node_id, U("state"), make_view("{}"));
+    BST_REQUIRE_EQUAL("[]", nmos::details::find_resource_view(resources, device_id, U("type"))->body);
+    BST_REQUIRE(!nmos::details::find_resource_view(resources, device_id, U("other")));
+
+    nmos::modify_resource(resources, device_id, [](nmos::resource& resource) { resource.data[U("label")] = web::json::value::string(U("example")); });
+    BST_REQUIRE(!nmos::details::find_resource_view(resources, device_id, U("state")));
+    BST_REQUIRE(!nmos::details::find_resource_view(resources, device_id, U("type")));
+
+    // but the views of other resources are unaffected
+    BST_REQUIRE(!!nmos::details::find_resource_view(resources, node_id, U("state")));
+
+    // and are discarded once the resource is erased
+    nmos::erase_resource(resources, node_id);
+    BST_REQUIRE(!nmos::details::find_resource_view(resources, node_id, U("state")));
+    BST_REQUIRE(resources.view_cache.views.empty());
+}
+
+////////////////////////////////////////////////////////////////////////////////////////////
+BST_TEST_CASE(testResourcesTagIndex)
+{
+    const auto node_id = nmos::make_id();
+    const auto device1_id = nmos::make_id();
+    const auto device2_id = nmos::make_id();
+
+    const auto tag = [](nmos::resource resource, const web::json::value& tags)
+    {
+        resource.data[U("tags")] = tags;
+        return resource;
+    };
+
+    nmos::resources resources;
+    nmos::insert_resource(resources, make_test_resource(nmos::types::node, node_id));
+    nmos::insert_resource(resources, tag(make_test_resource(nmos::types::device, device1_id, U("node_id"), node_id), web::json::value_of({ { U("location"), web::json::value_of({ U("studio1"), U("gallery") }) } })));
+    nmos::insert_resource(resources, tag(make_test_resource(nmos::types::device, device2_id, U("node_id"), node_id), web::json::value_of({ { U("location"), web::json::value_of({ U("studio2") }) } })));
+
+    BST_REQUIRE_EQUAL(1, nmos::details::find_tagged_resources(resources, U("location"), U("studio1")).size());
+    BST_REQUIRE_EQUAL(1, nmos::details::find_tagged_resources(resources, U("location"), U("gallery")).count(device1_id));
+    BST_REQUIRE(nmos::details::find_tagged_resources(resources, U("location"), U("studio3")).empty());
+
+    const auto find_candidates = [&](const web::json::value& flat_query_params)
+    {
+        const nmos::resource_query query(nmos::is04_versions::v1_2, U("/devices"), flat_query_params);
+        return nmos::details::find_indexed_resources(resources, query, false);
+    };
+
+    // a Basic Query, or an RQL query, on a tag finds its candidates via the tag index
+    auto candidates = find_candidates(web::json::value_of({ { U("tags.location"), U("studio2") } }));
+    BST_REQUIRE(!!candidates);
+    BST_REQUIRE_EQUAL(1, candidates->size());
+    BST_REQUIRE_EQUAL(device2_id, candidates->front()->id);
+
+    // each resource is a candidate only once, even if it has more than one of the values
+    candidates = find_candidates(web::json::value_of({ { U("query.rql"), U("in(tags.location,(studio1,gallery,studio2))") } }));
+    BST_REQUIRE(!!candidates);
+    BST_REQUIRE_EQUAL(2, candidates->size());
+    BST_REQUIRE_EQUAL(device2_id, candidates->front()->id);
+
+    // the index is kept up to date when resources are modified and erased
+    nmos::modify_resource(resources, device2_id, [](nmos::resource& resource) { resource.data[U("tags")] = web::json::value_of({ { U("location"), web::json::value_of({ U("studio1") }) } }); });
+    BST_REQUIRE(nmos::details::find_tagged_resources(resources, U("location"), U("studio2")).empty());
+    BST_REQUIRE_EQUAL(2, nmos::details::find_tagged_resources(resources, U("location"), U("studio1")).size());
+
+    nmos::erase_resource(resources, device1_id, false);
+    BST_REQUIRE_EQUAL(1, nmos::details::find_tagged_resources(resources, U("location"), U("studio1")).size());
+    BST_REQUIRE(nmos::details::find_tagged_resources(resources, U("location"), U("gallery")).empty());
+
+    nmos::erase_resource(resources, node_id);
+    BST_REQUIRE(resources.tagged_resources.ids.empty());
+    BST_REQUIRE(resources.tagged_resources.keys.empty());
+}
+
+////////////////////////////////////////////////////////////////////////////////////////////
+BST_TEST_CASE(testResourcesReceiverCompatibilityIndex)
+{
+    const auto node_id = nmos::make_id();
+    const auto device_id = nmos::make_id();
+    const auto video_id = nmos::make_id();
+    const auto any_video_id = nmos::make_id();
+    const auto audio_id = nmos::make_id();
+
+    const auto receiver = [&](const nmos::id& id, const utility::string_t& format, const web::json::value& caps)
+    {
+        auto resource = make_test_resource(nmos::types::receiver, id, U("device_id"), device_id);
+        resource.data[U("format")] = web::json::value::string(format);
+        resource.data[U("caps")] = caps;
+        return resource;
+    };
+
+    nmos::resources resources;
+    nmos::insert_resource(resources, make_test_resource(nmos::types::node, node_id));
+    nmos::insert_resource(resources, make_test_resource(nmos::types::device, device_id, U("node_id"), node_id));
+    nmos::insert_resource(resources, receiver(video_id, U("urn:x-nmos:format:video"), web::json::value_of({ { U("media_types"), web::json::value_of({ U("video/raw"), U("video/jxsv") }) } })));
+    nmos::insert_resource(resources, receiver(any_video_id, U("urn:x-nmos:format:video"), web::json::value::object()));
+    nmos::insert_resource(resources, receiver(audio_id, U("urn:x-nmos:format:audio"), web::json::value_of({ { U("media_types"), web::json::value_of({ U("audio/L24") }) } })));
+
+    // receivers that don't constrain the media types of their format are compatible with any of them
+    BST_REQUIRE_EQUAL(2, nmos::details::find_compatible_receivers(resources, U("urn:x-nmos:format:video"), U("video/raw")).size());
+    BST_REQUIRE_EQUAL(1, nmos::details::find_compatible_receivers(resources, U("urn:x-nmos:format:video"), U("video/h264")).count(any_video_id));
+    BST_REQUIRE_EQUAL(1, nmos::details::find_compatible_receivers(resources, U("urn:x-nmos:format:audio"), U("audio/L24")).count(audio_id));
+    BST_REQUIRE(nmos::details::find_compatible_receivers(resources, U("urn:x-nmos:format:audio"), U("audio/L16")).empty());
+    BST_REQUIRE_EQUAL(2, nmos::details::find_compatible_receivers(resources, U("urn:x-nmos:format:video"), {}).size());
+
+    const auto find_candidates = [&](const web::json::value& flat_query_params)
+    {
+        const nmos::resource_query query(nmos::is04_versions::v1_2, U("/receivers"), flat_query_params);
+        return nmos::details::find_indexed_resources(resources, query, false);
+    };
+
+    // a receiver compatibility query finds its candidates via the index, and the query itself matches exactly those receivers
+    auto candidates = find_candidates(web::json::value_of({ { U("query.compatible"), U("urn:x-nmos:format:video,video/jxsv") } }));
+    BST_REQUIRE(!!candidates);
+    BST_REQUIRE_EQUAL(2, candidates->size());
+
+    const nmos::resource_query query(nmos::is04_versions::v1_2, U("/receivers"), web::json::value_of({ { U("query.compatible"), U("urn:x-nmos:format:video,video/jxsv") } }));
+    BST_REQUIRE(query(*nmos::find_resource(resources, { video_id, nmos::types::receiver })));
+    BST_REQUIRE(query(*nmos::find_resource(resources, { any_video_id, nmos::types::receiver })));
+    BST_REQUIRE(!query(*nmos::find_resource(resources, { audio_id, nmos::types::receiver })));
+
+    // the index is kept up to date when receivers are modified and erased
+    nmos::modify_resource(resources, video_id, [](nmos::resource& resource) { resource.data[U("caps")] = web::json::value_of({ { U("media_types"), web::json::value_of({ U("video/raw") }) } }); });
+    BST_REQUIRE_EQUAL(1, nmos::details::find_compatible_receivers(resources, U("urn:x-nmos:format:video"), U("video/jxsv")).size());
+    BST_REQUIRE(!query(*nmos::find_resource(resources, { video_id, nmos::types::receiver })));
+
+    nmos::erase_resource(resources, any_video_id, false);
+    BST_REQUIRE(nmos::details::find_compatible_receivers(resources, U("urn:x-nmos:format:video"), U("video/h264")).empty());
+
+    nmos::erase_resource(resources, node_id);
+    BST_REQUIRE(resources.compatible_receivers.ids.empty());
+    BST_REQUIRE(resources.compatible_receivers.keys.empty());
+}
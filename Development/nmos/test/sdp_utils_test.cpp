@@ -0,0 +1,155 @@
+// The first "test" is of course whether the header compiles standalone
+#include "nmos/sdp_utils.h"
+
+#include <chrono>
+#include "bst/test/test.h"
+#include "sdp/sdp.h"
+
+namespace
+{
+    const std::string video_sdp = R"(v=0
+o=- 3745911798 3745911798 IN IP4 192.168.9.142
+s=Example Sender 1 (Video)
+t=0 0
+a=group:DUP PRIMARY SECONDARY
+m=video 50020 RTP/AVP 96
+c=IN IP4 239.22.142.1/32
+a=ts-refclk:ptp=IEEE1588-2008:traceable
+a=source-filter: incl IN IP4 239.22.142.1 192.168.9.142
+a=rtpmap:96 raw/90000
+a=fmtp:96 colorimetry=BT709; exactframerate=30000/1001; depth=10; TCS=SDR; sampling=YCbCr-4:2:2; width=1920; interlace; TP=2110TPN; PM=2110GPM; height=1080; SSN=ST2110-20:2017;
+a=mediaclk:direct=0
+a=mid:PRIMARY
+m=video 50120 RTP/AVP 96
+c=IN IP4 239.122.142.1/32
+a=ts-refclk:ptp=IEEE1588-2008:traceable
+a=source-filter: incl IN IP4 239.122.142.1 192.168.109.142
+a=rtpmap:96 raw/90000
+a=fmtp:96 colorimetry=BT709; exactframerate=30000/1001; depth=10; TCS=SDR; sampling=YCbCr-4:2:2; width=1920; interlace; TP=2110TPN; PM=2110GPM; height=1080; SSN=ST2110-20:2017;
+a=mediaclk:direct=0
+a=mid:SECONDARY
+)";
+
+    const std::string audio_sdp = "v=0\r\n"
+        "o=- 3745911799 3745911799 IN IP4 192.168.9.142\r\n"
+        "s=Example Sender 2 (Audio)\r\n"
+        "t=0 0\r\n"
+        "m=audio 50030 RTP/AVP 97\r\n"
+        "c=IN IP4 239.22.142.2/64\r\n"
+        "a=ts-refclk:localmac=CA-FE-01-CA-FE-02\r\n"
+        "a=rtpmap:97 L24/48000/8\r\n"
+        "a=fmtp:97 channel-order=SMPTE2110.(SGRP,SGRP)\r\n"
+        "a=ptime:0.125\r\n"
+        "a=mediaclk:direct=0\r\n";
+
+    std::pair<nmos::sdp_parameters, web::json::value> parse_generic(const std::string& session_description)
+    {
+        return nmos::parse_session_description(sdp::parse_session_description(session_description));
+    }
+
+    void check_equal(const nmos::sdp_parameters& expected, const nmos::sdp_parameters& actual)
+    {
+        BST_REQUIRE_EQUAL(expected.origin.user_name, actual.origin.user_name);
+        BST_REQUIRE_EQUAL(expected.origin.session_id, actual.origin.session_id);
+        BST_REQUIRE_EQUAL(expected.origin.session_version, actual.origin.session_version);
+        BST_REQUIRE_EQUAL(expected.session_name, actual.session_name);
+        BST_REQUIRE_EQUAL(expected.connection_data.ttl, actual.connection_data.ttl);
+        BST_REQUIRE_EQUAL(expected.timing.start_time, actual.timing.start_time);
+        BST_REQUIRE_EQUAL(expected.timing.stop_time, actual.timing.stop_time);
+        BST_REQUIRE_EQUAL(expected.group.semantics, actual.group.semantics);
+        BST_REQUIRE(expected.group.media_stream_ids == actual.group.media_stream_ids);
+        BST_REQUIRE_EQUAL(expected.media_type, actual.media_type);
+        BST_REQUIRE_EQUAL(expected.protocol, actual.protocol);
+        BST_REQUIRE_EQUAL(expected.rtpmap.payload_type, actual.rtpmap.payload_type);
+        BST_REQUIRE_EQUAL(expected.rtpmap.encoding_name, actual.rtpmap.encoding_name);
+        BST_REQUIRE_EQUAL(expected.rtpmap.clock_rate, actual.rtpmap.clock_rate);
+        BST_REQUIRE_EQUAL(expected.video.width, actual.video.width);
+        BST_REQUIRE_EQUAL(expected.video.height, actual.video.height);
+        BST_REQUIRE_EQUAL(expected.video.exactframerate, actual.video.exactframerate);
+        BST_REQUIRE_EQUAL(expected.video.interlace, actual.video.interlace);
+        BST_REQUIRE_EQUAL(expected.video.sampling, actual.video.sampling);
+        BST_REQUIRE_EQUAL(expected.video.depth, actual.video.depth);
+        BST_REQUIRE_EQUAL(expected.video.tcs, actual.video.tcs);
+        BST_REQUIRE_EQUAL(expected.video.colorimetry, actual.video.colorimetry);
+        BST_REQUIRE_EQUAL(expected.video.tp, actual.video.tp);
+        BST_REQUIRE_EQUAL(expected.audio.channel_count, actual.audio.channel_count);
+        BST_REQUIRE_EQUAL(expected.audio.bit_depth, actual.audio.bit_depth);
+        BST_REQUIRE_EQUAL(expected.audio.sample_rate, actual.audio.sample_rate);
+        BST_REQUIRE_EQUAL(expected.audio.channel_order, actual.audio.channel_order);
+        BST_REQUIRE_EQUAL(expected.audio.packet_time, actual.audio.packet_time);
+        BST_REQUIRE_EQUAL(expected.ts_refclk.clock_source, actual.ts_refclk.clock_source);
+        BST_REQUIRE_EQUAL(expected.ts_refclk.ptp_version, actual.ts_refclk.ptp_version);
+        BST_REQUIRE_EQUAL(expected.ts_refclk.ptp_server, actual.ts_refclk.ptp_server);
+        BST_REQUIRE_EQUAL(expected.ts_refclk.mac_address, actual.ts_refclk.mac_address);
+        BST_REQUIRE_EQUAL(expected.mediaclk.clock_source, actual.mediaclk.clock_source);
+        BST_REQUIRE_EQUAL(expected.mediaclk.clock_parameters, actual.mediaclk.clock_parameters);
+    }
+
+    void check_same_as_generic(const std::string& session_description)
+    {
+        const auto expected = parse_generic(session_description);
+        const auto actual = nmos::parse_session_description(session_description);
+        check_equal(expected.first, actual.first);
+        BST_REQUIRE_EQUAL(expected.second, actual.second);
+    }
+}
+
+////////////////////////////////////////////////////////////////////////////////////////////
+BST_TEST_CASE(testParseSessionDescriptionVideo)
+{
+    check_same_as_generic(video_sdp);
+
+    const auto sdp_transport_params = nmos::parse_session_description(video_sdp);
+    BST_REQUIRE_EQUAL(1920, sdp_transport_params.first.video.width);
+    BST_REQUIRE_EQUAL(nmos::rational(30000, 1001), sdp_transport_params.first.video.exactframerate);
+    BST_REQUIRE(sdp_transport_params.first.video.interlace);
+    BST_REQUIRE_EQUAL(2, sdp_transport_params.second.size());
+    BST_REQUIRE_EQUAL(U("192.168.109.142"), sdp_transport_params.second.at(1).at(U("source_ip")).as_string());
+    BST_REQUIRE_EQUAL(50120, sdp_transport_params.second.at(1).at(U("destination_port")).as_integer());
+}
+
+////////////////////////////////////////////////////////////////////////////////////////////
+BST_TEST_CASE(testParseSessionDescriptionAudio)
+{
+    check_same_as_generic(audio_sdp);
+
+    const auto sdp_transport_params = nmos::parse_session_description(audio_sdp);
+    BST_REQUIRE_EQUAL(8, sdp_transport_params.first.audio.channel_count);
+    BST_REQUIRE_EQUAL(24, sdp_transport_params.first.audio.bit_depth);
+    BST_REQUIRE_EQUAL(0.125, sdp_transport_params.first.audio.packet_time);
+    BST_REQUIRE_EQUAL(1, sdp_transport_params.second.size());
+}
+
+////////////////////////////////////////////////////////////////////////////////////////////
+BST_TEST_CASE(testParseSessionDescriptionFallback)
+{
+    // unusual lines and attributes are handled by the generic grammar
+    check_same_as_generic(audio_sdp + "a=framerate:25\r\n");
+    check_same_as_generic(audio_sdp + "a=x-foo\r\n");
+
+    std::string repeat_times = audio_sdp;
+    repeat_times.insert(repeat_times.find("t=0 0\r\n") + 7, "r=7d 1h 0 25h\r\n");
+    check_same_as_generic(repeat_times);
+
+    // and so are errors
+    BST_REQUIRE_THROW(nmos::parse_session_description(audio_sdp + "\r\n"), std::runtime_error);
+    BST_REQUIRE_THROW(nmos::parse_session_description(audio_sdp.substr(0, audio_sdp.find("a=ptime"))), std::runtime_error);
+    BST_REQUIRE_THROW(nmos::parse_session_description(std::string{ "v=1\r\n" } + audio_sdp.substr(5)), std::runtime_error);
+}
+
+////////////////////////////////////////////////////////////////////////////////////////////
+BST_TEST_CASE(testParseSessionDescriptionBenchmark)
+{
+    const int iterations = 1000;
+
+    const auto start = std::chrono::steady_clock::now();
+    for (int i = 0; i < iterations; ++i) parse_generic(video_sdp);
+    const auto generic = std::chrono::steady_clock::now() - start;
+
+    const auto middle = std::chrono::steady_clock::now();
+    for (int i = 0; i < iterations; ++i) nmos::parse_session_description(video_sdp);
+    const auto fast = std::chrono::steady_clock::now() - middle;
+
+    // only a warning, since timing is at the mercy of the test machine
+    BST_WARN_LT(fast.count(), generic.count());
+}
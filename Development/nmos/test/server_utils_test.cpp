@@ -0,0 +1,46 @@
+// The first "test" is of course whether the header compiles standalone
+#include "nmos/server_utils.h"
+
+#include <atomic>
+#include "bst/test/test.h"
+
+namespace
+{
+    struct test_work
+    {
+        nmos::experimental::work_stealing_scheduler* scheduler;
+        std::atomic<int> count;
+        int nested;
+    };
+
+    void run_test_work(void* param)
+    {
+        auto work = static_cast<test_work*>(param);
+        // work scheduled by the scheduler's own threads is queued by that thread
+        if (0 < work->nested--) work->scheduler->schedule(&run_test_work, param);
+        ++work->count;
+    }
+}
+
+////////////////////////////////////////////////////////////////////////////////////////////
+BST_TEST_CASE(testWorkStealingScheduler)
+{
+    const int external = 1000;
+    std::vector<test_work> works(external);
+    {
+        nmos::experimental::work_stealing_scheduler scheduler(4);
+        for (auto& work : works)
+        {
+            work.scheduler = &scheduler;
+            work.count = 0;
+            work.nested = 10;
+            scheduler.schedule(&run_test_work, &work);
+        }
+        // the destructor finishes the work that has already been scheduled, including that scheduled by the work itself
+    }
+
+    for (const auto& work : works)
+    {
+        BST_REQUIRE_EQUAL(11, work.count.load());
+    }
+}
@@ -0,0 +1,66 @@
+// The first "test" is of course whether the header compiles standalone
+#include "nmos/slog.h"
+
+#include "bst/test/test.h"
+
+namespace
+{
+    struct test_gate : public slog::base_gate
+    {
+        test_gate() : suppressed(0), summaries(0) {}
+        virtual bool pertinent(slog::severity level) const { return true; }
+        virtual void log(const slog::log_message& message) const
+        {
+            const std::string prefix("Suppressed ");
+            const auto str = message.str();
+            if (0 == str.compare(0, prefix.size(), prefix))
+            {
+                suppressed += std::stoi(str.substr(prefix.size()));
+                ++summaries;
+            }
+        }
+        mutable int suppressed;
+        mutable int summaries;
+    };
+}
+
+////////////////////////////////////////////////////////////////////////////////////////////
+BST_TEST_CASE(testRateLimitedGate)
+{
+    test_gate gate;
+    int logged = 0;
+    {
+        nmos::experimental::rate_limited_gate limited(gate, 3);
+
+        for (int i = 0; i < 10; ++i)
+        {
+            if (limited.pertinent(slog::severities::more_info)) ++logged;
+        }
+
+        // more severe messages are not limited
+        for (int i = 0; i < 10; ++i)
+        {
+            BST_REQUIRE(limited.pertinent(slog::severities::warning));
+        }
+    }
+
+    // unless the test happened to straddle a second, only the first few messages are logged,
+    // and every suppressed message is counted by a summary, the last when the gate is destroyed
+    BST_REQUIRE(3 <= logged && logged <= 6);
+    BST_REQUIRE_EQUAL(10, logged + gate.suppressed);
+    BST_REQUIRE(1 <= gate.summaries);
+}
+
+////////////////////////////////////////////////////////////////////////////////////////////
+BST_TEST_CASE(testRateLimitedGateUnlimited)
+{
+    test_gate gate;
+    {
+        nmos::experimental::rate_limited_gate unlimited(gate, 0);
+        for (int i = 0; i < 10; ++i)
+        {
+            BST_REQUIRE(unlimited.pertinent(slog::severities::more_info));
+        }
+    }
+    BST_REQUIRE_EQUAL(0, gate.summaries);
+}
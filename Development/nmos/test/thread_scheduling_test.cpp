@@ -0,0 +1,44 @@
+// The first "test" is of course whether the header compiles standalone
+#include "nmos/thread_scheduling.h"
+
+#include "bst/test/test.h"
+#include "nmos/slog.h"
+
+namespace
+{
+    struct test_gate : public slog::base_gate
+    {
+        virtual bool pertinent(slog::severity level) const { return false; }
+        virtual void log(const slog::log_message& message) const {}
+    };
+}
+
+////////////////////////////////////////////////////////////////////////////////////////////
+BST_TEST_CASE(testThreadSchedulingInvalid)
+{
+    // nothing to do is not an error
+    nmos::experimental::set_current_thread_scheduling(web::json::value::object());
+
+    BST_REQUIRE_THROW(nmos::experimental::set_current_thread_scheduling(web::json::value::array()), std::invalid_argument);
+    BST_REQUIRE_THROW(nmos::experimental::set_current_thread_scheduling(web::json::value_of({ { U("affinity"), web::json::value::array() } })), std::invalid_argument);
+    BST_REQUIRE_THROW(nmos::experimental::set_current_thread_scheduling(web::json::value_of({ { U("affinity"), web::json::value_of({ -1 }) } })), std::invalid_argument);
+    BST_REQUIRE_THROW(nmos::experimental::set_current_thread_scheduling(web::json::value_of({ { U("realtime_priority"), U("high") } })), std::invalid_argument);
+    BST_REQUIRE_THROW(nmos::experimental::set_current_thread_scheduling(web::json::value_of({ { U("realtime_priority"), 50 }, { U("nice"), -10 } })), std::invalid_argument);
+}
+
+////////////////////////////////////////////////////////////////////////////////////////////
+BST_TEST_CASE(testThreadSchedulingCallback)
+{
+    test_gate gate;
+
+    const auto settings = web::json::value_of({
+        { nmos::experimental::fields::thread_scheduling, web::json::value_of({
+            { U("node_behaviour"), web::json::value_of({ { U("nice"), 0 } }) }
+        }) }
+    });
+
+    // only the configured threads have a callback, so that the listeners needn't wrap the others
+    BST_REQUIRE(!nmos::experimental::make_thread_scheduling_callback(settings, U("erase_expired_resources"), gate));
+    BST_REQUIRE(!nmos::experimental::make_thread_scheduling_callback(web::json::value::object(), U("node_behaviour"), gate));
+    BST_REQUIRE(!!nmos::experimental::make_thread_scheduling_callback(settings, U("node_behaviour"), gate));
+}
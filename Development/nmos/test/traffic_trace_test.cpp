@@ -0,0 +1,64 @@
+// The first "test" is of course whether the header compiles standalone
+#include "nmos/traffic_trace.h"
+
+#include <sstream>
+#include "bst/test/test.h"
+
+////////////////////////////////////////////////////////////////////////////////////////////
+BST_TEST_CASE(testTrafficTraceRoundTrip)
+{
+    nmos::experimental::traffic_record heartbeat{ 1600000000000000, U("192.0.2.1"), web::http::methods::POST, U("/x-nmos/registration/v1.3/health/nodes/1a9c2d4e-0000-4000-8000-000000000000"), {}, {} };
+
+    const std::string json{ "{\"type\":\"node\",\"data\":{}}" };
+    nmos::experimental::traffic_record registration{ 1600000000123456, U("192.0.2.2"), web::http::methods::POST, U("/x-nmos/registration/v1.3/resource"),
+        { { U("Content-Type"), U("application/json") }, { U("Host"), U("registry.example.com") } }, { json.begin(), json.end() } };
+
+    std::stringstream trace;
+    nmos::experimental::write_traffic_trace_header(trace);
+    nmos::experimental::write_traffic_record(trace, heartbeat);
+    nmos::experimental::write_traffic_record(trace, registration);
+
+    nmos::experimental::read_traffic_trace_header(trace);
+
+    nmos::experimental::traffic_record record;
+    BST_REQUIRE(nmos::experimental::read_traffic_record(trace, record));
+    BST_REQUIRE_EQUAL(heartbeat.received, record.received);
+    BST_REQUIRE_EQUAL(heartbeat.client, record.client);
+    BST_REQUIRE_EQUAL(heartbeat.method, record.method);
+    BST_REQUIRE_EQUAL(heartbeat.path, record.path);
+    BST_REQUIRE(record.headers.empty());
+    BST_REQUIRE(record.body.empty());
+
+    BST_REQUIRE(nmos::experimental::read_traffic_record(trace, record));
+    BST_REQUIRE_EQUAL(registration.received, record.received);
+    BST_REQUIRE_EQUAL(registration.path, record.path);
+    BST_REQUIRE(registration.headers == record.headers);
+    BST_REQUIRE(registration.body == record.body);
+
+    BST_REQUIRE(!nmos::experimental::read_traffic_record(trace, record));
+}
+
+////////////////////////////////////////////////////////////////////////////////////////////
+BST_TEST_CASE(testTrafficTraceTruncated)
+{
+    // a trace which was cut off in the middle of a record, e.g. because the registry was killed, is read up to the last complete record
+    nmos::experimental::traffic_record query{ 1600000000000000, U("192.0.2.1"), web::http::methods::GET, U("/x-nmos/query/v1.3/senders?paging.limit=100"), {}, {} };
+
+    std::stringstream complete;
+    nmos::experimental::write_traffic_trace_header(complete);
+    nmos::experimental::write_traffic_record(complete, query);
+    nmos::experimental::write_traffic_record(complete, query);
+    const auto bytes = complete.str();
+
+    std::stringstream truncated(bytes.substr(0, bytes.size() - 10));
+    nmos::experimental::read_traffic_trace_header(truncated);
+
+    nmos::experimental::traffic_record record;
+    BST_REQUIRE(nmos::experimental::read_traffic_record(truncated, record));
+    BST_REQUIRE_EQUAL(query.path, record.path);
+    BST_REQUIRE(!nmos::experimental::read_traffic_record(truncated, record));
+
+    // and something else entirely is rejected
+    std::stringstream other("{\"nmos_cpp_registry_snapshot\":1}\n");
+    BST_REQUIRE_THROW(nmos::experimental::read_traffic_trace_header(other), std::runtime_error);
+}
@@ -0,0 +1,46 @@
+// The first "test" is of course whether the header compiles standalone
+#include "nmos/version.h"
+
+#include "bst/test/test.h"
+#include "cpprest/basic_utils.h"
+
+////////////////////////////////////////////////////////////////////////////////////////////
+BST_TEST_CASE(testMakeVersion)
+{
+    BST_REQUIRE_STRING_EQUAL("0:0", utility::us2s(nmos::make_version(nmos::tai{})));
+    BST_REQUIRE_STRING_EQUAL("1439299836:10", utility::us2s(nmos::make_version(nmos::tai{ 1439299836, 10 })));
+    BST_REQUIRE_STRING_EQUAL("-9223372036854775808:999999999", utility::us2s(nmos::make_version(nmos::tai{ (std::numeric_limits<std::int64_t>::min)(), 999999999 })));
+}
+
+////////////////////////////////////////////////////////////////////////////////////////////
+BST_TEST_CASE(testParseVersion)
+{
+    const nmos::tai versions[] = { {}, { 1439299836, 10 }, { 9223372036854775807, 999999999 }, { (std::numeric_limits<std::int64_t>::min)(), 0 } };
+    for (const auto& version : versions)
+    {
+        BST_REQUIRE(version == nmos::parse_version(nmos::make_version(version)));
+    }
+
+    // like extraction from a string stream
+    BST_REQUIRE(nmos::tai(1, 2) == nmos::parse_version(U(" 1 : 2")));
+    BST_REQUIRE(nmos::tai(1, 2) == nmos::parse_version(U("+1:2foo")));
+
+    for (const auto& invalid : { U(""), U("1"), U("1:"), U("1-2"), U(":2"), U("a:b"), U("9223372036854775808:0") })
+    {
+        BST_REQUIRE(nmos::tai{} == nmos::parse_version(invalid));
+    }
+}
+
+////////////////////////////////////////////////////////////////////////////////////////////
+BST_TEST_CASE(testTaiCoarseClock)
+{
+    // the coarse clock has the same epoch, and is never ahead of the precise clock
+    const auto before = nmos::tai_clock::now();
+    const auto coarse = nmos::tai_clock::coarse_now();
+    const auto after = nmos::tai_clock::now();
+    BST_REQUIRE(coarse <= after);
+    BST_REQUIRE(before - coarse < std::chrono::seconds(1));
+
+    // nor does it go backwards
+    BST_REQUIRE(coarse <= nmos::tai_clock::coarse_now());
+}
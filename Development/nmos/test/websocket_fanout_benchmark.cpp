@@ -0,0 +1,366 @@
+// The first "test" is of course whether the header compiles standalone
+#include "nmos/query_ws_api.h"
+
+#include <algorithm>
+#include <condition_variable>
+#include <iomanip>
+#include <iostream>
+#include <thread>
+#if defined(__linux__)
+#include <fstream>
+#include <unistd.h>
+#endif
+#include "bst/test/test.h"
+#include "cpprest/ws_client.h"
+#include "nmos/client_utils.h"
+#include "nmos/connection_resources.h"
+#include "nmos/events_resources.h"
+#include "nmos/events_ws_api.h"
+#include "nmos/is04_versions.h"
+#include "nmos/model.h"
+#include "nmos/node_resource.h"
+#include "nmos/node_resources.h"
+#include "nmos/query_utils.h"
+#include "nmos/server_utils.h"
+#include "nmos/transport.h"
+#include "slog/all_in_one.h"
+
+// These benchmarks measure the fan-out of resource changes to many websocket clients, end to end through an in-process websocket listener
+// and the real send threads, i.e. nmos::send_query_ws_events_thread and nmos::send_events_ws_messages_thread, reporting the distribution of
+// the delivery latency, the delivery throughput, and the memory used per connection (on Linux)
+// Each change is stamped with its steady_clock time, in the label of a resource or the payload of an IS-07 string state, so the clients can measure the latency
+namespace
+{
+    struct test_gate : public slog::base_gate
+    {
+        virtual bool pertinent(slog::severity level) const { return false; }
+        virtual void log(const slog::log_message& message) const {}
+    };
+
+    const unsigned short query_ws_port = 23213;
+    const unsigned short events_ws_port = 23217;
+
+    // the resident set size of the process, or zero if it isn't available on this platform
+    std::size_t resident_bytes()
+    {
+#if defined(__linux__)
+        std::ifstream statm("/proc/self/statm");
+        std::size_t size = 0, resident = 0;
+        statm >> size >> resident;
+        return resident * (std::size_t)sysconf(_SC_PAGESIZE);
+#else
+        return 0;
+#endif
+    }
+
+    utility::string_t make_stamp()
+    {
+        return U("t=") + utility::ostringstreamed(std::chrono::duration_cast<std::chrono::microseconds>(std::chrono::steady_clock::now().time_since_epoch()).count());
+    }
+
+    // the statistics collected by all the clients, from their message handlers
+    struct fanout_stats
+    {
+        std::mutex mutex;
+        std::condition_variable condition;
+
+        // the number of clients which have received their first message, e.g. the initial 'sync' resource events
+        std::size_t ready = 0;
+
+        std::vector<long long> latencies;
+
+        void record(const utility::string_t& stamp)
+        {
+            if (0 != stamp.compare(0, 2, U("t="))) return;
+            const auto now = std::chrono::duration_cast<std::chrono::microseconds>(std::chrono::steady_clock::now().time_since_epoch()).count();
+            const auto latency = now - std::stoll(utility::us2s(stamp.substr(2)));
+            std::lock_guard<std::mutex> lock(mutex);
+            latencies.push_back(latency);
+        }
+
+        void first_message()
+        {
+            std::lock_guard<std::mutex> lock(mutex);
+            ++ready;
+            condition.notify_all();
+        }
+
+        bool wait_ready(std::size_t count)
+        {
+            std::unique_lock<std::mutex> lock(mutex);
+            return condition.wait_for(lock, std::chrono::seconds(30), [&] { return count <= ready; });
+        }
+    };
+
+    // a client which calls the specified function with the parsed message
+    std::unique_ptr<web::websockets::client::websocket_callback_client> make_client(const nmos::settings& settings, fanout_stats& stats, std::function<void(const web::json::value&)> handle_message)
+    {
+        std::unique_ptr<web::websockets::client::websocket_callback_client> client(new web::websockets::client::websocket_callback_client(nmos::make_websocket_client_config(settings)));
+        auto first = std::make_shared<bool>(true);
+        client->set_message_handler([&stats, handle_message, first](const web::websockets::client::websocket_incoming_message& msg)
+        {
+            const auto message = web::json::value::parse(utility::s2us(msg.extract_string().get()));
+            handle_message(message);
+            if (*first)
+            {
+                *first = false;
+                stats.first_message();
+            }
+        });
+        return client;
+    }
+
+    // drive the specified number of changes per second, for the specified duration
+    void drive_changes(std::size_t changes_per_second, std::chrono::seconds duration, std::function<void(std::size_t)> change)
+    {
+        const auto interval = std::chrono::microseconds(1000000 / (std::max)(changes_per_second, std::size_t(1)));
+        const auto start = std::chrono::steady_clock::now();
+        auto next = start;
+        for (std::size_t index = 0; next < start + duration; ++index)
+        {
+            std::this_thread::sleep_until(next);
+            change(index);
+            next += interval;
+        }
+    }
+
+    void report(const std::string& name, fanout_stats& stats, std::size_t connections, std::size_t before_bytes, std::size_t after_bytes, std::chrono::seconds duration)
+    {
+        std::lock_guard<std::mutex> lock(stats.mutex);
+        auto& latencies = stats.latencies;
+        std::sort(latencies.begin(), latencies.end());
+        const auto percentile = [&latencies](double p) { return latencies.empty() ? 0LL : latencies[(std::size_t)(p * (latencies.size() - 1))]; };
+
+        std::cout << std::left << std::setw(64) << name << std::right
+            << std::setw(12) << latencies.size() << " deliveries"
+            << std::setw(12) << std::fixed << std::setprecision(1) << latencies.size() / double(duration.count()) << " deliveries/s"
+            << std::endl;
+        std::cout << std::left << std::setw(64) << "" << std::right
+            << " latency (us) p50 " << percentile(0.5) << " p90 " << percentile(0.9) << " p99 " << percentile(0.99) << " max " << percentile(1.0)
+            << std::endl;
+        if (0 != before_bytes && before_bytes < after_bytes)
+        {
+            std::cout << std::left << std::setw(64) << "" << std::right
+                << " memory " << (after_bytes - before_bytes) / connections << " bytes/connection"
+                << std::endl;
+        }
+    }
+
+    void benchmark_query_ws_fanout(std::size_t connections, std::size_t subscription_types, std::size_t changes_per_second, std::chrono::seconds duration = std::chrono::seconds(5))
+    {
+        using web::json::value;
+        using web::json::value_of;
+
+        test_gate gate;
+
+        nmos::registry_model model;
+        model.settings = value::object();
+        nmos::insert_registry_default_settings(model.settings);
+        model.settings[nmos::fields::host_address] = value::string(U("127.0.0.1"));
+        model.settings[nmos::fields::query_ws_port] = query_ws_port;
+
+        // one resource of each type, so that each change matches the subscriptions of one type
+        const auto node_id = nmos::make_id(), device_id = nmos::make_id(), source_id = nmos::make_id(), flow_id = nmos::make_id(), sender_id = nmos::make_id(), receiver_id = nmos::make_id();
+        const std::vector<std::pair<utility::string_t, nmos::id>> types
+        {
+            { U("/senders"), sender_id },
+            { U("/receivers"), receiver_id },
+            { U("/flows"), flow_id },
+            { U("/sources"), source_id },
+            { U("/devices"), device_id },
+            { U("/nodes"), node_id }
+        };
+        subscription_types = (std::min)((std::max)(subscription_types, std::size_t(1)), types.size());
+
+        std::vector<nmos::id> subscription_ids;
+        {
+            auto lock = model.write_lock();
+            auto& resources = model.registry_resources;
+            nmos::insert_resource(resources, nmos::make_node(node_id, model.settings));
+            nmos::insert_resource(resources, nmos::make_device(device_id, node_id, { sender_id }, { receiver_id }, model.settings));
+            nmos::insert_resource(resources, nmos::make_video_source(source_id, device_id, nmos::rational(25, 1), model.settings));
+            nmos::insert_resource(resources, nmos::make_raw_video_flow(flow_id, source_id, device_id, model.settings));
+            nmos::insert_resource(resources, nmos::make_sender(sender_id, flow_id, device_id, {}, model.settings));
+            nmos::insert_resource(resources, nmos::make_video_receiver(receiver_id, device_id, nmos::transports::rtp_mcast, {}, model.settings));
+
+            for (std::size_t type = 0; type < subscription_types; ++type)
+            {
+                const auto id = nmos::make_id();
+                auto data = value_of({
+                    { nmos::fields::id, id },
+                    { nmos::fields::max_update_rate_ms, 0 },
+                    { nmos::fields::persist, true },
+                    { nmos::fields::secure, false },
+                    { nmos::fields::resource_path, types[type].first },
+                    { nmos::fields::params, value::object() },
+                    { nmos::fields::ws_href, U("ws://127.0.0.1:") + utility::ostringstreamed(query_ws_port) + U("/x-nmos/query/v1.3/subscriptions/") + id }
+                });
+                nmos::insert_resource(resources, { nmos::is04_versions::v1_3, nmos::types::subscription, std::move(data), true });
+                subscription_ids.push_back(id);
+            }
+        }
+
+        nmos::websockets websockets;
+        const auto query_id = nmos::make_id();
+        auto websocket_config = nmos::make_websocket_listener_config(model.settings);
+        web::websockets::experimental::listener::validate_handler validate_handler = nmos::make_query_ws_validate_handler(model, gate);
+        web::websockets::experimental::listener::open_handler open_handler = nmos::make_query_ws_open_handler(query_id, model, websockets, gate);
+        web::websockets::experimental::listener::close_handler close_handler = nmos::make_query_ws_close_handler(model, websockets, gate);
+        web::websockets::experimental::listener::websocket_listener listener(web::websockets::experimental::listener::make_listener_uri(false, web::websockets::experimental::listener::host_wildcard, query_ws_port), websocket_config);
+        listener.set_validate_handler(std::ref(validate_handler));
+        listener.set_open_handler(std::ref(open_handler));
+        listener.set_close_handler(std::ref(close_handler));
+        listener.open().wait();
+
+        std::thread send_thread([&] { nmos::send_query_ws_events_thread(listener, model, websockets, gate); });
+
+        fanout_stats stats;
+        const auto before_bytes = resident_bytes();
+
+        // open the connections, spread across the subscriptions
+        std::vector<std::unique_ptr<web::websockets::client::websocket_callback_client>> clients;
+        for (std::size_t connection = 0; connection < connections; ++connection)
+        {
+            clients.push_back(make_client(model.settings, stats, [&stats](const value& message)
+            {
+                for (const auto& event : nmos::fields::grain_data(message).as_array())
+                {
+                    if (event.has_field(U("post"))) stats.record(nmos::fields::label(event.at(U("post"))));
+                }
+            }));
+            const auto& subscription_id = subscription_ids[connection % subscription_ids.size()];
+            clients.back()->connect(U("ws://127.0.0.1:") + utility::ostringstreamed(query_ws_port) + U("/x-nmos/query/v1.3/subscriptions/") + subscription_id).wait();
+        }
+        BST_REQUIRE(stats.wait_ready(connections));
+
+        const auto after_bytes = resident_bytes();
+
+        drive_changes(changes_per_second, duration, [&](std::size_t index)
+        {
+            auto lock = model.write_lock();
+            const auto stamp = make_stamp();
+            nmos::modify_resource(model.registry_resources, types[index % subscription_types].second, [&stamp](nmos::resource& resource)
+            {
+                resource.data[nmos::fields::label] = value::string(stamp);
+            });
+            model.notify();
+        });
+
+        // allow the changes still in flight to be delivered
+        std::this_thread::sleep_for(std::chrono::milliseconds(500));
+
+        report("query websockets " + std::to_string(connections) + " connections, " + std::to_string(subscription_types) + " subscription types, " + std::to_string(changes_per_second) + " changes/s", stats, connections, before_bytes, after_bytes, duration);
+
+        for (auto& client : clients) client->close().wait();
+        model.controlled_shutdown();
+        send_thread.join();
+        listener.close().wait();
+    }
+
+    void benchmark_events_ws_fanout(std::size_t connections, std::size_t sources, std::size_t changes_per_second, std::chrono::seconds duration = std::chrono::seconds(5))
+    {
+        using web::json::value;
+        using web::json::value_of;
+
+        test_gate gate;
+
+        nmos::node_model model;
+        model.settings = value::object();
+        nmos::insert_node_default_settings(model.settings);
+        model.settings[nmos::fields::host_address] = value::string(U("127.0.0.1"));
+        model.settings[nmos::fields::events_ws_port] = events_ws_port;
+
+        // one IS-05 sender, i.e. one websocket endpoint, for the device, and the specified number of IS-07 sources
+        const auto device_id = nmos::make_id();
+        sources = (std::max)(sources, std::size_t(1));
+        std::vector<nmos::id> source_ids;
+        {
+            auto lock = model.write_lock();
+            for (std::size_t source = 0; source < sources; ++source)
+            {
+                const auto source_id = nmos::make_id();
+                nmos::insert_resource(model.events_resources, nmos::make_events_source(source_id, nmos::make_events_string_state(source_id, {}), nmos::make_events_string_type()));
+                source_ids.push_back(source_id);
+            }
+
+            auto sender = nmos::make_connection_events_websocket_sender(nmos::make_id(), device_id, source_ids.front(), model.settings);
+            sender.data[nmos::fields::endpoint_active][nmos::fields::master_enable] = value::boolean(true);
+            nmos::insert_resource(model.connection_resources, std::move(sender));
+        }
+
+        nmos::websockets websockets;
+        nmos::experimental::events_ws_publisher publisher;
+        auto websocket_config = nmos::make_websocket_listener_config(model.settings);
+        web::websockets::experimental::listener::validate_handler validate_handler = nmos::make_events_ws_validate_handler(model, gate);
+        web::websockets::experimental::listener::open_handler open_handler = nmos::make_events_ws_open_handler(model, websockets, gate);
+        web::websockets::experimental::listener::close_handler close_handler = nmos::make_events_ws_close_handler(model, websockets, publisher, gate);
+        web::websockets::experimental::listener::message_handler message_handler = nmos::make_events_ws_message_handler(model, websockets, publisher, gate);
+        web::websockets::experimental::listener::websocket_listener listener(web::websockets::experimental::listener::make_listener_uri(false, web::websockets::experimental::listener::host_wildcard, events_ws_port), websocket_config);
+        listener.set_validate_handler(std::ref(validate_handler));
+        listener.set_open_handler(std::ref(open_handler));
+        listener.set_close_handler(std::ref(close_handler));
+        listener.set_message_handler(std::ref(message_handler));
+        listener.open().wait();
+
+        std::thread send_thread([&] { nmos::send_events_ws_messages_thread(listener, model, websockets, publisher, gate); });
+
+        fanout_stats stats;
+        const auto before_bytes = resident_bytes();
+
+        // open the connections, and subscribe each to one of the sources
+        const auto connection_uri = nmos::make_events_ws_api_connection_uri(device_id, model.settings);
+        std::vector<std::unique_ptr<web::websockets::client::websocket_callback_client>> clients;
+        for (std::size_t connection = 0; connection < connections; ++connection)
+        {
+            clients.push_back(make_client(model.settings, stats, [&stats](const value& message)
+            {
+                if (U("state") == web::json::field_as_string_or{ U("message_type"), {} }(message)) stats.record(message.at(U("payload")).at(U("value")).as_string());
+            }));
+            clients.back()->connect(connection_uri).wait();
+
+            web::websockets::client::websocket_outgoing_message subscription;
+            subscription.set_utf8_message(utility::us2s(value_of({
+                { nmos::fields::command, U("subscription") },
+                { nmos::fields::sources, value_of({ source_ids[connection % source_ids.size()] }) }
+            }).serialize()));
+            clients.back()->send(subscription).wait();
+        }
+        // the current state of the source is sent in response to the subscription command
+        BST_REQUIRE(stats.wait_ready(connections));
+
+        const auto after_bytes = resident_bytes();
+
+        drive_changes(changes_per_second, duration, [&](std::size_t index)
+        {
+            auto lock = model.write_lock();
+            const auto& source_id = source_ids[index % source_ids.size()];
+            nmos::experimental::publish_events_state(model, websockets, publisher, source_id, nmos::make_events_string_state(source_id, make_stamp()));
+            model.notify();
+        });
+
+        std::this_thread::sleep_for(std::chrono::milliseconds(500));
+
+        report("events websockets " + std::to_string(connections) + " connections, " + std::to_string(sources) + " sources, " + std::to_string(changes_per_second) + " changes/s", stats, connections, before_bytes, after_bytes, duration);
+
+        for (auto& client : clients) client->close().wait();
+        model.controlled_shutdown();
+        send_thread.join();
+        listener.close().wait();
+    }
+}
+
+////////////////////////////////////////////////////////////////////////////////////////////
+BST_TEST_CASE(benchmarkQueryWebSocketFanout)
+{
+    benchmark_query_ws_fanout(10, 1, 100);
+    benchmark_query_ws_fanout(100, 3, 100);
+    benchmark_query_ws_fanout(500, 6, 1000);
+}
+
+////////////////////////////////////////////////////////////////////////////////////////////
+BST_TEST_CASE(benchmarkEventsWebSocketFanout)
+{
+    benchmark_events_ws_fanout(10, 1, 100);
+    benchmark_events_ws_fanout(100, 10, 100);
+    benchmark_events_ws_fanout(500, 50, 1000);
+}
@@ -0,0 +1,119 @@
+#include "nmos/thread_scheduling.h"
+
+#include <stdexcept>
+#include <system_error>
+#if defined(__linux__)
+#include <cerrno>
+#include <pthread.h>
+#include <sched.h>
+#include <sys/resource.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+#endif
+#include "nmos/model.h"
+#include "nmos/slog.h"
+
+namespace nmos
+{
+    namespace experimental
+    {
+        namespace details
+        {
+            const web::json::field_as_value_or affinity{ U("affinity"), {} }; // array of CPU numbers, or null
+            const web::json::field_as_value_or realtime_priority{ U("realtime_priority"), {} }; // integer, or null
+            const web::json::field_as_value_or nice{ U("nice"), {} }; // integer, or null
+
+            static void set_thread_scheduling(const web::json::value& scheduling, const utility::string_t& name, slog::base_gate& gate)
+            {
+                try
+                {
+                    set_current_thread_scheduling(scheduling);
+                    slog::log<slog::severities::info>(gate, SLOG_FLF) << "Set scheduling of " << name << " thread: " << scheduling.serialize();
+                }
+                catch (const std::exception& e)
+                {
+                    slog::log<slog::severities::error>(gate, SLOG_FLF) << "Could not set scheduling of " << name << " thread: " << e.what();
+                }
+            }
+        }
+
+        // set the CPU affinity and either the real-time (SCHED_FIFO) priority or the nice value of the calling thread,
+        // from an object like { "affinity": [ 2, 3 ], "realtime_priority": 50 } or { "nice": -10 }, in which any of the fields may be omitted
+        void set_current_thread_scheduling(const web::json::value& scheduling)
+        {
+            if (!scheduling.is_object()) throw std::invalid_argument("thread scheduling must be an object");
+
+            const auto& affinity = details::affinity(scheduling);
+            const auto& realtime_priority = details::realtime_priority(scheduling);
+            const auto& nice = details::nice(scheduling);
+
+            if (!affinity.is_null() && (!affinity.is_array() || 0 == affinity.size())) throw std::invalid_argument("thread affinity must be a non-empty array of CPU numbers");
+            if (!realtime_priority.is_null() && !realtime_priority.is_integer()) throw std::invalid_argument("thread realtime_priority must be an integer");
+            if (!nice.is_null() && !nice.is_integer()) throw std::invalid_argument("thread nice value must be an integer");
+            // a real-time thread isn't subject to the nice value, so it would be misleading to accept both
+            if (!realtime_priority.is_null() && !nice.is_null()) throw std::invalid_argument("thread scheduling may specify either realtime_priority or nice, not both");
+
+            if (affinity.is_null() && realtime_priority.is_null() && nice.is_null()) return;
+
+#if defined(__linux__)
+            if (!affinity.is_null())
+            {
+                cpu_set_t cpus;
+                CPU_ZERO(&cpus);
+                for (const auto& cpu : affinity.as_array())
+                {
+                    if (!cpu.is_integer() || 0 > cpu.as_integer() || CPU_SETSIZE <= cpu.as_integer()) throw std::invalid_argument("thread affinity must be a non-empty array of CPU numbers");
+                    CPU_SET(cpu.as_integer(), &cpus);
+                }
+                const auto error = pthread_setaffinity_np(pthread_self(), sizeof(cpus), &cpus);
+                if (0 != error) throw std::system_error(error, std::system_category(), "pthread_setaffinity_np");
+            }
+
+            if (!realtime_priority.is_null())
+            {
+                sched_param param{};
+                param.sched_priority = realtime_priority.as_integer();
+                const auto error = pthread_setschedparam(pthread_self(), SCHED_FIFO, &param);
+                if (0 != error) throw std::system_error(error, std::system_category(), "pthread_setschedparam");
+            }
+            else if (!nice.is_null())
+            {
+                // on Linux, the nice value is an attribute of each thread rather than the whole process, so it can be set using the thread id
+                if (0 != setpriority(PRIO_PROCESS, (id_t)syscall(SYS_gettid), nice.as_integer())) throw std::system_error(errno, std::system_category(), "setpriority");
+            }
+#else
+            throw std::system_error(std::make_error_code(std::errc::not_supported), "thread scheduling");
+#endif
+        }
+
+        // set the scheduling of the calling thread to that configured for the named thread, if any, logging any failure
+        // e.g. at the start of each of the background threads started by nmos::details::make_thread_guard
+        void set_thread_scheduling(const nmos::base_model& model, const utility::string_t& name, slog::base_gate& gate)
+        {
+            // the settings may be updated by other threads, so take a copy of the configuration
+            web::json::value scheduling;
+            {
+                auto lock = model.read_lock();
+                const auto& thread_scheduling = nmos::experimental::fields::thread_scheduling(model.settings);
+                if (!thread_scheduling.has_field(name)) return;
+                scheduling = thread_scheduling.at(name);
+            }
+
+            details::set_thread_scheduling(scheduling, name, gate);
+        }
+
+        // make a function which sets the scheduling of the calling thread to that configured for the named thread, for threads started by e.g. the listeners,
+        // or return an empty function if none is configured
+        std::function<void()> make_thread_scheduling_callback(const nmos::settings& settings, const utility::string_t& name, slog::base_gate& gate)
+        {
+            const auto& thread_scheduling = nmos::experimental::fields::thread_scheduling(settings);
+            if (!thread_scheduling.has_field(name)) return{};
+
+            const auto scheduling = thread_scheduling.at(name);
+            return [scheduling, name, &gate]
+            {
+                details::set_thread_scheduling(scheduling, name, gate);
+            };
+        }
+    }
+}
@@ -0,0 +1,36 @@
+#ifndef NMOS_THREAD_SCHEDULING_H
+#define NMOS_THREAD_SCHEDULING_H
+
+#include <functional>
+#include "nmos/settings.h"
+
+namespace slog
+{
+    class base_gate;
+}
+
+// This is an experimental extension to set the CPU affinity and priority of the background threads and the listener threads,
+// so that e.g. heartbeats, registration expiry and activations remain timely when the process shares the host with other heavy loads
+// See nmos::experimental::fields::thread_scheduling
+namespace nmos
+{
+    struct base_model;
+
+    namespace experimental
+    {
+        // set the CPU affinity and either the real-time (SCHED_FIFO) priority or the nice value of the calling thread,
+        // from an object like { "affinity": [ 2, 3 ], "realtime_priority": 50 } or { "nice": -10 }, in which any of the fields may be omitted
+        // throws std::invalid_argument for an invalid object, and std::system_error if the scheduling cannot be set, e.g. for lack of privileges or on unsupported platforms
+        void set_current_thread_scheduling(const web::json::value& scheduling);
+
+        // set the scheduling of the calling thread to that configured for the named thread, if any, logging any failure
+        // e.g. at the start of each of the background threads started by nmos::details::make_thread_guard
+        void set_thread_scheduling(const nmos::base_model& model, const utility::string_t& name, slog::base_gate& gate);
+
+        // make a function which sets the scheduling of the calling thread to that configured for the named thread, for threads started by e.g. the listeners,
+        // or return an empty function if none is configured
+        std::function<void()> make_thread_scheduling_callback(const nmos::settings& settings, const utility::string_t& name, slog::base_gate& gate);
+    }
+}
+
+#endif
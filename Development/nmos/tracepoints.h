@@ -0,0 +1,35 @@
+#ifndef NMOS_TRACEPOINTS_H
+#define NMOS_TRACEPOINTS_H
+
+// When NMOS_CPP_USDT is defined (see NmosCppCommon.cmake), NMOS_CPP_TRACE(name, args...) is a USDT (user-level statically defined tracing) probe
+// of the "nmos_cpp" provider, which costs a single nop until a tracer such as bpftrace or perf attaches to it, so that a production process
+// can be profiled without rebuilding; e.g. for a histogram of the time for which the model lock is waited for, by call site line
+//     bpftrace -e 'usdt:./nmos-cpp-registry:nmos_cpp:lock_acquire { @start[tid] = nsecs; }
+//                  usdt:./nmos-cpp-registry:nmos_cpp:lock_acquired /@start[tid]/ { @wait_ns[arg1] = hist(nsecs - @start[tid]); delete(@start[tid]); }'
+// Otherwise, the tracepoints are compiled out, and their arguments aren't evaluated
+// Arguments must be integers or pointers, e.g. the c_str() of a utility::string_t, which is a UTF-8 std::string on the platforms with USDT support
+//
+// The tracepoints, and their arguments, are:
+//     lock_acquire(file, line, shared)                  before the model lock is acquired by nmos::base_model::read_lock or write_lock
+//     lock_acquired(file, line, shared)                 once it has been acquired
+//     lock_release(file, line, shared, hold_us)         when it is released (only when NMOS_CPP_INSTRUMENT_MUTEX is also defined)
+//     registration_commit(action, type, id)             before a Registration API request creates, modifies or refreshes a resource
+//     registration_committed(action, type, id)          once the resource, and the resource events, have been inserted or modified
+//     heartbeat(node_id)                                when a Registration API heartbeat is handled
+//     subscription_match(subscription_id, events)       when resource changes match a subscription, before the events are inserted
+//     ws_enqueue(connection_id, events)                 when events are inserted into the event queue of a Query API websocket connection
+//     ws_send(subscription_id, bytes)                   before a Query API websocket message is sent
+//     ws_sent(subscription_id, bytes)                   once it has been sent
+//     expiry_begin(description)                         before each cycle of erasing expired resources
+//     expiry_end(description, expired, forgotten)       after each cycle
+//     activation_process(id, scheduled, latency_us)     when an IS-05 immediate or scheduled activation is staged
+//     activation_commit(resources)                      before the resources modified by the staged activations are committed to the model
+//     activation_committed(failures)                    once they have been committed
+#if defined(NMOS_CPP_USDT)
+#include <sys/sdt.h>
+#define NMOS_CPP_TRACE(...) STAP_PROBEV(nmos_cpp, __VA_ARGS__)
+#else
+#define NMOS_CPP_TRACE(...) ((void)0)
+#endif
+
+#endif
@@ -0,0 +1,192 @@
+#include "nmos/traffic_trace.h"
+
+#include <algorithm>
+#include <chrono>
+#include <stdexcept>
+#include "cpprest/basic_utils.h"
+#include "cpprest/containerstream.h"
+#include "nmos/slog.h"
+
+namespace nmos
+{
+    namespace experimental
+    {
+        namespace details
+        {
+            // the header identifies the format, in case it ever needs to change
+            static const char traffic_trace_magic[] = { 'n', 'm', 'o', 's', 't', 'r', 'c', '1' };
+
+            static void write_varint(std::ostream& os, std::uint64_t value)
+            {
+                while (0x80 <= value)
+                {
+                    os.put(char(0x80 | (value & 0x7f)));
+                    value >>= 7;
+                }
+                os.put(char(value));
+            }
+
+            static bool read_varint(std::istream& is, std::uint64_t& value)
+            {
+                value = 0;
+                for (int shift = 0; shift < 64; shift += 7)
+                {
+                    const auto c = is.get();
+                    if (std::istream::traits_type::eof() == c) return false;
+                    value |= std::uint64_t(c & 0x7f) << shift;
+                    if (0 == (c & 0x80)) return true;
+                }
+                return false;
+            }
+
+            static void write_bytes(std::ostream& os, const char* data, std::size_t size)
+            {
+                write_varint(os, size);
+                os.write(data, (std::streamsize)size);
+            }
+
+            static void write_string(std::ostream& os, const utility::string_t& value)
+            {
+                const auto utf8 = utility::us2s(value);
+                write_bytes(os, utf8.data(), utf8.size());
+            }
+
+            static bool read_bytes(std::istream& is, std::string& bytes)
+            {
+                std::uint64_t size;
+                if (!read_varint(is, size)) return false;
+                bytes.resize((std::size_t)size);
+                if (0 != size) is.read(&bytes[0], (std::streamsize)size);
+                return !is.fail();
+            }
+
+            static bool read_string(std::istream& is, utility::string_t& value)
+            {
+                std::string utf8;
+                if (!read_bytes(is, utf8)) return false;
+                value = utility::s2us(utf8);
+                return true;
+            }
+        }
+
+        void write_traffic_trace_header(std::ostream& os)
+        {
+            os.write(details::traffic_trace_magic, sizeof(details::traffic_trace_magic));
+        }
+
+        void write_traffic_record(std::ostream& os, const traffic_record& record)
+        {
+            details::write_varint(os, (std::uint64_t)record.received);
+            details::write_string(os, record.client);
+            details::write_string(os, record.method);
+            details::write_string(os, record.path);
+            details::write_varint(os, record.headers.size());
+            for (const auto& header : record.headers)
+            {
+                details::write_string(os, header.first);
+                details::write_string(os, header.second);
+            }
+            details::write_bytes(os, (const char*)record.body.data(), record.body.size());
+        }
+
+        void read_traffic_trace_header(std::istream& is)
+        {
+            char magic[sizeof(details::traffic_trace_magic)];
+            is.read(magic, sizeof(magic));
+            if (!is || !std::equal(magic, magic + sizeof(magic), details::traffic_trace_magic))
+            {
+                throw std::runtime_error("not a traffic trace");
+            }
+        }
+
+        bool read_traffic_record(std::istream& is, traffic_record& record)
+        {
+            std::uint64_t received;
+            if (!details::read_varint(is, received)) return false;
+            record.received = (std::int64_t)received;
+            if (!details::read_string(is, record.client)) return false;
+            if (!details::read_string(is, record.method)) return false;
+            if (!details::read_string(is, record.path)) return false;
+            std::uint64_t headers;
+            if (!details::read_varint(is, headers)) return false;
+            record.headers.clear();
+            for (std::uint64_t header = 0; header < headers; ++header)
+            {
+                std::pair<utility::string_t, utility::string_t> name_value;
+                if (!details::read_string(is, name_value.first) || !details::read_string(is, name_value.second)) return false;
+                record.headers.push_back(std::move(name_value));
+            }
+            std::string body;
+            if (!details::read_bytes(is, body)) return false;
+            record.body.assign(body.begin(), body.end());
+            return true;
+        }
+
+        traffic_recorder::traffic_recorder(const utility::string_t& filename)
+        {
+            const auto file_ = utility::us2s(filename);
+            // a trace may be appended to, e.g. after a restart, so only a new (or empty) file needs the header
+            const bool empty = std::ifstream(file_, std::ios::binary | std::ios::ate).tellg() <= 0;
+            file.open(file_, std::ios::binary | std::ios::app);
+            if (!file) throw std::runtime_error("could not open traffic trace file: " + file_);
+            if (empty) write_traffic_trace_header(file);
+        }
+
+        traffic_recorder::~traffic_recorder()
+        {
+            std::lock_guard<std::mutex> lock(mutex);
+            file.flush();
+        }
+
+        void traffic_recorder::record(const traffic_record& record)
+        {
+            std::lock_guard<std::mutex> lock(mutex);
+            write_traffic_record(file, record);
+        }
+
+        // construct a traffic recorder based on settings, or return nullptr if the capture mode is disabled
+        std::shared_ptr<traffic_recorder> make_traffic_recorder(const nmos::settings& settings, slog::base_gate& gate)
+        {
+            const auto filename = nmos::experimental::fields::traffic_trace_file(settings);
+            if (filename.empty()) return{};
+
+            slog::log<slog::severities::warning>(gate, SLOG_FLF) << "Recording all API requests to traffic trace file: " << filename;
+            return std::make_shared<traffic_recorder>(filename);
+        }
+
+        namespace details
+        {
+            // make a listener handler which records each request, including its body, before calling the specified handler
+            std::function<void(web::http::http_request)> make_traffic_capture_handler(std::function<void(web::http::http_request)> handler, std::shared_ptr<traffic_recorder> recorder)
+            {
+                return [handler, recorder](web::http::http_request req)
+                {
+                    auto record = std::make_shared<traffic_record>();
+                    record->received = std::chrono::duration_cast<std::chrono::microseconds>(std::chrono::system_clock::now().time_since_epoch()).count();
+                    record->client = req.remote_address();
+                    record->method = req.method();
+                    record->path = req.relative_uri().to_string();
+                    record->headers.assign(req.headers().begin(), req.headers().end());
+
+                    req.extract_vector().then([handler, recorder, record, req](pplx::task<std::vector<unsigned char>> body) mutable
+                    {
+                        // if the body can't be read, e.g. because the client disconnected, the route handlers will find that out for themselves
+                        try { record->body = body.get(); } catch (const web::http::http_exception&) {}
+
+                        if (!record->body.empty())
+                        {
+                            // restore the body for the route handlers, without changing the Content-Type
+                            const auto content_type = req.headers().content_type();
+                            req.set_body(concurrency::streams::bytestream::open_istream(record->body), record->body.size());
+                            if (content_type.empty()) req.headers().remove(web::http::header_names::content_type);
+                            else req.headers().set_content_type(content_type);
+                        }
+
+                        recorder->record(*record);
+                        handler(req);
+                    });
+                };
+            }
+        }
+    }
+}
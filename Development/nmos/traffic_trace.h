@@ -0,0 +1,78 @@
+#ifndef NMOS_TRAFFIC_TRACE_H
+#define NMOS_TRAFFIC_TRACE_H
+
+#include <cstdint>
+#include <fstream>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <vector>
+#include "cpprest/http_msg.h"
+#include "nmos/settings.h"
+
+namespace slog
+{
+    class base_gate;
+}
+
+// This is an experimental extension to record the requests to the APIs in a compact binary trace file,
+// which can be replayed against another instance, e.g. by nmos-cpp-loadgen, to reproduce production load offline
+// See nmos::experimental::fields::traffic_trace_file
+namespace nmos
+{
+    namespace experimental
+    {
+        // one recorded request
+        struct traffic_record
+        {
+            // the time at which the request was received, in microseconds since the epoch of the system clock
+            std::int64_t received;
+            // the client address, used to preserve the order of the requests from each client on replay
+            utility::string_t client;
+            web::http::method method;
+            // the request path and query, relative to the listener
+            utility::string_t path;
+            std::vector<std::pair<utility::string_t, utility::string_t>> headers;
+            std::vector<unsigned char> body;
+        };
+
+        // the trace file format is a header followed by a sequence of records, in which each integer is an unsigned LEB128 varint,
+        // and each string or body is its length in bytes followed by its UTF-8 or raw bytes, so that the file is safe to append to
+        void write_traffic_trace_header(std::ostream& os);
+        void write_traffic_record(std::ostream& os, const traffic_record& record);
+
+        // check the header, which throws std::runtime_error if the stream is not a trace
+        void read_traffic_trace_header(std::istream& is);
+        // read the next record, returning false at the end of the stream (or a truncated record, e.g. if the recorder was killed)
+        bool read_traffic_record(std::istream& is, traffic_record& record);
+
+        // appends records to a trace file; records may be written concurrently from the listener threads
+        class traffic_recorder
+        {
+        public:
+            explicit traffic_recorder(const utility::string_t& filename);
+            ~traffic_recorder();
+
+            void record(const traffic_record& record);
+
+            traffic_recorder(const traffic_recorder&) = delete;
+            traffic_recorder& operator=(const traffic_recorder&) = delete;
+
+        private:
+            std::mutex mutex;
+            std::ofstream file;
+        };
+
+        // construct a traffic recorder based on settings, or return nullptr if the capture mode is disabled
+        std::shared_ptr<traffic_recorder> make_traffic_recorder(const nmos::settings& settings, slog::base_gate& gate);
+
+        namespace details
+        {
+            // make a listener handler which records each request, including its body, before calling the specified handler
+            // note, the body has to be read, and then restored, before the API route handlers extract it
+            std::function<void(web::http::http_request)> make_traffic_capture_handler(std::function<void(web::http::http_request)> handler, std::shared_ptr<traffic_recorder> recorder);
+        }
+    }
+}
+
+#endif
@@ -1,6 +1,9 @@
 #ifndef NMOS_VERSION_H
 #define NMOS_VERSION_H
 
+#include <cstdint>
+#include <limits>
+#include "cpprest/details/basic_types.h"
 #include "nmos/tai.h"
 
 namespace nmos
@@ -10,20 +13,70 @@ namespace nmos
     // identifies the instant at which this change took place."
     // See https://github.com/AMWA-TV/nmos-discovery-registration/blob/v1.2/docs/2.1.%20APIs%20-%20Common%20Keys.md#version
 
+    namespace details
+    {
+        // append the decimal representation of the integer, without the overhead of a string stream
+        inline void append_integer(utility::string_t& s, std::int64_t value)
+        {
+            utility::char_t digits[20];
+            auto first = digits + 20;
+            auto magnitude = 0 > value ? std::uint64_t(0) - std::uint64_t(value) : std::uint64_t(value);
+            do
+            {
+                *--first = utility::char_t(U('0') + magnitude % 10);
+                magnitude /= 10;
+            } while (0 != magnitude);
+            if (0 > value) s.push_back(U('-'));
+            s.append(first, digits + 20);
+        }
+
+        // parse an optionally signed decimal integer, like the extraction operator of a string stream, but without the overhead,
+        // returning false if there are no digits or the value is out of range
+        inline bool parse_integer(const utility::char_t*& first, const utility::char_t* last, std::int64_t& value)
+        {
+            bool negative = false;
+            if (last != first && (U('-') == *first || U('+') == *first)) negative = U('-') == *first++;
+            if (last == first || *first < U('0') || U('9') < *first) return false;
+
+            const std::uint64_t limit = std::uint64_t((std::numeric_limits<std::int64_t>::max)()) + (negative ? 1 : 0);
+            std::uint64_t magnitude = 0;
+            for (; last != first && U('0') <= *first && *first <= U('9'); ++first)
+            {
+                const std::uint64_t digit = *first - U('0');
+                if (magnitude > (limit - digit) / 10) return false;
+                magnitude = magnitude * 10 + digit;
+            }
+            value = negative ? std::int64_t(std::uint64_t(0) - magnitude) : std::int64_t(magnitude);
+            return true;
+        }
+    }
+
     inline utility::string_t make_version(tai tai = tai_now())
     {
-        utility::ostringstream_t os;
-        os << tai.seconds << U(':') << tai.nanoseconds;
-        return os.str();
+        utility::string_t version;
+        version.reserve(32);
+        details::append_integer(version, tai.seconds);
+        version.push_back(U(':'));
+        details::append_integer(version, tai.nanoseconds);
+        return version;
     }
 
     inline tai parse_version(const utility::string_t& timestamp)
     {
-        utility::istringstream_t is(timestamp);
+        // equivalent to extracting <seconds>, ':', <nanoseconds> from a string stream (so any leading whitespace is skipped,
+        // and anything after the nanoseconds is ignored), since this is used e.g. for every resource compared by an RQL query
+        auto first = timestamp.c_str();
+        const auto last = first + timestamp.size();
+        const auto skip_whitespace = [&] { while (last != first && (U(' ') == *first || (U('\t') <= *first && *first <= U('\r')))) ++first; };
+
         tai tai;
-        utility::char_t colon;
-        is >> tai.seconds >> colon >> tai.nanoseconds;
-        return !is.fail() && U(':') == colon ? tai : nmos::tai{};
+        skip_whitespace();
+        if (!details::parse_integer(first, last, tai.seconds)) return nmos::tai{};
+        skip_whitespace();
+        if (last == first || U(':') != *first++) return nmos::tai{};
+        skip_whitespace();
+        if (!details::parse_integer(first, last, tai.nanoseconds)) return nmos::tai{};
+        return tai;
     }
 }
 
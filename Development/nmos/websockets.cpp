@@ -0,0 +1,31 @@
+#include "nmos/websockets.h"
+
+#include "nmos/slog.h"
+
+namespace nmos
+{
+    namespace details
+    {
+        // close the specified websocket connections, e.g. those identified while the model lock was held by one of the websocket send threads,
+        // which should be done once that lock has been released, since each close contends with the listener's own threads that may be waiting for the lock in the close handler
+        void close_websockets(web::websockets::experimental::listener::websocket_listener& listener, const std::vector<web::websockets::experimental::listener::connection_id>& connections, const utility::string_t& close_reason, slog::base_gate& gate)
+        {
+            if (connections.empty()) return;
+
+            slog::log<slog::severities::more_info>(gate, SLOG_FLF) << "Closing " << connections.size() << " websocket connections";
+
+            for (const auto& connection : connections)
+            {
+                try
+                {
+                    // theoretically blocking, but in fact not, since the close handshake is only initiated here, and completed by the listener's own threads
+                    listener.close(connection, web::websockets::websocket_close_status::server_terminate, close_reason).wait();
+                }
+                catch (const web::websockets::websocket_exception& e)
+                {
+                    slog::log<slog::severities::warning>(gate, SLOG_FLF) << "WebSocket error: " << e.what() << " [" << e.error_code() << "]";
+                }
+            }
+        }
+    }
+}
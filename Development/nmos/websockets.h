@@ -1,16 +1,30 @@
 #ifndef NMOS_WEBSOCKETS_H
 #define NMOS_WEBSOCKETS_H
 
+#include <vector>
 #include <boost/bimap/bimap.hpp>
 #include <boost/bimap/unordered_set_of.hpp>
 #include "cpprest/ws_listener.h" // for web::websockets::experimental::listener::connection_id, etc.
 #include "nmos/id.h"
 
+namespace slog
+{
+    class base_gate;
+}
+
 namespace nmos
 {
     // This declares a container type suitable for managing websocket connections associated with subscriptions
     // to NMOS APIs, as used in the IS-04 Query WebSocket API and IS-07 Events WebSocket API.
     typedef boost::bimaps::bimap<boost::bimaps::unordered_set_of<nmos::id>, web::websockets::experimental::listener::connection_id> websockets;
+
+    namespace details
+    {
+        // close the specified websocket connections, e.g. those identified while the model lock was held by one of the websocket send threads,
+        // which should be done once that lock has been released, since each close contends with the listener's own threads that may be waiting for the lock in the close handler;
+        // errors are logged rather than thrown, since e.g. the client may have closed the connection in the meantime
+        void close_websockets(web::websockets::experimental::listener::websocket_listener& listener, const std::vector<web::websockets::experimental::listener::connection_id>& connections, const utility::string_t& close_reason, slog::base_gate& gate);
+    }
 }
 
 #endif
@@ -0,0 +1,103 @@
+#ifndef PPLX_PPLX_COROUTINE_H
+#define PPLX_PPLX_COROUTINE_H
+
+// Adapters to write asynchronous operations that use pplx::task as C++20 coroutines,
+// e.g. a function returning pplx::task<bool> can co_await pplx::complete_at(time, token), or a web::http::client::http_client request, and then co_return true
+// rather than chaining continuations by then() and pplx::do_while
+// PPLX_HAS_COROUTINES is defined to 1 when the compiler supports C++20 coroutines, so that each module can opt in while still supporting C++11 builds, e.g.
+//
+// #include "pplx/pplx_coroutine.h"
+// #if PPLX_HAS_COROUTINES
+// ... coroutine implementation ...
+// #else
+// ... continuation implementation ...
+// #endif
+
+#if defined(__has_include)
+#if __has_include(<coroutine>) && defined(__cpp_impl_coroutine) && __cpp_impl_coroutine >= 201902L
+#define PPLX_HAS_COROUTINES 1
+#endif
+#endif
+
+#ifndef PPLX_HAS_COROUTINES
+#define PPLX_HAS_COROUTINES 0
+#endif
+
+#if PPLX_HAS_COROUTINES
+
+#include <coroutine>
+#include <exception>
+#include "pplx/pplxtasks.h"
+
+#if (defined(_MSC_VER) && (_MSC_VER >= 1800)) && !CPPREST_FORCE_PPLX
+namespace Concurrency // since namespace pplx = Concurrency
+#else
+namespace pplx
+#endif
+{
+    namespace coroutine_details
+    {
+        template <typename ReturnType>
+        struct task_awaiter
+        {
+            pplx::task<ReturnType> task;
+
+            bool await_ready() const { return task.is_done(); }
+
+            void await_suspend(std::coroutine_handle<> coroutine)
+            {
+                // resume the coroutine on the thread that completes the task, rather than scheduling another continuation
+                task.then([coroutine](pplx::task<ReturnType>) { coroutine.resume(); }, pplx::task_continuation_context::use_synchronous_execution());
+            }
+
+            // rethrows the exception if the task failed, or pplx::task_canceled if it was cancelled
+            ReturnType await_resume() { return task.get(); }
+        };
+
+        template <typename ReturnType>
+        struct task_promise_base
+        {
+            pplx::task_completion_event<ReturnType> completion;
+
+            pplx::task<ReturnType> get_return_object() { return pplx::create_task(completion); }
+
+            // the coroutine runs synchronously until it first awaits an incomplete task
+            std::suspend_never initial_suspend() noexcept { return{}; }
+            std::suspend_never final_suspend() noexcept { return{}; }
+
+            void unhandled_exception() { completion.set_exception(std::current_exception()); }
+        };
+
+        template <typename ReturnType>
+        struct task_promise : task_promise_base<ReturnType>
+        {
+            void return_value(ReturnType value) { this->completion.set(std::move(value)); }
+        };
+
+        template <>
+        struct task_promise<void> : task_promise_base<void>
+        {
+            void return_void() { this->completion.set(); }
+        };
+    }
+
+    /// <summary>
+    ///     Awaits the completion of a task in a coroutine, resulting in the task's result, or rethrowing its exception.
+    /// </summary>
+    template <typename ReturnType>
+    inline coroutine_details::task_awaiter<ReturnType> operator co_await(pplx::task<ReturnType> task)
+    {
+        return{ std::move(task) };
+    }
+}
+
+// allow a coroutine to return pplx::task<ReturnType>, which completes when the coroutine returns, or throws an exception
+template <typename ReturnType, typename... Args>
+struct std::coroutine_traits<pplx::task<ReturnType>, Args...>
+{
+    typedef pplx::coroutine_details::task_promise<ReturnType> promise_type;
+};
+
+#endif
+
+#endif
@@ -53,47 +53,131 @@ namespace Concurrency // since namespace pplx = Concurrency
 
 #else
 
+#include <cstdint>
+#include <map>
+#include <mutex>
+#include <vector>
 #include <boost/asio/basic_waitable_timer.hpp>
 #include "pplx/threadpool.h"
 
 namespace pplx
 {
-    pplx::task<void> complete_after(unsigned int milliseconds, const pplx::cancellation_token& token)
+    namespace details
     {
-        // construct a task that completes after an asynchronous wait on a timer
-        pplx::task_completion_event<void> tce;
-
-        typedef boost::asio::basic_waitable_timer<std::chrono::steady_clock> steady_timer;
-        // when the current <see cref="set_ambient_scheduler Function">ambient scheduler</see> has been changed from the default
-        // using the shared threadpool perhaps isn't appropriate, but given the scheduler_interface, the alternative is unclear...
-        auto timer = std::make_shared<steady_timer>(crossplat::threadpool::shared_instance().service());
-        timer->expires_from_now(std::chrono::duration_cast<steady_timer::duration>(std::chrono::milliseconds(milliseconds)));
-        timer->async_wait([tce](const boost::system::error_code& ec)
+        // a single asio timer shared by all the tasks created by complete_after, rather than one per call, which is expensive
+        // when e.g. many simulated nodes each have periodic heartbeats; the pending deadlines are kept in order in a map,
+        // and the timer is only re-armed when the earliest deadline changes
+        class timer_service
         {
-            if (ec == boost::asio::error::operation_aborted)
+        public:
+            typedef std::chrono::steady_clock clock;
+            // the sequence number distinguishes timers with the same deadline
+            typedef std::pair<clock::time_point, std::uint64_t> key_type;
+
+            // when the current <see cref="set_ambient_scheduler Function">ambient scheduler</see> has been changed from the default
+            // using the shared threadpool perhaps isn't appropriate, but given the scheduler_interface, the alternative is unclear...
+            static timer_service& shared_instance()
             {
-                // calling tce.set_exception(pplx::task_canceled()) does not have the right effect, it results in a call
-                // to wait on the task throwing rather than returning pplx::canceled
-                if (!tce._IsTriggered())
+                // intentionally leaked, so that it outlives any pending handlers on the shared threadpool
+                static timer_service* instance = new timer_service(crossplat::threadpool::shared_instance().service());
+                return *instance;
+            }
+
+            key_type schedule(clock::time_point deadline, pplx::task_completion_event<void> tce)
+            {
+                std::lock_guard<std::mutex> lock(mutex);
+                const key_type key{ deadline, ++sequence };
+                timers.insert({ key, tce });
+                arm();
+                return key;
+            }
+
+            // returns true if the timer was removed before it expired
+            bool cancel(const key_type& key)
+            {
+                std::lock_guard<std::mutex> lock(mutex);
+                // if this was the earliest deadline, the shared timer is left armed, and will simply find nothing to do
+                return 0 != timers.erase(key);
+            }
+
+        private:
+            typedef boost::asio::basic_waitable_timer<clock> steady_timer;
+
+            explicit timer_service(boost::asio::io_service& service)
+                : timer(service)
+                , armed((clock::time_point::max)())
+                , sequence(0)
+            {}
+
+            // (with the mutex locked)
+            void arm()
+            {
+                if (timers.empty() || armed <= timers.begin()->first.first) return;
+
+                armed = timers.begin()->first.first;
+                // this cancels any pending wait, whose handler will then be called with operation_aborted
+                timer.expires_at(armed);
+                timer.async_wait([this](const boost::system::error_code& ec)
                 {
-                    tce._Cancel();
-                }
+                    if (ec != boost::asio::error::operation_aborted) expire();
+                });
             }
-            else
+
+            void expire()
             {
-                tce.set();
+                std::vector<pplx::task_completion_event<void>> expired;
+                {
+                    std::lock_guard<std::mutex> lock(mutex);
+                    const auto now = clock::now();
+                    auto last = timers.begin();
+                    for (; timers.end() != last && last->first.first <= now; ++last)
+                    {
+                        expired.push_back(last->second);
+                    }
+                    timers.erase(timers.begin(), last);
+                    armed = (clock::time_point::max)();
+                    arm();
+                }
+
+                // complete the tasks without the mutex locked, since continuations may run inline
+                for (auto& tce : expired)
+                {
+                    tce.set();
+                }
             }
-        });
+
+            std::mutex mutex;
+            steady_timer timer;
+            clock::time_point armed;
+            std::uint64_t sequence;
+            std::map<key_type, pplx::task_completion_event<void>> timers;
+        };
+    }
+
+    pplx::task<void> complete_after(unsigned int milliseconds, const pplx::cancellation_token& token)
+    {
+        // construct a task that completes after an asynchronous wait on the shared timer
+        pplx::task_completion_event<void> tce;
+
+        auto& service = details::timer_service::shared_instance();
+        const auto key = service.schedule(details::timer_service::clock::now() + std::chrono::milliseconds(milliseconds), tce);
 
         auto result = pplx::create_task(tce, token);
 
         // when the token is canceled, cancel the timer
         if (token.is_cancelable())
         {
-            auto registration = token.register_callback([timer]
+            auto registration = token.register_callback([&service, key, tce]
             {
-                boost::system::error_code ignored;
-                timer->cancel(ignored);
+                if (service.cancel(key))
+                {
+                    // calling tce.set_exception(pplx::task_canceled()) does not have the right effect, it results in a call
+                    // to wait on the task throwing rather than returning pplx::canceled
+                    if (!tce._IsTriggered())
+                    {
+                        tce._Cancel();
+                    }
+                }
             });
 
             result.then([token, registration](pplx::task<void>)
@@ -102,9 +186,6 @@ namespace pplx
             });
         }
 
-        // capture the timer so it definitely doesn't get deleted too soon
-        result.then([timer]{});
-
         return result;
     }
 }
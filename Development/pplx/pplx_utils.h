@@ -2,6 +2,8 @@
 #define PPLX_PPLX_UTILS_H
 
 #include <chrono>
+#include <exception>
+#include <vector>
 #include "pplx/pplxtasks.h"
 
 #if (defined(_MSC_VER) && (_MSC_VER >= 1800)) && !CPPREST_FORCE_PPLX
@@ -102,6 +104,59 @@ namespace pplx
         open_close_guard& operator=(const open_close_guard&) = delete;
         guarded_t* guarded;
     };
+
+    /// <summary>
+    ///     RAII helper for a number of objects of classes that have asynchronous open/close member functions,
+    ///     which are opened concurrently, rather than one after another, and likewise closed.
+    ///     If any fails to open, the others are closed and the exception is rethrown.
+    /// </summary>
+    template <typename T>
+    struct open_close_guards
+    {
+        typedef T guarded_t;
+        open_close_guards() {}
+        explicit open_close_guards(const std::vector<T*>& ts)
+        {
+            std::vector<pplx::task<void>> opens;
+            opens.reserve(ts.size());
+            for (auto t : ts) opens.push_back(t->open());
+
+            std::exception_ptr error;
+            for (size_t i = 0; i < opens.size(); ++i)
+            {
+                try
+                {
+                    opens[i].wait();
+                    guarded.push_back(ts[i]);
+                }
+                catch (...)
+                {
+                    if (!error) error = std::current_exception();
+                }
+            }
+            if (error)
+            {
+                close();
+                std::rethrow_exception(error);
+            }
+        }
+        ~open_close_guards() { close(); }
+        open_close_guards(open_close_guards&& other) : guarded(std::move(other.guarded)) { other.guarded.clear(); }
+        open_close_guards& operator=(open_close_guards&& other) { if (this != &other) { close(); guarded = std::move(other.guarded); other.guarded.clear(); } return *this; }
+        open_close_guards(const open_close_guards&) = delete;
+        open_close_guards& operator=(const open_close_guards&) = delete;
+        std::vector<guarded_t*> guarded;
+
+    private:
+        void close()
+        {
+            std::vector<pplx::task<void>> closes;
+            closes.reserve(guarded.size());
+            for (auto t : guarded) closes.push_back(t->close());
+            guarded.clear();
+            for (auto& closing : closes) closing.wait();
+        }
+    };
 }
 
 #endif
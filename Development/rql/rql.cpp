@@ -1,7 +1,10 @@
 #include "rql/rql.h"
 
+#include <memory>
 #include <stack>
 #include <stdexcept>
+#include <vector>
+#include <boost/algorithm/string/split.hpp>
 #include "cpprest/base_uri.h" // for uri::decode
 #include "cpprest/basic_utils.h"
 #include "cpprest/json_utils.h"
@@ -444,7 +447,13 @@ namespace rql
             return logical_or(lhs, std::bind(predicate, std::placeholders::_1, rhs)) == value_true ? value_true : value_false;
         }
 
-        inline web::json::value matches(const web::json::value& target, const utility::string_t& pattern, bool icase)
+        inline utility::regex_t::flag_type regex_flags(bool icase)
+        {
+            // verbose conditional expression avoids compiler warnings on all platforms
+            return icase ? utility::regex_t::flag_type(utility::regex_t::icase) : utility::regex_t::flag_type(0);
+        }
+
+        inline web::json::value matches_regex(const web::json::value& target, const utility::regex_t& regex)
         {
             if (!target.is_string())
             {
@@ -452,13 +461,22 @@ namespace rql
             }
             else
             {
-                // verbose conditional expression avoids compiler warnings on all platforms
-                const auto flags = icase ? utility::regex_t::flag_type(utility::regex_t::icase) : utility::regex_t::flag_type(0);
+                return bst::regex_search(target.as_string(), regex) ? value_true : value_false;
+            }
+        }
 
+        inline web::json::value matches(const web::json::value& target, const utility::string_t& pattern, bool icase)
+        {
+            if (!target.is_string())
+            {
+                return value_indeterminate;
+            }
+            else
+            {
                 // throws bst::regex_error if the pattern is not valid
-                utility::regex_t regex(pattern, flags);
+                utility::regex_t regex(pattern, regex_flags(icase));
 
-                return bst::regex_search(target.as_string(), regex) ? value_true : value_false;
+                return matches_regex(target, regex);
             }
         }
     }
@@ -746,4 +764,372 @@ namespace rql
     {
         return details::default_any_operators(equal_to, less);
     }
+
+    // Helpers for compiling RQL
+
+    namespace details
+    {
+        inline extractor make_extractor(const web::json::value& object)
+        {
+            return [&object](web::json::value& results, const web::json::value& key)
+            {
+                return web::json::extract(object.as_object(), results, key.as_string());
+            };
+        }
+
+        inline std::vector<utility::string_t> split_key_path(const web::json::value& key)
+        {
+            std::vector<utility::string_t> key_path;
+            // throws web::json::json_exception if the key is not a string
+            boost::algorithm::split(key_path, key.as_string(), [](utility::char_t c) { return U('.') == c; });
+            return key_path;
+        }
+
+        // an argument of a call-operator, which is either a constant, or a compiled query to be evaluated for each object
+        // this avoids copying constant values (e.g. the array for an 'in' operator) for each object
+        struct operand
+        {
+            // result is used as storage if the operand needs to be evaluated
+            const web::json::value& operator()(const web::json::value& object, web::json::value& result) const
+            {
+                if (!evaluate) return constant;
+                result = evaluate(object);
+                return result;
+            }
+
+            web::json::value constant;
+            compiled_query evaluate;
+        };
+
+        inline web::json::value all_of(const std::vector<compiled_query>& args, const web::json::value& object)
+        {
+            bool indeterminate = false;
+            for (const auto& arg : args)
+            {
+                auto result = arg(object);
+                if (!result.is_boolean())
+                {
+                    indeterminate = true;
+                }
+                else if (!result.as_bool())
+                {
+                    return value_false;
+                }
+            }
+            return indeterminate ? value_indeterminate : value_true;
+        }
+
+        inline web::json::value any_of(const std::vector<compiled_query>& args, const web::json::value& object)
+        {
+            bool indeterminate = false;
+            for (const auto& arg : args)
+            {
+                auto result = arg(object);
+                if (!result.is_boolean())
+                {
+                    indeterminate = true;
+                }
+                else if (result.as_bool())
+                {
+                    return value_true;
+                }
+            }
+            return indeterminate ? value_indeterminate : value_false;
+        }
+
+        // relation(<property>, <value>) with the specified predicate
+        inline compiled_query relation(operand lhs, operand rhs, comparator predicate)
+        {
+            return [lhs, rhs, predicate](const web::json::value& object)
+            {
+                web::json::value l, r;
+                return predicate(lhs(object, l), rhs(object, r));
+            };
+        }
+
+        // relation(<property>, <value>) with the specified predicate, satisfied by any element if the property's value is an array
+        inline compiled_query any_relation(operand lhs, operand rhs, comparator predicate)
+        {
+            return [lhs, rhs, predicate](const web::json::value& object)
+            {
+                web::json::value l, r;
+                const auto& rvalue = rhs(object, r);
+                return details::logical_or(lhs(object, l), [&](const web::json::value& element) { return predicate(element, rvalue); });
+            };
+        }
+
+        // the compiled functions below are equivalent to those used by an evaluator with the default (or default array-friendly) call-operators
+        // and an extractor using web::json::extract, but call-operators are found once, rather than for each object, property key paths are
+        // split once, and constant arguments such as regex patterns are constructed once
+        struct compiler
+        {
+            comparator equal_to;
+            comparator less;
+            bool any;
+            // used to evaluate any part of the query that cannot be compiled
+            std::shared_ptr<const rql::operators> operators;
+
+            compiled_query operator()(const web::json::value& arg, bool extract_value = false) const
+            {
+                try
+                {
+                    // arg is a call-operator
+                    if (is_call_operator(arg))
+                    {
+                        return compile_call(arg.at(U("name")).as_string(), arg.at(U("args")));
+                    }
+                    // arg is a value used as property key
+                    else if (extract_value)
+                    {
+                        const auto key_path = split_key_path(arg);
+                        return [key_path](const web::json::value& object)
+                        {
+                            web::json::value extracted;
+                            web::json::extract(object.as_object(), extracted, key_path);
+                            return extracted;
+                        };
+                    }
+                    // arg is a value
+                    else
+                    {
+                        return [arg](const web::json::value&) { return arg; };
+                    }
+                }
+                catch (const std::exception&)
+                {
+                    // e.g. an unimplemented call-operator, missing arguments, or an invalid regex pattern, so defer to the evaluator,
+                    // in order that the error is reported (or not!) exactly as if the query was being interpreted
+                    return interpret(arg, extract_value);
+                }
+            }
+
+            operand compile_operand(const web::json::value& arg, bool extract_value = false) const
+            {
+                return is_call_operator(arg) || extract_value ? operand{ {}, (*this)(arg, extract_value) } : operand{ arg, {} };
+            }
+
+            compiled_query interpret(const web::json::value& arg, bool extract_value) const
+            {
+                const auto operators = this->operators;
+                return [arg, extract_value, operators](const web::json::value& object)
+                {
+                    return evaluator{ make_extractor(object), *operators }(arg, extract_value);
+                };
+            }
+
+            compiled_query compile_call(const utility::string_t& name, const web::json::value& args) const
+            {
+                // throws json_exception if not an array
+                const auto& elements = args.as_array();
+
+                // Logical operators
+
+                if (U("and") == name || U("or") == name)
+                {
+                    std::vector<compiled_query> compiled;
+                    for (const auto& element : elements)
+                    {
+                        compiled.push_back((*this)(element));
+                    }
+                    if (U("and") == name)
+                    {
+                        return [compiled](const web::json::value& object) { return details::all_of(compiled, object); };
+                    }
+                    else
+                    {
+                        return [compiled](const web::json::value& object) { return details::any_of(compiled, object); };
+                    }
+                }
+                else if (U("not") == name)
+                {
+                    const auto compiled = (*this)(args.at(0));
+                    return [compiled](const web::json::value& object) { return details::logical_not(compiled(object)); };
+                }
+
+                // Relational operators
+
+                const auto equal_to = this->equal_to;
+                const auto less = this->less;
+
+                const std::pair<utility::string_t, comparator> predicates[] =
+                {
+                    { U("eq"), equal_to },
+                    { U("ne"), [equal_to](const web::json::value& lhs, const web::json::value& rhs) { return details::logical_not(equal_to(lhs, rhs)); } },
+                    { U("gt"), [less](const web::json::value& lhs, const web::json::value& rhs) { return less(rhs, lhs); } },
+                    { U("ge"), [less](const web::json::value& lhs, const web::json::value& rhs) { return details::logical_not(less(lhs, rhs)); } },
+                    { U("lt"), less },
+                    { U("le"), [less](const web::json::value& lhs, const web::json::value& rhs) { return details::logical_not(less(rhs, lhs)); } }
+                };
+                for (const auto& predicate : predicates)
+                {
+                    if (predicate.first == name)
+                    {
+                        auto lhs = compile_operand(args.at(0), true);
+                        auto rhs = compile_operand(args.at(1));
+                        return any ? any_relation(std::move(lhs), std::move(rhs), predicate.second) : relation(std::move(lhs), std::move(rhs), predicate.second);
+                    }
+                }
+
+                // Set relation functions
+
+                if (U("in") == name || U("out") == name)
+                {
+                    const auto lhs = compile_operand(args.at(0), true);
+                    const auto rhs = compile_operand(args.at(1));
+                    const bool negate = U("out") == name;
+                    return [lhs, rhs, equal_to, negate](const web::json::value& object)
+                    {
+                        web::json::value l, r;
+                        const auto result = details::includes(rhs(object, r), lhs(object, l), equal_to);
+                        return negate ? details::logical_not(result) : result;
+                    };
+                }
+                else if (U("contains") == name || U("excludes") == name)
+                {
+                    const auto lhs = compile_operand(args.at(0), true);
+                    const auto rhs = compile_operand(args.at(1));
+                    const bool negate = U("excludes") == name;
+                    return [lhs, rhs, equal_to, negate](const web::json::value& object)
+                    {
+                        web::json::value l, r;
+                        const auto result = details::includes(lhs(object, l), rhs(object, r), equal_to);
+                        return negate ? details::logical_not(result) : result;
+                    };
+                }
+
+                // Additional filter functions
+
+                if (U("null") == name)
+                {
+                    const auto& arg = args.at(0);
+
+                    // arg is a call-operator
+                    if (is_call_operator(arg))
+                    {
+                        const auto compiled = (*this)(arg);
+                        return [compiled](const web::json::value& object)
+                        {
+                            return web::json::value::null() == compiled(object) ? value_true : value_false;
+                        };
+                    }
+                    else
+                    {
+                        // distinguish a null value from property key not found
+                        const auto key_path = split_key_path(arg);
+                        return [key_path](const web::json::value& object)
+                        {
+                            web::json::value extracted;
+                            if (!web::json::extract(object.as_object(), extracted, key_path))
+                            {
+                                return value_indeterminate;
+                            }
+                            return web::json::value::null() == extracted ? value_true : value_false;
+                        };
+                    }
+                }
+                else if (U("matches") == name)
+                {
+                    const auto target = compile_operand(args.at(0), true);
+                    const auto& pattern = args.at(1);
+                    // throws web::json::json_exception if options are not a string
+                    const auto flags = regex_flags(args.size() > 2 ? args.at(2).as_string() == U("i") : false);
+
+                    if (!is_call_operator(pattern))
+                    {
+                        // construct the regex just once
+                        // throws web::json::json_exception if pattern is not a string, or bst::regex_error if the pattern is not valid
+                        const auto regex = std::make_shared<const utility::regex_t>(pattern.as_string(), flags);
+                        const bool any = this->any;
+                        return [target, regex, any](const web::json::value& object)
+                        {
+                            web::json::value t;
+                            const auto& tvalue = target(object, t);
+                            return any
+                                ? details::logical_or(tvalue, [&regex](const web::json::value& element) { return matches_regex(element, *regex); })
+                                : matches_regex(tvalue, *regex);
+                        };
+                    }
+                    else
+                    {
+                        const auto compiled = (*this)(pattern);
+                        const bool any = this->any;
+                        return [target, compiled, flags, any](const web::json::value& object)
+                        {
+                            web::json::value t;
+                            const auto& tvalue = target(object, t);
+                            // throws web::json::json_exception if pattern is not a string, or bst::regex_error if the pattern is not valid
+                            const utility::regex_t regex(compiled(object).as_string(), flags);
+                            return any
+                                ? details::logical_or(tvalue, [&regex](const web::json::value& element) { return matches_regex(element, regex); })
+                                : matches_regex(tvalue, regex);
+                        };
+                    }
+                }
+
+                // Other helpers
+
+                if (U("count") == name)
+                {
+                    const auto compiled = compile_operand(args.at(0), true);
+                    return [compiled](const web::json::value& object)
+                    {
+                        web::json::value a;
+                        const auto& arg = compiled(object, a);
+                        if (!arg.is_object() && !arg.is_array())
+                        {
+                            return value_indeterminate;
+                        }
+                        return web::json::value::number(arg.size());
+                    };
+                }
+                else if (U("get") == name)
+                {
+                    const auto& arg = args.at(0);
+
+                    // arg is a call-operator, the result of which can only be known for each object
+                    if (is_call_operator(arg))
+                    {
+                        const auto compiled = (*this)(arg);
+                        const auto operators = this->operators;
+                        return [compiled, operators](const web::json::value& object)
+                        {
+                            return evaluator{ make_extractor(object), *operators }(compiled(object), true);
+                        };
+                    }
+                    else
+                    {
+                        return (*this)(arg, true);
+                    }
+                }
+                else if (U("value") == name)
+                {
+                    return (*this)(args.at(0));
+                }
+
+                throw details::unimplemented_operator(name);
+            }
+        };
+    }
+
+    compiled_query compile_query(const web::json::value& query)
+    {
+        return compile_query(query, default_equal_to, default_less);
+    }
+
+    compiled_query compile_query(const web::json::value& query, comparator equal_to, comparator less)
+    {
+        const details::compiler compile{ equal_to, less, false, std::make_shared<const operators>(default_operators(equal_to, less)) };
+        return compile(query);
+    }
+
+    compiled_query compile_any_query(const web::json::value& query)
+    {
+        return compile_any_query(query, default_equal_to, default_less);
+    }
+
+    compiled_query compile_any_query(const web::json::value& query, comparator equal_to, comparator less)
+    {
+        const details::compiler compile{ equal_to, less, true, std::make_shared<const operators>(default_any_operators(equal_to, less)) };
+        return compile(query);
+    }
 }
@@ -65,6 +65,19 @@ namespace rql
 
     web::json::value default_equal_to(const web::json::value& lhs, const web::json::value& rhs);
     web::json::value default_less(const web::json::value& lhs, const web::json::value& rhs);
+
+    // Compile an RQL query into a tree of functions that can be evaluated repeatedly, for many json objects, more efficiently than
+    // by an evaluator, with the same result as an evaluator using the default (or array-friendly) call-operators and an extractor
+    // that uses web::json::extract on the object
+    // Any part of the query that cannot be compiled, e.g. an unimplemented call-operator, is instead interpreted when evaluated
+
+    typedef std::function<web::json::value(const web::json::value&)> compiled_query;
+
+    compiled_query compile_query(const web::json::value& query);
+    compiled_query compile_any_query(const web::json::value& query); // array-friendly variant
+
+    compiled_query compile_query(const web::json::value& query, comparator equal_to, comparator less);
+    compiled_query compile_any_query(const web::json::value& query, comparator equal_to, comparator less); // array-friendly variant
 }
 
 #endif
@@ -0,0 +1,58 @@
+// The first "test" is of course whether the header compiles standalone
+#include "rql/rql.h"
+
+#include "bst/test/benchmark.h"
+#include "bst/test/test.h"
+#include "cpprest/json_utils.h"
+
+namespace
+{
+    const auto object = web::json::value_of({
+        { U("id"), U("3b8be755-08ff-452b-b217-c9151eb21193") },
+        { U("label"), U("Example Sender") },
+        { U("transport"), U("urn:x-nmos:transport:rtp.mcast") },
+        { U("tags"), web::json::value_of({ U("baz"), U("qux") }) },
+        { U("interface_bindings"), web::json::value_of({ U("eth0"), U("eth1") }) },
+        { U("count"), 42 }
+    });
+
+    const utility::string_t query = U("and(eq(transport,urn%3Ax-nmos%3Atransport%3Artp.mcast),or(contains(interface_bindings,eth1),matches(label,%5Eexample,i)),gt(count,41))");
+}
+
+////////////////////////////////////////////////////////////////////////////////////////////
+BST_TEST_CASE(benchmarkRql)
+{
+    bst::test::benchmark("rql::parse_query", []
+    {
+        bst::test::do_not_optimize(rql::parse_query(query));
+    });
+
+    const auto parsed = rql::parse_query(query);
+    const rql::evaluator evaluate
+    {
+        [](web::json::value& results, const web::json::value& key)
+        {
+            return web::json::extract(object.as_object(), results, key.as_string());
+        },
+        rql::default_any_operators()
+    };
+    BST_REQUIRE_EQUAL(rql::value_true, evaluate(parsed));
+
+    bst::test::benchmark("rql::evaluator", [&]
+    {
+        bst::test::do_not_optimize(evaluate(parsed));
+    });
+
+    const auto compiled = rql::compile_any_query(parsed);
+    BST_REQUIRE_EQUAL(rql::value_true, compiled(object));
+
+    bst::test::benchmark("rql::compile_any_query", [&]
+    {
+        bst::test::do_not_optimize(rql::compile_any_query(parsed));
+    });
+
+    bst::test::benchmark("rql::compiled_query", [&]
+    {
+        bst::test::do_not_optimize(compiled(object));
+    });
+}
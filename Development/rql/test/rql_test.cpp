@@ -0,0 +1,89 @@
+// The first "test" is of course whether the header compiles standalone
+#include "rql/rql.h"
+
+#include "bst/test/test.h"
+#include "cpprest/json_utils.h"
+
+namespace
+{
+    web::json::value evaluate(const web::json::value& object, const utility::string_t& query)
+    {
+        return rql::evaluator
+        {
+            [&object](web::json::value& results, const web::json::value& key)
+            {
+                return web::json::extract(object.as_object(), results, key.as_string());
+            },
+            rql::default_any_operators()
+        }(rql::parse_query(query));
+    }
+
+    web::json::value evaluate_compiled(const web::json::value& object, const utility::string_t& query)
+    {
+        return rql::compile_any_query(rql::parse_query(query))(object);
+    }
+}
+
+////////////////////////////////////////////////////////////////////////////////////////////
+BST_TEST_CASE(testCompileAnyQuery)
+{
+    using web::json::value;
+    using web::json::value_of;
+
+    const auto object = value_of({
+        { U("id"), U("foo") },
+        { U("label"), U("Foo Bar") },
+        { U("count"), 42 },
+        { U("empty"), value::null() },
+        { U("tags"), value_of({ U("baz"), U("qux") }) },
+        { U("caps"), value_of({ { U("media_type"), U("video/raw") } }) },
+        { U("interfaces"), value_of({
+            value_of({ { U("name"), U("eth0") } }),
+            value_of({ { U("name"), U("eth1") } })
+        }) }
+    });
+
+    const utility::string_t queries[] =
+    {
+        U("eq(id,foo)"),
+        U("ne(id,foo)"),
+        U("eq(caps.media_type,video%2Fraw)"),
+        U("eq(interfaces.name,eth1)"),
+        U("ne(tags,baz)"),
+        U("gt(count,41)"),
+        U("ge(count,43)"),
+        U("lt(count,43)"),
+        U("le(count,41)"),
+        U("eq(count,string:42)"),
+        U("eq(missing,foo)"),
+        U("and(eq(id,foo),gt(count,41))"),
+        U("and(eq(id,foo),eq(missing,foo))"),
+        U("or(eq(id,bar),eq(missing,foo))"),
+        U("or(eq(id,bar),eq(count,42))"),
+        U("not(eq(id,foo))"),
+        U("in(id,(foo,bar))"),
+        U("out(id,(foo,bar))"),
+        U("contains(tags,qux)"),
+        U("excludes(tags,qux)"),
+        U("null(empty)"),
+        U("null(missing)"),
+        U("null(id)"),
+        U("matches(label,%5Efoo,i)"),
+        U("matches(label,%5Efoo)"),
+        U("matches(tags,%5Eq)"),
+        U("matches(interfaces.name,value(1%24))"),
+        U("eq(count(tags),2)"),
+        U("eq(get(value(id)),foo)"),
+        U("value(true)")
+    };
+
+    for (const auto& query : queries)
+    {
+        BST_REQUIRE_EQUAL(evaluate(object, query), evaluate_compiled(object, query));
+    }
+
+    // an unimplemented call-operator is only reported when evaluated
+    const auto compiled = rql::compile_any_query(rql::parse_query(U("or(eq(id,foo),unimplemented(id))")));
+    BST_REQUIRE_EQUAL(rql::value_true, compiled(object));
+    BST_REQUIRE_THROW(rql::compile_any_query(rql::parse_query(U("and(eq(id,foo),unimplemented(id))")))(object), std::runtime_error);
+}
@@ -0,0 +1,47 @@
+// The first "test" is of course whether the header compiles standalone
+#include "sdp/sdp.h"
+
+#include "bst/test/benchmark.h"
+#include "bst/test/test.h"
+#include "cpprest/json_utils.h"
+
+namespace
+{
+    const std::string video_sdp = R"(v=0
+o=- 3745911798 3745911798 IN IP4 192.168.9.142
+s=Example Sender 1 (Video)
+t=0 0
+a=group:DUP PRIMARY SECONDARY
+m=video 50020 RTP/AVP 96
+c=IN IP4 239.22.142.1/32
+a=ts-refclk:ptp=IEEE1588-2008:traceable
+a=source-filter: incl IN IP4 239.22.142.1 192.168.9.142
+a=rtpmap:96 raw/90000
+a=fmtp:96 colorimetry=BT709; exactframerate=30000/1001; depth=10; TCS=SDR; sampling=YCbCr-4:2:2; width=1920; interlace; TP=2110TPN; PM=2110GPM; height=1080; SSN=ST2110-20:2017;
+a=mediaclk:direct=0
+a=mid:PRIMARY
+m=video 50120 RTP/AVP 96
+c=IN IP4 239.122.142.1/32
+a=ts-refclk:ptp=IEEE1588-2008:traceable
+a=source-filter: incl IN IP4 239.122.142.1 192.168.109.142
+a=rtpmap:96 raw/90000
+a=fmtp:96 colorimetry=BT709; exactframerate=30000/1001; depth=10; TCS=SDR; sampling=YCbCr-4:2:2; width=1920; interlace; TP=2110TPN; PM=2110GPM; height=1080; SSN=ST2110-20:2017;
+a=mediaclk:direct=0
+a=mid:SECONDARY
+)";
+}
+
+////////////////////////////////////////////////////////////////////////////////////////////
+BST_TEST_CASE(benchmarkSdp)
+{
+    bst::test::benchmark("sdp::parse_session_description", []
+    {
+        bst::test::do_not_optimize(sdp::parse_session_description(video_sdp));
+    });
+
+    const auto session_description = sdp::parse_session_description(video_sdp);
+    bst::test::benchmark("sdp::make_session_description", [&]
+    {
+        bst::test::do_not_optimize(sdp::make_session_description(session_description));
+    });
+}